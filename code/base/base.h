@@ -18,6 +18,7 @@
 #include "config_hw.h"
 
 
+typedef unsigned long long u64;
 typedef unsigned int u32;
 typedef unsigned short u16;
 typedef unsigned char u8;
@@ -35,7 +36,7 @@ typedef u32 __le32;
 // dword[3...0]: BB.BB.MM.mm  (BB.BB: build number (highest bytes), MM: major ver, mm: minor ver (lowest byte)) 
 #define SYSTEM_SW_VERSION_MAJOR 11
 #define SYSTEM_SW_VERSION_MINOR 8
-#define SYSTEM_SW_BUILD_NUMBER  11801
+#define SYSTEM_SW_BUILD_NUMBER  11802
 //#define SYSTEM_IS_PRERELEASE 1
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -114,8 +115,10 @@ void log_enable_full();
 void log_force_full_log();
 void log_regular_mode();
 int  log_is_errors_only();
+void log_use_ring(int iUseRing);
 
 void log_format_time(u32 miliseconds, char* szOutTime);
+void log_format_time_loop_counter(u32 miliseconds, u32 uLoopCounter, char* szOutTime);
 void log_line(const char* format, ...);
 void log_line_forced_to_file(const char* format, ...);
 void log_buffer(const u8* buffer, int size);
@@ -0,0 +1,529 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "chacha20_poly1305.h"
+
+// The vector engine keeps the same state word of four consecutive blocks in one vector register.
+// GCC vector extensions compile to SSE2 on x86 and NEON on ARM (scalar code on CPUs without SIMD).
+// Keystream words are stored in memory order, so little endian only (all supported platforms).
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CHACHA20_HAS_VECTOR_ENGINE 1
+typedef u32 type_chacha20_vector __attribute__((vector_size(16)));
+#if defined(__clang__)
+#define CHACHA20_SHUFFLE(a, b, i0, i1, i2, i3) __builtin_shufflevector(a, b, i0, i1, i2, i3)
+#else
+#define CHACHA20_SHUFFLE(a, b, i0, i1, i2, i3) __builtin_shuffle(a, b, (type_chacha20_vector){ i0, i1, i2, i3 })
+#endif
+#endif
+
+// Data is processed (encrypted and authenticated) in chunks of this size, while still in the cache
+#define CHACHA20_POLY1305_CHUNK_SIZE 256
+
+#define CHACHA20_ROTL(v, n) (((v) << (n)) | ((v) >> (32-(n))))
+
+#define CHACHA20_QUARTER_ROUND(a, b, c, d) \
+   a += b; d ^= a; d = CHACHA20_ROTL(d, 16); \
+   c += d; b ^= c; b = CHACHA20_ROTL(b, 12); \
+   a += b; d ^= a; d = CHACHA20_ROTL(d, 8); \
+   c += d; b ^= c; b = CHACHA20_ROTL(b, 7);
+
+#define CHACHA20_DOUBLE_ROUND(x) \
+   CHACHA20_QUARTER_ROUND(x[0], x[4], x[8], x[12]) \
+   CHACHA20_QUARTER_ROUND(x[1], x[5], x[9], x[13]) \
+   CHACHA20_QUARTER_ROUND(x[2], x[6], x[10], x[14]) \
+   CHACHA20_QUARTER_ROUND(x[3], x[7], x[11], x[15]) \
+   CHACHA20_QUARTER_ROUND(x[0], x[5], x[10], x[15]) \
+   CHACHA20_QUARTER_ROUND(x[1], x[6], x[11], x[12]) \
+   CHACHA20_QUARTER_ROUND(x[2], x[7], x[8], x[13]) \
+   CHACHA20_QUARTER_ROUND(x[3], x[4], x[9], x[14])
+
+static void _chacha20_engine_auto(u32* pState, u8* pData, int iLength);
+
+// All engines xor the keystream into pData, starting with block pState[12], and advance pState[12]
+static void (*s_pFnChaCha20Engine)(u32*, u8*, int) = _chacha20_engine_auto;
+static int s_iChaCha20Engine = CHACHA20_ENGINE_SCALAR;
+
+static u32 _chacha20_load32(const u8* pData)
+{
+   return ((u32)pData[0]) | (((u32)pData[1]) << 8) | (((u32)pData[2]) << 16) | (((u32)pData[3]) << 24);
+}
+
+static void _chacha20_store32(u8* pData, u32 uValue)
+{
+   pData[0] = (u8)uValue;
+   pData[1] = (u8)(uValue >> 8);
+   pData[2] = (u8)(uValue >> 16);
+   pData[3] = (u8)(uValue >> 24);
+}
+
+static void _chacha20_init_state(u32* pState, const u8* pKey, u32 uCounter, const u8* pNonce)
+{
+   pState[0] = 0x61707865;
+   pState[1] = 0x3320646e;
+   pState[2] = 0x79622d32;
+   pState[3] = 0x6b206574;
+   for( int i=0; i<8; i++ )
+      pState[4+i] = _chacha20_load32(pKey + 4*i);
+   pState[12] = uCounter;
+   for( int i=0; i<3; i++ )
+      pState[13+i] = _chacha20_load32(pNonce + 4*i);
+}
+
+static void _chacha20_scalar_block(const u32* pState, u8* pOutput)
+{
+   u32 x[16];
+   for( int i=0; i<16; i++ )
+      x[i] = pState[i];
+   for( int i=0; i<10; i++ )
+   {
+      CHACHA20_DOUBLE_ROUND(x)
+   }
+   for( int i=0; i<16; i++ )
+      _chacha20_store32(pOutput + 4*i, x[i] + pState[i]);
+}
+
+static void _chacha20_engine_scalar(u32* pState, u8* pData, int iLength)
+{
+   u8 uKeyStream[CHACHA20_BLOCK_SIZE];
+   while ( iLength > 0 )
+   {
+      _chacha20_scalar_block(pState, uKeyStream);
+      pState[12]++;
+      int iCount = (iLength < CHACHA20_BLOCK_SIZE)?iLength:CHACHA20_BLOCK_SIZE;
+      for( int i=0; i<iCount; i++ )
+         pData[i] ^= uKeyStream[i];
+      pData += iCount;
+      iLength -= iCount;
+   }
+}
+
+#ifdef CHACHA20_HAS_VECTOR_ENGINE
+
+// Four consecutive keystream blocks (256 bytes), xored into pData (iLength bytes, up to 256)
+static void _chacha20_vector_4blocks(const u32* pState, u8* pData, int iLength)
+{
+   type_chacha20_vector x[16];
+   type_chacha20_vector s[16];
+   for( int i=0; i<16; i++ )
+   {
+      type_chacha20_vector v = { pState[i], pState[i], pState[i], pState[i] };
+      s[i] = v;
+   }
+   type_chacha20_vector vCounters = { 0, 1, 2, 3 };
+   s[12] += vCounters;
+   for( int i=0; i<16; i++ )
+      x[i] = s[i];
+
+   for( int i=0; i<10; i++ )
+   {
+      CHACHA20_DOUBLE_ROUND(x)
+   }
+   for( int i=0; i<16; i++ )
+      x[i] += s[i];
+
+   // 4x4 transposes: block b, words 4g..4g+3 are lane b of x[4g..4g+3]
+   u8 uKeyStream[4*CHACHA20_BLOCK_SIZE] __attribute__((aligned(16)));
+   u8* pOutput = (iLength == 4*CHACHA20_BLOCK_SIZE)?pData:uKeyStream;
+   for( int g=0; g<4; g++ )
+   {
+      type_chacha20_vector t0 = CHACHA20_SHUFFLE(x[4*g], x[4*g+1], 0, 4, 1, 5);
+      type_chacha20_vector t1 = CHACHA20_SHUFFLE(x[4*g+2], x[4*g+3], 0, 4, 1, 5);
+      type_chacha20_vector t2 = CHACHA20_SHUFFLE(x[4*g], x[4*g+1], 2, 6, 3, 7);
+      type_chacha20_vector t3 = CHACHA20_SHUFFLE(x[4*g+2], x[4*g+3], 2, 6, 3, 7);
+      type_chacha20_vector r[4];
+      r[0] = CHACHA20_SHUFFLE(t0, t1, 0, 1, 4, 5);
+      r[1] = CHACHA20_SHUFFLE(t0, t1, 2, 3, 6, 7);
+      r[2] = CHACHA20_SHUFFLE(t2, t3, 0, 1, 4, 5);
+      r[3] = CHACHA20_SHUFFLE(t2, t3, 2, 3, 6, 7);
+      for( int b=0; b<4; b++ )
+      {
+         // Full chunk: xor straight into the data, otherwise keep the keystream for the partial xor below
+         u8* pOut = pOutput + b*CHACHA20_BLOCK_SIZE + g*16;
+         if ( pOutput == pData )
+         {
+            type_chacha20_vector vData;
+            memcpy(&vData, pOut, 16);
+            r[b] ^= vData;
+         }
+         memcpy(pOut, &r[b], 16);
+      }
+   }
+   if ( pOutput == pData )
+      return;
+
+   int iPos = 0;
+   for( ; iPos + 16 <= iLength; iPos += 16 )
+   {
+      type_chacha20_vector vData, vKey;
+      memcpy(&vData, pData + iPos, 16);
+      memcpy(&vKey, uKeyStream + iPos, 16);
+      vData ^= vKey;
+      memcpy(pData + iPos, &vData, 16);
+   }
+   for( ; iPos < iLength; iPos++ )
+      pData[iPos] ^= uKeyStream[iPos];
+}
+
+static void _chacha20_engine_vector(u32* pState, u8* pData, int iLength)
+{
+   while ( iLength > CHACHA20_BLOCK_SIZE )
+   {
+      int iCount = (iLength < 4*CHACHA20_BLOCK_SIZE)?iLength:(4*CHACHA20_BLOCK_SIZE);
+      _chacha20_vector_4blocks(pState, pData, iCount);
+      pState[12] += (u32)((iCount + CHACHA20_BLOCK_SIZE - 1)/CHACHA20_BLOCK_SIZE);
+      pData += iCount;
+      iLength -= iCount;
+   }
+   // A single block is cheaper on the scalar path
+   if ( iLength > 0 )
+      _chacha20_engine_scalar(pState, pData, iLength);
+}
+
+#endif // CHACHA20_HAS_VECTOR_ENGINE
+
+int chacha20_is_engine_supported(int iEngine)
+{
+   switch ( iEngine )
+   {
+      case CHACHA20_ENGINE_SCALAR:
+         return 1;
+#ifdef CHACHA20_HAS_VECTOR_ENGINE
+      case CHACHA20_ENGINE_VECTOR:
+         return 1;
+#endif
+      default:
+         return 0;
+   }
+}
+
+int chacha20_set_engine(int iEngine)
+{
+   if ( ! chacha20_is_engine_supported(iEngine) )
+      return 0;
+
+   switch ( iEngine )
+   {
+#ifdef CHACHA20_HAS_VECTOR_ENGINE
+      case CHACHA20_ENGINE_VECTOR:
+         s_pFnChaCha20Engine = _chacha20_engine_vector;
+         break;
+#endif
+      default:
+         s_pFnChaCha20Engine = _chacha20_engine_scalar;
+         break;
+   }
+   s_iChaCha20Engine = iEngine;
+   return 1;
+}
+
+int chacha20_get_engine()
+{
+   return s_iChaCha20Engine;
+}
+
+const char* chacha20_get_engine_name(int iEngine)
+{
+   switch ( iEngine )
+   {
+      case CHACHA20_ENGINE_SCALAR: return "scalar";
+      case CHACHA20_ENGINE_VECTOR: return "vector";
+      default: return "unknown";
+   }
+}
+
+void chacha20_init()
+{
+   if ( chacha20_set_engine(CHACHA20_ENGINE_VECTOR) )
+      return;
+   chacha20_set_engine(CHACHA20_ENGINE_SCALAR);
+}
+
+static void _chacha20_engine_auto(u32* pState, u8* pData, int iLength)
+{
+   chacha20_init();
+   s_pFnChaCha20Engine(pState, pData, iLength);
+}
+
+void chacha20_block(const u8* pKey, u32 uCounter, const u8* pNonce, u8* pOutput)
+{
+   u32 uState[16];
+   _chacha20_init_state(uState, pKey, uCounter, pNonce);
+   _chacha20_scalar_block(uState, pOutput);
+}
+
+void chacha20_xor(const u8* pKey, u32 uCounter, const u8* pNonce, u8* pData, int iLength)
+{
+   if ( (NULL == pData) || (iLength <= 0) )
+      return;
+   u32 uState[16];
+   _chacha20_init_state(uState, pKey, uCounter, pNonce);
+   s_pFnChaCha20Engine(uState, pData, iLength);
+}
+
+//----------------------------------------------------
+// Poly1305, 26 bit limbs and 32x32->64 bit multiplies (fast on 32 bit ARM too)
+
+static void _poly1305_blocks(type_poly1305_state* pState, const u8* pData, int iLength, u32 uHighBit)
+{
+   const u32 r0 = pState->r[0], r1 = pState->r[1], r2 = pState->r[2], r3 = pState->r[3], r4 = pState->r[4];
+   const u32 s1 = r1*5, s2 = r2*5, s3 = r3*5, s4 = r4*5;
+   u32 h0 = pState->h[0], h1 = pState->h[1], h2 = pState->h[2], h3 = pState->h[3], h4 = pState->h[4];
+
+   while ( iLength >= 16 )
+   {
+      h0 += (_chacha20_load32(pData)) & 0x3ffffff;
+      h1 += (_chacha20_load32(pData+3) >> 2) & 0x3ffffff;
+      h2 += (_chacha20_load32(pData+6) >> 4) & 0x3ffffff;
+      h3 += (_chacha20_load32(pData+9) >> 6) & 0x3ffffff;
+      h4 += (_chacha20_load32(pData+12) >> 8) | uHighBit;
+
+      u64 d0 = ((u64)h0*r0) + ((u64)h1*s4) + ((u64)h2*s3) + ((u64)h3*s2) + ((u64)h4*s1);
+      u64 d1 = ((u64)h0*r1) + ((u64)h1*r0) + ((u64)h2*s4) + ((u64)h3*s3) + ((u64)h4*s2);
+      u64 d2 = ((u64)h0*r2) + ((u64)h1*r1) + ((u64)h2*r0) + ((u64)h3*s4) + ((u64)h4*s3);
+      u64 d3 = ((u64)h0*r3) + ((u64)h1*r2) + ((u64)h2*r1) + ((u64)h3*r0) + ((u64)h4*s4);
+      u64 d4 = ((u64)h0*r4) + ((u64)h1*r3) + ((u64)h2*r2) + ((u64)h3*r1) + ((u64)h4*r0);
+
+      u32 c = (u32)(d0 >> 26); h0 = (u32)d0 & 0x3ffffff;
+      d1 += c; c = (u32)(d1 >> 26); h1 = (u32)d1 & 0x3ffffff;
+      d2 += c; c = (u32)(d2 >> 26); h2 = (u32)d2 & 0x3ffffff;
+      d3 += c; c = (u32)(d3 >> 26); h3 = (u32)d3 & 0x3ffffff;
+      d4 += c; c = (u32)(d4 >> 26); h4 = (u32)d4 & 0x3ffffff;
+      h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+      h1 += c;
+
+      pData += 16;
+      iLength -= 16;
+   }
+   pState->h[0] = h0; pState->h[1] = h1; pState->h[2] = h2; pState->h[3] = h3; pState->h[4] = h4;
+}
+
+void poly1305_init(type_poly1305_state* pState, const u8* pKey)
+{
+   // r is clamped
+   pState->r[0] = (_chacha20_load32(pKey)) & 0x3ffffff;
+   pState->r[1] = (_chacha20_load32(pKey+3) >> 2) & 0x3ffff03;
+   pState->r[2] = (_chacha20_load32(pKey+6) >> 4) & 0x3ffc0ff;
+   pState->r[3] = (_chacha20_load32(pKey+9) >> 6) & 0x3f03fff;
+   pState->r[4] = (_chacha20_load32(pKey+12) >> 8) & 0x00fffff;
+   for( int i=0; i<5; i++ )
+      pState->h[i] = 0;
+   for( int i=0; i<4; i++ )
+      pState->pad[i] = _chacha20_load32(pKey + 16 + 4*i);
+   pState->iLeftover = 0;
+}
+
+void poly1305_update(type_poly1305_state* pState, const u8* pData, int iLength)
+{
+   if ( (NULL == pData) || (iLength <= 0) )
+      return;
+   if ( pState->iLeftover > 0 )
+   {
+      int iCount = 16 - pState->iLeftover;
+      if ( iCount > iLength )
+         iCount = iLength;
+      memcpy(pState->buffer + pState->iLeftover, pData, iCount);
+      pState->iLeftover += iCount;
+      pData += iCount;
+      iLength -= iCount;
+      if ( pState->iLeftover < 16 )
+         return;
+      _poly1305_blocks(pState, pState->buffer, 16, 1<<24);
+      pState->iLeftover = 0;
+   }
+   int iFull = iLength & ~15;
+   if ( iFull > 0 )
+   {
+      _poly1305_blocks(pState, pData, iFull, 1<<24);
+      pData += iFull;
+      iLength -= iFull;
+   }
+   if ( iLength > 0 )
+   {
+      memcpy(pState->buffer, pData, iLength);
+      pState->iLeftover = iLength;
+   }
+}
+
+void poly1305_finish(type_poly1305_state* pState, u8* pTag)
+{
+   if ( pState->iLeftover > 0 )
+   {
+      pState->buffer[pState->iLeftover] = 1;
+      for( int i=pState->iLeftover+1; i<16; i++ )
+         pState->buffer[i] = 0;
+      _poly1305_blocks(pState, pState->buffer, 16, 0);
+      pState->iLeftover = 0;
+   }
+
+   u32 h0 = pState->h[0], h1 = pState->h[1], h2 = pState->h[2], h3 = pState->h[3], h4 = pState->h[4];
+   u32 c;
+   c = h1 >> 26; h1 &= 0x3ffffff;
+   h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+   h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+   h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+   h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+   h1 += c;
+
+   // g = h + 5 - 2^130; use g if h >= 2^130 - 5
+   u32 g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+   u32 g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+   u32 g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+   u32 g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+   u32 g4 = h4 + c - (1 << 26);
+
+   u32 uMask = (g4 >> 31) - 1;
+   g0 &= uMask; g1 &= uMask; g2 &= uMask; g3 &= uMask; g4 &= uMask;
+   uMask = ~uMask;
+   h0 = (h0 & uMask) | g0;
+   h1 = (h1 & uMask) | g1;
+   h2 = (h2 & uMask) | g2;
+   h3 = (h3 & uMask) | g3;
+   h4 = (h4 & uMask) | g4;
+
+   // h = (h + pad) mod 2^128
+   h0 = h0 | (h1 << 26);
+   h1 = (h1 >> 6) | (h2 << 20);
+   h2 = (h2 >> 12) | (h3 << 14);
+   h3 = (h3 >> 18) | (h4 << 8);
+
+   u64 f;
+   f = (u64)h0 + pState->pad[0]; h0 = (u32)f;
+   f = (u64)h1 + pState->pad[1] + (f >> 32); h1 = (u32)f;
+   f = (u64)h2 + pState->pad[2] + (f >> 32); h2 = (u32)f;
+   f = (u64)h3 + pState->pad[3] + (f >> 32); h3 = (u32)f;
+
+   _chacha20_store32(pTag, h0);
+   _chacha20_store32(pTag+4, h1);
+   _chacha20_store32(pTag+8, h2);
+   _chacha20_store32(pTag+12, h3);
+}
+
+void poly1305_mac(const u8* pKey, const u8* pData, int iLength, u8* pTag)
+{
+   type_poly1305_state state;
+   poly1305_init(&state, pKey);
+   poly1305_update(&state, pData, iLength);
+   poly1305_finish(&state, pTag);
+}
+
+//----------------------------------------------------
+// AEAD
+
+static void _chacha20_poly1305_pad16(type_poly1305_state* pState, int iLength)
+{
+   static const u8 s_uZeros[16] = {0};
+   if ( iLength & 15 )
+      poly1305_update(pState, s_uZeros, 16 - (iLength & 15));
+}
+
+static void _chacha20_poly1305_lengths(type_poly1305_state* pState, int iAADLength, int iLength)
+{
+   u8 uLengths[16];
+   memset(uLengths, 0, sizeof(uLengths));
+   _chacha20_store32(uLengths, (u32)iAADLength);
+   _chacha20_store32(uLengths + 8, (u32)iLength);
+   poly1305_update(pState, uLengths, 16);
+}
+
+// Block 0 of the keystream is the one time Poly1305 key; data is encrypted from block 1
+static void _chacha20_poly1305_start(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u32* pState, type_poly1305_state* pPoly)
+{
+   u8 uPolyKey[CHACHA20_BLOCK_SIZE];
+   _chacha20_init_state(pState, pKey, 0, pNonce);
+   _chacha20_scalar_block(pState, uPolyKey);
+   pState[12] = 1;
+   poly1305_init(pPoly, uPolyKey);
+   memset(uPolyKey, 0, sizeof(uPolyKey));
+   if ( (NULL != pAAD) && (iAADLength > 0) )
+   {
+      poly1305_update(pPoly, pAAD, iAADLength);
+      _chacha20_poly1305_pad16(pPoly, iAADLength);
+   }
+}
+
+void chacha20_poly1305_encrypt(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, u8* pTag)
+{
+   u32 uState[16];
+   type_poly1305_state poly;
+   if ( (NULL == pAAD) || (iAADLength < 0) )
+      iAADLength = 0;
+   if ( (NULL == pData) || (iLength < 0) )
+      iLength = 0;
+   _chacha20_poly1305_start(pKey, pNonce, pAAD, iAADLength, uState, &poly);
+
+   for( int iPos=0; iPos<iLength; iPos += CHACHA20_POLY1305_CHUNK_SIZE )
+   {
+      int iCount = iLength - iPos;
+      if ( iCount > CHACHA20_POLY1305_CHUNK_SIZE )
+         iCount = CHACHA20_POLY1305_CHUNK_SIZE;
+      s_pFnChaCha20Engine(uState, pData + iPos, iCount);
+      poly1305_update(&poly, pData + iPos, iCount);
+   }
+   _chacha20_poly1305_pad16(&poly, iLength);
+   _chacha20_poly1305_lengths(&poly, iAADLength, iLength);
+   poly1305_finish(&poly, pTag);
+}
+
+int chacha20_poly1305_decrypt(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, const u8* pTag)
+{
+   u32 uState[16];
+   type_poly1305_state poly;
+   if ( (NULL == pAAD) || (iAADLength < 0) )
+      iAADLength = 0;
+   if ( (NULL == pData) || (iLength < 0) )
+      iLength = 0;
+   _chacha20_poly1305_start(pKey, pNonce, pAAD, iAADLength, uState, &poly);
+
+   for( int iPos=0; iPos<iLength; iPos += CHACHA20_POLY1305_CHUNK_SIZE )
+   {
+      int iCount = iLength - iPos;
+      if ( iCount > CHACHA20_POLY1305_CHUNK_SIZE )
+         iCount = CHACHA20_POLY1305_CHUNK_SIZE;
+      poly1305_update(&poly, pData + iPos, iCount);
+      s_pFnChaCha20Engine(uState, pData + iPos, iCount);
+   }
+   _chacha20_poly1305_pad16(&poly, iLength);
+   _chacha20_poly1305_lengths(&poly, iAADLength, iLength);
+
+   u8 uTag[POLY1305_TAG_SIZE];
+   poly1305_finish(&poly, uTag);
+   u8 uDiff = 0;
+   for( int i=0; i<POLY1305_TAG_SIZE; i++ )
+      uDiff |= uTag[i] ^ pTag[i];
+   if ( 0 == uDiff )
+      return 1;
+
+   // Forged or corrupted: put the ciphertext back (rare, keeps the single pass for valid packets)
+   if ( iLength > 0 )
+      chacha20_xor(pKey, 1, pNonce, pData, iLength);
+   return 0;
+}
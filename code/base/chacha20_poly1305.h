@@ -0,0 +1,58 @@
+#pragma once
+
+#include "base.h"
+
+// ChaCha20 stream cipher, Poly1305 authenticator and the ChaCha20-Poly1305 AEAD construction (RFC 8439).
+// The ChaCha20 engine is selected at runtime; all engines return identical results.
+
+#define CHACHA20_KEY_SIZE 32
+#define CHACHA20_NONCE_SIZE 12
+#define CHACHA20_BLOCK_SIZE 64
+#define POLY1305_KEY_SIZE 32
+#define POLY1305_TAG_SIZE 16
+
+#define CHACHA20_ENGINE_SCALAR 0   // one block at a time, the reference
+#define CHACHA20_ENGINE_VECTOR 1   // four blocks at a time in vector registers (SSE2/NEON)
+#define CHACHA20_ENGINE_COUNT 2
+
+typedef struct
+{
+   u32 r[5];
+   u32 h[5];
+   u32 pad[4];
+   u8  buffer[16];
+   int iLeftover;
+} type_poly1305_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Selects the fastest engine supported by this CPU. Called automatically on first use.
+void chacha20_init();
+
+int chacha20_is_engine_supported(int iEngine);
+// Returns 1 if the engine was selected, 0 if not supported on this CPU
+int chacha20_set_engine(int iEngine);
+int chacha20_get_engine();
+const char* chacha20_get_engine_name(int iEngine);
+
+// One keystream block for the given block counter
+void chacha20_block(const u8* pKey, u32 uCounter, const u8* pNonce, u8* pOutput);
+// Encrypts/decrypts in place, starting with block uCounter
+void chacha20_xor(const u8* pKey, u32 uCounter, const u8* pNonce, u8* pData, int iLength);
+
+void poly1305_init(type_poly1305_state* pState, const u8* pKey);
+void poly1305_update(type_poly1305_state* pState, const u8* pData, int iLength);
+void poly1305_finish(type_poly1305_state* pState, u8* pTag);
+void poly1305_mac(const u8* pKey, const u8* pData, int iLength, u8* pTag);
+
+// Encrypts pData in place and computes the tag over pAAD and the ciphertext, in a single pass over pData
+void chacha20_poly1305_encrypt(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, u8* pTag);
+// Authenticates and decrypts pData in place, in a single pass. Returns 1 if the tag is valid.
+// On an invalid tag returns 0 and pData is left unchanged (still encrypted).
+int chacha20_poly1305_decrypt(const u8* pKey, const u8* pNonce, const u8* pAAD, int iAADLength, u8* pData, int iLength, const u8* pTag);
+
+#ifdef __cplusplus
+}
+#endif
@@ -50,6 +50,9 @@
 
 #define DEFAULT_USE_PPCAP_FOR_TX 0
 #define DEFAULT_BYPASS_SOCKET_BUFFERS 1
+#define DEFAULT_USE_MMAP_RING_FOR_RX 0
+#define DEFAULT_USE_BATCHED_RADIO_TX 0
+#define DEFAULT_USE_PACED_VIDEO_TX 0
 #define DEFAULT_RADIO_TX_POWER_CONTROLLER 20
 #define DEFAULT_RADIO_TX_POWER 20
 #define DEFAULT_RADIO_SIK_TX_POWER 11
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "base.h"
+
+// CRC32 (IEEE 802.3, reflected, same as zlib) used for packets and IPC messages validation.
+// The engine is selected at runtime for the CPU we run on; all engines return identical results.
+
+#define CRC32_ENGINE_TABLE 0    // byte at a time table lookup, the reference
+#define CRC32_ENGINE_SLICE8 1   // slice-by-8 tables
+#define CRC32_ENGINE_ARMV8 2    // ARMv8 crc32 instructions
+#define CRC32_ENGINE_PCLMUL 3   // x86 carry-less multiply folding
+#define CRC32_ENGINE_COUNT 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Selects the fastest engine supported by this CPU. Called automatically on first use.
+void crc32_init();
+
+int crc32_is_engine_supported(int iEngine);
+// Returns 1 if the engine was selected, 0 if not supported on this CPU
+int crc32_set_engine(int iEngine);
+int crc32_get_engine();
+const char* crc32_get_engine_name(int iEngine);
+
+u32 crc32_compute(const u8* pData, int iLength);
+
+#ifdef __cplusplus
+}  
+#endif
@@ -28,6 +28,7 @@ extern "C" {
 #define CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_FRAMES_RECV_DURATION ((u32)(((u32)0x01)<<19))
 #define CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_FRAMES_CAPTURE_JITTER ((u32)(((u32)0x01)<<20))
 #define CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_FRAMES_SEND_DURATION ((u32)(((u32)0x01)<<21))
+#define CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_LATENCY_TRACE    ((u32)(((u32)0x01)<<22))
 
 
 #define ID_DONOT_SHOW_AGAIN_MIXED_PI_OPENIPC_HARDWARE 1
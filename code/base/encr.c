@@ -33,6 +33,7 @@
 #include "base.h"
 #include "config.h"
 #include "encr.h"
+#include "chacha20_poly1305.h"
 #include "../radio/radiopackets2.h"
 
 #define ENC_BLOCK_SIZE 8
@@ -41,6 +42,73 @@
 u8 s_epp[MAX_PASS_LENGTH+1];
 u8 s_eppl = 0;
 
+// ChaCha20-Poly1305 key, derived from the pass phrase each time it changes
+static u8 s_uEppAEADKey[CHACHA20_KEY_SIZE];
+// Random id of this session (boot) and the key the packets sent in this session are encrypted with
+static u8 s_uEppAEADSessionId[ENC_AEAD_SESSION_ID_SIZE];
+static u8 s_uEppAEADSessionKey[CHACHA20_KEY_SIZE];
+
+static void _epp_aead_derive_session_key(const u8* pSessionId, u8* pSessionKey)
+{
+   u8 uNonce[CHACHA20_NONCE_SIZE] = { 's','e','s','s' };
+   u8 uBlock[CHACHA20_BLOCK_SIZE];
+   memcpy(uNonce + 4, pSessionId, ENC_AEAD_SESSION_ID_SIZE);
+   chacha20_block(s_uEppAEADKey, 0, uNonce, uBlock);
+   memcpy(pSessionKey, uBlock, CHACHA20_KEY_SIZE);
+   memset(uBlock, 0, sizeof(uBlock));
+}
+
+void epp_aead_new_session()
+{
+   int iRead = 0;
+   FILE* fd = fopen("/dev/urandom", "rb");
+   if ( NULL != fd )
+   {
+      iRead = (int)fread(s_uEppAEADSessionId, 1, ENC_AEAD_SESSION_ID_SIZE, fd);
+      fclose(fd);
+   }
+   if ( ENC_AEAD_SESSION_ID_SIZE != iRead )
+   {
+      // No random source: mix the clock, the process id and the previous session id
+      log_softerror_and_alarm("[Encr] Failed to read a random session id, using the clock.");
+      u8 uKey[CHACHA20_KEY_SIZE];
+      u8 uBlock[CHACHA20_BLOCK_SIZE];
+      static const u8 s_uSessionNonce[CHACHA20_NONCE_SIZE] = { 'r','u','b','y','-','s','e','s','s','i','o','n' };
+      u64 uTimeMicros = get_current_timestamp_micros();
+      u32 uPid = (u32)getpid();
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      memset(uKey, 0, sizeof(uKey));
+      memcpy(uKey, &uTimeMicros, sizeof(u64));
+      memcpy(uKey + 8, &uPid, sizeof(u32));
+      memcpy(uKey + 12, &ts.tv_sec, (sizeof(ts.tv_sec) < 8)?sizeof(ts.tv_sec):8);
+      memcpy(uKey + 20, &ts.tv_nsec, (sizeof(ts.tv_nsec) < 4)?sizeof(ts.tv_nsec):4);
+      memcpy(uKey + 24, s_uEppAEADSessionId, ENC_AEAD_SESSION_ID_SIZE);
+      chacha20_block(uKey, 0, s_uSessionNonce, uBlock);
+      memcpy(s_uEppAEADSessionId, uBlock, ENC_AEAD_SESSION_ID_SIZE);
+   }
+   _epp_aead_derive_session_key(s_uEppAEADSessionId, s_uEppAEADSessionKey);
+}
+
+static void _epp_aead_derive_key()
+{
+   static const u8 s_uKeyNonce[CHACHA20_NONCE_SIZE] = { 'r','u','b','y','-','p','a','s','s','-','k','y' };
+   u8 uBlock[CHACHA20_BLOCK_SIZE];
+   int iLength = (s_eppl < MAX_PASS_LENGTH)?(int)s_eppl:MAX_PASS_LENGTH;
+
+   // Absorb the pass phrase a key size at a time, each step keyed by the previous one
+   memset(s_uEppAEADKey, 0, sizeof(s_uEppAEADKey));
+   for( int iPos=0; iPos<iLength; iPos += CHACHA20_KEY_SIZE )
+   {
+      for( int i=0; (i<CHACHA20_KEY_SIZE) && (iPos+i < iLength); i++ )
+         s_uEppAEADKey[i] ^= s_epp[iPos+i];
+      chacha20_block(s_uEppAEADKey, ((u32)iPos) | (((u32)iLength) << 16), s_uKeyNonce, uBlock);
+      memcpy(s_uEppAEADKey, uBlock, CHACHA20_KEY_SIZE);
+   }
+   memset(uBlock, 0, sizeof(uBlock));
+   epp_aead_new_session();
+}
+
 int lpp(char* szOutputBuffer, int maxLength)
 {
    char szFile[128];
@@ -91,6 +159,7 @@ int lpp(char* szOutputBuffer, int maxLength)
    s_eppl = pos;
    strncpy((char*)s_epp, szBuffer, MAX_PASS_LENGTH);
    s_epp[MAX_PASS_LENGTH] = 0;
+   _epp_aead_derive_key();
 
    if ( NULL != szOutputBuffer )
       strncpy(szOutputBuffer, szBuffer, maxLength);
@@ -113,6 +182,7 @@ int spp(char* szBuffer)
    s_eppl = strlen(szBuffer);
    strncpy((char*)s_epp, szBuffer, MAX_PASS_LENGTH);
    s_epp[MAX_PASS_LENGTH] = 0;
+   _epp_aead_derive_key();
 
    u8 sBlockSeed[ENC_BLOCK_SIZE];
    u8 sBlockInput[ENC_BLOCK_SIZE];
@@ -165,6 +235,8 @@ void rpp()
 {
    s_eppl = 0;
    s_epp[0] = 0;
+   memset(s_uEppAEADKey, 0, sizeof(s_uEppAEADKey));
+   memset(s_uEppAEADSessionKey, 0, sizeof(s_uEppAEADSessionKey));
 }
 
 u8* gpp(int* pLen)
@@ -212,3 +284,45 @@ int dpp(u8* pData, int len)
    }
    return 1;
 }
+
+static void _epp_aead_nonce(t_packet_header* pPH, u8* pNonce)
+{
+   memcpy(pNonce, &pPH->stream_packet_idx, sizeof(u32));
+   memcpy(pNonce + 4, &pPH->vehicle_id_src, sizeof(u32));
+   memcpy(pNonce + 8, &pPH->radio_link_packet_index, sizeof(u16));
+   pNonce[10] = 0;
+   pNonce[11] = 0;
+}
+
+int epp_aead(u8* pPacket)
+{
+   if ( (NULL == pPacket) || (0 == s_eppl) )
+      return 0;
+   t_packet_header* pPH = (t_packet_header*)pPacket;
+   int dx = sizeof(t_packet_header);
+   if ( pPH->total_length < dx )
+      return 0;
+
+   u8 uNonce[CHACHA20_NONCE_SIZE];
+   _epp_aead_nonce(pPH, uNonce);
+   chacha20_poly1305_encrypt(s_uEppAEADSessionKey, uNonce, pPacket, dx, pPacket + dx, pPH->total_length - dx, pPacket + pPH->total_length);
+   memcpy(pPacket + pPH->total_length + ENC_AEAD_TAG_SIZE, s_uEppAEADSessionId, ENC_AEAD_SESSION_ID_SIZE);
+   return 1;
+}
+
+int dpp_aead(u8* pPacket, int iBufferLength)
+{
+   if ( (NULL == pPacket) || (0 == s_eppl) )
+      return 0;
+   t_packet_header* pPH = (t_packet_header*)pPacket;
+   int dx = sizeof(t_packet_header);
+   if ( (iBufferLength < dx) || (pPH->total_length < dx) || (pPH->total_length + ENC_AEAD_TRAILER_SIZE > iBufferLength) )
+      return 0;
+
+   // The sender session key, from the session id it sent
+   u8 uSessionKey[CHACHA20_KEY_SIZE];
+   _epp_aead_derive_session_key(pPacket + pPH->total_length + ENC_AEAD_TAG_SIZE, uSessionKey);
+   u8 uNonce[CHACHA20_NONCE_SIZE];
+   _epp_aead_nonce(pPH, uNonce);
+   return chacha20_poly1305_decrypt(uSessionKey, uNonce, pPacket, dx, pPacket + dx, pPH->total_length - dx, pPacket + pPH->total_length);
+}
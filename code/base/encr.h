@@ -6,6 +6,16 @@
 
 #define MAX_PASS_LENGTH 64
 
+// Packets encryption modes (bEncrypt param when building radio packets)
+#define ENC_MODE_NONE 0
+#define ENC_MODE_XOR  1
+#define ENC_MODE_AEAD 2
+
+#define ENC_AEAD_TAG_SIZE 16
+#define ENC_AEAD_SESSION_ID_SIZE 8
+// Sent after each AEAD packet: the tag, then the sender session id
+#define ENC_AEAD_TRAILER_SIZE (ENC_AEAD_TAG_SIZE + ENC_AEAD_SESSION_ID_SIZE)
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,6 +32,22 @@ int hpp();
 int epp(u8* pData, int len);
 int dpp(u8* pData, int len);
 
+// ChaCha20-Poly1305 for radio packets. The packet header is authenticated, everything after it is
+// encrypted in place. The trailer (tag and session id) is written after the packet (at total_length),
+// so the buffer must have ENC_AEAD_TRAILER_SIZE bytes more.
+//
+// Nonce uniqueness: a (key, nonce) pair must never encrypt two different packets. The nonce is the stream
+// packet index, the source vehicle id and the radio link packet index, which do not repeat within a session
+// but start over on each restart, while the pass phrase (and the key derived from it) stays the same.
+// So each session (process start, or pass phrase change) picks a random 64 bit session id and encrypts with
+// a key derived from the pass phrase key and that id. The receiver derives the same key from the session id
+// sent in the trailer. Two sessions share a key only if their random ids collide.
+int epp_aead(u8* pPacket);
+// Returns 1 if the packet is authentic (and decrypts it), 0 if not (packet left unchanged)
+int dpp_aead(u8* pPacket, int iBufferLength);
+// Starts a new session: new random session id, so new encryption key (done each time the pass phrase is loaded or set)
+void epp_aead_new_session();
+
 #ifdef __cplusplus
 }  
 #endif 
\ No newline at end of file
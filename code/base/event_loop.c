@@ -0,0 +1,533 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include "base.h"
+#include "event_loop.h"
+
+u64 event_loop_get_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000LL;
+}
+
+int event_loop_get_histogram_bucket(u32 uMicros)
+{
+   int iBucket = 0;
+   while ( (uMicros > 0) && (iBucket < LOOP_LATENCY_HISTOGRAM_BUCKETS-1) )
+   {
+      uMicros >>= 1;
+      iBucket++;
+   }
+   return iBucket;
+}
+
+u32 event_loop_get_histogram_percentile(const u32* pHistogram, int iPercent)
+{
+   if ( NULL == pHistogram )
+      return 0;
+   u64 uTotal = 0;
+   for( int i=0; i<LOOP_LATENCY_HISTOGRAM_BUCKETS; i++ )
+      uTotal += pHistogram[i];
+   if ( 0 == uTotal )
+      return 0;
+   u64 uTarget = (uTotal * (u64)iPercent + 99) / 100;
+   if ( uTarget < 1 )
+      uTarget = 1;
+   u64 uCount = 0;
+   for( int i=0; i<LOOP_LATENCY_HISTOGRAM_BUCKETS; i++ )
+   {
+      uCount += pHistogram[i];
+      if ( uCount >= uTarget )
+         return (i == LOOP_LATENCY_HISTOGRAM_BUCKETS-1)?MAX_U32:(((u32)1) << i);
+   }
+   return MAX_U32;
+}
+
+int event_loop_init(type_event_loop* pLoop)
+{
+   if ( NULL == pLoop )
+      return 0;
+   memset(pLoop, 0, sizeof(type_event_loop));
+   pLoop->iEpollFd = epoll_create1(EPOLL_CLOEXEC);
+   if ( pLoop->iEpollFd < 0 )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to create epoll, error: %d, %s", errno, strerror(errno));
+      return 0;
+   }
+   return 1;
+}
+
+void event_loop_close(type_event_loop* pLoop)
+{
+   if ( NULL == pLoop )
+      return;
+   for( int i=0; i<pLoop->iCountSources; i++ )
+   {
+      type_event_loop_source* pSource = &(pLoop->sources[i]);
+      // Fd sources are owned by the caller
+      if ( (pSource->iType != EVENT_LOOP_SOURCE_FD) && (pSource->iFd >= 0) )
+         close(pSource->iFd);
+      pSource->iFd = -1;
+   }
+   if ( pLoop->iEpollFd >= 0 )
+      close(pLoop->iEpollFd);
+   pLoop->iEpollFd = -1;
+   pLoop->iCountSources = 0;
+}
+
+static int _event_loop_watch_fd(type_event_loop* pLoop, int iSourceId, int iFd)
+{
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u32 = (u32)iSourceId;
+   if ( 0 != epoll_ctl(pLoop->iEpollFd, EPOLL_CTL_ADD, iFd, &ev) )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to add source %s (fd %d) to epoll, error: %d, %s", pLoop->sources[iSourceId].szName, iFd, errno, strerror(errno));
+      return 0;
+   }
+   return 1;
+}
+
+static type_event_loop_source* _event_loop_new_source(type_event_loop* pLoop, const char* szName, int iType, int iPriority, event_loop_handler pHandler, void* pContext)
+{
+   if ( (NULL == pLoop) || (pLoop->iEpollFd < 0) || (NULL == pHandler) )
+      return NULL;
+   if ( pLoop->iCountSources >= EVENT_LOOP_MAX_SOURCES )
+   {
+      log_softerror_and_alarm("[EventLoop] Too many sources, can't add %s", (NULL != szName)?szName:"N/A");
+      return NULL;
+   }
+   if ( iPriority < 0 )
+      iPriority = 0;
+   if ( iPriority >= EVENT_LOOP_PRIORITY_CLASSES )
+      iPriority = EVENT_LOOP_PRIORITY_CLASSES-1;
+
+   type_event_loop_source* pSource = &(pLoop->sources[pLoop->iCountSources]);
+   memset(pSource, 0, sizeof(type_event_loop_source));
+   pSource->iType = iType;
+   pSource->iFd = -1;
+   pSource->iPriority = iPriority;
+   pSource->iEnabled = 1;
+   pSource->pHandler = pHandler;
+   pSource->pContext = pContext;
+   strncpy(pSource->szName, (NULL != szName)?szName:"N/A", sizeof(pSource->szName)-1);
+   return pSource;
+}
+
+int event_loop_add_fd(type_event_loop* pLoop, const char* szName, int iFd, int iPriority, event_loop_handler pHandler, event_loop_prepare_wait pPrepareWait, event_loop_finish_wait pFinishWait, void* pContext)
+{
+   type_event_loop_source* pSource = _event_loop_new_source(pLoop, szName, EVENT_LOOP_SOURCE_FD, iPriority, pHandler, pContext);
+   if ( NULL == pSource )
+      return -1;
+   pSource->pPrepareWait = pPrepareWait;
+   pSource->pFinishWait = pFinishWait;
+   int iSourceId = pLoop->iCountSources;
+   if ( iFd >= 0 )
+   {
+      if ( ! _event_loop_watch_fd(pLoop, iSourceId, iFd) )
+         return -1;
+      pSource->iFd = iFd;
+   }
+   pLoop->iCountSources++;
+   log_line("[EventLoop] Added fd source %s (fd %d), priority %d", pSource->szName, iFd, iPriority);
+   return iSourceId;
+}
+
+static int _event_loop_program_timer(type_event_loop_source* pSource, u32 uPeriodMicros)
+{
+   if ( uPeriodMicros < 50 )
+      uPeriodMicros = 50;
+   pSource->uPeriodMicros = uPeriodMicros;
+   pSource->uTimeDueMicros = event_loop_get_time_micros() + uPeriodMicros;
+
+   struct itimerspec spec;
+   spec.it_value.tv_sec = pSource->uTimeDueMicros / 1000000LL;
+   spec.it_value.tv_nsec = (pSource->uTimeDueMicros % 1000000LL) * 1000LL;
+   spec.it_interval.tv_sec = uPeriodMicros / 1000000;
+   spec.it_interval.tv_nsec = (uPeriodMicros % 1000000) * 1000;
+   if ( 0 != timerfd_settime(pSource->iFd, TFD_TIMER_ABSTIME, &spec, NULL) )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to set timer %s period to %u us, error: %d, %s", pSource->szName, uPeriodMicros, errno, strerror(errno));
+      return 0;
+   }
+   return 1;
+}
+
+int event_loop_add_timer(type_event_loop* pLoop, const char* szName, u32 uPeriodMicros, int iPriority, event_loop_handler pHandler, void* pContext)
+{
+   type_event_loop_source* pSource = _event_loop_new_source(pLoop, szName, EVENT_LOOP_SOURCE_TIMER, iPriority, pHandler, pContext);
+   if ( NULL == pSource )
+      return -1;
+   pSource->iFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if ( pSource->iFd < 0 )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to create timer %s, error: %d, %s", pSource->szName, errno, strerror(errno));
+      return -1;
+   }
+   int iSourceId = pLoop->iCountSources;
+   if ( (! _event_loop_program_timer(pSource, uPeriodMicros)) || (! _event_loop_watch_fd(pLoop, iSourceId, pSource->iFd)) )
+   {
+      close(pSource->iFd);
+      pSource->iFd = -1;
+      return -1;
+   }
+   pLoop->iCountSources++;
+   log_line("[EventLoop] Added timer source %s, period %u us, priority %d", pSource->szName, pSource->uPeriodMicros, iPriority);
+   return iSourceId;
+}
+
+int event_loop_add_event(type_event_loop* pLoop, const char* szName, int iPriority, event_loop_handler pHandler, void* pContext)
+{
+   type_event_loop_source* pSource = _event_loop_new_source(pLoop, szName, EVENT_LOOP_SOURCE_EVENT, iPriority, pHandler, pContext);
+   if ( NULL == pSource )
+      return -1;
+   pSource->iFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if ( pSource->iFd < 0 )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to create event %s, error: %d, %s", pSource->szName, errno, strerror(errno));
+      return -1;
+   }
+   int iSourceId = pLoop->iCountSources;
+   if ( ! _event_loop_watch_fd(pLoop, iSourceId, pSource->iFd) )
+   {
+      close(pSource->iFd);
+      pSource->iFd = -1;
+      return -1;
+   }
+   pLoop->iCountSources++;
+   log_line("[EventLoop] Added event source %s, priority %d", pSource->szName, iPriority);
+   return iSourceId;
+}
+
+static type_event_loop_source* _event_loop_get_source(type_event_loop* pLoop, int iSourceId, int iType)
+{
+   if ( (NULL == pLoop) || (iSourceId < 0) || (iSourceId >= pLoop->iCountSources) )
+      return NULL;
+   if ( pLoop->sources[iSourceId].iType != iType )
+      return NULL;
+   return &(pLoop->sources[iSourceId]);
+}
+
+int event_loop_set_fd(type_event_loop* pLoop, int iSourceId, int iFd)
+{
+   type_event_loop_source* pSource = _event_loop_get_source(pLoop, iSourceId, EVENT_LOOP_SOURCE_FD);
+   if ( NULL == pSource )
+      return 0;
+   // The old fd may already be closed by its owner (and removed from epoll with it)
+   if ( pSource->iFd >= 0 )
+      epoll_ctl(pLoop->iEpollFd, EPOLL_CTL_DEL, pSource->iFd, NULL);
+   pSource->iFd = -1;
+   pSource->iReady = 0;
+   if ( iFd < 0 )
+      return 1;
+   if ( ! _event_loop_watch_fd(pLoop, iSourceId, iFd) )
+      return 0;
+   pSource->iFd = iFd;
+   log_line("[EventLoop] Source %s now uses fd %d", pSource->szName, iFd);
+   return 1;
+}
+
+int event_loop_set_timer_period(type_event_loop* pLoop, int iSourceId, u32 uPeriodMicros)
+{
+   type_event_loop_source* pSource = _event_loop_get_source(pLoop, iSourceId, EVENT_LOOP_SOURCE_TIMER);
+   if ( NULL == pSource )
+      return 0;
+   if ( pSource->uPeriodMicros == uPeriodMicros )
+      return 1;
+   return _event_loop_program_timer(pSource, uPeriodMicros);
+}
+
+void event_loop_signal(type_event_loop* pLoop, int iSourceId)
+{
+   if ( (NULL == pLoop) || (iSourceId < 0) || (iSourceId >= EVENT_LOOP_MAX_SOURCES) )
+      return;
+   int iFd = pLoop->sources[iSourceId].iFd;
+   if ( iFd < 0 )
+      return;
+   u64 uValue = 1;
+   if ( write(iFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+}
+
+void event_loop_enable_source(type_event_loop* pLoop, int iSourceId, int iEnable)
+{
+   if ( (NULL == pLoop) || (iSourceId < 0) || (iSourceId >= pLoop->iCountSources) )
+      return;
+   pLoop->sources[iSourceId].iEnabled = iEnable;
+   if ( ! iEnable )
+      pLoop->sources[iSourceId].iReady = 0;
+}
+
+void event_loop_set_time_slice(type_event_loop* pLoop, int iSourceId, u32 uTimeSliceMicros)
+{
+   if ( (NULL == pLoop) || (iSourceId < 0) || (iSourceId >= pLoop->iCountSources) )
+      return;
+   pLoop->sources[iSourceId].uTimeSliceMicros = uTimeSliceMicros;
+}
+
+int event_loop_slice_expired(type_event_loop* pLoop)
+{
+   if ( (NULL == pLoop) || (0 == pLoop->uSliceDeadlineMicros) )
+      return 0;
+   return (event_loop_get_time_micros() >= pLoop->uSliceDeadlineMicros)?1:0;
+}
+
+// Consumes the readiness of a timer or event source. Returns 0 if it was not really ready.
+static int _event_loop_consume_ready(type_event_loop_source* pSource, u64 uTimeNow)
+{
+   if ( pSource->iType == EVENT_LOOP_SOURCE_FD )
+   {
+      pSource->uTimeReadyMicros = uTimeNow;
+      return 1;
+   }
+   u64 uValue = 0;
+   if ( read(pSource->iFd, &uValue, sizeof(uValue)) != sizeof(uValue) )
+      return 0;
+   if ( 0 == uValue )
+      return 0;
+   if ( pSource->iType == EVENT_LOOP_SOURCE_EVENT )
+   {
+      pSource->uTimeReadyMicros = uTimeNow;
+      return 1;
+   }
+   // Timer: ready since the first missed expiration
+   pSource->uTimeReadyMicros = pSource->uTimeDueMicros;
+   pSource->uTimeDueMicros += uValue * (u64)pSource->uPeriodMicros;
+   if ( uValue > 1 )
+      pSource->uTotalMissedTimerTicks += (u32)(uValue - 1);
+   return 1;
+}
+
+static void _event_loop_run_source(type_event_loop* pLoop, type_event_loop_source* pSource, u64* puTimeInHandlers)
+{
+   pSource->iReady = 0;
+   u64 uTimeStart = event_loop_get_time_micros();
+   u32 uLatency = (uTimeStart > pSource->uTimeReadyMicros)?(u32)(uTimeStart - pSource->uTimeReadyMicros):0;
+   pLoop->stats.uLatencyHistogram[pSource->iPriority][event_loop_get_histogram_bucket(uLatency)]++;
+   pLoop->stats.uTotalDispatches[pSource->iPriority]++;
+   if ( uLatency > pLoop->stats.uMaxLatencyMicros[pSource->iPriority] )
+      pLoop->stats.uMaxLatencyMicros[pSource->iPriority] = uLatency;
+
+   // Nested runs (preempting sources) keep the deadline of the interrupted handler
+   u64 uSliceDeadlineInterrupted = pLoop->uSliceDeadlineMicros;
+   pLoop->uSliceDeadlineMicros = (0 != pSource->uTimeSliceMicros)?(uTimeStart + pSource->uTimeSliceMicros):0;
+
+   pSource->pHandler(pSource->pContext);
+
+   pLoop->uSliceDeadlineMicros = uSliceDeadlineInterrupted;
+   u32 uRunTime = (u32)(event_loop_get_time_micros() - uTimeStart);
+   pSource->uTotalRuns++;
+   pSource->uTotalRunMicros += uRunTime;
+   if ( uRunTime > pSource->uMaxRunMicros )
+      pSource->uMaxRunMicros = uRunTime;
+   if ( (0 != pSource->uTimeSliceMicros) && (uRunTime > pSource->uTimeSliceMicros) )
+      pSource->uTotalSliceOverruns++;
+   *puTimeInHandlers += uRunTime;
+}
+
+static void _event_loop_update_handlers_stats(type_event_loop* pLoop)
+{
+   pLoop->stats.iCountHandlers = (pLoop->iCountSources < LOOP_LATENCY_MAX_HANDLERS)?pLoop->iCountSources:LOOP_LATENCY_MAX_HANDLERS;
+   for( int i=0; i<pLoop->stats.iCountHandlers; i++ )
+   {
+      type_event_loop_source* pSource = &(pLoop->sources[i]);
+      shared_mem_loop_handler_stats* pStats = &(pLoop->stats.handlers[i]);
+      strncpy(pStats->szName, pSource->szName, sizeof(pStats->szName)-1);
+      pStats->szName[sizeof(pStats->szName)-1] = 0;
+      pStats->uTotalRuns = pSource->uTotalRuns;
+      pStats->uMaxRunMicros = pSource->uMaxRunMicros;
+      pStats->uTotalRunMicros = pSource->uTotalRunMicros;
+      pStats->uTimeSliceMicros = pSource->uTimeSliceMicros;
+      pStats->uTotalSliceOverruns = pSource->uTotalSliceOverruns;
+      pStats->uTotalMissedTimerTicks = pSource->uTotalMissedTimerTicks;
+   }
+}
+
+// Runs the high priority sources that became ready since the wait
+static void _event_loop_run_preempting_sources(type_event_loop* pLoop, u64* puTimeInHandlers)
+{
+   u64 uTimeNow = event_loop_get_time_micros();
+   for( int i=0; i<pLoop->iCountSources; i++ )
+   {
+      type_event_loop_source* pSource = &(pLoop->sources[i]);
+      if ( (pSource->iPriority != EVENT_LOOP_PRIORITY_HIGH) || (! pSource->iEnabled) || pSource->iReady )
+         continue;
+      if ( pSource->iType == EVENT_LOOP_SOURCE_TIMER )
+      {
+         if ( uTimeNow >= pSource->uTimeDueMicros )
+            pSource->iReady = _event_loop_consume_ready(pSource, uTimeNow);
+      }
+      else if ( (pSource->iType == EVENT_LOOP_SOURCE_FD) && (NULL != pSource->pPrepareWait) )
+      {
+         int iPending = pSource->pPrepareWait(pSource->pContext);
+         if ( NULL != pSource->pFinishWait )
+            pSource->pFinishWait(pSource->pContext);
+         if ( iPending )
+         {
+            pSource->iReady = 1;
+            pSource->uTimeReadyMicros = uTimeNow;
+         }
+      }
+   }
+   for( int i=0; i<pLoop->iCountSources; i++ )
+   {
+      if ( pLoop->sources[i].iReady && (pLoop->sources[i].iPriority == EVENT_LOOP_PRIORITY_HIGH) )
+         _event_loop_run_source(pLoop, &(pLoop->sources[i]), puTimeInHandlers);
+   }
+}
+
+int event_loop_run_once(type_event_loop* pLoop, int iTimeoutMs)
+{
+   if ( (NULL == pLoop) || (pLoop->iEpollFd < 0) )
+      return -1;
+
+   u64 uTimeNow = event_loop_get_time_micros();
+   int iAnyPending = 0;
+   for( int i=0; i<pLoop->iCountSources; i++ )
+   {
+      type_event_loop_source* pSource = &(pLoop->sources[i]);
+      if ( (! pSource->iEnabled) || (pSource->iFd < 0) || (NULL == pSource->pPrepareWait) )
+         continue;
+      if ( pSource->pPrepareWait(pSource->pContext) )
+      {
+         pSource->iReady = 1;
+         pSource->uTimeReadyMicros = uTimeNow;
+         iAnyPending = 1;
+      }
+   }
+
+   struct epoll_event events[EVENT_LOOP_MAX_SOURCES];
+   int iCountEvents = epoll_wait(pLoop->iEpollFd, events, EVENT_LOOP_MAX_SOURCES, iAnyPending?0:iTimeoutMs);
+   int iWaitError = ((iCountEvents < 0) && (errno != EINTR))?errno:0;
+
+   for( int i=0; i<pLoop->iCountSources; i++ )
+   {
+      type_event_loop_source* pSource = &(pLoop->sources[i]);
+      if ( (pSource->iFd >= 0) && (NULL != pSource->pFinishWait) )
+         pSource->pFinishWait(pSource->pContext);
+   }
+
+   pLoop->stats.uTotalIterations++;
+   if ( (! iAnyPending) && (0 != iTimeoutMs) )
+      pLoop->stats.uTotalIdleWaits++;
+
+   if ( 0 != iWaitError )
+   {
+      log_softerror_and_alarm("[EventLoop] Wait failed, error: %d, %s", iWaitError, strerror(iWaitError));
+      return -1;
+   }
+
+   uTimeNow = event_loop_get_time_micros();
+   for( int i=0; i<iCountEvents; i++ )
+   {
+      u32 uSourceId = events[i].data.u32;
+      if ( uSourceId >= (u32)pLoop->iCountSources )
+         continue;
+      type_event_loop_source* pSource = &(pLoop->sources[uSourceId]);
+      if ( pSource->iReady )
+         continue;
+      if ( ! pSource->iEnabled )
+      {
+         // Still consume timers and events, so they don't keep the wait from blocking
+         if ( pSource->iType != EVENT_LOOP_SOURCE_FD )
+            _event_loop_consume_ready(pSource, uTimeNow);
+         continue;
+      }
+      pSource->iReady = _event_loop_consume_ready(pSource, uTimeNow);
+   }
+
+   u64 uTimeInHandlers = 0;
+   int iCountRun = 0;
+   for( int iPriority=0; iPriority<EVENT_LOOP_PRIORITY_CLASSES; iPriority++ )
+   {
+      for( int i=0; i<pLoop->iCountSources; i++ )
+      {
+         type_event_loop_source* pSource = &(pLoop->sources[i]);
+         if ( (! pSource->iReady) || (pSource->iPriority != iPriority) )
+            continue;
+         if ( iPriority != EVENT_LOOP_PRIORITY_HIGH )
+            _event_loop_run_preempting_sources(pLoop, &uTimeInHandlers);
+         _event_loop_run_source(pLoop, pSource, &uTimeInHandlers);
+         iCountRun++;
+      }
+   }
+
+   pLoop->uLastIterationMicros = (u32)uTimeInHandlers;
+   if ( iCountRun > 0 )
+      pLoop->stats.uIterationTimeHistogram[event_loop_get_histogram_bucket((u32)uTimeInHandlers)]++;
+
+   if ( NULL != pLoop->pSharedStats )
+   {
+      u32 uTimeNowMs = get_current_timestamp_ms();
+      if ( uTimeNowMs >= pLoop->uTimeLastPublish + EVENT_LOOP_STATS_PUBLISH_INTERVAL_MS )
+      {
+         pLoop->uTimeLastPublish = uTimeNowMs;
+         pLoop->stats.uTimeLastUpdate = uTimeNowMs;
+         _event_loop_update_handlers_stats(pLoop);
+         shared_mem_loop_latency_stats_publish(pLoop->pSharedStats, &(pLoop->stats));
+      }
+   }
+   return iCountRun;
+}
+
+void event_loop_set_shared_stats(type_event_loop* pLoop, shared_mem_loop_latency_stats_versioned* pSharedStats)
+{
+   if ( NULL != pLoop )
+      pLoop->pSharedStats = pSharedStats;
+}
+
+shared_mem_loop_latency_stats* event_loop_get_stats(type_event_loop* pLoop)
+{
+   if ( NULL == pLoop )
+      return NULL;
+   _event_loop_update_handlers_stats(pLoop);
+   return &(pLoop->stats);
+}
+
+void event_loop_reset_stats(type_event_loop* pLoop)
+{
+   if ( NULL == pLoop )
+      return;
+   memset(&(pLoop->stats), 0, sizeof(shared_mem_loop_latency_stats));
+   for( int i=0; i<pLoop->iCountSources; i++ )
+   {
+      pLoop->sources[i].uTotalRuns = 0;
+      pLoop->sources[i].uTotalMissedTimerTicks = 0;
+      pLoop->sources[i].uMaxRunMicros = 0;
+      pLoop->sources[i].uTotalRunMicros = 0;
+      pLoop->sources[i].uTotalSliceOverruns = 0;
+   }
+}
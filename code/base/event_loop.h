@@ -0,0 +1,112 @@
+#pragma once
+
+#include "base.h"
+#include "shared_mem.h"
+
+// Single threaded event loop (reactor) on epoll, for the router processes main loops.
+// Event sources: file descriptors (radio rx queues wakeup, sockets), periodic timers (timerfd)
+// and events signaled from other threads (eventfd). The loop blocks until a source is ready and
+// runs the handlers of the ready sources in priority class order; before each normal or low priority
+// handler it checks the high priority sources again and runs them first if they became ready.
+// Loop latency (source ready to handler start) is kept as histograms, per priority class, and can be
+// published to shared memory.
+
+#define EVENT_LOOP_PRIORITY_HIGH 0   // radio rx, video retransmissions requests
+#define EVENT_LOOP_PRIORITY_NORMAL 1 // IPC, video output
+#define EVENT_LOOP_PRIORITY_LOW 2    // housekeeping
+#define EVENT_LOOP_PRIORITY_CLASSES LOOP_LATENCY_PRIORITY_CLASSES
+
+#define EVENT_LOOP_MAX_SOURCES 16
+
+#define EVENT_LOOP_SOURCE_FD 0
+#define EVENT_LOOP_SOURCE_TIMER 1
+#define EVENT_LOOP_SOURCE_EVENT 2
+
+#define EVENT_LOOP_STATS_PUBLISH_INTERVAL_MS 500
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*event_loop_handler)(void* pContext);
+// Optional, for fd sources with a wait handshake (like the radio rx queues): called before each wait,
+// returns 1 if the source has pending work (the loop does not block then). Always followed by the finish call.
+typedef int (*event_loop_prepare_wait)(void* pContext);
+typedef void (*event_loop_finish_wait)(void* pContext);
+
+typedef struct
+{
+   int iType;
+   int iFd; // own timerfd/eventfd for timers and events
+   int iPriority;
+   int iEnabled;
+   int iReady;
+   char szName[24];
+   event_loop_handler pHandler;
+   event_loop_prepare_wait pPrepareWait;
+   event_loop_finish_wait pFinishWait;
+   void* pContext;
+
+   u32 uPeriodMicros; // timers
+   u64 uTimeDueMicros; // timers: next expiration
+   u64 uTimeReadyMicros;
+
+   u32 uTimeSliceMicros; // handlers should return when it is used up (see event_loop_slice_expired)
+
+   u32 uTotalRuns;
+   u32 uTotalMissedTimerTicks;
+   u32 uMaxRunMicros;
+   u64 uTotalRunMicros;
+   u32 uTotalSliceOverruns;
+} type_event_loop_source;
+
+typedef struct
+{
+   int iEpollFd;
+   int iCountSources;
+   type_event_loop_source sources[EVENT_LOOP_MAX_SOURCES];
+   u32 uTimeLastPublish;
+   u32 uLastIterationMicros; // time spent in handlers on the last iteration
+   u64 uSliceDeadlineMicros; // of the handler running now, 0 if none
+   shared_mem_loop_latency_stats stats;
+   shared_mem_loop_latency_stats_versioned* pSharedStats;
+} type_event_loop;
+
+int event_loop_init(type_event_loop* pLoop);
+void event_loop_close(type_event_loop* pLoop);
+
+// All return the source id (>= 0), or -1 on failure. iFd can be -1 (set it later with event_loop_set_fd).
+int event_loop_add_fd(type_event_loop* pLoop, const char* szName, int iFd, int iPriority, event_loop_handler pHandler, event_loop_prepare_wait pPrepareWait, event_loop_finish_wait pFinishWait, void* pContext);
+int event_loop_add_timer(type_event_loop* pLoop, const char* szName, u32 uPeriodMicros, int iPriority, event_loop_handler pHandler, void* pContext);
+int event_loop_add_event(type_event_loop* pLoop, const char* szName, int iPriority, event_loop_handler pHandler, void* pContext);
+
+// Fd sources: replaces the watched fd (for fds recreated by their owners; the same fd number is
+// registered again, as a closed fd is removed from epoll). Returns 1 on success.
+int event_loop_set_fd(type_event_loop* pLoop, int iSourceId, int iFd);
+// Timers: reprograms the timer if the period changed, next expiration is one period from now
+int event_loop_set_timer_period(type_event_loop* pLoop, int iSourceId, u32 uPeriodMicros);
+// Events: wakes up the loop to run the event handler. Can be called from any thread.
+void event_loop_signal(type_event_loop* pLoop, int iSourceId);
+void event_loop_enable_source(type_event_loop* pLoop, int iSourceId, int iEnable);
+// Bounded time slices: a handler doing a variable amount of work (reading a backlog of packets)
+// checks event_loop_slice_expired and returns when its slice is used up; fd sources still ready are
+// run again on the next iteration, after the other ready sources of the iteration. 0: no time slice.
+void event_loop_set_time_slice(type_event_loop* pLoop, int iSourceId, u32 uTimeSliceMicros);
+int event_loop_slice_expired(type_event_loop* pLoop);
+u64 event_loop_get_time_micros();
+
+// Waits up to iTimeoutMs (-1: no timeout) for ready sources and runs their handlers.
+// Returns the number of handlers run, -1 on wait error.
+int event_loop_run_once(type_event_loop* pLoop, int iTimeoutMs);
+
+// Stats (including the per handler run times) are published to shared memory every EVENT_LOOP_STATS_PUBLISH_INTERVAL_MS, if set
+void event_loop_set_shared_stats(type_event_loop* pLoop, shared_mem_loop_latency_stats_versioned* pSharedStats);
+shared_mem_loop_latency_stats* event_loop_get_stats(type_event_loop* pLoop);
+void event_loop_reset_stats(type_event_loop* pLoop);
+// Upper bound (microseconds) of the histogram bucket holding the given percentile (0..100) of the samples
+u32 event_loop_get_histogram_percentile(const u32* pHistogram, int iPercent);
+int event_loop_get_histogram_bucket(u32 uMicros);
+
+#ifdef __cplusplus
+}
+#endif
@@ -50,6 +50,8 @@
 #define MODEL_ENC_FLAG_ENC_DATA   ((u32)(((u32)0x01)<<1))
 #define MODEL_ENC_FLAG_ENC_VIDEO  ((u32)(((u32)0x01)<<2))
 #define MODEL_ENC_FLAG_ENC_ALL    ((u32)(((u32)0x01)<<3))
+// Encrypted streams use ChaCha20-Poly1305 (authenticated) instead of the legacy pass phrase xor
+#define MODEL_ENC_FLAG_ENC_AEAD   ((u32)(((u32)0x01)<<4))
 
 // raspivid commands
 #define RASPIVID_COMMAND_ID_BRIGHTNESS 1
@@ -141,6 +143,9 @@
 //#define DEVELOPER_FLAGS_BIT_SEND_BACK_VEHICLE_VIDEO_BITRATE_HISTORY ((u32)(((u32)0x01)<<16))
 #define DEVELOPER_FLAGS_BIT_INJECT_RECOVERABLE_VIDEO_FAULTS ((u32)(((u32)0x01)<<17))
 #define DEVELOPER_FLAGS_USE_PCAP_RADIO_TX ((u32)(((u32)0x01)<<18))
+#define DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX ((u32)(((u32)0x01)<<19))
+#define DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX ((u32)(((u32)0x01)<<20))
+#define DEVELOPER_FLAGS_USE_PACED_VIDEO_TX ((u32)(((u32)0x01)<<21))
 
 
 #define RXTX_SYNC_TYPE_NONE 0
@@ -50,6 +50,7 @@
 #include "hardware_radio.h"
 #include "hardware_serial.h"
 #include "hardware_radio_sik.h"
+#include "hardware_radio_netlink.h"
 #include "hardware_procs.h"
 #include "../common/string_utils.h"
 
@@ -1039,84 +1040,125 @@ int _hardware_enumerate_wifi_radios()
       for( int kk=0; kk<(int)(sizeof(sRadioInfo[i].szProductId)/sizeof(sRadioInfo[i].szProductId[0])); kk++ )
          sRadioInfo[i].szProductId[kk] = 0;
 
-      // Find the MAC address
-      sprintf(szComm, "iw dev %s info | grep addr", sRadioInfo[i].szName );
-      if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
-      {
-         log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
-      }
-      else if ( 1 != sscanf(szBuff, "%*s %s", szComm) )
+      // Find the MAC address, physical interface index and supported bands: from nl80211 if available, iw otherwise
+      type_radio_netlink_interface netlinkInterface;
+      int iHasNetlinkInfo = hardware_radio_netlink_get_interface(sRadioInfo[i].szName, &netlinkInterface);
+
+      if ( iHasNetlinkInfo && netlinkInterface.iHasMAC )
       {
-         log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
+         for( int k=0; k<6; k++ )
+            sprintf(&(sRadioInfo[i].szMAC[2*k]), "%02X", netlinkInterface.uMAC[k]);
+         log_line("Found MAC address %s for %s", sRadioInfo[i].szMAC, sRadioInfo[i].szName);
       }
       else
       {
-         log_line("Found MAC address %s for %s", szComm, sRadioInfo[i].szName);
-         szComm[MAX_MAC_LENGTH-1] = 0;
-         int iSt = 0;
-         int iEnd = 0;
-         while ( iEnd < (int)strlen(szComm) )
+         sprintf(szComm, "iw dev %s info | grep addr", sRadioInfo[i].szName );
+         if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
+         {
+            log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
+         }
+         else if ( 1 != sscanf(szBuff, "%*s %s", szComm) )
+         {
+            log_softerror_and_alarm("Failed to find MAC address for %s", sRadioInfo[i].szName);
+         }
+         else
          {
-            if ( szComm[iEnd] == ':' )
-               iEnd++;
-            else
+            log_line("Found MAC address %s for %s", szComm, sRadioInfo[i].szName);
+            szComm[MAX_MAC_LENGTH-1] = 0;
+            int iSt = 0;
+            int iEnd = 0;
+            while ( iEnd < (int)strlen(szComm) )
             {
-               szComm[iSt] = toupper(szComm[iEnd]);
-               iSt++;
-               iEnd++;
+               if ( szComm[iEnd] == ':' )
+                  iEnd++;
+               else
+               {
+                  szComm[iSt] = toupper(szComm[iEnd]);
+                  iSt++;
+                  iEnd++;
+               }
             }
+            szComm[iSt] = 0;
+            strncpy(sRadioInfo[i].szMAC, szComm, MAX_MAC_LENGTH-1);
+            sRadioInfo[i].szMAC[MAX_MAC_LENGTH-1] = 0;
          }
-         szComm[iSt] = 0;
-         strncpy(sRadioInfo[i].szMAC, szComm, MAX_MAC_LENGTH-1);
-         sRadioInfo[i].szMAC[MAX_MAC_LENGTH-1] = 0;
       }
 
       // Find physical interface number, in form phy#0
 
-      sprintf(szComm, "iw dev | grep -B 1 %s", sRadioInfo[i].szName );
-      if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
-      {
-         sRadioInfo[i].phy_index = i;
-         log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
-      }
-      else if ( 1 != sscanf(szBuff, "%s", szComm) )
+      if ( iHasNetlinkInfo && (netlinkInterface.iPhyIndex >= 0) )
       {
-         sRadioInfo[i].phy_index = i;
-         log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
+         sRadioInfo[i].phy_index = netlinkInterface.iPhyIndex;
+         log_line("phy index: %d", sRadioInfo[i].phy_index);
       }
       else
       {
-         int iPhyStrLen = strlen(szComm);
-         log_line("phy string: [%s], length: %d", szComm, iPhyStrLen);
-         sRadioInfo[i].phy_index = szComm[iPhyStrLen-1] - '0';
-         if ( (iPhyStrLen > 2) && isdigit(szComm[iPhyStrLen-2]) )
+         sprintf(szComm, "iw dev | grep -B 1 %s", sRadioInfo[i].szName );
+         if ( 1 != hw_execute_bash_command_raw(szComm, szBuff) )
          {
-            sRadioInfo[i].phy_index = 10 * (szComm[iPhyStrLen-2] - '0') + sRadioInfo[i].phy_index;
+            sRadioInfo[i].phy_index = i;
+            log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
+         }
+         else if ( 1 != sscanf(szBuff, "%s", szComm) )
+         {
+            sRadioInfo[i].phy_index = i;
+            log_softerror_and_alarm("Failed to find physical interface index for %s", sRadioInfo[i].szName);
+         }
+         else
+         {
+            int iPhyStrLen = strlen(szComm);
+            log_line("phy string: [%s], length: %d", szComm, iPhyStrLen);
+            sRadioInfo[i].phy_index = szComm[iPhyStrLen-1] - '0';
+            if ( (iPhyStrLen > 2) && isdigit(szComm[iPhyStrLen-2]) )
+            {
+               sRadioInfo[i].phy_index = 10 * (szComm[iPhyStrLen-2] - '0') + sRadioInfo[i].phy_index;
+            }
          }
       }
 
       // Check supported bands
 
       sRadioInfo[i].supportedBands = 0;
-      sprintf(szComm, "iw phy%d info | grep 2377", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_23;
-
-      sprintf(szComm, "iw phy%d info | grep 2427", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_24;
-
-      sprintf(szComm, "iw phy%d info | grep 2512", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_25;
-
-      sprintf(szComm, "iw phy%d info | grep 5745", sRadioInfo[i].phy_index);
-      hw_execute_bash_command_raw(szComm, szBuff);
-      if ( 5 < strlen(szBuff) )
-        sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_58;
+      u32 uPhyFrequencies[RADIO_NETLINK_MAX_PHY_FREQUENCIES];
+      int iPhyFrequencies = -1;
+      if ( iHasNetlinkInfo )
+         iPhyFrequencies = hardware_radio_netlink_get_phy_frequencies(sRadioInfo[i].phy_index, uPhyFrequencies, RADIO_NETLINK_MAX_PHY_FREQUENCIES);
+      if ( iPhyFrequencies > 0 )
+      {
+         for( int k=0; k<iPhyFrequencies; k++ )
+         {
+            if ( uPhyFrequencies[k] == 2377 )
+               sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_23;
+            if ( uPhyFrequencies[k] == 2427 )
+               sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_24;
+            if ( uPhyFrequencies[k] == 2512 )
+               sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_25;
+            if ( uPhyFrequencies[k] == 5745 )
+               sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_58;
+         }
+      }
+      else
+      {
+         sprintf(szComm, "iw phy%d info | grep 2377", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_23;
+
+         sprintf(szComm, "iw phy%d info | grep 2427", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_24;
+
+         sprintf(szComm, "iw phy%d info | grep 2512", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_25;
+
+         sprintf(szComm, "iw phy%d info | grep 5745", sRadioInfo[i].phy_index);
+         hw_execute_bash_command_raw(szComm, szBuff);
+         if ( 5 < strlen(szBuff) )
+           sRadioInfo[i].supportedBands |= RADIO_HW_SUPPORTED_BAND_58;
+      }
 
       if ( sRadioInfo[i].iRadioDriver == RADIO_HW_DRIVER_REALTEK_8812EU )
          sRadioInfo[i].supportedBands &= ~RADIO_HW_SUPPORTED_BAND_24;
@@ -1863,28 +1905,23 @@ int _configure_radio_interface_atheros(int iInterfaceIndex, radio_hw_info_t* pRa
    #ifdef HW_PLATFORM_OPENIPC_CAMERA
 
    //sprintf(szComm, "iwconfig %s mode monitor", pRadioHWInfo->szName);
-   sprintf(szComm, "iw dev %s set type monitor", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_type_monitor(pRadioHWInfo->szName, NULL);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, RADIO_NETLINK_MONITOR_FLAG_FCSFAIL, szOutput);
    hardware_sleep_ms(uDelayMS);
 
    //sprintf(szComm, "ifconfig %s up", pRadioHWInfo->szName );
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, NULL);
    hardware_sleep_ms(uDelayMS);
 
    return 1;
    #endif
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, RADIO_NETLINK_MONITOR_FLAG_FCSFAIL, szOutput);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, NULL);
    hardware_sleep_ms(uDelayMS);
    int dataRateMb = DEFAULT_RADIO_DATARATE_VIDEO_ATHEROS/1000/1000;
    if ( dataRateMb > 0 )
@@ -1894,22 +1931,18 @@ int _configure_radio_interface_atheros(int iInterfaceIndex, radio_hw_info_t* pRa
    hw_execute_bash_command(szComm, NULL);
    hardware_sleep_ms(uDelayMS);
    //sprintf(szComm, "ifconfig %s down 2>&1", pRadioHWInfo->szName );
-   sprintf(szComm, "ip link set dev %s down", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 0, NULL);
    if ( 0 != szOutput[0] )
       log_softerror_and_alarm("Unexpected result: [%s]", szOutput);
    hardware_sleep_ms(uDelayMS);
    
-   sprintf(szComm, "iw dev %s set monitor none", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, 0, NULL);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, RADIO_NETLINK_MONITOR_FLAG_FCSFAIL, szOutput);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, NULL);
    hardware_sleep_ms(uDelayMS);
    
    pRadioHWInfo->iCurrentDataRateBPS = dataRateMb*1000*1000;
@@ -1927,40 +1960,34 @@ int _configure_radio_interface_realtek(int iInterfaceIndex, radio_hw_info_t* pRa
 
    #ifdef HW_PLATFORM_OPENIPC_CAMERA
    
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, NULL);
    hardware_sleep_ms(uDelayMS);
 
    sprintf(szComm, "iwconfig %s mode monitor", pRadioHWInfo->szName );
    hw_execute_bash_command(szComm, NULL);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, RADIO_NETLINK_MONITOR_FLAG_FCSFAIL, szOutput);
    hardware_sleep_ms(uDelayMS);
    
    return 1;
 
    #endif
 
-   sprintf(szComm, "ip link set dev %s down", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 0, szOutput);
    if ( 0 != szOutput[0] )
       log_softerror_and_alarm("[HW-R] Unexpected result: [%s]", szOutput);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor none 2>&1", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, 0, szOutput);
    if ( 0 != szOutput[0] )
       log_softerror_and_alarm("Unexpected result: [%s]", szOutput);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, RADIO_NETLINK_MONITOR_FLAG_FCSFAIL, szOutput);
    hardware_sleep_ms(uDelayMS);
 
-   sprintf(szComm, "ip link set dev %s up", pRadioHWInfo->szName );
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, szOutput);
    if ( 0 != szOutput[0] )
       log_softerror_and_alarm("Unexpected result: [%s]", szOutput);
    hardware_sleep_ms(uDelayMS);
@@ -1988,8 +2015,7 @@ int hardware_initialize_radio_interface(int iInterfaceIndex, u32 uDelayMS)
 
    pRadioHWInfo->iCurrentDataRateBPS = 0;
    //sprintf(szComm, "ifconfig %s mtu 2304 2>&1", pRadioHWInfo->szName );
-   sprintf(szComm, "ip link set dev %s mtu 1400", pRadioHWInfo->szName);
-   hw_execute_bash_command(szComm, szOutput);
+   hardware_radio_set_mtu(pRadioHWInfo->szName, 1400, szOutput);
    if ( 0 != szOutput[0] )
       log_softerror_and_alarm("[HW-R] Unexpected result: [%s]", szOutput);
    hardware_sleep_ms(uDelayMS);
@@ -2035,6 +2061,41 @@ int hardware_add_radio_interface_info(radio_hw_info_t* pRadioInfo)
    return 1;
 }
 
+int hardware_radio_set_simulated_interfaces(int iCount)
+{
+   if ( (iCount < 1) || (iCount > MAX_RADIO_INTERFACES) )
+      return 0;
+
+   s_iHwRadiosCount = 0;
+   s_iHwRadiosSupportedCount = 0;
+   for( int i=0; i<iCount; i++ )
+   {
+      radio_hw_info_t* pRadioInfo = &sRadioInfo[i];
+      memset(pRadioInfo, 0, sizeof(radio_hw_info_t));
+      pRadioInfo->phy_index = i;
+      pRadioInfo->isSupported = 1;
+      pRadioInfo->isEnabled = 1;
+      pRadioInfo->supportedBands = RADIO_HW_SUPPORTED_BAND_58;
+      pRadioInfo->isHighCapacityInterface = 1;
+      pRadioInfo->isConfigurable = 1;
+      pRadioInfo->isTxCapable = 1;
+      pRadioInfo->uCurrentFrequencyKhz = 5825000;
+      pRadioInfo->iRadioType = RADIO_TYPE_ATHEROS;
+      sprintf(pRadioInfo->szName, "sim%d", i);
+      strcpy(pRadioInfo->szDescription, "Simulated radio");
+      strcpy(pRadioInfo->szDriver, "sim");
+      sprintf(pRadioInfo->szMAC, "00:00:00:00:00:%02X", i+1);
+      sprintf(pRadioInfo->szUSBPort, "S%d", i+1);
+      pRadioInfo->runtimeInterfaceInfoRx.selectable_fd = -1;
+      pRadioInfo->runtimeInterfaceInfoTx.selectable_fd = -1;
+      s_iHwRadiosCount++;
+      s_iHwRadiosSupportedCount++;
+   }
+   s_HardwareRadiosEnumeratedOnce = 1;
+   log_line("[HW-R] Using %d simulated radio interfaces.", iCount);
+   return 1;
+}
+
 int hardware_get_radio_index_by_name(const char* szName)
 {
    if ( ! s_HardwareRadiosEnumeratedOnce )
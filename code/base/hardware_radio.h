@@ -218,6 +218,8 @@ int hardware_get_radio_interfaces_count();
 int hardware_get_supported_radio_interfaces_count();
 radio_hw_info_t* hardware_get_radio_info_array();
 int hardware_add_radio_interface_info(radio_hw_info_t* pRadioInfo);
+// Replaces the radio interfaces with iCount wifi interfaces (named simN) without enumerating the hardware, to be used with the radio link simulator
+int hardware_radio_set_simulated_interfaces(int iCount);
 int hardware_get_radio_index_by_name(const char* szName);
 int hardware_get_radio_index_from_mac(const char* szMAC);
 int hardware_radio_has_low_capacity_links();
@@ -0,0 +1,672 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "base.h"
+#include "hardware_radio_netlink.h"
+#include "hardware_procs.h"
+
+#include <pthread.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/nl80211.h>
+
+#define RADIO_NETLINK_BUFFER_SIZE 8192
+#define RADIO_NETLINK_RECV_TIMEOUT_MS 1000
+
+static pthread_mutex_t s_MutexRadioNetlink = PTHREAD_MUTEX_INITIALIZER;
+static int s_iRadioNetlinkSocketGeneric = -1;
+static int s_iRadioNetlinkSocketRoute = -1;
+static int s_iRadioNetlinkFamilyId = -1;
+static int s_iRadioNetlinkInitFailed = 0;
+static int s_iRadioNetlinkLastError = 0;
+static u32 s_uRadioNetlinkSequence = 0;
+
+// Called for each reply message (not for acks and errors)
+typedef void (*radio_netlink_callback_t)(struct nlmsghdr* pNLH, void* pContext);
+
+typedef struct
+{
+   u8 uBuffer[RADIO_NETLINK_BUFFER_SIZE] __attribute__((aligned(4)));
+   int iLength;
+} type_radio_netlink_msg;
+
+static struct nlmsghdr* _netlink_msg_init(type_radio_netlink_msg* pMsg, u16 uType, u16 uFlags)
+{
+   memset(pMsg->uBuffer, 0, NLMSG_HDRLEN);
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)pMsg->uBuffer;
+   pNLH->nlmsg_type = uType;
+   pNLH->nlmsg_flags = uFlags;
+   pNLH->nlmsg_seq = ++s_uRadioNetlinkSequence;
+   pMsg->iLength = NLMSG_HDRLEN;
+   return pNLH;
+}
+
+static void* _netlink_msg_reserve(type_radio_netlink_msg* pMsg, int iSize)
+{
+   int iAligned = NLMSG_ALIGN(iSize);
+   if ( pMsg->iLength + iAligned > RADIO_NETLINK_BUFFER_SIZE )
+      return NULL;
+   void* pData = pMsg->uBuffer + pMsg->iLength;
+   memset(pData, 0, iAligned);
+   pMsg->iLength += iAligned;
+   return pData;
+}
+
+static void _netlink_msg_init_genl(type_radio_netlink_msg* pMsg, u16 uFamily, u8 uCommand, u16 uFlags)
+{
+   _netlink_msg_init(pMsg, uFamily, uFlags);
+   struct genlmsghdr* pGenl = (struct genlmsghdr*)_netlink_msg_reserve(pMsg, GENL_HDRLEN);
+   pGenl->cmd = uCommand;
+   pGenl->version = 1;
+}
+
+static int _netlink_put_attr(type_radio_netlink_msg* pMsg, u16 uType, const void* pData, int iSize)
+{
+   if ( pMsg->iLength + NLA_ALIGN(NLA_HDRLEN + iSize) > RADIO_NETLINK_BUFFER_SIZE )
+      return 0;
+   struct nlattr* pAttr = (struct nlattr*)(pMsg->uBuffer + pMsg->iLength);
+   pAttr->nla_type = uType;
+   pAttr->nla_len = NLA_HDRLEN + iSize;
+   if ( iSize > 0 )
+      memcpy((u8*)pAttr + NLA_HDRLEN, pData, iSize);
+   memset((u8*)pAttr + NLA_HDRLEN + iSize, 0, NLA_ALIGN(pAttr->nla_len) - pAttr->nla_len);
+   pMsg->iLength += NLA_ALIGN(pAttr->nla_len);
+   return 1;
+}
+
+static int _netlink_put_u32(type_radio_netlink_msg* pMsg, u16 uType, u32 uValue)
+{
+   return _netlink_put_attr(pMsg, uType, &uValue, sizeof(u32));
+}
+
+// Returns the offset of the nested attribute, to close it with _netlink_nest_end
+static int _netlink_nest_start(type_radio_netlink_msg* pMsg, u16 uType)
+{
+   int iOffset = pMsg->iLength;
+   if ( ! _netlink_put_attr(pMsg, uType | NLA_F_NESTED, NULL, 0) )
+      return -1;
+   return iOffset;
+}
+
+static void _netlink_nest_end(type_radio_netlink_msg* pMsg, int iOffset)
+{
+   if ( iOffset < 0 )
+      return;
+   struct nlattr* pAttr = (struct nlattr*)(pMsg->uBuffer + iOffset);
+   pAttr->nla_len = pMsg->iLength - iOffset;
+}
+
+// Splits the attributes stream in the table indexed by attribute type
+static void _netlink_parse_attrs(struct nlattr** pTable, int iMaxType, u8* pData, int iLength)
+{
+   memset(pTable, 0, sizeof(struct nlattr*) * (iMaxType+1));
+   while ( iLength >= NLA_HDRLEN )
+   {
+      struct nlattr* pAttr = (struct nlattr*)pData;
+      if ( (pAttr->nla_len < NLA_HDRLEN) || (pAttr->nla_len > iLength) )
+         break;
+      int iType = pAttr->nla_type & NLA_TYPE_MASK;
+      if ( iType <= iMaxType )
+         pTable[iType] = pAttr;
+      int iAligned = NLA_ALIGN(pAttr->nla_len);
+      pData += iAligned;
+      iLength -= iAligned;
+   }
+}
+
+static u8* _netlink_attr_data(struct nlattr* pAttr)
+{
+   return (u8*)pAttr + NLA_HDRLEN;
+}
+
+static int _netlink_attr_length(struct nlattr* pAttr)
+{
+   return pAttr->nla_len - NLA_HDRLEN;
+}
+
+static u32 _netlink_attr_u32(struct nlattr* pAttr)
+{
+   u32 uValue = 0;
+   if ( _netlink_attr_length(pAttr) >= (int)sizeof(u32) )
+      memcpy(&uValue, _netlink_attr_data(pAttr), sizeof(u32));
+   return uValue;
+}
+
+static int _netlink_open_socket(int iProtocol)
+{
+   int iSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, iProtocol);
+   if ( iSocket < 0 )
+      return -1;
+
+   struct sockaddr_nl addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.nl_family = AF_NETLINK;
+   if ( 0 != bind(iSocket, (struct sockaddr*)&addr, sizeof(addr)) )
+   {
+      close(iSocket);
+      return -1;
+   }
+   struct timeval tv;
+   tv.tv_sec = RADIO_NETLINK_RECV_TIMEOUT_MS/1000;
+   tv.tv_usec = (RADIO_NETLINK_RECV_TIMEOUT_MS%1000)*1000;
+   setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+   int iExtAck = 1;
+   setsockopt(iSocket, SOL_NETLINK, NETLINK_EXT_ACK, &iExtAck, sizeof(iExtAck));
+   return iSocket;
+}
+
+// Sends the request and reads the replies until the ack (or the end of the dump).
+// Returns 0 on success or the negative errno.
+static int _netlink_transact(int iSocket, type_radio_netlink_msg* pMsg, radio_netlink_callback_t pCallback, void* pContext)
+{
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)pMsg->uBuffer;
+   pNLH->nlmsg_len = pMsg->iLength;
+   u32 uSequence = pNLH->nlmsg_seq;
+
+   struct sockaddr_nl addrKernel;
+   memset(&addrKernel, 0, sizeof(addrKernel));
+   addrKernel.nl_family = AF_NETLINK;
+
+   if ( sendto(iSocket, pMsg->uBuffer, pMsg->iLength, 0, (struct sockaddr*)&addrKernel, sizeof(addrKernel)) < 0 )
+      return -errno;
+
+   static u8 s_uBufferRecv[32*1024] __attribute__((aligned(4)));
+   while ( 1 )
+   {
+      int iLength = recv(iSocket, s_uBufferRecv, sizeof(s_uBufferRecv), 0);
+      if ( iLength < 0 )
+      {
+         if ( errno == EINTR )
+            continue;
+         return -errno;
+      }
+      if ( 0 == iLength )
+         return -EIO;
+
+      for( struct nlmsghdr* pReply = (struct nlmsghdr*)s_uBufferRecv; NLMSG_OK(pReply, (u32)iLength); pReply = NLMSG_NEXT(pReply, iLength) )
+      {
+         // Replies to an older request that timed out
+         if ( pReply->nlmsg_seq != uSequence )
+            continue;
+         if ( pReply->nlmsg_type == NLMSG_DONE )
+            return 0;
+         if ( pReply->nlmsg_type == NLMSG_ERROR )
+         {
+            struct nlmsgerr* pError = (struct nlmsgerr*)NLMSG_DATA(pReply);
+            return pError->error;
+         }
+         if ( NULL != pCallback )
+            pCallback(pReply, pContext);
+         if ( ! (pReply->nlmsg_flags & NLM_F_MULTI) )
+         if ( ! (pNLH->nlmsg_flags & NLM_F_ACK) )
+            return 0;
+      }
+   }
+   return 0;
+}
+
+static void _netlink_family_callback(struct nlmsghdr* pNLH, void* pContext)
+{
+   struct nlattr* pAttrs[CTRL_ATTR_MAX+1];
+   u8* pData = (u8*)NLMSG_DATA(pNLH) + GENL_HDRLEN;
+   _netlink_parse_attrs(pAttrs, CTRL_ATTR_MAX, pData, (int)pNLH->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN);
+   if ( NULL != pAttrs[CTRL_ATTR_FAMILY_ID] )
+   {
+      u16 uId = 0;
+      memcpy(&uId, _netlink_attr_data(pAttrs[CTRL_ATTR_FAMILY_ID]), sizeof(u16));
+      *((int*)pContext) = uId;
+   }
+}
+
+// Must be called with the mutex locked
+static int _netlink_check_init()
+{
+   if ( s_iRadioNetlinkFamilyId > 0 )
+      return 1;
+   if ( s_iRadioNetlinkInitFailed )
+      return 0;
+
+   s_iRadioNetlinkSocketRoute = _netlink_open_socket(NETLINK_ROUTE);
+   s_iRadioNetlinkSocketGeneric = _netlink_open_socket(NETLINK_GENERIC);
+   if ( s_iRadioNetlinkSocketGeneric >= 0 )
+   {
+      type_radio_netlink_msg msg;
+      _netlink_msg_init_genl(&msg, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, NLM_F_REQUEST | NLM_F_ACK);
+      _netlink_put_attr(&msg, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME, strlen(NL80211_GENL_NAME)+1);
+      int iFamilyId = -1;
+      s_iRadioNetlinkLastError = _netlink_transact(s_iRadioNetlinkSocketGeneric, &msg, _netlink_family_callback, &iFamilyId);
+      if ( (0 == s_iRadioNetlinkLastError) && (iFamilyId > 0) )
+         s_iRadioNetlinkFamilyId = iFamilyId;
+   }
+
+   if ( s_iRadioNetlinkFamilyId > 0 )
+   {
+      log_line("[HW-R] Netlink: nl80211 available (family id %d), radio interfaces are configured using netlink.", s_iRadioNetlinkFamilyId);
+      return 1;
+   }
+   // Don't retry on each call: cfg80211 is loaded with the radio drivers, before we get here
+   s_iRadioNetlinkInitFailed = 1;
+   log_line("[HW-R] Netlink: nl80211 not available (error %d), using iw commands.", s_iRadioNetlinkLastError);
+   return 0;
+}
+
+int hardware_radio_netlink_init()
+{
+   pthread_mutex_lock(&s_MutexRadioNetlink);
+   int iResult = _netlink_check_init();
+   pthread_mutex_unlock(&s_MutexRadioNetlink);
+   return iResult;
+}
+
+void hardware_radio_netlink_close()
+{
+   pthread_mutex_lock(&s_MutexRadioNetlink);
+   if ( s_iRadioNetlinkSocketGeneric >= 0 )
+      close(s_iRadioNetlinkSocketGeneric);
+   if ( s_iRadioNetlinkSocketRoute >= 0 )
+      close(s_iRadioNetlinkSocketRoute);
+   s_iRadioNetlinkSocketGeneric = -1;
+   s_iRadioNetlinkSocketRoute = -1;
+   s_iRadioNetlinkFamilyId = -1;
+   s_iRadioNetlinkInitFailed = 0;
+   pthread_mutex_unlock(&s_MutexRadioNetlink);
+}
+
+int hardware_radio_netlink_get_last_error()
+{
+   return s_iRadioNetlinkLastError;
+}
+
+// Builds a nl80211 command for the interface. Returns 0 if nl80211 is not available or the interface does not exist.
+// Leaves the mutex locked on success.
+static int _netlink_start_nl80211_command(type_radio_netlink_msg* pMsg, const char* szInterface, u8 uCommand)
+{
+   pthread_mutex_lock(&s_MutexRadioNetlink);
+   if ( ! _netlink_check_init() )
+   {
+      pthread_mutex_unlock(&s_MutexRadioNetlink);
+      return 0;
+   }
+   int iIfIndex = (NULL == szInterface)?0:(int)if_nametoindex(szInterface);
+   if ( (NULL != szInterface) && (0 == iIfIndex) )
+   {
+      s_iRadioNetlinkLastError = -ENODEV;
+      pthread_mutex_unlock(&s_MutexRadioNetlink);
+      return 0;
+   }
+   _netlink_msg_init_genl(pMsg, (u16)s_iRadioNetlinkFamilyId, uCommand, NLM_F_REQUEST | NLM_F_ACK);
+   if ( NULL != szInterface )
+      _netlink_put_u32(pMsg, NL80211_ATTR_IFINDEX, (u32)iIfIndex);
+   return 1;
+}
+
+// Sends the command and unlocks the mutex
+static int _netlink_end_nl80211_command(type_radio_netlink_msg* pMsg, radio_netlink_callback_t pCallback, void* pContext)
+{
+   s_iRadioNetlinkLastError = _netlink_transact(s_iRadioNetlinkSocketGeneric, pMsg, pCallback, pContext);
+   int iResult = (0 == s_iRadioNetlinkLastError)?1:0;
+   pthread_mutex_unlock(&s_MutexRadioNetlink);
+   return iResult;
+}
+
+int hardware_radio_netlink_set_frequency(const char* szInterface, u32 uFrequencyMhz, int iHTMode)
+{
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, szInterface, NL80211_CMD_SET_WIPHY) )
+      return 0;
+   u32 uChannelType = NL80211_CHAN_NO_HT;
+   if ( iHTMode == RADIO_NETLINK_HT20 )
+      uChannelType = NL80211_CHAN_HT20;
+   else if ( iHTMode == RADIO_NETLINK_HT40_MINUS )
+      uChannelType = NL80211_CHAN_HT40MINUS;
+   else if ( iHTMode == RADIO_NETLINK_HT40_PLUS )
+      uChannelType = NL80211_CHAN_HT40PLUS;
+   _netlink_put_u32(&msg, NL80211_ATTR_WIPHY_FREQ, uFrequencyMhz);
+   _netlink_put_u32(&msg, NL80211_ATTR_WIPHY_CHANNEL_TYPE, uChannelType);
+   return _netlink_end_nl80211_command(&msg, NULL, NULL);
+}
+
+int hardware_radio_netlink_set_interface_type(const char* szInterface, u32 uIfType)
+{
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, szInterface, NL80211_CMD_SET_INTERFACE) )
+      return 0;
+   _netlink_put_u32(&msg, NL80211_ATTR_IFTYPE, uIfType);
+   return _netlink_end_nl80211_command(&msg, NULL, NULL);
+}
+
+int hardware_radio_netlink_set_monitor_flags(const char* szInterface, u32 uFlags)
+{
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, szInterface, NL80211_CMD_SET_INTERFACE) )
+      return 0;
+   _netlink_put_u32(&msg, NL80211_ATTR_IFTYPE, NL80211_IFTYPE_MONITOR);
+   // Empty nested attribute means no flags (same as "iw set monitor none")
+   int iNest = _netlink_nest_start(&msg, NL80211_ATTR_MNTR_FLAGS);
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_FCSFAIL )
+      _netlink_put_attr(&msg, NL80211_MNTR_FLAG_FCSFAIL, NULL, 0);
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_PLCPFAIL )
+      _netlink_put_attr(&msg, NL80211_MNTR_FLAG_PLCPFAIL, NULL, 0);
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_CONTROL )
+      _netlink_put_attr(&msg, NL80211_MNTR_FLAG_CONTROL, NULL, 0);
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_OTHER_BSS )
+      _netlink_put_attr(&msg, NL80211_MNTR_FLAG_OTHER_BSS, NULL, 0);
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_COOK_FRAMES )
+      _netlink_put_attr(&msg, NL80211_MNTR_FLAG_COOK_FRAMES, NULL, 0);
+   _netlink_nest_end(&msg, iNest);
+   return _netlink_end_nl80211_command(&msg, NULL, NULL);
+}
+
+int hardware_radio_netlink_set_txpower_fixed(const char* szInterface, int iTxPowerMBm)
+{
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, szInterface, NL80211_CMD_SET_WIPHY) )
+      return 0;
+   _netlink_put_u32(&msg, NL80211_ATTR_WIPHY_TX_POWER_SETTING, NL80211_TX_POWER_FIXED);
+   _netlink_put_u32(&msg, NL80211_ATTR_WIPHY_TX_POWER_LEVEL, (u32)iTxPowerMBm);
+   return _netlink_end_nl80211_command(&msg, NULL, NULL);
+}
+
+// rtnetlink RTM_NEWLINK on an existing link: flags and/or MTU
+static int _netlink_set_link(const char* szInterface, int iUp, int iMTU)
+{
+   int iIfIndex = (int)if_nametoindex(szInterface);
+   pthread_mutex_lock(&s_MutexRadioNetlink);
+   if ( s_iRadioNetlinkSocketRoute < 0 )
+      s_iRadioNetlinkSocketRoute = _netlink_open_socket(NETLINK_ROUTE);
+   if ( (s_iRadioNetlinkSocketRoute < 0) || (0 == iIfIndex) )
+   {
+      s_iRadioNetlinkLastError = (0 == iIfIndex)?-ENODEV:-EPROTONOSUPPORT;
+      pthread_mutex_unlock(&s_MutexRadioNetlink);
+      return 0;
+   }
+   type_radio_netlink_msg msg;
+   _netlink_msg_init(&msg, RTM_NEWLINK, NLM_F_REQUEST | NLM_F_ACK);
+   struct ifinfomsg* pInfo = (struct ifinfomsg*)_netlink_msg_reserve(&msg, sizeof(struct ifinfomsg));
+   pInfo->ifi_family = AF_UNSPEC;
+   pInfo->ifi_index = iIfIndex;
+   if ( iUp >= 0 )
+   {
+      pInfo->ifi_change = IFF_UP;
+      pInfo->ifi_flags = iUp?IFF_UP:0;
+   }
+   if ( iMTU > 0 )
+      _netlink_put_u32(&msg, IFLA_MTU, (u32)iMTU);
+   s_iRadioNetlinkLastError = _netlink_transact(s_iRadioNetlinkSocketRoute, &msg, NULL, NULL);
+   int iResult = (0 == s_iRadioNetlinkLastError)?1:0;
+   pthread_mutex_unlock(&s_MutexRadioNetlink);
+   return iResult;
+}
+
+int hardware_radio_netlink_set_link_up(const char* szInterface, int iUp)
+{
+   return _netlink_set_link(szInterface, iUp?1:0, 0);
+}
+
+int hardware_radio_netlink_set_mtu(const char* szInterface, int iMTU)
+{
+   return _netlink_set_link(szInterface, -1, iMTU);
+}
+
+typedef struct
+{
+   type_radio_netlink_interface* pInterfaces;
+   int iMaxInterfaces;
+   int iCount;
+} type_radio_netlink_interfaces_context;
+
+static void _netlink_interface_callback(struct nlmsghdr* pNLH, void* pContext)
+{
+   type_radio_netlink_interfaces_context* pCtx = (type_radio_netlink_interfaces_context*)pContext;
+   if ( pCtx->iCount >= pCtx->iMaxInterfaces )
+      return;
+   struct nlattr* pAttrs[NL80211_ATTR_MAX+1];
+   u8* pData = (u8*)NLMSG_DATA(pNLH) + GENL_HDRLEN;
+   _netlink_parse_attrs(pAttrs, NL80211_ATTR_MAX, pData, (int)pNLH->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN);
+   if ( (NULL == pAttrs[NL80211_ATTR_IFINDEX]) || (NULL == pAttrs[NL80211_ATTR_IFNAME]) )
+      return;
+
+   type_radio_netlink_interface* pInterface = &(pCtx->pInterfaces[pCtx->iCount]);
+   memset(pInterface, 0, sizeof(type_radio_netlink_interface));
+   pInterface->iIfIndex = (int)_netlink_attr_u32(pAttrs[NL80211_ATTR_IFINDEX]);
+   int iLen = _netlink_attr_length(pAttrs[NL80211_ATTR_IFNAME]);
+   if ( iLen > (int)sizeof(pInterface->szName)-1 )
+      iLen = (int)sizeof(pInterface->szName)-1;
+   memcpy(pInterface->szName, _netlink_attr_data(pAttrs[NL80211_ATTR_IFNAME]), iLen);
+   pInterface->szName[iLen] = 0;
+   pInterface->iPhyIndex = -1;
+   if ( NULL != pAttrs[NL80211_ATTR_WIPHY] )
+      pInterface->iPhyIndex = (int)_netlink_attr_u32(pAttrs[NL80211_ATTR_WIPHY]);
+   if ( NULL != pAttrs[NL80211_ATTR_IFTYPE] )
+      pInterface->uIfType = _netlink_attr_u32(pAttrs[NL80211_ATTR_IFTYPE]);
+   if ( NULL != pAttrs[NL80211_ATTR_WIPHY_FREQ] )
+      pInterface->uFrequencyMhz = _netlink_attr_u32(pAttrs[NL80211_ATTR_WIPHY_FREQ]);
+   if ( (NULL != pAttrs[NL80211_ATTR_MAC]) && (_netlink_attr_length(pAttrs[NL80211_ATTR_MAC]) >= 6) )
+   {
+      memcpy(pInterface->uMAC, _netlink_attr_data(pAttrs[NL80211_ATTR_MAC]), 6);
+      pInterface->iHasMAC = 1;
+   }
+   pCtx->iCount++;
+}
+
+int hardware_radio_netlink_get_interfaces(type_radio_netlink_interface* pInterfaces, int iMaxInterfaces)
+{
+   if ( (NULL == pInterfaces) || (iMaxInterfaces <= 0) )
+      return -1;
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, NULL, NL80211_CMD_GET_INTERFACE) )
+      return -1;
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)msg.uBuffer;
+   pNLH->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+
+   type_radio_netlink_interfaces_context ctx;
+   ctx.pInterfaces = pInterfaces;
+   ctx.iMaxInterfaces = iMaxInterfaces;
+   ctx.iCount = 0;
+   if ( ! _netlink_end_nl80211_command(&msg, _netlink_interface_callback, &ctx) )
+      return -1;
+   return ctx.iCount;
+}
+
+int hardware_radio_netlink_get_interface(const char* szInterface, type_radio_netlink_interface* pInterface)
+{
+   if ( NULL == pInterface )
+      return 0;
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, szInterface, NL80211_CMD_GET_INTERFACE) )
+      return 0;
+   type_radio_netlink_interfaces_context ctx;
+   ctx.pInterfaces = pInterface;
+   ctx.iMaxInterfaces = 1;
+   ctx.iCount = 0;
+   if ( ! _netlink_end_nl80211_command(&msg, _netlink_interface_callback, &ctx) )
+      return 0;
+   return (1 == ctx.iCount)?1:0;
+}
+
+typedef struct
+{
+   int iPhyIndex;
+   u32* pFrequencies;
+   int iMaxFrequencies;
+   int iCount;
+} type_radio_netlink_phy_context;
+
+// Split dump: the bands and frequencies of a phy can come in several messages
+static void _netlink_phy_callback(struct nlmsghdr* pNLH, void* pContext)
+{
+   type_radio_netlink_phy_context* pCtx = (type_radio_netlink_phy_context*)pContext;
+   struct nlattr* pAttrs[NL80211_ATTR_MAX+1];
+   u8* pData = (u8*)NLMSG_DATA(pNLH) + GENL_HDRLEN;
+   _netlink_parse_attrs(pAttrs, NL80211_ATTR_MAX, pData, (int)pNLH->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN);
+   if ( (NULL == pAttrs[NL80211_ATTR_WIPHY]) || (NULL == pAttrs[NL80211_ATTR_WIPHY_BANDS]) )
+      return;
+   if ( (int)_netlink_attr_u32(pAttrs[NL80211_ATTR_WIPHY]) != pCtx->iPhyIndex )
+      return;
+
+   u8* pBand = _netlink_attr_data(pAttrs[NL80211_ATTR_WIPHY_BANDS]);
+   int iBandsLength = _netlink_attr_length(pAttrs[NL80211_ATTR_WIPHY_BANDS]);
+   while ( iBandsLength >= NLA_HDRLEN )
+   {
+      struct nlattr* pBandAttr = (struct nlattr*)pBand;
+      if ( (pBandAttr->nla_len < NLA_HDRLEN) || (pBandAttr->nla_len > iBandsLength) )
+         break;
+      struct nlattr* pBandAttrs[NL80211_BAND_ATTR_MAX+1];
+      _netlink_parse_attrs(pBandAttrs, NL80211_BAND_ATTR_MAX, _netlink_attr_data(pBandAttr), _netlink_attr_length(pBandAttr));
+      if ( NULL != pBandAttrs[NL80211_BAND_ATTR_FREQS] )
+      {
+         u8* pFreq = _netlink_attr_data(pBandAttrs[NL80211_BAND_ATTR_FREQS]);
+         int iFreqsLength = _netlink_attr_length(pBandAttrs[NL80211_BAND_ATTR_FREQS]);
+         while ( iFreqsLength >= NLA_HDRLEN )
+         {
+            struct nlattr* pFreqAttr = (struct nlattr*)pFreq;
+            if ( (pFreqAttr->nla_len < NLA_HDRLEN) || (pFreqAttr->nla_len > iFreqsLength) )
+               break;
+            struct nlattr* pFreqAttrs[NL80211_FREQUENCY_ATTR_MAX+1];
+            _netlink_parse_attrs(pFreqAttrs, NL80211_FREQUENCY_ATTR_MAX, _netlink_attr_data(pFreqAttr), _netlink_attr_length(pFreqAttr));
+            if ( (NULL != pFreqAttrs[NL80211_FREQUENCY_ATTR_FREQ]) && (pCtx->iCount < pCtx->iMaxFrequencies) )
+               pCtx->pFrequencies[pCtx->iCount++] = _netlink_attr_u32(pFreqAttrs[NL80211_FREQUENCY_ATTR_FREQ]);
+            pFreq += NLA_ALIGN(pFreqAttr->nla_len);
+            iFreqsLength -= NLA_ALIGN(pFreqAttr->nla_len);
+         }
+      }
+      pBand += NLA_ALIGN(pBandAttr->nla_len);
+      iBandsLength -= NLA_ALIGN(pBandAttr->nla_len);
+   }
+}
+
+int hardware_radio_netlink_get_phy_frequencies(int iPhyIndex, u32* pFrequencies, int iMaxFrequencies)
+{
+   if ( (NULL == pFrequencies) || (iMaxFrequencies <= 0) )
+      return -1;
+   type_radio_netlink_msg msg;
+   if ( ! _netlink_start_nl80211_command(&msg, NULL, NL80211_CMD_GET_WIPHY) )
+      return -1;
+   struct nlmsghdr* pNLH = (struct nlmsghdr*)msg.uBuffer;
+   pNLH->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+   _netlink_put_u32(&msg, NL80211_ATTR_WIPHY, (u32)iPhyIndex);
+   _netlink_put_attr(&msg, NL80211_ATTR_SPLIT_WIPHY_DUMP, NULL, 0);
+
+   type_radio_netlink_phy_context ctx;
+   ctx.iPhyIndex = iPhyIndex;
+   ctx.pFrequencies = pFrequencies;
+   ctx.iMaxFrequencies = iMaxFrequencies;
+   ctx.iCount = 0;
+   if ( ! _netlink_end_nl80211_command(&msg, _netlink_phy_callback, &ctx) )
+      return -1;
+   return ctx.iCount;
+}
+
+//-----------------------------------------------------
+// Netlink first, iw/ip commands as fallback
+
+static int _radio_netlink_result(int iResult, const char* szOperation, const char* szInterface, char* szOutput)
+{
+   if ( NULL != szOutput )
+      szOutput[0] = 0;
+   if ( iResult )
+      return 1;
+   if ( s_iRadioNetlinkFamilyId > 0 )
+      log_softerror_and_alarm("[HW-R] Netlink: failed to %s on %s, error: %d (%s). Using iw/ip command.", szOperation, szInterface, s_iRadioNetlinkLastError, strerror(-s_iRadioNetlinkLastError));
+   return 0;
+}
+
+int hardware_radio_set_link_up(const char* szInterface, int iUp, char* szOutput)
+{
+   if ( _radio_netlink_result(hardware_radio_netlink_set_link_up(szInterface, iUp), iUp?"set link up":"set link down", szInterface, szOutput) )
+      return 1;
+   char szComm[128];
+   snprintf(szComm, sizeof(szComm), "ip link set dev %s %s", szInterface, iUp?"up":"down");
+   return hw_execute_bash_command(szComm, szOutput);
+}
+
+int hardware_radio_set_mtu(const char* szInterface, int iMTU, char* szOutput)
+{
+   if ( _radio_netlink_result(hardware_radio_netlink_set_mtu(szInterface, iMTU), "set MTU", szInterface, szOutput) )
+      return 1;
+   char szComm[128];
+   snprintf(szComm, sizeof(szComm), "ip link set dev %s mtu %d", szInterface, iMTU);
+   return hw_execute_bash_command(szComm, szOutput);
+}
+
+int hardware_radio_set_type_monitor(const char* szInterface, char* szOutput)
+{
+   if ( _radio_netlink_result(hardware_radio_netlink_set_interface_type(szInterface, NL80211_IFTYPE_MONITOR), "set type monitor", szInterface, szOutput) )
+      return 1;
+   char szComm[128];
+   snprintf(szComm, sizeof(szComm), "iw dev %s set type monitor", szInterface);
+   return hw_execute_bash_command(szComm, szOutput);
+}
+
+int hardware_radio_set_type_managed(const char* szInterface, char* szOutput)
+{
+   if ( _radio_netlink_result(hardware_radio_netlink_set_interface_type(szInterface, NL80211_IFTYPE_STATION), "set type managed", szInterface, szOutput) )
+      return 1;
+   char szComm[128];
+   snprintf(szComm, sizeof(szComm), "iw dev %s set type managed", szInterface);
+   return hw_execute_bash_command(szComm, szOutput);
+}
+
+int hardware_radio_set_monitor_flags(const char* szInterface, u32 uFlags, char* szOutput)
+{
+   if ( _radio_netlink_result(hardware_radio_netlink_set_monitor_flags(szInterface, uFlags), "set monitor flags", szInterface, szOutput) )
+      return 1;
+   char szFlags[128];
+   szFlags[0] = 0;
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_FCSFAIL )
+      strcat(szFlags, " fcsfail");
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_PLCPFAIL )
+      strcat(szFlags, " plcpfail");
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_CONTROL )
+      strcat(szFlags, " control");
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_OTHER_BSS )
+      strcat(szFlags, " otherbss");
+   if ( uFlags & RADIO_NETLINK_MONITOR_FLAG_COOK_FRAMES )
+      strcat(szFlags, " cook");
+   if ( 0 == szFlags[0] )
+      strcpy(szFlags, " none");
+   char szComm[256];
+   snprintf(szComm, sizeof(szComm), "iw dev %s set monitor%s", szInterface, szFlags);
+   return hw_execute_bash_command(szComm, szOutput);
+}
+
+int hardware_radio_set_txpower_fixed(const char* szInterface, int iTxPowerMBm, char* szOutput)
+{
+   if ( _radio_netlink_result(hardware_radio_netlink_set_txpower_fixed(szInterface, iTxPowerMBm), "set tx power", szInterface, szOutput) )
+      return 1;
+   char szComm[128];
+   snprintf(szComm, sizeof(szComm), "iw dev %s set txpower fixed %d", szInterface, iTxPowerMBm);
+   return hw_execute_bash_command(szComm, szOutput);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "base.h"
+
+// In process netlink client (no libnl) for the radio interfaces: nl80211 (generic netlink) for
+// frequency, interface type, monitor flags, tx power and phys/interfaces info; rtnetlink for link
+// up/down and MTU. Saves the fork+exec of an iw/ip command on each operation.
+// The hardware_radio_set_* helpers use netlink when available and fall back to the iw/ip commands.
+
+#define RADIO_NETLINK_HT_NONE 0
+#define RADIO_NETLINK_HT20 1
+#define RADIO_NETLINK_HT40_MINUS 2
+#define RADIO_NETLINK_HT40_PLUS 3
+
+#define RADIO_NETLINK_MONITOR_FLAG_FCSFAIL 0x01
+#define RADIO_NETLINK_MONITOR_FLAG_PLCPFAIL 0x02
+#define RADIO_NETLINK_MONITOR_FLAG_CONTROL 0x04
+#define RADIO_NETLINK_MONITOR_FLAG_OTHER_BSS 0x08
+#define RADIO_NETLINK_MONITOR_FLAG_COOK_FRAMES 0x10
+
+#define RADIO_NETLINK_MAX_INTERFACES 16
+#define RADIO_NETLINK_MAX_PHY_FREQUENCIES 128
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   int iIfIndex;
+   int iPhyIndex;
+   u32 uIfType; // NL80211_IFTYPE_*
+   u32 uFrequencyMhz; // 0 if not known
+   int iHasMAC;
+   u8  uMAC[6];
+   char szName[32];
+} type_radio_netlink_interface;
+
+// Returns 1 if nl80211 is available (opens the netlink sockets on first use)
+int hardware_radio_netlink_init();
+void hardware_radio_netlink_close();
+// Last error (negative errno) returned by the kernel or by the socket calls
+int hardware_radio_netlink_get_last_error();
+
+// All return 1 on success, 0 on failure
+int hardware_radio_netlink_set_frequency(const char* szInterface, u32 uFrequencyMhz, int iHTMode);
+int hardware_radio_netlink_set_interface_type(const char* szInterface, u32 uIfType);
+int hardware_radio_netlink_set_monitor_flags(const char* szInterface, u32 uFlags);
+// iTxPowerMBm: in mBm (1/100 dBm), negative values are accepted (some drivers use them as raw power index)
+int hardware_radio_netlink_set_txpower_fixed(const char* szInterface, int iTxPowerMBm);
+int hardware_radio_netlink_set_link_up(const char* szInterface, int iUp);
+int hardware_radio_netlink_set_mtu(const char* szInterface, int iMTU);
+
+// Returns the number of nl80211 interfaces found, -1 on failure
+int hardware_radio_netlink_get_interfaces(type_radio_netlink_interface* pInterfaces, int iMaxInterfaces);
+int hardware_radio_netlink_get_interface(const char* szInterface, type_radio_netlink_interface* pInterface);
+// Returns the number of frequencies (MHz) supported by the phy, -1 on failure
+int hardware_radio_netlink_get_phy_frequencies(int iPhyIndex, u32* pFrequencies, int iMaxFrequencies);
+
+// Netlink first, iw/ip commands if netlink is not available or failed.
+// szOutput (optional): the output of the fallback command, empty when netlink was used.
+int hardware_radio_set_link_up(const char* szInterface, int iUp, char* szOutput);
+int hardware_radio_set_mtu(const char* szInterface, int iMTU, char* szOutput);
+int hardware_radio_set_type_monitor(const char* szInterface, char* szOutput);
+int hardware_radio_set_type_managed(const char* szInterface, char* szOutput);
+// uFlags: RADIO_NETLINK_MONITOR_FLAG_*, 0 for none
+int hardware_radio_set_monitor_flags(const char* szInterface, u32 uFlags, char* szOutput);
+int hardware_radio_set_txpower_fixed(const char* szInterface, int iTxPowerMBm, char* szOutput);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,221 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/mman.h>
+#include <time.h>
+#include "base.h"
+#include "shared_mem.h"
+#include "latency_trace.h"
+
+#define LATENCY_TRACE_VERSION 1
+
+static type_latency_trace_stats* s_pLatencyTraceStats = NULL;
+
+static const char* s_szLatencyTraceStageNames[LATENCY_TRACE_STAGES] =
+{
+   "capture",
+   "fec-block",
+   "radio-tx",
+   "radio-rx",
+   "block-done",
+   "output"
+};
+
+u64 latency_trace_get_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)(t.tv_nsec/1000);
+}
+
+int latency_trace_get_bucket(u32 uMicros)
+{
+   if ( uMicros < LATENCY_TRACE_SUB_BUCKETS )
+      return (int)uMicros;
+   if ( uMicros >= (((u32)1) << LATENCY_TRACE_MAX_POW2) )
+      return LATENCY_TRACE_BUCKETS - 1;
+
+   int iPow2 = 31 - __builtin_clz(uMicros);
+   int iShift = iPow2 - LATENCY_TRACE_SUB_BUCKETS_BITS;
+   return (iShift + 1) * LATENCY_TRACE_SUB_BUCKETS + (int)((uMicros >> iShift) & (LATENCY_TRACE_SUB_BUCKETS-1));
+}
+
+u32 latency_trace_get_bucket_max_micros(int iBucket)
+{
+   if ( iBucket < LATENCY_TRACE_SUB_BUCKETS )
+      return (u32)((iBucket < 0)?0:iBucket);
+   if ( iBucket >= LATENCY_TRACE_BUCKETS - 1 )
+      return 0xFFFFFFFF;
+
+   int iShift = iBucket / LATENCY_TRACE_SUB_BUCKETS - 1;
+   u32 uMin = ((u32)(LATENCY_TRACE_SUB_BUCKETS + (iBucket % LATENCY_TRACE_SUB_BUCKETS))) << iShift;
+   return uMin + (((u32)1) << iShift) - 1;
+}
+
+const char* latency_trace_get_stage_name(int iStage)
+{
+   if ( (iStage < 0) || (iStage >= LATENCY_TRACE_STAGES) )
+      return "unknown";
+   return s_szLatencyTraceStageNames[iStage];
+}
+
+int latency_trace_init(const char* szSMName)
+{
+   if ( NULL != s_pLatencyTraceStats )
+      return 1;
+   type_latency_trace_stats* pStats = (type_latency_trace_stats*)open_shared_mem_for_write(szSMName, sizeof(type_latency_trace_stats));
+   if ( NULL == pStats )
+   {
+      log_softerror_and_alarm("[LatencyTrace] Failed to open shared memory %s, latency tracing is disabled.", szSMName);
+      return 0;
+   }
+   pStats->uVersion = LATENCY_TRACE_VERSION;
+   pStats->uTimeStart = get_current_timestamp_ms();
+   __atomic_store_n(&s_pLatencyTraceStats, pStats, __ATOMIC_RELEASE);
+   log_line("[LatencyTrace] Started, %d stages, %d buckets per stage.", LATENCY_TRACE_STAGES, LATENCY_TRACE_BUCKETS);
+   return 1;
+}
+
+void latency_trace_close()
+{
+   type_latency_trace_stats* pStats = __atomic_exchange_n(&s_pLatencyTraceStats, NULL, __ATOMIC_ACQ_REL);
+   if ( NULL != pStats )
+      munmap(pStats, sizeof(type_latency_trace_stats));
+}
+
+int latency_trace_is_enabled()
+{
+   return (NULL != __atomic_load_n(&s_pLatencyTraceStats, __ATOMIC_RELAXED))?1:0;
+}
+
+void latency_trace_histogram_add(type_latency_trace_histogram* pHistogram, u32 uMicros)
+{
+   __atomic_fetch_add(&(pHistogram->uBuckets[latency_trace_get_bucket(uMicros)]), 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&(pHistogram->uSumMicros), (u64)uMicros, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&(pHistogram->uCount), 1, __ATOMIC_RELAXED);
+
+   u32 uMax = __atomic_load_n(&(pHistogram->uMaxMicros), __ATOMIC_RELAXED);
+   while ( uMicros > uMax )
+   {
+      if ( __atomic_compare_exchange_n(&(pHistogram->uMaxMicros), &uMax, uMicros, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+         break;
+   }
+}
+
+void latency_trace_add(int iStage, u32 uMicros)
+{
+   type_latency_trace_stats* pStats = __atomic_load_n(&s_pLatencyTraceStats, __ATOMIC_ACQUIRE);
+   if ( (NULL == pStats) || (iStage < 0) || (iStage >= LATENCY_TRACE_STAGES) )
+      return;
+   latency_trace_histogram_add(&(pStats->stages[iStage]), uMicros);
+}
+
+void latency_trace_add_since(int iStage, u64 uStartMicros)
+{
+   if ( (0 == uStartMicros) || (NULL == __atomic_load_n(&s_pLatencyTraceStats, __ATOMIC_RELAXED)) )
+      return;
+   u64 uNow = latency_trace_get_time_micros();
+   if ( uNow < uStartMicros )
+      return;
+   u64 uDelta = uNow - uStartMicros;
+   latency_trace_add(iStage, (uDelta > 0xFFFFFFFF)?0xFFFFFFFF:(u32)uDelta);
+}
+
+u32 latency_trace_histogram_get_percentile(const type_latency_trace_histogram* pHistogram, int iPercent)
+{
+   u32 uTotal = 0;
+   for( int i=0; i<LATENCY_TRACE_BUCKETS; i++ )
+      uTotal += pHistogram->uBuckets[i];
+   if ( 0 == uTotal )
+      return 0;
+
+   // Rank of the sample at the percentile, rounded up
+   u64 uRank = ((u64)uTotal * (u64)iPercent + 99) / 100;
+   if ( uRank < 1 )
+      uRank = 1;
+   u64 uSum = 0;
+   for( int i=0; i<LATENCY_TRACE_BUCKETS; i++ )
+   {
+      uSum += pHistogram->uBuckets[i];
+      if ( uSum >= uRank )
+      {
+         u32 uValue = latency_trace_get_bucket_max_micros(i);
+         if ( (0 != pHistogram->uMaxMicros) && (uValue > pHistogram->uMaxMicros) )
+            uValue = pHistogram->uMaxMicros;
+         return uValue;
+      }
+   }
+   return pHistogram->uMaxMicros;
+}
+
+void latency_trace_histogram_diff(const type_latency_trace_histogram* pCurrent, const type_latency_trace_histogram* pPrevious, type_latency_trace_histogram* pResult)
+{
+   // Counters only grow while the same writer runs; a writer restart clears them: use the current values as they are
+   int bRestarted = (pCurrent->uCount < pPrevious->uCount)?1:0;
+   pResult->uCount = bRestarted?pCurrent->uCount:(pCurrent->uCount - pPrevious->uCount);
+   pResult->uSumMicros = bRestarted?pCurrent->uSumMicros:(pCurrent->uSumMicros - pPrevious->uSumMicros);
+   pResult->uMaxMicros = pCurrent->uMaxMicros;
+   for( int i=0; i<LATENCY_TRACE_BUCKETS; i++ )
+   {
+      if ( bRestarted || (pCurrent->uBuckets[i] < pPrevious->uBuckets[i]) )
+         pResult->uBuckets[i] = pCurrent->uBuckets[i];
+      else
+         pResult->uBuckets[i] = pCurrent->uBuckets[i] - pPrevious->uBuckets[i];
+   }
+}
+
+type_latency_trace_stats* latency_trace_open_for_read(const char* szSMName)
+{
+   return (type_latency_trace_stats*)open_shared_mem_for_read(szSMName, sizeof(type_latency_trace_stats));
+}
+
+void latency_trace_close_for_read(type_latency_trace_stats* pStats)
+{
+   if ( NULL != pStats )
+      munmap(pStats, sizeof(type_latency_trace_stats));
+}
+
+void latency_trace_snapshot(const type_latency_trace_stats* pStats, type_latency_trace_stats* pSnapshot)
+{
+   pSnapshot->uVersion = pStats->uVersion;
+   pSnapshot->uTimeStart = pStats->uTimeStart;
+   for( int iStage=0; iStage<LATENCY_TRACE_STAGES; iStage++ )
+   {
+      const type_latency_trace_histogram* pSrc = &(pStats->stages[iStage]);
+      type_latency_trace_histogram* pDest = &(pSnapshot->stages[iStage]);
+      pDest->uCount = __atomic_load_n(&(pSrc->uCount), __ATOMIC_RELAXED);
+      pDest->uMaxMicros = __atomic_load_n(&(pSrc->uMaxMicros), __ATOMIC_RELAXED);
+      pDest->uSumMicros = __atomic_load_n(&(pSrc->uSumMicros), __ATOMIC_RELAXED);
+      for( int i=0; i<LATENCY_TRACE_BUCKETS; i++ )
+         pDest->uBuckets[i] = __atomic_load_n(&(pSrc->uBuckets[i]), __ATOMIC_RELAXED);
+   }
+}
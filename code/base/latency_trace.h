@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../base/base.h"
+
+// Per stage latency tracing of the video pipeline, from capture on the vehicle to the output to the player
+// on the controller. Each process (vehicle router, station router) publishes one histogram per stage in its own
+// shared memory (SHARED_MEM_LATENCY_TRACE_*), updated lock free (atomic adds) from any thread.
+// Histograms are log-linear (HDR style): 8 linear sub buckets per power of 2 of microseconds, so the
+// relative error of a percentile is at most 12.5%, from 1 us to 16 seconds (the last bucket holds everything above).
+
+#define LATENCY_TRACE_SUB_BUCKETS_BITS 3
+#define LATENCY_TRACE_SUB_BUCKETS (1<<LATENCY_TRACE_SUB_BUCKETS_BITS)
+#define LATENCY_TRACE_MAX_POW2 24
+// Linear buckets up to LATENCY_TRACE_SUB_BUCKETS, then SUB_BUCKETS per power of 2, plus the overflow bucket
+#define LATENCY_TRACE_BUCKETS ((LATENCY_TRACE_MAX_POW2 - LATENCY_TRACE_SUB_BUCKETS_BITS + 1) * LATENCY_TRACE_SUB_BUCKETS + 1)
+
+// Vehicle stages
+#define LATENCY_TRACE_STAGE_CAPTURE 0 // frame first data read from the camera to frame end read
+#define LATENCY_TRACE_STAGE_FEC_BLOCK 1 // frame first data read to its video block FEC packets ready (block closed)
+#define LATENCY_TRACE_STAGE_RADIO_TX 2 // frame first data read to the video packet sent on the radio
+// Both
+#define LATENCY_TRACE_STAGE_RADIO_RX 3 // radio packet read by the radio rx thread to picked up by the router
+// Station stages
+#define LATENCY_TRACE_STAGE_BLOCK_COMPLETE 4 // first packet of a video block received to the block decodable
+#define LATENCY_TRACE_STAGE_OUTPUT 5 // video packet received to its data sent to the player/streamer
+#define LATENCY_TRACE_STAGES 6
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   u32 uCount;
+   u32 uMaxMicros;
+   u64 uSumMicros;
+   u32 uBuckets[LATENCY_TRACE_BUCKETS];
+} type_latency_trace_histogram;
+
+typedef struct
+{
+   u32 uVersion;
+   u32 uTimeStart; // ms, g_TimeNow of the writer when it started
+   type_latency_trace_histogram stages[LATENCY_TRACE_STAGES] __attribute__((aligned(64)));
+} type_latency_trace_stats;
+
+// Monotonic clock used for all the trace times
+u64 latency_trace_get_time_micros();
+
+int latency_trace_get_bucket(u32 uMicros);
+// Upper limit (included) of the bucket
+u32 latency_trace_get_bucket_max_micros(int iBucket);
+const char* latency_trace_get_stage_name(int iStage);
+
+// Writer: opens (cleared) the shared memory of this process. Returns 1 on success.
+// Without it (or after latency_trace_close) the add functions do nothing.
+int latency_trace_init(const char* szSMName);
+void latency_trace_close();
+int latency_trace_is_enabled();
+void latency_trace_add(int iStage, u32 uMicros);
+// Adds the time from uStartMicros (latency_trace_get_time_micros clock) to now. Does nothing if uStartMicros is 0.
+void latency_trace_add_since(int iStage, u64 uStartMicros);
+
+void latency_trace_histogram_add(type_latency_trace_histogram* pHistogram, u32 uMicros);
+// Returns the upper limit of the bucket holding the given percentile, 0 if the histogram is empty
+u32 latency_trace_histogram_get_percentile(const type_latency_trace_histogram* pHistogram, int iPercent);
+// pResult = pCurrent - pPrevious (for the values over a time window). Max is the one of pCurrent.
+void latency_trace_histogram_diff(const type_latency_trace_histogram* pCurrent, const type_latency_trace_histogram* pPrevious, type_latency_trace_histogram* pResult);
+
+// Readers
+type_latency_trace_stats* latency_trace_open_for_read(const char* szSMName);
+void latency_trace_close_for_read(type_latency_trace_stats* pStats);
+// Copies the histograms of all stages (each counter read atomically, no lock with the writers)
+void latency_trace_snapshot(const type_latency_trace_stats* pStats, type_latency_trace_stats* pSnapshot);
+
+#ifdef __cplusplus
+}
+#endif
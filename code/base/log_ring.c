@@ -0,0 +1,658 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <signal.h>
+#include "base.h"
+#include "log_ring.h"
+
+// Process local cache of the registered formats, by format content hash (formats are not
+// always string literals, so the format pointer can't be used as the key)
+#define LOG_RING_FORMATS_CACHE_SIZE 1024 // power of 2
+#define LOG_RING_FORMATS_CACHE_MAX_PROBES 16
+#define LOG_RING_FORMATS_LOCK_TIMEOUT_MS 50
+
+typedef struct
+{
+   u64 uHash; // 0 for an empty entry
+   u32 uFormatId;
+   u32 uFormatLength;
+} type_log_ring_format_cache_entry;
+
+static type_log_ring_format_cache_entry s_LogRingFormatsCache[LOG_RING_FORMATS_CACHE_SIZE];
+
+char* log_ring_get_name(int iPid)
+{
+   static char s_szLogRingName[64];
+   snprintf(s_szLogRingName, sizeof(s_szLogRingName)/sizeof(s_szLogRingName[0]), "/%s%d", LOG_RING_SHM_PREFIX, iPid);
+   return s_szLogRingName;
+}
+
+type_log_ring* log_ring_create(const char* szComponentName)
+{
+   // Can't use log_line here: it would log to this ring
+   char szName[64];
+   strcpy(szName, log_ring_get_name((int)getpid()));
+   shm_unlink(szName);
+   int fd = shm_open(szName, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( fd < 0 )
+   {
+      log_line_forced_to_file("[LogRing] Failed to create shared memory %s, error: %d, %s", szName, errno, strerror(errno));
+      return NULL;
+   }
+   if ( 0 != ftruncate(fd, sizeof(type_log_ring)) )
+   {
+      log_line_forced_to_file("[LogRing] Failed to set size of shared memory %s, error: %d, %s", szName, errno, strerror(errno));
+      close(fd);
+      shm_unlink(szName);
+      return NULL;
+   }
+   void* pMap = mmap(NULL, sizeof(type_log_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if ( MAP_FAILED == pMap )
+   {
+      log_line_forced_to_file("[LogRing] Failed to map shared memory %s, error: %d, %s", szName, errno, strerror(errno));
+      shm_unlink(szName);
+      return NULL;
+   }
+
+   // Memory of a new shm segment is zeroed; only the slots sequences need init
+   type_log_ring* pRing = (type_log_ring*)pMap;
+   pRing->uVersion = LOG_RING_VERSION;
+   pRing->iPid = (int)getpid();
+   if ( NULL != szComponentName )
+      strncpy(pRing->szComponentName, szComponentName, sizeof(pRing->szComponentName)-1);
+   for( u32 u=0; u<LOG_RING_SLOTS; u++ )
+      pRing->slots[u].uSequence = u;
+   memset(s_LogRingFormatsCache, 0, sizeof(s_LogRingFormatsCache));
+   __atomic_store_n(&pRing->uMagic, LOG_RING_MAGIC, __ATOMIC_RELEASE);
+
+   log_line_forced_to_file("[LogRing] Created log ring %s: %u slots, %u bytes.", szName, LOG_RING_SLOTS, (u32)sizeof(type_log_ring));
+   return pRing;
+}
+
+type_log_ring* log_ring_open(const char* szName)
+{
+   if ( NULL == szName )
+      return NULL;
+   int fd = shm_open(szName, O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( fd < 0 )
+      return NULL;
+   struct stat fdStat;
+   if ( (0 != fstat(fd, &fdStat)) || (fdStat.st_size != (off_t)sizeof(type_log_ring)) )
+   {
+      close(fd);
+      return NULL;
+   }
+   void* pMap = mmap(NULL, sizeof(type_log_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if ( MAP_FAILED == pMap )
+      return NULL;
+   type_log_ring* pRing = (type_log_ring*)pMap;
+   if ( (__atomic_load_n(&pRing->uMagic, __ATOMIC_ACQUIRE) != LOG_RING_MAGIC) || (pRing->uVersion != LOG_RING_VERSION) )
+   {
+      munmap(pMap, sizeof(type_log_ring));
+      return NULL;
+   }
+   return pRing;
+}
+
+void log_ring_close(type_log_ring* pRing)
+{
+   if ( NULL != pRing )
+      munmap(pRing, sizeof(type_log_ring));
+}
+
+// p points after the '%' of a conversion (not "%%"). Returns the position after the conversion
+// character and the argument type, or NULL if the conversion is not supported for binary args.
+static const char* _log_ring_parse_conversion(const char* p, u8* puArgType)
+{
+   while ( ('-' == *p) || ('+' == *p) || (' ' == *p) || ('#' == *p) || ('0' == *p) || ('\'' == *p) )
+      p++;
+   if ( '*' == *p )
+      return NULL;
+   while ( (*p >= '0') && (*p <= '9') )
+      p++;
+   if ( '.' == *p )
+   {
+      p++;
+      if ( '*' == *p )
+         return NULL;
+      while ( (*p >= '0') && (*p <= '9') )
+         p++;
+   }
+
+   u8 uIntType = LOG_RING_ARG_INT;
+   if ( 'h' == *p )
+   {
+      p++;
+      if ( 'h' == *p )
+         p++;
+   }
+   else if ( 'l' == *p )
+   {
+      p++;
+      uIntType = LOG_RING_ARG_LONG;
+      if ( 'l' == *p )
+      {
+         p++;
+         uIntType = LOG_RING_ARG_LONG_LONG;
+      }
+   }
+   else if ( ('q' == *p) || ('j' == *p) )
+   {
+      p++;
+      uIntType = LOG_RING_ARG_LONG_LONG;
+   }
+   else if ( ('z' == *p) || ('t' == *p) )
+   {
+      p++;
+      uIntType = LOG_RING_ARG_SIZE;
+   }
+   else if ( 'L' == *p )
+      return NULL;
+
+   switch ( *p )
+   {
+      case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+         *puArgType = uIntType;
+         break;
+      case 'c':
+         if ( LOG_RING_ARG_INT != uIntType )
+            return NULL;
+         *puArgType = LOG_RING_ARG_INT;
+         break;
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+         *puArgType = LOG_RING_ARG_DOUBLE;
+         break;
+      case 's':
+         if ( LOG_RING_ARG_INT != uIntType )
+            return NULL;
+         *puArgType = LOG_RING_ARG_STRING;
+         break;
+      case 'p':
+         *puArgType = LOG_RING_ARG_POINTER;
+         break;
+      default:
+         return NULL;
+   }
+   return p+1;
+}
+
+static int _log_ring_get_arg_size(u8 uArgType)
+{
+   switch ( uArgType )
+   {
+      case LOG_RING_ARG_INT: return (int)sizeof(int);
+      case LOG_RING_ARG_LONG: return (int)sizeof(long);
+      case LOG_RING_ARG_LONG_LONG: return (int)sizeof(long long);
+      case LOG_RING_ARG_SIZE: return (int)sizeof(size_t);
+      case LOG_RING_ARG_DOUBLE: return (int)sizeof(double);
+      case LOG_RING_ARG_POINTER: return (int)sizeof(void*);
+      case LOG_RING_ARG_STRING: return (int)sizeof(u16);
+   }
+   return 0;
+}
+
+// Returns 0 if the format can't be stored with binary args
+static int _log_ring_parse_format(const char* szFormat, type_log_ring_format* pFormat)
+{
+   pFormat->uArgsCount = 0;
+   const char* p = szFormat;
+   while ( 0 != *p )
+   {
+      if ( '%' != *p )
+      {
+         p++;
+         continue;
+      }
+      p++;
+      if ( '%' == *p )
+      {
+         p++;
+         continue;
+      }
+      if ( pFormat->uArgsCount >= LOG_RING_MAX_ARGS )
+         return 0;
+      p = _log_ring_parse_conversion(p, &(pFormat->uArgTypes[pFormat->uArgsCount]));
+      if ( NULL == p )
+         return 0;
+      pFormat->uArgsCount++;
+   }
+   return 1;
+}
+
+// Called with the formats lock taken
+static u32 _log_ring_register_format(type_log_ring* pRing, const char* szFormat, int iFormatLength)
+{
+   u32 uCount = pRing->uFormatsCount;
+   // Already registered by another thread or by a forked process sharing this ring
+   for( u32 u=0; u<uCount; u++ )
+   {
+      if ( 0 == strcmp(&(pRing->szFormatsPool[pRing->formats[u].uPoolOffset]), szFormat) )
+         return u;
+   }
+   if ( (uCount >= LOG_RING_MAX_FORMATS) || (pRing->uFormatsPoolUsed + (u32)iFormatLength + 1 > LOG_RING_FORMATS_POOL_SIZE) )
+      return LOG_RING_FORMAT_ID_TEXT;
+
+   type_log_ring_format* pFormat = &(pRing->formats[uCount]);
+   if ( ! _log_ring_parse_format(szFormat, pFormat) )
+      return LOG_RING_FORMAT_ID_TEXT;
+   pFormat->uPoolOffset = pRing->uFormatsPoolUsed;
+   memcpy(&(pRing->szFormatsPool[pFormat->uPoolOffset]), szFormat, iFormatLength+1);
+   pRing->uFormatsPoolUsed += (u32)iFormatLength + 1;
+   __atomic_store_n(&pRing->uFormatsCount, uCount+1, __ATOMIC_RELEASE);
+   return uCount;
+}
+
+static u32 _log_ring_get_format_id(type_log_ring* pRing, const char* szFormat, u64 uHash, int iFormatLength)
+{
+   u32 uIndex = (u32)uHash & (LOG_RING_FORMATS_CACHE_SIZE-1);
+   for( int i=0; i<LOG_RING_FORMATS_CACHE_MAX_PROBES; i++ )
+   {
+      type_log_ring_format_cache_entry* pEntry = &s_LogRingFormatsCache[(uIndex+i) & (LOG_RING_FORMATS_CACHE_SIZE-1)];
+      u64 uEntryHash = __atomic_load_n(&pEntry->uHash, __ATOMIC_ACQUIRE);
+      if ( uEntryHash == uHash )
+      {
+         // Two formats can have the same hash: the registered one must be this format, as its
+         // args are packed for it. If not, this format is logged as text.
+         u32 uFormatId = pEntry->uFormatId;
+         if ( LOG_RING_FORMAT_ID_TEXT == uFormatId )
+            return uFormatId;
+         if ( (pEntry->uFormatLength == (u32)iFormatLength) &&
+              (0 == memcmp(&(pRing->szFormatsPool[pRing->formats[uFormatId].uPoolOffset]), szFormat, iFormatLength+1)) )
+            return uFormatId;
+         return LOG_RING_FORMAT_ID_TEXT;
+      }
+      if ( 0 == uEntryHash )
+         break;
+   }
+
+   // Not cached: register it (rare, takes the lock shared by all the producers of the ring)
+   u32 uTimeStart = 0;
+   while ( __atomic_exchange_n(&pRing->uFormatsLock, 1, __ATOMIC_ACQUIRE) )
+   {
+      if ( 0 == uTimeStart )
+         uTimeStart = get_current_timestamp_ms();
+      else if ( get_current_timestamp_ms() > uTimeStart + LOG_RING_FORMATS_LOCK_TIMEOUT_MS )
+         return LOG_RING_FORMAT_ID_TEXT;
+      sched_yield();
+   }
+   u32 uFormatId = _log_ring_register_format(pRing, szFormat, iFormatLength);
+   for( int i=0; i<LOG_RING_FORMATS_CACHE_MAX_PROBES; i++ )
+   {
+      type_log_ring_format_cache_entry* pEntry = &s_LogRingFormatsCache[(uIndex+i) & (LOG_RING_FORMATS_CACHE_SIZE-1)];
+      u64 uEntryHash = __atomic_load_n(&pEntry->uHash, __ATOMIC_ACQUIRE);
+      if ( uEntryHash == uHash )
+         break;
+      if ( 0 != uEntryHash )
+         continue;
+      pEntry->uFormatId = uFormatId;
+      pEntry->uFormatLength = (u32)iFormatLength;
+      __atomic_store_n(&pEntry->uHash, uHash, __ATOMIC_RELEASE);
+      break;
+   }
+   __atomic_store_n(&pRing->uFormatsLock, 0, __ATOMIC_RELEASE);
+   return uFormatId;
+}
+
+static int _log_ring_pack_args(type_log_ring_format* pFormat, u8* pData, va_list args)
+{
+   // Strings get what is left after all the fixed size args
+   int iFixedSize = 0;
+   for( int i=0; i<pFormat->uArgsCount; i++ )
+      iFixedSize += _log_ring_get_arg_size(pFormat->uArgTypes[i]);
+   int iStringsSpace = LOG_RING_SLOT_DATA_SIZE - iFixedSize;
+
+   int iPos = 0;
+   for( int i=0; i<pFormat->uArgsCount; i++ )
+   {
+      switch ( pFormat->uArgTypes[i] )
+      {
+         case LOG_RING_ARG_INT:
+         {
+            int iValue = va_arg(args, int);
+            memcpy(pData + iPos, &iValue, sizeof(iValue));
+            iPos += sizeof(iValue);
+            break;
+         }
+         case LOG_RING_ARG_LONG:
+         {
+            long lValue = va_arg(args, long);
+            memcpy(pData + iPos, &lValue, sizeof(lValue));
+            iPos += sizeof(lValue);
+            break;
+         }
+         case LOG_RING_ARG_LONG_LONG:
+         {
+            long long llValue = va_arg(args, long long);
+            memcpy(pData + iPos, &llValue, sizeof(llValue));
+            iPos += sizeof(llValue);
+            break;
+         }
+         case LOG_RING_ARG_SIZE:
+         {
+            size_t uValue = va_arg(args, size_t);
+            memcpy(pData + iPos, &uValue, sizeof(uValue));
+            iPos += sizeof(uValue);
+            break;
+         }
+         case LOG_RING_ARG_DOUBLE:
+         {
+            double dValue = va_arg(args, double);
+            memcpy(pData + iPos, &dValue, sizeof(dValue));
+            iPos += sizeof(dValue);
+            break;
+         }
+         case LOG_RING_ARG_POINTER:
+         {
+            void* pValue = va_arg(args, void*);
+            memcpy(pData + iPos, &pValue, sizeof(pValue));
+            iPos += sizeof(pValue);
+            break;
+         }
+         case LOG_RING_ARG_STRING:
+         {
+            const char* szValue = va_arg(args, const char*);
+            if ( NULL == szValue )
+               szValue = "(null)";
+            u16 uLength = 0;
+            while ( (0 != szValue[uLength]) && ((int)uLength < iStringsSpace) )
+               uLength++;
+            iStringsSpace -= uLength;
+            memcpy(pData + iPos, &uLength, sizeof(u16));
+            iPos += sizeof(u16);
+            memcpy(pData + iPos, szValue, uLength);
+            iPos += uLength;
+            break;
+         }
+      }
+   }
+   return iPos;
+}
+
+int log_ring_write(type_log_ring* pRing, u32 uTime, u32 uLoopCounter, const char* szFormat, va_list args)
+{
+   if ( (NULL == pRing) || (NULL == szFormat) )
+      return 0;
+
+   // One pass over the format: length, FNV-1a hash and if it has any conversions
+   u64 uHash = 14695981039346656037ULL;
+   int iHasConversions = 0;
+   int iFormatLength = 0;
+   for( const char* p = szFormat; 0 != *p; p++ )
+   {
+      uHash = (uHash ^ (u8)(*p)) * 1099511628211ULL;
+      if ( '%' == *p )
+         iHasConversions = 1;
+      iFormatLength++;
+   }
+   if ( 0 == uHash )
+      uHash = 1;
+
+   u32 uFormatId = LOG_RING_FORMAT_ID_TEXT;
+   if ( iHasConversions )
+      uFormatId = _log_ring_get_format_id(pRing, szFormat, uHash, iFormatLength);
+
+   // Reserve a free slot: it's free for this position when its sequence equals the position
+   type_log_ring_slot* pSlot = NULL;
+   u32 uPos = __atomic_load_n(&pRing->uWritePos, __ATOMIC_RELAXED);
+   while ( 1 )
+   {
+      pSlot = &pRing->slots[uPos & (LOG_RING_SLOTS-1)];
+      u32 uSequence = __atomic_load_n(&pSlot->uSequence, __ATOMIC_ACQUIRE);
+      int iDiff = (int)(uSequence - uPos);
+      if ( 0 == iDiff )
+      {
+         if ( __atomic_compare_exchange_n(&pRing->uWritePos, &uPos, uPos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+            break;
+      }
+      else if ( iDiff < 0 )
+      {
+         __atomic_add_fetch(&pRing->uTotalDropped, 1, __ATOMIC_RELAXED);
+         return 0;
+      }
+      else
+         uPos = __atomic_load_n(&pRing->uWritePos, __ATOMIC_RELAXED);
+   }
+
+   __atomic_store_n(&pSlot->iProducerPid, (int)getpid(), __ATOMIC_RELAXED);
+   pSlot->uTime = uTime;
+   pSlot->uLoopCounter = (u16)(uLoopCounter % 1000);
+   pSlot->uFormatId = (u16)uFormatId;
+   if ( LOG_RING_FORMAT_ID_TEXT == uFormatId )
+   {
+      int iLength = 0;
+      if ( iHasConversions )
+         iLength = vsnprintf((char*)pSlot->uData, LOG_RING_SLOT_DATA_SIZE, szFormat, args);
+      else
+      {
+         iLength = iFormatLength;
+         if ( iLength > LOG_RING_SLOT_DATA_SIZE-1 )
+            iLength = LOG_RING_SLOT_DATA_SIZE-1;
+         memcpy(pSlot->uData, szFormat, iLength);
+      }
+      if ( (iLength < 0) || (iLength > LOG_RING_SLOT_DATA_SIZE-1) )
+         iLength = (iLength < 0)?0:(LOG_RING_SLOT_DATA_SIZE-1);
+      pSlot->uDataLength = (u16)iLength;
+   }
+   else
+      pSlot->uDataLength = (u16)_log_ring_pack_args(&(pRing->formats[uFormatId]), pSlot->uData, args);
+
+   // Fails if the consumer skipped the slot meanwhile (took too long to write it)
+   u32 uExpected = uPos;
+   if ( ! __atomic_compare_exchange_n(&pSlot->uSequence, &uExpected, uPos+1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED) )
+   {
+      __atomic_add_fetch(&pRing->uTotalDropped, 1, __ATOMIC_RELAXED);
+      return 0;
+   }
+   return 1;
+}
+
+static int _log_ring_format_line(type_log_ring* pRing, type_log_ring_slot* pSlot, char* szOutput, int iMaxLength)
+{
+   if ( LOG_RING_FORMAT_ID_TEXT == pSlot->uFormatId )
+   {
+      int iLength = pSlot->uDataLength;
+      if ( iLength > iMaxLength-1 )
+         iLength = iMaxLength-1;
+      memcpy(szOutput, pSlot->uData, iLength);
+      szOutput[iLength] = 0;
+      return iLength;
+   }
+   if ( pSlot->uFormatId >= __atomic_load_n(&pRing->uFormatsCount, __ATOMIC_ACQUIRE) )
+      return snprintf(szOutput, iMaxLength, "[LogRing] Invalid format id %u", pSlot->uFormatId);
+
+   type_log_ring_format* pFormat = &(pRing->formats[pSlot->uFormatId]);
+   const char* p = &(pRing->szFormatsPool[pFormat->uPoolOffset]);
+   int iOut = 0;
+   int iArg = 0;
+   int iDataPos = 0;
+   char szSpec[32];
+   char szString[LOG_RING_SLOT_DATA_SIZE+1];
+
+   while ( (0 != *p) && (iOut < iMaxLength-1) )
+   {
+      if ( '%' != *p )
+      {
+         szOutput[iOut++] = *p++;
+         continue;
+      }
+      if ( '%' == *(p+1) )
+      {
+         szOutput[iOut++] = '%';
+         p += 2;
+         continue;
+      }
+      u8 uArgType = 0;
+      const char* pEnd = _log_ring_parse_conversion(p+1, &uArgType);
+      if ( (NULL == pEnd) || (iArg >= pFormat->uArgsCount) || ((int)(pEnd - p) >= (int)sizeof(szSpec)) )
+         break;
+      memcpy(szSpec, p, pEnd - p);
+      szSpec[pEnd - p] = 0;
+      p = pEnd;
+      iArg++;
+
+      int iSize = _log_ring_get_arg_size(uArgType);
+      if ( iDataPos + iSize > (int)pSlot->uDataLength )
+         break;
+      int iRemaining = iMaxLength - iOut;
+      int iWritten = 0;
+      switch ( uArgType )
+      {
+         case LOG_RING_ARG_INT:
+         {
+            int iValue;
+            memcpy(&iValue, pSlot->uData + iDataPos, sizeof(iValue));
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, iValue);
+            break;
+         }
+         case LOG_RING_ARG_LONG:
+         {
+            long lValue;
+            memcpy(&lValue, pSlot->uData + iDataPos, sizeof(lValue));
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, lValue);
+            break;
+         }
+         case LOG_RING_ARG_LONG_LONG:
+         {
+            long long llValue;
+            memcpy(&llValue, pSlot->uData + iDataPos, sizeof(llValue));
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, llValue);
+            break;
+         }
+         case LOG_RING_ARG_SIZE:
+         {
+            size_t uValue;
+            memcpy(&uValue, pSlot->uData + iDataPos, sizeof(uValue));
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, uValue);
+            break;
+         }
+         case LOG_RING_ARG_DOUBLE:
+         {
+            double dValue;
+            memcpy(&dValue, pSlot->uData + iDataPos, sizeof(dValue));
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, dValue);
+            break;
+         }
+         case LOG_RING_ARG_POINTER:
+         {
+            void* pValue;
+            memcpy(&pValue, pSlot->uData + iDataPos, sizeof(pValue));
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, pValue);
+            break;
+         }
+         case LOG_RING_ARG_STRING:
+         {
+            u16 uLength;
+            memcpy(&uLength, pSlot->uData + iDataPos, sizeof(u16));
+            if ( iDataPos + iSize + (int)uLength > (int)pSlot->uDataLength )
+               uLength = 0;
+            memcpy(szString, pSlot->uData + iDataPos + iSize, uLength);
+            szString[uLength] = 0;
+            iDataPos += uLength;
+            iWritten = snprintf(szOutput + iOut, iRemaining, szSpec, szString);
+            break;
+         }
+      }
+      iDataPos += iSize;
+      if ( iWritten < 0 )
+         break;
+      iOut += iWritten;
+      if ( iOut > iMaxLength-1 )
+         iOut = iMaxLength-1;
+   }
+   szOutput[iOut] = 0;
+   return iOut;
+}
+
+int log_ring_read_line(type_log_ring* pRing, char* szOutput, int iMaxLength, u32* puTime, u32* puLoopCounter, u32* puTimeFirstStaleSlot)
+{
+   if ( (NULL == pRing) || (NULL == szOutput) || (iMaxLength < 2) )
+      return 0;
+
+   u32 uPos = pRing->uReadPos;
+   type_log_ring_slot* pSlot = &pRing->slots[uPos & (LOG_RING_SLOTS-1)];
+   if ( __atomic_load_n(&pSlot->uSequence, __ATOMIC_ACQUIRE) != uPos+1 )
+   {
+      if ( __atomic_load_n(&pRing->uWritePos, __ATOMIC_ACQUIRE) == uPos )
+      {
+         if ( NULL != puTimeFirstStaleSlot )
+            *puTimeFirstStaleSlot = 0;
+         return 0;
+      }
+      // Slot reserved by a producer but not published yet
+      if ( NULL == puTimeFirstStaleSlot )
+         return 0;
+      u32 uTimeNow = get_current_timestamp_ms();
+      if ( 0 == *puTimeFirstStaleSlot )
+         *puTimeFirstStaleSlot = uTimeNow;
+      if ( uTimeNow < *puTimeFirstStaleSlot + LOG_RING_STALE_SLOT_TIMEOUT_MS )
+         return 0;
+      // Skip it only if the producer is gone; a live one is just slow
+      int iPid = __atomic_load_n(&pSlot->iProducerPid, __ATOMIC_ACQUIRE);
+      if ( (iPid > 0) && ((0 == kill(iPid, 0)) || (errno != ESRCH)) )
+         return 0;
+      // Free the slot for the producers on the next lap, unless it was just published
+      pSlot->iProducerPid = 0;
+      u32 uExpected = uPos;
+      if ( ! __atomic_compare_exchange_n(&pSlot->uSequence, &uExpected, uPos + LOG_RING_SLOTS, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+         return 0;
+      *puTimeFirstStaleSlot = 0;
+      pRing->uTotalStaleSlotsSkipped++;
+      __atomic_store_n(&pRing->uReadPos, uPos+1, __ATOMIC_RELEASE);
+      return -1;
+   }
+   if ( NULL != puTimeFirstStaleSlot )
+      *puTimeFirstStaleSlot = 0;
+
+   if ( NULL != puTime )
+      *puTime = pSlot->uTime;
+   if ( NULL != puLoopCounter )
+      *puLoopCounter = pSlot->uLoopCounter;
+   int iLength = _log_ring_format_line(pRing, pSlot, szOutput, iMaxLength);
+
+   // Free the slot for the producers on the next lap
+   pSlot->iProducerPid = 0;
+   __atomic_store_n(&pSlot->uSequence, uPos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+   __atomic_store_n(&pRing->uReadPos, uPos+1, __ATOMIC_RELEASE);
+   return iLength;
+}
+
+int log_ring_get_pending_count(type_log_ring* pRing)
+{
+   if ( NULL == pRing )
+      return 0;
+   return (int)(__atomic_load_n(&pRing->uWritePos, __ATOMIC_ACQUIRE) - __atomic_load_n(&pRing->uReadPos, __ATOMIC_ACQUIRE));
+}
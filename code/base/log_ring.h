@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdarg.h>
+#include "../base/base.h"
+
+// Per process binary log ring, in a POSIX shared memory segment, consumed by ruby_logger.
+// log_line stores in a ring slot just the time, a format id and the binary values of the
+// arguments; the text is formatted (and written to the log files, in batches) by ruby_logger.
+// Format strings are registered once per process in a table in the same shared memory segment.
+// Any number of producer threads (and forked child processes), one consumer. A slot reserved by
+// a producer that died before publishing it is skipped by the consumer after LOG_RING_STALE_SLOT_TIMEOUT_MS,
+// once the producer process is confirmed gone. Publishing a skipped slot fails (late line dropped).
+
+#define LOG_RING_SHM_PREFIX "RUBY_LOG_RING_"
+#define LOG_RING_MAGIC 0x4C4F4752
+#define LOG_RING_VERSION 2
+#define LOG_RING_SLOTS 512 // power of 2
+#define LOG_RING_SLOT_DATA_SIZE MAX_SERVICE_LOG_ENTRY_LENGTH
+#define LOG_RING_MAX_FORMATS 512
+#define LOG_RING_FORMATS_POOL_SIZE 32768
+#define LOG_RING_MAX_ARGS 16
+#define LOG_RING_STALE_SLOT_TIMEOUT_MS 500
+
+// Slot holds already formatted text (format not supported for binary args or formats table full)
+#define LOG_RING_FORMAT_ID_TEXT 0xFFFF
+
+#define LOG_RING_ARG_INT 1
+#define LOG_RING_ARG_LONG 2
+#define LOG_RING_ARG_LONG_LONG 3
+#define LOG_RING_ARG_SIZE 4
+#define LOG_RING_ARG_DOUBLE 5
+#define LOG_RING_ARG_STRING 6 // stored as u16 length + chars
+#define LOG_RING_ARG_POINTER 7
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   u32 uSequence; // position when free for that position, position + 1 when published
+   u32 uTime;
+   u16 uFormatId;
+   u16 uDataLength;
+   u16 uLoopCounter;
+   u16 uReserved;
+   int iProducerPid; // process that reserved the slot, 0 when free
+   u8  uData[LOG_RING_SLOT_DATA_SIZE];
+} __attribute__((aligned(8))) type_log_ring_slot;
+
+typedef struct
+{
+   u32 uPoolOffset;
+   u8  uArgsCount;
+   u8  uArgTypes[LOG_RING_MAX_ARGS];
+} type_log_ring_format;
+
+typedef struct
+{
+   u32 uMagic;
+   u32 uVersion;
+   int iPid;
+   char szComponentName[64];
+
+   // Producers
+   u32 uWritePos __attribute__((aligned(64)));
+   u32 uTotalDropped;
+   u32 uFormatsLock; // spin lock, formats are registered rarely
+   u32 uFormatsCount; // published (release) after the format is complete
+   u32 uFormatsPoolUsed;
+
+   // Consumer
+   u32 uReadPos __attribute__((aligned(64)));
+   u32 uTotalStaleSlotsSkipped;
+
+   type_log_ring_format formats[LOG_RING_MAX_FORMATS];
+   char szFormatsPool[LOG_RING_FORMATS_POOL_SIZE];
+   type_log_ring_slot slots[LOG_RING_SLOTS] __attribute__((aligned(64)));
+} type_log_ring;
+
+// Producer: creates the ring of the current process (replaces a stale one left by a process with the same PID)
+type_log_ring* log_ring_create(const char* szComponentName);
+// Returns 1 if the line was stored, 0 if the ring was full (line dropped)
+int log_ring_write(type_log_ring* pRing, u32 uTime, u32 uLoopCounter, const char* szFormat, va_list args);
+
+// Consumer
+char* log_ring_get_name(int iPid);
+type_log_ring* log_ring_open(const char* szName);
+void log_ring_close(type_log_ring* pRing);
+// Returns the length of the text formatted into szOutput, 0 if there is no line, -1 if a stale slot was skipped
+int log_ring_read_line(type_log_ring* pRing, char* szOutput, int iMaxLength, u32* puTime, u32* puLoopCounter, u32* puTimeFirstStaleSlot);
+int log_ring_get_pending_count(type_log_ring* pRing);
+
+#ifdef __cplusplus
+}
+#endif
@@ -34,7 +34,9 @@
 #include "base.h"
 #include "models.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <math.h>
+#include <sys/stat.h>
 #include "config.h"
 #include "ctrl_preferences.h"
 #include "hardware.h"
@@ -42,6 +44,7 @@
 #include "hardware_camera.h"
 #include "hardware_procs.h"
 #include "hardware_i2c.h"
+#include "crc32.h"
 #include "camera_utils.h"
 #include "utils.h"
 #include "../common/string_utils.h"
@@ -222,6 +225,9 @@ Model::Model(void)
    vehicle_name[0] = 0;
    vehicle_long_name[0] = 0;
    iLoadedFileVersion = 0;
+   memset(uBinarySectionsCRC, 0, sizeof(uBinarySectionsCRC));
+   uBinarySectionsValidMask = 0;
+   uLastLoadedBinarySectionsMask = 0;
    radioInterfacesParams.interfaces_count = 0;
    is_spectator = false;
    uVehicleId = 0;
@@ -291,23 +297,66 @@ bool Model::reloadIfChanged(bool bLoadStats)
    char szFile[MAX_FILE_PATH_SIZE];
    strcpy(szFile, FOLDER_CONFIG);
    strcat(szFile, FILE_CONFIG_CURRENT_VEHICLE_MODEL);
-   FILE* fd = fopen(szFile, "r");
+   return reloadFromFileIfChanged(szFile, bLoadStats);
+}
+
+bool Model::reloadFromFileIfChanged(const char* filename, bool bLoadStats)
+{
+   uLastLoadedBinarySectionsMask = 0;
+   FILE* fd = fopen(filename, "r");
    if ( NULL == fd )
       return false;
 
+   // Version line, file stamp line, save count line
    int iV, iS = 0;
-   if ( 1 == fscanf(fd, "%*s %d", &iV) )
-   if ( 1 == fscanf(fd, "%*s %d", &iS) )
+   if ( 2 == fscanf(fd, "%*s %d %*s %*s %d", &iV, &iS) )
    if ( iS != iSaveCount )
    {
-      log_line("Model: changed. Reload");
       fclose(fd);
-      return loadFromFile(szFile, bLoadStats);
+      // Binary file saved with the text file: copy just the sections that changed
+      if ( loadFromBinaryFile(filename, bLoadStats, true) )
+      {
+         log_line("Model: changed. Reloaded from binary file, save count: %d, sections: 0x%X", iSaveCount, uLastLoadedBinarySectionsMask);
+         return true;
+      }
+      log_line("Model: changed. Reload");
+      return loadFromFile(filename, bLoadStats);
    }
    fclose(fd);
    return true;
 }
 
+bool Model::loadFromTextFile(const char* filename)
+{
+   FILE* fd = fopen(filename, "r");
+   if ( NULL == fd )
+      return false;
+
+   bool bLoadedOk = false;
+   int iVersion = 0;
+   if ( 1 != fscanf(fd, "%*s %d", &iVersion) )
+      log_softerror_and_alarm("Load model: Error on version line. Invalid vehicle configuration file: %s", filename);
+   else
+   {
+      //log_line("Found model file version: %d.", iVersion);
+      if ( 10 == iVersion )
+         bLoadedOk = loadVersion10(fd);
+      if ( 11 == iVersion )
+         bLoadedOk = loadVersion11(fd);
+      if ( 12 == iVersion )
+         bLoadedOk = loadVersion12(fd);
+      if ( bLoadedOk )
+         iLoadedFileVersion = iVersion;
+      else
+         log_softerror_and_alarm("Invalid vehicle configuration file: %s", filename);
+   }
+   fclose(fd);
+
+   // Content in memory no longer matches the binary sections CRCs
+   uBinarySectionsValidMask = 0;
+   return bLoadedOk;
+}
+
 bool Model::loadFromFile(const char* filename, bool bLoadStats)
 {
    char szFileNormal[MAX_FILE_PATH_SIZE];
@@ -319,49 +368,36 @@ bool Model::loadFromFile(const char* filename, bool bLoadStats)
    szFileBackup[strlen(szFileBackup)-2] = 'a';
    szFileBackup[strlen(szFileBackup)-1] = 'k';
 
-   bool bMainFileLoadedOk = false;
-   bool bBackupFileLoadedOk = false;
-
-   type_vehicle_stats_info stats;
-   memcpy((u8*)&stats, (u8*)&m_Stats, sizeof(type_vehicle_stats_info));
-
    u32 timeStart = get_current_timestamp_ms();
 
-   int iVersionMain = 0;
-   int iVersionBackup = 0;
-   FILE* fd = fopen(szFileNormal, "r");
-   if ( NULL != fd )
+   if ( loadFromBinaryFile(filename, bLoadStats, false) )
    {
-      if ( 1 != fscanf(fd, "%*s %d", &iVersionMain) )
-      {
-         log_softerror_and_alarm("Load model: Error on version line. Invalid vehicle configuration file: %s", szFileNormal);
-         bMainFileLoadedOk = false;
-      }
-      else
-      {
-         //log_line("Found model file version: %d.", iVersion);
-         if ( 10 == iVersionMain )
-            bMainFileLoadedOk = loadVersion10(fd);
-         if ( 11 == iVersionMain )
-            bMainFileLoadedOk = loadVersion11(fd);
-         if ( 12 == iVersionMain )
-            bMainFileLoadedOk = loadVersion12(fd);
-         if ( bMainFileLoadedOk )
-         {
-            iLoadedFileVersion = iVersionMain;
-         }
-         else
-            log_softerror_and_alarm("Invalid vehicle configuration file: %s",szFileNormal);
-      }
-      fclose(fd);
+      timeStart = get_current_timestamp_ms() - timeStart;
+      log_line("Loaded vehicle (%s) successfully (%u ms) from binary file: [%s] name: [%s], VID: %u, %s, software: %d.%d (b-%d), save count: %d, on time: %02d:%02d",
+         bLoadStats?"with stats":"without stats", timeStart,
+         filename, vehicle_name, uVehicleId, 
+         is_spectator?"spectator mode": "control mode",
+         get_sw_version_major(this), get_sw_version_minor(this), get_sw_version_build(this),
+         iSaveCount, m_Stats.uCurrentOnTime/60, m_Stats.uCurrentOnTime%60);
+      return true;
    }
-   else
-      bMainFileLoadedOk = false;
 
-   if ( bMainFileLoadedOk )
+   // Binary file is created from the text file only for the models in the config folder
+   bool bCreateBinaryFile = (0 == strncmp(filename, FOLDER_CONFIG, strlen(FOLDER_CONFIG)));
+
+   type_vehicle_stats_info stats;
+   memcpy((u8*)&stats, (u8*)&m_Stats, sizeof(type_vehicle_stats_info));
+
+   if ( loadFromTextFile(szFileNormal) )
    {
+      if ( bCreateBinaryFile )
+         saveToBinaryFile(szFileNormal);
+
       if ( ! bLoadStats ) 
+      {
          memcpy((u8*)&m_Stats, (u8*)&stats, sizeof(type_vehicle_stats_info));
+         uBinarySectionsValidMask &= ~(((u32)1) << MODEL_BIN_SECTION_STATS);
+      }
 
       timeStart = get_current_timestamp_ms() - timeStart;
       char szFreq1[64];
@@ -382,59 +418,28 @@ bool Model::loadFromFile(const char* filename, bool bLoadStats)
       return true;
    }
 
+   bool bBackupFileLoadedOk = loadFromTextFile(szFileBackup);
 
-   fd = fopen(szFileBackup, "r");
-   if ( NULL != fd )
-   {
-      if ( 1 != fscanf(fd, "%*s %d", &iVersionBackup) )
-      {
-         log_softerror_and_alarm("Load model: Error on version line. Invalid vehicle configuration file: %s", szFileBackup);
-         bBackupFileLoadedOk = false;
-      }
-      else
-      {
-         //log_line("Found model file version: %d.", iVersion);
-         if ( 10 == iVersionBackup )
-            bBackupFileLoadedOk = loadVersion10(fd);
-         if ( 11 == iVersionBackup )
-            bBackupFileLoadedOk = loadVersion11(fd);
-         if ( 12 == iVersionBackup )
-            bBackupFileLoadedOk = loadVersion12(fd);
-         if ( bBackupFileLoadedOk )
-         {
-            iLoadedFileVersion = iVersionBackup;
-         }
-         else
-            log_softerror_and_alarm("Invalid vehicle configuration file: %s",szFileBackup);
-      }
-      fclose(fd);
-   }
-   else
-      bBackupFileLoadedOk = false;
+   if ( ! bLoadStats ) 
+      memcpy((u8*)&m_Stats, (u8*)&stats, sizeof(type_vehicle_stats_info));
 
    if ( !bBackupFileLoadedOk )
    {
-      if ( ! bLoadStats ) 
-         memcpy((u8*)&m_Stats, (u8*)&stats, sizeof(type_vehicle_stats_info));
       log_softerror_and_alarm("Failed to load vehicle configuration from file: %s (missing file, missing backup)",filename);
       resetToDefaults(true);
       return false;
    }
 
-   if ( ! bLoadStats ) 
-      memcpy((u8*)&m_Stats, (u8*)&stats, sizeof(type_vehicle_stats_info));
-
    timeStart = get_current_timestamp_ms() - timeStart;
    log_line("Loaded vehicle successfully (%d ms) from backup file: %s; version %d, save count: %d, vehicle name: [%s], vehicle id: %u, software: %d.%d (b-%d), is in control mode: %s", timeStart, filename, iLoadedFileVersion, iSaveCount, vehicle_name, uVehicleId, get_sw_version_major(this), get_sw_version_minor(this), get_sw_version_build(this), is_spectator?"no (is spectator)":"yes");
 
    constructLongName();
    
-   fd = fopen(szFileNormal, "w");
-   if ( NULL != fd )
+   if ( saveToTextFile(szFileNormal, false) )
    {
-      saveVersion12(fd, false);
-      fclose(fd);
       log_line("Restored main model file from backup model file.");
+      if ( bCreateBinaryFile )
+         saveToBinaryFile(szFileNormal);
    }
    else
       log_softerror_and_alarm("Failed to write main model file from backup model file.");
@@ -442,7 +447,6 @@ bool Model::loadFromFile(const char* filename, bool bLoadStats)
    return true;
 }
 
-
 bool Model::loadVersion10(FILE* fd)
 {
    char szBuff[256];
@@ -1703,16 +1707,7 @@ bool Model::loadVersion11(FILE* fd)
    //----------------------------------------
 
    // Validate settings;
-   validate_settings();
-
-   if ( telemetry_params.vehicle_mavlink_id <= 0 || telemetry_params.vehicle_mavlink_id > 255 )
-      telemetry_params.vehicle_mavlink_id = DEFAULT_MAVLINK_SYS_ID_VEHICLE;
-   if ( telemetry_params.controller_mavlink_id <= 0 || telemetry_params.controller_mavlink_id > 255 )
-      telemetry_params.controller_mavlink_id = DEFAULT_MAVLINK_SYS_ID_CONTROLLER;
-   if ( telemetry_params.flags == 0 )
-      telemetry_params.flags = TELEMETRY_FLAGS_REQUEST_DATA_STREAMS | TELEMETRY_FLAGS_SPECTATOR_ENABLE;
-   if ( rxtx_sync_type < 0 || rxtx_sync_type >= RXTX_SYNC_TYPE_LAST )
-      rxtx_sync_type = RXTX_SYNC_TYPE_BASIC;
+   validateLoadedSettings();
 
    /*
    log_line("---------------------------------------");
@@ -2257,16 +2252,7 @@ bool Model::loadVersion12(FILE* fd)
    //----------------------------------------
 
    // Validate settings;
-   validate_settings();
-
-   if ( telemetry_params.vehicle_mavlink_id <= 0 || telemetry_params.vehicle_mavlink_id > 255 )
-      telemetry_params.vehicle_mavlink_id = DEFAULT_MAVLINK_SYS_ID_VEHICLE;
-   if ( telemetry_params.controller_mavlink_id <= 0 || telemetry_params.controller_mavlink_id > 255 )
-      telemetry_params.controller_mavlink_id = DEFAULT_MAVLINK_SYS_ID_CONTROLLER;
-   if ( telemetry_params.flags == 0 )
-      telemetry_params.flags = TELEMETRY_FLAGS_REQUEST_DATA_STREAMS | TELEMETRY_FLAGS_SPECTATOR_ENABLE;
-   if ( rxtx_sync_type < 0 || rxtx_sync_type >= RXTX_SYNC_TYPE_LAST )
-      rxtx_sync_type = RXTX_SYNC_TYPE_BASIC;
+   validateLoadedSettings();
 
    /*
    log_line("---------------------------------------");
@@ -2309,15 +2295,12 @@ bool Model::saveToFile(const char* filename, bool isOnController)
          vehicle_name[i] = '_';
    }
 
-   FILE* fd = fopen(filename, "w");
-   if ( NULL == fd )
+   if ( ! saveToTextFile(filename, isOnController) )
    {
       log_softerror_and_alarm("Failed to save model configuration to file: %s",filename);
       return false;
    }
-   saveVersion12(fd, isOnController);
-   fflush(fd);
-   fclose(fd);
+   saveToBinaryFile(filename);
 
    log_line("Saved vehicle successfully to file: [%s] name: [%s], VID: %u, software: %d.%d (b-%d), has negociated radio: %s, is on controller: %s, %s, on time: %02d:%02d",
          filename, vehicle_name, uVehicleId, get_sw_version_major(this), get_sw_version_minor(this), get_sw_version_build(this),
@@ -2331,19 +2314,508 @@ bool Model::saveToFile(const char* filename, bool isOnController)
    szBuff[strlen(szBuff)-2] = 'a';
    szBuff[strlen(szBuff)-1] = 'k';
 
-   fd = fopen(szBuff, "w");
-   if ( NULL == fd )
+   if ( ! saveToTextFile(szBuff, isOnController) )
    {
       log_softerror_and_alarm("Failed to save model configuration to file: %s",szBuff);
       return false;
    }
+   return true;
+}
+
+bool Model::saveToTextFile(const char* filename, bool isOnController)
+{
+   FILE* fd = fopen(filename, "w");
+   if ( NULL == fd )
+      return false;
    saveVersion12(fd, isOnController);
    fflush(fd);
    fclose(fd);
+   return true;
+}
+
+#define MODEL_BIN_MAGIC 0x4D444C42
+#define MODEL_BIN_VERSION 1
+#define MODEL_BIN_MAX_CHUNKS 4
+
+typedef struct
+{
+   u32 uOffset;
+   u32 uSize;
+   u32 uCRC;
+   int iSaveCountChanged; // save count when the content of the section last changed
+} type_model_bin_section;
+
+typedef struct
+{
+   u32 uMagic;
+   u32 uVersion;
+   u32 uLayoutId; // changes with the software version or when the size of any section changes
+   u32 uTotalSize;
+   int iSaveCount;
+   int iTextFileVersion;
+   u32 uTextFileSize; // text model file saved together with this binary file
+   u32 uTextFileCRC;
+   u32 uSectionsChangedMask; // sections changed by the last save
+   type_model_bin_section sections[MODEL_BIN_SECTIONS_COUNT];
+   u32 uHeaderCRC; // of all the header fields above
+} type_model_bin_header;
+
+// Model members stored in the general section
+typedef struct
+{
+   u32 uModelFlags;
+   u32 uModelPersistentStatusFlags;
+   u32 uDeveloperFlags;
+   char vehicle_name[MAX_VEHICLE_NAME_LENGTH];
+   u32 uVehicleId;
+   u32 uControllerId;
+   u32 uControllerBoardType;
+   u32 sw_version;
+   u8  is_spectator;
+   u8  vehicle_type;
+   u8  enableDHCP;
+   u8  uDummy;
+   int rxtx_sync_type;
+   u32 alarms;
+   u32 camera_rc_channels;
+   u32 enc_flags;
+   int iGPSCount;
+} type_model_bin_general;
+
+static void _model_get_binary_file_name(const char* szTextFile, char* szOutput)
+{
+   strcpy(szOutput, szTextFile);
+   int iLen = strlen(szOutput);
+   if ( iLen < 4 )
+   {
+      strcat(szOutput, ".mdb");
+      return;
+   }
+   szOutput[iLen-3] = 'm';
+   szOutput[iLen-2] = 'd';
+   szOutput[iLen-1] = 'b';
+}
 
+// Size, CRC and version of the text model file
+static bool _model_get_text_file_info(const char* szTextFile, u32* puSize, u32* puCRC, int* piVersion)
+{
+   FILE* fd = fopen(szTextFile, "rb");
+   if ( NULL == fd )
+      return false;
+   u8 uBuffer[32*1024];
+   u8* pBuffer = uBuffer;
+   int iSize = fread(uBuffer, 1, sizeof(uBuffer)-1, fd);
+   if ( iSize == (int)sizeof(uBuffer)-1 )
+   {
+      // Larger than expected for a model file
+      fseek(fd, 0, SEEK_END);
+      iSize = (int)ftell(fd);
+      fseek(fd, 0, SEEK_SET);
+      pBuffer = (u8*) malloc(iSize+1);
+      if ( (NULL == pBuffer) || (iSize != (int)fread(pBuffer, 1, iSize, fd)) )
+      {
+         if ( NULL != pBuffer )
+            free(pBuffer);
+         fclose(fd);
+         return false;
+      }
+   }
+   fclose(fd);
+   if ( iSize <= 0 )
+      return false;
+   pBuffer[iSize] = 0;
+   *puSize = (u32)iSize;
+   *puCRC = crc32_compute(pBuffer, iSize);
+   if ( 1 != sscanf((char*)pBuffer, "%*s %d", piVersion) )
+      *piVersion = 0;
+   if ( pBuffer != uBuffer )
+      free(pBuffer);
    return true;
 }
 
+static int _model_bin_add_chunk(u8** pChunks, u32* pSizes, int iCount, void* pData, u32 uSize)
+{
+   pChunks[iCount] = (u8*)pData;
+   pSizes[iCount] = uSize;
+   return iCount+1;
+}
+
+static u32 _model_bin_get_header_crc(type_model_bin_header* pHeader)
+{
+   return crc32_compute((const u8*)pHeader, (int)offsetof(type_model_bin_header, uHeaderCRC));
+}
+
+// Returns the number of model members (chunks) stored in the section, in order
+int Model::getBinarySectionChunks(int iSection, void* pGeneral, u8** pChunks, u32* pSizes)
+{
+   int iCount = 0;
+   switch ( iSection )
+   {
+      case MODEL_BIN_SECTION_GENERAL:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, pGeneral, sizeof(type_model_bin_general));
+         break;
+      case MODEL_BIN_SECTION_HARDWARE:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &hwCapabilities, sizeof(hwCapabilities));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &hardwareInterfacesInfo, sizeof(hardwareInterfacesInfo));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &processesPriorities, sizeof(processesPriorities));
+         break;
+      case MODEL_BIN_SECTION_RADIO:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &radioInterfacesParams, sizeof(radioInterfacesParams));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &radioInterfacesRuntimeCapab, sizeof(radioInterfacesRuntimeCapab));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &radioLinksParams, sizeof(radioLinksParams));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &relay_params, sizeof(relay_params));
+         break;
+      case MODEL_BIN_SECTION_STATS:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &m_Stats, sizeof(m_Stats));
+         break;
+      case MODEL_BIN_SECTION_CAMERA:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, camera_params, sizeof(camera_params));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &iCameraCount, sizeof(iCameraCount));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &iCurrentCamera, sizeof(iCurrentCamera));
+         break;
+      case MODEL_BIN_SECTION_VIDEO:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &video_params, sizeof(video_params));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, video_link_profiles, sizeof(video_link_profiles));
+         break;
+      case MODEL_BIN_SECTION_OSD:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &osd_params, sizeof(osd_params));
+         break;
+      case MODEL_BIN_SECTION_RC:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &rc_params, sizeof(rc_params));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &functions_params, sizeof(functions_params));
+         break;
+      case MODEL_BIN_SECTION_TELEMETRY:
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &telemetry_params, sizeof(telemetry_params));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &audio_params, sizeof(audio_params));
+         iCount = _model_bin_add_chunk(pChunks, pSizes, iCount, &alarms_params, sizeof(alarms_params));
+         break;
+   }
+   return iCount;
+}
+
+void Model::fillBinaryGeneralSection(void* pGeneral)
+{
+   type_model_bin_general* pG = (type_model_bin_general*)pGeneral;
+   memset(pG, 0, sizeof(type_model_bin_general));
+   pG->uModelFlags = uModelFlags;
+   pG->uModelPersistentStatusFlags = uModelPersistentStatusFlags;
+   pG->uDeveloperFlags = uDeveloperFlags;
+   memcpy(pG->vehicle_name, vehicle_name, MAX_VEHICLE_NAME_LENGTH);
+   pG->uVehicleId = uVehicleId;
+   pG->uControllerId = uControllerId;
+   pG->uControllerBoardType = uControllerBoardType;
+   pG->sw_version = sw_version;
+   pG->is_spectator = is_spectator?1:0;
+   pG->vehicle_type = vehicle_type;
+   pG->enableDHCP = enableDHCP?1:0;
+   pG->rxtx_sync_type = rxtx_sync_type;
+   pG->alarms = alarms;
+   pG->camera_rc_channels = camera_rc_channels;
+   pG->enc_flags = enc_flags;
+   pG->iGPSCount = iGPSCount;
+}
+
+// CRC of the section as it would be saved from the current content in memory
+u32 Model::computeBinarySectionCRC(int iSection)
+{
+   type_model_bin_general general;
+   fillBinaryGeneralSection(&general);
+   u8* pChunks[MODEL_BIN_MAX_CHUNKS];
+   u32 uSizes[MODEL_BIN_MAX_CHUNKS];
+   int iCount = getBinarySectionChunks(iSection, &general, pChunks, uSizes);
+   u32 uSize = 0;
+   for( int k=0; k<iCount; k++ )
+      uSize += uSizes[k];
+   u8* pBuffer = (u8*) malloc(uSize);
+   if ( NULL == pBuffer )
+      return 0;
+   u8* pDest = pBuffer;
+   for( int k=0; k<iCount; k++ )
+   {
+      memcpy(pDest, pChunks[k], uSizes[k]);
+      pDest += uSizes[k];
+   }
+   u32 uCRC = crc32_compute(pBuffer, (int)uSize);
+   free(pBuffer);
+   return uCRC;
+}
+
+// filename is the text model file; the binary file is saved next to it
+bool Model::saveToBinaryFile(const char* filename)
+{
+   char szFile[MAX_FILE_PATH_SIZE];
+   char szFileTmp[MAX_FILE_PATH_SIZE+16];
+   _model_get_binary_file_name(filename, szFile);
+   snprintf(szFileTmp, sizeof(szFileTmp), "%s.%d", szFile, (int)getpid());
+
+   type_model_bin_general general;
+   fillBinaryGeneralSection(&general);
+
+   type_model_bin_header header;
+   memset(&header, 0, sizeof(header));
+   header.uMagic = MODEL_BIN_MAGIC;
+   header.uVersion = MODEL_BIN_VERSION;
+   header.iSaveCount = iSaveCount;
+   if ( ! _model_get_text_file_info(filename, &header.uTextFileSize, &header.uTextFileCRC, &header.iTextFileVersion) )
+      return false;
+
+   u8* pChunks[MODEL_BIN_MAX_CHUNKS];
+   u32 uSizes[MODEL_BIN_MAX_CHUNKS];
+   u32 uLayout[4+MODEL_BIN_SECTIONS_COUNT];
+   uLayout[0] = MODEL_BIN_VERSION;
+   uLayout[1] = SYSTEM_SW_VERSION_MAJOR;
+   uLayout[2] = SYSTEM_SW_VERSION_MINOR;
+   uLayout[3] = SYSTEM_SW_BUILD_NUMBER;
+
+   u32 uOffset = (sizeof(type_model_bin_header) + 7) & (~(u32)7);
+   for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+   {
+      int iCount = getBinarySectionChunks(i, &general, pChunks, uSizes);
+      header.sections[i].uOffset = uOffset;
+      header.sections[i].uSize = 0;
+      for( int k=0; k<iCount; k++ )
+         header.sections[i].uSize += uSizes[k];
+      uLayout[4+i] = header.sections[i].uSize;
+      uOffset += (header.sections[i].uSize + 7) & (~(u32)7);
+   }
+   header.uTotalSize = uOffset;
+   header.uLayoutId = crc32_compute((const u8*)uLayout, sizeof(uLayout));
+
+   u8* pBuffer = (u8*) malloc(header.uTotalSize);
+   if ( NULL == pBuffer )
+      return false;
+   memset(pBuffer, 0, header.uTotalSize);
+
+   for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+   {
+      int iCount = getBinarySectionChunks(i, &general, pChunks, uSizes);
+      u8* pDest = pBuffer + header.sections[i].uOffset;
+      for( int k=0; k<iCount; k++ )
+      {
+         memcpy(pDest, pChunks[k], uSizes[k]);
+         pDest += uSizes[k];
+      }
+      header.sections[i].uCRC = crc32_compute(pBuffer + header.sections[i].uOffset, (int)header.sections[i].uSize);
+      header.sections[i].iSaveCountChanged = iSaveCount;
+   }
+
+   // Keep track of the sections that did not change since the previous save
+   type_model_bin_header headerPrev;
+   bool bHasPrevious = false;
+   FILE* fd = fopen(szFile, "rb");
+   if ( NULL != fd )
+   {
+      if ( 1 == fread(&headerPrev, sizeof(headerPrev), 1, fd) )
+      if ( (headerPrev.uMagic == MODEL_BIN_MAGIC) && (headerPrev.uLayoutId == header.uLayoutId) )
+      if ( headerPrev.uHeaderCRC == _model_bin_get_header_crc(&headerPrev) )
+      {
+         bHasPrevious = true;
+         for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+         {
+            if ( headerPrev.sections[i].uCRC == header.sections[i].uCRC )
+               header.sections[i].iSaveCountChanged = headerPrev.sections[i].iSaveCountChanged;
+            else
+               header.uSectionsChangedMask |= ((u32)1) << i;
+         }
+      }
+      fclose(fd);
+   }
+   if ( ! bHasPrevious )
+      header.uSectionsChangedMask = (((u32)1) << MODEL_BIN_SECTIONS_COUNT) - 1;
+
+   header.uHeaderCRC = _model_bin_get_header_crc(&header);
+   memcpy(pBuffer, &header, sizeof(header));
+
+   // Written to a temporary file and renamed, so readers never map a partially written file
+   bool bOk = false;
+   fd = fopen(szFileTmp, "wb");
+   if ( NULL != fd )
+   {
+      if ( 1 == fwrite(pBuffer, header.uTotalSize, 1, fd) )
+         bOk = true;
+      if ( 0 != fclose(fd) )
+         bOk = false;
+   }
+   free(pBuffer);
+
+   if ( bOk && (0 != rename(szFileTmp, szFile)) )
+      bOk = false;
+   if ( ! bOk )
+   {
+      unlink(szFileTmp);
+      log_softerror_and_alarm("Failed to save binary model file: %s", szFile);
+      return false;
+   }
+
+   for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+      uBinarySectionsCRC[i] = header.sections[i].uCRC;
+   uBinarySectionsValidMask = (((u32)1) << MODEL_BIN_SECTIONS_COUNT) - 1;
+   return true;
+}
+
+// filename is the text model file; the binary file next to it is used only if it was saved together with the text file.
+// bOnlyChangedSections: copy only the sections that changed since this model was loaded from (or saved to) the binary file;
+// returns right away if the save count did not change.
+bool Model::loadFromBinaryFile(const char* filename, bool bLoadStats, bool bOnlyChangedSections)
+{
+   uLastLoadedBinarySectionsMask = 0;
+
+   char szFile[MAX_FILE_PATH_SIZE];
+   _model_get_binary_file_name(filename, szFile);
+
+   int fd = open(szFile, O_RDONLY);
+   if ( fd < 0 )
+      return false;
+   struct stat statBin;
+   if ( (0 != fstat(fd, &statBin)) || (statBin.st_size < (off_t)sizeof(type_model_bin_header)) )
+   {
+      close(fd);
+      return false;
+   }
+   u32 uMapSize = (u32)statBin.st_size;
+   u8* pMap = (u8*) mmap(NULL, uMapSize, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if ( MAP_FAILED == pMap )
+      return false;
+
+   type_model_bin_header header;
+   memcpy(&header, pMap, sizeof(header));
+
+   type_model_bin_general general;
+   u8* pChunks[MODEL_BIN_MAX_CHUNKS];
+   u32 uSizes[MODEL_BIN_MAX_CHUNKS];
+   u32 uLayout[4+MODEL_BIN_SECTIONS_COUNT];
+   uLayout[0] = MODEL_BIN_VERSION;
+   uLayout[1] = SYSTEM_SW_VERSION_MAJOR;
+   uLayout[2] = SYSTEM_SW_VERSION_MINOR;
+   uLayout[3] = SYSTEM_SW_BUILD_NUMBER;
+   for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+   {
+      int iCount = getBinarySectionChunks(i, &general, pChunks, uSizes);
+      uLayout[4+i] = 0;
+      for( int k=0; k<iCount; k++ )
+         uLayout[4+i] += uSizes[k];
+   }
+
+   bool bValid = true;
+   if ( (header.uMagic != MODEL_BIN_MAGIC) || (header.uVersion != MODEL_BIN_VERSION) || (header.uTotalSize != uMapSize) )
+      bValid = false;
+   else if ( header.uHeaderCRC != _model_bin_get_header_crc(&header) )
+      bValid = false;
+   else if ( header.uLayoutId != crc32_compute((const u8*)uLayout, sizeof(uLayout)) )
+      bValid = false;
+   else
+   {
+      // Text file was changed without saving the binary file (i.e. copied or imported)
+      u32 uTextSize = 0, uTextCRC = 0;
+      int iTextVersion = 0;
+      if ( ! _model_get_text_file_info(filename, &uTextSize, &uTextCRC, &iTextVersion) )
+         bValid = false;
+      else if ( (uTextSize != header.uTextFileSize) || (uTextCRC != header.uTextFileCRC) )
+         bValid = false;
+   }
+
+   if ( ! bValid )
+   {
+      munmap(pMap, uMapSize);
+      return false;
+   }
+
+   if ( bOnlyChangedSections && (header.iSaveCount == iSaveCount) )
+   {
+      munmap(pMap, uMapSize);
+      return true;
+   }
+
+   // Check all the sections to load first, so that nothing is changed if any of them is invalid
+   u32 uMaskToLoad = 0;
+   for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+   {
+      if ( (MODEL_BIN_SECTION_STATS == i) && (! bLoadStats) )
+         continue;
+      if ( bOnlyChangedSections && (uBinarySectionsValidMask & (((u32)1) << i)) )
+      if ( uBinarySectionsCRC[i] == header.sections[i].uCRC )
+         continue;
+      if ( (header.sections[i].uSize != uLayout[4+i]) || (header.sections[i].uOffset + header.sections[i].uSize > uMapSize) ||
+           (header.sections[i].uCRC != crc32_compute(pMap + header.sections[i].uOffset, (int)header.sections[i].uSize)) )
+      {
+         log_softerror_and_alarm("Invalid binary model file: %s (section %d), ignoring it.", szFile, i);
+         munmap(pMap, uMapSize);
+         return false;
+      }
+      uMaskToLoad |= ((u32)1) << i;
+   }
+
+   for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+   {
+      if ( ! (uMaskToLoad & (((u32)1) << i)) )
+         continue;
+      int iCount = getBinarySectionChunks(i, &general, pChunks, uSizes);
+      u8* pSrc = pMap + header.sections[i].uOffset;
+      for( int k=0; k<iCount; k++ )
+      {
+         memcpy(pChunks[k], pSrc, uSizes[k]);
+         pSrc += uSizes[k];
+      }
+      uBinarySectionsCRC[i] = header.sections[i].uCRC;
+      uBinarySectionsValidMask |= ((u32)1) << i;
+   }
+   munmap(pMap, uMapSize);
+
+   if ( ! bLoadStats )
+      uBinarySectionsValidMask &= ~(((u32)1) << MODEL_BIN_SECTION_STATS);
+
+   if ( uMaskToLoad & (((u32)1) << MODEL_BIN_SECTION_GENERAL) )
+   {
+      uModelFlags = general.uModelFlags;
+      uModelPersistentStatusFlags = general.uModelPersistentStatusFlags;
+      uDeveloperFlags = general.uDeveloperFlags;
+      memcpy(vehicle_name, general.vehicle_name, MAX_VEHICLE_NAME_LENGTH);
+      vehicle_name[MAX_VEHICLE_NAME_LENGTH-1] = 0;
+      uVehicleId = general.uVehicleId;
+      uControllerId = general.uControllerId;
+      uControllerBoardType = general.uControllerBoardType;
+      sw_version = general.sw_version;
+      if ( hardware_is_vehicle() )
+         sw_version = (SYSTEM_SW_VERSION_MAJOR * 256 + SYSTEM_SW_VERSION_MINOR) | (SYSTEM_SW_BUILD_NUMBER<<16);
+      is_spectator = (bool)general.is_spectator;
+      vehicle_type = general.vehicle_type;
+      enableDHCP = (bool)general.enableDHCP;
+      rxtx_sync_type = general.rxtx_sync_type;
+      alarms = general.alarms;
+      camera_rc_channels = general.camera_rc_channels;
+      enc_flags = general.enc_flags;
+      iGPSCount = general.iGPSCount;
+      constructLongName();
+   }
+
+   // Same bounds checks as when loading the text file (stale or foreign binary file)
+   if ( 0 != uMaskToLoad )
+   {
+      validateLoadedSettings();
+      // Sections changed by the validation no longer match their binary CRCs
+      for( int i=0; i<MODEL_BIN_SECTIONS_COUNT; i++ )
+      {
+         if ( ! (uBinarySectionsValidMask & (((u32)1) << i)) )
+            continue;
+         if ( computeBinarySectionCRC(i) != uBinarySectionsCRC[i] )
+         {
+            log_line("Model: binary section %d changed by the settings validation.", i);
+            uBinarySectionsValidMask &= ~(((u32)1) << i);
+         }
+      }
+   }
+   iSaveCount = header.iSaveCount;
+   iLoadedFileVersion = header.iTextFileVersion;
+   uLastLoadedBinarySectionsMask = uMaskToLoad;
+   return true;
+}
+
+u32 Model::getLastLoadedBinarySectionsMask()
+{
+   return uLastLoadedBinarySectionsMask;
+}
+
 
 bool Model::saveVersion12(FILE* fd, bool isOnController)
 {
@@ -2556,7 +3028,7 @@ bool Model::saveVersion12(FILE* fd, bool isOnController)
       strcat(szModel, szSetting);
       sprintf(szSetting, "%d %d %d %d\n", camera_params[k].profiles[i].exposure, camera_params[k].profiles[i].whitebalance, camera_params[k].profiles[i].metering, camera_params[k].profiles[i].drc);
       strcat(szModel, szSetting);
-      sprintf(szSetting, "%f %f %f", camera_params[k].profiles[i].analogGain, camera_params[k].profiles[i].awbGainB, camera_params[k].profiles[i].awbGainR);
+      sprintf(szSetting, "%f %f %f ", camera_params[k].profiles[i].analogGain, camera_params[k].profiles[i].awbGainB, camera_params[k].profiles[i].awbGainR);
       strcat(szModel, szSetting);
       sprintf(szSetting, "%f %f ", camera_params[k].profiles[i].fovH, camera_params[k].profiles[i].fovV);
       strcat(szModel, szSetting);
@@ -3893,6 +4365,21 @@ bool Model::validateVideoProfilesMaxVideoBitrate()
    return bUpdated;
 }
 
+// Run on the settings loaded from a text or binary model file
+void Model::validateLoadedSettings()
+{
+   validate_settings();
+
+   if ( telemetry_params.vehicle_mavlink_id <= 0 || telemetry_params.vehicle_mavlink_id > 255 )
+      telemetry_params.vehicle_mavlink_id = DEFAULT_MAVLINK_SYS_ID_VEHICLE;
+   if ( telemetry_params.controller_mavlink_id <= 0 || telemetry_params.controller_mavlink_id > 255 )
+      telemetry_params.controller_mavlink_id = DEFAULT_MAVLINK_SYS_ID_CONTROLLER;
+   if ( telemetry_params.flags == 0 )
+      telemetry_params.flags = TELEMETRY_FLAGS_REQUEST_DATA_STREAMS | TELEMETRY_FLAGS_SPECTATOR_ENABLE;
+   if ( rxtx_sync_type < 0 || rxtx_sync_type >= RXTX_SYNC_TYPE_LAST )
+      rxtx_sync_type = RXTX_SYNC_TYPE_BASIC;
+}
+
 bool Model::validate_settings()
 {
    log_line("Model: Validating model settings...");
@@ -4506,6 +4993,21 @@ void Model::resetToDefaults(bool generateId)
    else
       uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_PCAP_RADIO_TX);
 
+   if ( DEFAULT_USE_MMAP_RING_FOR_RX )
+      uDeveloperFlags |= DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX;
+   else
+      uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX);
+
+   if ( DEFAULT_USE_BATCHED_RADIO_TX )
+      uDeveloperFlags |= DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX;
+   else
+      uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX);
+
+   if ( DEFAULT_USE_PACED_VIDEO_TX )
+      uDeveloperFlags |= DEVELOPER_FLAGS_USE_PACED_VIDEO_TX;
+   else
+      uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_PACED_VIDEO_TX);
+
    radioInterfacesParams.interfaces_count = 0;
    resetRadioLinksParams();
 
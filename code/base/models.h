@@ -515,6 +515,22 @@ typedef struct
    u32 uDummyHW2;
 } type_hardware_capabilities;
 
+// Binary model file: saved next to the text model file (same name, .mdb extension) on each save.
+// It's memory mapped and checked (header and sections CRCs) on load, much faster than parsing the text file.
+// The model is split in sections; a reload copies only the sections changed since the last load.
+// The text file is still saved on each save and it's the import/export format; it's used when the
+// binary file is missing, invalid (other software build) or was not saved together with the text file.
+#define MODEL_BIN_SECTION_GENERAL 0
+#define MODEL_BIN_SECTION_HARDWARE 1
+#define MODEL_BIN_SECTION_RADIO 2
+#define MODEL_BIN_SECTION_STATS 3
+#define MODEL_BIN_SECTION_CAMERA 4
+#define MODEL_BIN_SECTION_VIDEO 5
+#define MODEL_BIN_SECTION_OSD 6
+#define MODEL_BIN_SECTION_RC 7
+#define MODEL_BIN_SECTION_TELEMETRY 8
+#define MODEL_BIN_SECTIONS_COUNT 9
+
 class Model
 {
    public:
@@ -609,8 +625,14 @@ class Model
       type_alarms_parameters alarms_params;
 
       bool reloadIfChanged(bool bLoadStats);
+      bool reloadFromFileIfChanged(const char* filename, bool bLoadStats);
       bool loadFromFile(const char* filename, bool bLoadStats = false);
+      bool loadFromTextFile(const char* filename);
       bool saveToFile(const char* filename, bool isOnController);
+      bool saveToTextFile(const char* filename, bool isOnController);
+      bool loadFromBinaryFile(const char* filename, bool bLoadStats, bool bOnlyChangedSections);
+      bool saveToBinaryFile(const char* filename);
+      u32  getLastLoadedBinarySectionsMask();
       int  getLoadedFileVersion();
       bool isRunningOnOpenIPCHardware();
       bool isRunningOnPiHardware();
@@ -740,8 +762,15 @@ class Model
       char vehicle_long_name[256];
       int iLoadedFileVersion;
       int iSaveCount;
+      u32 uBinarySectionsCRC[MODEL_BIN_SECTIONS_COUNT]; // CRC of each section as last loaded from/saved to the binary file
+      u32 uBinarySectionsValidMask; // sections for which the CRC above matches the content in memory
+      u32 uLastLoadedBinarySectionsMask;
 
       void generateUID();
+      int  getBinarySectionChunks(int iSection, void* pGeneral, u8** pChunks, u32* pSizes);
+      void fillBinaryGeneralSection(void* pGeneral);
+      u32  computeBinarySectionCRC(int iSection);
+      void validateLoadedSettings();
       bool loadVersion10(FILE* fd); // from 7.6
       bool loadVersion11(FILE* fd); // from 11.5
       bool loadVersion12(FILE* fd); // from 11.7.07
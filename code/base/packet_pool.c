@@ -0,0 +1,301 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pthread.h>
+#include "packet_pool.h"
+
+#define PACKET_POOL_MAGIC 0x50504B54
+// Buffers moved at once between a thread free list and the global free list
+#define PACKET_POOL_BATCH 32
+
+typedef struct type_packet_pool_buffer
+{
+   u32 uMagic;
+   _ATOMIC_PREFIX u32 uRefCount;
+   int iLength;
+   struct type_packet_pool_buffer* pNextFree;
+} type_packet_pool_buffer;
+
+typedef struct
+{
+   type_packet_pool_buffer* pFirst;
+   int iCount;
+} type_packet_pool_thread_cache;
+
+// [header][headroom][data], header and data on cache line boundaries
+#define PACKET_POOL_HEADER_SIZE (((int)sizeof(type_packet_pool_buffer) + PACKET_POOL_CACHE_LINE - 1) & ~(PACKET_POOL_CACHE_LINE - 1))
+#define PACKET_POOL_DATA_OFFSET (PACKET_POOL_HEADER_SIZE + PACKET_POOL_HEADROOM)
+#define PACKET_POOL_BUFFER_SIZE ((PACKET_POOL_DATA_OFFSET + PACKET_POOL_DATA_SIZE + PACKET_POOL_CACHE_LINE - 1) & ~(PACKET_POOL_CACHE_LINE - 1))
+#define PACKET_POOL_SLAB_SIZE (PACKET_POOL_SLAB_BUFFERS * PACKET_POOL_BUFFER_SIZE)
+
+static pthread_mutex_t s_MutexPacketPool = PTHREAD_MUTEX_INITIALIZER;
+static type_packet_pool_buffer* s_pPacketPoolFreeList = NULL;
+static u8* s_pPacketPoolSlabs[PACKET_POOL_MAX_SLABS];
+static _ATOMIC_PREFIX u32 s_uPacketPoolSlabsCount = 0;
+static int s_iPacketPoolHandoffEnabled = 1;
+static __thread type_packet_pool_thread_cache s_PacketPoolThreadCache = { NULL, 0 };
+
+static u64 s_uPacketPoolAllocations = 0;
+static u64 s_uPacketPoolFrees = 0;
+static u64 s_uPacketPoolCopies = 0;
+static u64 s_uPacketPoolBytesCopied = 0;
+static u64 s_uPacketPoolBytesZeroed = 0;
+
+static type_packet_pool_buffer* _packet_pool_get_header(u8* pBuffer)
+{
+   return (type_packet_pool_buffer*)(pBuffer - PACKET_POOL_DATA_OFFSET);
+}
+
+// Called with the pool mutex locked
+static int _packet_pool_add_slab()
+{
+   u32 uSlabs = s_uPacketPoolSlabsCount;
+   if ( uSlabs >= PACKET_POOL_MAX_SLABS )
+   {
+      static int s_iErrorLoggedPoolFull = 0;
+      if ( ! s_iErrorLoggedPoolFull )
+         log_softerror_and_alarm("[PacketPool] Reached the max pool size (%d buffers).", PACKET_POOL_MAX_SLABS * PACKET_POOL_SLAB_BUFFERS);
+      s_iErrorLoggedPoolFull = 1;
+      return 0;
+   }
+   void* pSlab = NULL;
+   if ( 0 != posix_memalign(&pSlab, PACKET_POOL_CACHE_LINE, PACKET_POOL_SLAB_SIZE) )
+   {
+      log_error_and_alarm("[PacketPool] Failed to allocate %d packet buffers.", PACKET_POOL_SLAB_BUFFERS);
+      return 0;
+   }
+   for( int i=PACKET_POOL_SLAB_BUFFERS-1; i>=0; i-- )
+   {
+      type_packet_pool_buffer* pBuffer = (type_packet_pool_buffer*)((u8*)pSlab + i*PACKET_POOL_BUFFER_SIZE);
+      pBuffer->uMagic = PACKET_POOL_MAGIC;
+      pBuffer->uRefCount = 0;
+      pBuffer->iLength = 0;
+      pBuffer->pNextFree = s_pPacketPoolFreeList;
+      s_pPacketPoolFreeList = pBuffer;
+   }
+   s_pPacketPoolSlabs[uSlabs] = (u8*)pSlab;
+   __atomic_store_n(&s_uPacketPoolSlabsCount, uSlabs+1, __ATOMIC_RELEASE);
+   return 1;
+}
+
+static void _packet_pool_refill_thread_cache(type_packet_pool_thread_cache* pCache)
+{
+   pthread_mutex_lock(&s_MutexPacketPool);
+   if ( NULL == s_pPacketPoolFreeList )
+      _packet_pool_add_slab();
+   while ( (NULL != s_pPacketPoolFreeList) && (pCache->iCount < PACKET_POOL_BATCH) )
+   {
+      type_packet_pool_buffer* pBuffer = s_pPacketPoolFreeList;
+      s_pPacketPoolFreeList = pBuffer->pNextFree;
+      pBuffer->pNextFree = pCache->pFirst;
+      pCache->pFirst = pBuffer;
+      pCache->iCount++;
+   }
+   pthread_mutex_unlock(&s_MutexPacketPool);
+}
+
+// Moves up to iCount buffers from the thread free list to the global free list
+static void _packet_pool_flush_thread_cache(type_packet_pool_thread_cache* pCache, int iCount)
+{
+   if ( NULL == pCache->pFirst )
+      return;
+   type_packet_pool_buffer* pFirst = pCache->pFirst;
+   type_packet_pool_buffer* pLast = pFirst;
+   int iMoved = 1;
+   while ( (iMoved < iCount) && (NULL != pLast->pNextFree) )
+   {
+      pLast = pLast->pNextFree;
+      iMoved++;
+   }
+   pCache->pFirst = pLast->pNextFree;
+   pCache->iCount -= iMoved;
+
+   pthread_mutex_lock(&s_MutexPacketPool);
+   pLast->pNextFree = s_pPacketPoolFreeList;
+   s_pPacketPoolFreeList = pFirst;
+   pthread_mutex_unlock(&s_MutexPacketPool);
+}
+
+u8* packet_pool_alloc()
+{
+   type_packet_pool_thread_cache* pCache = &s_PacketPoolThreadCache;
+   if ( NULL == pCache->pFirst )
+   {
+      _packet_pool_refill_thread_cache(pCache);
+      if ( NULL == pCache->pFirst )
+         return NULL;
+   }
+   type_packet_pool_buffer* pBuffer = pCache->pFirst;
+   pCache->pFirst = pBuffer->pNextFree;
+   pCache->iCount--;
+
+   pBuffer->pNextFree = NULL;
+   pBuffer->iLength = 0;
+   __atomic_store_n(&pBuffer->uRefCount, 1, __ATOMIC_RELAXED);
+   __atomic_add_fetch(&s_uPacketPoolAllocations, 1, __ATOMIC_RELAXED);
+   return (u8*)pBuffer + PACKET_POOL_DATA_OFFSET;
+}
+
+u8* packet_pool_alloc_copy(const u8* pData, int iLength)
+{
+   if ( (NULL == pData) || (iLength < 0) || (iLength > PACKET_POOL_DATA_SIZE) )
+      return NULL;
+   u8* pBuffer = packet_pool_alloc();
+   if ( NULL == pBuffer )
+      return NULL;
+   memcpy(pBuffer, pData, iLength);
+   _packet_pool_get_header(pBuffer)->iLength = iLength;
+   packet_pool_count_copy(iLength);
+   return pBuffer;
+}
+
+void packet_pool_ref(u8* pBuffer)
+{
+   if ( NULL == pBuffer )
+      return;
+   __atomic_add_fetch(&_packet_pool_get_header(pBuffer)->uRefCount, 1, __ATOMIC_RELAXED);
+}
+
+void packet_pool_unref(u8* pBuffer)
+{
+   if ( NULL == pBuffer )
+      return;
+   type_packet_pool_buffer* pHeader = _packet_pool_get_header(pBuffer);
+   if ( 0 != __atomic_sub_fetch(&pHeader->uRefCount, 1, __ATOMIC_ACQ_REL) )
+      return;
+
+   type_packet_pool_thread_cache* pCache = &s_PacketPoolThreadCache;
+   pHeader->pNextFree = pCache->pFirst;
+   pCache->pFirst = pHeader;
+   pCache->iCount++;
+   __atomic_add_fetch(&s_uPacketPoolFrees, 1, __ATOMIC_RELAXED);
+
+   // Buffers freed by a consumer thread are usually allocated by a producer thread: give them back in batches
+   if ( pCache->iCount >= 2*PACKET_POOL_BATCH )
+      _packet_pool_flush_thread_cache(pCache, PACKET_POOL_BATCH);
+}
+
+int packet_pool_get_ref_count(u8* pBuffer)
+{
+   if ( NULL == pBuffer )
+      return 0;
+   return (int)__atomic_load_n(&_packet_pool_get_header(pBuffer)->uRefCount, __ATOMIC_ACQUIRE);
+}
+
+void packet_pool_set_length(u8* pBuffer, int iLength)
+{
+   if ( (NULL == pBuffer) || (iLength < 0) || (iLength > PACKET_POOL_DATA_SIZE) )
+      return;
+   _packet_pool_get_header(pBuffer)->iLength = iLength;
+}
+
+int packet_pool_get_length(u8* pBuffer)
+{
+   if ( NULL == pBuffer )
+      return 0;
+   return _packet_pool_get_header(pBuffer)->iLength;
+}
+
+u8* packet_pool_get_headroom(u8* pBuffer)
+{
+   if ( NULL == pBuffer )
+      return NULL;
+   return pBuffer - PACKET_POOL_HEADROOM;
+}
+
+u8* packet_pool_get_handoff_buffer(const u8* pData, int iLength)
+{
+   if ( (NULL == pData) || (! s_iPacketPoolHandoffEnabled) )
+      return NULL;
+
+   u32 uSlabs = __atomic_load_n(&s_uPacketPoolSlabsCount, __ATOMIC_ACQUIRE);
+   for( u32 u=0; u<uSlabs; u++ )
+   {
+      u8* pSlab = s_pPacketPoolSlabs[u];
+      if ( (pData < pSlab) || (pData >= pSlab + PACKET_POOL_SLAB_SIZE) )
+         continue;
+      if ( ((pData - pSlab) % PACKET_POOL_BUFFER_SIZE) != PACKET_POOL_DATA_OFFSET )
+         return NULL;
+      type_packet_pool_buffer* pHeader = _packet_pool_get_header((u8*)pData);
+      if ( (pHeader->uMagic != PACKET_POOL_MAGIC) || (pHeader->iLength != iLength) || (0 == pHeader->uRefCount) )
+         return NULL;
+      return (u8*)pData;
+   }
+   return NULL;
+}
+
+void packet_pool_set_handoff_enabled(int iEnabled)
+{
+   s_iPacketPoolHandoffEnabled = iEnabled;
+}
+
+int packet_pool_is_handoff_enabled()
+{
+   return s_iPacketPoolHandoffEnabled;
+}
+
+void packet_pool_flush_thread_cache()
+{
+   type_packet_pool_thread_cache* pCache = &s_PacketPoolThreadCache;
+   _packet_pool_flush_thread_cache(pCache, pCache->iCount);
+}
+
+void packet_pool_count_copy(int iBytes)
+{
+   __atomic_add_fetch(&s_uPacketPoolCopies, 1, __ATOMIC_RELAXED);
+   __atomic_add_fetch(&s_uPacketPoolBytesCopied, (u64)iBytes, __ATOMIC_RELAXED);
+}
+
+void packet_pool_count_zeroed(int iBytes)
+{
+   __atomic_add_fetch(&s_uPacketPoolBytesZeroed, (u64)iBytes, __ATOMIC_RELAXED);
+}
+
+void packet_pool_get_stats(type_packet_pool_stats* pStats)
+{
+   if ( NULL == pStats )
+      return;
+   pStats->uSlabs = __atomic_load_n(&s_uPacketPoolSlabsCount, __ATOMIC_ACQUIRE);
+   pStats->uBuffersTotal = pStats->uSlabs * PACKET_POOL_SLAB_BUFFERS;
+   pStats->uAllocations = __atomic_load_n(&s_uPacketPoolAllocations, __ATOMIC_RELAXED);
+   pStats->uBuffersInUse = (u32)(pStats->uAllocations - __atomic_load_n(&s_uPacketPoolFrees, __ATOMIC_RELAXED));
+   pStats->uCopies = __atomic_load_n(&s_uPacketPoolCopies, __ATOMIC_RELAXED);
+   pStats->uBytesCopied = __atomic_load_n(&s_uPacketPoolBytesCopied, __ATOMIC_RELAXED);
+   pStats->uBytesZeroed = __atomic_load_n(&s_uPacketPoolBytesZeroed, __ATOMIC_RELAXED);
+}
+
+void packet_pool_reset_stats()
+{
+   __atomic_store_n(&s_uPacketPoolCopies, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&s_uPacketPoolBytesCopied, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&s_uPacketPoolBytesZeroed, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "base.h"
+#include "config.h"
+#include "../radio/radiopackets2.h"
+
+// Pool of reference counted radio packet buffers, shared by the radio rx queues, the packets queues and the
+// video rx buffers, so a packet can be passed between them as a handle instead of being copied.
+// A buffer is referenced by the pointer to its data area. Each buffer has PACKET_POOL_DATA_SIZE bytes of data,
+// cache line aligned, preceded by PACKET_POOL_HEADROOM free bytes (room for the radiotap and IEEE headers).
+// Freed buffers go to a per thread free list, moved in batches to/from a global free list, so alloc/free
+// don't take a lock in the common case. The pool grows in slabs, never shrinks.
+// A buffer shared by more than one reference is read only.
+
+#define PACKET_POOL_CACHE_LINE 64
+#define PACKET_POOL_HEADROOM 64
+#define PACKET_POOL_DATA_SIZE MAX_PACKET_TOTAL_SIZE
+#define PACKET_POOL_SLAB_BUFFERS 256
+#define PACKET_POOL_MAX_SLABS 128
+
+typedef struct
+{
+   u32 uSlabs;
+   u32 uBuffersTotal;
+   u32 uBuffersInUse;
+   u64 uAllocations;
+   u64 uCopies;       // packets copied between buffers
+   u64 uBytesCopied;
+   u64 uBytesZeroed;  // padding zeroed for the EC decoding
+} type_packet_pool_stats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns a buffer with a reference count of 1 and a length of 0, NULL if out of memory
+u8* packet_pool_alloc();
+// Allocates a buffer and copies the packet in it
+u8* packet_pool_alloc_copy(const u8* pData, int iLength);
+void packet_pool_ref(u8* pBuffer);
+// Buffer goes back to the pool when the last reference is released
+void packet_pool_unref(u8* pBuffer);
+int packet_pool_get_ref_count(u8* pBuffer);
+
+// Bytes used in the buffer data area, set by the owner
+void packet_pool_set_length(u8* pBuffer, int iLength);
+int packet_pool_get_length(u8* pBuffer);
+// Start of the headroom: PACKET_POOL_HEADROOM bytes before the data
+u8* packet_pool_get_headroom(u8* pBuffer);
+
+// Returns the pool buffer if pData/iLength is the whole content of a pool buffer (so a receiver can keep a
+// reference to it instead of copying it, and use the rest of the data area), NULL otherwise or if hand off is disabled
+u8* packet_pool_get_handoff_buffer(const u8* pData, int iLength);
+// On by default; turned off only to measure the copying paths
+void packet_pool_set_handoff_enabled(int iEnabled);
+int packet_pool_is_handoff_enabled();
+
+// Moves the buffers of the calling thread free list to the global free list. For threads that exit.
+void packet_pool_flush_thread_cache();
+
+void packet_pool_count_copy(int iBytes);
+void packet_pool_count_zeroed(int iBytes);
+void packet_pool_get_stats(type_packet_pool_stats* pStats);
+// Resets the copy counters only, the buffers in use are still counted
+void packet_pool_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
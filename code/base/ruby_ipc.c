@@ -32,6 +32,7 @@
 #include "base.h"
 #include "config.h"
 #include "ruby_ipc.h"
+#include "ruby_ipc_shm_ring.h"
 #include "hardware.h"
 #include "hardware_procs.h"
 #include "../common/string_utils.h"
@@ -43,7 +44,13 @@
 #include <errno.h>
 
 //#define RUBY_USE_FIFO_PIPES 1
+// RUBY_USES_SHM_RINGS is set at build time (make RUBY_IPC_SHM_RINGS=1); all processes must use the same transport
+#ifndef RUBY_USES_SHM_RINGS
 #define RUBY_USES_MSGQUEUES 1
+#endif
+
+// Messages already have the packet CRC; enable to also check the shared memory ring slots
+//#define RUBY_IPC_SHM_RINGS_CRC 1
 
 #define FIFO_RUBY_ROUTER_TO_CENTRAL "/tmp/ruby/fiforoutercentral"
 #define FIFO_RUBY_CENTRAL_TO_ROUTER "/tmp/ruby/fifocentralrouter"
@@ -59,12 +66,19 @@
 #define PROFILE_IPC_MAX_TIME 20
 
 #define MAX_CHANNELS 16
+#define MAX_CHANNELS_IDS_LOOKUP 64 // power of 2
 
 int s_iRubyIPCChannelsUniqueIds[MAX_CHANNELS];
 int s_iRubyIPCChannelsFd[MAX_CHANNELS];
 int s_iRubyIPCChannelsType[MAX_CHANNELS];
 u8  s_uRubyIPCChannelsMsgId[MAX_CHANNELS];
 key_t s_uRubyIPCChannelsKeys[MAX_CHANNELS];
+#ifdef RUBY_USES_SHM_RINGS
+type_ruby_ipc_shm_ring s_RubyIPCChannelsRings[MAX_CHANNELS];
+#endif
+
+// Channel index for a channel unique id (hashed on the low bits of the id); checked against s_iRubyIPCChannelsUniqueIds
+static int s_iRubyIPCChannelIndexForId[MAX_CHANNELS_IDS_LOOKUP];
 
 static int s_iRubyIPCChannelsUniqueIdCounter = 1;
 
@@ -149,6 +163,27 @@ char* _ruby_ipc_get_pipe_name(int nChannelType )
 }
 
 
+static int _ruby_ipc_get_channel_index(int iChannelUniqueId)
+{
+   if ( iChannelUniqueId <= 0 )
+      return -1;
+   int iIndex = s_iRubyIPCChannelIndexForId[iChannelUniqueId & (MAX_CHANNELS_IDS_LOOKUP-1)];
+   if ( (iIndex >= 0) && (iIndex < s_iRubyIPCChannelsCount) && (s_iRubyIPCChannelsUniqueIds[iIndex] == iChannelUniqueId) )
+      return iIndex;
+
+   // Two opened channels have ids with the same low bits
+   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
+         return i;
+   return -1;
+}
+
+static void _ruby_ipc_update_channels_lookup()
+{
+   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+      s_iRubyIPCChannelIndexForId[s_iRubyIPCChannelsUniqueIds[i] & (MAX_CHANNELS_IDS_LOOKUP-1)] = i;
+}
+
 void _ruby_ipc_log_channels()
 {
    log_line("[IPC] Currently opened channels: %d:", s_iRubyIPCChannelsCount);
@@ -164,6 +199,17 @@ void _ruby_ipc_log_channel_info(int iChannelType, int iChannelId, int iChannelFd
 {
    if ( iChannelFd < 0 )
       return;
+   #ifdef RUBY_USES_SHM_RINGS
+   int iIndex = _ruby_ipc_get_channel_index(iChannelId);
+   if ( (iIndex >= 0) && (NULL != s_RubyIPCChannelsRings[iIndex].pHeader) )
+      log_line("[IPC] Channel %s (id: %d, fd: %d) info: %d pending messages, %u slots, %u full ring errors, %u stale slots skipped",
+         _ruby_ipc_get_channel_name(iChannelType), iChannelId, iChannelFd,
+         ruby_ipc_shm_ring_get_pending_count(&s_RubyIPCChannelsRings[iIndex]),
+         s_RubyIPCChannelsRings[iIndex].pHeader->uSlotsCount,
+         s_RubyIPCChannelsRings[iIndex].pHeader->uTotalFullErrors,
+         s_RubyIPCChannelsRings[iIndex].pHeader->uTotalStaleSlotsSkipped);
+   return;
+   #endif
    struct msqid_ds msg_stats;
    if ( 0 != msgctl(iChannelFd, IPC_STAT, &msg_stats) )
       log_softerror_and_alarm("[IPC] Failed to get statistics on ICP message queue %s, id %d, fd %d",
@@ -267,6 +313,17 @@ void ruby_clear_all_ipc_channels()
 
    #endif
 
+   #ifdef RUBY_USES_SHM_RINGS
+
+   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+   {
+      ruby_ipc_shm_ring_close(&s_RubyIPCChannelsRings[i]);
+      ruby_ipc_shm_ring_remove(s_iRubyIPCChannelsType[i]);
+   }
+   s_iRubyIPCChannelsCount = 0;
+
+   #endif
+
    log_line("[IPC] Done clearing all IPC channels.");
 }
 
@@ -347,10 +404,27 @@ int ruby_open_ipc_channel_write_endpoint(int nChannelType)
 
    #endif
 
+   #ifdef RUBY_USES_SHM_RINGS
+
+   u32 uRingFlags = 0;
+   #ifdef RUBY_IPC_SHM_RINGS_CRC
+   uRingFlags |= RUBY_IPC_SHM_RING_FLAG_CRC;
+   #endif
+   if ( ! ruby_ipc_shm_ring_open(&s_RubyIPCChannelsRings[s_iRubyIPCChannelsCount], nChannelType, RUBY_IPC_SHM_RING_DEFAULT_SLOTS, uRingFlags) )
+   {
+      log_softerror_and_alarm("[IPC] Failed to create IPC shared memory ring write endpoint for channel %s", _ruby_ipc_get_channel_name(nChannelType));
+      return -1;
+   }
+   s_uRubyIPCChannelsKeys[s_iRubyIPCChannelsCount] = 0;
+   s_iRubyIPCChannelsFd[s_iRubyIPCChannelsCount] = s_RubyIPCChannelsRings[s_iRubyIPCChannelsCount].iFd;
+
+   #endif
+
    s_iRubyIPCChannelsUniqueIds[s_iRubyIPCChannelsCount] = s_iRubyIPCChannelsUniqueIdCounter;
    s_iRubyIPCChannelsUniqueIdCounter++;
 
    s_iRubyIPCChannelsCount++;
+   _ruby_ipc_update_channels_lookup();
    
    log_line("[IPC] Opened IPC channel %s write endpoint: success, fd: %d, id: %d. (%d channels currently opened).",
       _ruby_ipc_get_channel_name(nChannelType), s_iRubyIPCChannelsFd[s_iRubyIPCChannelsCount-1], s_iRubyIPCChannelsUniqueIds[s_iRubyIPCChannelsCount-1], s_iRubyIPCChannelsCount);
@@ -433,10 +507,27 @@ int ruby_open_ipc_channel_read_endpoint(int nChannelType)
    //   log_line("[IPC] IPC channels pools max: %u bytes, max msg size: %u bytes, max msg queue total size: %u bytes", (u32)msg_info.msgpool, (u32)msg_info.msgmax, (u32)msg_info.msgmnb);
    #endif
 
+   #ifdef RUBY_USES_SHM_RINGS
+
+   u32 uRingFlags = 0;
+   #ifdef RUBY_IPC_SHM_RINGS_CRC
+   uRingFlags |= RUBY_IPC_SHM_RING_FLAG_CRC;
+   #endif
+   if ( ! ruby_ipc_shm_ring_open(&s_RubyIPCChannelsRings[s_iRubyIPCChannelsCount], nChannelType, RUBY_IPC_SHM_RING_DEFAULT_SLOTS, uRingFlags) )
+   {
+      log_softerror_and_alarm("[IPC] Failed to create IPC shared memory ring read endpoint for channel %s", _ruby_ipc_get_channel_name(nChannelType));
+      return -1;
+   }
+   s_uRubyIPCChannelsKeys[s_iRubyIPCChannelsCount] = 0;
+   s_iRubyIPCChannelsFd[s_iRubyIPCChannelsCount] = s_RubyIPCChannelsRings[s_iRubyIPCChannelsCount].iFd;
+
+   #endif
+
    s_iRubyIPCChannelsUniqueIds[s_iRubyIPCChannelsCount] = s_iRubyIPCChannelsUniqueIdCounter;
    s_iRubyIPCChannelsUniqueIdCounter++;
 
    s_iRubyIPCChannelsCount++;
+   _ruby_ipc_update_channels_lookup();
    
    log_line("[IPC] Opened IPC channel %s read endpoint: success, fd: %d, id: %d. (%d channels currently opened).",
       _ruby_ipc_get_channel_name(nChannelType), s_iRubyIPCChannelsFd[s_iRubyIPCChannelsCount-1], s_iRubyIPCChannelsUniqueIds[s_iRubyIPCChannelsCount-1], s_iRubyIPCChannelsCount);
@@ -449,16 +540,9 @@ int ruby_open_ipc_channel_read_endpoint(int nChannelType)
 int ruby_close_ipc_channel(int iChannelUniqueId)
 {
    int fdToClose = 0;
-   int iChannelIndex = -1;
-   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
-   {
-      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
-      {
-         fdToClose = s_iRubyIPCChannelsFd[i];
-         iChannelIndex = i;
-         break;
-      }
-   }
+   int iChannelIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 != iChannelIndex )
+      fdToClose = s_iRubyIPCChannelsFd[iChannelIndex];
 
    if ( (iChannelUniqueId < 0) || (fdToClose < 0) || (-1 == iChannelIndex) )
    {
@@ -478,6 +562,11 @@ int ruby_close_ipc_channel(int iChannelUniqueId)
    msgctl(fdToClose,IPC_RMID,NULL);
    #endif
 
+   #ifdef RUBY_USES_SHM_RINGS
+   ruby_ipc_shm_ring_close(&s_RubyIPCChannelsRings[iChannelIndex]);
+   ruby_ipc_shm_ring_remove(s_iRubyIPCChannelsType[iChannelIndex]);
+   #endif
+
 
    log_line("[IPC] Closed IPC channel %s, channel index %d, unique id %d, fd %d",
        _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iChannelIndex]),
@@ -489,9 +578,12 @@ int ruby_close_ipc_channel(int iChannelUniqueId)
       s_iRubyIPCChannelsType[k] = s_iRubyIPCChannelsType[k+1];
       s_iRubyIPCChannelsUniqueIds[k] = s_iRubyIPCChannelsUniqueIds[k+1];
       s_uRubyIPCChannelsMsgId[k] = s_uRubyIPCChannelsMsgId[k+1];
-
+      #ifdef RUBY_USES_SHM_RINGS
+      memcpy(&s_RubyIPCChannelsRings[k], &s_RubyIPCChannelsRings[k+1], sizeof(type_ruby_ipc_shm_ring));
+      #endif
    }
    s_iRubyIPCChannelsCount--;
+   _ruby_ipc_update_channels_lookup();
   
    _ruby_ipc_log_channels();
    return 1;
@@ -505,21 +597,10 @@ int ruby_ipc_channel_send_message(int iChannelUniqueId, u8* pMessage, int iLengt
       return 0;
    }
 
-   int iFoundIndex = -1;
    int iChannelFd = 0;
-   //int iChannelType = 0;
-   //u8 uChannelMsgId = 0;
-   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
-   {
-      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
-      {
-         iChannelFd = s_iRubyIPCChannelsFd[i];
-         //iChannelType = s_iRubyIPCChannelsType[i];
-         //uChannelMsgId = s_uRubyIPCChannelsMsgId[i];
-         iFoundIndex = i;
-         break;
-      }
-   }
+   int iFoundIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 != iFoundIndex )
+      iChannelFd = s_iRubyIPCChannelsFd[iFoundIndex];
 
    if ( iFoundIndex == -1 )
    {
@@ -655,6 +736,27 @@ int ruby_ipc_channel_send_message(int iChannelUniqueId, u8* pMessage, int iLengt
    } while (iRetryCounter > 0);
    #endif
 
+   #ifdef RUBY_USES_SHM_RINGS
+
+   int iRetryCounter = 2;
+   do
+   {
+      if ( ruby_ipc_shm_ring_write(&s_RubyIPCChannelsRings[iFoundIndex], pMessage, iLength, s_uRubyIPCChannelsMsgId[iFoundIndex]) )
+      {
+         if ( iRetryCounter < 2 )
+            log_line("[IPC] Succeded to send message after write retry.");
+         res = iLength;
+         break;
+      }
+      res = 0;
+      log_softerror_and_alarm("[IPC] Failed to write to IPC %s, ring full (%d pending messages). Retry write operation only (%d)...",
+         _ruby_ipc_get_channel_name(s_iRubyIPCChannelsType[iFoundIndex]), ruby_ipc_shm_ring_get_pending_count(&s_RubyIPCChannelsRings[iFoundIndex]), iRetryCounter);
+      iRetryCounter--;
+      hardware_sleep_ms(10);
+   } while (iRetryCounter > 0);
+
+   #endif
+
    #ifdef PROFILE_IPC
    u32 uTimeTotal = get_current_timestamp_ms() - uTimeStart;
    if ( uTimeTotal > PROFILE_IPC_MAX_TIME )
@@ -676,18 +778,13 @@ u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempB
       return NULL;
    }
 
-   int iFoundIndex = -1;
    int iChannelFd = 0;
    int iChannelType = 0;
-   for( int i=0; i<s_iRubyIPCChannelsCount; i++ )
+   int iFoundIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 != iFoundIndex )
    {
-      if ( s_iRubyIPCChannelsUniqueIds[i] == iChannelUniqueId )
-      {
-         iChannelFd = s_iRubyIPCChannelsFd[i];
-         iChannelType = s_iRubyIPCChannelsType[i];
-         iFoundIndex = i;
-         break;
-      }
+      iChannelFd = s_iRubyIPCChannelsFd[iFoundIndex];
+      iChannelType = s_iRubyIPCChannelsType[iFoundIndex];
    }
 
    if ( iFoundIndex == -1 )
@@ -814,6 +911,16 @@ u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempB
 
    #endif
 
+   #ifdef RUBY_USES_SHM_RINGS
+
+   if ( iChannelFd < 0 )
+      return NULL;
+   lenReadIPCMsgQueue = ruby_ipc_shm_ring_read(&s_RubyIPCChannelsRings[iFoundIndex], pOutputBuffer);
+   if ( lenReadIPCMsgQueue > 0 )
+      pReturn = pOutputBuffer;
+
+   #endif
+
    #ifdef PROFILE_IPC
    u32 uTimeTotal = get_current_timestamp_ms() - uTimeStart;
    if ( (uTimeTotal > PROFILE_IPC_MAX_TIME + timeoutMicrosec/1000) || uTimeTotal >= 50 )
@@ -831,6 +938,35 @@ u8* ruby_ipc_try_read_message(int iChannelUniqueId, u8* pTempBuffer, int* pTempB
    return pReturn;
 }
 
+int ruby_ipc_wait_for_message(int iChannelUniqueId, u32 uTimeoutMicros)
+{
+   int iIndex = _ruby_ipc_get_channel_index(iChannelUniqueId);
+   if ( -1 == iIndex )
+      return 0;
+
+   #ifdef RUBY_USES_SHM_RINGS
+   return ruby_ipc_shm_ring_wait(&s_RubyIPCChannelsRings[iIndex], uTimeoutMicros);
+   #endif
+
+   #ifdef RUBY_USES_MSGQUEUES
+   // No wake up on message queues: poll the queue
+   u32 uTimeStart = get_current_timestamp_micros();
+   while ( 1 )
+   {
+      struct msqid_ds msg_stats;
+      if ( 0 != msgctl(s_iRubyIPCChannelsFd[iIndex], IPC_STAT, &msg_stats) )
+         return 0;
+      if ( msg_stats.msg_qnum > 0 )
+         return 1;
+      if ( get_current_timestamp_micros() - uTimeStart >= uTimeoutMicros )
+         return 0;
+      hardware_sleep_micros(200);
+   }
+   #endif
+
+   return 1;
+}
+
 int ruby_ipc_get_read_continous_error_count()
 {
    return s_iRubyIPCCountReadErrors;
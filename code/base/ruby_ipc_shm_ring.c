@@ -0,0 +1,339 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <time.h>
+#include "base.h"
+#include "ruby_ipc_shm_ring.h"
+
+static long _ruby_ipc_shm_ring_futex(u32* pAddress, int iOperation, u32 uValue, const struct timespec* pTimeout)
+{
+   return syscall(SYS_futex, pAddress, iOperation, uValue, pTimeout, NULL, 0);
+}
+
+char* ruby_ipc_shm_ring_get_name(int iChannelType)
+{
+   static char s_szRubyIPCShmRingName[64];
+   snprintf(s_szRubyIPCShmRingName, sizeof(s_szRubyIPCShmRingName)/sizeof(s_szRubyIPCShmRingName[0]), "/RUBY_IPC_RING_%d", iChannelType);
+   return s_szRubyIPCShmRingName;
+}
+
+static u32 _ruby_ipc_shm_ring_get_map_size(u32 uSlotsCount)
+{
+   return sizeof(type_ruby_ipc_shm_ring_header) + uSlotsCount * sizeof(type_ruby_ipc_shm_ring_slot);
+}
+
+int ruby_ipc_shm_ring_open(type_ruby_ipc_shm_ring* pRing, int iChannelType, u32 uSlotsCount, u32 uFlags)
+{
+   if ( NULL == pRing )
+      return 0;
+   memset(pRing, 0, sizeof(type_ruby_ipc_shm_ring));
+   pRing->iFd = -1;
+   strcpy(pRing->szName, ruby_ipc_shm_ring_get_name(iChannelType));
+
+   if ( (uSlotsCount < 2) || (0 != (uSlotsCount & (uSlotsCount-1))) )
+      uSlotsCount = RUBY_IPC_SHM_RING_DEFAULT_SLOTS;
+
+   // Only the process that creates the segment initializes it; the others wait for it to be ready
+   int iCreated = 1;
+   int fd = shm_open(pRing->szName, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( (fd < 0) && (errno == EEXIST) )
+   {
+      iCreated = 0;
+      fd = shm_open(pRing->szName, O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   }
+   if ( fd < 0 )
+   {
+      log_softerror_and_alarm("[IPCShmRing] Failed to open shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+      return 0;
+   }
+
+   if ( iCreated )
+   {
+      pRing->uMapSize = _ruby_ipc_shm_ring_get_map_size(uSlotsCount);
+      if ( 0 != ftruncate(fd, pRing->uMapSize) )
+      {
+         log_softerror_and_alarm("[IPCShmRing] Failed to set size of shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+         close(fd);
+         shm_unlink(pRing->szName);
+         return 0;
+      }
+   }
+   else
+   {
+      struct stat fdStat;
+      u32 uTimeStart = get_current_timestamp_ms();
+      while ( 1 )
+      {
+         if ( (0 == fstat(fd, &fdStat)) && (fdStat.st_size >= (off_t)_ruby_ipc_shm_ring_get_map_size(2)) )
+            break;
+         if ( get_current_timestamp_ms() > uTimeStart + 200 )
+         {
+            log_softerror_and_alarm("[IPCShmRing] Shared memory %s was not initialized by its creator.", pRing->szName);
+            close(fd);
+            return 0;
+         }
+         hardware_sleep_ms(1);
+      }
+      pRing->uMapSize = (u32)fdStat.st_size;
+   }
+
+   void* pMap = mmap(NULL, pRing->uMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if ( MAP_FAILED == pMap )
+   {
+      log_softerror_and_alarm("[IPCShmRing] Failed to map shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+      close(fd);
+      if ( iCreated )
+         shm_unlink(pRing->szName);
+      return 0;
+   }
+   pRing->pHeader = (type_ruby_ipc_shm_ring_header*)pMap;
+
+   if ( iCreated )
+   {
+      memset(pMap, 0, pRing->uMapSize);
+      pRing->pHeader->uVersion = RUBY_IPC_SHM_RING_VERSION;
+      pRing->pHeader->uSlotsCount = uSlotsCount;
+      pRing->pHeader->uFlags = uFlags;
+      for( u32 u=0; u<uSlotsCount; u++ )
+         pRing->pHeader->slots[u].uSequence = u;
+      __atomic_store_n(&pRing->pHeader->uMagic, RUBY_IPC_SHM_RING_MAGIC, __ATOMIC_RELEASE);
+   }
+   else
+   {
+      u32 uTimeStart = get_current_timestamp_ms();
+      while ( __atomic_load_n(&pRing->pHeader->uMagic, __ATOMIC_ACQUIRE) != RUBY_IPC_SHM_RING_MAGIC )
+      {
+         if ( get_current_timestamp_ms() > uTimeStart + 200 )
+            break;
+         hardware_sleep_ms(1);
+      }
+      if ( (pRing->pHeader->uMagic != RUBY_IPC_SHM_RING_MAGIC) || (pRing->pHeader->uVersion != RUBY_IPC_SHM_RING_VERSION) ||
+           (pRing->uMapSize < _ruby_ipc_shm_ring_get_map_size(pRing->pHeader->uSlotsCount)) )
+      {
+         log_softerror_and_alarm("[IPCShmRing] Shared memory %s has an invalid or old format (magic: %X, version: %u, size: %u). Recreate it.",
+            pRing->szName, pRing->pHeader->uMagic, pRing->pHeader->uVersion, pRing->uMapSize);
+         munmap(pMap, pRing->uMapSize);
+         close(fd);
+         pRing->pHeader = NULL;
+         shm_unlink(pRing->szName);
+         return ruby_ipc_shm_ring_open(pRing, iChannelType, uSlotsCount, uFlags);
+      }
+   }
+   pRing->uSlotsMask = pRing->pHeader->uSlotsCount - 1;
+   pRing->iFd = fd;
+
+   log_line("[IPCShmRing] %s shared memory %s: %u slots, %u bytes, CRC: %s, %d pending messages.",
+      iCreated?"Created":"Opened", pRing->szName, pRing->pHeader->uSlotsCount, pRing->uMapSize,
+      (pRing->pHeader->uFlags & RUBY_IPC_SHM_RING_FLAG_CRC)?"yes":"no", ruby_ipc_shm_ring_get_pending_count(pRing));
+   return 1;
+}
+
+void ruby_ipc_shm_ring_close(type_ruby_ipc_shm_ring* pRing)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return;
+   munmap(pRing->pHeader, pRing->uMapSize);
+   if ( pRing->iFd >= 0 )
+      close(pRing->iFd);
+   pRing->pHeader = NULL;
+   pRing->iFd = -1;
+   pRing->uMapSize = 0;
+}
+
+void ruby_ipc_shm_ring_remove(int iChannelType)
+{
+   if ( 0 != shm_unlink(ruby_ipc_shm_ring_get_name(iChannelType)) )
+   if ( errno != ENOENT )
+      log_softerror_and_alarm("[IPCShmRing] Failed to remove shared memory %s, error: %d, %s", ruby_ipc_shm_ring_get_name(iChannelType), errno, strerror(errno));
+}
+
+int ruby_ipc_shm_ring_write(type_ruby_ipc_shm_ring* pRing, u8* pMessage, int iLength, u8 uMsgId)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) || (NULL == pMessage) || (iLength <= 0) || (iLength > RUBY_IPC_SHM_RING_MAX_MSG_SIZE) )
+      return 0;
+
+   type_ruby_ipc_shm_ring_header* pHeader = pRing->pHeader;
+   type_ruby_ipc_shm_ring_slot* pSlot = NULL;
+   u32 uPos = __atomic_load_n(&pHeader->uWritePos, __ATOMIC_RELAXED);
+
+   // Reserve a free slot: it's free for this position when its sequence equals the position
+   while ( 1 )
+   {
+      pSlot = &pHeader->slots[uPos & pRing->uSlotsMask];
+      u32 uSequence = __atomic_load_n(&pSlot->uSequence, __ATOMIC_ACQUIRE);
+      int iDiff = (int)(uSequence - uPos);
+      if ( 0 == iDiff )
+      {
+         if ( __atomic_compare_exchange_n(&pHeader->uWritePos, &uPos, uPos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+            break;
+      }
+      else if ( iDiff < 0 )
+      {
+         __atomic_add_fetch(&pHeader->uTotalFullErrors, 1, __ATOMIC_RELAXED);
+         return 0;
+      }
+      else
+         uPos = __atomic_load_n(&pHeader->uWritePos, __ATOMIC_RELAXED);
+   }
+
+   __atomic_store_n(&pSlot->iProducerPid, (int)getpid(), __ATOMIC_RELAXED);
+   memcpy(pSlot->uData, pMessage, iLength);
+   pSlot->uLength = (u16)iLength;
+   pSlot->uMsgId = uMsgId;
+   if ( pHeader->uFlags & RUBY_IPC_SHM_RING_FLAG_CRC )
+      pSlot->uCRC = base_compute_crc32(pSlot->uData, iLength);
+
+   // Publish, then wake up the consumer if it waits (full barriers, paired with ruby_ipc_shm_ring_wait).
+   // Fails if the consumer skipped the slot meanwhile (took too long to write it).
+   u32 uExpected = uPos;
+   if ( ! __atomic_compare_exchange_n(&pSlot->uSequence, &uExpected, uPos+1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) )
+   {
+      __atomic_add_fetch(&pHeader->uTotalLateWritesDiscarded, 1, __ATOMIC_RELAXED);
+      return 0;
+   }
+   if ( __atomic_load_n(&pHeader->uConsumerWaiting, __ATOMIC_SEQ_CST) )
+   {
+      __atomic_add_fetch(&pHeader->uFutexWakeSeq, 1, __ATOMIC_SEQ_CST);
+      _ruby_ipc_shm_ring_futex(&pHeader->uFutexWakeSeq, FUTEX_WAKE, 1, NULL);
+   }
+   return 1;
+}
+
+int ruby_ipc_shm_ring_has_messages(type_ruby_ipc_shm_ring* pRing)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return 0;
+   u32 uPos = pRing->pHeader->uReadPos;
+   type_ruby_ipc_shm_ring_slot* pSlot = &pRing->pHeader->slots[uPos & pRing->uSlotsMask];
+   if ( __atomic_load_n(&pSlot->uSequence, __ATOMIC_SEQ_CST) == uPos+1 )
+      return 1;
+   // A reserved but not yet published slot counts too, so that a stale slot gets skipped by the next read
+   return (__atomic_load_n(&pRing->pHeader->uWritePos, __ATOMIC_SEQ_CST) != uPos)?1:0;
+}
+
+int ruby_ipc_shm_ring_read(type_ruby_ipc_shm_ring* pRing, u8* pOutput)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) || (NULL == pOutput) )
+      return 0;
+
+   type_ruby_ipc_shm_ring_header* pHeader = pRing->pHeader;
+   u32 uPos = pHeader->uReadPos;
+   type_ruby_ipc_shm_ring_slot* pSlot = &pHeader->slots[uPos & pRing->uSlotsMask];
+   if ( __atomic_load_n(&pSlot->uSequence, __ATOMIC_ACQUIRE) != uPos+1 )
+   {
+      if ( __atomic_load_n(&pHeader->uWritePos, __ATOMIC_ACQUIRE) == uPos )
+      {
+         pRing->uTimeFirstStaleSlot = 0;
+         return 0;
+      }
+      // Slot reserved by a producer but not published yet
+      u32 uTimeNow = get_current_timestamp_ms();
+      if ( 0 == pRing->uTimeFirstStaleSlot )
+         pRing->uTimeFirstStaleSlot = uTimeNow;
+      if ( uTimeNow < pRing->uTimeFirstStaleSlot + RUBY_IPC_SHM_RING_STALE_SLOT_TIMEOUT_MS )
+         return 0;
+      // Skip it only if the producer is gone; a live one is just slow
+      int iPid = __atomic_load_n(&pSlot->iProducerPid, __ATOMIC_ACQUIRE);
+      if ( (iPid > 0) && ((0 == kill(iPid, 0)) || (errno != ESRCH)) )
+         return 0;
+      // Free the slot for the producers on the next lap, unless it was just published
+      pSlot->iProducerPid = 0;
+      u32 uExpected = uPos;
+      if ( ! __atomic_compare_exchange_n(&pSlot->uSequence, &uExpected, uPos + pHeader->uSlotsCount, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) )
+         return 0;
+      log_softerror_and_alarm("[IPCShmRing] Skipping slot %u on %s, reserved but not written by producer %d (exited) for %u ms.", uPos, pRing->szName, iPid, uTimeNow - pRing->uTimeFirstStaleSlot);
+      pRing->uTimeFirstStaleSlot = 0;
+      pHeader->uTotalStaleSlotsSkipped++;
+      __atomic_store_n(&pHeader->uReadPos, uPos+1, __ATOMIC_RELEASE);
+      return -1;
+   }
+   pRing->uTimeFirstStaleSlot = 0;
+
+   int iLength = pSlot->uLength;
+   int iResult = iLength;
+   if ( (iLength <= 0) || (iLength > RUBY_IPC_SHM_RING_MAX_MSG_SIZE) )
+   {
+      log_softerror_and_alarm("[IPCShmRing] Invalid message length (%d bytes) on %s, msg id: %d", iLength, pRing->szName, pSlot->uMsgId);
+      iResult = -1;
+   }
+   else
+   {
+      memcpy(pOutput, pSlot->uData, iLength);
+      if ( pHeader->uFlags & RUBY_IPC_SHM_RING_FLAG_CRC )
+      if ( base_compute_crc32(pOutput, iLength) != pSlot->uCRC )
+      {
+         log_softerror_and_alarm("[IPCShmRing] Invalid CRC on %s, msg id: %d, length: %d", pRing->szName, pSlot->uMsgId, iLength);
+         iResult = -1;
+      }
+   }
+
+   // Free the slot for the producers on the next lap
+   pSlot->iProducerPid = 0;
+   __atomic_store_n(&pSlot->uSequence, uPos + pHeader->uSlotsCount, __ATOMIC_RELEASE);
+   __atomic_store_n(&pHeader->uReadPos, uPos+1, __ATOMIC_RELEASE);
+   return iResult;
+}
+
+int ruby_ipc_shm_ring_wait(type_ruby_ipc_shm_ring* pRing, u32 uTimeoutMicros)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return 0;
+   if ( ruby_ipc_shm_ring_has_messages(pRing) )
+      return 1;
+   if ( 0 == uTimeoutMicros )
+      return 0;
+
+   type_ruby_ipc_shm_ring_header* pHeader = pRing->pHeader;
+   u32 uWakeSeq = __atomic_load_n(&pHeader->uFutexWakeSeq, __ATOMIC_SEQ_CST);
+   __atomic_store_n(&pHeader->uConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+   if ( ! ruby_ipc_shm_ring_has_messages(pRing) )
+   {
+      struct timespec timeout;
+      timeout.tv_sec = uTimeoutMicros / 1000000;
+      timeout.tv_nsec = (uTimeoutMicros % 1000000) * 1000;
+      _ruby_ipc_shm_ring_futex(&pHeader->uFutexWakeSeq, FUTEX_WAIT, uWakeSeq, &timeout);
+   }
+   __atomic_store_n(&pHeader->uConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+   return ruby_ipc_shm_ring_has_messages(pRing);
+}
+
+int ruby_ipc_shm_ring_get_pending_count(type_ruby_ipc_shm_ring* pRing)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return 0;
+   return (int)(__atomic_load_n(&pRing->pHeader->uWritePos, __ATOMIC_ACQUIRE) - __atomic_load_n(&pRing->pHeader->uReadPos, __ATOMIC_ACQUIRE));
+}
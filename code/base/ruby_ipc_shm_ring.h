@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../base/base.h"
+
+// Shared memory ring used as an IPC channel transport between processes.
+// Fixed size message slots in a POSIX shared memory segment (one per channel), any number
+// of producers (processes or threads) and one consumer. Each slot has a sequence number:
+// producers reserve a slot with a CAS on the write position, copy the message and publish
+// the slot; the consumer reads the slots in order. The consumer can block on a futex word
+// (shared across processes) until a message is published.
+// A slot reserved by a producer that died before publishing it is skipped by the consumer
+// after RUBY_IPC_SHM_RING_STALE_SLOT_TIMEOUT_MS, once the producer process is confirmed gone
+// (a slow producer is waited for). Publishing a skipped slot fails, so a late write is discarded.
+
+#define RUBY_IPC_SHM_RING_MAGIC 0x52494E47
+#define RUBY_IPC_SHM_RING_VERSION 2
+#define RUBY_IPC_SHM_RING_DEFAULT_SLOTS 128 // power of 2
+#define RUBY_IPC_SHM_RING_MAX_MSG_SIZE 1600
+#define RUBY_IPC_SHM_RING_STALE_SLOT_TIMEOUT_MS 500
+
+#define RUBY_IPC_SHM_RING_FLAG_CRC 0x01
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   u32 uSequence; // position when free for that position, position + 1 when published
+   u16 uLength;
+   u8  uMsgId;
+   u8  uReserved;
+   u32 uCRC; // only if the ring was created with RUBY_IPC_SHM_RING_FLAG_CRC
+   int iProducerPid; // process that reserved the slot, 0 when free
+   u8  uData[RUBY_IPC_SHM_RING_MAX_MSG_SIZE];
+} __attribute__((aligned(64))) type_ruby_ipc_shm_ring_slot;
+
+typedef struct
+{
+   u32 uMagic;
+   u32 uVersion;
+   u32 uSlotsCount;
+   u32 uFlags;
+
+   // Producers
+   u32 uWritePos __attribute__((aligned(64)));
+   u32 uTotalFullErrors;
+   u32 uTotalLateWritesDiscarded; // published after the consumer skipped the slot
+
+   // Consumer
+   u32 uReadPos __attribute__((aligned(64)));
+   u32 uTotalStaleSlotsSkipped;
+   u32 uFutexWakeSeq __attribute__((aligned(64))); // bumped on each published message when the consumer waits
+   u32 uConsumerWaiting;
+
+   type_ruby_ipc_shm_ring_slot slots[0] __attribute__((aligned(64)));
+} type_ruby_ipc_shm_ring_header;
+
+typedef struct
+{
+   type_ruby_ipc_shm_ring_header* pHeader;
+   int iFd;
+   u32 uMapSize;
+   u32 uSlotsMask;
+   char szName[64];
+
+   // Consumer side only
+   u32 uTimeFirstStaleSlot;
+} type_ruby_ipc_shm_ring;
+
+// Opens (and creates if needed) the ring for the given channel type. uFlags and uSlotsCount are used only
+// when the ring is created. Returns 1 on success.
+int ruby_ipc_shm_ring_open(type_ruby_ipc_shm_ring* pRing, int iChannelType, u32 uSlotsCount, u32 uFlags);
+void ruby_ipc_shm_ring_close(type_ruby_ipc_shm_ring* pRing);
+// Removes the ring shared memory segment for the channel type (it's recreated on the next open)
+void ruby_ipc_shm_ring_remove(int iChannelType);
+char* ruby_ipc_shm_ring_get_name(int iChannelType);
+
+// Returns 1 if the message was published, 0 if the ring is full or the message is invalid
+int ruby_ipc_shm_ring_write(type_ruby_ipc_shm_ring* pRing, u8* pMessage, int iLength, u8 uMsgId);
+// Returns the length of the message copied to pOutput (at least RUBY_IPC_SHM_RING_MAX_MSG_SIZE bytes),
+// 0 if there is no message, -1 if a message was dropped (invalid CRC or length)
+int ruby_ipc_shm_ring_read(type_ruby_ipc_shm_ring* pRing, u8* pOutput);
+int ruby_ipc_shm_ring_has_messages(type_ruby_ipc_shm_ring* pRing);
+// Consumer: blocks until a message is published or the timeout expires. Returns 1 if there are messages.
+int ruby_ipc_shm_ring_wait(type_ruby_ipc_shm_ring* pRing, u32 uTimeoutMicros);
+int ruby_ipc_shm_ring_get_pending_count(type_ruby_ipc_shm_ring* pRing);
+
+#ifdef __cplusplus
+}
+#endif
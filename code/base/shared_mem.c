@@ -33,6 +33,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stddef.h>
+#include <sched.h>
+#include <time.h>
 #include "base.h"
 #include "shared_mem.h"
 #include "../radio/radiopackets2.h"
@@ -135,25 +138,179 @@ void process_stats_mark_active(shared_mem_process_stats* pStats, u32 timeNow)
 }
 
 
-shared_mem_radio_stats* shared_mem_radio_stats_open_for_read()
+void shared_mem_seqlocks_init(shared_mem_seqlock* pLocks, int iCount)
 {
-   void *retVal = open_shared_mem_for_read(SHARED_MEM_RADIO_STATS, sizeof(shared_mem_radio_stats));
-   return (shared_mem_radio_stats*)retVal;
+   if ( NULL == pLocks )
+      return;
+   u32 uStartSequence = (((u32)time(NULL)) << 8) & 0xFFFFFFFE;
+   for( int i=0; i<iCount; i++ )
+      __atomic_store_n(&(pLocks[i].uSequence), uStartSequence, __ATOMIC_RELEASE);
+}
+
+void shared_mem_seqlock_write_begin(shared_mem_seqlock* pLock)
+{
+   // Make the sequence odd before any data is modified
+   __atomic_store_n(&(pLock->uSequence), pLock->uSequence + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void shared_mem_seqlock_write_end(shared_mem_seqlock* pLock)
+{
+   // Make the sequence even after all the data is modified
+   __atomic_store_n(&(pLock->uSequence), pLock->uSequence + 1, __ATOMIC_RELEASE);
+}
+
+u32 shared_mem_sections_publish(shared_mem_seqlock* pLocks, u8* pShared, const u8* pLocal, const shared_mem_section* pSections, int iCount)
+{
+   if ( (NULL == pLocks) || (NULL == pShared) || (NULL == pLocal) || (NULL == pSections) )
+      return 0;
+
+   // Single writer: the shared copy can be compared without the seqlock
+   u32 uBytesWritten = 0;
+   for( int i=0; i<iCount; i++ )
+   {
+      u8* pDest = pShared + pSections[i].uOffset;
+      const u8* pSrc = pLocal + pSections[i].uOffset;
+      if ( 0 == memcmp(pDest, pSrc, pSections[i].uSize) )
+         continue;
+      shared_mem_seqlock_write_begin(&pLocks[i]);
+      memcpy(pDest, pSrc, pSections[i].uSize);
+      shared_mem_seqlock_write_end(&pLocks[i]);
+      uBytesWritten += pSections[i].uSize;
+   }
+   return uBytesWritten;
+}
+
+void shared_mem_sections_reader_reset(shared_mem_sections_reader* pReader)
+{
+   if ( NULL == pReader )
+      return;
+   memset(pReader, 0, sizeof(shared_mem_sections_reader));
+   // Sequences are always even when published, so everything is copied on the first read
+   for( int i=0; i<SHARED_MEM_MAX_SECTIONS; i++ )
+      pReader->uLastSequence[i] = MAX_U32;
+}
+
+int shared_mem_sections_read(const shared_mem_seqlock* pLocks, const u8* pShared, u8* pLocal, const shared_mem_section* pSections, int iCount, shared_mem_sections_reader* pReader)
+{
+   if ( (NULL == pLocks) || (NULL == pShared) || (NULL == pLocal) || (NULL == pSections) || (NULL == pReader) )
+      return 0;
+   if ( iCount > SHARED_MEM_MAX_SECTIONS )
+      iCount = SHARED_MEM_MAX_SECTIONS;
+
+   pReader->uTotalReads++;
+   int iCountCopied = 0;
+   for( int i=0; i<iCount; i++ )
+   {
+      int iRetries = 0;
+      int bConsistent = 0;
+      while ( iRetries < SHARED_MEM_SEQLOCK_MAX_READ_RETRIES )
+      {
+         u32 uSequenceStart = __atomic_load_n(&(pLocks[i].uSequence), __ATOMIC_ACQUIRE);
+         if ( uSequenceStart & 0x01 )
+         {
+            // Writer is updating this section right now
+            iRetries++;
+            if ( iRetries > 8 )
+               sched_yield();
+            continue;
+         }
+         if ( uSequenceStart == pReader->uLastSequence[i] )
+         {
+            pReader->uTotalBytesSkipped += pSections[i].uSize;
+            bConsistent = 1;
+            break;
+         }
+         memcpy(pLocal + pSections[i].uOffset, pShared + pSections[i].uOffset, pSections[i].uSize);
+         __atomic_thread_fence(__ATOMIC_ACQUIRE);
+         if ( __atomic_load_n(&(pLocks[i].uSequence), __ATOMIC_RELAXED) == uSequenceStart )
+         {
+            pReader->uLastSequence[i] = uSequenceStart;
+            pReader->uTotalBytesCopied += pSections[i].uSize;
+            iCountCopied++;
+            bConsistent = 1;
+            break;
+         }
+         iRetries++;
+         if ( iRetries > 8 )
+            sched_yield();
+      }
+      pReader->uTotalRetries += (u32)iRetries;
+      if ( ! bConsistent )
+      {
+         // Local copy of this section may be torn; it's copied again on the next read
+         pReader->uLastSequence[i] = MAX_U32;
+         pReader->uTotalFailedReads++;
+      }
+   }
+   return iCountCopied;
+}
+
+static shared_mem_section s_SectionsRadioStats[SHARED_MEM_RADIO_STATS_SECTIONS];
+static int s_iSectionsRadioStatsInitialized = 0;
+
+static const shared_mem_section* _shared_mem_radio_stats_get_sections()
+{
+   if ( s_iSectionsRadioStatsInitialized )
+      return s_SectionsRadioStats;
+
+   int iSection = 0;
+   s_SectionsRadioStats[iSection].uOffset = 0;
+   s_SectionsRadioStats[iSection].uSize = offsetof(shared_mem_radio_stats, radio_streams);
+   iSection++;
+   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
+   {
+      s_SectionsRadioStats[iSection].uOffset = offsetof(shared_mem_radio_stats, radio_streams) + i * sizeof(shared_mem_radio_stats_stream) * MAX_RADIO_STREAMS;
+      s_SectionsRadioStats[iSection].uSize = sizeof(shared_mem_radio_stats_stream) * MAX_RADIO_STREAMS;
+      iSection++;
+   }
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+   {
+      s_SectionsRadioStats[iSection].uOffset = offsetof(shared_mem_radio_stats, radio_interfaces) + i * sizeof(shared_mem_radio_stats_radio_interface);
+      s_SectionsRadioStats[iSection].uSize = sizeof(shared_mem_radio_stats_radio_interface);
+      iSection++;
+   }
+   s_SectionsRadioStats[iSection].uOffset = offsetof(shared_mem_radio_stats, radio_links);
+   s_SectionsRadioStats[iSection].uSize = sizeof(shared_mem_radio_stats) - offsetof(shared_mem_radio_stats, radio_links);
+   s_iSectionsRadioStatsInitialized = 1;
+   return s_SectionsRadioStats;
+}
+
+shared_mem_radio_stats_versioned* shared_mem_radio_stats_open_for_read()
+{
+   void *retVal = open_shared_mem_for_read(SHARED_MEM_RADIO_STATS, sizeof(shared_mem_radio_stats_versioned));
+   return (shared_mem_radio_stats_versioned*)retVal;
 }
 
-shared_mem_radio_stats* shared_mem_radio_stats_open_for_write()
+shared_mem_radio_stats_versioned* shared_mem_radio_stats_open_for_write()
 {
-   void *retVal = open_shared_mem_for_write(SHARED_MEM_RADIO_STATS, sizeof(shared_mem_radio_stats));
-   return (shared_mem_radio_stats*)retVal;
+   void *retVal = open_shared_mem_for_write(SHARED_MEM_RADIO_STATS, sizeof(shared_mem_radio_stats_versioned));
+   if ( NULL != retVal )
+      shared_mem_seqlocks_init(((shared_mem_radio_stats_versioned*)retVal)->locks, SHARED_MEM_RADIO_STATS_SECTIONS);
+   return (shared_mem_radio_stats_versioned*)retVal;
 }
 
-void shared_mem_radio_stats_close(shared_mem_radio_stats* pAddress)
+void shared_mem_radio_stats_close(shared_mem_radio_stats_versioned* pAddress)
 {
    if ( NULL != pAddress )
-      munmap(pAddress, sizeof(shared_mem_radio_stats));
+      munmap(pAddress, sizeof(shared_mem_radio_stats_versioned));
    //shm_unlink(szName);
 }
 
+u32 shared_mem_radio_stats_publish(shared_mem_radio_stats_versioned* pShared, const shared_mem_radio_stats* pLocal)
+{
+   if ( NULL == pShared )
+      return 0;
+   return shared_mem_sections_publish(pShared->locks, (u8*)&(pShared->stats), (const u8*)pLocal, _shared_mem_radio_stats_get_sections(), SHARED_MEM_RADIO_STATS_SECTIONS);
+}
+
+int shared_mem_radio_stats_read(const shared_mem_radio_stats_versioned* pShared, shared_mem_radio_stats* pLocal, shared_mem_sections_reader* pReader)
+{
+   if ( NULL == pShared )
+      return 0;
+   return shared_mem_sections_read(pShared->locks, (const u8*)&(pShared->stats), (u8*)pLocal, _shared_mem_radio_stats_get_sections(), SHARED_MEM_RADIO_STATS_SECTIONS, pReader);
+}
+
 shared_mem_radio_stats_rx_hist* shared_mem_radio_stats_rx_hist_open_for_read()
 {
    void *retVal = open_shared_mem_for_read(SHARED_MEM_RADIO_STATS_RX_HIST, sizeof(shared_mem_radio_stats_rx_hist));
@@ -172,6 +329,60 @@ void shared_mem_radio_stats_rx_hist_close(shared_mem_radio_stats_rx_hist* pAddre
       munmap(pAddress, sizeof(shared_mem_radio_stats_rx_hist));
 }
 
+static const shared_mem_section s_SharedMemLoopLatencySection = { 0, sizeof(shared_mem_loop_latency_stats) };
+
+shared_mem_loop_latency_stats_versioned* shared_mem_loop_latency_stats_open_for_read(const char* szName)
+{
+   void *retVal = open_shared_mem_for_read(szName, sizeof(shared_mem_loop_latency_stats_versioned));
+   return (shared_mem_loop_latency_stats_versioned*)retVal;
+}
+
+shared_mem_loop_latency_stats_versioned* shared_mem_loop_latency_stats_open_for_write(const char* szName)
+{
+   void *retVal = open_shared_mem_for_write(szName, sizeof(shared_mem_loop_latency_stats_versioned));
+   if ( NULL != retVal )
+      shared_mem_seqlocks_init(&(((shared_mem_loop_latency_stats_versioned*)retVal)->lock), 1);
+   return (shared_mem_loop_latency_stats_versioned*)retVal;
+}
+
+void shared_mem_loop_latency_stats_close(shared_mem_loop_latency_stats_versioned* pAddress)
+{
+   if ( NULL != pAddress )
+      munmap(pAddress, sizeof(shared_mem_loop_latency_stats_versioned));
+}
+
+u32 shared_mem_loop_latency_stats_publish(shared_mem_loop_latency_stats_versioned* pShared, const shared_mem_loop_latency_stats* pLocal)
+{
+   if ( NULL == pShared )
+      return 0;
+   return shared_mem_sections_publish(&(pShared->lock), (u8*)&(pShared->stats), (const u8*)pLocal, &s_SharedMemLoopLatencySection, 1);
+}
+
+int shared_mem_loop_latency_stats_read(const shared_mem_loop_latency_stats_versioned* pShared, shared_mem_loop_latency_stats* pLocal, shared_mem_sections_reader* pReader)
+{
+   if ( NULL == pShared )
+      return 0;
+   return shared_mem_sections_read(&(pShared->lock), (const u8*)&(pShared->stats), (u8*)pLocal, &s_SharedMemLoopLatencySection, 1, pReader);
+}
+
+shared_mem_radio_tx_pacing_stats* shared_mem_radio_tx_pacing_stats_open_for_read()
+{
+   void *retVal = open_shared_mem_for_read(SHARED_MEM_RADIO_TX_PACING_STATS, sizeof(shared_mem_radio_tx_pacing_stats));
+   return (shared_mem_radio_tx_pacing_stats*)retVal;
+}
+
+shared_mem_radio_tx_pacing_stats* shared_mem_radio_tx_pacing_stats_open_for_write()
+{
+   void *retVal = open_shared_mem_for_write(SHARED_MEM_RADIO_TX_PACING_STATS, sizeof(shared_mem_radio_tx_pacing_stats));
+   return (shared_mem_radio_tx_pacing_stats*)retVal;
+}
+
+void shared_mem_radio_tx_pacing_stats_close(shared_mem_radio_tx_pacing_stats* pAddress)
+{
+   if ( NULL != pAddress )
+      munmap(pAddress, sizeof(shared_mem_radio_tx_pacing_stats));
+}
+
 shared_mem_video_frames_stats* shared_mem_video_frames_stats_open_for_read()
 {
    void *retVal = open_shared_mem_for_read(SHARED_MEM_VIDEO_FRAMES_STATS , sizeof(shared_mem_video_frames_stats));
@@ -11,6 +11,11 @@
 
 #define SHARED_MEM_RADIO_STATS "/SYSTEM_SHARED_MEM_RUBY_RADIO_STATS"
 #define SHARED_MEM_RADIO_STATS_RX_HIST "/SYSTEM_SHARED_MEM_RUBY_RADIO_STATS_RX_HIST"
+#define SHARED_MEM_RADIO_TX_PACING_STATS "/SYSTEM_SHARED_MEM_RUBY_RADIO_TX_PACING_STATS"
+#define SHARED_MEM_LOOP_LATENCY_STATION "/SYSTEM_SHARED_MEM_RUBY_LOOP_LATENCY_STATION"
+#define SHARED_MEM_LOOP_LATENCY_VEHICLE "/SYSTEM_SHARED_MEM_RUBY_LOOP_LATENCY_VEHICLE"
+#define SHARED_MEM_LATENCY_TRACE_STATION "/SYSTEM_SHARED_MEM_RUBY_LATENCY_TRACE_STATION"
+#define SHARED_MEM_LATENCY_TRACE_VEHICLE "/SYSTEM_SHARED_MEM_RUBY_LATENCY_TRACE_VEHICLE"
 
 #define SHARED_MEM_VIDEO_FRAMES_STATS "/SYSTEM_SHARED_MEM_STATION_VIDEO_STREAM_INFO"
 #define SHARED_MEM_VIDEO_FRAMES_STATS_RADIO_IN "/SYSTEM_SHARED_MEM_STATION_VIDEO_STREAM_INFO_RADIO_IN"
@@ -139,6 +144,99 @@ typedef struct
 
 } ALIGN_STRUCT_SPEC_INFO shared_mem_video_frames_stats;
 
+// Seqlock versioned sections, for shared memory with one writer process and any number of readers.
+// A large shared memory struct is split into sections (byte ranges), each one with its own sequence
+// counter, kept outside the struct itself. The writer makes the sequence odd while it updates a
+// section and even again after that, and updates only the sections that changed since the last publish.
+// Readers retry a section if its sequence was odd or changed while copying it (torn read) and skip
+// the copy for sections with the same sequence as on their previous read.
+
+#define SHARED_MEM_MAX_SECTIONS 16
+#define SHARED_MEM_SEQLOCK_MAX_READ_RETRIES 64
+
+typedef struct
+{
+   u32 uOffset;
+   u32 uSize;
+} ALIGN_STRUCT_SPEC_INFO shared_mem_section;
+
+typedef struct
+{
+   u32 uSequence;
+} ALIGN_STRUCT_SPEC_INFO shared_mem_seqlock;
+
+// Reader side state, one for each reader of a versioned shared memory object
+typedef struct
+{
+   u32 uLastSequence[SHARED_MEM_MAX_SECTIONS];
+   u32 uTotalReads;
+   u32 uTotalRetries; // torn reads retried
+   u32 uTotalFailedReads; // sections still changing after SHARED_MEM_SEQLOCK_MAX_READ_RETRIES
+   u64 uTotalBytesCopied;
+   u64 uTotalBytesSkipped; // unchanged sections not copied
+} ALIGN_STRUCT_SPEC_INFO shared_mem_sections_reader;
+
+// Radio stats shared by the router with central, versioned by sections:
+// the header, the streams of each vehicle, each radio interface and the radio links.
+#define SHARED_MEM_RADIO_STATS_SECTIONS (1 + MAX_CONCURENT_VEHICLES + MAX_RADIO_INTERFACES + 1)
+#if SHARED_MEM_RADIO_STATS_SECTIONS > SHARED_MEM_MAX_SECTIONS
+#error "SHARED_MEM_RADIO_STATS_SECTIONS is larger than SHARED_MEM_MAX_SECTIONS"
+#endif
+
+typedef struct
+{
+   shared_mem_seqlock locks[SHARED_MEM_RADIO_STATS_SECTIONS];
+   shared_mem_radio_stats stats;
+} ALIGN_STRUCT_SPEC_INFO shared_mem_radio_stats_versioned;
+
+// Main loop latency histograms, published by the processes running an event loop (see event_loop.h).
+// Latency: from the time an event source is ready (timer due, fd readable) to the start of its handler.
+// Buckets are log2 of microseconds: bucket 0 is < 1 us, bucket i is [2^(i-1), 2^i) us, the last one is everything above.
+#define LOOP_LATENCY_HISTOGRAM_BUCKETS 20
+#define LOOP_LATENCY_PRIORITY_CLASSES 3
+#define LOOP_LATENCY_MAX_HANDLERS 12
+
+// Run time of each event source handler (in the order the sources were added to the loop)
+typedef struct
+{
+   char szName[16];
+   u32 uTotalRuns;
+   u32 uMaxRunMicros;
+   u64 uTotalRunMicros;
+   u32 uTimeSliceMicros; // 0: no time slice set
+   u32 uTotalSliceOverruns; // runs longer than the time slice
+   u32 uTotalMissedTimerTicks;
+} ALIGN_STRUCT_SPEC_INFO shared_mem_loop_handler_stats;
+
+typedef struct
+{
+   u32 uTimeLastUpdate;
+   u32 uTotalIterations;
+   u32 uTotalIdleWaits; // iterations that blocked in the wait, with nothing pending
+   u32 uTotalDispatches[LOOP_LATENCY_PRIORITY_CLASSES];
+   u32 uMaxLatencyMicros[LOOP_LATENCY_PRIORITY_CLASSES];
+   u32 uLatencyHistogram[LOOP_LATENCY_PRIORITY_CLASSES][LOOP_LATENCY_HISTOGRAM_BUCKETS];
+   u32 uIterationTimeHistogram[LOOP_LATENCY_HISTOGRAM_BUCKETS]; // time spent in handlers on each iteration
+   int iCountHandlers;
+   shared_mem_loop_handler_stats handlers[LOOP_LATENCY_MAX_HANDLERS];
+} ALIGN_STRUCT_SPEC_INFO shared_mem_loop_latency_stats;
+
+typedef struct
+{
+   shared_mem_seqlock lock;
+   shared_mem_loop_latency_stats stats;
+} ALIGN_STRUCT_SPEC_INFO shared_mem_loop_latency_stats_versioned;
+
+// Sets an even start sequence, different on each writer start, so that readers of a previous writer instance copy everything again
+void shared_mem_seqlocks_init(shared_mem_seqlock* pLocks, int iCount);
+void shared_mem_seqlock_write_begin(shared_mem_seqlock* pLock);
+void shared_mem_seqlock_write_end(shared_mem_seqlock* pLock);
+// Writer: copies the changed sections from pLocal to pShared. Returns the number of bytes written.
+u32 shared_mem_sections_publish(shared_mem_seqlock* pLocks, u8* pShared, const u8* pLocal, const shared_mem_section* pSections, int iCount);
+void shared_mem_sections_reader_reset(shared_mem_sections_reader* pReader);
+// Reader: copies the sections changed since the last read from pShared to pLocal. Returns the number of sections copied.
+int shared_mem_sections_read(const shared_mem_seqlock* pLocks, const u8* pShared, u8* pLocal, const shared_mem_section* pSections, int iCount, shared_mem_sections_reader* pReader);
+
 void* open_shared_mem(const char* name, int size, int readOnly);
 void* open_shared_mem_for_write(const char* name, int size);
 void* open_shared_mem_for_read(const char* name, int size);
@@ -150,14 +248,26 @@ void shared_mem_process_stats_close(const char* szName, shared_mem_process_stats
 void process_stats_reset(shared_mem_process_stats* pStats, u32 timeNow);
 void process_stats_mark_active(shared_mem_process_stats* pStats, u32 timeNow);
 
-shared_mem_radio_stats* shared_mem_radio_stats_open_for_read();
-shared_mem_radio_stats* shared_mem_radio_stats_open_for_write();
-void shared_mem_radio_stats_close(shared_mem_radio_stats* pAddress);
+shared_mem_radio_stats_versioned* shared_mem_radio_stats_open_for_read();
+shared_mem_radio_stats_versioned* shared_mem_radio_stats_open_for_write();
+void shared_mem_radio_stats_close(shared_mem_radio_stats_versioned* pAddress);
+u32 shared_mem_radio_stats_publish(shared_mem_radio_stats_versioned* pShared, const shared_mem_radio_stats* pLocal);
+int shared_mem_radio_stats_read(const shared_mem_radio_stats_versioned* pShared, shared_mem_radio_stats* pLocal, shared_mem_sections_reader* pReader);
 
 shared_mem_radio_stats_rx_hist* shared_mem_radio_stats_rx_hist_open_for_read();
 shared_mem_radio_stats_rx_hist* shared_mem_radio_stats_rx_hist_open_for_write();
 void shared_mem_radio_stats_rx_hist_close(shared_mem_radio_stats_rx_hist* pAddress);
 
+shared_mem_radio_tx_pacing_stats* shared_mem_radio_tx_pacing_stats_open_for_read();
+shared_mem_radio_tx_pacing_stats* shared_mem_radio_tx_pacing_stats_open_for_write();
+void shared_mem_radio_tx_pacing_stats_close(shared_mem_radio_tx_pacing_stats* pAddress);
+
+shared_mem_loop_latency_stats_versioned* shared_mem_loop_latency_stats_open_for_read(const char* szName);
+shared_mem_loop_latency_stats_versioned* shared_mem_loop_latency_stats_open_for_write(const char* szName);
+void shared_mem_loop_latency_stats_close(shared_mem_loop_latency_stats_versioned* pAddress);
+u32 shared_mem_loop_latency_stats_publish(shared_mem_loop_latency_stats_versioned* pShared, const shared_mem_loop_latency_stats* pLocal);
+int shared_mem_loop_latency_stats_read(const shared_mem_loop_latency_stats_versioned* pShared, shared_mem_loop_latency_stats* pLocal, shared_mem_sections_reader* pReader);
+
 shared_mem_video_frames_stats* shared_mem_video_frames_stats_open_for_read();
 shared_mem_video_frames_stats* shared_mem_video_frames_stats_open_for_write();
 void shared_mem_video_frames_stats_close(shared_mem_video_frames_stats* pAddress);
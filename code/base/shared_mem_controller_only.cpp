@@ -38,27 +38,59 @@
 #include "shared_mem_controller_only.h"
 #include "../radio/radiopackets2.h"
 
-shared_mem_video_stream_stats_rx_processors* shared_mem_video_stream_stats_rx_processors_open_for_read()
+shared_mem_video_stream_stats_rx_processors_versioned* shared_mem_video_stream_stats_rx_processors_open_for_read()
 {
-   void *retVal =  open_shared_mem(SHARED_MEM_VIDEO_STREAM_STATS, sizeof(shared_mem_video_stream_stats_rx_processors), 1);
-   shared_mem_video_stream_stats_rx_processors *tretval = (shared_mem_video_stream_stats_rx_processors*)retVal;
+   void *retVal =  open_shared_mem(SHARED_MEM_VIDEO_STREAM_STATS, sizeof(shared_mem_video_stream_stats_rx_processors_versioned), 1);
+   shared_mem_video_stream_stats_rx_processors_versioned *tretval = (shared_mem_video_stream_stats_rx_processors_versioned*)retVal;
    return tretval;
 }
 
-shared_mem_video_stream_stats_rx_processors* shared_mem_video_stream_stats_rx_processors_open_for_write()
+shared_mem_video_stream_stats_rx_processors_versioned* shared_mem_video_stream_stats_rx_processors_open_for_write()
 {
-   void *retVal =  open_shared_mem(SHARED_MEM_VIDEO_STREAM_STATS, sizeof(shared_mem_video_stream_stats_rx_processors), 0);
-   shared_mem_video_stream_stats_rx_processors *tretval = (shared_mem_video_stream_stats_rx_processors*)retVal;
+   void *retVal =  open_shared_mem(SHARED_MEM_VIDEO_STREAM_STATS, sizeof(shared_mem_video_stream_stats_rx_processors_versioned), 0);
+   shared_mem_video_stream_stats_rx_processors_versioned *tretval = (shared_mem_video_stream_stats_rx_processors_versioned*)retVal;
+   if ( NULL != tretval )
+      shared_mem_seqlocks_init(tretval->locks, MAX_VIDEO_PROCESSORS);
    return tretval;
 }
 
-void shared_mem_video_stream_stats_rx_processors_close(shared_mem_video_stream_stats_rx_processors* pAddress)
+void shared_mem_video_stream_stats_rx_processors_close(shared_mem_video_stream_stats_rx_processors_versioned* pAddress)
 {
    if ( NULL != pAddress )
-      munmap(pAddress, sizeof(shared_mem_video_stream_stats_rx_processors));
+      munmap(pAddress, sizeof(shared_mem_video_stream_stats_rx_processors_versioned));
    //shm_unlink(SHARED_MEM_VIDEO_STREAM_STATS);
 }
 
+static shared_mem_section s_SectionsVideoStreamStats[MAX_VIDEO_PROCESSORS];
+static bool s_bSectionsVideoStreamStatsInitialized = false;
+
+static const shared_mem_section* _shared_mem_video_stream_stats_get_sections()
+{
+   if ( s_bSectionsVideoStreamStatsInitialized )
+      return s_SectionsVideoStreamStats;
+   for( int i=0; i<MAX_VIDEO_PROCESSORS; i++ )
+   {
+      s_SectionsVideoStreamStats[i].uOffset = i * sizeof(shared_mem_video_stream_stats);
+      s_SectionsVideoStreamStats[i].uSize = sizeof(shared_mem_video_stream_stats);
+   }
+   s_bSectionsVideoStreamStatsInitialized = true;
+   return s_SectionsVideoStreamStats;
+}
+
+u32 shared_mem_video_stream_stats_rx_processors_publish(shared_mem_video_stream_stats_rx_processors_versioned* pShared, const shared_mem_video_stream_stats_rx_processors* pLocal)
+{
+   if ( NULL == pShared )
+      return 0;
+   return shared_mem_sections_publish(pShared->locks, (u8*)&(pShared->stats), (const u8*)pLocal, _shared_mem_video_stream_stats_get_sections(), MAX_VIDEO_PROCESSORS);
+}
+
+int shared_mem_video_stream_stats_rx_processors_read(const shared_mem_video_stream_stats_rx_processors_versioned* pShared, shared_mem_video_stream_stats_rx_processors* pLocal, shared_mem_sections_reader* pReader)
+{
+   if ( NULL == pShared )
+      return 0;
+   return shared_mem_sections_read(pShared->locks, (const u8*)&(pShared->stats), (u8*)pLocal, _shared_mem_video_stream_stats_get_sections(), MAX_VIDEO_PROCESSORS, pReader);
+}
+
 shared_mem_video_stream_stats* get_shared_mem_video_stream_stats_for_vehicle(shared_mem_video_stream_stats_rx_processors* pSM, u32 uVehicleId)
 {
    if ( (NULL == pSM) || (0 == uVehicleId) || (MAX_U32 == uVehicleId) )
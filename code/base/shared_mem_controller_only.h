@@ -1,6 +1,7 @@
 #pragma once
 #include "base.h"
 #include "config.h"
+#include "shared_mem.h"
 
 #define SHARED_MEM_CONTROLLER_ROUTER_VEHICLES_INFO "R_SHARED_MEM_CONTROLLER_ROUTER_VEHICLE_INFO"
 #define SHARED_MEM_VIDEO_STREAM_STATS "/SYSTEM_SHARED_MEM_STATION_VIDEO_STREAM_STATS"
@@ -56,6 +57,13 @@ typedef struct
    shared_mem_video_stream_stats video_streams[MAX_VIDEO_PROCESSORS];
 } ALIGN_STRUCT_SPEC_INFO shared_mem_video_stream_stats_rx_processors;
 
+// Shared by the router with central, versioned by video processor (see shared_mem_sections_publish)
+typedef struct
+{
+   shared_mem_seqlock locks[MAX_VIDEO_PROCESSORS];
+   shared_mem_video_stream_stats_rx_processors stats;
+} ALIGN_STRUCT_SPEC_INFO shared_mem_video_stream_stats_rx_processors_versioned;
+
 typedef struct
 {
    u32 uVehiclesIds[MAX_CONCURENT_VEHICLES];
@@ -89,9 +97,11 @@ typedef struct
    u32 uRTTime[MAX_RADIO_INTERFACES][MAX_DBG_PING_DATAPOINTS];
 } ALIGN_STRUCT_SPEC_INFO shared_mem_ctrl_ping_stats;
 
-shared_mem_video_stream_stats_rx_processors* shared_mem_video_stream_stats_rx_processors_open_for_read();
-shared_mem_video_stream_stats_rx_processors* shared_mem_video_stream_stats_rx_processors_open_for_write();
-void shared_mem_video_stream_stats_rx_processors_close(shared_mem_video_stream_stats_rx_processors* pAddress);
+shared_mem_video_stream_stats_rx_processors_versioned* shared_mem_video_stream_stats_rx_processors_open_for_read();
+shared_mem_video_stream_stats_rx_processors_versioned* shared_mem_video_stream_stats_rx_processors_open_for_write();
+void shared_mem_video_stream_stats_rx_processors_close(shared_mem_video_stream_stats_rx_processors_versioned* pAddress);
+u32 shared_mem_video_stream_stats_rx_processors_publish(shared_mem_video_stream_stats_rx_processors_versioned* pShared, const shared_mem_video_stream_stats_rx_processors* pLocal);
+int shared_mem_video_stream_stats_rx_processors_read(const shared_mem_video_stream_stats_rx_processors_versioned* pShared, shared_mem_video_stream_stats_rx_processors* pLocal, shared_mem_sections_reader* pReader);
 shared_mem_video_stream_stats* get_shared_mem_video_stream_stats_for_vehicle(shared_mem_video_stream_stats_rx_processors* pSM, u32 uVehicleId);
 void reset_video_stream_stats_for_vehicle(shared_mem_video_stream_stats_rx_processors* pSM, u32 uVehicleId);
 void reset_video_stream_stats_detected_info(shared_mem_video_stream_stats* pVSStats);
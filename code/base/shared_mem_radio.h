@@ -203,3 +203,25 @@ typedef struct
 
 } ALIGN_STRUCT_SPEC_INFO shared_mem_radio_stats;
 
+
+// Paced video tx (vehicle): achieved gaps between consecutive paced frames
+// and how late frames were released compared to their schedule. Cumulative.
+#define RADIO_TX_PACING_GAP_HISTOGRAM_BUCKETS 40
+#define RADIO_TX_PACING_GAP_HISTOGRAM_BUCKET_MICROS 50
+// Lateness buckets, in microseconds: <10, <25, <50, <100, <250, <500, <1000, >=1000
+#define RADIO_TX_PACING_LATENESS_HISTOGRAM_BUCKETS 8
+
+typedef struct
+{
+   u32 uTimeLastUpdate;
+   u32 uTotalFrames;
+   u32 uTotalPacedFrames; // frames that were queued before their release time (are in the histograms)
+   u32 uTotalWriteErrors;
+   u32 uTotalQueueFullWaits; // updated by the producer
+   u32 uTotalDroppedFrames; // updated by the producer
+   u32 uMaxQueuedFrames;
+   u32 uLastTargetGapMicros;
+   u32 uMaxLatenessMicros;
+   u32 uHistogramAchievedGap[RADIO_TX_PACING_GAP_HISTOGRAM_BUCKETS]; // last bucket: all larger gaps
+   u32 uHistogramLateness[RADIO_TX_PACING_LATENESS_HISTOGRAM_BUCKETS];
+} ALIGN_STRUCT_SPEC_INFO shared_mem_radio_tx_pacing_stats;
@@ -35,6 +35,7 @@
 #include "../base/config.h"
 #include "../base/models.h"
 #include "../base/hardware_procs.h"
+#include "../base/hardware_radio_netlink.h"
 #include "../common/string_utils.h"
 #include "../radio/radioflags.h"
 
@@ -735,7 +736,30 @@ bool radio_utils_set_interface_frequency(Model* pModel, int iRadioIndex, int iAs
             sprintf(cmd, "iwconfig %s freq %u000", pRadioInfo->szName, uFrequencyKhz);            
             #endif
          }
-         hw_execute_process(cmd, 0, szOutput, sizeof(szOutput)/sizeof(szOutput[0]));
+
+         // nl80211 first (same channel setup as the iw/iwconfig commands, without a process spawn); commands as fallback
+         bool bSetUsingNetlink = false;
+         if ( bTryHT40 || pRadioInfo->isHighCapacityInterface )
+         {
+            #if defined(HW_PLATFORM_RASPBERRY)
+            int iHTMode = bUsedHT40?RADIO_NETLINK_HT40_PLUS:RADIO_NETLINK_HT_NONE;
+            #else
+            int iHTMode = RADIO_NETLINK_HT_NONE;
+            #endif
+            if ( hardware_radio_netlink_set_frequency(pRadioInfo->szName, uFreqWifi, iHTMode) )
+               bSetUsingNetlink = true;
+            else if ( (iHTMode != RADIO_NETLINK_HT_NONE) && (-EINVAL == hardware_radio_netlink_get_last_error()) )
+            {
+               log_softerror_and_alarm("Failed to switch radio interface %d (%s, %s) to frequency %s in HT40 mode using netlink. Retry operation.", i+1, pRadioInfo->szName, str_get_radio_driver_description(pRadioInfo->iRadioDriver), str_format_frequency(uFrequencyKhz));
+               hardware_sleep_ms(delayMs);
+               if ( hardware_radio_netlink_set_frequency(pRadioInfo->szName, uFreqWifi, RADIO_NETLINK_HT_NONE) )
+                  bSetUsingNetlink = true;
+            }
+            if ( (! bSetUsingNetlink) && hardware_radio_netlink_init() )
+               log_softerror_and_alarm("Failed to switch radio interface %d (%s) to frequency %s using netlink, error: %d. Using command.", i+1, pRadioInfo->szName, str_format_frequency(uFrequencyKhz), hardware_radio_netlink_get_last_error());
+         }
+         if ( ! bSetUsingNetlink )
+            hw_execute_process(cmd, 0, szOutput, sizeof(szOutput)/sizeof(szOutput[0]));
          
          if ( 5 < strlen(szOutput) )
             log_softerror_and_alarm("Received a response from set freq command: [%s]", szOutput);
@@ -841,17 +865,14 @@ bool radio_utils_set_datarate_atheros(Model* pModel, int iCard, int dataRate_bps
    char cmd[1024];
 
    //sprintf(cmd, "ifconfig %s down", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s down", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 0, NULL);
    hardware_sleep_ms(delayMs);
 
-   sprintf(cmd, "iw dev %s set type managed", pRadioHWInfo->szName );
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_type_managed(pRadioHWInfo->szName, NULL);
    hardware_sleep_ms(delayMs);
 
    //sprintf(cmd, "ifconfig %s up", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s up", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, NULL);
    hardware_sleep_ms(delayMs);
 
    if ( dataRate_bps > 0 )
@@ -862,21 +883,17 @@ bool radio_utils_set_datarate_atheros(Model* pModel, int iCard, int dataRate_bps
    hardware_sleep_ms(delayMs);
 
    //sprintf(cmd, "ifconfig %s down", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s down", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 0, NULL);
    hardware_sleep_ms(delayMs);
 
-   sprintf(cmd, "iw dev %s set monitor none", pRadioHWInfo->szName );
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, 0, NULL);
    hardware_sleep_ms(delayMs);
 
-   sprintf(cmd, "iw dev %s set monitor fcsfail", pRadioHWInfo->szName );
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_monitor_flags(pRadioHWInfo->szName, RADIO_NETLINK_MONITOR_FLAG_FCSFAIL, NULL);
    hardware_sleep_ms(delayMs);
 
    //sprintf(cmd, "ifconfig %s up", pRadioHWInfo->szName );
-   sprintf(cmd, "ip link set dev %s up", pRadioHWInfo->szName);
-   hw_execute_bash_command(cmd, NULL);
+   hardware_radio_set_link_up(pRadioHWInfo->szName, 1, NULL);
    hardware_sleep_ms(delayMs);
 
    pRadioHWInfo->iCurrentDataRateBPS = dataRate_bps;
@@ -0,0 +1,420 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <time.h>
+#include "base.h"
+#include "video_frame_ring.h"
+
+static long _video_frame_ring_futex(u32* pAddress, int iOperation, u32 uValue, const struct timespec* pTimeout)
+{
+   return syscall(SYS_futex, pAddress, iOperation, uValue, pTimeout, NULL, 0);
+}
+
+u64 video_frame_ring_get_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)(t.tv_nsec/1000);
+}
+
+static int _video_frame_ring_map(type_video_frame_ring* pRing, int fd)
+{
+   void* pMap = mmap(NULL, sizeof(type_video_frame_ring_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if ( MAP_FAILED == pMap )
+   {
+      log_softerror_and_alarm("[VideoFrameRing] Failed to map shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+      return 0;
+   }
+   pRing->pHeader = (type_video_frame_ring_header*)pMap;
+   return 1;
+}
+
+int video_frame_ring_create(type_video_frame_ring* pRing, const char* szName)
+{
+   if ( (NULL == pRing) || (NULL == szName) )
+      return 0;
+   memset(pRing, 0, sizeof(type_video_frame_ring));
+   strncpy(pRing->szName, szName, sizeof(pRing->szName)-1);
+
+   // Always start with a new segment: a consumer still mapping the old one keeps it until it reopens
+   shm_unlink(pRing->szName);
+   int fd = shm_open(pRing->szName, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( fd < 0 )
+   {
+      log_softerror_and_alarm("[VideoFrameRing] Failed to create shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+      return 0;
+   }
+   if ( 0 != ftruncate(fd, sizeof(type_video_frame_ring_header)) )
+   {
+      log_softerror_and_alarm("[VideoFrameRing] Failed to set size of shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+      close(fd);
+      shm_unlink(pRing->szName);
+      return 0;
+   }
+   if ( ! _video_frame_ring_map(pRing, fd) )
+   {
+      shm_unlink(pRing->szName);
+      return 0;
+   }
+
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   memset(pHeader, 0, sizeof(type_video_frame_ring_header) - VIDEO_FRAME_RING_DATA_SIZE);
+   pHeader->uVersion = VIDEO_FRAME_RING_VERSION;
+   pHeader->uDataSize = VIDEO_FRAME_RING_DATA_SIZE;
+   pHeader->uMaxFrames = VIDEO_FRAME_RING_MAX_FRAMES;
+   for( int i=0; i<VIDEO_FRAME_RING_MAX_FRAMES; i++ )
+      pHeader->frames[i].uRefCount = VIDEO_FRAME_RING_REF_RECLAIMED;
+   __atomic_store_n(&pHeader->uMagic, VIDEO_FRAME_RING_MAGIC, __ATOMIC_RELEASE);
+
+   log_line("[VideoFrameRing] Created shared memory %s: %u frames, %u bytes data.", pRing->szName, (u32)VIDEO_FRAME_RING_MAX_FRAMES, (u32)VIDEO_FRAME_RING_DATA_SIZE);
+   return 1;
+}
+
+// Consumer: drops the frame references left by a previous consumer (killed while holding frames),
+// otherwise the producer could never reclaim those frames and would drop all new ones.
+// There is only one consumer, so any reference present when it opens the ring is stale.
+// Keeps the reclaimed flag as it is, so it does not race with the producer reclaiming or publishing slots.
+static int _video_frame_ring_reset_references(type_video_frame_ring* pRing)
+{
+   int iCountReset = 0;
+   for( int i=0; i<VIDEO_FRAME_RING_MAX_FRAMES; i++ )
+   {
+      type_video_frame_ring_desc* pDesc = &pRing->pHeader->frames[i];
+      u32 uRef = __atomic_load_n(&pDesc->uRefCount, __ATOMIC_ACQUIRE);
+      while ( (uRef & ~VIDEO_FRAME_RING_REF_RECLAIMED) != 0 )
+      {
+         if ( __atomic_compare_exchange_n(&pDesc->uRefCount, &uRef, uRef & VIDEO_FRAME_RING_REF_RECLAIMED, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+         {
+            iCountReset++;
+            break;
+         }
+      }
+   }
+   return iCountReset;
+}
+
+int video_frame_ring_open(type_video_frame_ring* pRing, const char* szName)
+{
+   if ( (NULL == pRing) || (NULL == szName) )
+      return 0;
+   memset(pRing, 0, sizeof(type_video_frame_ring));
+   strncpy(pRing->szName, szName, sizeof(pRing->szName)-1);
+
+   int fd = shm_open(pRing->szName, O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( fd < 0 )
+   {
+      log_softerror_and_alarm("[VideoFrameRing] Failed to open shared memory %s, error: %d, %s", pRing->szName, errno, strerror(errno));
+      return 0;
+   }
+   struct stat fdStat;
+   if ( (0 != fstat(fd, &fdStat)) || (fdStat.st_size < (off_t)sizeof(type_video_frame_ring_header)) )
+   {
+      log_softerror_and_alarm("[VideoFrameRing] Shared memory %s has an invalid size.", pRing->szName);
+      close(fd);
+      return 0;
+   }
+   if ( ! _video_frame_ring_map(pRing, fd) )
+      return 0;
+
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   u32 uTimeStart = get_current_timestamp_ms();
+   while ( __atomic_load_n(&pHeader->uMagic, __ATOMIC_ACQUIRE) != VIDEO_FRAME_RING_MAGIC )
+   {
+      if ( get_current_timestamp_ms() > uTimeStart + 200 )
+         break;
+      hardware_sleep_ms(1);
+   }
+   if ( (pHeader->uMagic != VIDEO_FRAME_RING_MAGIC) || (pHeader->uVersion != VIDEO_FRAME_RING_VERSION) ||
+        (pHeader->uDataSize != VIDEO_FRAME_RING_DATA_SIZE) || (pHeader->uMaxFrames != VIDEO_FRAME_RING_MAX_FRAMES) )
+   {
+      log_softerror_and_alarm("[VideoFrameRing] Shared memory %s has an invalid or old format (magic: %X, version: %u).", pRing->szName, pHeader->uMagic, pHeader->uVersion);
+      video_frame_ring_close(pRing);
+      return 0;
+   }
+   __atomic_store_n(&pHeader->uReadSeq, __atomic_load_n(&pHeader->uPublishSeq, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+   int iCountReset = _video_frame_ring_reset_references(pRing);
+   log_line("[VideoFrameRing] Opened shared memory %s, %u frames published so far, %d frames still referenced by a previous consumer.", pRing->szName, pHeader->uTotalFramesPublished, iCountReset);
+   return 1;
+}
+
+void video_frame_ring_close(type_video_frame_ring* pRing)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return;
+   munmap(pRing->pHeader, sizeof(type_video_frame_ring_header));
+   pRing->pHeader = NULL;
+}
+
+// Producer: frees the oldest frame slot and its data, if the consumer does not reference it
+static int _video_frame_ring_reclaim_oldest(type_video_frame_ring* pRing)
+{
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   u32 uOldest = pHeader->uOldestSeq;
+   if ( uOldest == pHeader->uPublishSeq )
+      return 0;
+   type_video_frame_ring_desc* pDesc = &pHeader->frames[uOldest & (VIDEO_FRAME_RING_MAX_FRAMES-1)];
+   u32 uExpected = 0;
+   if ( ! __atomic_compare_exchange_n(&pDesc->uRefCount, &uExpected, VIDEO_FRAME_RING_REF_RECLAIMED, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+      return 0;
+   if ( (int)(uOldest - __atomic_load_n(&pHeader->uReadSeq, __ATOMIC_ACQUIRE)) >= 0 )
+      pHeader->uTotalFramesReclaimedUnread++;
+   __atomic_store_n(&pHeader->uOldestSeq, uOldest+1, __ATOMIC_RELEASE);
+   return 1;
+}
+
+// Producer: checks if uLength more bytes fit contiguous after the open frame data. Sets *piMoveToStart
+// if they fit only after moving the open frame to the start of the data area.
+static int _video_frame_ring_has_room(type_video_frame_ring* pRing, u32 uLength, int* piMoveToStart)
+{
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   u32 uPartial = pRing->uWritePos - pRing->uFrameStart;
+   *piMoveToStart = 0;
+
+   if ( pHeader->uOldestSeq == pHeader->uPublishSeq )
+   {
+      if ( pRing->uWritePos + uLength <= VIDEO_FRAME_RING_DATA_SIZE )
+         return 1;
+      *piMoveToStart = 1;
+      return 1;
+   }
+
+   // Published frames are in [uLiveStart, uFrameStart), circular
+   u32 uLiveStart = pHeader->frames[pHeader->uOldestSeq & (VIDEO_FRAME_RING_MAX_FRAMES-1)].uOffset;
+   if ( pRing->uFrameStart > uLiveStart )
+   {
+      if ( pRing->uWritePos + uLength <= VIDEO_FRAME_RING_DATA_SIZE )
+         return 1;
+      if ( uPartial + uLength <= uLiveStart )
+      {
+         *piMoveToStart = 1;
+         return 1;
+      }
+      return 0;
+   }
+   return (pRing->uWritePos + uLength <= uLiveStart)?1:0;
+}
+
+static void _video_frame_ring_drop_frame(type_video_frame_ring* pRing)
+{
+   if ( ! pRing->iDroppingFrame )
+      pRing->pHeader->uTotalFramesDropped++;
+   pRing->iDroppingFrame = 1;
+   pRing->uWritePos = pRing->uFrameStart;
+}
+
+int video_frame_ring_write(type_video_frame_ring* pRing, u8* pData, u32 uLength)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) || (NULL == pData) || (0 == uLength) )
+      return 0;
+   if ( pRing->iDroppingFrame )
+      return 0;
+
+   if ( pRing->uWritePos == pRing->uFrameStart )
+      pRing->uTimeFrameFirstData = video_frame_ring_get_time_micros();
+
+   if ( pRing->uWritePos - pRing->uFrameStart + uLength > VIDEO_FRAME_RING_MAX_FRAME_SIZE )
+   {
+      _video_frame_ring_drop_frame(pRing);
+      return 0;
+   }
+
+   int iMoveToStart = 0;
+   while ( ! _video_frame_ring_has_room(pRing, uLength, &iMoveToStart) )
+   {
+      if ( ! _video_frame_ring_reclaim_oldest(pRing) )
+      {
+         _video_frame_ring_drop_frame(pRing);
+         return 0;
+      }
+   }
+
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   if ( iMoveToStart )
+   {
+      u32 uPartial = pRing->uWritePos - pRing->uFrameStart;
+      if ( uPartial > 0 )
+         memmove(&pHeader->uData[0], &pHeader->uData[pRing->uFrameStart], uPartial);
+      pHeader->uTotalBytesMoved += uPartial;
+      pRing->uFrameStart = 0;
+      pRing->uWritePos = uPartial;
+   }
+   memcpy(&pHeader->uData[pRing->uWritePos], pData, uLength);
+   pRing->uWritePos += uLength;
+   return 1;
+}
+
+int video_frame_ring_publish(type_video_frame_ring* pRing, u32 uFlags)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return 0;
+   if ( pRing->iDroppingFrame )
+   {
+      pRing->iDroppingFrame = 0;
+      pRing->iDiscontinuity = 1;
+      pRing->uWritePos = pRing->uFrameStart;
+      return 0;
+   }
+   u32 uLength = pRing->uWritePos - pRing->uFrameStart;
+   if ( 0 == uLength )
+      return 0;
+
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   while ( pHeader->uPublishSeq - pHeader->uOldestSeq >= VIDEO_FRAME_RING_MAX_FRAMES )
+   {
+      if ( ! _video_frame_ring_reclaim_oldest(pRing) )
+      {
+         pHeader->uTotalFramesDropped++;
+         pRing->iDiscontinuity = 1;
+         pRing->uWritePos = pRing->uFrameStart;
+         return 0;
+      }
+   }
+
+   u32 uSeq = pHeader->uPublishSeq;
+   type_video_frame_ring_desc* pDesc = &pHeader->frames[uSeq & (VIDEO_FRAME_RING_MAX_FRAMES-1)];
+   pDesc->uOffset = pRing->uFrameStart;
+   pDesc->uLength = uLength;
+   pDesc->uFlags = uFlags;
+   if ( pRing->iDiscontinuity )
+      pDesc->uFlags |= VIDEO_FRAME_RING_FLAG_DISCONTINUITY;
+   pDesc->uTimeFirstDataMicros = pRing->uTimeFrameFirstData;
+   pDesc->uTimePublishedMicros = video_frame_ring_get_time_micros();
+   __atomic_store_n(&pDesc->uSequence, uSeq, __ATOMIC_RELAXED);
+   // Valid for the consumer from now on (a consumer reference taken on the old frame is kept in the count)
+   __atomic_sub_fetch(&pDesc->uRefCount, VIDEO_FRAME_RING_REF_RECLAIMED, __ATOMIC_RELEASE);
+
+   pRing->iDiscontinuity = 0;
+   pRing->uFrameStart = pRing->uWritePos;
+   pHeader->uTotalFramesPublished++;
+   pHeader->uTotalBytesPublished += uLength;
+
+   // Publish, then wake up the consumer if it waits (full barriers, paired with video_frame_ring_acquire)
+   __atomic_store_n(&pHeader->uPublishSeq, uSeq+1, __ATOMIC_SEQ_CST);
+   if ( __atomic_load_n(&pHeader->uConsumerWaiting, __ATOMIC_SEQ_CST) )
+      _video_frame_ring_futex(&pHeader->uPublishSeq, FUTEX_WAKE, 1, NULL);
+   return 1;
+}
+
+void video_frame_ring_discard_frame(type_video_frame_ring* pRing)
+{
+   if ( NULL == pRing )
+      return;
+   pRing->uWritePos = pRing->uFrameStart;
+   pRing->iDroppingFrame = 0;
+}
+
+int video_frame_ring_acquire(type_video_frame_ring* pRing, u32 uTimeoutMicros, type_video_frame_ring_frame* pFrame)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) || (NULL == pFrame) )
+      return 0;
+
+   type_video_frame_ring_header* pHeader = pRing->pHeader;
+   u32 uReadSeq = pHeader->uReadSeq;
+   u32 uSkipped = 0;
+   int iWaited = 0;
+
+   while ( 1 )
+   {
+      u32 uPublishSeq = __atomic_load_n(&pHeader->uPublishSeq, __ATOMIC_SEQ_CST);
+      if ( uReadSeq == uPublishSeq )
+      {
+         if ( (0 == uTimeoutMicros) || iWaited )
+            break;
+         iWaited = 1;
+         __atomic_store_n(&pHeader->uConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+         struct timespec timeout;
+         timeout.tv_sec = uTimeoutMicros / 1000000;
+         timeout.tv_nsec = (uTimeoutMicros % 1000000) * 1000;
+         _video_frame_ring_futex(&pHeader->uPublishSeq, FUTEX_WAIT, uReadSeq, &timeout);
+         __atomic_store_n(&pHeader->uConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+         continue;
+      }
+
+      u32 uOldestSeq = __atomic_load_n(&pHeader->uOldestSeq, __ATOMIC_ACQUIRE);
+      if ( (int)(uReadSeq - uOldestSeq) < 0 )
+      {
+         uSkipped += uOldestSeq - uReadSeq;
+         uReadSeq = uOldestSeq;
+         continue;
+      }
+
+      type_video_frame_ring_desc* pDesc = &pHeader->frames[uReadSeq & (VIDEO_FRAME_RING_MAX_FRAMES-1)];
+      u32 uRef = __atomic_fetch_add(&pDesc->uRefCount, 1, __ATOMIC_ACQ_REL);
+      if ( (uRef & VIDEO_FRAME_RING_REF_RECLAIMED) || (__atomic_load_n(&pDesc->uSequence, __ATOMIC_ACQUIRE) != uReadSeq) )
+      {
+         // Reclaimed by the producer right now; the oldest sequence moves past it
+         __atomic_sub_fetch(&pDesc->uRefCount, 1, __ATOMIC_RELEASE);
+         sched_yield();
+         continue;
+      }
+
+      pFrame->pData = &pHeader->uData[pDesc->uOffset];
+      pFrame->uSequence = uReadSeq;
+      pFrame->uLength = pDesc->uLength;
+      pFrame->uFlags = pDesc->uFlags;
+      pFrame->uSkippedBefore = uSkipped;
+      pFrame->uTimeFirstDataMicros = pDesc->uTimeFirstDataMicros;
+      pFrame->uTimePublishedMicros = pDesc->uTimePublishedMicros;
+      pHeader->uTotalFramesSkipped += uSkipped;
+      __atomic_store_n(&pHeader->uReadSeq, uReadSeq+1, __ATOMIC_RELEASE);
+      return 1;
+   }
+
+   if ( uSkipped > 0 )
+   {
+      pHeader->uTotalFramesSkipped += uSkipped;
+      __atomic_store_n(&pHeader->uReadSeq, uReadSeq, __ATOMIC_RELEASE);
+   }
+   return 0;
+}
+
+void video_frame_ring_release(type_video_frame_ring* pRing, type_video_frame_ring_frame* pFrame)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) || (NULL == pFrame) || (NULL == pFrame->pData) )
+      return;
+   type_video_frame_ring_desc* pDesc = &pRing->pHeader->frames[pFrame->uSequence & (VIDEO_FRAME_RING_MAX_FRAMES-1)];
+   __atomic_sub_fetch(&pDesc->uRefCount, 1, __ATOMIC_RELEASE);
+   pFrame->pData = NULL;
+}
+
+int video_frame_ring_get_pending_count(type_video_frame_ring* pRing)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pHeader) )
+      return 0;
+   return (int)(__atomic_load_n(&pRing->pHeader->uPublishSeq, __ATOMIC_ACQUIRE) - __atomic_load_n(&pRing->pHeader->uReadSeq, __ATOMIC_ACQUIRE));
+}
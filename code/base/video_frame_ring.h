@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../base/base.h"
+
+// Frame oriented shared memory ring for the video stream from the router to the local video player.
+// The router writes the received H264/H265 data in place in the ring data area and publishes a
+// descriptor (offset, length, flags, times) when the frame (NAL) is complete. A frame never wraps
+// around the end of the data area, so the player gets a pointer to contiguous frame data in the
+// shared memory and hands it straight to the decoder input packet, then releases it.
+// One producer, one consumer. A frame referenced by the consumer is never overwritten: when the ring
+// is full the producer reclaims the oldest frames not referenced (the consumer sees them as skipped
+// frames) or, if the oldest frame is referenced, drops the frame it is writing.
+// The consumer blocks on a futex on the publish sequence (shared across processes) until a frame is published.
+
+#define VIDEO_FRAME_RING_NAME "/SSMRVideoFrames"
+#define VIDEO_FRAME_RING_MAGIC 0x56465247
+#define VIDEO_FRAME_RING_VERSION 1
+#define VIDEO_FRAME_RING_MAX_FRAMES 128 // power of 2
+#define VIDEO_FRAME_RING_DATA_SIZE (1024*1024)
+#define VIDEO_FRAME_RING_MAX_FRAME_SIZE (VIDEO_FRAME_RING_DATA_SIZE/2)
+
+// Set in the descriptor reference count while the frame slot is not valid (free or reused by the producer)
+#define VIDEO_FRAME_RING_REF_RECLAIMED 0x80000000
+
+#define VIDEO_FRAME_RING_FLAG_NAL_END 0x01 // data ends on a NAL end (not set if the router does not wait for full frames)
+#define VIDEO_FRAME_RING_FLAG_H265 0x02
+#define VIDEO_FRAME_RING_FLAG_DISCONTINUITY 0x04 // the producer dropped data before this frame
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   u32 uSequence;
+   u32 uRefCount; // consumer references, plus VIDEO_FRAME_RING_REF_RECLAIMED while the slot is not valid
+   u32 uOffset;
+   u32 uLength;
+   u32 uFlags;
+   u32 uReserved;
+   u64 uTimeFirstDataMicros; // video_frame_ring_get_time_micros() clock
+   u64 uTimePublishedMicros;
+} __attribute__((aligned(64))) type_video_frame_ring_desc;
+
+typedef struct
+{
+   u32 uMagic;
+   u32 uVersion;
+   u32 uDataSize;
+   u32 uMaxFrames;
+
+   // Producer
+   u32 uPublishSeq __attribute__((aligned(64))); // sequence of the next frame to publish, futex word
+   u32 uOldestSeq; // oldest frame not reclaimed
+   u32 uTotalFramesPublished;
+   u32 uTotalFramesDropped; // not published: ring full with referenced frames or too big
+   u32 uTotalFramesReclaimedUnread;
+   u32 uTotalBytesPublished;
+   u32 uTotalBytesMoved; // partial frames moved to the start of the data area
+
+   // Consumer
+   u32 uReadSeq __attribute__((aligned(64)));
+   u32 uConsumerWaiting;
+   u32 uTotalFramesSkipped;
+
+   type_video_frame_ring_desc frames[VIDEO_FRAME_RING_MAX_FRAMES];
+   u8 uData[VIDEO_FRAME_RING_DATA_SIZE] __attribute__((aligned(64)));
+} type_video_frame_ring_header;
+
+typedef struct
+{
+   type_video_frame_ring_header* pHeader;
+   char szName[64];
+
+   // Producer side only
+   u32 uFrameStart; // open frame (not published yet)
+   u32 uWritePos;
+   u64 uTimeFrameFirstData;
+   int iDroppingFrame;
+   int iDiscontinuity;
+} type_video_frame_ring;
+
+// A frame acquired by the consumer, valid until released
+typedef struct
+{
+   u8* pData;
+   u32 uSequence;
+   u32 uLength;
+   u32 uFlags;
+   u32 uSkippedBefore; // frames reclaimed by the producer before the consumer got to them
+   u64 uTimeFirstDataMicros;
+   u64 uTimePublishedMicros;
+} type_video_frame_ring_frame;
+
+u64 video_frame_ring_get_time_micros();
+
+// Producer: creates (or recreates, cleared) the ring. Returns 1 on success.
+int video_frame_ring_create(type_video_frame_ring* pRing, const char* szName);
+// Consumer: opens an existing ring, starts with the next published frame and drops the frame references
+// left by a previous consumer. Returns 1 on success.
+int video_frame_ring_open(type_video_frame_ring* pRing, const char* szName);
+void video_frame_ring_close(type_video_frame_ring* pRing);
+
+// Producer: appends data to the open frame. Returns 0 if the open frame is dropped.
+int video_frame_ring_write(type_video_frame_ring* pRing, u8* pData, u32 uLength);
+// Producer: publishes the open frame and wakes up the consumer. Returns 1 if a frame was published.
+int video_frame_ring_publish(type_video_frame_ring* pRing, u32 uFlags);
+// Producer: discards the data of the open frame
+void video_frame_ring_discard_frame(type_video_frame_ring* pRing);
+
+// Consumer: gets the next frame (a reference on it), waits up to uTimeoutMicros for it. Returns 1 if pFrame is valid.
+int video_frame_ring_acquire(type_video_frame_ring* pRing, u32 uTimeoutMicros, type_video_frame_ring_frame* pFrame);
+void video_frame_ring_release(type_video_frame_ring* pRing, type_video_frame_ring_frame* pFrame);
+int video_frame_ring_get_pending_count(type_video_frame_ring* pRing);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1583,6 +1583,12 @@ char* str_get_developer_flags(u32 uDeveloperFlags)
       strcat(s_szDeveloperFlagsDesc, " INJECT_VIDEO_FAULTS2");
    if ( uDeveloperFlags & DEVELOPER_FLAGS_USE_PCAP_RADIO_TX )
       strcat(s_szDeveloperFlagsDesc, " USE_PCAP_RADIO_TX");
+   if ( uDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX )
+      strcat(s_szDeveloperFlagsDesc, " USE_MMAP_RING_RADIO_RX");
+   if ( uDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX )
+      strcat(s_szDeveloperFlagsDesc, " USE_BATCHED_RADIO_TX");
+   if ( uDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX )
+      strcat(s_szDeveloperFlagsDesc, " USE_PACED_VIDEO_TX");
    
    if ( 0 == s_szDeveloperFlagsDesc[0] )
       strcpy(s_szDeveloperFlagsDesc, "[None]");
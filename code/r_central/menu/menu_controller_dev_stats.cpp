@@ -222,6 +222,13 @@ void MenuControllerDevStatsConfig::addItems()
    m_pItemsSelect[18]->setSelectedIndex( (pP->uDebugStatsFlags & CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_FRAMES_RECV_DURATION)?1:0);
    m_IndexShowVideoFramesRecvTimes = addMenuItem(m_pItemsSelect[18]);
 
+   m_pItemsSelect[21] = new MenuItemSelect("Show Video Latency per Stage (@GS Side)", "Shows the percentiles of the time spent in each stage of the video pipeline on the controller, over the last seconds.");
+   m_pItemsSelect[21]->addSelection("No");
+   m_pItemsSelect[21]->addSelection("Yes");
+   m_pItemsSelect[21]->setUseMultiViewLayout();
+   m_pItemsSelect[21]->setSelectedIndex( (pP->uDebugStatsFlags & CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_LATENCY_TRACE)?1:0);
+   m_IndexShowVideoLatencyTrace = addMenuItem(m_pItemsSelect[21]);
+
    for( int i=0; i<m_ItemsCount; i++ )
       m_pMenuItems[i]->setTextColor(get_Color_Dev());
 
@@ -415,6 +422,14 @@ void MenuControllerDevStatsConfig::onSelectItem()
          pP->uDebugStatsFlags &= ~CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_FRAMES_RECV_DURATION;
    }
 
+   if ( m_IndexShowVideoLatencyTrace == m_SelectedIndex )
+   {
+      if ( m_pItemsSelect[21]->getSelectedIndex() != 0 )
+         pP->uDebugStatsFlags |= CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_LATENCY_TRACE;
+      else
+         pP->uDebugStatsFlags &= ~CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_LATENCY_TRACE;
+   }
+
    if ( m_IndexShowVideoProfileChanges == m_SelectedIndex )
    {
       if ( m_pItemsSelect[10]->getSelectedIndex() != 0 )
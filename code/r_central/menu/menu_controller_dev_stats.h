@@ -39,4 +39,5 @@ class MenuControllerDevStatsConfig: public Menu
       int m_IndexShowVideoFramesSendTimes;
       int m_IndexShowVideoFramesRecvTimes;
       int m_IndexShowVideoFramesCaptureJitter;
+      int m_IndexShowVideoLatencyTrace;
 };
\ No newline at end of file
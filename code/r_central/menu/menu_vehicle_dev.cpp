@@ -80,6 +80,27 @@ void MenuVehicleDev::addItems()
       m_pItemsSelect[9]->setSelectedIndex(1);
    m_IndexPCAPRadioTx = addMenuItem(m_pItemsSelect[9]);
 
+   m_pItemsSelect[10] = new MenuItemSelect("Radio Rx Type", "What method the vehicle and the controller use for receiving radio packets. Mmap ring reads blocks of packets from a kernel ring buffer.");
+   m_pItemsSelect[10]->addSelection("PPCAP");
+   m_pItemsSelect[10]->addSelection("Mmap ring");
+   m_pItemsSelect[10]->setIsEditable();
+   m_pItemsSelect[10]->setSelectedIndex((g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX)?1:0);
+   m_IndexMMapRingRadioRx = addMenuItem(m_pItemsSelect[10]);
+
+   m_pItemsSelect[11] = new MenuItemSelect("Vehicle Batched Radio Tx", "Sends each burst of video packets to the radio driver with a single system call (sockets Tx type only).");
+   m_pItemsSelect[11]->addSelection("No");
+   m_pItemsSelect[11]->addSelection("Yes");
+   m_pItemsSelect[11]->setIsEditable();
+   m_pItemsSelect[11]->setSelectedIndex((g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX)?1:0);
+   m_IndexBatchedRadioTx = addMenuItem(m_pItemsSelect[11]);
+
+   m_pItemsSelect[13] = new MenuItemSelect("Vehicle Paced Video Tx", "Paces video packets to the radio driver from a dedicated thread, so the vehicle main loop does not wait for the radio (sockets Tx type only).");
+   m_pItemsSelect[13]->addSelection("No");
+   m_pItemsSelect[13]->addSelection("Yes");
+   m_pItemsSelect[13]->setIsEditable();
+   m_pItemsSelect[13]->setSelectedIndex((g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX)?1:0);
+   m_IndexPacedVideoTx = addMenuItem(m_pItemsSelect[13]);
+
    m_pItemsSelect[6] = new MenuItemSelect("Bypass kernel sockets buffers", "Skip kernel's qdisc (traffic control) layer (PACKET_QDISC_BYPASS).");
    m_pItemsSelect[6]->addSelection("No");
    m_pItemsSelect[6]->addSelection("Yes");
@@ -231,6 +252,39 @@ void MenuVehicleDev::onSelectItem()
       return;
    }
 
+   if ( m_IndexMMapRingRadioRx == m_SelectedIndex )
+   {
+      if ( 0 == m_pItemsSelect[10]->getSelectedIndex() )
+         g_pCurrentModel->uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX);
+      else
+         g_pCurrentModel->uDeveloperFlags |= DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX;
+      if ( ! handle_commands_send_developer_flags(g_pCurrentModel->uDeveloperFlags) )
+         valuesToUI();
+      return;
+   }
+
+   if ( m_IndexBatchedRadioTx == m_SelectedIndex )
+   {
+      if ( 0 == m_pItemsSelect[11]->getSelectedIndex() )
+         g_pCurrentModel->uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX);
+      else
+         g_pCurrentModel->uDeveloperFlags |= DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX;
+      if ( ! handle_commands_send_developer_flags(g_pCurrentModel->uDeveloperFlags) )
+         valuesToUI();
+      return;
+   }
+
+   if ( m_IndexPacedVideoTx == m_SelectedIndex )
+   {
+      if ( 0 == m_pItemsSelect[13]->getSelectedIndex() )
+         g_pCurrentModel->uDeveloperFlags &= (~DEVELOPER_FLAGS_USE_PACED_VIDEO_TX);
+      else
+         g_pCurrentModel->uDeveloperFlags |= DEVELOPER_FLAGS_USE_PACED_VIDEO_TX;
+      if ( ! handle_commands_send_developer_flags(g_pCurrentModel->uDeveloperFlags) )
+         valuesToUI();
+      return;
+   }
+
    if ( m_IndexBypassSocketBuffers == m_SelectedIndex )
    {
       u32 uFlags = g_pCurrentModel->radioLinksParams.uGlobalRadioLinksFlags;
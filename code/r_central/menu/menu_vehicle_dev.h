@@ -20,6 +20,9 @@ class MenuVehicleDev: public Menu
 
       int m_IndexDevStats;
       int m_IndexPCAPRadioTx;
+      int m_IndexMMapRingRadioRx;
+      int m_IndexBatchedRadioTx;
+      int m_IndexPacedVideoTx;
       int m_IndexBypassSocketBuffers;
       int m_IndexClockSyncType;
       int m_IndexRadioSilence;
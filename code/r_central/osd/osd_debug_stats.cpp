@@ -34,6 +34,8 @@
 #include "../../base/utils.h"
 #include "../../base/ctrl_preferences.h"
 #include "../../base/ctrl_settings.h"
+#include "../../base/shared_mem.h"
+#include "../../base/latency_trace.h"
 #include "../../common/string_utils.h"
 #include <math.h>
 #include "osd_debug_stats.h"
@@ -1039,6 +1041,67 @@ float _osd_render_ack_time_hist(controller_runtime_info_vehicle* pRTInfoVehicle,
    return yPos;
 }
 
+static type_latency_trace_stats* s_pSMLatencyTraceStation = NULL;
+static type_latency_trace_stats s_LatencyTracePrevious;
+static type_latency_trace_stats s_LatencyTraceWindow;
+static u32 s_uTimeLastLatencyTraceUpdate = 0;
+static u32 s_uTimeLastLatencyTraceOpenTry = 0;
+
+// Percentiles of each controller side stage of the video pipeline, over the last second (see latency_trace.h)
+float _osd_render_latency_trace(float xPos, float yPos)
+{
+   char szBuff[256];
+   float height_text = g_pRenderEngine->textHeight(s_idFontStats);
+
+   if ( NULL == s_pSMLatencyTraceStation )
+   if ( (0 == s_uTimeLastLatencyTraceOpenTry) || (g_TimeNow > s_uTimeLastLatencyTraceOpenTry + 2000) )
+   {
+      s_uTimeLastLatencyTraceOpenTry = g_TimeNow;
+      s_pSMLatencyTraceStation = latency_trace_open_for_read(SHARED_MEM_LATENCY_TRACE_STATION);
+      if ( NULL != s_pSMLatencyTraceStation )
+      {
+         latency_trace_snapshot(s_pSMLatencyTraceStation, &s_LatencyTracePrevious);
+         memset(&s_LatencyTraceWindow, 0, sizeof(type_latency_trace_stats));
+         s_uTimeLastLatencyTraceUpdate = g_TimeNow;
+      }
+   }
+
+   if ( NULL == s_pSMLatencyTraceStation )
+   {
+      g_pRenderEngine->drawText(xPos, yPos, s_idFontStats, "Video Latency per Stage (@GS Side): not available");
+      return yPos + height_text*1.3;
+   }
+
+   if ( (! s_bDebugStatsControllerInfoFreeze) && (g_TimeNow >= s_uTimeLastLatencyTraceUpdate + 1000) )
+   {
+      type_latency_trace_stats current;
+      latency_trace_snapshot(s_pSMLatencyTraceStation, &current);
+      for( int i=0; i<LATENCY_TRACE_STAGES; i++ )
+         latency_trace_histogram_diff(&(current.stages[i]), &(s_LatencyTracePrevious.stages[i]), &(s_LatencyTraceWindow.stages[i]));
+      memcpy(&s_LatencyTracePrevious, &current, sizeof(type_latency_trace_stats));
+      s_uTimeLastLatencyTraceUpdate = g_TimeNow;
+   }
+
+   g_pRenderEngine->drawText(xPos, yPos, s_idFontStats, "Video Latency per Stage (@GS Side), last second: count, p50 / p95 / p99 / max (ms)");
+   yPos += height_text*1.3;
+
+   for( int i=LATENCY_TRACE_STAGE_RADIO_RX; i<=LATENCY_TRACE_STAGE_OUTPUT; i++ )
+   {
+      type_latency_trace_histogram* pHist = &(s_LatencyTraceWindow.stages[i]);
+      if ( 0 == pHist->uCount )
+         snprintf(szBuff, sizeof(szBuff)/sizeof(szBuff[0]), "%s: 0", latency_trace_get_stage_name(i));
+      else
+         snprintf(szBuff, sizeof(szBuff)/sizeof(szBuff[0]), "%s: %u, %.1f / %.1f / %.1f / %.1f", latency_trace_get_stage_name(i), pHist->uCount,
+            (float)latency_trace_histogram_get_percentile(pHist, 50)/1000.0,
+            (float)latency_trace_histogram_get_percentile(pHist, 95)/1000.0,
+            (float)latency_trace_histogram_get_percentile(pHist, 99)/1000.0,
+            (float)pHist->uMaxMicros/1000.0);
+      g_pRenderEngine->drawText(xPos, yPos, s_idFontStats, szBuff);
+      yPos += height_text*1.1;
+   }
+   return yPos;
+}
+
 void osd_render_debug_stats()
 {
    Preferences* pP = get_Preferences();
@@ -2397,6 +2460,14 @@ void osd_render_debug_stats()
       iCountGraphs++;
    }
 
+   //--------------------------------------------
+   if ( pP->uDebugStatsFlags & CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_LATENCY_TRACE )
+   {
+      y = _osd_render_latency_trace(xPos, y);
+      y += height_text_small;
+      iCountGraphs++;
+   }
+
    //--------------------------------------------
    if ( pP->uDebugStatsFlags & CTRL_RT_DEBUG_INFO_FLAG_SHOW_VIDEO_FRAMES_RECV_DURATION )
    {
@@ -321,6 +321,7 @@ void _pairing_open_shared_mem()
       if ( NULL != g_pSM_RadioStats )
          break;
       g_pSM_RadioStats = shared_mem_radio_stats_open_for_read();
+      shared_mem_sections_reader_reset(&g_SMReaderRadioStats);
       hardware_sleep_ms(2);
       iAnyNewOpen++;
    }
@@ -359,6 +360,7 @@ void _pairing_open_shared_mem()
       if ( NULL != g_pSM_VideoDecodeStats )
          break;
       g_pSM_VideoDecodeStats = shared_mem_video_stream_stats_rx_processors_open_for_read();
+      shared_mem_sections_reader_reset(&g_SMReaderVideoDecodeStats);
       hardware_sleep_ms(2);
       iAnyNewOpen++;
    }
@@ -2205,11 +2205,13 @@ void clear_shared_mems()
    memset(&g_SM_HistoryRxStats, 0, sizeof(shared_mem_radio_stats_rx_hist));
    memset(&g_SM_HistoryRxStatsVehicle, 0, sizeof(shared_mem_radio_stats_rx_hist));
    memset(&g_SM_VideoDecodeStats, 0, sizeof(shared_mem_video_stream_stats_rx_processors));
+   shared_mem_sections_reader_reset(&g_SMReaderVideoDecodeStats);
    
    memset(&g_SMControllerRTInfo, 0, sizeof(controller_runtime_info));
    memset(&g_SM_DownstreamInfoRC, 0, sizeof(t_packet_header_rc_info_downstream));
    memset(&g_SM_RouterVehiclesRuntimeInfo, 0, sizeof(shared_mem_router_vehicles_runtime_info));
    memset(&g_SM_RadioStats, 0, sizeof(shared_mem_radio_stats));
+   shared_mem_sections_reader_reset(&g_SMReaderRadioStats);
    memset(&g_SM_RadioRxQueueInfo, 0, sizeof(shared_mem_radio_rx_queue_info));
    memset(&g_SM_DevVideoBitrateHistory, 0, sizeof(shared_mem_dev_video_bitrate_history));
    memset(&g_SM_RCIn, 0, sizeof(t_shared_mem_i2c_controller_rc_in));
@@ -2315,7 +2317,7 @@ void synchronize_shared_mems()
    if ( NULL != g_pSM_RouterVehiclesRuntimeInfo )
       memcpy((u8*)&g_SM_RouterVehiclesRuntimeInfo, g_pSM_RouterVehiclesRuntimeInfo, sizeof(shared_mem_router_vehicles_runtime_info));
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)&g_SM_RadioStats, g_pSM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_read(g_pSM_RadioStats, &g_SM_RadioStats, &g_SMReaderRadioStats);
    
    if ( NULL != g_pSM_HistoryRxStats )
       memcpy((u8*)&g_SM_HistoryRxStats, g_pSM_HistoryRxStats, sizeof(shared_mem_radio_stats_rx_hist));
@@ -2333,7 +2335,7 @@ void synchronize_shared_mems()
    }
 
    if ( NULL != g_pSM_VideoDecodeStats )
-      memcpy((u8*)&g_SM_VideoDecodeStats, g_pSM_VideoDecodeStats, sizeof(shared_mem_video_stream_stats_rx_processors));
+      shared_mem_video_stream_stats_rx_processors_read(g_pSM_VideoDecodeStats, &g_SM_VideoDecodeStats, &g_SMReaderVideoDecodeStats);
    if ( NULL != g_pSM_RadioRxQueueInfo )
       memcpy((u8*)&g_SM_RadioRxQueueInfo, g_pSM_RadioRxQueueInfo, sizeof(shared_mem_radio_rx_queue_info));
    if ( NULL != g_pSM_RCIn )
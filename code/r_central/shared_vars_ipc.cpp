@@ -59,8 +59,9 @@ t_packet_header_rc_info_downstream g_SM_DownstreamInfoRC; // RC Info received on
 shared_mem_router_vehicles_runtime_info* g_pSM_RouterVehiclesRuntimeInfo = NULL;
 shared_mem_router_vehicles_runtime_info g_SM_RouterVehiclesRuntimeInfo;
 
-shared_mem_radio_stats* g_pSM_RadioStats = NULL;
+shared_mem_radio_stats_versioned* g_pSM_RadioStats = NULL;
 shared_mem_radio_stats g_SM_RadioStats;
+shared_mem_sections_reader g_SMReaderRadioStats;
 
 shared_mem_radio_stats_rx_hist* g_pSM_HistoryRxStats = NULL;
 shared_mem_radio_stats_rx_hist g_SM_HistoryRxStats;
@@ -73,8 +74,9 @@ shared_mem_video_frames_stats g_SM_VideoFramesStatsOutput;
 //shared_mem_video_frames_stats g_VideoInfoStatsFromVehicleCameraOut;
 //shared_mem_video_frames_stats g_VideoInfoStatsFromVehicleRadioOut;
 
-shared_mem_video_stream_stats_rx_processors* g_pSM_VideoDecodeStats = NULL;
+shared_mem_video_stream_stats_rx_processors_versioned* g_pSM_VideoDecodeStats = NULL;
 shared_mem_video_stream_stats_rx_processors g_SM_VideoDecodeStats;
+shared_mem_sections_reader g_SMReaderVideoDecodeStats;
 
 shared_mem_radio_rx_queue_info* g_pSM_RadioRxQueueInfo = NULL;
 shared_mem_radio_rx_queue_info g_SM_RadioRxQueueInfo;
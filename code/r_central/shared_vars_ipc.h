@@ -34,8 +34,9 @@ extern t_packet_header_rc_info_downstream g_SM_DownstreamInfoRC;
 extern shared_mem_router_vehicles_runtime_info* g_pSM_RouterVehiclesRuntimeInfo;
 extern shared_mem_router_vehicles_runtime_info g_SM_RouterVehiclesRuntimeInfo;
 
-extern shared_mem_radio_stats* g_pSM_RadioStats;
+extern shared_mem_radio_stats_versioned* g_pSM_RadioStats;
 extern shared_mem_radio_stats g_SM_RadioStats;
+extern shared_mem_sections_reader g_SMReaderRadioStats;
 
 extern shared_mem_radio_stats_rx_hist* g_pSM_HistoryRxStats;
 extern shared_mem_radio_stats_rx_hist g_SM_HistoryRxStats;
@@ -48,8 +49,9 @@ extern shared_mem_video_frames_stats g_SM_VideoFramesStatsOutput;
 //extern shared_mem_video_frames_stats g_VideoInfoStatsFromVehicleCameraOut;
 //extern shared_mem_video_frames_stats g_VideoInfoStatsFromVehicleRadioOut;
 
-extern shared_mem_video_stream_stats_rx_processors* g_pSM_VideoDecodeStats;
+extern shared_mem_video_stream_stats_rx_processors_versioned* g_pSM_VideoDecodeStats;
 extern shared_mem_video_stream_stats_rx_processors g_SM_VideoDecodeStats;
+extern shared_mem_sections_reader g_SMReaderVideoDecodeStats;
 
 extern shared_mem_radio_rx_queue_info* g_pSM_RadioRxQueueInfo;
 extern shared_mem_radio_rx_queue_info g_SM_RadioRxQueueInfo;
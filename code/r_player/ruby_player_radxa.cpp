@@ -61,6 +61,7 @@
 #include "../base/hardware_procs.h"
 #include "../base/hdmi.h"
 #include "../base/parser_h264.h"
+#include "../base/video_frame_ring.h"
 #include "../renderer/drm_core.h"
 #include <ctype.h>
 #include <sys/ioctl.h>
@@ -102,7 +103,6 @@ u8 g_uPipeBuffer[PIPE_BUFFER_SIZE];
 int g_iPipeBufferWritePos = 0;
 int g_iPipeBufferReadPos = 0;
 
-sem_t* s_pSemaphoreSMData = NULL;
 
 void _signal_play_file_will_finish()
 {
@@ -565,29 +565,14 @@ void _do_stream_mode_pipe()
 
 
 
+// Frames are read from the router SM frames ring and handed to the decoder straight from the shared memory
 void _do_stream_mode_sm()
 {
    ControllerSettings* pCS = get_ControllerSettings();
 
-   s_pSemaphoreSMData = sem_open(SEMAPHORE_SM_VIDEO_DATA_AVAILABLE, O_RDONLY);
-   if ( (NULL == s_pSemaphoreSMData) || (SEM_FAILED == s_pSemaphoreSMData) )
-   {
-      log_error_and_alarm("Failed to create SM data read semaphore: %s", SEMAPHORE_SM_VIDEO_DATA_AVAILABLE);
-      return;
-   }
-   int iSemVal = 0;
-   if ( 0 == sem_getvalue(s_pSemaphoreSMData, &iSemVal) )
-      log_line("SM data semaphore initial value: %d", iSemVal);
-   else
-      log_softerror_and_alarm("Failed to get SM data sem value.");
-
-
    if ( hdmi_enum_modes() < 0 )
    {
       log_error_and_alarm("Failed to enumerate HDMI modes. Exit SM player.");
-      if ( NULL != s_pSemaphoreSMData )
-           sem_close(s_pSemaphoreSMData);
-      s_pSemaphoreSMData = NULL;
       return;
    }
 
@@ -600,154 +585,71 @@ void _do_stream_mode_sm()
 
    if ( mpp_init(g_bUseH265Decoder, pCS->iVideoMPPBuffersSize, g_uCPUAffinityMask, g_iRawPriority) != 0 )
    {
-      if ( NULL != s_pSemaphoreSMData )
-           sem_close(s_pSemaphoreSMData);
-      s_pSemaphoreSMData = NULL;
       ruby_drm_core_uninit();
       return;
    }
 
-   int fdSMem = -1;
-   unsigned char* pSMem = NULL;
-   uint32_t uSharedMemReadPos = 0;
-
-   fdSMem = shm_open(SM_STREAMER_NAME, O_RDONLY, S_IRUSR | S_IWUSR);
-
-   if( fdSMem < 0 )
-   {
-      log_softerror_and_alarm("Failed to open shared memory for read: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-      
-      if ( NULL != s_pSemaphoreSMData )
-           sem_close(s_pSemaphoreSMData);
-      s_pSemaphoreSMData = NULL;
-      mpp_uninit();
-      ruby_drm_core_uninit();
-      return;
-   }
-   
-   pSMem = (unsigned char*) mmap(NULL, SM_STREAMER_SIZE, PROT_READ, MAP_SHARED, fdSMem, 0);
-   if ( (pSMem == MAP_FAILED) || (pSMem == NULL) )
+   type_video_frame_ring videoFrameRing;
+   if ( ! video_frame_ring_open(&videoFrameRing, VIDEO_FRAME_RING_NAME) )
    {
-      log_softerror_and_alarm("Failed to map shared memory: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-      if ( NULL != pSMem )
-      {
-         munmap(pSMem, SM_STREAMER_SIZE);
-         log_line("Unmapped shared mem: %s", SM_STREAMER_NAME);
-      }
-      if ( NULL != s_pSemaphoreSMData )
-           sem_close(s_pSemaphoreSMData);
-      s_pSemaphoreSMData = NULL;
+      log_softerror_and_alarm("Failed to open SM video frames ring for read: %s", VIDEO_FRAME_RING_NAME);
       mpp_uninit();
       ruby_drm_core_uninit();
       return;
    }
-   close(fdSMem); 
-   log_line("Mapped shared mem: %s", SM_STREAMER_NAME);
 
    mpp_enable_vsync(pCS->iHDMIVSync?true:false);
    mpp_start_decoding_thread();
 
    u32 uTimeLastCheck = get_current_timestamp_ms();
-   int nRead = 1;
    int iCount =0;
    int iTotalRead = 0;
+   u32 uTotalSkippedFrames = 0;
+   u32 uMaxHandoffMicros = 0;
    bool bAnyInputEver = false;
    u32 uTimeStartReceivingStream = 0;
+   type_video_frame_ring_frame frame;
   
    while ( !g_bQuit )
    {
-      u32* pTmp1 = (u32*)pSMem;
-      u32* pTmp2 = (u32*)(&(pSMem[sizeof(u32)]));
-      u32 uWritePos1 = 0;
-      u32 uWritePos2 = 0;
-      u32 uBytesToRead = 0;
-
-      while ((uBytesToRead == 0) && (!g_bQuit))
-      {
-         g_pSMProcessStats->lastActiveTime = get_current_timestamp_ms();
-         uWritePos1 = *pTmp1;
-         uWritePos2 = *pTmp2;
-         if ( (uSharedMemReadPos == uWritePos1) || (uWritePos1 != uWritePos2) )
-         {
-            struct timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_nsec += 1000LL*(long long)10000; // 10 milisec
-            int iResSem = sem_timedwait(s_pSemaphoreSMData, &ts);
-            if ( 0 != iResSem )
-            {
-               if ( errno != ETIMEDOUT )
-                  log_softerror_and_alarm("Failed to timewait on semaphore. Error: %d, %s", errno, strerror(errno));
-               continue;
-            }
-            is_semaphore_signaled_clear_logok(s_pSemaphoreSMData, SEMAPHORE_SM_VIDEO_DATA_AVAILABLE, 0);
-
-            uWritePos1 = *pTmp1;
-            uWritePos2 = *pTmp2;
-            if ( (uSharedMemReadPos == uWritePos1) || (uWritePos1 != uWritePos2) )
-               continue;
-         }
-         if ( uWritePos1 > uSharedMemReadPos )
-         {
-            uBytesToRead = uWritePos1 - uSharedMemReadPos;
-            if ( uBytesToRead > PIPE_BUFFER_SIZE )
-               uBytesToRead = PIPE_BUFFER_SIZE;
-            memcpy(g_uPipeBuffer, &pSMem[uSharedMemReadPos], uBytesToRead);
-            uSharedMemReadPos += uBytesToRead;
-            if ( uSharedMemReadPos >= SM_STREAMER_SIZE )
-               uSharedMemReadPos = 2*sizeof(u32);
-         }
-         else
-         {
-            uBytesToRead = (SM_STREAMER_SIZE - uSharedMemReadPos);
-            if ( uBytesToRead > PIPE_BUFFER_SIZE )
-               uBytesToRead = PIPE_BUFFER_SIZE;
-            memcpy(g_uPipeBuffer, &pSMem[uSharedMemReadPos], uBytesToRead);
-            uSharedMemReadPos += uBytesToRead;
-            if ( uSharedMemReadPos >= SM_STREAMER_SIZE )
-               uSharedMemReadPos = 2*sizeof(u32);
-            if ( (PIPE_BUFFER_SIZE- uBytesToRead > 0) && (uWritePos1 > 0) )
-            {
-               unsigned char* pTmpB = &(g_uPipeBuffer[0]) + uBytesToRead;
-
-               u32 uBytesToRead2 = uWritePos1 - 2*sizeof(u32);
-               if ( uBytesToRead2 + uBytesToRead > PIPE_BUFFER_SIZE )
-                  uBytesToRead2 = PIPE_BUFFER_SIZE - uBytesToRead;
-               memcpy(pTmpB, &pSMem[uSharedMemReadPos], uBytesToRead2);
-               uSharedMemReadPos += uBytesToRead2;
-               uBytesToRead += uBytesToRead2;
-            }
-         }
-      } 
-      if ( g_bQuit )
-         break;
+      g_pSMProcessStats->lastActiveTime = get_current_timestamp_ms();
+      if ( ! video_frame_ring_acquire(&videoFrameRing, 10000, &frame) )
+         continue;
 
       g_pSMProcessStats->lastIPCIncomingTime = get_current_timestamp_ms();
 
       if ( ! bAnyInputEver )
       {
-         log_line("Start receiving video stream data through pipe (%d bytes)", nRead);
+         log_line("Start receiving video stream data through SM frames ring (%u bytes)", frame.uLength);
          bAnyInputEver = true;
          uTimeStartReceivingStream = get_current_timestamp_ms();
       }
 
-      nRead = uBytesToRead;
+      u32 uHandoffMicros = (u32)(video_frame_ring_get_time_micros() - frame.uTimePublishedMicros);
+      if ( uHandoffMicros > uMaxHandoffMicros )
+         uMaxHandoffMicros = uHandoffMicros;
+      uTotalSkippedFrames += frame.uSkippedBefore;
       iCount++;
-      iTotalRead += nRead;
+      iTotalRead += (int)frame.uLength;
       if ( (iCount % 10) == 0 )
       {
          u32 uTime = get_current_timestamp_ms();
          if ( uTime >= uTimeLastCheck + 4000 )
          {
             uTimeLastCheck = uTime;
-            log_line("Video player alive, reading %d kbits/sec", iTotalRead*8/4/1000);
+            log_line("Video player alive, reading %d kbits/sec, max SM handoff: %u us, skipped frames: %u", iTotalRead*8/4/1000, uMaxHandoffMicros, uTotalSkippedFrames);
             iTotalRead = 0;
+            uMaxHandoffMicros = 0;
+            uTotalSkippedFrames = 0;
          }
       }
 
-      int iRes = mpp_feed_data_to_decoder(g_uPipeBuffer, nRead);
+      // The frame data is referenced (not overwritten by the router) until it's released
+      int iRes = mpp_feed_data_to_decoder(frame.pData, (int)frame.uLength);
+      video_frame_ring_release(&videoFrameRing, &frame);
       if ( iRes > 5 )
       {
-         log_line("Stalled consuming %d bytes, stall for %d ms. Signaling alarm", nRead, iRes);
+         log_line("Stalled consuming %u bytes, stall for %d ms. Signaling alarm", frame.uLength, iRes);
          if ( get_current_timestamp_ms() > uTimeStartReceivingStream + 5000 )
          {
             sem_t* ps = sem_open(SEMAPHORE_VIDEO_STREAMER_OVERLOAD, O_CREAT, S_IWUSR | S_IRUSR, 0);
@@ -768,14 +670,8 @@ void _do_stream_mode_sm()
    mpp_mark_end_of_stream();
    mpp_uninit();
 
-   if ( NULL != pSMem )
-   {
-      munmap(pSMem, SM_STREAMER_SIZE);
-      log_line("Unmapped shared mem: %s", SM_STREAMER_NAME);
-   }
-   if ( NULL != s_pSemaphoreSMData )
-        sem_close(s_pSemaphoreSMData);
-   s_pSemaphoreSMData = NULL;
+   video_frame_ring_close(&videoFrameRing);
+   log_line("Closed SM video frames ring: %s", VIDEO_FRAME_RING_NAME);
    ruby_drm_core_uninit();
 }
 
@@ -618,7 +618,7 @@ bool _send_packet_to_wifi_radio_interface(int iLocalRadioLinkId, int iRadioInter
    int be = 0;
    if ( (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_DATA) || (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_ALL) )
    if ( hpp() )
-      be = 1;
+      be = (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_AEAD)?ENC_MODE_AEAD:ENC_MODE_XOR;
 
    int iDataRateTx = _compute_packet_uplink_datarate_radioflags_tx_power(iVehicleRadioLinkId, iRadioInterfaceIndex, pPacketData);
    int totalLength = radio_build_new_raw_ieee_packet(iLocalRadioLinkId, s_RadioRawPacket, pPacketData, nPacketLength, RADIO_PORT_ROUTER_UPLINK, be);
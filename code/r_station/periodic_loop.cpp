@@ -76,7 +76,7 @@ void _synchronize_shared_mems()
    if ( g_TimeNow >= s_TimeLastVideoStatsUpdate + 200 )
    {
       s_TimeLastVideoStatsUpdate = g_TimeNow;
-      memcpy((u8*)g_pSM_VideoDecodeStats, (u8*)(&g_SM_VideoDecodeStats), sizeof(shared_mem_video_stream_stats_rx_processors));
+      shared_mem_video_stream_stats_rx_processors_publish(g_pSM_VideoDecodeStats, &g_SM_VideoDecodeStats);
    
       if ( NULL != g_pSM_RouterVehiclesRuntimeInfo )
       {
@@ -623,7 +623,7 @@ void router_periodic_loop()
       {
          s_uTimeLastRadioStatsSharedMemSync = g_TimeNow;
          if ( NULL != g_pSM_RadioStats )
-            memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+            shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
       }
 
       for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
@@ -728,7 +728,7 @@ void router_periodic_loop()
    if ( g_TimeNow >= s_uTimeLastVideoStatsUpdate + 50 )
    {
       s_uTimeLastVideoStatsUpdate = g_TimeNow;
-      memcpy(g_pSM_VideoDecodeStats, &g_SM_VideoDecodeStats, sizeof(shared_mem_video_stream_stats_rx_processors));
+      shared_mem_video_stream_stats_rx_processors_publish(g_pSM_VideoDecodeStats, &g_SM_VideoDecodeStats);
    }
 
    if ( g_TimeNow >= g_SM_RadioRxQueueInfo.uLastMeasureTime + g_SM_RadioRxQueueInfo.uMeasureIntervalMs )
@@ -148,7 +148,7 @@ bool _switch_to_vehicle_radio_link(int iVehicleRadioLinkId)
    // Update the radio state to reflect the new assigned radio links to local radio interfaces
 
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    return true;
 }
 
@@ -435,7 +435,7 @@ void _process_local_notification_model_changed(t_packet_header* pPH, u8 uChangeT
 
       // Update the radio state to reflect the new radio links
       if ( NULL != g_pSM_RadioStats )
-         memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+         shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    
       discardRetransmissionsInfoAndBuffersOnLengthyOp();
       return;
@@ -1085,7 +1085,7 @@ void process_local_control_packet(u8* pPacketBuffer)
       }
 
       if ( NULL != g_pSM_RadioStats )
-         memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+         shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
 
       if ( g_pCurrentModel->hasCamera() )
          rx_video_output_on_controller_settings_changed();
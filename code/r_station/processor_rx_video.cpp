@@ -63,6 +63,7 @@
 #include "../radio/radiopackets2.h"
 #include "../radio/radio_rx.h"
 #include "../radio/radiopacketsqueue.h"
+#include "../radio/fec_worker.h"
 
 #include "shared_vars.h"
 #include "shared_vars_state.h"
@@ -104,6 +105,24 @@ ProcessorRxVideo* ProcessorRxVideo::getVideoProcessorForVehicleId(u32 uVehicleId
    return NULL;
 }
 
+void ProcessorRxVideo::checkAndOutputRecoveredBlocks()
+{
+   if ( 0 == fec_worker_process_completed() )
+      return;
+
+   for( int i=0; i<MAX_VIDEO_PROCESSORS; i++ )
+   {
+      ProcessorRxVideo* pProcessor = g_pVideoProcessorRxList[i];
+      if ( (NULL == pProcessor) || pProcessor->m_bPaused || (NULL == pProcessor->m_pVideoRxBuffer) )
+         continue;
+      type_global_state_vehicle_runtime_info* pRuntimeInfo = getVehicleRuntimeInfo(pProcessor->m_uVehicleId);
+      Model* pModel = findModelWithId(pProcessor->m_uVehicleId, 172);
+      if ( (NULL == pRuntimeInfo) || (NULL == pModel) )
+         continue;
+      pProcessor->_checkAndOutputAvailablePackets(pRuntimeInfo, pModel);
+   }
+}
+
 ProcessorRxVideo::ProcessorRxVideo(u32 uVehicleId, u8 uVideoStreamIndex)
 :m_bInitialized(false)
 {
@@ -117,6 +136,7 @@ ProcessorRxVideo::ProcessorRxVideo(u32 uVehicleId, u8 uVideoStreamIndex)
    m_uLastTimeReceivedRetransmission = 0;
    m_uLastTimeCheckedForMissingPackets = 0;
    m_uRequestRetransmissionUniqueId = 0;
+   video_nack_init(&m_NackState);
    m_TimeLastHistoryStatsUpdate = 0;
    m_TimeLastRetransmissionsStatsUpdate = 0;
 
@@ -229,6 +249,7 @@ void ProcessorRxVideo::resetReceiveState()
    m_iMaxRecvPacketTopBlockWhenRequested = -1;
 
    m_uRequestRetransmissionUniqueId = 0;
+   video_nack_reset_pending(&m_NackState);
    m_uLastVideoBlockIndexResolutionChange = 0;
    m_uLastVideoBlockPacketIndexResolutionChange = 0;
    memset(&m_NewestReceivedVideoPacketInfo, 0, sizeof(t_packet_header_video_segment));
@@ -476,6 +497,9 @@ void ProcessorRxVideo::handleReceivedVideoRetrPacket(int interfaceNb, u8* pBuffe
 
    m_uLastTimeReceivedRetransmission = g_TimeNow;
    pCtrlRTInfo->uCountAckRetransmissions[g_SMControllerRTInfo.iCurrentIndex]++;
+   if ( pPHVS->uStreamInfoFlags == VIDEO_STREAM_INFO_FLAG_RETRANSMISSION_ID )
+      video_nack_on_response(&m_NackState, pPHVS->uStreamInfo, g_TimeNow);
+
    if ( pPHVS->uStreamInfoFlags == VIDEO_STREAM_INFO_FLAG_RETRANSMISSION_ID )
    if ( pPHVS->uStreamInfo == m_uRequestRetransmissionUniqueId )
    {
@@ -561,7 +585,7 @@ void ProcessorRxVideo::handleReceivedVideoRetrPacket(int interfaceNb, u8* pBuffe
             pPHVS->uStreamInfo);
    }
 
-   if ( ! m_pVideoRxBuffer->checkAddVideoPacket(pBuffer, iBufferLength) )
+   if ( ! m_pVideoRxBuffer->checkAddVideoPacket(pBuffer, iBufferLength, radio_rx_get_last_packet_rx_time_micros()) )
       return;
 
    _checkAndOutputAvailablePackets(pRuntimeInfo, pModel);
@@ -647,7 +671,7 @@ void ProcessorRxVideo::handleReceivedVideoPacket(int interfaceNb, u8* pBuffer, i
    #endif
 
 
-   if ( ! m_pVideoRxBuffer->checkAddVideoPacket(pBuffer, iBufferLength) )
+   if ( ! m_pVideoRxBuffer->checkAddVideoPacket(pBuffer, iBufferLength, radio_rx_get_last_packet_rx_time_micros()) )
    {
       if ( bIsNewest )
          memcpy(&m_CopyNewestReceivedVideoRxBlockInfo, m_pVideoRxBuffer->getTopBlockInBuffer(), sizeof(type_rx_video_block_info));
@@ -698,7 +722,7 @@ void ProcessorRxVideo::_checkAndOutputAvailablePackets(type_global_state_vehicle
       pVideoPacket = m_pVideoRxBuffer->getBottomBlockAndPacketInBuffer(&pVideoBlock);
       
       // Reached an empty packet?
-      if ( (0 == pVideoBlock->uReceivedTime) || pVideoPacket->bEmpty )
+      if ( (0 == pVideoBlock->uReceivedTime) || (NULL == pVideoPacket) )
             break;
 
       // Output and advance to next video packet, even if empty
@@ -718,7 +742,7 @@ void ProcessorRxVideo::processAndOutputVideoPacket(type_rx_video_block_info* pVi
 
    if ( g_pControllerSettings->iEnableDebugStats ||
         ((NULL != g_pCurrentModel) && (g_pCurrentModel->osd_params.osd_flags2[g_pCurrentModel->osd_params.iCurrentOSDScreen] & OSD_FLAG2_SHOW_VIDEO_FRAMES_STATS)) )
-      _updateDebugStatsOnVideoPacket(pVideoPacket);
+      _updateDebugStatsOnVideoPacket(pVideoBlock, pVideoPacket);
 
    memcpy(&m_LastOutputedVideoPacketInfo, pPHVS, sizeof(t_packet_header_video_segment));
    memcpy(&m_CopyLastOutputedVideoRxBlockInfo, pVideoBlock, sizeof(type_rx_video_block_info));
@@ -789,7 +813,7 @@ void ProcessorRxVideo::processAndOutputVideoPacket(type_rx_video_block_info* pVi
       m_bWasParsingStream = false;
    }
 
-   rx_video_output_video_data(m_uVehicleId, pVideoPacket->pPHVS, iVideoWidth, iVideoHeight, pVideoRawStreamData, pPHVSImp->uVideoDataLength, pVideoPacket->pPH->total_length, bWaitFullFrame);
+   rx_video_output_video_data(m_uVehicleId, pVideoPacket->pPHVS, iVideoWidth, iVideoHeight, pVideoRawStreamData, pPHVSImp->uVideoDataLength, pVideoPacket->pPH->total_length, bWaitFullFrame, pVideoPacket->uTraceRxMicros);
 
    // Update controller stats
 
@@ -805,7 +829,7 @@ void ProcessorRxVideo::processAndOutputVideoPacket(type_rx_video_block_info* pVi
    }
 
    static u32 s_uLastOutputedVideoBlockIdReconstructed = 0;
-   if ( pVideoPacket->bReconstructed )
+   if ( pVideoBlock->uReconstructedMask & VIDEO_RX_PACKET_BIT(pPHVS->uCurrentBlockPacketIndex) )
    if ( s_uLastOutputedVideoBlockIdReconstructed != pVideoBlock->uVideoBlockIndex )
    {
       s_uLastOutputedVideoBlockIdReconstructed = pVideoBlock->uVideoBlockIndex;
@@ -904,7 +928,7 @@ void ProcessorRxVideo::updateControllerRTInfoAndVideoDecodingStats(u8* pRadioPac
    }
 }
 
-void ProcessorRxVideo::_updateDebugStatsOnVideoPacket(type_rx_video_packet_info* pVideoPacket)
+void ProcessorRxVideo::_updateDebugStatsOnVideoPacket(type_rx_video_block_info* pVideoBlock, type_rx_video_packet_info* pVideoPacket)
 {
    u8* pRadioPacket = pVideoPacket->pRawData;
    t_packet_header* pPH = (t_packet_header*)pRadioPacket;
@@ -941,7 +965,7 @@ void ProcessorRxVideo::_updateDebugStatsOnVideoPacket(type_rx_video_packet_info*
       return;
 
 
-   if ( pVideoPacket->bReconstructed )
+   if ( pVideoBlock->uReconstructedMask & VIDEO_RX_PACKET_BIT(pPHVS->uCurrentBlockPacketIndex) )
    {
       u8 uPckts = (g_SMControllerDebugVideoRTInfo.uOutputFramePackets[g_SMControllerDebugVideoRTInfo.iCurrentFrameBufferIndex] >> 16) & 0xFF;
       uPckts++;
@@ -1146,7 +1170,10 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
    if ( g_TimeNow >= m_uLastTimeRequestedRetransmission + m_iMilisecondsMaxRetransmissionWindow )
       m_uTimeIntervalMsForRequestingRetransmissions = DEFAULT_RETRANSMISSION_MIN_REQUEST_INTERVAL_MS;
 
-   // Request all missing packets except current block which is requested only on some cases
+   // Request all missing packets except current block which is requested only on some cases.
+   // Packets already requested are requested again only after the request timeout (from the measured
+   // retransmissions round trip time). Blocks whose retransmissions would arrive after the block is
+   // discarded (past the max retransmission window) are not requested anymore.
 
    //#define PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS 20
    // params after header:
@@ -1156,8 +1183,10 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
    //         bit 0: contains re-requested packets
    //         bit 1: contains request for start of video frame packets at the end
    //         bit 2: contains request for end of video frame packets at the end
-   //   u8: number of individual video packets requested
+   //         bit 3: requested packets are coalesced per video block (VIDEO_NACK_FLAG_COALESCED)
+   //   u8: number of individual video packets requested (number of video blocks if coalesced)
    //   (u32+u8)*n = each (video block index + video packet index) requested
+   //      or, if coalesced: u32 first video block index + (u8+u32)*n = each (video block index delta + packets mask) requested
    //   (u16+u8) frame id and frame packets from start to get
    //   (u16+u8) frame id and frame packets to EOF to get
 
@@ -1175,8 +1204,12 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
       log_softerror_and_alarm("[ProcessorRxVideo] Tried to request retransmissions before having received a video packet.");
    }
 
-   u8 packet[MAX_PACKET_TOTAL_SIZE];
-   u8* pDataInfo = packet + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
+   // Older vehicles only know the individual packets requests
+   bool bCoalesceRequests = (get_sw_version_build(pModel) >= VIDEO_NACK_COALESCED_MIN_SW_BUILD);
+   u32 uRequestedBlocksIndexes[MAX_RXTX_BLOCKS_BUFFER];
+   u32 uRequestedBlocksMasks[MAX_RXTX_BLOCKS_BUFFER];
+   int iCountRequestedBlocks = 0;
+
    u32 uTopVideoBlockIdInBuffer = 0;
    int iTopVideoBlockPacketIndexInBuffer = -1;
    //u32 uTopVideoBlockLastRecvTime = 0;
@@ -1202,50 +1235,39 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
          strcat(szBufferBlocks, szTmp);
       }
 
+      if ( video_nack_is_past_deadline(&m_NackState, pVideoBlock->uVideoBlockIndex, pVideoBlock->uReceivedTime, (u32)m_iMilisecondsMaxRetransmissionWindow, g_TimeNow) )
+         continue;
+
+      u32 uRequestMask = 0;
       if ( 0 == (pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) )
       {
-         memcpy(pDataInfo, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
-         pDataInfo += sizeof(u32);
-         u8 uPacketIndex = 0xFF;
-         memcpy(pDataInfo, &uPacketIndex, sizeof(u8));
-         pDataInfo += sizeof(u8);
+         // Full block requests are tracked on the first packet of the block
+         if ( 0 == _getBlockPacketsToRequest(pVideoBlock, VIDEO_RX_PACKET_BIT(0), 1, 1, &bContainsReRequestedPackets) )
+            continue;
+         uRequestMask = VIDEO_NACK_MASK_FULL_BLOCK;
          iCountPacketsRequested++;
          //log_line("DBG will request full block [%u]", pVideoBlock->uVideoBlockIndex);
-         continue;
       }
-
-      int iCountToRequestFromBlock = pVideoBlock->iBlockDataPackets - pVideoBlock->iRecvDataPackets - pVideoBlock->iRecvECPackets;
-      if ( pVideoBlock->iBlockDataPackets == 0 )
-         iCountToRequestFromBlock = 1;
-      if ( iCountToRequestFromBlock <= 0 )
-         continue;
-
-      for( int k=0; k<pVideoBlock->iBlockDataPackets+1; k++ )
+      else
       {
-         if ( NULL == pVideoBlock->packets[k].pRawData )
-            continue;
-         if ( ! pVideoBlock->packets[k].bEmpty )
+         int iCountToRequestFromBlock = pVideoBlock->iBlockDataPackets - pVideoBlock->iRecvDataPackets - pVideoBlock->iRecvECPackets;
+         if ( pVideoBlock->iBlockDataPackets == 0 )
+            iCountToRequestFromBlock = 1;
+         if ( iCountToRequestFromBlock <= 0 )
             continue;
 
-         if ( 0 != pVideoBlock->packets[k].uRequestedTime )
-            bContainsReRequestedPackets = true;
-         pVideoBlock->packets[k].uRequestedTime = g_TimeNow;
-         uLastRequestedVideoBlockIndex = pVideoBlock->uVideoBlockIndex;
-         iLastRequestedVideoBlockPacketIndex = k;
-         memcpy(pDataInfo, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
-         pDataInfo += sizeof(u32);
-         u8 uPacketIndex = k;
-         memcpy(pDataInfo, &uPacketIndex, sizeof(u8));
-         pDataInfo += sizeof(u8);
-
-         iCountToRequestFromBlock--;
-         iCountPacketsRequested++;
-         if ( iCountToRequestFromBlock == 0 )
-            break;
-         if ( iCountPacketsRequested >= DEFAULT_VIDEO_RETRANS_MAX_PCOUNT )
-           break;
+         u32 uMissingMask = pVideoBlock->uAllocatedMask & (~pVideoBlock->uReceivedMask) & VIDEO_RX_PACKETS_MASK(pVideoBlock->iBlockDataPackets+1);
+         uRequestMask = _getBlockPacketsToRequest(pVideoBlock, uMissingMask, iCountToRequestFromBlock, DEFAULT_VIDEO_RETRANS_MAX_PCOUNT - iCountPacketsRequested, &bContainsReRequestedPackets);
+         if ( 0 == uRequestMask )
+            continue;
+         iCountPacketsRequested += __builtin_popcount(uRequestMask);
+         iLastRequestedVideoBlockPacketIndex = 31 - __builtin_clz(uRequestMask);
       }
-   
+      uLastRequestedVideoBlockIndex = pVideoBlock->uVideoBlockIndex;
+      uRequestedBlocksIndexes[iCountRequestedBlocks] = pVideoBlock->uVideoBlockIndex;
+      uRequestedBlocksMasks[iCountRequestedBlocks] = uRequestMask;
+      iCountRequestedBlocks++;
+
       if ( iCountPacketsRequested >= DEFAULT_VIDEO_RETRANS_MAX_PCOUNT )
         break;
    }
@@ -1274,35 +1296,19 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
       sprintf(szTmp, "t[f%d %u %d/%d pckts of %d/%d, eof %d]", pVideoBlock->uH264FrameIndex, pVideoBlock->uVideoBlockIndex, pVideoBlock->iRecvDataPackets, pVideoBlock->iRecvECPackets, pVideoBlock->iBlockDataPackets, pVideoBlock->iBlockECPackets, pVideoBlock->iLastRecordedEOF);
       strcat(szBufferBlocks, szTmp);
 
-      bool bRequestData = false;
-
       // Not enough EC packets to reconstruct
-      if ( (pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) < pVideoBlock->iBlockDataPackets )
+      if ( ((pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) < pVideoBlock->iBlockDataPackets) && (iCountPacketsRequested < DEFAULT_VIDEO_RETRANS_MAX_PCOUNT) )
       {
-         for( int k=0; k<pVideoBlock->iBlockDataPackets; k++ )
+         u32 uMissingMask = pVideoBlock->uAllocatedMask & (~pVideoBlock->uReceivedMask) & VIDEO_RX_PACKETS_MASK(pVideoBlock->iBlockDataPackets);
+         u32 uRequestMask = _getBlockPacketsToRequest(pVideoBlock, uMissingMask, iCountToRequestFromBlock, DEFAULT_VIDEO_RETRANS_MAX_PCOUNT - iCountPacketsRequested, &bContainsReRequestedPackets);
+         if ( 0 != uRequestMask )
          {
-            if ( NULL == pVideoBlock->packets[k].pRawData )
-               continue;
-            if ( ! pVideoBlock->packets[k].bEmpty )
-               continue;
-
-            if ( 0 != pVideoBlock->packets[k].uRequestedTime )
-               bContainsReRequestedPackets = true;
-            pVideoBlock->packets[k].uRequestedTime = g_TimeNow;
+            iCountPacketsRequested += __builtin_popcount(uRequestMask);
             uLastRequestedVideoBlockIndex = pVideoBlock->uVideoBlockIndex;
-            iLastRequestedVideoBlockPacketIndex = k;
-            memcpy(pDataInfo, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
-            pDataInfo += sizeof(u32);
-            u8 uPacketIndex = k;
-            memcpy(pDataInfo, &uPacketIndex, sizeof(u8));
-            pDataInfo += sizeof(u8);
-
-            iCountToRequestFromBlock--;
-            iCountPacketsRequested++;
-            if ( iCountToRequestFromBlock == 0 )
-               break;
-            if ( iCountPacketsRequested >= DEFAULT_VIDEO_RETRANS_MAX_PCOUNT )
-              break;
+            iLastRequestedVideoBlockPacketIndex = 31 - __builtin_clz(uRequestMask);
+            uRequestedBlocksIndexes[iCountRequestedBlocks] = pVideoBlock->uVideoBlockIndex;
+            uRequestedBlocksMasks[iCountRequestedBlocks] = uRequestMask;
+            iCountRequestedBlocks++;
          }
          m_uLastTopBlockIdRequested = pVideoBlock->uVideoBlockIndex;
          m_iMaxRecvPacketTopBlockWhenRequested = pVideoBlock->iMaxReceivedDataOrECPacketIndex;
@@ -1315,6 +1321,9 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
       }
    }
 
+   if ( iCountPacketsRequested == 0 )
+      return 0;
+
    // Do we have full missing blocks at the end of frame?
    pVideoBlock = m_pVideoRxBuffer->getBlockInBufferFromBottom(iCountBlocks-1);
    bool bMissingEnd = false;
@@ -1323,30 +1332,27 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
       //log_line("DBG we have missing full blocks at end of f%d. Blocks in rx-buffer: %d, last block: [%u], frame total packets: %d, last received block end frame packet: %d",
       //   pVideoBlock->uH264FrameIndex, iCountBlocks, pVideoBlock->uVideoBlockIndex, pVideoBlock->iTotalFramePackets, pVideoBlock->iFramePacketEnd);
       bMissingEnd = true;
-      memcpy(pDataInfo, &(pVideoBlock->uH264FrameIndex), sizeof(u16));
-      pDataInfo += sizeof(u16);
-      *pDataInfo = pVideoBlock->iFramePacketEnd + 1;
-      pDataInfo++;
    }
-   if ( iCountPacketsRequested == 0 )
-      return 0;
 
-   u8 uFlags = 0;
-   u8 uCount = iCountPacketsRequested;
    m_uRequestRetransmissionUniqueId++;
 
+   u8 uFlags = 0;
    if ( bContainsReRequestedPackets )
       uFlags |= 0x01;
    if ( bMissingEnd )
       uFlags |= 0x01<<2;
-   memcpy(packet + sizeof(t_packet_header), (u8*)&m_uRequestRetransmissionUniqueId, sizeof(u32));
-   memcpy(packet + sizeof(t_packet_header) + sizeof(u32), (u8*)&m_uVideoStreamIndex, sizeof(u8));
-   memcpy(packet + sizeof(t_packet_header) + sizeof(u32) + sizeof(u8), (u8*)&uFlags, sizeof(u8));
-   memcpy(packet + sizeof(t_packet_header) + sizeof(u32) + 2*sizeof(u8), (u8*)&uCount, sizeof(u8));
-   PH.total_length = sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-   PH.total_length += iCountPacketsRequested*(sizeof(u32) + sizeof(u8)); 
+
+   u8 packet[MAX_PACKET_TOTAL_SIZE];
+   u8* pDataInfo = packet + sizeof(t_packet_header);
+   pDataInfo += video_nack_build_request(pDataInfo, m_uRequestRetransmissionUniqueId, m_uVideoStreamIndex, uFlags, uRequestedBlocksIndexes, uRequestedBlocksMasks, iCountRequestedBlocks, bCoalesceRequests?1:0);
    if ( bMissingEnd )
-      PH.total_length += sizeof(u16) + sizeof(u8);
+   {
+      memcpy(pDataInfo, &(pVideoBlock->uH264FrameIndex), sizeof(u16));
+      pDataInfo += sizeof(u16);
+      *pDataInfo = pVideoBlock->iFramePacketEnd + 1;
+      pDataInfo++;
+   }
+   PH.total_length = (u16)(pDataInfo - packet);
 
    memcpy(packet, (u8*)&PH, sizeof(t_packet_header));
 
@@ -1356,31 +1362,33 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
 
    u32 uLastRetransmissionRequestTime = m_uLastTimeRequestedRetransmission;
    m_uLastTimeRequestedRetransmission = g_TimeNow;
+   video_nack_on_request_sent(&m_NackState, m_uRequestRetransmissionUniqueId, g_TimeNow, iCountPacketsRequested, PH.total_length);
 
    controller_runtime_info_vehicle* pRTInfo = controller_rt_info_get_vehicle_info(&g_SMControllerRTInfo, m_uVehicleId);
    if ( NULL != pRTInfo )
    {
       pRTInfo->uCountReqRetransmissions[g_SMControllerRTInfo.iCurrentIndex]++;
-      if ( pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] + uCount > 255 )
+      if ( pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] + iCountPacketsRequested > 255 )
          pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] = 255;
       else
-         pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] += uCount;
+         pRTInfo->uCountReqRetrPackets[g_SMControllerRTInfo.iCurrentIndex] += iCountPacketsRequested;
    }
 
-   pDataInfo = packet + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-   u32 uFirstReqBlockIndex =0;
-   memcpy(&uFirstReqBlockIndex, pDataInfo, sizeof(u32));
+   u32 uFirstReqBlockIndex = uRequestedBlocksIndexes[0];
+   int iFirstReqBlockPacketIndex = (VIDEO_NACK_MASK_FULL_BLOCK == uRequestedBlocksMasks[0])?0xFF:__builtin_ctz(uRequestedBlocksMasks[0]);
    if ( 1 == iCountPacketsRequested )
-      log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for 1 packet ([%u/%d]) (%s%s), last retr req was %u ms ago, EOF was detected %u ms ago for frame %d",
-         m_uRequestRetransmissionUniqueId, uFirstReqBlockIndex, (int)pDataInfo[sizeof(u32)],
+      log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for 1 packet ([%u/%d]) (%s%s), last retr req was %u ms ago, EOF was detected %u ms ago for frame %d, retr rtt %u ms, timeout %u ms",
+         m_uRequestRetransmissionUniqueId, uFirstReqBlockIndex, iFirstReqBlockPacketIndex,
          bContainsReRequestedPackets?"has re-requested packets":"no re-requests",
-         bMissingEnd?", has missing frame end":"", g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number() );
+         bMissingEnd?", has missing frame end":"", g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number(),
+         video_nack_get_srtt_ms(&m_NackState), video_nack_get_rto_ms(&m_NackState));
    else
-      log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for %d packets ([%u/%d]...[%u/%d]) (%s%s), last retr req was %u ms ago, EOF was detected %u ms ago for frame %d",
-         m_uRequestRetransmissionUniqueId, iCountPacketsRequested,
-         uFirstReqBlockIndex, (int)pDataInfo[sizeof(u32)], uLastRequestedVideoBlockIndex, iLastRequestedVideoBlockPacketIndex,
+      log_line("[ProcessorRxVideo] * Requested retr id %u from vehicle for %d packets in %d blocks ([%u/%d]...[%u/%d]) (%s%s), last retr req was %u ms ago, EOF was detected %u ms ago for frame %d, retr rtt %u ms, timeout %u ms",
+         m_uRequestRetransmissionUniqueId, iCountPacketsRequested, iCountRequestedBlocks,
+         uFirstReqBlockIndex, iFirstReqBlockPacketIndex, uLastRequestedVideoBlockIndex, iLastRequestedVideoBlockPacketIndex,
          bContainsReRequestedPackets?"has re-requested packets":"no re-requests",
-         bMissingEnd?", has missing frame end":"", g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number());
+         bMissingEnd?", has missing frame end":"", g_TimeNow - uLastRetransmissionRequestTime, g_TimeNow - radio_rx_get_current_frame_end_time(), radio_rx_get_current_frame_number(),
+         video_nack_get_srtt_ms(&m_NackState), video_nack_get_rto_ms(&m_NackState));
    
    log_line("[ProcessorRxVideo] * Video blocks in buffer: %d (%s), top/max video block in buffer: [%u/pkt %d] / [%u/pkt %d], last recv video pkt [f%d %u/%u eof %d], received %u ms ago",
       iCountBlocks, szBufferBlocks, uTopVideoBlockIdInBuffer, iTopVideoBlockPacketIndexInBuffer, m_pVideoRxBuffer->getBufferTopVideoBlockIndex(), m_pVideoRxBuffer->getTopBufferMaxReceivedVideoBlockPacketIndex(),
@@ -1392,6 +1400,37 @@ int ProcessorRxVideo::checkAndRequestMissingPackets(bool bForceSyncNow)
    return iCountPacketsRequested;
 }
 
+u32 ProcessorRxVideo::_getBlockPacketsToRequest(type_rx_video_block_info* pVideoBlock, u32 uMissingMask, int iCountNeeded, int iMaxCount, bool* pbReRequested)
+{
+   // Packets still in flight count as needed packets, they are not requested again until their request times out
+   u32 uNeededMask = 0;
+   while ( (0 != uMissingMask) && (iCountNeeded > 0) )
+   {
+      uNeededMask |= uMissingMask & (~(uMissingMask - 1));
+      uMissingMask &= uMissingMask - 1;
+      iCountNeeded--;
+   }
+
+   // The block is discarded at the end of the retransmission window
+   u32 uDeadline = 0;
+   if ( 0 != pVideoBlock->uReceivedTime )
+      uDeadline = pVideoBlock->uReceivedTime + (u32)m_iMilisecondsMaxRetransmissionWindow;
+   u32 uToRequest = video_nack_get_packets_to_request(&m_NackState, uNeededMask, pVideoBlock->uRequestedMask, pVideoBlock->uPacketsRequestedTime, uDeadline, g_TimeNow);
+   u32 uRequestMask = 0;
+   while ( (0 != uToRequest) && (iMaxCount > 0) )
+   {
+      int k = __builtin_ctz(uToRequest);
+      uToRequest &= uToRequest - 1;
+      if ( pVideoBlock->uRequestedMask & VIDEO_RX_PACKET_BIT(k) )
+         *pbReRequested = true;
+      pVideoBlock->uRequestedMask |= VIDEO_RX_PACKET_BIT(k);
+      pVideoBlock->uPacketsRequestedTime[k] = g_TimeNow;
+      uRequestMask |= VIDEO_RX_PACKET_BIT(k);
+      iMaxCount--;
+   }
+   return uRequestMask;
+}
+
 void discardRetransmissionsInfoAndBuffersOnLengthyOp()
 {
    log_line("[ProcessorRxVideo] Discard all retransmissions info after a lengthy router operation.");
@@ -3,6 +3,7 @@
 #include "../base/models.h"
 #include "../base/shared_mem_controller_only.h"
 #include "../base/parser_h264.h"
+#include "../radio/video_nack.h"
 #include "video_rx_buffers.h"
 #include "shared_vars_state.h"
 
@@ -63,6 +64,8 @@ class ProcessorRxVideo
 
       static void oneTimeInit();
       static ProcessorRxVideo* getVideoProcessorForVehicleId(u32 uVehicleId, u32 uVideoStreamIndex);
+      // Collects the video blocks EC decoded by the FEC workers and outputs the video packets now available
+      static void checkAndOutputRecoveredBlocks();
       //static void log(const char* format, ...);
 
       bool init();
@@ -107,11 +110,13 @@ class ProcessorRxVideo
       
       void updateControllerRTInfoAndVideoDecodingStats(u8* pRadioPacket, int iPacketLength);
       
-      void _updateDebugStatsOnVideoPacket(type_rx_video_packet_info* pVideoPacket);
+      void _updateDebugStatsOnVideoPacket(type_rx_video_block_info* pVideoBlock, type_rx_video_packet_info* pVideoPacket);
       void _checkUpdateRetransmissionsState();
       void checkUpdateRetransmissionsState();
       // Returns how many retransmission packets where requested, if any
       int checkAndRequestMissingPackets(bool bForceSyncNow);
+      // Returns the first iCountNeeded missing packets of the block that are not in flight (at most iMaxCount), marks them as requested
+      u32 _getBlockPacketsToRequest(type_rx_video_block_info* pVideoBlock, u32 uMissingMask, int iCountNeeded, int iMaxCount, bool* pbReRequested);
       void checkAndDiscardBlocksTooOld();
 
       void _checkAndOutputAvailablePackets(type_global_state_vehicle_runtime_info* pRuntimeInfo, Model* pModel);
@@ -150,6 +155,7 @@ class ProcessorRxVideo
       u32 m_uRequestRetransmissionUniqueId;
       u32 m_uLastTimeRequestedRetransmission;
       u32 m_uLastTimeReceivedRetransmission;
+      type_video_nack_state m_NackState;
 
       u32 m_uLastTopBlockIdRequested;
       int m_iMaxRecvPacketTopBlockWhenRequested;
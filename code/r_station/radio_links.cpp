@@ -418,7 +418,7 @@ void radio_links_compute_auto_radio_interfaces_assignment(int iVehicleRadioLink)
       iCountAssignedVehicleRadioLinks = 1;
       g_SM_RadioStats.countLocalRadioLinks = 1;
       if ( NULL != g_pSM_RadioStats )
-         memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+         shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
       if ( 0 == iCountInterfacesAssigned )
          send_alarm_to_central(ALARM_ID_CONTROLLER_NO_INTERFACES_FOR_RADIO_LINK,iConnectFirstUsableRadioLinkId, 0);
       
@@ -585,7 +585,7 @@ void radio_links_compute_auto_radio_interfaces_assignment(int iVehicleRadioLink)
    log_line("Assigned %d controller local radio links to vehicle's radio links (vehicle has %d active radio links)", iCountAssignedVehicleRadioLinks, iCountVehicleActiveUsableRadioLinks);
    
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
 
    //---------------------------------------------------------------
    // Log errors
@@ -662,7 +662,7 @@ void radio_links_close_rxtx_radio_interfaces()
       g_SM_RadioStats.radio_interfaces[i].openedForWrite = 0;
    }
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    log_line("Closed all radio interfaces (rx/tx)."); 
 }
 
@@ -759,7 +759,7 @@ void radio_links_open_rxtx_radio_interfaces_for_search( u32 uSearchFreq )
    }
    
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    log_line("Opening RX radio interfaces for search complete. %d interfaces opened for RX:", iCountOpenRead);
    
    for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
@@ -925,7 +925,7 @@ void radio_links_open_rxtx_radio_interfaces()
    }
 
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    log_line("Opening RX/TX radio interfaces complete. %d interfaces opened for RX, %d interfaces opened for TX:", totalCountForRead, totalCountForWrite);
 
    if ( totalCountForRead == 0 )
@@ -1002,7 +1002,7 @@ void radio_links_open_rxtx_radio_interfaces()
    }
 
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    log_line("Finished opening RX/TX radio interfaces.");
 
    radio_links_set_monitor_mode();
@@ -1159,7 +1159,7 @@ bool radio_links_set_cards_frequencies_and_params(int iVehicleLinkId)
    }
 
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
 
    hardware_save_radio_info();
 
@@ -1287,7 +1287,7 @@ bool radio_links_set_cards_frequencies_for_search(u32 uSearchFreq, bool bSiKSear
    }
 
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    log_line("Links: Set all cards frequencies for search mode to %s. Completed.", str_format_frequency(uSearchFreq));
    return true;
 }
@@ -1327,7 +1327,7 @@ bool radio_links_apply_settings(Model* pModel, int iRadioLink, type_radio_links_
 
       hardware_save_radio_info();
       if ( NULL != g_pSM_RadioStats )
-         memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+         shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
    }
 
    // Apply data rates
@@ -58,10 +58,13 @@
 #include "../radio/radio_rx.h"
 #include "../radio/radio_tx.h"
 #include "../radio/radio_duplicate_det.h"
+#include "../radio/fec_worker.h"
 #include "../utils/utils_controller.h"
 #include "../base/controller_rt_info.h"
 #include "../base/vehicle_rt_info.h"
 #include "../base/core_plugins_settings.h"
+#include "../base/event_loop.h"
+#include "../base/latency_trace.h"
 #include "../common/models_connect_frequencies.h"
 
 #include "ruby_rt_station.h"
@@ -230,6 +233,11 @@ void reasign_radio_links(bool bSilent)
    else
       radio_set_use_pcap_for_tx(0);
 
+   if ( (NULL != g_pCurrentModel) && (g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX) )
+      radio_set_use_mmap_ring_for_rx(-1, 1);
+   else
+      radio_set_use_mmap_ring_for_rx(-1, 0);
+
    if ( g_pControllerSettings->iRadioBypassSocketBuffers )
       radio_set_bypass_socket_buffers(1);
    else
@@ -591,7 +599,7 @@ void init_shared_memory_objects()
       radio_stats_reset(&g_SM_RadioStats, g_pCurrentModel->osd_params.iRadioInterfacesGraphRefreshIntervalMs);
 
    if ( NULL != g_pSM_RadioStats )
-      memcpy((u8*)g_pSM_RadioStats, (u8*)&g_SM_RadioStats, sizeof(shared_mem_radio_stats));
+      shared_mem_radio_stats_publish(g_pSM_RadioStats, &g_SM_RadioStats);
 
    g_pSM_VideoDecodeStats = shared_mem_video_stream_stats_rx_processors_open_for_write();
    if ( NULL == g_pSM_VideoDecodeStats )
@@ -629,6 +637,8 @@ void init_shared_memory_objects()
    else
       log_line("Opened shared mem controller adaptive video info for writing.");
 
+   latency_trace_init(SHARED_MEM_LATENCY_TRACE_STATION);
+
    g_TimeNow = get_current_timestamp_ms();
 
    for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
@@ -776,6 +786,10 @@ void _check_send_packets(bool bDoTxSync)
 void _main_loop_searching();
 void _main_loop_simple(bool bDoBasicTxSync);
 void _main_loop_adv_sync();
+bool _router_event_loop_init();
+void _router_event_loop_close();
+bool _router_event_loop_is_active();
+void _main_loop_event_driven();
 
 void handle_sigint(int sig) 
 { 
@@ -853,6 +867,10 @@ int main(int argc, char *argv[])
    int iCPUCoresCount = hw_procs_get_cpu_count();
    log_line("Detected CPU with %d cores.", iCPUCoresCount);   
 
+   // Video blocks EC decoding runs on its own thread, if there is a core for it
+   if ( (! g_bSearching) && (iCPUCoresCount > 1) )
+      fec_worker_start(FEC_WORKER_DEFAULT_THREADS, -1);
+
    utils_log_radio_packets_sizes();
    radio_init_link_structures();
    radio_enable_crc_gen(1);
@@ -890,6 +908,11 @@ int main(int argc, char *argv[])
    else
       radio_set_use_pcap_for_tx(0);
 
+   if ( (NULL != g_pCurrentModel) && (g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX) )
+      radio_set_use_mmap_ring_for_rx(-1, 1);
+   else
+      radio_set_use_mmap_ring_for_rx(-1, 0);
+
    g_uControllerId = controller_utils_getControllerId();
    log_line("Controller UID: %u", g_uControllerId);
 
@@ -1043,6 +1066,28 @@ int main(int argc, char *argv[])
    u32 uLastLoopTime = g_TimeNow;
    g_pProcessStats->uLoopTimer1 = g_pProcessStats->uLoopTimer2 = g_TimeNow;
 
+   _router_event_loop_init();
+
+   while ( (!g_bQuit) && _router_event_loop_is_active() )
+   {
+      g_TimeNow = get_current_timestamp_ms();
+      g_pProcessStats->lastActiveTime = g_TimeNow;
+      g_pProcessStats->uLoopCounter++;
+      g_pProcessStats->uLoopSubStep = 0;
+      g_uLoopCounter++;
+
+      if ( g_bSearching )
+      {
+         static u32 s_uTimeLastSearchAliveLogEvents = 0;
+         if ( g_TimeNow > s_uTimeLastSearchAliveLogEvents + 500 )
+         {
+            s_uTimeLastSearchAliveLogEvents = g_TimeNow;
+            log_line("Still in search mode, all active...");
+         }
+      }
+      _main_loop_event_driven();
+   }
+
    while ( !g_bQuit )
    {
       g_TimeNow = get_current_timestamp_ms();
@@ -1101,12 +1146,14 @@ int main(int argc, char *argv[])
 
    log_line("Stopping...");
 
+   _router_event_loop_close();
    packet_utils_uninit();
    radio_rx_stop_rx_thread();
    radio_link_cleanup();
    unload_CorePlugins();
 
    video_processors_cleanup();
+   fec_worker_stop();
    if ( is_audio_processing_started() )
       uninit_processing_audio();
 
@@ -1123,6 +1170,7 @@ int main(int argc, char *argv[])
    shared_mem_video_frames_stats_close(g_pSM_VideoFramesStatsOutput);
    //shared_mem_video_frames_stats_radio_in_close(g_pSM_VideoInfoStatsRadioIn);
    shared_mem_router_vehicles_runtime_info_close(g_pSM_RouterVehiclesRuntimeInfo);
+   latency_trace_close();
 
    shared_mem_ctrl_ping_stats_info_close(g_pSMDbgPingStats);
    radio_links_close_rxtx_radio_interfaces(); 
@@ -1194,7 +1242,120 @@ void video_processors_cleanup()
 
 static u32 uMaxLoopTime = DEFAULT_MAX_LOOP_TIME_MILISECONDS;
 
-void _main_loop_try_recevive_data()
+// Runs the video processors (missing packets checks and retransmissions requests) and the adaptive video.
+// With advanced sync, a vehicle is synced once no video packets were received for its retransmissions guard interval.
+void _periodic_loop_video_processors(bool bAdvSync)
+{
+   bool bAnyVehicleMustSyncNow = false;
+
+   if ( ! bAdvSync )
+   {
+      for( int i=0; i<MAX_VIDEO_PROCESSORS; i++ )
+      {
+         if ( g_pVideoProcessorRxList[i] != NULL )
+            g_pVideoProcessorRxList[i]->periodicLoopProcessor(g_TimeNow, false);
+      }
+   }
+   else
+   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
+   {
+      if ( (g_State.vehiclesRuntimeInfo[i].uVehicleId == 0) || (g_State.vehiclesRuntimeInfo[i].uVehicleId == MAX_U32) )
+         continue;
+      if ( ! g_State.vehiclesRuntimeInfo[i].bIsPairingDone )
+         continue;
+      Model* pModel = findModelWithId(g_State.vehiclesRuntimeInfo[i].uVehicleId, 28);
+
+      if ( (NULL == pModel) || pModel->isVideoLinkFixedOneWay() || (! pModel->hasCamera()) )
+         continue;
+
+      ProcessorRxVideo* pProcessorRxVideo = ProcessorRxVideo::getVideoProcessorForVehicleId(g_State.vehiclesRuntimeInfo[i].uVehicleId, 0);
+      if ( (NULL != pProcessorRxVideo) && (NULL != pProcessorRxVideo->m_pVideoRxBuffer) )
+      {
+         bool bSyncNow = false;
+         if ( g_TimeNow >= pProcessorRxVideo->getLastestVideoPacketReceiveTime() + ((((u32)pModel->video_link_profiles[pModel->video_params.iCurrentVideoProfile].uProfileFlags) & VIDEO_PROFILE_FLAG_MASK_RETRANSMISSIONS_GUARD_MASK)>>8) )
+             bSyncNow = true;
+         pProcessorRxVideo->periodicLoopProcessor(g_TimeNow, bSyncNow);
+
+         if ( bSyncNow )
+            bAnyVehicleMustSyncNow = true;
+      }
+   }
+
+   if ( bAnyVehicleMustSyncNow || controller_rt_info_will_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
+      adaptive_video_periodic_loop(bAnyVehicleMustSyncNow);
+}
+
+void _update_rt_info_signal_slice()
+{
+   if ( ! controller_rt_info_will_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
+      return;
+   for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
+   {
+      memcpy((u8*)&(g_SMControllerRTInfo.radioInterfacesSignalInfoVideo[g_SMControllerRTInfo.iCurrentIndex][i]), (u8*)&(g_SM_RadioStats.radio_interfaces[i].signalInfo.signalInfoVideo), sizeof(type_runtime_radio_rx_signal_info));
+      memcpy((u8*)&(g_SMControllerRTInfo.radioInterfacesSignalInfoData[g_SMControllerRTInfo.iCurrentIndex][i]), (u8*)&(g_SM_RadioStats.radio_interfaces[i].signalInfo.signalInfoData), sizeof(type_runtime_radio_rx_signal_info));
+   }
+   radio_rx_reset_signal_info();
+   radio_stats_reset_rx_signal_info(&g_SM_RadioStats);
+}
+
+void _check_advance_rt_info_index()
+{
+   if ( ! controller_rt_info_check_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
+      return;
+   radio_rx_set_packet_counter_output(&(g_SMControllerRTInfo.uRxHighPriorityPackets[g_SMControllerRTInfo.iCurrentIndex][0]),
+       &(g_SMControllerRTInfo.uRxDataPackets[g_SMControllerRTInfo.iCurrentIndex][0]), &(g_SMControllerRTInfo.uRxMissingPackets[g_SMControllerRTInfo.iCurrentIndex][0]), &(g_SMControllerRTInfo.uRxMissingPacketsMaxGap[g_SMControllerRTInfo.iCurrentIndex][0]));
+
+   if ( g_pControllerSettings->iDeveloperMode )
+      radio_rx_set_air_gap_track_output(&(g_SMControllerRTInfo.uRxMaxAirgapSlots[g_SMControllerRTInfo.iCurrentIndex]));
+}
+
+void _check_cpu_loop_overload_alarms(u32 uLoopTimeMs)
+{
+   if ( test_link_is_in_progress() )
+      return;
+   if ( ! g_pControllerSettings->iDeveloperMode )
+      return;
+   if ( g_TimeNow <= rx_video_recording_get_last_start_stop_time() + 2000 )
+      return;
+
+   s_iCountCPULoopOverflows++;
+   if ( rx_video_is_recording() )
+   {
+      if ( uLoopTimeMs > uMaxLoopTime*2 )
+      {
+         if ( s_iCountCPULoopOverflows >= 1 )
+         if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
+            send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD_RECORDING, uLoopTimeMs, 0);
+
+         if ( uLoopTimeMs >= 300 )
+         if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
+            send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD_RECORDING, uLoopTimeMs<<16, 0);
+      }
+   }
+   else
+   {
+      if ( s_iCountCPULoopOverflows > 5 )
+      if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
+         send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD, uLoopTimeMs, 0);
+
+      if ( uLoopTimeMs >= 300 )
+      if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
+         send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD, uLoopTimeMs<<16, 0);
+   }
+}
+
+void _update_loop_time_stats(u32 uLoopTimeMs)
+{
+   if ( NULL == g_pProcessStats )
+      return;
+   if ( g_pProcessStats->uMaxLoopTimeMs < uLoopTimeMs )
+      g_pProcessStats->uMaxLoopTimeMs = uLoopTimeMs;
+   g_pProcessStats->uTotalLoopTime += uLoopTimeMs;
+   if ( 0 != g_pProcessStats->uLoopCounter )
+      g_pProcessStats->uAverageLoopTimeMs = g_pProcessStats->uTotalLoopTime / g_pProcessStats->uLoopCounter;
+}
+
+void _main_loop_try_recevive_data(bool bWaitForPackets)
 {
    g_pProcessStats->uLoopCounter2 = g_pProcessStats->uLoopCounter3 = 0;
 
@@ -1203,8 +1364,8 @@ void _main_loop_try_recevive_data()
    int iTotalConsumedRegPriority = 0;
    int iTotalConsumeLoops = 0;
    int iMaxCountToConsumeOnce = 100;
-   u32 uReadTimeoutMicrosVideo = 200;
-   u32 uReadTimeoutMicrosHigh = 200;
+   u32 uReadTimeoutMicrosVideo = bWaitForPackets?200:0;
+   u32 uReadTimeoutMicrosHigh = bWaitForPackets?200:0;
 
    do
    {
@@ -1219,11 +1380,14 @@ void _main_loop_try_recevive_data()
       int iConsumedReg = _try_read_consume_rx_packets(false, iMaxCountToConsumeOnce, uReadTimeoutMicrosVideo);
       iTotalConsumedHighPriority += iConsumedHigh;
       iTotalConsumedRegPriority += iConsumedReg;
+      ProcessorRxVideo::checkAndOutputRecoveredBlocks();
       g_pProcessStats->uLoopCounter2 += iConsumedHigh;
       g_pProcessStats->uLoopCounter3 += iConsumedReg;
       if ( (0 == iConsumedReg) && (0 == iConsumedHigh) )
          break;
 
+      if ( ! bWaitForPackets )
+         continue;
       if ( 0 != iConsumedReg )
       {
          uReadTimeoutMicrosVideo = 1000;
@@ -1253,7 +1417,7 @@ void _main_loop_searching()
 {
    g_pProcessStats->uLoopTimer1 = g_TimeNow = get_current_timestamp_ms();
 
-   _main_loop_try_recevive_data();
+   _main_loop_try_recevive_data(true);
 
    g_TimeNow = g_pProcessStats->uLoopTimer2 = get_current_timestamp_ms();
 
@@ -1281,20 +1445,13 @@ void _main_loop_simple(bool bDoBasicTxSync)
 
    u32 tTime0 = g_TimeNow;
 
-   _main_loop_try_recevive_data();
+   _main_loop_try_recevive_data(true);
 
    g_TimeNow = get_current_timestamp_ms();
    g_pProcessStats->uLoopTimer1 = g_TimeNow;
    u32 tTime1 = g_TimeNow;
 
-   for( int i=0; i<MAX_VIDEO_PROCESSORS; i++ )
-   {
-      if ( g_pVideoProcessorRxList[i] != NULL )
-         g_pVideoProcessorRxList[i]->periodicLoopProcessor(g_TimeNow, false);
-   }
-   
-   if ( controller_rt_info_will_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
-      adaptive_video_periodic_loop(false);
+   _periodic_loop_video_processors(false);
 
    router_periodic_loop();
 
@@ -1308,16 +1465,7 @@ void _main_loop_simple(bool bDoBasicTxSync)
    g_TimeNow = g_pProcessStats->uLoopTimer2 = get_current_timestamp_ms();
    u32 tTime2 = g_TimeNow;
 
-   if ( controller_rt_info_will_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
-   {
-      for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
-      {
-         memcpy((u8*)&(g_SMControllerRTInfo.radioInterfacesSignalInfoVideo[g_SMControllerRTInfo.iCurrentIndex][i]), (u8*)&(g_SM_RadioStats.radio_interfaces[i].signalInfo.signalInfoVideo), sizeof(type_runtime_radio_rx_signal_info));
-         memcpy((u8*)&(g_SMControllerRTInfo.radioInterfacesSignalInfoData[g_SMControllerRTInfo.iCurrentIndex][i]), (u8*)&(g_SM_RadioStats.radio_interfaces[i].signalInfo.signalInfoData), sizeof(type_runtime_radio_rx_signal_info));
-      }
-      radio_rx_reset_signal_info();
-      radio_stats_reset_rx_signal_info(&g_SM_RadioStats);
-   }
+   _update_rt_info_signal_slice();
 
    g_TimeNow = get_current_timestamp_ms();
    u32 tTime3 = g_TimeNow;
@@ -1331,58 +1479,16 @@ void _main_loop_simple(bool bDoBasicTxSync)
       log_softerror_and_alarm("Router %s main loop took too long to complete (loop count: %u) (%d milisec: %u + %u + %u + %u) recording: %s, repeat count: %u!!!",
         bDoBasicTxSync?"basic":"simple", g_pProcessStats->uLoopCounter, tTime4 - tTime0, tTime1-tTime0, tTime2-tTime1, tTime3-tTime2, tTime4-tTime3,
         rx_video_is_recording()?"yes":"no", s_iCountCPULoopOverflows+1);
-      if ( ! test_link_is_in_progress() )
-      if ( g_pControllerSettings->iDeveloperMode )
-      if ( g_TimeNow > rx_video_recording_get_last_start_stop_time() + 2000 )
-      {
-         s_iCountCPULoopOverflows++;
-         if ( rx_video_is_recording() )
-         {
-            if ( (tTime4 > tTime0 + uMaxLoopTime*2) )
-            {
-               if ( s_iCountCPULoopOverflows >= 1 )
-               if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
-                  send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD_RECORDING,(tTime4-tTime0), 0);
-
-               if ( tTime4 >= tTime0 + 300 )
-               if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
-                  send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD_RECORDING,(tTime4-tTime0)<<16, 0);
-            }
-         }
-         else
-         {
-            if ( s_iCountCPULoopOverflows > 5 )
-            if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
-               send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD,(tTime4-tTime0), 0);
-
-            if ( tTime4 >= tTime0 + 300 )
-            if ( g_TimeNow > g_TimeLastSetRadioFlagsCommandSent + 5000 )
-               send_alarm_to_central(ALARM_ID_CONTROLLER_CPU_LOOP_OVERLOAD,(tTime4-tTime0)<<16, 0);
-         }
-      }
+      _check_cpu_loop_overload_alarms(tTime4 - tTime0);
    }
    else
    {
       s_iCountCPULoopOverflows = 0;
    }
 
-   if ( controller_rt_info_check_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
-   {
-      radio_rx_set_packet_counter_output(&(g_SMControllerRTInfo.uRxHighPriorityPackets[g_SMControllerRTInfo.iCurrentIndex][0]),
-          &(g_SMControllerRTInfo.uRxDataPackets[g_SMControllerRTInfo.iCurrentIndex][0]), &(g_SMControllerRTInfo.uRxMissingPackets[g_SMControllerRTInfo.iCurrentIndex][0]), &(g_SMControllerRTInfo.uRxMissingPacketsMaxGap[g_SMControllerRTInfo.iCurrentIndex][0]));
-   
-      if ( g_pControllerSettings->iDeveloperMode )
-         radio_rx_set_air_gap_track_output(&(g_SMControllerRTInfo.uRxMaxAirgapSlots[g_SMControllerRTInfo.iCurrentIndex]));
-   }
+   _check_advance_rt_info_index();
 
-   if ( NULL != g_pProcessStats )
-   {
-      if ( g_pProcessStats->uMaxLoopTimeMs < tTime4 - tTime0 )
-         g_pProcessStats->uMaxLoopTimeMs = tTime4 - tTime0;
-      g_pProcessStats->uTotalLoopTime += tTime4 - tTime0;
-      if ( 0 != g_pProcessStats->uLoopCounter )
-         g_pProcessStats->uAverageLoopTimeMs = g_pProcessStats->uTotalLoopTime / g_pProcessStats->uLoopCounter;
-   }
+   _update_loop_time_stats(tTime4 - tTime0);
 }
 
 void _main_loop_adv_sync()
@@ -1390,7 +1496,7 @@ void _main_loop_adv_sync()
    g_TimeNow = get_current_timestamp_ms();
    u32 tTime0 = g_TimeNow;
 
-   _main_loop_try_recevive_data();
+   _main_loop_try_recevive_data(true);
 
    // To fix
    /*
@@ -1407,37 +1513,10 @@ void _main_loop_adv_sync()
    */
 
    g_TimeNow = get_current_timestamp_ms();
-   bool bAnyVehicleMustSyncNow = false;
-
-   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
-   {
-      if ( (g_State.vehiclesRuntimeInfo[i].uVehicleId == 0) || (g_State.vehiclesRuntimeInfo[i].uVehicleId == MAX_U32) )
-         continue;
-      if ( ! g_State.vehiclesRuntimeInfo[i].bIsPairingDone )
-         continue;
-      Model* pModel = findModelWithId(g_State.vehiclesRuntimeInfo[i].uVehicleId, 28);
-
-      if ( (NULL == pModel) || pModel->isVideoLinkFixedOneWay() || (! pModel->hasCamera()) )
-         continue;
-
-      ProcessorRxVideo* pProcessorRxVideo = ProcessorRxVideo::getVideoProcessorForVehicleId(g_State.vehiclesRuntimeInfo[i].uVehicleId, 0);
-      if ( (NULL != pProcessorRxVideo) && (NULL != pProcessorRxVideo->m_pVideoRxBuffer) )
-      {
-         bool bSyncNow = false;
-         if ( g_TimeNow >= pProcessorRxVideo->getLastestVideoPacketReceiveTime() + ((((u32)pModel->video_link_profiles[pModel->video_params.iCurrentVideoProfile].uProfileFlags) & VIDEO_PROFILE_FLAG_MASK_RETRANSMISSIONS_GUARD_MASK)>>8) )
-             bSyncNow = true;
-         pProcessorRxVideo->periodicLoopProcessor(g_TimeNow, bSyncNow);
-
-         if ( bSyncNow )
-            bAnyVehicleMustSyncNow = true;
-      }
-   }
+   _periodic_loop_video_processors(true);
 
    u32 tTime1 = g_TimeNow;
 
-   if ( bAnyVehicleMustSyncNow || controller_rt_info_will_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
-      adaptive_video_periodic_loop(bAnyVehicleMustSyncNow);
-
    router_periodic_loop();
    
    _read_ipc_pipes(tTime1);
@@ -1449,16 +1528,7 @@ void _main_loop_adv_sync()
    g_TimeNow = get_current_timestamp_ms();
    u32 tTime2 = g_TimeNow;
 
-   if ( controller_rt_info_will_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
-   {
-      for( int i=0; i<hardware_get_radio_interfaces_count(); i++ )
-      {
-         memcpy((u8*)&(g_SMControllerRTInfo.radioInterfacesSignalInfoVideo[g_SMControllerRTInfo.iCurrentIndex][i]), (u8*)&(g_SM_RadioStats.radio_interfaces[i].signalInfo.signalInfoVideo), sizeof(type_runtime_radio_rx_signal_info));
-         memcpy((u8*)&(g_SMControllerRTInfo.radioInterfacesSignalInfoData[g_SMControllerRTInfo.iCurrentIndex][i]), (u8*)&(g_SM_RadioStats.radio_interfaces[i].signalInfo.signalInfoData), sizeof(type_runtime_radio_rx_signal_info));
-      }
-      radio_rx_reset_signal_info();
-      radio_stats_reset_rx_signal_info(&g_SM_RadioStats);
-   }
+   _update_rt_info_signal_slice();
 
    g_TimeNow = get_current_timestamp_ms();
    u32 tTime3 = g_TimeNow;
@@ -1503,20 +1573,200 @@ void _main_loop_adv_sync()
       s_iCountCPULoopOverflows = 0;
    }
 
-   if ( controller_rt_info_check_advance_index(&g_SMControllerRTInfo, g_TimeNow) )
+   _check_advance_rt_info_index();
+
+   _update_loop_time_stats(tTime4 - tTime0);
+}
+
+//------------------------------------------------------------
+// Event driven main loop: radio rx wakeups, video/rt info timer, IPC and
+// housekeeping timers, dispatched by priority (radio rx and video first).
+
+static type_event_loop s_RouterEventLoop;
+static bool s_bRouterEventLoopActive = false;
+static int s_iRouterEventLoopSourceRadioRx = -1;
+static int s_iRouterEventLoopSourceVideo = -1;
+static u32 s_uRouterRadioRxStartCount = 0;
+static bool s_bRouterEventLoopVideoChecked = false;
+static shared_mem_loop_latency_stats_versioned* s_pSMLoopLatency = NULL;
+
+#define ROUTER_EVENT_LOOP_IPC_PERIOD_MICROS 2000
+#define ROUTER_EVENT_LOOP_HOUSEKEEPING_PERIOD_MICROS 5000
+
+static int _router_event_loop_radio_rx_prepare_wait(void* pContext)
+{
+   return radio_rx_prepare_wait();
+}
+
+static void _router_event_loop_radio_rx_finish_wait(void* pContext)
+{
+   radio_rx_finish_wait();
+}
+
+static void _router_event_loop_on_radio_rx(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   _main_loop_try_recevive_data(false);
+}
+
+// Video processors checks run at the retransmissions guard interval (adv sync), at most at the rt info slice interval
+static u32 _router_event_loop_get_video_period_micros()
+{
+   u32 uPeriodMs = SYSTEM_RT_INFO_UPDATE_INTERVAL_MS;
+   if ( g_bSearching || (NULL == g_pCurrentModel) || (! g_pCurrentModel->hasCamera()) )
+      return uPeriodMs * 1000;
+   if ( g_pCurrentModel->rxtx_sync_type == RXTX_SYNC_TYPE_ADV )
+   if ( ! g_pCurrentModel->isVideoLinkFixedOneWay() )
    {
-      radio_rx_set_packet_counter_output(&(g_SMControllerRTInfo.uRxHighPriorityPackets[g_SMControllerRTInfo.iCurrentIndex][0]),
-          &(g_SMControllerRTInfo.uRxDataPackets[g_SMControllerRTInfo.iCurrentIndex][0]), &(g_SMControllerRTInfo.uRxMissingPackets[g_SMControllerRTInfo.iCurrentIndex][0]), &(g_SMControllerRTInfo.uRxMissingPacketsMaxGap[g_SMControllerRTInfo.iCurrentIndex][0]));
-      if ( g_pControllerSettings->iDeveloperMode )
-         radio_rx_set_air_gap_track_output(&(g_SMControllerRTInfo.uRxMaxAirgapSlots[g_SMControllerRTInfo.iCurrentIndex]));
+      u32 uGuardMs = (((u32)g_pCurrentModel->video_link_profiles[g_pCurrentModel->video_params.iCurrentVideoProfile].uProfileFlags) & VIDEO_PROFILE_FLAG_MASK_RETRANSMISSIONS_GUARD_MASK)>>8;
+      if ( (uGuardMs > 0) && (uGuardMs < uPeriodMs) )
+         uPeriodMs = uGuardMs;
    }
+   return uPeriodMs * 1000;
+}
 
-   if ( NULL != g_pProcessStats )
+static void _router_event_loop_on_video(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   if ( ! g_bSearching )
    {
-      if ( g_pProcessStats->uMaxLoopTimeMs < tTime4 - tTime0 )
-         g_pProcessStats->uMaxLoopTimeMs = tTime4 - tTime0;
-      g_pProcessStats->uTotalLoopTime += tTime4 - tTime0;
-      if ( 0 != g_pProcessStats->uLoopCounter )
-         g_pProcessStats->uAverageLoopTimeMs = g_pProcessStats->uTotalLoopTime / g_pProcessStats->uLoopCounter;
+      _periodic_loop_video_processors((NULL != g_pCurrentModel) && (g_pCurrentModel->rxtx_sync_type == RXTX_SYNC_TYPE_ADV));
+      s_bRouterEventLoopVideoChecked = true;
+      _update_rt_info_signal_slice();
+      _check_advance_rt_info_index();
+   }
+
+   u32 uPeriodMicros = _router_event_loop_get_video_period_micros();
+   if ( uPeriodMicros != s_RouterEventLoop.sources[s_iRouterEventLoopSourceVideo].uPeriodMicros )
+      event_loop_set_timer_period(&s_RouterEventLoop, s_iRouterEventLoopSourceVideo, uPeriodMicros);
+}
+
+static void _router_event_loop_on_fec_worker(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   fec_worker_clear_wakeup();
+   ProcessorRxVideo::checkAndOutputRecoveredBlocks();
+}
+
+static void _router_event_loop_on_ipc(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   _read_ipc_pipes(g_TimeNow);
+   _consume_ipc_messages();
+}
+
+static void _router_event_loop_on_housekeeping(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   router_periodic_loop();
+   if ( (! g_bSearching) && (NULL != g_pCurrentModel) && g_pCurrentModel->hasCamera() )
+      rx_video_output_periodic_loop();
+}
+
+// Returns false if the event loop can't be used; the polling main loops are used then
+bool _router_event_loop_init()
+{
+   if ( radio_rx_get_wakeup_fd() < 0 )
+   {
+      log_softerror_and_alarm("[EventLoop] Radio rx has no wakeup fd. Using the polling main loop.");
+      return false;
+   }
+   if ( ! event_loop_init(&s_RouterEventLoop) )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to create the event loop. Using the polling main loop.");
+      return false;
+   }
+
+   s_uRouterRadioRxStartCount = radio_rx_get_start_count();
+   s_iRouterEventLoopSourceRadioRx = event_loop_add_fd(&s_RouterEventLoop, "radio-rx", radio_rx_get_wakeup_fd(), EVENT_LOOP_PRIORITY_HIGH,
+      _router_event_loop_on_radio_rx, _router_event_loop_radio_rx_prepare_wait, _router_event_loop_radio_rx_finish_wait, NULL);
+   s_iRouterEventLoopSourceVideo = event_loop_add_timer(&s_RouterEventLoop, "video", _router_event_loop_get_video_period_micros(), EVENT_LOOP_PRIORITY_HIGH, _router_event_loop_on_video, NULL);
+   if ( fec_worker_get_wakeup_fd() >= 0 )
+   if ( event_loop_add_fd(&s_RouterEventLoop, "video-fec", fec_worker_get_wakeup_fd(), EVENT_LOOP_PRIORITY_HIGH, _router_event_loop_on_fec_worker, NULL, NULL, NULL) < 0 )
+      log_softerror_and_alarm("[EventLoop] Failed to add the FEC workers source, recovered blocks are collected on received packets only.");
+   // IPC channels are message queues by default (no fd to wait on), so they are polled
+   int iSourceIPC = event_loop_add_timer(&s_RouterEventLoop, "ipc", ROUTER_EVENT_LOOP_IPC_PERIOD_MICROS, EVENT_LOOP_PRIORITY_NORMAL, _router_event_loop_on_ipc, NULL);
+   int iSourceHousekeeping = event_loop_add_timer(&s_RouterEventLoop, "housekeeping", ROUTER_EVENT_LOOP_HOUSEKEEPING_PERIOD_MICROS, EVENT_LOOP_PRIORITY_LOW, _router_event_loop_on_housekeeping, NULL);
+
+   if ( (s_iRouterEventLoopSourceRadioRx < 0) || (s_iRouterEventLoopSourceVideo < 0) || (iSourceIPC < 0) || (iSourceHousekeeping < 0) )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to add the event loop sources. Using the polling main loop.");
+      event_loop_close(&s_RouterEventLoop);
+      return false;
    }
+
+   s_pSMLoopLatency = shared_mem_loop_latency_stats_open_for_write(SHARED_MEM_LOOP_LATENCY_STATION);
+   if ( NULL == s_pSMLoopLatency )
+      log_softerror_and_alarm("[EventLoop] Failed to open shared mem for loop latency stats for write!");
+   event_loop_set_shared_stats(&s_RouterEventLoop, s_pSMLoopLatency);
+
+   s_bRouterEventLoopActive = true;
+   log_line("[EventLoop] Using the event driven main loop (video timer: %u us).", s_RouterEventLoop.sources[s_iRouterEventLoopSourceVideo].uPeriodMicros);
+   return true;
+}
+
+void _router_event_loop_close()
+{
+   if ( ! s_bRouterEventLoopActive )
+      return;
+   event_loop_close(&s_RouterEventLoop);
+   shared_mem_loop_latency_stats_close(s_pSMLoopLatency);
+   s_pSMLoopLatency = NULL;
+   s_bRouterEventLoopActive = false;
+}
+
+bool _router_event_loop_is_active()
+{
+   return s_bRouterEventLoopActive;
+}
+
+void _main_loop_event_driven()
+{
+   // Radio rx thread was restarted (radio links reassigned): it has a new wakeup fd
+   if ( radio_rx_get_start_count() != s_uRouterRadioRxStartCount )
+   {
+      s_uRouterRadioRxStartCount = radio_rx_get_start_count();
+      event_loop_set_fd(&s_RouterEventLoop, s_iRouterEventLoopSourceRadioRx, radio_rx_get_wakeup_fd());
+      log_line("[EventLoop] Radio rx restarted, updated wakeup fd.");
+   }
+
+   g_pProcessStats->uLoopTimer1 = g_TimeNow = get_current_timestamp_ms();
+   u32 tTime0 = g_TimeNow;
+
+   s_bRouterEventLoopVideoChecked = false;
+   event_loop_run_once(&s_RouterEventLoop, 100);
+
+   g_TimeNow = g_pProcessStats->uLoopTimer2 = get_current_timestamp_ms();
+
+   if ( g_bSearching )
+   {
+      s_iCountCPULoopOverflows = 0;
+      _update_loop_time_stats(g_TimeNow - tTime0);
+      return;
+   }
+
+   // As in the polling adv sync loop: the retransmissions checks run on each pass, not just on the video timer
+   bool bAdvSync = (NULL != g_pCurrentModel) && (g_pCurrentModel->rxtx_sync_type == RXTX_SYNC_TYPE_ADV);
+   if ( bAdvSync && (! s_bRouterEventLoopVideoChecked) )
+      _periodic_loop_video_processors(true);
+
+   _check_send_packets(bAdvSync || ((NULL != g_pCurrentModel) && (g_pCurrentModel->rxtx_sync_type == RXTX_SYNC_TYPE_BASIC)));
+
+   g_TimeNow = get_current_timestamp_ms();
+
+   // Only the time spent in handlers counts as loop time, not the time waiting for events
+   u32 uLoopTimeMs = s_RouterEventLoop.uLastIterationMicros/1000 + (g_TimeNow - g_pProcessStats->uLoopTimer2);
+   if ( (g_TimeNow > g_TimeStart + 10000) && (uLoopTimeMs > uMaxLoopTime) )
+   {
+      log_softerror_and_alarm("Router event loop iteration took too long to complete (loop count: %u) (%u milisec) recording: %s, repeat count: %u!!!",
+         g_pProcessStats->uLoopCounter, uLoopTimeMs, rx_video_is_recording()?"yes":"no", s_iCountCPULoopOverflows+1);
+      _check_cpu_loop_overload_alarms(uLoopTimeMs);
+   }
+   else
+      s_iCountCPULoopOverflows = 0;
+
+   if ( uLoopTimeMs >= 70 )
+      discardRetransmissionsInfoAndBuffersOnLengthyOp();
+
+   _update_loop_time_stats(uLoopTimeMs);
 }
@@ -58,6 +58,8 @@
 #include "../base/hardware_procs.h"
 #include "../base/ruby_ipc.h"
 #include "../base/parser_h264.h"
+#include "../base/video_frame_ring.h"
+#include "../base/latency_trace.h"
 #include "../base/camera_utils.h"
 #include "../common/string_utils.h"
 #include "../radio/radiolink.h"
@@ -88,9 +90,8 @@ u8* s_pPipeVideoOutputBuffer = NULL;
 int s_iPipeVideoOutputPos = 0;
 
 shared_mem_process_stats* s_pSMProcessStatsMPPPlayer = NULL;
-sem_t* s_pSemaphoreSMData = NULL;
-u8* s_pSMVideoStreamerWrite = NULL;
-u32 s_uSMVideoStreamWritePosition = 0;
+type_video_frame_ring s_VideoFrameRing;
+bool s_bVideoFrameRingCreated = false;
 bool s_bEnableVideoStreamerOutput = false;
 bool s_bDidSentAnyDataToVideoStreamerSM = false;
 bool s_bDidSentAnyDataToVideoStreamerPipe = false;
@@ -162,23 +163,6 @@ void rx_video_output_start_video_streamer()
       return;
    }
 
-   if ( NULL != s_pSemaphoreSMData )
-      sem_close(s_pSemaphoreSMData);
-   s_pSemaphoreSMData = NULL;
-
-   //s_pSemaphoreSMData = sem_open(SEMAPHORE_SM_VIDEO_DATA_AVAILABLE, O_RDWR);
-   s_pSemaphoreSMData = sem_open(SEMAPHORE_SM_VIDEO_DATA_AVAILABLE, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-   if ( (NULL == s_pSemaphoreSMData) || (SEM_FAILED == s_pSemaphoreSMData) )
-   {
-      log_error_and_alarm("[VideoOutput] Failed to create semaphore: %s", SEMAPHORE_SM_VIDEO_DATA_AVAILABLE);
-      return;
-   }
-   int iSemVal = 0;
-   if ( 0 == sem_getvalue(s_pSemaphoreSMData, &iSemVal) )
-      log_line("[VideoOutput] SM data semaphore initial value: %d", iSemVal);
-   else
-      log_softerror_and_alarm("[VideoOutput] Failed to get SM data semaphore value.");
-
    char szStreamerPrefixes[256];
    char szStreamerParams[256];
    char szTmp[32];
@@ -348,11 +332,6 @@ void rx_video_output_stop_video_streamer()
 
    s_iPIDVideoStreamer = -1;
 
-   if ( NULL != s_pSemaphoreSMData )
-      sem_close(s_pSemaphoreSMData);
-   s_pSemaphoreSMData = NULL;
-   sem_unlink(SEMAPHORE_SM_VIDEO_DATA_AVAILABLE);
-
    log_line("[VideoOutput] Executed command to stop video streamer");
 }
 
@@ -407,16 +386,11 @@ static void * _thread_rx_video_output_streamer_watchdog(void *argument)
       rx_video_output_stop_video_streamer();
       if ( s_bRxVideoOutputUseSM )
       {
-         s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-         if ( NULL != s_pSMVideoStreamerWrite )
-         {
-            u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-            u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-            *pTmp1 = s_uSMVideoStreamWritePosition;
-            *pTmp2 = s_uSMVideoStreamWritePosition;
-         }
+         // The router does not write to the SM while the reinitialize flag is set
+         if ( s_bVideoFrameRingCreated )
+            video_frame_ring_discard_frame(&s_VideoFrameRing);
          s_bDidSentAnyDataToVideoStreamerSM = false;
-         log_line("[VideoOutputThread] Reseted SM video output position.");
+         log_line("[VideoOutputThread] Discarded SM video output partial frame.");
       }
 
       if ( ! s_bRxVideoOutputStreamerThreadMustStop )
@@ -598,44 +572,16 @@ void rx_video_output_init()
    s_ParserH264StreamOutput.init();
    s_ParserH264VideoOutput.init();
    
-   s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-   s_pSMVideoStreamerWrite = NULL;
-
+   s_bVideoFrameRingCreated = false;
    if ( s_bRxVideoOutputUseSM )
    {
-      int fdSM = shm_open(SM_STREAMER_NAME, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
-
-      if( fdSM < 0 )
-         log_softerror_and_alarm("[VideoOutput] Failed to open shared memory for write: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-      else
+      if ( video_frame_ring_create(&s_VideoFrameRing, VIDEO_FRAME_RING_NAME) )
       {
-         if ( ftruncate(fdSM, SM_STREAMER_SIZE) == -1 )
-         {
-            log_softerror_and_alarm("[VideoOutput] Failed to init (ftruncate) shared memory: %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-            close(fdSM);
-         }
-         else
-         {
-            s_pSMVideoStreamerWrite = (u8*) mmap(NULL, SM_STREAMER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fdSM, 0);
-            if ( (s_pSMVideoStreamerWrite == MAP_FAILED) || (s_pSMVideoStreamerWrite == NULL) )
-            {
-               log_softerror_and_alarm("[VideoOutput] Failed to map shared memory %s, error: %d %s", SM_STREAMER_NAME, errno, strerror(errno));
-               close(fdSM);
-               s_pSMVideoStreamerWrite = NULL;
-            }
-            else
-            {
-               memset(s_pSMVideoStreamerWrite, 0, SM_STREAMER_SIZE);
-               close(fdSM);
-               s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-               u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-               u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-               *pTmp1 = s_uSMVideoStreamWritePosition;
-               *pTmp2 = s_uSMVideoStreamWritePosition;
-               log_line("[VideoOutput] Successfully opened and cleared SM for video output: %s", SM_STREAMER_NAME);
-            }
-         }
+         s_bVideoFrameRingCreated = true;
+         log_line("[VideoOutput] Successfully created SM video frames ring for video output: %s", VIDEO_FRAME_RING_NAME);
       }
+      else
+         log_softerror_and_alarm("[VideoOutput] Failed to create SM video frames ring for video output: %s", VIDEO_FRAME_RING_NAME);
    }
    s_pSemaphoreVideoStreamerOverloadAlarm = sem_open(SEMAPHORE_VIDEO_STREAMER_OVERLOAD, O_CREAT, S_IWUSR | S_IRUSR, 0);
    if ( (NULL == s_pSemaphoreVideoStreamerOverloadAlarm) || (SEM_FAILED == s_pSemaphoreVideoStreamerOverloadAlarm) )
@@ -782,12 +728,12 @@ void rx_video_output_uninit()
       sem_close(s_pSemaphoreVideoStreamerOverloadAlarm);
    s_pSemaphoreVideoStreamerOverloadAlarm = NULL;
 
-   if ( NULL != s_pSMVideoStreamerWrite )
+   if ( s_bVideoFrameRingCreated )
    {
-      munmap(s_pSMVideoStreamerWrite, SM_STREAMER_SIZE);
-      s_pSMVideoStreamerWrite = NULL;
-      s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-      log_line("[VideoOutput] Closes streamer SM for video output: %S", SM_STREAMER_NAME);
+      log_line("[VideoOutput] Closed SM video frames ring (%u frames published, %u dropped, %u skipped by the player)",
+         s_VideoFrameRing.pHeader->uTotalFramesPublished, s_VideoFrameRing.pHeader->uTotalFramesDropped, s_VideoFrameRing.pHeader->uTotalFramesReclaimedUnread);
+      video_frame_ring_close(&s_VideoFrameRing);
+      s_bVideoFrameRingCreated = false;
    }
    log_line("[VideoOutput] Uninit complete.");
 }
@@ -796,14 +742,10 @@ void rx_video_output_enable_streamer_output()
 {
    log_line("[VideoOutput] Enable video output to streamer.");
 
-   if ( s_bRxVideoOutputUseSM )
+   if ( s_bRxVideoOutputUseSM && s_bVideoFrameRingCreated )
    {
-      s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-      u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-      u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-      *pTmp1 = s_uSMVideoStreamWritePosition;
-      *pTmp2 = s_uSMVideoStreamWritePosition;
-      log_line("[VideoOutput] Reseted SM video output position.");
+      video_frame_ring_discard_frame(&s_VideoFrameRing);
+      log_line("[VideoOutput] Discarded SM video output partial frame.");
    }
 
    _rx_video_output_check_start_streamer();
@@ -922,9 +864,10 @@ void _rx_video_output_parse_h264_stream(u32 uVehicleId, u8* pBuffer, int iLength
    */
 }
 
+// Writes the data in place in the SM frames ring; the player hands the published frames straight to the decoder
 void _rx_video_output_to_sharedmem(u8* pBuffer, u32 uLength, bool bWaitFullFrame, bool bIsEndOfNALFrame)
 {
-   if ( (NULL == pBuffer) || (uLength == 0 ) || (NULL == s_pSMVideoStreamerWrite) || (!s_bEnableVideoStreamerOutput) || s_bRxVideoOutputStreamerMustReinitialize )
+   if ( (NULL == pBuffer) || (uLength == 0 ) || (!s_bVideoFrameRingCreated) || (!s_bEnableVideoStreamerOutput) || s_bRxVideoOutputStreamerMustReinitialize )
       return;
 
    s_uTimeLastOutputDataToLocalVideoPlayer = g_TimeNow;
@@ -934,38 +877,16 @@ void _rx_video_output_to_sharedmem(u8* pBuffer, u32 uLength, bool bWaitFullFrame
       s_bDidSentAnyDataToVideoStreamerSM = true;
    }
 
-   if ( uLength <= (SM_STREAMER_SIZE-s_uSMVideoStreamWritePosition) )
-   {
-      memcpy(&(s_pSMVideoStreamerWrite[s_uSMVideoStreamWritePosition]), pBuffer, uLength);
-      s_uSMVideoStreamWritePosition += uLength;
-      if ( s_uSMVideoStreamWritePosition >= SM_STREAMER_SIZE )
-         s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-   }
-   else
-   {
-      u32 uLeft = SM_STREAMER_SIZE-s_uSMVideoStreamWritePosition;
-      memcpy(&(s_pSMVideoStreamerWrite[s_uSMVideoStreamWritePosition]), pBuffer, uLeft);
-      u8* pTmp = pBuffer + uLeft;
-      s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-
-      memcpy(&(s_pSMVideoStreamerWrite[s_uSMVideoStreamWritePosition]), pTmp, uLength-uLeft);
-      s_uSMVideoStreamWritePosition += uLength-uLeft;
-      if ( s_uSMVideoStreamWritePosition >= SM_STREAMER_SIZE )
-         s_uSMVideoStreamWritePosition = 2*sizeof(u32);
-   }
+   video_frame_ring_write(&s_VideoFrameRing, pBuffer, uLength);
 
    if ( (! bWaitFullFrame) || (bWaitFullFrame && bIsEndOfNALFrame) )
    {
-      u32* pTmp1 = (u32*)(&(s_pSMVideoStreamerWrite[0]));
-      u32* pTmp2 = (u32*)(&(s_pSMVideoStreamerWrite[sizeof(u32)]));
-      *pTmp1 = s_uSMVideoStreamWritePosition;
-      *pTmp2 = s_uSMVideoStreamWritePosition;
-
-      if ( NULL != s_pSemaphoreSMData )
-      {
-         if ( 0 != sem_post(s_pSemaphoreSMData) )
-            log_softerror_and_alarm("[VideoOutput] Failed to set semaphore for SM data.");
-      }
+      u32 uFlags = 0;
+      if ( bIsEndOfNALFrame )
+         uFlags |= VIDEO_FRAME_RING_FLAG_NAL_END;
+      if ( s_uCurrentReceivedVideoStreamType == VIDEO_TYPE_H265 )
+         uFlags |= VIDEO_FRAME_RING_FLAG_H265;
+      video_frame_ring_publish(&s_VideoFrameRing, uFlags);
    }
 }
 
@@ -1153,15 +1074,13 @@ void _rx_video_output_to_usb(u8* pData, int iLength)
 void rx_video_output_discard_cached_data()
 {
    if ( s_bEnableVideoStreamerOutput && s_bRxVideoOutputUseSM )
-   if ( NULL != s_pSMVideoStreamerWrite )
-   {
-      s_uSMVideoStreamWritePosition = s_pSMVideoStreamerWrite[0];
-   }
+   if ( s_bVideoFrameRingCreated )
+      video_frame_ring_discard_frame(&s_VideoFrameRing);
 
    s_iPipeVideoOutputPos = 0;
 }
 
-void rx_video_output_video_data(u32 uVehicleId, t_packet_header_video_segment* pPHVS, int width, int height, u8* pBuffer, int video_data_length, int packet_length, bool bWaitFullFrame)
+void rx_video_output_video_data(u32 uVehicleId, t_packet_header_video_segment* pPHVS, int width, int height, u8* pBuffer, int video_data_length, int packet_length, bool bWaitFullFrame, u64 uTraceRxTimeMicros)
 {
    if ( g_bSearching )
       return;
@@ -1266,6 +1185,9 @@ void rx_video_output_video_data(u32 uVehicleId, t_packet_header_video_segment* p
    if ( -1 != s_iLocalVideoPlayerUDPSocket )
       _rx_video_output_to_local_video_player_udp(pBuffer, video_data_length);
 
+   // Output stage: the video data of the packet reached the player/streamer
+   latency_trace_add_since(LATENCY_TRACE_STAGE_OUTPUT, uTraceRxTimeMicros);
+
    if ( s_VideoETHOutputInfo.s_bForwardETHPipeEnabled && (-1 != s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile) )
       write(s_VideoETHOutputInfo.s_ForwardETHVideoPipeFile, pBuffer, video_data_length);
 
@@ -67,13 +67,13 @@ shared_mem_router_vehicles_runtime_info g_SM_RouterVehiclesRuntimeInfo;
 shared_mem_router_vehicles_runtime_info* g_pSM_RouterVehiclesRuntimeInfo = NULL;
 
 shared_mem_video_stream_stats_rx_processors g_SM_VideoDecodeStats;
-shared_mem_video_stream_stats_rx_processors* g_pSM_VideoDecodeStats = NULL;
+shared_mem_video_stream_stats_rx_processors_versioned* g_pSM_VideoDecodeStats = NULL;
 
 shared_mem_radio_rx_queue_info* g_pSM_RadioRxQueueInfo = NULL;
 shared_mem_radio_rx_queue_info g_SM_RadioRxQueueInfo;
 
 shared_mem_radio_stats g_SM_RadioStats;
-shared_mem_radio_stats* g_pSM_RadioStats = NULL;
+shared_mem_radio_stats_versioned* g_pSM_RadioStats = NULL;
 
 shared_mem_process_stats* g_pProcessStats = NULL;
 shared_mem_process_stats* g_pProcessStatsCentral = NULL;
@@ -48,13 +48,13 @@ extern shared_mem_router_vehicles_runtime_info g_SM_RouterVehiclesRuntimeInfo;
 extern shared_mem_router_vehicles_runtime_info* g_pSM_RouterVehiclesRuntimeInfo;
 
 extern shared_mem_video_stream_stats_rx_processors g_SM_VideoDecodeStats;
-extern shared_mem_video_stream_stats_rx_processors* g_pSM_VideoDecodeStats;
+extern shared_mem_video_stream_stats_rx_processors_versioned* g_pSM_VideoDecodeStats;
 
 extern shared_mem_radio_rx_queue_info* g_pSM_RadioRxQueueInfo;
 extern shared_mem_radio_rx_queue_info g_SM_RadioRxQueueInfo;
 
 extern shared_mem_radio_stats g_SM_RadioStats;
-extern shared_mem_radio_stats* g_pSM_RadioStats;
+extern shared_mem_radio_stats_versioned* g_pSM_RadioStats;
 
 extern shared_mem_process_stats* g_pProcessStats;
 extern shared_mem_process_stats* g_pProcessStatsCentral;
@@ -35,6 +35,7 @@
 #include "timers.h"
 #include "packets_utils.h"
 #include "../radio/fec.h"
+#include "../base/latency_trace.h"
 
 int VideoRxPacketsBuffer::m_siVideoBuffersInstancesCount = 0;
 
@@ -50,6 +51,7 @@ VideoRxPacketsBuffer::VideoRxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
    {
       _empty_block_buffer_index(i);
+      m_VideoBlocks[i].uAllocatedMask = 0;
       for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
       {
          m_VideoBlocks[i].packets[k].pRawData = NULL;
@@ -63,17 +65,25 @@ VideoRxPacketsBuffer::VideoRxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    m_iTopBufferIndex = 0;
    m_iBottomBufferIndex = 0;
    m_iBottomBufferPacketIndex = 0;
+   m_uTraceRxTimeMicros = 0;
+   m_uLastECJobId = 0;
 }
 
 VideoRxPacketsBuffer::~VideoRxPacketsBuffer()
 {
    uninit();
 
+   // FEC worker jobs still running reference this instance
+   if ( fec_worker_get_pending_jobs() > 0 )
+   if ( ! fec_worker_wait_all_completed(500) )
+      log_softerror_and_alarm("[VideoRXBuffer] Timed out waiting for the FEC workers to finish.");
+
    for( int i=0; i<MAX_RXTX_BLOCKS_BUFFER; i++ )
    for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
    {
       if ( NULL != m_VideoBlocks[i].packets[k].pRawData )
-         free(m_VideoBlocks[i].packets[k].pRawData);
+         packet_pool_unref(m_VideoBlocks[i].packets[k].pRawData);
+      m_VideoBlocks[i].uAllocatedMask = 0;
 
       m_VideoBlocks[i].packets[k].pRawData = NULL;
       m_VideoBlocks[i].packets[k].pVideoData = NULL;
@@ -123,22 +133,19 @@ bool VideoRxPacketsBuffer::_check_allocate_video_block_in_buffer(int iBufferInde
    if ( (iBufferIndex < 0) || (iBufferIndex >= MAX_RXTX_BLOCKS_BUFFER) )
       return false;
 
-   for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockDataPackets + m_VideoBlocks[iBufferIndex].iBlockECPackets; i++ )
+   u32 uToAllocate = VIDEO_RX_PACKETS_MASK(m_VideoBlocks[iBufferIndex].iBlockDataPackets + m_VideoBlocks[iBufferIndex].iBlockECPackets) & (~m_VideoBlocks[iBufferIndex].uAllocatedMask);
+   while ( 0 != uToAllocate )
    {
-      if ( NULL != m_VideoBlocks[iBufferIndex].packets[i].pRawData )
-         continue;
+      int i = __builtin_ctz(uToAllocate);
+      uToAllocate &= uToAllocate - 1;
 
-      u8* pRawData = (u8*)malloc(MAX_PACKET_TOTAL_SIZE);
+      u8* pRawData = packet_pool_alloc();
       if ( NULL == pRawData )
       {
          log_error_and_alarm("[VideoRXBuffer] Failed to allocate packet, buffer index: %d, packet index %d", iBufferIndex, i);
          return false;
       }
-      m_VideoBlocks[iBufferIndex].packets[i].pRawData = pRawData;
-      m_VideoBlocks[iBufferIndex].packets[i].pVideoData = pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment);
-      m_VideoBlocks[iBufferIndex].packets[i].pPH = (t_packet_header*)pRawData;
-      m_VideoBlocks[iBufferIndex].packets[i].pPHVS = (t_packet_header_video_segment*)(pRawData + sizeof(t_packet_header));
-      m_VideoBlocks[iBufferIndex].packets[i].pPHVSImp = (t_packet_header_video_segment_important*)(pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+      _set_packet_buffer(iBufferIndex, i, pRawData);
 
       m_VideoBlocks[iBufferIndex].packets[i].pPHVS->uCurrentBlockDataPackets = m_VideoBlocks[iBufferIndex].iBlockDataPackets;
       m_VideoBlocks[iBufferIndex].packets[i].pPHVS->uCurrentBlockECPackets = m_VideoBlocks[iBufferIndex].iBlockECPackets;
@@ -147,19 +154,36 @@ bool VideoRxPacketsBuffer::_check_allocate_video_block_in_buffer(int iBufferInde
    return true;
 }
 
+// Releases the current packet buffer (if any) and takes over the reference to pRawData
+void VideoRxPacketsBuffer::_set_packet_buffer(int iBufferIndex, int iPacketIndex, u8* pRawData)
+{
+   if ( NULL != m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pRawData )
+      packet_pool_unref(m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pRawData);
+   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pRawData = pRawData;
+   m_VideoBlocks[iBufferIndex].uAllocatedMask |= VIDEO_RX_PACKET_BIT(iPacketIndex);
+   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pVideoData = pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment);
+   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pPH = (t_packet_header*)pRawData;
+   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pPHVS = (t_packet_header_video_segment*)(pRawData + sizeof(t_packet_header));
+   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].pPHVSImp = (t_packet_header_video_segment_important*)(pRawData + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+}
+
 void VideoRxPacketsBuffer::_empty_block_buffer_packet_index(int iBufferIndex, int iPacketIndex)
 {
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].uReceivedTime = 0;
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].uRequestedTime = 0;
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].bEmpty = true;
-   m_VideoBlocks[iBufferIndex].packets[iPacketIndex].bReconstructed = false;
+   u32 uMask = ~VIDEO_RX_PACKET_BIT(iPacketIndex);
+   m_VideoBlocks[iBufferIndex].uReceivedMask &= uMask;
+   m_VideoBlocks[iBufferIndex].uReconstructedMask &= uMask;
+   m_VideoBlocks[iBufferIndex].uRequestedMask &= uMask;
 }
 
 void VideoRxPacketsBuffer::_empty_block_buffer_index(int iBufferIndex)
 {
+   m_VideoBlocks[iBufferIndex].uReceivedMask = 0;
+   m_VideoBlocks[iBufferIndex].uReconstructedMask = 0;
+   m_VideoBlocks[iBufferIndex].uRequestedMask = 0;
    m_VideoBlocks[iBufferIndex].uH264FrameIndex = 0;
    m_VideoBlocks[iBufferIndex].uVideoBlockIndex = 0;
    m_VideoBlocks[iBufferIndex].uReceivedTime = 0;
+   m_VideoBlocks[iBufferIndex].uTraceFirstRxMicros = 0;
    m_VideoBlocks[iBufferIndex].iTotalFramePackets = 0;
    m_VideoBlocks[iBufferIndex].iFramePacketStart = -1;
    m_VideoBlocks[iBufferIndex].iFramePacketEnd = -1;
@@ -171,10 +195,7 @@ void VideoRxPacketsBuffer::_empty_block_buffer_index(int iBufferIndex)
    m_VideoBlocks[iBufferIndex].iRecvDataPackets = 0;
    m_VideoBlocks[iBufferIndex].iRecvECPackets = 0;
    m_VideoBlocks[iBufferIndex].iReconstructedECUsed = 0;
-   for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
-   {
-      _empty_block_buffer_packet_index(iBufferIndex, k);
-   }
+   m_VideoBlocks[iBufferIndex].uECJobId = 0;
 }
 
 void VideoRxPacketsBuffer::_empty_buffers(const char* szReason, t_packet_header* pPH, t_packet_header_video_segment* pPHVS)
@@ -239,6 +260,9 @@ void VideoRxPacketsBuffer::_check_do_ec_for_video_block(int iBufferIndex)
    if ( m_VideoBlocks[iBufferIndex].iRecvDataPackets + m_VideoBlocks[iBufferIndex].iRecvECPackets < m_VideoBlocks[iBufferIndex].iBlockDataPackets )
       return;
 
+   if ( 0 != m_VideoBlocks[iBufferIndex].uECJobId )
+      return;
+
    m_VideoBlocks[iBufferIndex].iReconstructedECUsed = m_VideoBlocks[iBufferIndex].iBlockDataPackets - m_VideoBlocks[iBufferIndex].iRecvDataPackets;
 
    int iPacketIndexGood = -1;
@@ -246,46 +270,136 @@ void VideoRxPacketsBuffer::_check_do_ec_for_video_block(int iBufferIndex)
    // Add existing data packets, mark and count the ones that are missing
    // Find a good PH, PHVS and video-debug-info (if any) in the block to reuse it in reconstruction
 
+   // Received data packets: set the space after the video data to 0 as EC uses it too.
+   // Missing data packets: the decoded data is written in their buffers, they must not be shared.
+   int iMaxBlockDataSize = PACKET_POOL_DATA_SIZE - (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   int iBlockDataSize = m_VideoBlocks[iBufferIndex].iBlockDataSize;
+   if ( iBlockDataSize > iMaxBlockDataSize )
+      iBlockDataSize = iMaxBlockDataSize;
+
    m_ECRxInfo.missing_packets_count = 0;
    for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockDataPackets; i++ )
    {
-      m_ECRxInfo.p_decode_data_packets_pointers[i] = m_VideoBlocks[iBufferIndex].packets[i].pVideoData;
-
-      if ( m_VideoBlocks[iBufferIndex].packets[i].bEmpty )
+      if ( ! (m_VideoBlocks[iBufferIndex].uReceivedMask & VIDEO_RX_PACKET_BIT(i)) )
       {
+         if ( packet_pool_get_ref_count(m_VideoBlocks[iBufferIndex].packets[i].pRawData) > 1 )
+         {
+            u8* pRawData = packet_pool_alloc();
+            if ( NULL == pRawData )
+               return;
+            _set_packet_buffer(iBufferIndex, i, pRawData);
+         }
          m_ECRxInfo.decode_missing_packets_indexes[m_ECRxInfo.missing_packets_count] = i;
          m_ECRxInfo.missing_packets_count++;
       }
-      else if ( -1 == iPacketIndexGood )
-         iPacketIndexGood = i;
+      else
+      {
+         int iVideoEnd = (int)sizeof(t_packet_header_video_segment_important) + m_VideoBlocks[iBufferIndex].packets[i].pPHVSImp->uVideoDataLength;
+         if ( iVideoEnd < iBlockDataSize )
+         {
+            memset(m_VideoBlocks[iBufferIndex].packets[i].pVideoData + iVideoEnd, 0, iBlockDataSize - iVideoEnd);
+            packet_pool_count_zeroed(iBlockDataSize - iVideoEnd);
+         }
+         if ( -1 == iPacketIndexGood )
+            iPacketIndexGood = i;
+      }
+      m_ECRxInfo.p_decode_data_packets_pointers[i] = m_VideoBlocks[iBufferIndex].packets[i].pVideoData;
    }
 
    // Add the needed FEC packets to the list
    int pos = 0;
    int iECDelta = m_VideoBlocks[iBufferIndex].iBlockDataPackets;
-   for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockECPackets; i++ )
+   u32 uECReceived = (m_VideoBlocks[iBufferIndex].uReceivedMask >> iECDelta) & VIDEO_RX_PACKETS_MASK(m_VideoBlocks[iBufferIndex].iBlockECPackets);
+   while ( (0 != uECReceived) && (pos < (int)(m_ECRxInfo.missing_packets_count)) )
    {
-      if ( ! m_VideoBlocks[iBufferIndex].packets[i+iECDelta].bEmpty )
-      {
-         if ( -1 == iPacketIndexGood )
-            iPacketIndexGood = i+iECDelta;
-
-         m_ECRxInfo.p_decode_ec_packets_pointers[pos] = m_VideoBlocks[iBufferIndex].packets[i+iECDelta].pVideoData;
-         m_ECRxInfo.decode_ec_packets_indexes[pos] = i;
-         pos++;
-         if ( pos == (int)(m_ECRxInfo.missing_packets_count) )
-            break;
-      }
+      int i = __builtin_ctz(uECReceived);
+      uECReceived &= uECReceived - 1;
+      if ( -1 == iPacketIndexGood )
+         iPacketIndexGood = i+iECDelta;
+
+      m_ECRxInfo.p_decode_ec_packets_pointers[pos] = m_VideoBlocks[iBufferIndex].packets[i+iECDelta].pVideoData;
+      m_ECRxInfo.decode_ec_packets_indexes[pos] = i;
+      pos++;
    }
 
    if ( -1 == iPacketIndexGood )
       return;
 
+   if ( _submit_ec_for_video_block(iBufferIndex) )
+      return;
+
+   int iRes = fec_decode(m_VideoBlocks[iBufferIndex].iBlockDataSize, m_ECRxInfo.p_decode_data_packets_pointers, m_VideoBlocks[iBufferIndex].iBlockDataPackets, m_ECRxInfo.p_decode_ec_packets_pointers, m_ECRxInfo.decode_ec_packets_indexes, m_ECRxInfo.decode_missing_packets_indexes, m_ECRxInfo.missing_packets_count);
+   _finish_ec_for_video_block(iBufferIndex, m_ECRxInfo.decode_missing_packets_indexes, (int)m_ECRxInfo.missing_packets_count, iRes, m_uTraceRxTimeMicros);
+}
+
+// Decoding is done by a FEC worker thread, if one has room for it. The job keeps a reference to the block
+// packets buffers, so they are not reused while it runs, even if the block is discarded meanwhile.
+bool VideoRxPacketsBuffer::_submit_ec_for_video_block(int iBufferIndex)
+{
+   type_fec_worker_job* pJob = fec_worker_get_free_job();
+   if ( NULL == pJob )
+      return false;
+
+   pJob->uBlockSize = m_VideoBlocks[iBufferIndex].iBlockDataSize;
+   pJob->uDataPackets = m_VideoBlocks[iBufferIndex].iBlockDataPackets;
+   pJob->uMissingCount = m_ECRxInfo.missing_packets_count;
+   for( int i=0; i<m_VideoBlocks[iBufferIndex].iBlockDataPackets; i++ )
+   {
+      pJob->pDataPointers[i] = m_ECRxInfo.p_decode_data_packets_pointers[i];
+      packet_pool_ref(m_VideoBlocks[iBufferIndex].packets[i].pRawData);
+      pJob->pPoolBuffers[pJob->iCountPoolBuffers] = m_VideoBlocks[iBufferIndex].packets[i].pRawData;
+      pJob->iCountPoolBuffers++;
+   }
+   for( int i=0; i<(int)m_ECRxInfo.missing_packets_count; i++ )
+   {
+      int iECPacketIndex = m_VideoBlocks[iBufferIndex].iBlockDataPackets + (int)m_ECRxInfo.decode_ec_packets_indexes[i];
+      pJob->pECPointers[i] = m_ECRxInfo.p_decode_ec_packets_pointers[i];
+      pJob->uECIndexes[i] = m_ECRxInfo.decode_ec_packets_indexes[i];
+      pJob->uMissingIndexes[i] = m_ECRxInfo.decode_missing_packets_indexes[i];
+      packet_pool_ref(m_VideoBlocks[iBufferIndex].packets[iECPacketIndex].pRawData);
+      pJob->pPoolBuffers[pJob->iCountPoolBuffers] = m_VideoBlocks[iBufferIndex].packets[iECPacketIndex].pRawData;
+      pJob->iCountPoolBuffers++;
+   }
+
+   m_uLastECJobId++;
+   if ( 0 == m_uLastECJobId )
+      m_uLastECJobId++;
+   m_VideoBlocks[iBufferIndex].uECJobId = m_uLastECJobId;
+
+   pJob->pCallback = &VideoRxPacketsBuffer::_on_fec_worker_job_done;
+   pJob->pContext = this;
+   pJob->uContextId = m_uLastECJobId;
+   pJob->iContextIndex = iBufferIndex;
+   pJob->uContextTimeMicros = m_uTraceRxTimeMicros;
+   fec_worker_submit_job(pJob);
+   return true;
+}
+
+void VideoRxPacketsBuffer::_on_fec_worker_job_done(type_fec_worker_job* pJob)
+{
+   VideoRxPacketsBuffer* pThis = (VideoRxPacketsBuffer*)pJob->pContext;
+   int iBufferIndex = pJob->iContextIndex;
+
+   // Block was emptied (discarded or buffers reset) while it was decoded
+   if ( pThis->m_VideoBlocks[iBufferIndex].uECJobId != pJob->uContextId )
+      return;
+   pThis->m_VideoBlocks[iBufferIndex].uECJobId = 0;
+   pThis->_finish_ec_for_video_block(iBufferIndex, pJob->uMissingIndexes, (int)pJob->uMissingCount, pJob->iResult, pJob->uContextTimeMicros);
+   pThis->_trace_check_block_complete(iBufferIndex);
+}
+
+void VideoRxPacketsBuffer::_finish_ec_for_video_block(int iBufferIndex, unsigned int* puMissingIndexes, int iMissingCount, int iResult, u64 uTraceRxMicros)
+{
+   // Same good packet as used by the decoding: first received data packet, or first received EC packet
+   u32 uReceived = m_VideoBlocks[iBufferIndex].uReceivedMask & VIDEO_RX_PACKETS_MASK(m_VideoBlocks[iBufferIndex].iBlockDataPackets + m_VideoBlocks[iBufferIndex].iBlockECPackets);
+   if ( 0 == uReceived )
+      return;
+   int iPacketIndexGood = __builtin_ctz(uReceived);
+
    t_packet_header* pPHGood = m_VideoBlocks[iBufferIndex].packets[iPacketIndexGood].pPH;
    t_packet_header_video_segment* pPHVSGood = m_VideoBlocks[iBufferIndex].packets[iPacketIndexGood].pPHVS;
 
-   int iRes = fec_decode(m_VideoBlocks[iBufferIndex].iBlockDataSize, m_ECRxInfo.p_decode_data_packets_pointers, m_VideoBlocks[iBufferIndex].iBlockDataPackets, m_ECRxInfo.p_decode_ec_packets_pointers, m_ECRxInfo.decode_ec_packets_indexes, m_ECRxInfo.decode_missing_packets_indexes, m_ECRxInfo.missing_packets_count);
-   if ( iRes < 0 )
+   if ( iResult < 0 )
    {
       log_softerror_and_alarm("[VideoRXBuffer] Failed to decode video block [%u], type %d/%d/%d bytes; max data recv index: %d, max data/ec received index: %d, recv: %d/%d packets, missing count: %d",
         m_VideoBlocks[iBufferIndex].uVideoBlockIndex,
@@ -294,16 +408,17 @@ void VideoRxPacketsBuffer::_check_do_ec_for_video_block(int iBufferIndex)
         m_VideoBlocks[iBufferIndex].iMaxReceivedDataPacketIndex,
         m_VideoBlocks[iBufferIndex].iMaxReceivedDataOrECPacketIndex,
         m_VideoBlocks[iBufferIndex].iRecvDataPackets, m_VideoBlocks[iBufferIndex].iRecvECPackets,
-        m_ECRxInfo.missing_packets_count);
+        iMissingCount);
    }
 
    // Mark all data packets reconstructed as received, set the right info in them (packet header info and video packet header info)
-   for( int i=0; i<(int)(m_ECRxInfo.missing_packets_count); i++ )
+   for( int i=0; i<iMissingCount; i++ )
    {
-      int iPacketIndexToFix = m_ECRxInfo.decode_missing_packets_indexes[i];
-      m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].bEmpty = false;
-      m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].bReconstructed = true;
+      int iPacketIndexToFix = puMissingIndexes[i];
+      m_VideoBlocks[iBufferIndex].uReceivedMask |= VIDEO_RX_PACKET_BIT(iPacketIndexToFix);
+      m_VideoBlocks[iBufferIndex].uReconstructedMask |= VIDEO_RX_PACKET_BIT(iPacketIndexToFix);
       m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].uReceivedTime = g_TimeNow;
+      m_VideoBlocks[iBufferIndex].packets[iPacketIndexToFix].uTraceRxMicros = uTraceRxMicros;
       m_VideoBlocks[iBufferIndex].iRecvDataPackets++;
       if ( iPacketIndexToFix > m_VideoBlocks[iBufferIndex].iMaxReceivedDataPacketIndex )
          m_VideoBlocks[iBufferIndex].iMaxReceivedDataPacketIndex = iPacketIndexToFix;
@@ -348,10 +463,14 @@ bool VideoRxPacketsBuffer::_add_video_packet_to_buffer(int iBufferIndex, u8* pPa
 
    t_packet_header* pPH = (t_packet_header*)pPacket;
    t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(pPacket + sizeof(t_packet_header));
-   t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(pPacket + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
 
-   if ( NULL != m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pRawData )
-   if ( ! m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].bEmpty )
+   if ( pPHVS->uCurrentBlockPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK )
+      return false;
+   if ( m_VideoBlocks[iBufferIndex].uReceivedMask & VIDEO_RX_PACKET_BIT(pPHVS->uCurrentBlockPacketIndex) )
+      return false;
+
+   // Block is EC decoded by a FEC worker: it will have all its data packets
+   if ( 0 != m_VideoBlocks[iBufferIndex].uECJobId )
       return false;
 
    // Set basic video block size info before check allocate block in buffer as it needs block info about packets
@@ -403,12 +522,27 @@ bool VideoRxPacketsBuffer::_add_video_packet_to_buffer(int iBufferIndex, u8* pPa
    if ( ! _check_allocate_video_block_in_buffer(iBufferIndex) )
       return false;
 
+   // Keep a reference to the received packet if it's a whole pool buffer, copy it otherwise.
+   // Not in a buffer still used by a FEC worker job (of a block discarded meanwhile).
+   u8* pPoolBuffer = packet_pool_get_handoff_buffer(pPacket, iPacketLength);
+   bool bHandoff = (NULL != pPoolBuffer);
+   if ( bHandoff )
+      packet_pool_ref(pPoolBuffer);
+   else if ( packet_pool_get_ref_count(m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pRawData) > 1 )
+   {
+      pPoolBuffer = packet_pool_alloc();
+      if ( NULL == pPoolBuffer )
+         return false;
+   }
+
    if ( m_bBuffersEmpty )
       log_line("[VRXBuffers] Start adding video packets to empty buffer. Adding [%u/%u] at buffer index %d",
          pPHVS->uCurrentBlockIndex, pPHVS->uCurrentBlockPacketIndex, m_iTopBufferIndex);
    m_bBuffersEmpty = false;
    
    m_VideoBlocks[iBufferIndex].uReceivedTime = g_TimeNow;
+   if ( 0 == m_VideoBlocks[iBufferIndex].iRecvDataPackets + m_VideoBlocks[iBufferIndex].iRecvECPackets )
+      m_VideoBlocks[iBufferIndex].uTraceFirstRxMicros = m_uTraceRxTimeMicros;
 
    if ( pPHVS->uCurrentBlockPacketIndex < pPHVS->uCurrentBlockDataPackets )
    {
@@ -426,25 +560,33 @@ bool VideoRxPacketsBuffer::_add_video_packet_to_buffer(int iBufferIndex, u8* pPa
    }
 
    m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].uReceivedTime = g_TimeNow;
-   m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].bEmpty = false;
-   m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].bReconstructed = false;
+   m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].uTraceRxMicros = m_uTraceRxTimeMicros;
+   m_VideoBlocks[iBufferIndex].uReceivedMask |= VIDEO_RX_PACKET_BIT(pPHVS->uCurrentBlockPacketIndex);
+   m_VideoBlocks[iBufferIndex].uReconstructedMask &= ~VIDEO_RX_PACKET_BIT(pPHVS->uCurrentBlockPacketIndex);
    
-   memcpy(m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pRawData, pPacket, iPacketLength);
-   
-   // Set remaining empty space to 0 as EC uses the good video data packets too.
-   if ( pPHVS->uCurrentBlockPacketIndex < pPHVS->uCurrentBlockDataPackets )
+   if ( NULL != pPoolBuffer )
+      _set_packet_buffer(iBufferIndex, pPHVS->uCurrentBlockPacketIndex, pPoolBuffer);
+   if ( ! bHandoff )
    {
-      u8* pVideoSource = m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pVideoData;
-      pVideoSource += sizeof(t_packet_header_video_segment_important);
-      pVideoSource += pPHVSImp->uVideoDataLength;
-      int iSizeToZero = MAX_PACKET_TOTAL_SIZE - sizeof(t_packet_header) - sizeof(t_packet_header_video_segment) - sizeof(t_packet_header_video_segment_important) - pPHVSImp->uVideoDataLength;
-      if ( iSizeToZero > 0 )
-         memset(pVideoSource, 0, iSizeToZero);
+      memcpy(m_VideoBlocks[iBufferIndex].packets[pPHVS->uCurrentBlockPacketIndex].pRawData, pPacket, iPacketLength);
+      packet_pool_count_copy(iPacketLength);
    }
    _check_do_ec_for_video_block(iBufferIndex);
+   _trace_check_block_complete(iBufferIndex);
    return true;
 }
 
+// Block complete stage: from the first packet of the block received to all the block data packets available (received or reconstructed)
+void VideoRxPacketsBuffer::_trace_check_block_complete(int iBufferIndex)
+{
+   if ( 0 == m_VideoBlocks[iBufferIndex].uTraceFirstRxMicros )
+      return;
+   if ( (m_VideoBlocks[iBufferIndex].iBlockDataPackets <= 0) || (m_VideoBlocks[iBufferIndex].iRecvDataPackets < m_VideoBlocks[iBufferIndex].iBlockDataPackets) )
+      return;
+   latency_trace_add_since(LATENCY_TRACE_STAGE_BLOCK_COMPLETE, m_VideoBlocks[iBufferIndex].uTraceFirstRxMicros);
+   m_VideoBlocks[iBufferIndex].uTraceFirstRxMicros = 0;
+}
+
 bool VideoRxPacketsBuffer::hasVideoPacket(u32 uVideoBlockIndex, u32 uVideoBlockPacketIndex)
 {
    if ( m_bBuffersEmpty )
@@ -459,14 +601,21 @@ bool VideoRxPacketsBuffer::hasVideoPacket(u32 uVideoBlockIndex, u32 uVideoBlockP
    int iBufferIndex = m_iBottomBufferIndex + (int) uDiffBlocks;
    iBufferIndex = iBufferIndex % MAX_RXTX_BLOCKS_BUFFER;
 
-   if ( m_VideoBlocks[iBufferIndex].packets[uVideoBlockPacketIndex].bEmpty )
+   // Being EC decoded by a FEC worker
+   if ( 0 != m_VideoBlocks[iBufferIndex].uECJobId )
+      return true;
+
+   if ( uVideoBlockPacketIndex >= MAX_TOTAL_PACKETS_IN_BLOCK )
       return false;
-   return true;
+   if ( m_VideoBlocks[iBufferIndex].uReceivedMask & VIDEO_RX_PACKET_BIT(uVideoBlockPacketIndex) )
+      return true;
+   return false;
 }
 
 // Returns true if the packet was added
-bool VideoRxPacketsBuffer::checkAddVideoPacket(u8* pPacket, int iPacketLength)
+bool VideoRxPacketsBuffer::checkAddVideoPacket(u8* pPacket, int iPacketLength, u64 uTraceRxTimeMicros)
 {
+   m_uTraceRxTimeMicros = uTraceRxTimeMicros;
    if ( (NULL == pPacket) || (iPacketLength <= (int)(sizeof(t_packet_header)+sizeof(t_packet_header_video_segment) + sizeof(t_packet_header_video_segment_important))) )
       return false;
 
@@ -601,6 +750,8 @@ type_rx_video_packet_info* VideoRxPacketsBuffer::getBottomBlockAndPacketInBuffer
    if ( NULL != ppOutputBlock )
       *ppOutputBlock = &(m_VideoBlocks[m_iBottomBufferIndex]);
 
+   if ( ! (m_VideoBlocks[m_iBottomBufferIndex].uReceivedMask & VIDEO_RX_PACKET_BIT(m_iBottomBufferPacketIndex)) )
+      return NULL;
    return &(m_VideoBlocks[m_iBottomBufferIndex].packets[m_iBottomBufferPacketIndex]);
 }
 
@@ -617,6 +768,9 @@ int VideoRxPacketsBuffer::discardOldBlocks(u32 uCutOffTime)
       if ( (m_VideoBlocks[m_iBottomBufferIndex].uReceivedTime > uCutOffTime) ||
            (m_VideoBlocks[m_iBottomBufferIndex].uReceivedTime == 0) )
          break;
+      // Complete as soon as its EC decoding is collected
+      if ( 0 != m_VideoBlocks[m_iBottomBufferIndex].uECJobId )
+         break;
       
       if ( iCountDiscarded < 3 )
          log_line("[VideoRXBuffer] Discard bottom buffer index: %d, video block id [f%d blk %u], fr has %d packets, blk has fr pkt %d to %d (recv time: %u ms ago, recv data/ec pckts: %d,%d, scheme: %d/%d), top buffer index: %d, video block id %u, max recv pckt index: %d",
@@ -648,6 +802,9 @@ bool VideoRxPacketsBuffer::discardBottomBlockIfIncomplete()
       return false;
    if ( m_VideoBlocks[m_iBottomBufferIndex].uVideoBlockIndex >= m_VideoBlocks[m_iTopBufferIndex].uVideoBlockIndex )
       return false;
+   // Complete as soon as its EC decoding is collected
+   if ( 0 != m_VideoBlocks[m_iBottomBufferIndex].uECJobId )
+      return false;
 
    if ( (m_VideoBlocks[m_iBottomBufferIndex].iBlockDataPackets == 0) ||
         (m_VideoBlocks[m_iBottomBufferIndex].iRecvDataPackets < m_VideoBlocks[m_iBottomBufferIndex].iBlockDataPackets) )
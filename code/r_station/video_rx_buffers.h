@@ -3,7 +3,9 @@
 #include "../base/base.h"
 #include "../base/config.h"
 #include "../base/models.h"
+#include "../base/packet_pool.h"
 #include "../radio/radiopackets2.h"
+#include "../radio/fec_worker.h"
 
 
 //  [packet header][video segment header][video seg header important][video data][000]
@@ -11,39 +13,66 @@
 //  | pRawData ptr                       | pVideoData ptr
 //                                       [    <- video block packet size ->          ]
 //                                                                   [-vid size-]
+// pRawData is a packet pool buffer: a received packet that is a whole pool buffer (i.e. borrowed from the
+// radio rx queue) is kept by reference instead of being copied. The [000] padding used by the EC decoding
+// is zeroed only when a block is decoded.
+// When the FEC workers are running, the EC decoding of a block is done by a worker thread: the block
+// doesn't take more packets until the decoded block is collected (fec_worker_process_completed).
+//
+// The state of the packets in a block (received, reconstructed, requested) is kept as bitmasks (bit n is
+// the block packet index n, data packets then EC packets), so the missing packets scans and the completeness
+// checks don't touch the packets info and emptying a block doesn't loop over its packets. The receive times
+// of a packet (type_rx_video_packet_info) are only valid if it has its bit set in uReceivedMask.
+
+#if MAX_TOTAL_PACKETS_IN_BLOCK > 32
+#error "Video rx blocks packets state bitmasks are 32 bits"
+#endif
+
+#define VIDEO_RX_PACKET_BIT(iPacketIndex) (((u32)1) << (iPacketIndex))
+// Bits of the first iCount packets of a block
+#define VIDEO_RX_PACKETS_MASK(iCount) (((iCount) >= 32)?0xFFFFFFFF:(VIDEO_RX_PACKET_BIT(iCount)-1))
 
 typedef struct
 {
-   u8* pRawData;
+   u8* pRawData; // packet pool buffer
    u8* pVideoData; // pointer inside pRawData
    t_packet_header* pPH; // pointer inside pRawData
    t_packet_header_video_segment* pPHVS; // pointer inside pRawData
    t_packet_header_video_segment_important* pPHVSImp; // pointer inside pRawData
    u32 uReceivedTime;
-   u32 uRequestedTime; // non zero if it was requested for retransmission
-   bool bEmpty;
-   bool bReconstructed;
+   u64 uTraceRxMicros; // latency trace: read by the radio rx thread (for reconstructed packets: the packet that completed the block)
 }
 type_rx_video_packet_info;
 
 typedef struct
 {
-   type_rx_video_packet_info packets[MAX_TOTAL_PACKETS_IN_BLOCK];
-   u16 uH264FrameIndex;
+   // Packets state, one bit for each packet index in the block
+   u32 uReceivedMask; // received or reconstructed
+   u32 uReconstructedMask;
+   u32 uRequestedMask; // requested for retransmission at least once
+   u32 uAllocatedMask; // has a packet buffer (kept when the block is emptied)
+   // Used by the scans, in the same cache line as the packets state
    u32 uVideoBlockIndex;
+   int iBlockDataPackets;
+   int iBlockECPackets;
+   int iRecvDataPackets;
+   int iRecvECPackets;
+   int iMaxReceivedDataOrECPacketIndex;
+   u32 uReceivedTime;
+   u32 uECJobId; // non zero while the block is EC decoded by a FEC worker
+
+   u16 uH264FrameIndex;
    int iTotalFramePackets;
    int iFramePacketStart;
    int iFramePacketEnd;
    int iMaxReceivedDataPacketIndex;
-   int iMaxReceivedDataOrECPacketIndex;
    int iLastRecordedEOF;
-   u32 uReceivedTime;
+   u64 uTraceFirstRxMicros; // latency trace: first packet of the block read by the radio rx thread
    int iBlockDataSize;
-   int iBlockDataPackets;
-   int iBlockECPackets;
-   int iRecvDataPackets;
-   int iRecvECPackets;
    int iReconstructedECUsed;
+
+   u32 uPacketsRequestedTime[MAX_TOTAL_PACKETS_IN_BLOCK]; // last request time, valid if set in uRequestedMask
+   type_rx_video_packet_info packets[MAX_TOTAL_PACKETS_IN_BLOCK];
 }
 type_rx_video_block_info;
 
@@ -68,8 +97,10 @@ class VideoRxPacketsBuffer
       void emptyBuffers(const char* szReason);
       
       bool hasVideoPacket(u32 uVideoBlockIndex, u32 uVideoBlockPacketIndex);
-      // Returns true if the packet was added
-      bool checkAddVideoPacket(u8* pPacket, int iPacketLength);
+      // Returns true if the packet was added. If pPacket is a whole packet pool buffer, it's kept by reference
+      // (it must not be modified afterwards), otherwise it's copied.
+      // uTraceRxTimeMicros: time the packet was read by the radio rx thread (latency trace clock), 0 if not traced
+      bool checkAddVideoPacket(u8* pPacket, int iPacketLength, u64 uTraceRxTimeMicros = 0);
 
       int getBufferBottomIndex();
       u32 getBufferBottomVideoBlockIndex();
@@ -80,6 +111,7 @@ class VideoRxPacketsBuffer
       int getCountBlocksInBuffer();
       type_rx_video_block_info* getTopBlockInBuffer();
       type_rx_video_block_info* getBlockInBufferFromBottom(int iDeltaPosition);
+      // Returns NULL if the bottom packet is not received (or reconstructed) yet
       type_rx_video_packet_info* getBottomBlockAndPacketInBuffer(type_rx_video_block_info** ppOutputBlock);
       int discardOldBlocks(u32 uCutOffTime);
       bool discardBottomBlockIfIncomplete();
@@ -88,10 +120,15 @@ class VideoRxPacketsBuffer
    protected:
 
       bool _check_allocate_video_block_in_buffer(int iBufferIndex);
+      void _set_packet_buffer(int iBufferIndex, int iPacketIndex, u8* pRawData);
       void _empty_block_buffer_packet_index(int iBufferIndex, int iPacketIndex);
       void _empty_block_buffer_index(int iBufferIndex);
       void _empty_buffers(const char* szReason, t_packet_header* pPH, t_packet_header_video_segment* pPHVS);
       void _check_do_ec_for_video_block(int iBufferIndex);
+      bool _submit_ec_for_video_block(int iBufferIndex);
+      void _finish_ec_for_video_block(int iBufferIndex, unsigned int* puMissingIndexes, int iMissingCount, int iResult, u64 uTraceRxMicros);
+      static void _on_fec_worker_job_done(type_fec_worker_job* pJob);
+      void _trace_check_block_complete(int iBufferIndex);
       bool _add_video_packet_to_buffer(int iBufferIndex, u8* pPacket, int iPacketLength);
 
       static int m_siVideoBuffersInstancesCount;
@@ -107,6 +144,8 @@ class VideoRxPacketsBuffer
       int m_iTopBufferIndex;
       int m_iBottomBufferIndex;
       int m_iBottomBufferPacketIndex;
+      u64 m_uTraceRxTimeMicros; // of the packet being added
+      u32 m_uLastECJobId;
 
       type_fec_info m_ECRxInfo;
 };
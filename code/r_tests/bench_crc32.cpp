@@ -0,0 +1,139 @@
+#include "../base/base.h"
+#include "../base/crc32.h"
+
+// CRC32 engines benchmark. Checks that every engine supported on this CPU returns
+// the same results as the reference table engine (random lengths and alignments),
+// then reports the throughput for typical radio packet sizes.
+//
+// Usage: bench_crc32 [-engine table|slice8|armv8|pclmul] [-mb N]
+
+#define BENCH_MAX_SIZE 4096
+#define VERIFY_ITERATIONS 20000
+
+static u8 s_Data[BENCH_MAX_SIZE + 64];
+static int s_iPacketSizes[] = { 64, 128, 256, 512, 1024, 1400, 1500 };
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+// Returns the number of mismatches against the reference engine
+static int _verify_engine(int iEngine)
+{
+   int iFailures = 0;
+   for( int i=0; i<VERIFY_ITERATIONS; i++ )
+   {
+      int iOffset = rand() % 16;
+      int iLength = rand() % BENCH_MAX_SIZE;
+      if ( i < 300 )
+         iLength = i;
+
+      crc32_set_engine(CRC32_ENGINE_TABLE);
+      u32 uRef = crc32_compute(s_Data + iOffset, iLength);
+      crc32_set_engine(iEngine);
+      u32 uCrc = crc32_compute(s_Data + iOffset, iLength);
+      if ( uCrc != uRef )
+      {
+         if ( iFailures < 10 )
+            printf("Engine %s: mismatch for length %d, offset %d: %08X, expected %08X\n", crc32_get_engine_name(iEngine), iLength, iOffset, uCrc, uRef);
+         iFailures++;
+      }
+   }
+   return iFailures;
+}
+
+int main(int argc, char *argv[])
+{
+   const char* szEngine = NULL;
+   int iMBPerTest = 64;
+
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-engine")) && (i < argc-1) )
+         szEngine = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-mb")) && (i < argc-1) )
+         iMBPerTest = atoi(argv[++i]);
+      else
+      {
+         printf("Usage: %s [-engine table|slice8|armv8|pclmul] [-mb N]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iMBPerTest < 1 )
+      iMBPerTest = 1;
+
+   srand(1234);
+   for( int i=0; i<(int)sizeof(s_Data); i++ )
+      s_Data[i] = rand() & 0xFF;
+
+   crc32_init();
+   int iDefaultEngine = crc32_get_engine();
+   printf("\nCRC32 benchmark, default engine: %s, %d MB per test\n", crc32_get_engine_name(iDefaultEngine), iMBPerTest);
+
+   // The standard check value for "123456789"
+   if ( crc32_compute((const u8*)"123456789", 9) != 0xCBF43926 )
+   {
+      printf("Invalid CRC32 check value.\n");
+      return 1;
+   }
+
+   int iFailures = 0;
+   bool bFoundEngine = false;
+   printf("%-8s", "engine");
+   for( size_t s=0; s<sizeof(s_iPacketSizes)/sizeof(s_iPacketSizes[0]); s++ )
+      printf(" %7d B", s_iPacketSizes[s]);
+   printf("   (GB/s)\n");
+
+   for( int iEngine=0; iEngine<CRC32_ENGINE_COUNT; iEngine++ )
+   {
+      if ( (NULL != szEngine) && (0 != strcmp(szEngine, crc32_get_engine_name(iEngine))) )
+         continue;
+      bFoundEngine = true;
+      if ( ! crc32_is_engine_supported(iEngine) )
+      {
+         printf("%-8s not supported on this CPU.\n", crc32_get_engine_name(iEngine));
+         continue;
+      }
+
+      int iEngineFailures = _verify_engine(iEngine);
+      iFailures += iEngineFailures;
+      crc32_set_engine(iEngine);
+
+      printf("%-8s", crc32_get_engine_name(iEngine));
+      for( size_t s=0; s<sizeof(s_iPacketSizes)/sizeof(s_iPacketSizes[0]); s++ )
+      {
+         int iSize = s_iPacketSizes[s];
+         int iIterations = (int)(((u64)iMBPerTest * 1024 * 1024) / (u64)iSize);
+         u32 uAccumulator = 0;
+         u64 uStart = _bench_time_ns();
+         for( int i=0; i<iIterations; i++ )
+            uAccumulator ^= crc32_compute(s_Data + (i & 7), iSize);
+         u64 uDelta = _bench_time_ns() - uStart;
+         double fGBs = 0.0;
+         if ( uDelta > 0 )
+            fGBs = ((double)iIterations * (double)iSize) / (double)uDelta;
+         printf(" %9.3f", fGBs);
+         if ( uAccumulator == 0x5A5A5A5A )
+            printf(" ");
+      }
+      printf("%s\n", (iEngineFailures > 0)?"   MISMATCH":"");
+   }
+
+   crc32_set_engine(iDefaultEngine);
+
+   if ( ! bFoundEngine )
+   {
+      printf("Unknown CRC32 engine: %s\n", szEngine);
+      return 1;
+   }
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d mismatches.\n", iFailures);
+      return 1;
+   }
+   printf("All engines match the reference.\n");
+   return 0;
+}
@@ -0,0 +1,117 @@
+#include "../base/base.h"
+#include "../base/hardware_radio.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/radio_duplicate_det.h"
+
+// Radio rx duplicate detection throughput: 6 vehicles x 8 streams, packets interleaved across the
+// vehicles and streams, each packet received twice (two radio interfaces) with the second copy a few
+// packets later, as the radio rx thread sees them. Reports packets/second and ns/packet.
+//
+// Usage: bench_dup_detection [-packets N] [-o output.json]
+
+extern u32 s_uRadioRxTimeNow;
+
+#define BENCH_VEHICLES 6
+#define BENCH_STREAMS 8
+#define BENCH_COPY_DELAY 16
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+   int iPackets = 4000000;
+   const char* szOutputFile = NULL;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-packets")) && (i < argc-1) )
+         iPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-packets N] [-o output.json]\n", argv[0]);
+         return 1;
+      }
+   }
+   if ( iPackets < 10000 )
+      iPackets = 10000;
+
+   log_disable();
+   hardware_radio_set_simulated_interfaces(2);
+   radio_duplicate_detection_init();
+   s_uRadioRxTimeNow = 100000;
+
+   // Pre built packet headers: original and delayed copy for each packet
+   int iTotal = iPackets * 2;
+   t_packet_header* pHeaders = (t_packet_header*)malloc(iTotal * sizeof(t_packet_header));
+   if ( NULL == pHeaders )
+      return 1;
+   u32 uStreamCounters[BENCH_VEHICLES][BENCH_STREAMS];
+   memset(uStreamCounters, 0, sizeof(uStreamCounters));
+   u32 uRandom = 0x9E3779B9;
+   for( int i=0; i<iPackets; i++ )
+   {
+      uRandom ^= uRandom << 13;
+      uRandom ^= uRandom >> 17;
+      uRandom ^= uRandom << 5;
+      int iVehicle = (int)(uRandom % BENCH_VEHICLES);
+      int iStream = (int)((uRandom >> 8) % BENCH_STREAMS);
+      t_packet_header* pPH = &pHeaders[i];
+      radio_packet_init(pPH, PACKET_COMPONENT_VIDEO, PACKET_TYPE_VIDEO_DATA, (u32)iStream);
+      pPH->vehicle_id_src = 1000 + iVehicle;
+      pPH->stream_packet_idx |= (uStreamCounters[iVehicle][iStream]++) & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+   }
+   // Copies: same order, BENCH_COPY_DELAY packets later, merged in the output order below
+   int* pOrder = (int*)malloc(iTotal * sizeof(int));
+   if ( NULL == pOrder )
+      return 1;
+   int iPos = 0;
+   for( int i=0; i<iPackets + BENCH_COPY_DELAY; i++ )
+   {
+      if ( i < iPackets )
+         pOrder[iPos++] = i;
+      if ( i >= BENCH_COPY_DELAY )
+         pOrder[iPos++] = i - BENCH_COPY_DELAY;
+   }
+
+   printf("\nDuplicate detection benchmark: %d vehicles x %d streams, %d packets, each received twice\n", BENCH_VEHICLES, BENCH_STREAMS, iPackets);
+
+   u32 uDuplicates = 0;
+   u64 uStart = _bench_time_ns();
+   for( int i=0; i<iTotal; i++ )
+   {
+      t_packet_header* pPH = &pHeaders[pOrder[i]];
+      if ( (i & 0x3FF) == 0 )
+         s_uRadioRxTimeNow++;
+      uDuplicates += (u32)radio_dup_detection_is_duplicate_on_stream(i & 1, (u8*)pPH, sizeof(t_packet_header), s_uRadioRxTimeNow);
+   }
+   u64 uElapsed = _bench_time_ns() - uStart;
+
+   double fNsPerPacket = (double)uElapsed / (double)iTotal;
+   double fPacketsPerSec = 1000000000.0 / fNsPerPacket;
+   printf("duplicates detected    : %u of %d (%s)\n", uDuplicates, iPackets, (uDuplicates == (u32)iPackets)?"ok":"WRONG");
+   printf("per packet             : %9.1f ns\n", fNsPerPacket);
+   printf("throughput             : %9.2f Mpackets/s\n", fPacketsPerSec/1000000.0);
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"dup_detection\",\n  \"vehicles\": %d,\n  \"streams\": %d,\n  \"packets\": %d,\n", BENCH_VEHICLES, BENCH_STREAMS, iTotal);
+         fprintf(fd, "  \"ns_per_packet\": %.1f,\n  \"packets_per_sec\": %.0f\n}\n", fNsPerPacket, fPacketsPerSec);
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+   free(pHeaders);
+   free(pOrder);
+   return (uDuplicates == (u32)iPackets)?0:1;
+}
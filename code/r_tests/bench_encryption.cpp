@@ -0,0 +1,179 @@
+#include "../base/base.h"
+#include "../base/encr.h"
+#include "../base/chacha20_poly1305.h"
+#include "../radio/radiopackets2.h"
+
+// Radio packets encryption throughput: the legacy pass phrase xor (dpp) against ChaCha20-Poly1305
+// (encrypt and decrypt, header authenticated, payload encrypted in place) on each ChaCha20 engine,
+// for small, medium and full size video packets. Reports MB/s of packet data.
+//
+// Usage: bench_encryption [-mb N] [-o output.json]
+
+extern u8 s_epp[MAX_PASS_LENGTH+1];
+extern u8 s_eppl;
+
+#define BENCH_PACKETS 64
+#define BENCH_MAX_RESULTS 32
+
+typedef struct
+{
+   char szName[48];
+   int iPacketSize;
+   double fMBPerSec;
+} type_bench_result;
+
+static type_bench_result s_Results[BENCH_MAX_RESULTS];
+static int s_iCountResults = 0;
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static void _add_result(const char* szName, int iPacketSize, u64 uBytes, u64 uElapsedNs)
+{
+   double fMBPerSec = ((double)uBytes / (1024.0*1024.0)) / ((double)uElapsedNs / 1000000000.0);
+   printf("%-28s %5d bytes : %9.1f MB/s\n", szName, iPacketSize, fMBPerSec);
+   if ( s_iCountResults >= BENCH_MAX_RESULTS )
+      return;
+   strncpy(s_Results[s_iCountResults].szName, szName, sizeof(s_Results[s_iCountResults].szName)-1);
+   s_Results[s_iCountResults].szName[sizeof(s_Results[s_iCountResults].szName)-1] = 0;
+   s_Results[s_iCountResults].iPacketSize = iPacketSize;
+   s_Results[s_iCountResults].fMBPerSec = fMBPerSec;
+   s_iCountResults++;
+}
+
+int main(int argc, char *argv[])
+{
+   int iMegaBytes = 64;
+   const char* szOutputFile = NULL;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-mb")) && (i < argc-1) )
+         iMegaBytes = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-mb N] [-o output.json]\n", argv[0]);
+         return 1;
+      }
+   }
+   if ( iMegaBytes < 1 )
+      iMegaBytes = 1;
+
+   log_disable();
+   strcpy((char*)s_epp, "bench-pass-phrase-0123");
+   s_eppl = (u8)strlen((char*)s_epp);
+
+   u8 uKey[CHACHA20_KEY_SIZE];
+   for( int i=0; i<CHACHA20_KEY_SIZE; i++ )
+      uKey[i] = (u8)(i*29 + 7);
+
+   int iSizes[] = { 64, 256, MAX_PACKET_PAYLOAD };
+   int iHeader = sizeof(t_packet_header);
+   u8* pPackets = (u8*)malloc(BENCH_PACKETS * MAX_PACKET_TOTAL_SIZE);
+   if ( NULL == pPackets )
+      return 1;
+   for( int i=0; i<BENCH_PACKETS * MAX_PACKET_TOTAL_SIZE; i++ )
+      pPackets[i] = (u8)(i*13 + 5);
+
+   printf("\nEncryption benchmark: %d MB per test, %d packets ring, ChaCha20 engines:", iMegaBytes, BENCH_PACKETS);
+   for( int iEngine=0; iEngine<CHACHA20_ENGINE_COUNT; iEngine++ )
+      if ( chacha20_is_engine_supported(iEngine) )
+         printf(" %s", chacha20_get_engine_name(iEngine));
+   printf("\n");
+
+   int iFailures = 0;
+   for( int k=0; k<(int)(sizeof(iSizes)/sizeof(iSizes[0])); k++ )
+   {
+      int iPacketSize = iSizes[k];
+      int iDataSize = iPacketSize - iHeader;
+      int iIterations = (int)(((u64)iMegaBytes * 1024 * 1024) / (u64)iPacketSize);
+      for( int p=0; p<BENCH_PACKETS; p++ )
+      {
+         t_packet_header* pPH = (t_packet_header*)(pPackets + p*MAX_PACKET_TOTAL_SIZE);
+         pPH->total_length = (u16)iPacketSize;
+      }
+
+      u64 uStart = _bench_time_ns();
+      for( int i=0; i<iIterations; i++ )
+      {
+         u8* pPacket = pPackets + (i % BENCH_PACKETS)*MAX_PACKET_TOTAL_SIZE;
+         dpp(pPacket + iHeader, iDataSize);
+      }
+      _add_result("legacy xor (dpp)", iPacketSize, (u64)iIterations * iPacketSize, _bench_time_ns() - uStart);
+
+      for( int iEngine=0; iEngine<CHACHA20_ENGINE_COUNT; iEngine++ )
+      {
+         if ( ! chacha20_set_engine(iEngine) )
+            continue;
+         char szName[48];
+
+         uStart = _bench_time_ns();
+         for( int i=0; i<iIterations; i++ )
+         {
+            u8* pPacket = pPackets + (i % BENCH_PACKETS)*MAX_PACKET_TOTAL_SIZE;
+            t_packet_header* pPH = (t_packet_header*)pPacket;
+            pPH->stream_packet_idx = (u32)i;
+            u8 uNonce[CHACHA20_NONCE_SIZE];
+            memset(uNonce, 0, sizeof(uNonce));
+            memcpy(uNonce, &pPH->stream_packet_idx, sizeof(u32));
+            chacha20_poly1305_encrypt(uKey, uNonce, pPacket, iHeader, pPacket + iHeader, iDataSize, pPacket + iPacketSize);
+         }
+         snprintf(szName, sizeof(szName), "chacha20-poly1305 enc %s", chacha20_get_engine_name(iEngine));
+         _add_result(szName, iPacketSize, (u64)iIterations * iPacketSize, _bench_time_ns() - uStart);
+
+         // Decrypt: the ring is encrypted again (not timed) before each pass, so all packets are valid
+         u64 uElapsed = 0;
+         for( int iPass=0; iPass<iIterations; iPass += BENCH_PACKETS )
+         {
+            for( int p=0; p<BENCH_PACKETS; p++ )
+            {
+               u8* pPacket = pPackets + p*MAX_PACKET_TOTAL_SIZE;
+               u8 uNonce[CHACHA20_NONCE_SIZE];
+               memset(uNonce, 0, sizeof(uNonce));
+               memcpy(uNonce, &((t_packet_header*)pPacket)->stream_packet_idx, sizeof(u32));
+               chacha20_poly1305_encrypt(uKey, uNonce, pPacket, iHeader, pPacket + iHeader, iDataSize, pPacket + iPacketSize);
+            }
+            uStart = _bench_time_ns();
+            for( int p=0; p<BENCH_PACKETS; p++ )
+            {
+               u8* pPacket = pPackets + p*MAX_PACKET_TOTAL_SIZE;
+               u8 uNonce[CHACHA20_NONCE_SIZE];
+               memset(uNonce, 0, sizeof(uNonce));
+               memcpy(uNonce, &((t_packet_header*)pPacket)->stream_packet_idx, sizeof(u32));
+               if ( ! chacha20_poly1305_decrypt(uKey, uNonce, pPacket, iHeader, pPacket + iHeader, iDataSize, pPacket + iPacketSize) )
+                  iFailures++;
+            }
+            uElapsed += _bench_time_ns() - uStart;
+         }
+         snprintf(szName, sizeof(szName), "chacha20-poly1305 dec %s", chacha20_get_engine_name(iEngine));
+         _add_result(szName, iPacketSize, (u64)((iIterations + BENCH_PACKETS - 1)/BENCH_PACKETS) * BENCH_PACKETS * iPacketSize, uElapsed);
+      }
+   }
+   chacha20_init();
+   if ( iFailures > 0 )
+      printf("WRONG: %d packets failed authentication.\n", iFailures);
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"encryption\",\n  \"results\": [\n");
+         for( int i=0; i<s_iCountResults; i++ )
+            fprintf(fd, "    { \"name\": \"%s\", \"packet_size\": %d, \"mb_per_sec\": %.1f }%s\n",
+               s_Results[i].szName, s_Results[i].iPacketSize, s_Results[i].fMBPerSec, (i < s_iCountResults-1)?",":"");
+         fprintf(fd, "  ]\n}\n");
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+   free(pPackets);
+   return (0 == iFailures)?0:1;
+}
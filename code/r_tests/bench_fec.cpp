@@ -0,0 +1,265 @@
+#include "../base/base.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/fec.h"
+
+#include <algorithm>
+#include <vector>
+
+// FEC encode/decode throughput and latency benchmark.
+// Runs fec_encode/fec_decode over a matrix of data/EC packets counts,
+// payload sizes and erasure patterns and writes the results as JSON.
+//
+// Usage: bench_fec [-o output.json] [-kernel scalar|ssse3|avx2|neon] [-blocks N] [-quick]
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t nmemb, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static volatile u32 s_uAllocationsCount = 0;
+
+extern "C" void* malloc(size_t size)
+{
+   s_uAllocationsCount++;
+   return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t nmemb, size_t size)
+{
+   s_uAllocationsCount++;
+   return __libc_calloc(nmemb, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+   s_uAllocationsCount++;
+   return __libc_realloc(ptr, size);
+}
+
+#define ERASURE_NONE 0
+#define ERASURE_SINGLE 1
+#define ERASURE_RANDOM_HALF 2
+#define ERASURE_BURST_MAX 3
+#define ERASURE_PATTERNS_COUNT 4
+
+static const char* s_szErasureNames[ERASURE_PATTERNS_COUNT] = { "none", "single", "random_half", "burst_max" };
+
+typedef struct
+{
+   int iDataPackets;
+   int iECPackets;
+} type_bench_block_scheme;
+
+static type_bench_block_scheme s_Schemes[] = { {4,2}, {6,3}, {8,4}, {12,6}, {16,8}, {24,12}, {32,16} };
+static int s_iPayloadSizes[] = { 256, 700, 1024, MAX_PACKET_PAYLOAD, 1400 };
+
+#define BENCH_MAX_PACKETS 64
+#define BENCH_MAX_SIZE 1500
+
+static u8 s_Data[BENCH_MAX_PACKETS][BENCH_MAX_SIZE];
+static u8 s_Fec[BENCH_MAX_PACKETS][BENCH_MAX_SIZE];
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static double _percentile(std::vector<u64>& samples, double fPercent)
+{
+   if ( samples.empty() )
+      return 0.0;
+   size_t uIndex = (size_t)((fPercent/100.0) * (double)(samples.size()-1) + 0.5);
+   std::nth_element(samples.begin(), samples.begin() + uIndex, samples.end());
+   return (double)samples[uIndex];
+}
+
+// Returns the number of erased data packets and fills the erased/fec indexes for fec_decode
+static int _build_erasures(int iPattern, int iDataPackets, int iECPackets, unsigned int* pErased, unsigned int* pFecNos)
+{
+   int iMax = std::min(iDataPackets, iECPackets);
+   int iCount = 0;
+   if ( iPattern == ERASURE_SINGLE )
+   {
+      pErased[0] = rand() % iDataPackets;
+      iCount = 1;
+   }
+   else if ( iPattern == ERASURE_RANDOM_HALF )
+   {
+      int iToErase = std::max(1, iMax/2);
+      for( int i=0; i<iDataPackets && iCount < iToErase; i++ )
+         if ( (rand() % (iDataPackets - i)) < (iToErase - iCount) )
+            pErased[iCount++] = i;
+   }
+   else if ( iPattern == ERASURE_BURST_MAX )
+   {
+      int iStart = rand() % (iDataPackets - iMax + 1);
+      for( int i=0; i<iMax; i++ )
+         pErased[iCount++] = iStart + i;
+   }
+   for( int i=0; i<iCount; i++ )
+      pFecNos[i] = i;
+   return iCount;
+}
+
+int main(int argc, char *argv[])
+{
+   const char* szOutputFile = "bench_fec.json";
+   const char* szKernel = NULL;
+   int iBlocks = 2000;
+
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-kernel")) && (i < argc-1) )
+         szKernel = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-blocks")) && (i < argc-1) )
+         iBlocks = std::max(10, atoi(argv[++i]));
+      else if ( 0 == strcmp(argv[i], "-quick") )
+         iBlocks = 200;
+      else
+      {
+         printf("Usage: %s [-o output.json] [-kernel scalar|ssse3|avx2|neon] [-blocks N] [-quick]\n", argv[0]);
+         return 0;
+      }
+   }
+
+   fec_init();
+   if ( NULL != szKernel )
+   {
+      bool bFound = false;
+      for( int k=0; k<FEC_KERNEL_COUNT; k++ )
+      {
+         if ( 0 != strcmp(szKernel, fec_get_kernel_name(k)) )
+            continue;
+         bFound = true;
+         if ( ! fec_set_kernel(k) )
+         {
+            printf("FEC kernel %s is not supported on this CPU.\n", szKernel);
+            return 1;
+         }
+      }
+      if ( ! bFound )
+      {
+         printf("Unknown FEC kernel: %s\n", szKernel);
+         return 1;
+      }
+   }
+
+   FILE* fd = fopen(szOutputFile, "wb");
+   if ( NULL == fd )
+   {
+      printf("Failed to create output file %s\n", szOutputFile);
+      return 1;
+   }
+
+   srand(1234);
+   for( int i=0; i<BENCH_MAX_PACKETS; i++ )
+   for( int k=0; k<BENCH_MAX_SIZE; k++ )
+      s_Data[i][k] = rand() & 0xFF;
+
+   printf("\nFEC benchmark, kernel: %s, %d blocks per test\n", fec_get_kernel_name(fec_get_kernel()), iBlocks);
+   printf("%-6s %-6s %-12s %-12s %10s %10s %10s %10s\n", "data", "size", "op", "erasures", "MB/s", "p50 us", "p99 us", "allocs");
+
+   fprintf(fd, "{\n  \"benchmark\": \"fec\",\n  \"kernel\": \"%s\",\n  \"blocks_per_test\": %d,\n", fec_get_kernel_name(fec_get_kernel()), iBlocks);
+   fprintf(fd, "  \"max_total_packets_in_block\": %d,\n  \"max_packet_payload\": %d,\n  \"results\": [\n", MAX_TOTAL_PACKETS_IN_BLOCK, MAX_PACKET_PAYLOAD);
+
+   std::vector<u64> latencies;
+   latencies.reserve(iBlocks);
+   bool bFirstResult = true;
+
+   u8* pData[BENCH_MAX_PACKETS];
+   u8* pFec[BENCH_MAX_PACKETS];
+   u8 workData[BENCH_MAX_PACKETS][BENCH_MAX_SIZE];
+   unsigned int uErased[BENCH_MAX_PACKETS];
+   unsigned int uFecNos[BENCH_MAX_PACKETS];
+
+   for( size_t s=0; s<sizeof(s_Schemes)/sizeof(s_Schemes[0]); s++ )
+   for( size_t p=0; p<sizeof(s_iPayloadSizes)/sizeof(s_iPayloadSizes[0]); p++ )
+   for( int iPattern=0; iPattern<ERASURE_PATTERNS_COUNT; iPattern++ )
+   {
+      int iDataPackets = s_Schemes[s].iDataPackets;
+      int iECPackets = s_Schemes[s].iECPackets;
+      int iSize = s_iPayloadSizes[p];
+      bool bEncode = (iPattern == ERASURE_NONE);
+
+      latencies.clear();
+      u32 uAllocations = 0;
+      u64 uTotalNs = 0;
+      u64 uTotalBytes = 0;
+      int iErasedPerBlock = 0;
+
+      for( int b=0; b<iBlocks; b++ )
+      {
+         for( int i=0; i<iDataPackets; i++ )
+            pData[i] = s_Data[i];
+         for( int i=0; i<iECPackets; i++ )
+            pFec[i] = s_Fec[i];
+
+         if ( bEncode )
+         {
+            u32 uAllocStart = s_uAllocationsCount;
+            u64 uStart = _bench_time_ns();
+            fec_encode(iSize, pData, iDataPackets, pFec, iECPackets);
+            u64 uDelta = _bench_time_ns() - uStart;
+            uAllocations += s_uAllocationsCount - uAllocStart;
+            latencies.push_back(uDelta);
+            uTotalNs += uDelta;
+            uTotalBytes += (u64)iSize * (u64)iDataPackets;
+            continue;
+         }
+
+         // Decode: encode once outside of the measurement, then erase and recover
+         fec_encode(iSize, pData, iDataPackets, pFec, iECPackets);
+         int iErased = _build_erasures(iPattern, iDataPackets, iECPackets, uErased, uFecNos);
+         iErasedPerBlock = iErased;
+         for( int i=0; i<iDataPackets; i++ )
+         {
+            memcpy(workData[i], s_Data[i], iSize);
+            pData[i] = workData[i];
+         }
+         for( int i=0; i<iErased; i++ )
+            memset(workData[uErased[i]], 0, iSize);
+
+         u32 uAllocStart = s_uAllocationsCount;
+         u64 uStart = _bench_time_ns();
+         fec_decode(iSize, pData, iDataPackets, pFec, uFecNos, uErased, iErased);
+         u64 uDelta = _bench_time_ns() - uStart;
+         uAllocations += s_uAllocationsCount - uAllocStart;
+         latencies.push_back(uDelta);
+         uTotalNs += uDelta;
+         uTotalBytes += (u64)iSize * (u64)iDataPackets;
+
+         for( int i=0; i<iErased; i++ )
+         {
+            if ( 0 != memcmp(workData[uErased[i]], s_Data[uErased[i]], iSize) )
+            {
+               printf("Decode verification failed (data: %d, ec: %d, size: %d, pattern: %s)\n", iDataPackets, iECPackets, iSize, s_szErasureNames[iPattern]);
+               fclose(fd);
+               return 1;
+            }
+         }
+      }
+
+      double fMBs = 0.0;
+      if ( uTotalNs > 0 )
+         fMBs = ((double)uTotalBytes / (1024.0*1024.0)) / ((double)uTotalNs / 1000000000.0);
+      double fP50 = _percentile(latencies, 50.0) / 1000.0;
+      double fP99 = _percentile(latencies, 99.0) / 1000.0;
+      double fAllocsPerCall = (double)uAllocations / (double)iBlocks;
+
+      printf("%2d/%-3d %-6d %-12s %-12s %10.1f %10.2f %10.2f %10.2f\n", iDataPackets, iECPackets, iSize, bEncode?"encode":"decode", s_szErasureNames[iPattern], fMBs, fP50, fP99, fAllocsPerCall);
+
+      fprintf(fd, "%s    {\"op\": \"%s\", \"data_packets\": %d, \"ec_packets\": %d, \"payload_size\": %d, \"erasures\": \"%s\", \"erased_packets\": %d, ",
+         bFirstResult?"":",\n", bEncode?"encode":"decode", iDataPackets, iECPackets, iSize, s_szErasureNames[iPattern], iErasedPerBlock);
+      fprintf(fd, "\"within_block_limits\": %s, \"mb_per_sec\": %.2f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"allocs_per_call\": %.3f}",
+         ((iDataPackets + iECPackets) <= MAX_TOTAL_PACKETS_IN_BLOCK)?"true":"false", fMBs, fP50, fP99, fAllocsPerCall);
+      bFirstResult = false;
+   }
+
+   fprintf(fd, "\n  ]\n}\n");
+   fclose(fd);
+   printf("\nResults written to %s\n", szOutputFile);
+   return 0;
+}
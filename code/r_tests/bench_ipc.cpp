@@ -0,0 +1,232 @@
+#include "../base/base.h"
+#include "../base/ruby_ipc.h"
+#include "../radio/radiopackets2.h"
+
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+
+// Cross process IPC benchmark: ping-pong between two processes over a pair of
+// ruby_ipc channels (the transport the library was built with: message queues, or
+// shared memory rings when built with RUBY_IPC_SHM_RINGS=1). Measures the round
+// trip latency, then the throughput with a window of messages in flight.
+// Uses its own channel types, so it can run next to the Ruby processes.
+//
+// Usage: bench_ipc [-count N] [-size bytes] [-window N] [-poll micros] [-o output.json]
+
+#define BENCH_IPC_CHANNEL_PING 96
+#define BENCH_IPC_CHANNEL_PONG 97
+#define BENCH_IPC_STOP_SEQUENCE 0xFFFFFFFF
+#define BENCH_IPC_WAIT_TIMEOUT_MICROS 200000
+
+static int s_iPollMicros = 0;
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static double _percentile(std::vector<u64>& samples, double fPercent)
+{
+   if ( samples.empty() )
+      return 0.0;
+   size_t uIndex = (size_t)((fPercent/100.0) * (double)(samples.size()-1) + 0.5);
+   std::nth_element(samples.begin(), samples.begin() + uIndex, samples.end());
+   return (double)samples[uIndex];
+}
+
+// Returns the message length or 0 on timeout
+static int _read_message(int iChannelId, u8* pOutput, u32 uTimeoutMicros)
+{
+   static u8 s_uTempBuffer[MAX_PACKET_TOTAL_SIZE];
+   static int s_iTempBufferPos = 0;
+   u64 uTimeStart = _bench_time_ns();
+   while ( true )
+   {
+      if ( NULL != ruby_ipc_try_read_message(iChannelId, s_uTempBuffer, &s_iTempBufferPos, pOutput) )
+         return 1;
+      if ( (_bench_time_ns() - uTimeStart)/1000 > uTimeoutMicros )
+         return 0;
+      if ( s_iPollMicros > 0 )
+         hardware_sleep_micros(s_iPollMicros);
+      else
+         ruby_ipc_wait_for_message(iChannelId, BENCH_IPC_WAIT_TIMEOUT_MICROS);
+   }
+   return 0;
+}
+
+static void _echo_process(int iSize)
+{
+   int iChannelRead = ruby_open_ipc_channel_read_endpoint(BENCH_IPC_CHANNEL_PING);
+   int iChannelWrite = ruby_open_ipc_channel_write_endpoint(BENCH_IPC_CHANNEL_PONG);
+   if ( (iChannelRead <= 0) || (iChannelWrite <= 0) )
+      exit(1);
+
+   u8 uMessage[IPC_CHANNEL_MAX_MSG_SIZE];
+   while ( true )
+   {
+      if ( ! _read_message(iChannelRead, uMessage, BENCH_IPC_WAIT_TIMEOUT_MICROS) )
+      {
+         if ( getppid() == 1 )
+            break;
+         continue;
+      }
+      u32 uSequence = 0;
+      memcpy(&uSequence, uMessage + sizeof(u32), sizeof(u32));
+      if ( uSequence == BENCH_IPC_STOP_SEQUENCE )
+         break;
+      ruby_ipc_channel_send_message(iChannelWrite, uMessage, iSize);
+   }
+   exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+   int iCount = 20000;
+   int iSize = 64;
+   int iWindow = 16;
+   const char* szOutputFile = NULL;
+
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-count")) && (i < argc-1) )
+         iCount = std::max(100, atoi(argv[++i]));
+      else if ( (0 == strcmp(argv[i], "-size")) && (i < argc-1) )
+         iSize = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-window")) && (i < argc-1) )
+         iWindow = std::max(1, std::min(64, atoi(argv[++i])));
+      else if ( (0 == strcmp(argv[i], "-poll")) && (i < argc-1) )
+         s_iPollMicros = std::max(0, atoi(argv[++i]));
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-count N] [-size bytes] [-window N] [-poll micros] [-o output.json]\n", argv[0]);
+         return 0;
+      }
+   }
+   iSize = std::max((int)(3*sizeof(u32)), std::min(iSize, IPC_CHANNEL_MAX_MSG_SIZE-8));
+
+   #ifdef RUBY_USES_SHM_RINGS
+   const char* szTransport = "shm_rings";
+   #else
+   const char* szTransport = "msgqueues";
+   #endif
+
+   printf("\nIPC ping-pong benchmark, transport: %s, %d messages of %d bytes, window: %d, %s\n", szTransport, iCount, iSize, iWindow,
+      (s_iPollMicros > 0)?"polling":"waiting for messages");
+   log_disable();
+
+   // Remove any channels left by a previous run
+   ruby_close_ipc_channel(ruby_open_ipc_channel_write_endpoint(BENCH_IPC_CHANNEL_PING));
+   ruby_close_ipc_channel(ruby_open_ipc_channel_write_endpoint(BENCH_IPC_CHANNEL_PONG));
+
+   fflush(stdout);
+   pid_t pid = fork();
+   if ( pid < 0 )
+   {
+      printf("Failed to start the echo process.\n");
+      return 1;
+   }
+   if ( 0 == pid )
+      _echo_process(iSize);
+
+   int iChannelWrite = ruby_open_ipc_channel_write_endpoint(BENCH_IPC_CHANNEL_PING);
+   int iChannelRead = ruby_open_ipc_channel_read_endpoint(BENCH_IPC_CHANNEL_PONG);
+   if ( (iChannelRead <= 0) || (iChannelWrite <= 0) )
+   {
+      printf("Failed to open the IPC channels.\n");
+      kill(pid, SIGTERM);
+      return 1;
+   }
+
+   u8 uMessage[IPC_CHANNEL_MAX_MSG_SIZE];
+   u8 uReply[IPC_CHANNEL_MAX_MSG_SIZE];
+   for( int i=0; i<iSize; i++ )
+      uMessage[i] = (u8)i;
+
+   // Round trip latency, one message in flight
+   std::vector<u64> latencies;
+   latencies.reserve(iCount);
+   int iLost = 0;
+   int iWarmup = 100;
+   for( int i=0; i<iCount + iWarmup; i++ )
+   {
+      u32 uSequence = (u32)i;
+      memcpy(uMessage + sizeof(u32), &uSequence, sizeof(u32));
+      u64 uStart = _bench_time_ns();
+      ruby_ipc_channel_send_message(iChannelWrite, uMessage, iSize);
+      u32 uReplySequence = 0;
+      do
+      {
+         if ( ! _read_message(iChannelRead, uReply, 1000000) )
+            break;
+         memcpy(&uReplySequence, uReply + sizeof(u32), sizeof(u32));
+      } while ( uReplySequence != uSequence );
+      u64 uDelta = _bench_time_ns() - uStart;
+      if ( uReplySequence != uSequence )
+      {
+         iLost++;
+         continue;
+      }
+      if ( i >= iWarmup )
+         latencies.push_back(uDelta);
+   }
+
+   double fP50 = _percentile(latencies, 50.0) / 1000.0;
+   double fP99 = _percentile(latencies, 99.0) / 1000.0;
+   double fMax = latencies.empty()?0.0:(double)(*std::max_element(latencies.begin(), latencies.end())) / 1000.0;
+   printf("Round trip: p50 %.2f us, p99 %.2f us, max %.2f us, lost %d\n", fP50, fP99, fMax, iLost);
+
+   // Throughput, iWindow messages in flight
+   int iSent = 0;
+   int iReceived = 0;
+   u64 uStart = _bench_time_ns();
+   while ( iReceived < iCount )
+   {
+      while ( (iSent < iCount) && (iSent - iReceived < iWindow) )
+      {
+         u32 uSequence = (u32)iSent;
+         memcpy(uMessage + sizeof(u32), &uSequence, sizeof(u32));
+         if ( ruby_ipc_channel_send_message(iChannelWrite, uMessage, iSize) <= 0 )
+            break;
+         iSent++;
+      }
+      if ( ! _read_message(iChannelRead, uReply, 1000000) )
+      {
+         iLost += iSent - iReceived;
+         break;
+      }
+      iReceived++;
+   }
+   double fSeconds = (double)(_bench_time_ns() - uStart) / 1000000000.0;
+   double fMessagesPerSec = (fSeconds > 0.0)?((double)(2*iReceived) / fSeconds):0.0;
+   printf("Throughput: %.0f messages/sec (%d round trips in %.3f sec), lost %d\n", fMessagesPerSec, iReceived, fSeconds, iLost);
+
+   u32 uStop = BENCH_IPC_STOP_SEQUENCE;
+   memcpy(uMessage + sizeof(u32), &uStop, sizeof(u32));
+   ruby_ipc_channel_send_message(iChannelWrite, uMessage, iSize);
+   waitpid(pid, NULL, 0);
+
+   ruby_close_ipc_channel(iChannelWrite);
+   ruby_close_ipc_channel(iChannelRead);
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "wb");
+      if ( NULL == fd )
+      {
+         printf("Failed to create output file %s\n", szOutputFile);
+         return 1;
+      }
+      fprintf(fd, "{\n  \"benchmark\": \"ipc\",\n  \"transport\": \"%s\",\n  \"messages\": %d,\n  \"message_size\": %d,\n  \"window\": %d,\n  \"poll_micros\": %d,\n",
+         szTransport, iCount, iSize, iWindow, s_iPollMicros);
+      fprintf(fd, "  \"rtt_p50_us\": %.3f,\n  \"rtt_p99_us\": %.3f,\n  \"rtt_max_us\": %.3f,\n  \"messages_per_sec\": %.0f,\n  \"lost\": %d\n}\n",
+         fP50, fP99, fMax, fMessagesPerSec, iLost);
+      fclose(fd);
+      printf("Results written to %s\n", szOutputFile);
+   }
+   return (iLost > 0)?1:0;
+}
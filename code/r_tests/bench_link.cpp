@@ -0,0 +1,615 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+#include "../base/flags_video.h"
+#include "../base/controller_rt_info.h"
+#include "../base/latency_trace.h"
+#include "../radio/radio_link_sim.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/fec.h"
+#include "../r_station/video_rx_buffers.h"
+#include "video_link_fixture.h"
+
+// End to end video link benchmark on the radio link simulator, no radio hardware needed.
+// Vehicle side (simulated interface 0): H264 frames (from an Annex-B file or synthetic) paced at the
+// video fps, packetized in video blocks with EC packets (same packet headers and FEC as the vehicle
+// router), sent on the downlink; answers the retransmission requests from its history of sent blocks.
+// Station side (simulated interface 1): the station VideoRxPacketsBuffer (EC recovery), in order output of the
+// video packets, retransmission requests on the uplink for the incomplete blocks, up to a max retransmission window.
+// Reports the goodput, the blocks recovered by EC/retransmissions, the lost blocks and the frames latency.
+//
+// Usage: bench_link [-in file.h264] [-seconds N] [-fps N] [-bitrate kbps] [-data N] [-ec N] [-psize bytes]
+//                   [-window ms] [-noretr] [-link "params"] [-uplink "params"] [-port base_udp_port] [-o output.json]
+// Link params: see radio_link_sim_parse_params, i.e. -link "loss=2,burst=0.5:20:80,delay=3,jitter=1,rate=12000"
+
+#define BENCH_HISTORY_BLOCKS 256
+#define BENCH_FRAMES_INFO 1024
+#define BENCH_MAX_FRAME_SIZE (1024*1024)
+#define BENCH_REQUEST_GAP_MS 5
+#define BENCH_MAX_REQUESTED_PACKETS 100
+
+typedef struct
+{
+   u8 uPackets[MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_TOTAL_SIZE];
+   int iPacketsLength[MAX_TOTAL_PACKETS_IN_BLOCK];
+   int iCountPackets;
+   u32 uBlockIndex;
+} type_bench_sent_block;
+
+typedef struct
+{
+   u64 uCaptureMicros;
+   int iDataPackets;
+   int iOutputPackets;
+   u16 uFrameIndex;
+} type_bench_frame_info;
+
+static int s_iBlockDataPackets = 8;
+static int s_iBlockECPackets = 4;
+static int s_iBlockPacketSize = 1100; // EC protected part: important header + video data
+static int s_iRetransmissionWindowMs = 100;
+static int s_bRetransmissions = 1;
+
+// Vehicle side state
+static type_bench_sent_block* s_pSentBlocks = NULL;
+static u32 s_uNextBlockIndex = 0;
+static u32 s_uNextStreamPacketIndex = 0;
+static u16 s_uNextFrameIndex = 0;
+static u32 s_uTotalFramesSent = 0;
+static u32 s_uTotalBlocksSent = 0;
+static u32 s_uTotalPacketsSent = 0;
+static u64 s_uTotalVideoBytesSent = 0;
+static u32 s_uTotalRetrRequestsReceived = 0;
+static u32 s_uTotalRetrPacketsSent = 0;
+static u32 s_uTotalRetrPacketsNotInHistory = 0;
+
+// Station side state
+static type_bench_frame_info s_FramesInfo[BENCH_FRAMES_INFO];
+static u32 s_uRetransmissionId = 0;
+static u32 s_uTotalRetrRequestsSent = 0;
+static u32 s_uTotalRetrPacketsRequested = 0;
+static u32 s_uTotalPacketsReceived = 0;
+static u32 s_uTotalBlocksClean = 0;
+static u32 s_uTotalBlocksRecoveredEC = 0;
+static u32 s_uTotalBlocksRecoveredRetr = 0;
+static u32 s_uTotalBlocksLost = 0;
+static u32 s_uTotalFramesComplete = 0;
+static u64 s_uTotalVideoBytesOutput = 0;
+static u32 s_uBottomBlockStalled = MAX_U32;
+static u32 s_uTimeBottomBlockStalled = 0;
+static type_latency_trace_histogram s_FramesLatency;
+
+static u64 _bench_time_micros()
+{
+   return latency_trace_get_time_micros();
+}
+
+//------------------------------------------------------------
+// Video source
+
+static u8* s_pInputFile = NULL;
+static int s_iInputFileSize = 0;
+static int s_iInputFilePos = 0;
+static u32 s_uRandomState = 0x12345678;
+
+static int _load_input_file(const char* szFile)
+{
+   FILE* fd = fopen(szFile, "rb");
+   if ( NULL == fd )
+      return 0;
+   fseek(fd, 0, SEEK_END);
+   long lSize = ftell(fd);
+   fseek(fd, 0, SEEK_SET);
+   if ( lSize < 8 )
+   {
+      fclose(fd);
+      return 0;
+   }
+   s_pInputFile = (u8*)malloc(lSize);
+   if ( (NULL == s_pInputFile) || (1 != fread(s_pInputFile, lSize, 1, fd)) )
+   {
+      fclose(fd);
+      return 0;
+   }
+   fclose(fd);
+   s_iInputFileSize = (int)lSize;
+   return 1;
+}
+
+// Position of the next Annex-B start code (3 or 4 bytes) from iPos, or the end of the file
+static int _find_start_code(int iPos)
+{
+   for( int i=iPos; i<s_iInputFileSize-3; i++ )
+   {
+      if ( (0 == s_pInputFile[i]) && (0 == s_pInputFile[i+1]) && (1 == s_pInputFile[i+2]) )
+         return ((i > iPos) && (0 == s_pInputFile[i-1]))?(i-1):i;
+   }
+   return s_iInputFileSize;
+}
+
+// Next access unit from the file: NAL units up to and including a slice NAL (H264 types 1 and 5); loops over the file
+static int _get_next_file_frame(u8* pOutput)
+{
+   int iSize = 0;
+   for( int iCountNALs=0; iCountNALs<64; iCountNALs++ )
+   {
+      if ( s_iInputFilePos >= s_iInputFileSize-4 )
+         s_iInputFilePos = _find_start_code(0);
+      int iStart = s_iInputFilePos;
+      int iHeader = iStart + ((0 == s_pInputFile[iStart+2])?4:3);
+      int iEnd = _find_start_code(iHeader);
+      s_iInputFilePos = iEnd;
+      if ( iSize + (iEnd - iStart) > BENCH_MAX_FRAME_SIZE )
+         break;
+      memcpy(pOutput + iSize, s_pInputFile + iStart, iEnd - iStart);
+      iSize += iEnd - iStart;
+      int iNALType = (iHeader < s_iInputFileSize)?(s_pInputFile[iHeader] & 0x1F):0;
+      if ( (1 == iNALType) || (5 == iNALType) )
+         break;
+   }
+   return iSize;
+}
+
+// Synthetic stream: a key frame (4 times the size of a P frame) every second
+static int _get_next_synthetic_frame(u8* pOutput, int iFPS, int iBitrateKbps)
+{
+   int iPFrameSize = iBitrateKbps * 1000 / 8 / (iFPS + 3);
+   bool bKeyFrame = ((s_uTotalFramesSent % (u32)iFPS) == 0);
+   int iSize = bKeyFrame?(4*iPFrameSize):iPFrameSize;
+   iSize = iSize - iSize/8 + (int)(video_fixture_random(&s_uRandomState) % (u32)(iSize/4 + 1));
+   if ( iSize < 64 )
+      iSize = 64;
+   if ( iSize > BENCH_MAX_FRAME_SIZE )
+      iSize = BENCH_MAX_FRAME_SIZE;
+   pOutput[0] = 0;
+   pOutput[1] = 0;
+   pOutput[2] = 0;
+   pOutput[3] = 1;
+   pOutput[4] = bKeyFrame?0x65:0x41;
+   for( int i=5; i<iSize; i++ )
+      pOutput[i] = (u8)video_fixture_random(&s_uRandomState);
+   return iSize;
+}
+
+//------------------------------------------------------------
+// Vehicle side
+
+// Splits the frame in video blocks (a block never spans two frames), adds the EC packets, sends all the packets
+static void _vehicle_send_frame(u8* pFrame, int iFrameSize, int iFPS)
+{
+   int iVideoDataSize = s_iBlockPacketSize - (int)sizeof(t_packet_header_video_segment_important);
+   int iFramePackets = (iFrameSize + iVideoDataSize - 1) / iVideoDataSize;
+   u16 uFrameIndex = s_uNextFrameIndex++;
+
+   type_bench_frame_info* pFrameInfo = &s_FramesInfo[uFrameIndex % BENCH_FRAMES_INFO];
+   pFrameInfo->uCaptureMicros = _bench_time_micros();
+   pFrameInfo->iDataPackets = iFramePackets;
+   pFrameInfo->iOutputPackets = 0;
+   pFrameInfo->uFrameIndex = uFrameIndex;
+
+   int iFramePacketIndex = 0;
+   int iFramePos = 0;
+   while ( iFramePacketIndex < iFramePackets )
+   {
+      int iDataPackets = iFramePackets - iFramePacketIndex;
+      if ( iDataPackets > s_iBlockDataPackets )
+         iDataPackets = s_iBlockDataPackets;
+      // Short blocks at the end of a frame keep the EC ratio
+      int iECPackets = (iDataPackets * s_iBlockECPackets + s_iBlockDataPackets - 1) / s_iBlockDataPackets;
+
+      type_bench_sent_block* pBlock = &s_pSentBlocks[s_uNextBlockIndex % BENCH_HISTORY_BLOCKS];
+      pBlock->uBlockIndex = s_uNextBlockIndex;
+      pBlock->iCountPackets = iDataPackets + iECPackets;
+
+      int iHeadersSize = (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+      for( int k=0; k<iDataPackets + iECPackets; k++ )
+      {
+         u8* pPacket = pBlock->uPackets[k];
+         memset(pPacket, 0, iHeadersSize + s_iBlockPacketSize);
+         int iPacketInFrame = iFramePacketIndex + ((k < iDataPackets)?k:(iDataPackets-1));
+         video_fixture_set_packet_headers(pPacket, 0, s_uNextBlockIndex, k, iDataPackets, iECPackets, s_iBlockPacketSize,
+            uFrameIndex, iFramePackets, iPacketInFrame, s_uNextStreamPacketIndex++);
+         t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(pPacket + sizeof(t_packet_header));
+         pPHVS->uRuntimeMetrics = (u16)(1000/iFPS);
+         if ( k >= iDataPackets )
+            continue;
+
+         t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(pPacket + iHeadersSize);
+         int iChunk = iFrameSize - iFramePos;
+         if ( iChunk > iVideoDataSize )
+            iChunk = iVideoDataSize;
+         pPHVSImp->uVideoDataLength = (u16)iChunk;
+         memcpy(pPacket + iHeadersSize + sizeof(t_packet_header_video_segment_important), pFrame + iFramePos, iChunk);
+         iFramePos += iChunk;
+         s_uTotalVideoBytesSent += iChunk;
+      }
+      video_fixture_encode_block(pBlock->uPackets, pBlock->iPacketsLength, iDataPackets, iECPackets, s_iBlockPacketSize);
+
+      for( int k=0; k<pBlock->iCountPackets; k++ )
+      {
+         video_fixture_send_packet(true, pBlock->uPackets[k], pBlock->iPacketsLength[k]);
+         s_uTotalPacketsSent++;
+      }
+      s_uNextBlockIndex++;
+      s_uTotalBlocksSent++;
+      iFramePacketIndex += iDataPackets;
+   }
+   s_uTotalFramesSent++;
+}
+
+static void _vehicle_resend_packet(type_bench_sent_block* pBlock, int iPacketIndex)
+{
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+   memcpy(uPacket, pBlock->uPackets[iPacketIndex], pBlock->iPacketsLength[iPacketIndex]);
+   t_packet_header* pPH = (t_packet_header*)uPacket;
+   pPH->packet_flags |= PACKET_FLAGS_BIT_RETRANSMITED;
+   video_fixture_send_packet(true, uPacket, pBlock->iPacketsLength[iPacketIndex]);
+   s_uTotalRetrPacketsSent++;
+}
+
+static void _vehicle_on_packet(u8* pPacket, int iLength, void* pContext)
+{
+   if ( ((t_packet_header*)pPacket)->packet_type != PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS )
+      return;
+   if ( iLength < (int)(sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8)) )
+      return;
+   s_uTotalRetrRequestsReceived++;
+   u8* pData = pPacket + sizeof(t_packet_header) + sizeof(u32);
+   int iCount = pData[2];
+   pData += 3;
+   for( int i=0; i<iCount; i++ )
+   {
+      if ( pData + sizeof(u32) + sizeof(u8) > pPacket + iLength )
+         break;
+      u32 uBlockIndex = 0;
+      memcpy(&uBlockIndex, pData, sizeof(u32));
+      u8 uPacketIndex = pData[sizeof(u32)];
+      pData += sizeof(u32) + sizeof(u8);
+
+      type_bench_sent_block* pBlock = &s_pSentBlocks[uBlockIndex % BENCH_HISTORY_BLOCKS];
+      if ( (pBlock->uBlockIndex != uBlockIndex) || (uBlockIndex >= s_uNextBlockIndex) )
+      {
+         s_uTotalRetrPacketsNotInHistory++;
+         continue;
+      }
+      if ( 0xFF == uPacketIndex )
+      {
+         for( int k=0; k<pBlock->iCountPackets; k++ )
+            _vehicle_resend_packet(pBlock, k);
+      }
+      else if ( (int)uPacketIndex < pBlock->iCountPackets )
+         _vehicle_resend_packet(pBlock, uPacketIndex);
+   }
+}
+
+//------------------------------------------------------------
+// Station side
+
+static void _station_on_block_done(type_rx_video_block_info* pBlock)
+{
+   if ( video_fixture_block_has_retransmitted_packets(pBlock) )
+      s_uTotalBlocksRecoveredRetr++;
+   else if ( pBlock->iReconstructedECUsed > 0 )
+      s_uTotalBlocksRecoveredEC++;
+   else
+      s_uTotalBlocksClean++;
+}
+
+static void _station_output_packet(type_rx_video_block_info* pBlock, type_rx_video_packet_info* pPacket, void* pContext)
+{
+   s_uBottomBlockStalled = MAX_U32;
+   s_uTotalVideoBytesOutput += pPacket->pPHVSImp->uVideoDataLength;
+   type_bench_frame_info* pFrameInfo = &s_FramesInfo[pPacket->pPHVS->uH264FrameIndex % BENCH_FRAMES_INFO];
+   if ( pFrameInfo->uFrameIndex == pPacket->pPHVS->uH264FrameIndex )
+   {
+      pFrameInfo->iOutputPackets++;
+      if ( pFrameInfo->iOutputPackets == pFrameInfo->iDataPackets )
+      {
+         s_uTotalFramesComplete++;
+         latency_trace_histogram_add(&s_FramesLatency, (u32)(_bench_time_micros() - pFrameInfo->uCaptureMicros));
+      }
+   }
+   if ( pPacket->pPHVS->uCurrentBlockPacketIndex == pBlock->iBlockDataPackets-1 )
+      _station_on_block_done(pBlock);
+}
+
+// The incomplete bottom block is skipped when retransmissions are off (and newer blocks are available)
+// or it waited longer than the retransmission window.
+static bool _station_can_discard_block(VideoRxPacketsBuffer* pRxBuffer, type_rx_video_block_info* pBlock, void* pContext)
+{
+   if ( s_uBottomBlockStalled != pBlock->uVideoBlockIndex )
+   {
+      s_uBottomBlockStalled = pBlock->uVideoBlockIndex;
+      s_uTimeBottomBlockStalled = g_TimeNow;
+   }
+   if ( s_bRetransmissions && (g_TimeNow < s_uTimeBottomBlockStalled + (u32)s_iRetransmissionWindowMs) )
+      return false;
+   s_uBottomBlockStalled = MAX_U32;
+   return true;
+}
+
+static void _station_output_available_packets(VideoRxPacketsBuffer* pRxBuffer)
+{
+   s_uTotalBlocksLost += (u32)video_fixture_output_available_packets(pRxBuffer, _station_output_packet, _station_can_discard_block, NULL);
+}
+
+// Requests the missing packets of the blocks before the top block, and of the top block if no packet
+// of it was received for BENCH_REQUEST_GAP_MS. A packet is requested again after the retransmission window/4.
+static void _station_request_missing_packets(VideoRxPacketsBuffer* pRxBuffer)
+{
+   int iCountBlocks = pRxBuffer->getCountBlocksInBuffer();
+   if ( 0 == iCountBlocks )
+      return;
+
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+   u8* pRequests = uPacket + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
+   int iCountRequested = 0;
+   u32 uRetryMs = (u32)s_iRetransmissionWindowMs/4;
+   if ( uRetryMs < 5 )
+      uRetryMs = 5;
+
+   for( int i=0; (i<iCountBlocks) && (iCountRequested < BENCH_MAX_REQUESTED_PACKETS); i++ )
+   {
+      type_rx_video_block_info* pBlock = pRxBuffer->getBlockInBufferFromBottom(i);
+      if ( (i == iCountBlocks-1) && (g_TimeNow < pBlock->uReceivedTime + BENCH_REQUEST_GAP_MS) )
+         break;
+      if ( (pBlock->iBlockDataPackets > 0) && (pBlock->iRecvDataPackets >= pBlock->iBlockDataPackets) )
+         continue;
+
+      // Nothing received from the block: request it all
+      if ( 0 == pBlock->iBlockDataPackets )
+      {
+         if ( (pBlock->uRequestedMask & VIDEO_RX_PACKET_BIT(0)) && (g_TimeNow < pBlock->uPacketsRequestedTime[0] + uRetryMs) )
+            continue;
+         pBlock->uRequestedMask |= VIDEO_RX_PACKET_BIT(0);
+         pBlock->uPacketsRequestedTime[0] = g_TimeNow;
+         memcpy(pRequests + iCountRequested*5, &pBlock->uVideoBlockIndex, sizeof(u32));
+         pRequests[iCountRequested*5 + 4] = 0xFF;
+         iCountRequested++;
+         continue;
+      }
+
+      // Only as many missing data packets as the EC packets can not recover
+      int iNeeded = pBlock->iBlockDataPackets - pBlock->iRecvDataPackets - pBlock->iRecvECPackets;
+      for( int k=0; (k<pBlock->iBlockDataPackets) && (iNeeded > 0) && (iCountRequested < BENCH_MAX_REQUESTED_PACKETS); k++ )
+      {
+         if ( pBlock->uReceivedMask & VIDEO_RX_PACKET_BIT(k) )
+            continue;
+         iNeeded--;
+         if ( (pBlock->uRequestedMask & VIDEO_RX_PACKET_BIT(k)) && (g_TimeNow < pBlock->uPacketsRequestedTime[k] + uRetryMs) )
+            continue;
+         pBlock->uRequestedMask |= VIDEO_RX_PACKET_BIT(k);
+         pBlock->uPacketsRequestedTime[k] = g_TimeNow;
+         memcpy(pRequests + iCountRequested*5, &pBlock->uVideoBlockIndex, sizeof(u32));
+         pRequests[iCountRequested*5 + 4] = (u8)k;
+         iCountRequested++;
+      }
+   }
+   if ( 0 == iCountRequested )
+      return;
+
+   t_packet_header PH;
+   radio_packet_init(&PH, PACKET_COMPONENT_VIDEO, PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS, STREAM_ID_DATA);
+   PH.packet_flags |= PACKET_FLAGS_BIT_HIGH_PRIORITY;
+   PH.vehicle_id_dest = 1;
+   PH.total_length = sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8) + iCountRequested*5;
+   s_uRetransmissionId++;
+   memcpy(uPacket, &PH, sizeof(t_packet_header));
+   memcpy(uPacket + sizeof(t_packet_header), &s_uRetransmissionId, sizeof(u32));
+   uPacket[sizeof(t_packet_header) + sizeof(u32)] = 0;
+   uPacket[sizeof(t_packet_header) + sizeof(u32) + 1] = 0;
+   uPacket[sizeof(t_packet_header) + sizeof(u32) + 2] = (u8)iCountRequested;
+
+   if ( video_fixture_send_packet(false, uPacket, PH.total_length) )
+   {
+      s_uTotalRetrRequestsSent++;
+      s_uTotalRetrPacketsRequested += iCountRequested;
+   }
+}
+
+static void _station_on_packet(u8* pPacket, int iLength, void* pContext)
+{
+   VideoRxPacketsBuffer* pRxBuffer = (VideoRxPacketsBuffer*)pContext;
+   t_packet_header* pPH = (t_packet_header*)pPacket;
+   if ( pPH->packet_type != PACKET_TYPE_VIDEO_DATA )
+      return;
+   s_uTotalPacketsReceived++;
+   if ( pRxBuffer->checkAddVideoPacket(pPacket, iLength, _bench_time_micros()) )
+      _station_output_available_packets(pRxBuffer);
+}
+
+//------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+   const char* szInputFile = NULL;
+   const char* szOutputFile = NULL;
+   const char* szLinkParams = "";
+   const char* szUplinkParams = "";
+   int iSeconds = 10;
+   int iFPS = 30;
+   int iBitrateKbps = 8000;
+   int iBasePort = RADIO_LINK_SIM_DEFAULT_BASE_PORT;
+
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-in")) && (i < argc-1) )
+         szInputFile = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-seconds")) && (i < argc-1) )
+         iSeconds = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-fps")) && (i < argc-1) )
+         iFPS = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-bitrate")) && (i < argc-1) )
+         iBitrateKbps = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-data")) && (i < argc-1) )
+         s_iBlockDataPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-ec")) && (i < argc-1) )
+         s_iBlockECPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-psize")) && (i < argc-1) )
+         s_iBlockPacketSize = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-window")) && (i < argc-1) )
+         s_iRetransmissionWindowMs = atoi(argv[++i]);
+      else if ( 0 == strcmp(argv[i], "-noretr") )
+         s_bRetransmissions = 0;
+      else if ( (0 == strcmp(argv[i], "-link")) && (i < argc-1) )
+         szLinkParams = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-uplink")) && (i < argc-1) )
+         szUplinkParams = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-port")) && (i < argc-1) )
+         iBasePort = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-in file.h264] [-seconds N] [-fps N] [-bitrate kbps] [-data N] [-ec N] [-psize bytes] [-window ms] [-noretr] [-link \"params\"] [-uplink \"params\"] [-port base_udp_port] [-o output.json]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   int iMaxPacketSize = MAX_PACKET_TOTAL_SIZE - (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   if ( (iFPS < 1) || (iSeconds < 1) || (s_iBlockDataPackets < 1) || (s_iBlockDataPackets > MAX_DATA_PACKETS_IN_BLOCK) ||
+        (s_iBlockECPackets < 0) || (s_iBlockECPackets > MAX_FECS_PACKETS_IN_BLOCK) ||
+        (s_iBlockPacketSize < 100) || (s_iBlockPacketSize > iMaxPacketSize) )
+   {
+      printf("Invalid parameters (max %d data packets, %d EC packets, block packet size 100 to %d bytes).\n", MAX_DATA_PACKETS_IN_BLOCK, MAX_FECS_PACKETS_IN_BLOCK, iMaxPacketSize);
+      return 1;
+   }
+
+   type_radio_link_sim_params paramsDownlink;
+   type_radio_link_sim_params paramsUplink;
+   radio_link_sim_set_default_params(&paramsDownlink);
+   radio_link_sim_set_default_params(&paramsUplink);
+   if ( (! radio_link_sim_parse_params(szLinkParams, &paramsDownlink)) || (! radio_link_sim_parse_params(szUplinkParams, &paramsUplink)) )
+   {
+      printf("Invalid link parameters.\n");
+      return 1;
+   }
+   if ( (NULL != szInputFile) && (! _load_input_file(szInputFile)) )
+   {
+      printf("Failed to read the input file %s\n", szInputFile);
+      return 1;
+   }
+
+   log_disable();
+   g_TimeStart = get_current_timestamp_ms();
+   g_TimeNow = g_TimeStart;
+   fec_init();
+   memset(&g_SMControllerRTInfo, 0, sizeof(controller_runtime_info));
+   memset(s_FramesInfo, 0, sizeof(s_FramesInfo));
+   memset(&s_FramesLatency, 0, sizeof(s_FramesLatency));
+
+   if ( ! video_fixture_open_sim_link((u16)iBasePort, &paramsDownlink, &paramsUplink) )
+   {
+      printf("Failed to open the simulated radio interfaces (UDP ports %d+).\n", iBasePort);
+      return 1;
+   }
+
+   Model model;
+   VideoRxPacketsBuffer* pRxBuffer = new VideoRxPacketsBuffer(0, 0);
+   s_pSentBlocks = (type_bench_sent_block*)malloc(BENCH_HISTORY_BLOCKS * sizeof(type_bench_sent_block));
+   u8* pFrame = (u8*)malloc(BENCH_MAX_FRAME_SIZE);
+   if ( (NULL == s_pSentBlocks) || (NULL == pFrame) || (! pRxBuffer->init(&model)) )
+   {
+      printf("Failed to initialize.\n");
+      return 1;
+   }
+   memset(s_pSentBlocks, 0xFF, BENCH_HISTORY_BLOCKS * sizeof(type_bench_sent_block));
+
+   printf("\nLink benchmark: %d s, %d fps, %s, EC %d/%d, %d bytes packets, retransmissions %s (window %d ms)\n",
+      iSeconds, iFPS, (NULL != szInputFile)?szInputFile:"synthetic stream", s_iBlockDataPackets, s_iBlockECPackets,
+      s_iBlockPacketSize, s_bRetransmissions?"on":"off", s_iRetransmissionWindowMs);
+   printf("Downlink: %s\n", (0 != szLinkParams[0])?szLinkParams:"no impairments");
+   printf("Uplink: %s\n", (0 != szUplinkParams[0])?szUplinkParams:"no impairments");
+
+   u64 uTimeStartMicros = _bench_time_micros();
+   u64 uTimeEndSendMicros = uTimeStartMicros + (u64)iSeconds * 1000000LL;
+   u64 uTimeEndMicros = uTimeEndSendMicros + (u64)(s_iRetransmissionWindowMs + 200) * 1000LL;
+   u64 uFrameIntervalMicros = 1000000LL / (u64)iFPS;
+   u64 uTimeNextFrame = uTimeStartMicros;
+   u32 uTimeLastRequestCheck = 0;
+
+   while ( 1 )
+   {
+      u64 uTimeNow = _bench_time_micros();
+      if ( uTimeNow >= uTimeEndMicros )
+         break;
+      g_TimeNow = get_current_timestamp_ms();
+
+      if ( (uTimeNow >= uTimeNextFrame) && (uTimeNow < uTimeEndSendMicros) )
+      {
+         int iFrameSize = (NULL != s_pInputFile)?_get_next_file_frame(pFrame):_get_next_synthetic_frame(pFrame, iFPS, iBitrateKbps);
+         if ( iFrameSize > 0 )
+            _vehicle_send_frame(pFrame, iFrameSize, iFPS);
+         uTimeNextFrame += uFrameIntervalMicros;
+         continue;
+      }
+
+      if ( s_bRetransmissions && (g_TimeNow != uTimeLastRequestCheck) )
+      {
+         uTimeLastRequestCheck = g_TimeNow;
+         _station_request_missing_packets(pRxBuffer);
+      }
+      _station_output_available_packets(pRxBuffer);
+
+      bool bStationHasPackets = false;
+      bool bVehicleHasPackets = false;
+      if ( ! video_fixture_poll_sim_link(1, &bStationHasPackets, &bVehicleHasPackets) )
+         continue;
+      g_TimeNow = get_current_timestamp_ms();
+      if ( bStationHasPackets )
+         video_fixture_read_packets(false, _station_on_packet, pRxBuffer);
+      if ( bVehicleHasPackets )
+         video_fixture_read_packets(true, _vehicle_on_packet, NULL);
+   }
+
+   double fSeconds = (double)(_bench_time_micros() - uTimeStartMicros) / 1000000.0;
+   type_radio_link_sim_stats statsDownlink;
+   type_radio_link_sim_stats statsUplink;
+   video_fixture_close_sim_link(&statsDownlink, &statsUplink);
+
+   double fGoodputKbps = (double)s_uTotalVideoBytesOutput * 8.0 / 1000.0 / (double)iSeconds;
+   double fSentKbps = (double)s_uTotalVideoBytesSent * 8.0 / 1000.0 / (double)iSeconds;
+   u32 uP50 = latency_trace_histogram_get_percentile(&s_FramesLatency, 50);
+   u32 uP95 = latency_trace_histogram_get_percentile(&s_FramesLatency, 95);
+   u32 uP99 = latency_trace_histogram_get_percentile(&s_FramesLatency, 99);
+
+   printf("Ran for %.1f s\n", fSeconds);
+   printf("video sent             : %9.1f kbps, %u frames, %u blocks, %u packets\n", fSentKbps, s_uTotalFramesSent, s_uTotalBlocksSent, s_uTotalPacketsSent);
+   printf("goodput (in order)     : %9.1f kbps, %u complete frames (%.2f%%)\n", fGoodputKbps, s_uTotalFramesComplete,
+      (s_uTotalFramesSent > 0)?(100.0*(double)s_uTotalFramesComplete/(double)s_uTotalFramesSent):0.0);
+   printf("blocks                 : %u clean, %u EC recovered, %u retransmission recovered, %u lost\n",
+      s_uTotalBlocksClean, s_uTotalBlocksRecoveredEC, s_uTotalBlocksRecoveredRetr, s_uTotalBlocksLost);
+   printf("retransmissions        : %u requests (%u packets) sent, %u received, %u packets resent, %u not in history\n",
+      s_uTotalRetrRequestsSent, s_uTotalRetrPacketsRequested, s_uTotalRetrRequestsReceived, s_uTotalRetrPacketsSent, s_uTotalRetrPacketsNotInHistory);
+   printf("downlink               : %u frames in, %u delivered, %u lost random, %u lost burst (%u bursts), %u queue drops\n",
+      statsDownlink.uFramesIn, statsDownlink.uFramesDelivered, statsDownlink.uFramesLostRandom, statsDownlink.uFramesLostBurst, statsDownlink.uBursts, statsDownlink.uFramesDroppedQueue);
+   printf("uplink                 : %u frames in, %u delivered\n", statsUplink.uFramesIn, statsUplink.uFramesDelivered);
+   printf("frame latency (ms)     : p50 %.1f, p95 %.1f, p99 %.1f, max %.1f\n",
+      (double)uP50/1000.0, (double)uP95/1000.0, (double)uP99/1000.0, (double)s_FramesLatency.uMaxMicros/1000.0);
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"link\",\n  \"seconds\": %d,\n  \"fps\": %d,\n  \"ec\": \"%d/%d\",\n  \"retransmissions\": %d,\n", iSeconds, iFPS, s_iBlockDataPackets, s_iBlockECPackets, s_bRetransmissions);
+         fprintf(fd, "  \"sent_kbps\": %.1f,\n  \"goodput_kbps\": %.1f,\n  \"frames_sent\": %u,\n  \"frames_complete\": %u,\n", fSentKbps, fGoodputKbps, s_uTotalFramesSent, s_uTotalFramesComplete);
+         fprintf(fd, "  \"blocks_clean\": %u,\n  \"blocks_ec_recovered\": %u,\n  \"blocks_retr_recovered\": %u,\n  \"blocks_lost\": %u,\n",
+            s_uTotalBlocksClean, s_uTotalBlocksRecoveredEC, s_uTotalBlocksRecoveredRetr, s_uTotalBlocksLost);
+         fprintf(fd, "  \"retr_requests\": %u,\n  \"retr_packets_requested\": %u,\n  \"retr_packets_sent\": %u,\n", s_uTotalRetrRequestsSent, s_uTotalRetrPacketsRequested, s_uTotalRetrPacketsSent);
+         fprintf(fd, "  \"latency_p50_ms\": %.1f,\n  \"latency_p95_ms\": %.1f,\n  \"latency_p99_ms\": %.1f,\n  \"latency_max_ms\": %.1f\n}\n",
+            (double)uP50/1000.0, (double)uP95/1000.0, (double)uP99/1000.0, (double)s_FramesLatency.uMaxMicros/1000.0);
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+
+   delete pRxBuffer;
+   free(s_pSentBlocks);
+   free(pFrame);
+   if ( NULL != s_pInputFile )
+      free(s_pInputFile);
+   return 0;
+}
@@ -0,0 +1,235 @@
+#include "../base/base.h"
+#include "../base/config_file_names.h"
+#include "../base/log_ring.h"
+
+#include <pthread.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+
+// log_line benchmark: several threads log at the same time, through the logger service
+// message queue (formatted text, one msgsnd for each line), then through the binary log
+// ring (ruby_logger formats the lines), then to the log file directly (no logger service).
+// A consumer thread plays the part of ruby_logger: it reads the lines, checks their content
+// and counts them. Measures the ns per log_line call seen by the logging threads.
+// Uses the logger service message queue: don't run it next to a running ruby_logger.
+//
+// Usage: bench_log [-threads N] [-count N] [-o output.json]
+
+#define BENCH_LOG_FORMAT "Bench line %d from thread %d, stream %s, rate %.2f"
+#define BENCH_LOG_MAX_THREADS 16
+
+#define BENCH_LOG_MODE_MSGQUEUE 0
+#define BENCH_LOG_MODE_RING 1
+#define BENCH_LOG_MODE_FILE 2
+
+static int s_iCountPerThread = 20000;
+static volatile int s_iConsumerStop = 0;
+static int s_iMode = BENCH_LOG_MODE_MSGQUEUE;
+static int s_iMsgQueue = -1;
+static u64 s_uLinesReceived = 0;
+static u64 s_uLinesInvalid = 0;
+
+static const char* s_szStreams[] = { "video", "telemetry", "rc", "audio" };
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static void _check_line(const char* szLine)
+{
+   int iIndex = 0, iThread = 0;
+   if ( 2 != sscanf(szLine, "Bench line %d from thread %d", &iIndex, &iThread) )
+   {
+      s_uLinesInvalid++;
+      return;
+   }
+   char szExpected[MAX_SERVICE_LOG_ENTRY_LENGTH];
+   snprintf(szExpected, sizeof(szExpected), BENCH_LOG_FORMAT, iIndex, iThread, s_szStreams[(iIndex + iThread) % 4], (double)iIndex / 8.0);
+   if ( 0 != strcmp(szLine, szExpected) )
+      s_uLinesInvalid++;
+   s_uLinesReceived++;
+}
+
+static void* _thread_consumer(void* pParam)
+{
+   type_log_ring* pRing = log_ring_open(log_ring_get_name((int)getpid()));
+   u32 uTimeFirstStaleSlot = 0;
+   char szLine[MAX_SERVICE_LOG_ENTRY_LENGTH];
+   type_log_message_buffer logMessage;
+
+   while ( 1 )
+   {
+      int iCount = 0;
+      if ( BENCH_LOG_MODE_MSGQUEUE == s_iMode )
+      {
+         int iLength = msgrcv(s_iMsgQueue, &logMessage, MAX_SERVICE_LOG_ENTRY_LENGTH, 0, MSG_NOERROR | IPC_NOWAIT);
+         if ( iLength > 0 )
+         {
+            logMessage.text[iLength-1] = 0;
+            const char* szText = strstr(logMessage.text, "bench_log: ");
+            if ( NULL != szText )
+               _check_line(szText + strlen("bench_log: "));
+            else
+               s_uLinesInvalid++;
+            iCount++;
+         }
+      }
+      else if ( (BENCH_LOG_MODE_RING == s_iMode) && (NULL != pRing) )
+      {
+         u32 uTime = 0, uLoopCounter = 0;
+         int iLength = log_ring_read_line(pRing, szLine, sizeof(szLine), &uTime, &uLoopCounter, &uTimeFirstStaleSlot);
+         if ( iLength > 0 )
+         {
+            _check_line(szLine);
+            iCount++;
+         }
+      }
+      if ( 0 == iCount )
+      {
+         if ( s_iConsumerStop )
+            break;
+         hardware_sleep_micros(200);
+      }
+   }
+   log_ring_close(pRing);
+   return NULL;
+}
+
+static void* _thread_producer(void* pParam)
+{
+   int iThread = (int)(long)pParam;
+   u64 uTimeStart = _bench_time_ns();
+   for( int i=0; i<s_iCountPerThread; i++ )
+      log_line(BENCH_LOG_FORMAT, i, iThread, s_szStreams[(i + iThread) % 4], (double)i / 8.0);
+   return (void*)(long)((_bench_time_ns() - uTimeStart) / (u64)s_iCountPerThread);
+}
+
+// Returns the average ns per log_line call over all the threads
+static double _run_mode(int iMode, int iThreads, u64* puReceived, u64* puInvalid)
+{
+   s_iMode = iMode;
+   s_iConsumerStop = 0;
+   s_uLinesReceived = 0;
+   s_uLinesInvalid = 0;
+
+   pthread_t consumer;
+   pthread_create(&consumer, NULL, _thread_consumer, NULL);
+
+   pthread_t producers[BENCH_LOG_MAX_THREADS];
+   for( int i=0; i<iThreads; i++ )
+      pthread_create(&producers[i], NULL, _thread_producer, (void*)(long)i);
+   double fTotalNs = 0.0;
+   for( int i=0; i<iThreads; i++ )
+   {
+      void* pResult = NULL;
+      pthread_join(producers[i], &pResult);
+      fTotalNs += (double)(long)pResult;
+   }
+   hardware_sleep_ms(200);
+   s_iConsumerStop = 1;
+   pthread_join(consumer, NULL);
+
+   *puReceived = s_uLinesReceived;
+   *puInvalid = s_uLinesInvalid;
+   return fTotalNs / (double)iThreads;
+}
+
+int main(int argc, char *argv[])
+{
+   int iThreads = 4;
+   const char* szOutputFile = NULL;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-threads")) && (i < argc-1) )
+         iThreads = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-count")) && (i < argc-1) )
+         s_iCountPerThread = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-threads N] [-count N] [-o output.json]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iThreads < 1 )
+      iThreads = 1;
+   if ( iThreads > BENCH_LOG_MAX_THREADS )
+      iThreads = BENCH_LOG_MAX_THREADS;
+   if ( s_iCountPerThread < 1 )
+      s_iCountPerThread = 1;
+
+   printf("\nlog_line benchmark, %d threads, %d lines per thread\n", iThreads, s_iCountPerThread);
+
+   key_t key = generate_msgqueue_key(LOGGER_MESSAGE_QUEUE_ID);
+   s_iMsgQueue = msgget(key, IPC_CREAT | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+   if ( s_iMsgQueue < 0 )
+   {
+      printf("Failed to create the logger message queue.\n");
+      return 1;
+   }
+   log_disable_stdout();
+   log_init("bench_log");
+
+   const char* szModes[] = { "msgqueue", "ring", "file" };
+   double fNsPerCall[3] = { 0.0, 0.0, 0.0 };
+   u64 uReceived[3] = { 0, 0, 0 };
+   u64 uInvalid[3] = { 0, 0, 0 };
+   u64 uTotalLines = (u64)iThreads * (u64)s_iCountPerThread;
+
+   log_use_ring(0);
+   fNsPerCall[0] = _run_mode(BENCH_LOG_MODE_MSGQUEUE, iThreads, &uReceived[0], &uInvalid[0]);
+   log_use_ring(1);
+   fNsPerCall[1] = _run_mode(BENCH_LOG_MODE_RING, iThreads, &uReceived[1], &uInvalid[1]);
+
+   // Direct writes to the log file, as processes do when the logger service is not available
+   bool bFileMode = (0 == access(FOLDER_LOGS, W_OK));
+   if ( bFileMode )
+   {
+      log_init_local_only("bench_log");
+      fNsPerCall[2] = _run_mode(BENCH_LOG_MODE_FILE, iThreads, &uReceived[2], &uInvalid[2]);
+   }
+
+   msgctl(s_iMsgQueue, IPC_RMID, NULL);
+   shm_unlink(log_ring_get_name((int)getpid()));
+
+   for( int i=0; i<3; i++ )
+   {
+      if ( (2 == i) && (! bFileMode) )
+      {
+         printf("%-9s: skipped, no write access to %s\n", szModes[i], FOLDER_LOGS);
+         continue;
+      }
+      if ( 2 == i )
+         printf("%-9s: %8.0f ns/call\n", szModes[i], fNsPerCall[i]);
+      else
+         printf("%-9s: %8.0f ns/call, %llu of %llu lines delivered to the consumer (%llu dropped), %llu invalid\n",
+            szModes[i], fNsPerCall[i], uReceived[i], uTotalLines, uTotalLines - uReceived[i], uInvalid[i]);
+   }
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"log\",\n  \"threads\": %d,\n  \"lines_per_thread\": %d,\n", iThreads, s_iCountPerThread);
+         fprintf(fd, "  \"msgqueue_ns_per_call\": %.1f,\n  \"msgqueue_delivered\": %llu,\n", fNsPerCall[0], uReceived[0]);
+         fprintf(fd, "  \"ring_ns_per_call\": %.1f,\n  \"ring_delivered\": %llu,\n", fNsPerCall[1], uReceived[1]);
+         fprintf(fd, "  \"file_ns_per_call\": %.1f\n}\n", fNsPerCall[2]);
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+
+   if ( (0 != uInvalid[0]) || (0 != uInvalid[1]) )
+   {
+      printf("FAILED: invalid log lines received.\n");
+      return 1;
+   }
+   return 0;
+}
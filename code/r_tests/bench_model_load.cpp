@@ -0,0 +1,118 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+
+// Model load time benchmark: full load from the text model file (fscanf parsing), full load
+// from the binary model file (mmap, CRC checks and copy), a reload check when nothing changed and
+// a reload after a change to just one section (what processes do on model changed notifications).
+//
+// Usage: bench_model_load [-count N] [-o output.json]
+
+#define BENCH_FOLDER "/tmp/bench_model_load/"
+#define BENCH_FILE BENCH_FOLDER "model.mdl"
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+   int iCount = 200;
+   const char* szOutputFile = NULL;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-count")) && (i < argc-1) )
+         iCount = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-count N] [-o output.json]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iCount < 1 )
+      iCount = 1;
+
+   printf("\nModel load benchmark, %d loads for each case\n", iCount);
+   log_disable();
+   if ( system("mkdir -p " BENCH_FOLDER) ) {}
+
+   Model* pModel = new Model();
+   pModel->resetToDefaults(true);
+   if ( ! pModel->saveToFile(BENCH_FILE, false) )
+   {
+      printf("Failed to save the model to %s\n", BENCH_FILE);
+      return 1;
+   }
+
+   Model* pReader = new Model();
+   int iFailures = 0;
+
+   u64 uTime = _bench_time_ns();
+   for( int i=0; i<iCount; i++ )
+      if ( ! pReader->loadFromTextFile(BENCH_FILE) )
+         iFailures++;
+   double fTextUs = (double)(_bench_time_ns() - uTime) / 1000.0 / (double)iCount;
+
+   uTime = _bench_time_ns();
+   for( int i=0; i<iCount; i++ )
+      if ( ! pReader->loadFromBinaryFile(BENCH_FILE, true, false) )
+         iFailures++;
+   double fBinaryUs = (double)(_bench_time_ns() - uTime) / 1000.0 / (double)iCount;
+
+   uTime = _bench_time_ns();
+   for( int i=0; i<iCount; i++ )
+      if ( ! pReader->reloadFromFileIfChanged(BENCH_FILE, true) )
+         iFailures++;
+   double fNoChangeUs = (double)(_bench_time_ns() - uTime) / 1000.0 / (double)iCount;
+
+   // One section changed on each save; only the reload is timed
+   u64 uTotalReload = 0;
+   for( int i=0; i<iCount; i++ )
+   {
+      pModel->osd_params.osd_flags[0] ^= 0x01;
+      pModel->saveToFile(BENCH_FILE, false);
+      uTime = _bench_time_ns();
+      if ( ! pReader->reloadFromFileIfChanged(BENCH_FILE, true) )
+         iFailures++;
+      uTotalReload += _bench_time_ns() - uTime;
+      if ( pReader->getLastLoadedBinarySectionsMask() != (((u32)1) << MODEL_BIN_SECTION_OSD) )
+         iFailures++;
+   }
+   double fOneSectionUs = (double)uTotalReload / 1000.0 / (double)iCount;
+
+   delete pReader;
+   delete pModel;
+   if ( system("rm -rf " BENCH_FOLDER) ) {}
+
+   printf("text file load         : %9.1f us\n", fTextUs);
+   printf("binary file load       : %9.1f us\n", fBinaryUs);
+   printf("reload, no change      : %9.1f us\n", fNoChangeUs);
+   printf("reload, 1 section      : %9.1f us\n", fOneSectionUs);
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"model_load\",\n  \"count\": %d,\n", iCount);
+         fprintf(fd, "  \"text_load_us\": %.1f,\n  \"binary_load_us\": %.1f,\n", fTextUs, fBinaryUs);
+         fprintf(fd, "  \"reload_no_change_us\": %.1f,\n  \"reload_one_section_us\": %.1f\n}\n", fNoChangeUs, fOneSectionUs);
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d load errors.\n", iFailures);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,222 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+#include "../base/controller_rt_info.h"
+#include "../base/hardware_radio.h"
+#include "../base/packet_pool.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/radio_rx_queue.h"
+#include "../radio/fec.h"
+#include "../r_station/video_rx_buffers.h"
+#include "video_link_fixture.h"
+
+// Packet copies on the station video receive path: video packets (EC encoded blocks, random losses) go
+// through the radio rx queue (as pushed by the radio rx thread), then to the VideoRxPacketsBuffer (EC
+// recovery) and are read back in order as the video output does. Runs the path twice: with the packet
+// pool hand off disabled (the rx queue packet is copied again in the video buffer) and enabled (the video
+// buffer keeps a reference to the rx queue packet). Reports the bytes copied and zeroed per delivered video
+// byte, the pool allocations and ns per packet. The copy out of the capture buffer into the rx queue is
+// counted; the video output copy (same in both cases) is not.
+//
+// Usage: bench_packet_pool [-packets N] [-data N] [-ec N] [-psize bytes] [-loss percent] [-o output.json]
+
+#define BENCH_TEMPLATE_BLOCKS 32
+
+typedef struct
+{
+   const char* szName;
+   double fCopiedPerByte;
+   double fZeroedPerByte;
+   double fCopiesPerPacket;
+   double fAllocationsPerPacket;
+   double fNsPerPacket;
+   u64 uDeliveredBytes;
+   u32 uDeliveredCRC;
+   u32 uLostBlocks;
+} type_bench_result;
+
+static int s_iBlockDataPackets = 8;
+static int s_iBlockECPackets = 4;
+static int s_iBlockPacketSize = 1150;
+static u8 s_uTemplatePackets[BENCH_TEMPLATE_BLOCKS][MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_TOTAL_SIZE];
+static int s_iTemplateLengths[BENCH_TEMPLATE_BLOCKS][MAX_TOTAL_PACKETS_IN_BLOCK];
+static u32 s_uRandom = 0x9E3779B9;
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static void _set_packet_headers(u8* pPacket, int iLength, u32 uBlockIndex, int iPacketIndex, u32 uStreamPacketIndex)
+{
+   // Four blocks per frame
+   int iPacketInFrame = (int)(uBlockIndex % 4)*s_iBlockDataPackets + ((iPacketIndex < s_iBlockDataPackets)?iPacketIndex:(s_iBlockDataPackets-1));
+   video_fixture_set_packet_headers(pPacket, iLength, uBlockIndex, iPacketIndex, s_iBlockDataPackets, s_iBlockECPackets, s_iBlockPacketSize,
+      (u16)(uBlockIndex/4), 4*s_iBlockDataPackets, iPacketInFrame, uStreamPacketIndex);
+}
+
+typedef struct
+{
+   u64 uBytes;
+   u32 uCRC;
+} type_bench_output;
+
+static void _output_packet(type_rx_video_block_info* pBlock, type_rx_video_packet_info* pPacket, void* pContext)
+{
+   type_bench_output* pOutput = (type_bench_output*)pContext;
+   pOutput->uBytes += pPacket->pPHVSImp->uVideoDataLength;
+   pOutput->uCRC += base_compute_crc32(pPacket->pVideoData + sizeof(t_packet_header_video_segment_important), pPacket->pPHVSImp->uVideoDataLength);
+}
+
+// The bottom block is dropped once it's a few blocks behind
+static bool _can_discard_block(VideoRxPacketsBuffer* pRxBuffer, type_rx_video_block_info* pBlock, void* pContext)
+{
+   return (pRxBuffer->getCountBlocksInBuffer() >= 3);
+}
+
+static void _run(type_bench_result* pResult, int iHandoff, int iPackets, int iLossPercent)
+{
+   packet_pool_set_handoff_enabled(iHandoff);
+   s_uRandom = 0x12345678;
+
+   Model model;
+   VideoRxPacketsBuffer* pRxBuffer = new VideoRxPacketsBuffer(0, 0);
+   pRxBuffer->init(&model);
+   type_radio_rx_queue queue;
+   radio_rx_queue_init(&queue, 64, NULL);
+
+   type_packet_pool_stats statsStart;
+   packet_pool_reset_stats();
+   packet_pool_get_stats(&statsStart);
+
+   int iBlockPackets = s_iBlockDataPackets + s_iBlockECPackets;
+   type_bench_output output;
+   memset(&output, 0, sizeof(output));
+   u32 uLostBlocks = 0;
+   u32 uStreamPacketIndex = 0;
+   u64 uStart = _bench_time_ns();
+   for( int i=0; i<iPackets; i++ )
+   {
+      u32 uBlockIndex = (u32)(i / iBlockPackets) + 1;
+      int iPacketIndex = i % iBlockPackets;
+      int iTemplate = (int)(uBlockIndex % BENCH_TEMPLATE_BLOCKS);
+      uStreamPacketIndex++;
+      if ( (int)(video_fixture_random(&s_uRandom) % 100) < iLossPercent )
+         continue;
+
+      // Radio rx thread: the packet is read (in the capture buffer) and queued
+      u8* pCapture = s_uTemplatePackets[iTemplate][iPacketIndex];
+      int iLength = s_iTemplateLengths[iTemplate][iPacketIndex];
+      _set_packet_headers(pCapture, iLength, uBlockIndex, iPacketIndex, uStreamPacketIndex);
+      radio_rx_queue_push_timed(&queue, pCapture, iLength, 0, 0);
+
+      // Router: borrow from the rx queue, add to the video buffer, output
+      int iRxLength = 0;
+      u8* pPacket = radio_rx_queue_borrow(&queue, 0, &iRxLength, NULL);
+      if ( NULL == pPacket )
+         continue;
+      pRxBuffer->checkAddVideoPacket(pPacket, iRxLength, 0);
+      radio_rx_queue_release(&queue);
+      uLostBlocks += (u32)video_fixture_output_available_packets(pRxBuffer, _output_packet, _can_discard_block, &output);
+   }
+   u64 uElapsed = _bench_time_ns() - uStart;
+
+   type_packet_pool_stats stats;
+   packet_pool_get_stats(&stats);
+   radio_rx_queue_free(&queue);
+   delete pRxBuffer;
+
+   pResult->szName = iHandoff?"hand off":"copy";
+   pResult->uDeliveredBytes = output.uBytes;
+   pResult->uDeliveredCRC = output.uCRC;
+   pResult->uLostBlocks = uLostBlocks;
+   double fDelivered = (output.uBytes > 0)?(double)output.uBytes:1.0;
+   pResult->fCopiedPerByte = (double)stats.uBytesCopied / fDelivered;
+   pResult->fZeroedPerByte = (double)stats.uBytesZeroed / fDelivered;
+   pResult->fCopiesPerPacket = (double)stats.uCopies / (double)iPackets;
+   pResult->fAllocationsPerPacket = (double)(stats.uAllocations - statsStart.uAllocations) / (double)iPackets;
+   pResult->fNsPerPacket = (double)uElapsed / (double)iPackets;
+}
+
+int main(int argc, char *argv[])
+{
+   int iPackets = 2000000;
+   int iLossPercent = 5;
+   const char* szOutputFile = NULL;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-packets")) && (i < argc-1) )
+         iPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-data")) && (i < argc-1) )
+         s_iBlockDataPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-ec")) && (i < argc-1) )
+         s_iBlockECPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-psize")) && (i < argc-1) )
+         s_iBlockPacketSize = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-loss")) && (i < argc-1) )
+         iLossPercent = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-packets N] [-data N] [-ec N] [-psize bytes] [-loss percent] [-o output.json]\n", argv[0]);
+         return 1;
+      }
+   }
+   int iMaxPacketSize = MAX_PACKET_TOTAL_SIZE - (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   if ( (s_iBlockDataPackets < 1) || (s_iBlockDataPackets > MAX_DATA_PACKETS_IN_BLOCK) || (s_iBlockECPackets < 0) ||
+        (s_iBlockDataPackets + s_iBlockECPackets > MAX_TOTAL_PACKETS_IN_BLOCK) ||
+        (s_iBlockPacketSize < 100) || (s_iBlockPacketSize > iMaxPacketSize) )
+   {
+      printf("Invalid block scheme, max packet size is %d bytes.\n", iMaxPacketSize);
+      return 1;
+   }
+   if ( iPackets < 10000 )
+      iPackets = 10000;
+
+   log_disable();
+   hardware_radio_set_simulated_interfaces(1);
+   g_TimeStart = get_current_timestamp_ms();
+   g_TimeNow = g_TimeStart + 10000;
+   fec_init();
+   memset(&g_SMControllerRTInfo, 0, sizeof(controller_runtime_info));
+   video_fixture_build_random_blocks(s_uTemplatePackets, s_iTemplateLengths, BENCH_TEMPLATE_BLOCKS, s_iBlockDataPackets, s_iBlockECPackets, s_iBlockPacketSize, &s_uRandom);
+
+   printf("\nStation video rx path copies: %d packets, blocks %d/%d, %d bytes video packets, %d%% loss\n",
+      iPackets, s_iBlockDataPackets, s_iBlockECPackets, s_iBlockPacketSize, iLossPercent);
+
+   type_bench_result results[2];
+   _run(&results[0], 0, iPackets, iLossPercent);
+   _run(&results[1], 1, iPackets, iLossPercent);
+
+   for( int i=0; i<2; i++ )
+   {
+      printf("%-8s: copied %.3f bytes, zeroed %.3f bytes per video byte; %.2f copies, %.2f pool allocations, %.1f ns per packet; %llu video bytes, %u lost blocks\n",
+         results[i].szName, results[i].fCopiedPerByte, results[i].fZeroedPerByte, results[i].fCopiesPerPacket,
+         results[i].fAllocationsPerPacket, results[i].fNsPerPacket, (unsigned long long)results[i].uDeliveredBytes, results[i].uLostBlocks);
+   }
+   int iOk = ((results[0].uDeliveredBytes == results[1].uDeliveredBytes) && (results[0].uDeliveredCRC == results[1].uDeliveredCRC))?1:0;
+   if ( ! iOk )
+      printf("Delivered video differs between the two runs!\n");
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"packet_pool\",\n  \"packets\": %d,\n  \"data_packets\": %d,\n  \"ec_packets\": %d,\n  \"packet_size\": %d,\n  \"loss_percent\": %d,\n",
+            iPackets, s_iBlockDataPackets, s_iBlockECPackets, s_iBlockPacketSize, iLossPercent);
+         for( int i=0; i<2; i++ )
+            fprintf(fd, "  \"%s\": { \"bytes_copied_per_video_byte\": %.4f, \"bytes_zeroed_per_video_byte\": %.4f, \"copies_per_packet\": %.3f, \"allocations_per_packet\": %.3f, \"ns_per_packet\": %.1f }%s\n",
+               i?"handoff":"copy", results[i].fCopiedPerByte, results[i].fZeroedPerByte, results[i].fCopiesPerPacket, results[i].fAllocationsPerPacket, results[i].fNsPerPacket, i?"":",");
+         fprintf(fd, "}\n");
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+   return iOk?0:1;
+}
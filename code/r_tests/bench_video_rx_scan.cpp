@@ -0,0 +1,430 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+#include "../base/controller_rt_info.h"
+#include "../base/hardware_radio.h"
+#include "../base/packet_pool.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/fec.h"
+#include "../r_station/video_rx_buffers.h"
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// Missing packets scan of the station video rx buffer, as done by the retransmissions requests
+// (ProcessorRxVideo::checkAndRequestMissingPackets): a window of blocks (as many as the rx buffer holds, up to 100)
+// with random losses is received in the VideoRxPacketsBuffer, then the window is scanned for the packets to request.
+// Compares the scan on the packets state bitmasks of the rx blocks with the same scan on the previous layout
+// (per packet structs with the state flags interleaved with the packet pointers, mirrored from the same blocks).
+// Reports ns per scan with warm caches and with the caches evicted before each scan, and the cache misses
+// per scan from the CPU perf counters, if they are available.
+//
+// Usage: bench_video_rx_scan [-blocks N] [-data N] [-ec N] [-loss percent] [-scans N] [-o output.json]
+
+// Globals the station video rx buffer uses
+controller_runtime_info g_SMControllerRTInfo;
+u32 g_TimeLastVideoParametersOrProfileChanged = 0;
+
+#define BENCH_MAX_REQUESTS 2048
+#define BENCH_EVICT_SIZE (16*1024*1024)
+
+// Previous layout of the rx blocks
+typedef struct
+{
+   u8* pRawData;
+   u8* pVideoData;
+   t_packet_header* pPH;
+   t_packet_header_video_segment* pPHVS;
+   t_packet_header_video_segment_important* pPHVSImp;
+   u32 uReceivedTime;
+   u32 uRequestedTime;
+   u64 uTraceRxMicros;
+   bool bEmpty;
+   bool bReconstructed;
+} type_bench_aos_packet_info;
+
+typedef struct
+{
+   type_bench_aos_packet_info packets[MAX_TOTAL_PACKETS_IN_BLOCK];
+   u16 uH264FrameIndex;
+   u32 uVideoBlockIndex;
+   int iTotalFramePackets;
+   int iFramePacketStart;
+   int iFramePacketEnd;
+   int iMaxReceivedDataPacketIndex;
+   int iMaxReceivedDataOrECPacketIndex;
+   int iLastRecordedEOF;
+   u32 uReceivedTime;
+   u64 uTraceFirstRxMicros;
+   int iBlockDataSize;
+   int iBlockDataPackets;
+   int iBlockECPackets;
+   int iRecvDataPackets;
+   int iRecvECPackets;
+   int iReconstructedECUsed;
+} type_bench_aos_block_info;
+
+typedef struct
+{
+   const char* szName;
+   double fNsPerScanWarm;
+   double fNsPerScanCold;
+   double fCacheMissesPerScan;
+   double fL1DMissesPerScan;
+   int iRequested;
+} type_bench_result;
+
+static int s_iBlockDataPackets = 16;
+static int s_iBlockECPackets = 4;
+static int s_iBlockPacketSize = 1200;
+static u32 s_uRandom = 0x9E3779B9;
+static type_bench_aos_block_info s_AOSBlocks[MAX_RXTX_BLOCKS_BUFFER];
+static u8 s_uRequests[BENCH_MAX_REQUESTS*5];
+static u8* s_pEvictBuffer = NULL;
+static int s_iPerfFdCacheMisses = -1;
+static int s_iPerfFdL1DMisses = -1;
+
+static u32 _bench_random()
+{
+   s_uRandom ^= s_uRandom << 13;
+   s_uRandom ^= s_uRandom >> 17;
+   s_uRandom ^= s_uRandom << 5;
+   return s_uRandom;
+}
+
+static u64 _bench_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static int _bench_open_perf_counter(u32 uType, u64 uConfig)
+{
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = uType;
+   attr.config = uConfig;
+   attr.disabled = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static u64 _bench_read_perf_counter(int iFd)
+{
+   u64 uValue = 0;
+   if ( iFd < 0 )
+      return 0;
+   if ( read(iFd, &uValue, sizeof(uValue)) != sizeof(uValue) )
+      return 0;
+   return uValue;
+}
+
+static void _bench_evict_caches()
+{
+   for( int i=0; i<BENCH_EVICT_SIZE; i += 64 )
+      s_pEvictBuffer[i]++;
+}
+
+static void _bench_fill_window(VideoRxPacketsBuffer* pRxBuffer, int iBlocks, int iLossPercent)
+{
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+   int iLength = (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment)) + s_iBlockPacketSize;
+   u32 uStreamPacketIndex = 0;
+   for( int b=0; b<iBlocks; b++ )
+   for( int k=0; k<s_iBlockDataPackets + s_iBlockECPackets; k++ )
+   {
+      uStreamPacketIndex++;
+      // Keep the first packet of each block, so that all the blocks are in the window
+      if ( (k > 0) && ((int)(_bench_random() % 100) < iLossPercent) )
+         continue;
+      memset(uPacket, 0, iLength);
+      t_packet_header* pPH = (t_packet_header*)uPacket;
+      t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(uPacket + sizeof(t_packet_header));
+      t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(uPacket + sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+      radio_packet_init(pPH, PACKET_COMPONENT_VIDEO | PACKET_FLAGS_BIT_HEADERS_ONLY_CRC, PACKET_TYPE_VIDEO_DATA, STREAM_ID_VIDEO_1);
+      pPH->vehicle_id_src = 1;
+      pPH->stream_packet_idx |= uStreamPacketIndex & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+      pPH->total_length = (u16)iLength;
+      pPHVS->uVideoStreamIndexAndType = 0 | (VIDEO_TYPE_H264 << 4);
+      pPHVS->uCurrentBlockIndex = (u32)b + 1;
+      pPHVS->uCurrentBlockPacketIndex = (u8)k;
+      pPHVS->uCurrentBlockPacketSize = (u16)s_iBlockPacketSize;
+      pPHVS->uCurrentBlockDataPackets = (u8)s_iBlockDataPackets;
+      pPHVS->uCurrentBlockECPackets = (u8)s_iBlockECPackets;
+      pPHVS->uH264FrameIndex = (u16)(b/4);
+      pPHVS->uFramePacketsInfo = (u16)(((4*s_iBlockDataPackets) << 8) | (((b % 4)*s_iBlockDataPackets + ((k < s_iBlockDataPackets)?k:(s_iBlockDataPackets-1))) & 0xFF));
+      if ( k < s_iBlockDataPackets )
+         pPHVSImp->uVideoDataLength = (u16)(s_iBlockPacketSize - (int)sizeof(t_packet_header_video_segment_important));
+      pRxBuffer->checkAddVideoPacket(uPacket, iLength, 0);
+   }
+}
+
+// Previous layout copy of the rx buffer blocks
+static void _bench_mirror_window(VideoRxPacketsBuffer* pRxBuffer, int iBlocks)
+{
+   memset(s_AOSBlocks, 0, sizeof(s_AOSBlocks));
+   for( int i=0; i<iBlocks; i++ )
+   {
+      type_rx_video_block_info* pBlock = pRxBuffer->getBlockInBufferFromBottom(i);
+      type_bench_aos_block_info* pAOSBlock = &s_AOSBlocks[i];
+      pAOSBlock->uH264FrameIndex = pBlock->uH264FrameIndex;
+      pAOSBlock->uVideoBlockIndex = pBlock->uVideoBlockIndex;
+      pAOSBlock->iMaxReceivedDataOrECPacketIndex = pBlock->iMaxReceivedDataOrECPacketIndex;
+      pAOSBlock->uReceivedTime = pBlock->uReceivedTime;
+      pAOSBlock->iBlockDataSize = pBlock->iBlockDataSize;
+      pAOSBlock->iBlockDataPackets = pBlock->iBlockDataPackets;
+      pAOSBlock->iBlockECPackets = pBlock->iBlockECPackets;
+      pAOSBlock->iRecvDataPackets = pBlock->iRecvDataPackets;
+      pAOSBlock->iRecvECPackets = pBlock->iRecvECPackets;
+      for( int k=0; k<MAX_TOTAL_PACKETS_IN_BLOCK; k++ )
+      {
+         pAOSBlock->packets[k].pRawData = pBlock->packets[k].pRawData;
+         pAOSBlock->packets[k].pVideoData = pBlock->packets[k].pVideoData;
+         pAOSBlock->packets[k].pPH = pBlock->packets[k].pPH;
+         pAOSBlock->packets[k].pPHVS = pBlock->packets[k].pPHVS;
+         pAOSBlock->packets[k].pPHVSImp = pBlock->packets[k].pPHVSImp;
+         pAOSBlock->packets[k].bEmpty = (pBlock->uReceivedMask & VIDEO_RX_PACKET_BIT(k))?false:true;
+         pAOSBlock->packets[k].bReconstructed = (pBlock->uReconstructedMask & VIDEO_RX_PACKET_BIT(k))?true:false;
+      }
+   }
+}
+
+// Not inlined, as the rx buffer getBlockInBufferFromBottom used by the bitmasks scan
+static type_bench_aos_block_info* __attribute__((noinline)) _bench_get_aos_block_from_bottom(int iDeltaPosition)
+{
+   int iIndex = iDeltaPosition;
+   if ( iIndex >= MAX_RXTX_BLOCKS_BUFFER )
+      iIndex -= MAX_RXTX_BLOCKS_BUFFER;
+   return &s_AOSBlocks[iIndex];
+}
+
+// Same scan as the retransmissions requests (blocks before the top block)
+static int _bench_scan_aos(int iBlocks, bool* pbReRequested)
+{
+   int iCountRequested = 0;
+   u8* pRequests = s_uRequests;
+   for( int i=0; i<iBlocks-1; i++ )
+   {
+      type_bench_aos_block_info* pVideoBlock = _bench_get_aos_block_from_bottom(i);
+      if ( 0 == (pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) )
+         continue;
+      int iCountToRequestFromBlock = pVideoBlock->iBlockDataPackets - pVideoBlock->iRecvDataPackets - pVideoBlock->iRecvECPackets;
+      if ( iCountToRequestFromBlock <= 0 )
+         continue;
+
+      for( int k=0; k<pVideoBlock->iBlockDataPackets+1; k++ )
+      {
+         if ( NULL == pVideoBlock->packets[k].pRawData )
+            continue;
+         if ( ! pVideoBlock->packets[k].bEmpty )
+            continue;
+         if ( 0 != pVideoBlock->packets[k].uRequestedTime )
+            *pbReRequested = true;
+         pVideoBlock->packets[k].uRequestedTime = g_TimeNow;
+         memcpy(pRequests, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
+         pRequests[4] = (u8)k;
+         pRequests += 5;
+         iCountRequested++;
+         iCountToRequestFromBlock--;
+         if ( (0 == iCountToRequestFromBlock) || (iCountRequested >= BENCH_MAX_REQUESTS) )
+            break;
+      }
+      if ( iCountRequested >= BENCH_MAX_REQUESTS )
+         break;
+   }
+   return iCountRequested;
+}
+
+static int _bench_scan_bitmasks(VideoRxPacketsBuffer* pRxBuffer, int iBlocks, bool* pbReRequested)
+{
+   int iCountRequested = 0;
+   u8* pRequests = s_uRequests;
+   for( int i=0; i<iBlocks-1; i++ )
+   {
+      type_rx_video_block_info* pVideoBlock = pRxBuffer->getBlockInBufferFromBottom(i);
+      if ( 0 == (pVideoBlock->iRecvDataPackets + pVideoBlock->iRecvECPackets) )
+         continue;
+      int iCountToRequestFromBlock = pVideoBlock->iBlockDataPackets - pVideoBlock->iRecvDataPackets - pVideoBlock->iRecvECPackets;
+      if ( iCountToRequestFromBlock <= 0 )
+         continue;
+
+      u32 uMissingMask = pVideoBlock->uAllocatedMask & (~pVideoBlock->uReceivedMask) & VIDEO_RX_PACKETS_MASK(pVideoBlock->iBlockDataPackets+1);
+      while ( 0 != uMissingMask )
+      {
+         int k = __builtin_ctz(uMissingMask);
+         uMissingMask &= uMissingMask - 1;
+         if ( pVideoBlock->uRequestedMask & VIDEO_RX_PACKET_BIT(k) )
+            *pbReRequested = true;
+         pVideoBlock->uRequestedMask |= VIDEO_RX_PACKET_BIT(k);
+         pVideoBlock->uPacketsRequestedTime[k] = g_TimeNow;
+         memcpy(pRequests, &pVideoBlock->uVideoBlockIndex, sizeof(u32));
+         pRequests[4] = (u8)k;
+         pRequests += 5;
+         iCountRequested++;
+         iCountToRequestFromBlock--;
+         if ( (0 == iCountToRequestFromBlock) || (iCountRequested >= BENCH_MAX_REQUESTS) )
+            break;
+      }
+      if ( iCountRequested >= BENCH_MAX_REQUESTS )
+         break;
+   }
+   return iCountRequested;
+}
+
+static int _bench_scan(VideoRxPacketsBuffer* pRxBuffer, int iBlocks, int iBitmasks, bool* pbReRequested)
+{
+   if ( iBitmasks )
+      return _bench_scan_bitmasks(pRxBuffer, iBlocks, pbReRequested);
+   return _bench_scan_aos(iBlocks, pbReRequested);
+}
+
+static void _bench_run(type_bench_result* pResult, VideoRxPacketsBuffer* pRxBuffer, int iBlocks, int iBitmasks, int iScans)
+{
+   bool bReRequested = false;
+   pResult->szName = iBitmasks?"bitmasks":"structs";
+   pResult->iRequested = _bench_scan(pRxBuffer, iBlocks, iBitmasks, &bReRequested);
+
+   u64 uStart = _bench_time_ns();
+   for( int i=0; i<iScans; i++ )
+      _bench_scan(pRxBuffer, iBlocks, iBitmasks, &bReRequested);
+   pResult->fNsPerScanWarm = (double)(_bench_time_ns() - uStart)/(double)iScans;
+
+   int iColdScans = iScans/100;
+   if ( iColdScans < 20 )
+      iColdScans = 20;
+   u64 uTotalNs = 0;
+   u64 uCacheMisses = 0;
+   u64 uL1DMisses = 0;
+   for( int i=0; i<iColdScans; i++ )
+   {
+      _bench_evict_caches();
+      u64 uMisses = _bench_read_perf_counter(s_iPerfFdCacheMisses);
+      u64 uL1D = _bench_read_perf_counter(s_iPerfFdL1DMisses);
+      uStart = _bench_time_ns();
+      _bench_scan(pRxBuffer, iBlocks, iBitmasks, &bReRequested);
+      uTotalNs += _bench_time_ns() - uStart;
+      uCacheMisses += _bench_read_perf_counter(s_iPerfFdCacheMisses) - uMisses;
+      uL1DMisses += _bench_read_perf_counter(s_iPerfFdL1DMisses) - uL1D;
+   }
+   pResult->fNsPerScanCold = (double)uTotalNs/(double)iColdScans;
+   pResult->fCacheMissesPerScan = (double)uCacheMisses/(double)iColdScans;
+   pResult->fL1DMissesPerScan = (double)uL1DMisses/(double)iColdScans;
+}
+
+int main(int argc, char *argv[])
+{
+   int iBlocks = 100;
+   int iLossPercent = 10;
+   int iScans = 20000;
+   const char* szOutputFile = NULL;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-blocks")) && (i < argc-1) )
+         iBlocks = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-data")) && (i < argc-1) )
+         s_iBlockDataPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-ec")) && (i < argc-1) )
+         s_iBlockECPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-loss")) && (i < argc-1) )
+         iLossPercent = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-scans")) && (i < argc-1) )
+         iScans = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-o")) && (i < argc-1) )
+         szOutputFile = argv[++i];
+      else
+      {
+         printf("Usage: %s [-blocks N] [-data N] [-ec N] [-loss percent] [-scans N] [-o output.json]\n", argv[0]);
+         return 1;
+      }
+   }
+   if ( (s_iBlockDataPackets < 1) || (s_iBlockDataPackets > MAX_DATA_PACKETS_IN_BLOCK) || (s_iBlockECPackets < 0) ||
+        (s_iBlockDataPackets + s_iBlockECPackets > MAX_TOTAL_PACKETS_IN_BLOCK) || (iScans < 1) )
+   {
+      printf("Invalid parameters.\n");
+      return 1;
+   }
+   // The rx buffer takes a new top block only while it has at least two free blocks
+   if ( iBlocks > MAX_RXTX_BLOCKS_BUFFER-2 )
+      iBlocks = MAX_RXTX_BLOCKS_BUFFER-2;
+
+   log_disable();
+   hardware_radio_set_simulated_interfaces(1);
+   g_TimeStart = get_current_timestamp_ms();
+   g_TimeNow = g_TimeStart + 10000;
+   memset(&g_SMControllerRTInfo, 0, sizeof(controller_runtime_info));
+   fec_init();
+
+   s_pEvictBuffer = (u8*)malloc(BENCH_EVICT_SIZE);
+   if ( NULL == s_pEvictBuffer )
+      return 1;
+   memset(s_pEvictBuffer, 0, BENCH_EVICT_SIZE);
+
+   s_iPerfFdCacheMisses = _bench_open_perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+   s_iPerfFdL1DMisses = _bench_open_perf_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+   if ( s_iPerfFdCacheMisses >= 0 )
+      ioctl(s_iPerfFdCacheMisses, PERF_EVENT_IOC_ENABLE, 0);
+   if ( s_iPerfFdL1DMisses >= 0 )
+      ioctl(s_iPerfFdL1DMisses, PERF_EVENT_IOC_ENABLE, 0);
+
+   Model model;
+   VideoRxPacketsBuffer* pRxBuffer = new VideoRxPacketsBuffer(0, 0);
+   pRxBuffer->init(&model);
+   _bench_fill_window(pRxBuffer, iBlocks, iLossPercent);
+   if ( pRxBuffer->getCountBlocksInBuffer() != iBlocks )
+   {
+      printf("Failed to fill the rx buffer window (%d of %d blocks).\n", pRxBuffer->getCountBlocksInBuffer(), iBlocks);
+      return 1;
+   }
+   _bench_mirror_window(pRxBuffer, iBlocks);
+
+   printf("\nStation video rx missing packets scan: %d blocks window, blocks %d/%d, %d%% loss, block size: %d bytes (was %d bytes)\n",
+      iBlocks, s_iBlockDataPackets, s_iBlockECPackets, iLossPercent, (int)sizeof(type_rx_video_block_info), (int)sizeof(type_bench_aos_block_info));
+
+   type_bench_result results[2];
+   _bench_run(&results[0], pRxBuffer, iBlocks, 0, iScans);
+   _bench_run(&results[1], pRxBuffer, iBlocks, 1, iScans);
+
+   bool bPerfCounters = (s_iPerfFdCacheMisses >= 0) || (s_iPerfFdL1DMisses >= 0);
+   for( int i=0; i<2; i++ )
+   {
+      printf("%-8s: %d packets requested per scan; %.1f ns per scan (warm), %.1f ns per scan (caches evicted)",
+         results[i].szName, results[i].iRequested, results[i].fNsPerScanWarm, results[i].fNsPerScanCold);
+      if ( bPerfCounters )
+         printf(", %.1f cache misses, %.1f L1D read misses per scan\n", results[i].fCacheMissesPerScan, results[i].fL1DMissesPerScan);
+      else
+         printf("\n");
+   }
+   if ( ! bPerfCounters )
+      printf("CPU perf counters not available (perf_event_open failed, error: %d), cache misses not measured.\n", errno);
+
+   int iOk = (results[0].iRequested == results[1].iRequested)?1:0;
+   if ( ! iOk )
+      printf("The two scans requested different packets!\n");
+
+   if ( NULL != szOutputFile )
+   {
+      FILE* fd = fopen(szOutputFile, "w");
+      if ( NULL == fd )
+         printf("Failed to create output file %s\n", szOutputFile);
+      else
+      {
+         fprintf(fd, "{\n  \"benchmark\": \"video_rx_scan\",\n  \"blocks\": %d,\n  \"data_packets\": %d,\n  \"ec_packets\": %d,\n  \"loss_percent\": %d,\n",
+            iBlocks, s_iBlockDataPackets, s_iBlockECPackets, iLossPercent);
+         for( int i=0; i<2; i++ )
+            fprintf(fd, "  \"%s\": { \"requested\": %d, \"ns_per_scan_warm\": %.1f, \"ns_per_scan_cold\": %.1f, \"cache_misses_per_scan\": %.1f, \"l1d_misses_per_scan\": %.1f }%s\n",
+               results[i].szName, results[i].iRequested, results[i].fNsPerScanWarm, results[i].fNsPerScanCold,
+               results[i].fCacheMissesPerScan, results[i].fL1DMissesPerScan, i?"":",");
+         fprintf(fd, "}\n");
+         fclose(fd);
+         printf("Results written to %s\n", szOutputFile);
+      }
+   }
+
+   delete pRxBuffer;
+   free(s_pEvictBuffer);
+   return iOk?0:1;
+}
@@ -0,0 +1,331 @@
+#include "../base/base.h"
+#include "../base/chacha20_poly1305.h"
+#include "../base/encr.h"
+#include "../radio/radiopackets2.h"
+
+// Known answer tests for ChaCha20, Poly1305 and the ChaCha20-Poly1305 AEAD (RFC 8439 test vectors),
+// on all the ChaCha20 engines supported by this CPU. Also checks that the engines agree on all
+// lengths and that modified ciphertext, additional data or tags are rejected and left untouched.
+// Radio packets: two sessions (restarts) never encrypt with the same key and nonce.
+
+extern u8 s_epp[MAX_PASS_LENGTH+1];
+extern u8 s_eppl;
+
+static const char* s_szSunscreen = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+
+// RFC 8439 2.3.2
+static const u8 s_uBlockKAT[64] = {
+   0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+   0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+   0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+   0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e };
+
+// RFC 8439 2.4.2
+static const u8 s_uEncryptKAT[114] = {
+   0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+   0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2, 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+   0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+   0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+   0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61, 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+   0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+   0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+   0x87, 0x4d };
+
+// RFC 8439 2.5.2
+static const u8 s_uPolyKey[32] = {
+   0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06, 0xa8,
+   0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b };
+static const u8 s_uPolyTag[16] = {
+   0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27, 0xa9 };
+
+// RFC 8439 2.8.2
+static const u8 s_uAEADAAD[12] = { 0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7 };
+static const u8 s_uAEADNonce[12] = { 0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47 };
+static const u8 s_uAEADCipherKAT[114] = {
+   0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+   0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+   0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+   0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+   0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+   0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+   0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+   0x61, 0x16 };
+static const u8 s_uAEADTagKAT[16] = {
+   0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91 };
+
+static int _check(const char* szName, const u8* pResult, const u8* pExpected, int iLength)
+{
+   if ( 0 == memcmp(pResult, pExpected, iLength) )
+      return 1;
+   printf("  %s: wrong result\n", szName);
+   return 0;
+}
+
+static int _test_known_answers()
+{
+   int iOk = 1;
+   u8 uKey[32];
+   u8 uBuffer[256];
+
+   for( int i=0; i<32; i++ )
+      uKey[i] = (u8)i;
+   u8 uNonceBlock[12] = { 0,0,0,0x09, 0,0,0,0x4a, 0,0,0,0 };
+   chacha20_block(uKey, 1, uNonceBlock, uBuffer);
+   iOk &= _check("chacha20 block", uBuffer, s_uBlockKAT, 64);
+
+   u8 uNonceEncrypt[12] = { 0,0,0,0, 0,0,0,0x4a, 0,0,0,0 };
+   int iLength = (int)strlen(s_szSunscreen);
+   memcpy(uBuffer, s_szSunscreen, iLength);
+   chacha20_xor(uKey, 1, uNonceEncrypt, uBuffer, iLength);
+   iOk &= _check("chacha20 encryption", uBuffer, s_uEncryptKAT, iLength);
+
+   const char* szPolyMessage = "Cryptographic Forum Research Group";
+   u8 uTag[16];
+   poly1305_mac(s_uPolyKey, (const u8*)szPolyMessage, (int)strlen(szPolyMessage), uTag);
+   iOk &= _check("poly1305", uTag, s_uPolyTag, 16);
+
+   // Same message fed in odd sized pieces
+   type_poly1305_state state;
+   poly1305_init(&state, s_uPolyKey);
+   poly1305_update(&state, (const u8*)szPolyMessage, 3);
+   poly1305_update(&state, (const u8*)szPolyMessage + 3, 17);
+   poly1305_update(&state, (const u8*)szPolyMessage + 20, (int)strlen(szPolyMessage) - 20);
+   poly1305_finish(&state, uTag);
+   iOk &= _check("poly1305 incremental", uTag, s_uPolyTag, 16);
+
+   for( int i=0; i<32; i++ )
+      uKey[i] = (u8)(0x80 + i);
+   memcpy(uBuffer, s_szSunscreen, iLength);
+   chacha20_poly1305_encrypt(uKey, s_uAEADNonce, s_uAEADAAD, sizeof(s_uAEADAAD), uBuffer, iLength, uTag);
+   iOk &= _check("aead ciphertext", uBuffer, s_uAEADCipherKAT, iLength);
+   iOk &= _check("aead tag", uTag, s_uAEADTagKAT, 16);
+
+   if ( ! chacha20_poly1305_decrypt(uKey, s_uAEADNonce, s_uAEADAAD, sizeof(s_uAEADAAD), uBuffer, iLength, s_uAEADTagKAT) )
+   {
+      printf("  aead decrypt: valid tag rejected\n");
+      iOk = 0;
+   }
+   iOk &= _check("aead plaintext", uBuffer, (const u8*)s_szSunscreen, iLength);
+   return iOk;
+}
+
+// All lengths up to a few chunks: the engine result must match the single block reference
+static int _test_engines_agree(int iEngine)
+{
+   u8 uKey[32];
+   u8 uNonce[12];
+   u8 uData[1600];
+   u8 uExpected[1600];
+   u32 uRandom = 0x1234567;
+   for( int i=0; i<32; i++ )
+      uKey[i] = (u8)(i*7 + 3);
+   for( int i=0; i<12; i++ )
+      uNonce[i] = (u8)(i*13 + 1);
+
+   for( int iLength=0; iLength<=(int)sizeof(uData); iLength += (iLength < 600)?1:37 )
+   {
+      for( int i=0; i<iLength; i++ )
+      {
+         uRandom = uRandom * 1103515245 + 12345;
+         uData[i] = (u8)(uRandom >> 16);
+      }
+      // Reference: one keystream block at a time
+      memcpy(uExpected, uData, iLength);
+      for( int iBlock=0; iBlock*64 < iLength; iBlock++ )
+      {
+         u8 uKeyStream[64];
+         chacha20_block(uKey, 0xFFFFFFFE + (u32)iBlock, uNonce, uKeyStream);
+         for( int i=0; (i<64) && (iBlock*64+i < iLength); i++ )
+            uExpected[iBlock*64+i] ^= uKeyStream[i];
+      }
+      chacha20_xor(uKey, 0xFFFFFFFE, uNonce, uData, iLength);
+      if ( 0 != memcmp(uData, uExpected, iLength) )
+      {
+         printf("  engine %s: wrong keystream for %d bytes\n", chacha20_get_engine_name(iEngine), iLength);
+         return 0;
+      }
+   }
+   return 1;
+}
+
+static int _test_forgeries()
+{
+   int iOk = 1;
+   u8 uKey[32];
+   u8 uNonce[12];
+   u8 uAAD[24];
+   u8 uPlain[1300];
+   u8 uData[1300];
+   u8 uCipher[1300];
+   u8 uTag[16];
+   for( int i=0; i<32; i++ )
+      uKey[i] = (u8)(255 - i);
+   for( int i=0; i<12; i++ )
+      uNonce[i] = (u8)i;
+   for( int i=0; i<24; i++ )
+      uAAD[i] = (u8)(i*3);
+   for( int i=0; i<(int)sizeof(uPlain); i++ )
+      uPlain[i] = (u8)(i*11);
+
+   int iLengths[] = { 0, 1, 15, 16, 17, 63, 64, 65, 255, 256, 257, 1250, 1300 };
+   for( int k=0; k<(int)(sizeof(iLengths)/sizeof(iLengths[0])); k++ )
+   {
+      int iLength = iLengths[k];
+      memcpy(uData, uPlain, iLength);
+      chacha20_poly1305_encrypt(uKey, uNonce, uAAD, sizeof(uAAD), uData, iLength, uTag);
+      memcpy(uCipher, uData, iLength);
+
+      // Flipped ciphertext bit
+      if ( iLength > 0 )
+      {
+         uData[iLength/2] ^= 0x10;
+         if ( chacha20_poly1305_decrypt(uKey, uNonce, uAAD, sizeof(uAAD), uData, iLength, uTag) )
+            iOk = 0;
+         uData[iLength/2] ^= 0x10;
+         if ( 0 != memcmp(uData, uCipher, iLength) )
+         {
+            printf("  %d bytes: rejected data was modified\n", iLength);
+            iOk = 0;
+         }
+      }
+      // Flipped additional data bit
+      uAAD[5] ^= 0x01;
+      if ( chacha20_poly1305_decrypt(uKey, uNonce, uAAD, sizeof(uAAD), uData, iLength, uTag) )
+         iOk = 0;
+      uAAD[5] ^= 0x01;
+      // Flipped tag bit
+      uTag[15] ^= 0x80;
+      if ( chacha20_poly1305_decrypt(uKey, uNonce, uAAD, sizeof(uAAD), uData, iLength, uTag) )
+         iOk = 0;
+      uTag[15] ^= 0x80;
+      // Other nonce
+      uNonce[0] ^= 0x01;
+      if ( chacha20_poly1305_decrypt(uKey, uNonce, uAAD, sizeof(uAAD), uData, iLength, uTag) )
+         iOk = 0;
+      uNonce[0] ^= 0x01;
+
+      if ( ! chacha20_poly1305_decrypt(uKey, uNonce, uAAD, sizeof(uAAD), uData, iLength, uTag) )
+      {
+         printf("  %d bytes: valid packet rejected\n", iLength);
+         iOk = 0;
+      }
+      else if ( 0 != memcmp(uData, uPlain, iLength) )
+      {
+         printf("  %d bytes: wrong plaintext\n", iLength);
+         iOk = 0;
+      }
+   }
+   return iOk;
+}
+
+// Same packet (same stream, vehicle and radio link indexes, so the same nonce) sent after a restart
+static int _test_aead_sessions()
+{
+   int iOk = 1;
+   strcpy((char*)s_epp, "test-pass-phrase");
+   s_eppl = (u8)strlen((char*)s_epp);
+
+   u8 uPlain[MAX_PACKET_TOTAL_SIZE];
+   u8 uPackets[2][MAX_PACKET_TOTAL_SIZE];
+   memset(uPlain, 0, sizeof(uPlain));
+   t_packet_header* pPH = (t_packet_header*)uPlain;
+   pPH->stream_packet_idx = 100;
+   pPH->vehicle_id_src = 7;
+   pPH->radio_link_packet_index = 5;
+   pPH->total_length = sizeof(t_packet_header) + 200;
+   for( int i=sizeof(t_packet_header); i<pPH->total_length; i++ )
+      uPlain[i] = (u8)(i*7);
+
+   for( int k=0; k<2; k++ )
+   {
+      epp_aead_new_session();
+      memcpy(uPackets[k], uPlain, sizeof(uPlain));
+      epp_aead(uPackets[k]);
+   }
+   int iTrailer = pPH->total_length + ENC_AEAD_TAG_SIZE;
+   if ( 0 == memcmp(uPackets[0] + iTrailer, uPackets[1] + iTrailer, ENC_AEAD_SESSION_ID_SIZE) )
+   {
+      printf("  two sessions have the same session id\n");
+      iOk = 0;
+   }
+   if ( 0 == memcmp(uPackets[0] + sizeof(t_packet_header), uPackets[1] + sizeof(t_packet_header), pPH->total_length - sizeof(t_packet_header)) )
+   {
+      printf("  same packet encrypted the same in two sessions\n");
+      iOk = 0;
+   }
+
+   // Received by a peer in another session
+   epp_aead_new_session();
+   for( int k=0; k<2; k++ )
+   {
+      if ( (! dpp_aead(uPackets[k], sizeof(uPackets[k]))) || (0 != memcmp(uPackets[k], uPlain, pPH->total_length)) )
+      {
+         printf("  session %d packet not decrypted\n", k);
+         iOk = 0;
+      }
+   }
+
+   // Session id is authenticated through the key
+   memcpy(uPackets[0], uPlain, sizeof(uPlain));
+   epp_aead(uPackets[0]);
+   uPackets[0][iTrailer] ^= 0x01;
+   if ( dpp_aead(uPackets[0], sizeof(uPackets[0])) )
+   {
+      printf("  packet with a modified session id accepted\n");
+      iOk = 0;
+   }
+
+   // Session ids of many restarts
+   static u8 s_uSessionIds[1000][ENC_AEAD_SESSION_ID_SIZE];
+   for( int k=0; k<1000; k++ )
+   {
+      epp_aead_new_session();
+      memcpy(uPackets[0], uPlain, sizeof(uPlain));
+      epp_aead(uPackets[0]);
+      memcpy(s_uSessionIds[k], uPackets[0] + iTrailer, ENC_AEAD_SESSION_ID_SIZE);
+      for( int i=0; i<k; i++ )
+      {
+         if ( 0 == memcmp(s_uSessionIds[i], s_uSessionIds[k], ENC_AEAD_SESSION_ID_SIZE) )
+         {
+            printf("  sessions %d and %d have the same session id\n", i, k);
+            iOk = 0;
+         }
+      }
+   }
+   return iOk;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting ChaCha20-Poly1305...\n");
+   log_disable();
+
+   int iFailures = 0;
+   for( int iEngine=0; iEngine<CHACHA20_ENGINE_COUNT; iEngine++ )
+   {
+      if ( ! chacha20_set_engine(iEngine) )
+      {
+         printf("Engine %s: not supported on this CPU, skipped.\n", chacha20_get_engine_name(iEngine));
+         continue;
+      }
+      int iOk = _test_known_answers();
+      iOk &= _test_engines_agree(iEngine);
+      iOk &= _test_forgeries();
+      printf("Engine %s: %s\n", chacha20_get_engine_name(iEngine), iOk?"ok":"FAILED");
+      if ( ! iOk )
+         iFailures++;
+   }
+
+   int iOkSessions = _test_aead_sessions();
+   printf("Radio packets sessions: %s\n", iOkSessions?"ok":"FAILED");
+   if ( ! iOkSessions )
+      iFailures++;
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d tests failed.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
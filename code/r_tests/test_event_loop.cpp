@@ -0,0 +1,300 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/event_loop.h"
+#include "../base/shared_mem.h"
+#include "../radio/radio_rx_queue.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+
+// Checks the event loop with a synthetic router load: a fake radio rx thread pushes packets in bursts
+// to a radio rx queue (with the eventfd wakeup), the loop consumes them from a high priority fd source,
+// next to a high priority video timer, a normal priority IPC timer and a low priority housekeeping timer
+// doing busy work. Checks that no packet is lost, that high priority sources run before low priority
+// ones and reports the loop latency percentiles. Then compares the idle CPU usage and wakeups with a
+// polling loop like the legacy router main loop (rx queue reads with 200 us timeouts).
+//
+// Usage: test_event_loop [-seconds N]
+
+#define TEST_SHARED_MEM_NAME "/SYSTEM_SHARED_MEM_RUBY_TEST_EVENT_LOOP"
+#define TEST_BURST_PACKETS 8
+#define TEST_BURST_INTERVAL_MICROS 2000
+#define TEST_HOUSEKEEPING_BUSY_MICROS 1500
+
+static int s_iFailures = 0;
+
+static type_radio_rx_queue_wakeup s_Wakeup;
+static type_radio_rx_queue s_Queue;
+static type_radio_rx_queue* s_pQueues[1] = { &s_Queue };
+static volatile int s_iProducerRunning = 0;
+static u32 s_uPacketsPushed = 0;
+static u32 s_uPacketsDropped = 0;
+static u32 s_uPacketsConsumed = 0;
+static u32 s_uPacketsOutOfOrder = 0;
+static u32 s_uNextExpectedPacket = 0;
+
+static int s_iOrder[8];
+static int s_iCountOrder = 0;
+
+static void _check(bool bCondition, const char* szMessage)
+{
+   if ( bCondition )
+      return;
+   printf("Failed: %s\n", szMessage);
+   s_iFailures++;
+}
+
+static u64 _test_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec/1000;
+}
+
+static void _busy_wait_micros(u32 uMicros)
+{
+   u64 uEnd = _test_time_micros() + uMicros;
+   while ( _test_time_micros() < uEnd ) {}
+}
+
+static double _cpu_time_ms()
+{
+   struct rusage ru;
+   getrusage(RUSAGE_SELF, &ru);
+   return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 + (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+static void* _thread_fake_radio_rx(void* pParam)
+{
+   int iSeconds = *(int*)pParam;
+   u8 uPacket[256];
+   memset(uPacket, 0, sizeof(uPacket));
+   u64 uEnd = _test_time_micros() + (u64)iSeconds * 1000000LL;
+   while ( _test_time_micros() < uEnd )
+   {
+      for( int i=0; i<TEST_BURST_PACKETS; i++ )
+      {
+         memcpy(uPacket, &s_uPacketsPushed, sizeof(u32));
+         if ( radio_rx_queue_push(&s_Queue, uPacket, sizeof(uPacket), 0) )
+            s_uPacketsPushed++;
+         else
+            s_uPacketsDropped++;
+      }
+      hardware_sleep_micros(TEST_BURST_INTERVAL_MICROS);
+   }
+   s_iProducerRunning = 0;
+   return NULL;
+}
+
+static int _on_radio_rx_prepare(void* pContext)
+{
+   return radio_rx_queue_wakeup_prepare_wait(&s_Wakeup, s_pQueues, 1);
+}
+
+static void _on_radio_rx_finish(void* pContext)
+{
+   radio_rx_queue_wakeup_finish_wait(&s_Wakeup);
+}
+
+static void _on_radio_rx(void* pContext)
+{
+   int iLength = 0;
+   int iInterface = 0;
+   u8* pPacket = NULL;
+   while ( NULL != (pPacket = radio_rx_queue_borrow(&s_Queue, 0, &iLength, &iInterface)) )
+   {
+      u32 uIndex = 0;
+      memcpy(&uIndex, pPacket, sizeof(u32));
+      if ( uIndex != s_uNextExpectedPacket )
+         s_uPacketsOutOfOrder++;
+      s_uNextExpectedPacket = uIndex + 1;
+      s_uPacketsConsumed++;
+      radio_rx_queue_release(&s_Queue);
+   }
+   if ( NULL != pContext )
+      (*(u32*)pContext)++;
+}
+
+static void _on_count(void* pContext)
+{
+   (*(u32*)pContext)++;
+}
+
+static void _on_housekeeping(void* pContext)
+{
+   (*(u32*)pContext)++;
+   _busy_wait_micros(TEST_HOUSEKEEPING_BUSY_MICROS);
+}
+
+static void _on_order(void* pContext)
+{
+   if ( s_iCountOrder < 8 )
+      s_iOrder[s_iCountOrder++] = (int)(long)pContext;
+}
+
+static void _print_histogram_percentiles(const char* szName, const u32* pHistogram)
+{
+   printf("  %-12s p50: %6u us, p90: %6u us, p99: %6u us\n", szName,
+      event_loop_get_histogram_percentile(pHistogram, 50),
+      event_loop_get_histogram_percentile(pHistogram, 90),
+      event_loop_get_histogram_percentile(pHistogram, 99));
+}
+
+static void _test_priority_order()
+{
+   type_event_loop loop;
+   _check(1 == event_loop_init(&loop), "priority: init");
+   int iLow = event_loop_add_event(&loop, "low", EVENT_LOOP_PRIORITY_LOW, _on_order, (void*)(long)EVENT_LOOP_PRIORITY_LOW);
+   int iNormal = event_loop_add_event(&loop, "normal", EVENT_LOOP_PRIORITY_NORMAL, _on_order, (void*)(long)EVENT_LOOP_PRIORITY_NORMAL);
+   int iHigh = event_loop_add_event(&loop, "high", EVENT_LOOP_PRIORITY_HIGH, _on_order, (void*)(long)EVENT_LOOP_PRIORITY_HIGH);
+   _check((iLow >= 0) && (iNormal >= 0) && (iHigh >= 0), "priority: add sources");
+
+   // Signaled in reverse priority order, must run in priority order
+   s_iCountOrder = 0;
+   event_loop_signal(&loop, iLow);
+   event_loop_signal(&loop, iNormal);
+   event_loop_signal(&loop, iHigh);
+   _check(3 == event_loop_run_once(&loop, 100), "priority: 3 handlers run");
+   _check((3 == s_iCountOrder) && (s_iOrder[0] == EVENT_LOOP_PRIORITY_HIGH) && (s_iOrder[1] == EVENT_LOOP_PRIORITY_NORMAL) && (s_iOrder[2] == EVENT_LOOP_PRIORITY_LOW), "priority: run in priority order");
+
+   // Nothing ready: times out
+   s_iCountOrder = 0;
+   _check(0 == event_loop_run_once(&loop, 5), "priority: timeout with no ready sources");
+
+   // Disabled source is not run
+   event_loop_enable_source(&loop, iNormal, 0);
+   event_loop_signal(&loop, iNormal);
+   event_loop_signal(&loop, iHigh);
+   s_iCountOrder = 0;
+   event_loop_run_once(&loop, 100);
+   _check((1 == s_iCountOrder) && (s_iOrder[0] == EVENT_LOOP_PRIORITY_HIGH), "priority: disabled source not run");
+   event_loop_close(&loop);
+}
+
+static void _test_synthetic_load(int iSeconds)
+{
+   u32 uRadioRuns = 0, uVideoRuns = 0, uIPCRuns = 0, uHousekeepingRuns = 0;
+   type_event_loop loop;
+   _check(1 == event_loop_init(&loop), "load: init");
+   _check(1 == radio_rx_queue_wakeup_init(&s_Wakeup), "load: wakeup init");
+   _check(1 == radio_rx_queue_init(&s_Queue, 256, &s_Wakeup), "load: queue init");
+
+   event_loop_add_fd(&loop, "radio-rx", s_Wakeup.iEventFd, EVENT_LOOP_PRIORITY_HIGH, _on_radio_rx, _on_radio_rx_prepare, _on_radio_rx_finish, &uRadioRuns);
+   event_loop_add_timer(&loop, "video", 5000, EVENT_LOOP_PRIORITY_HIGH, _on_count, &uVideoRuns);
+   event_loop_add_timer(&loop, "ipc", 2000, EVENT_LOOP_PRIORITY_NORMAL, _on_count, &uIPCRuns);
+   event_loop_add_timer(&loop, "housekeeping", 5000, EVENT_LOOP_PRIORITY_LOW, _on_housekeeping, &uHousekeepingRuns);
+
+   shared_mem_loop_latency_stats_versioned* pShared = shared_mem_loop_latency_stats_open_for_write(TEST_SHARED_MEM_NAME);
+   _check(NULL != pShared, "load: open shared mem");
+   event_loop_set_shared_stats(&loop, pShared);
+
+   s_iProducerRunning = 1;
+   pthread_t thread;
+   pthread_create(&thread, NULL, _thread_fake_radio_rx, &iSeconds);
+   while ( s_iProducerRunning )
+      event_loop_run_once(&loop, 100);
+   pthread_join(thread, NULL);
+   // Consume what is left
+   event_loop_run_once(&loop, 10);
+   _on_radio_rx(NULL);
+
+   printf("Synthetic load, %d s: %u packets pushed (%u dropped), %u consumed, %u out of order\n", iSeconds, s_uPacketsPushed, s_uPacketsDropped, s_uPacketsConsumed, s_uPacketsOutOfOrder);
+   printf("  runs: radio rx %u, video %u, ipc %u, housekeeping %u\n", uRadioRuns, uVideoRuns, uIPCRuns, uHousekeepingRuns);
+   shared_mem_loop_latency_stats* pStats = event_loop_get_stats(&loop);
+   _print_histogram_percentiles("high", pStats->uLatencyHistogram[EVENT_LOOP_PRIORITY_HIGH]);
+   _print_histogram_percentiles("normal", pStats->uLatencyHistogram[EVENT_LOOP_PRIORITY_NORMAL]);
+   _print_histogram_percentiles("low", pStats->uLatencyHistogram[EVENT_LOOP_PRIORITY_LOW]);
+   printf("  max latency: high %u us, normal %u us, low %u us\n", pStats->uMaxLatencyMicros[0], pStats->uMaxLatencyMicros[1], pStats->uMaxLatencyMicros[2]);
+
+   _check(0 == s_uPacketsDropped, "load: no packets dropped");
+   _check(s_uPacketsConsumed == s_uPacketsPushed, "load: all packets consumed");
+   _check(0 == s_uPacketsOutOfOrder, "load: packets consumed in order");
+   _check(uVideoRuns > 0 && uIPCRuns > 0 && uHousekeepingRuns > 0, "load: all timers run");
+   // High priority sources don't wait for the housekeeping busy work
+   _check(event_loop_get_histogram_percentile(pStats->uLatencyHistogram[EVENT_LOOP_PRIORITY_HIGH], 90) <= event_loop_get_histogram_percentile(pStats->uLatencyHistogram[EVENT_LOOP_PRIORITY_LOW], 90), "load: high priority latency not above low priority latency");
+
+   // Published stats
+   hardware_sleep_ms(EVENT_LOOP_STATS_PUBLISH_INTERVAL_MS + 10);
+   event_loop_run_once(&loop, 10);
+   shared_mem_loop_latency_stats statsRead;
+   shared_mem_sections_reader reader;
+   shared_mem_sections_reader_reset(&reader);
+   memset(&statsRead, 0, sizeof(statsRead));
+   shared_mem_loop_latency_stats_read(pShared, &statsRead, &reader);
+   _check((statsRead.uTotalIterations > 0) && (statsRead.uTotalDispatches[EVENT_LOOP_PRIORITY_HIGH] > 0), "load: stats published to shared memory");
+
+   shared_mem_loop_latency_stats_close(pShared);
+   event_loop_close(&loop);
+   radio_rx_queue_free(&s_Queue);
+   radio_rx_queue_wakeup_close(&s_Wakeup);
+}
+
+// Idle: no radio packets. Event loop with the router timers vs a polling loop doing rx queue reads with timeouts.
+static void _test_idle_cpu(int iSeconds)
+{
+   u32 uVideoRuns = 0, uIPCRuns = 0, uHousekeepingRuns = 0;
+   type_event_loop loop;
+   event_loop_init(&loop);
+   radio_rx_queue_wakeup_init(&s_Wakeup);
+   radio_rx_queue_init(&s_Queue, 256, &s_Wakeup);
+   event_loop_add_fd(&loop, "radio-rx", s_Wakeup.iEventFd, EVENT_LOOP_PRIORITY_HIGH, _on_radio_rx, _on_radio_rx_prepare, _on_radio_rx_finish, NULL);
+   event_loop_add_timer(&loop, "video", SYSTEM_RT_INFO_UPDATE_INTERVAL_MS*1000, EVENT_LOOP_PRIORITY_HIGH, _on_count, &uVideoRuns);
+   event_loop_add_timer(&loop, "ipc", 2000, EVENT_LOOP_PRIORITY_NORMAL, _on_count, &uIPCRuns);
+   event_loop_add_timer(&loop, "housekeeping", 5000, EVENT_LOOP_PRIORITY_LOW, _on_count, &uHousekeepingRuns);
+
+   double fCPU = _cpu_time_ms();
+   u64 uEnd = _test_time_micros() + (u64)iSeconds * 1000000LL;
+   u32 uEventIterations = 0;
+   while ( _test_time_micros() < uEnd )
+   {
+      event_loop_run_once(&loop, 100);
+      uEventIterations++;
+   }
+   double fCPUEvent = _cpu_time_ms() - fCPU;
+   event_loop_close(&loop);
+
+   fCPU = _cpu_time_ms();
+   uEnd = _test_time_micros() + (u64)iSeconds * 1000000LL;
+   u32 uPollIterations = 0;
+   int iLength = 0, iInterface = 0;
+   while ( _test_time_micros() < uEnd )
+   {
+      radio_rx_queue_borrow(&s_Queue, 200, &iLength, &iInterface);
+      radio_rx_queue_borrow(&s_Queue, 200, &iLength, &iInterface);
+      uPollIterations++;
+   }
+   double fCPUPoll = _cpu_time_ms() - fCPU;
+   radio_rx_queue_free(&s_Queue);
+   radio_rx_queue_wakeup_close(&s_Wakeup);
+
+   printf("Idle, %d s: event loop %u iterations, %.1f ms CPU; polling loop %u iterations, %.1f ms CPU\n",
+      iSeconds, uEventIterations, fCPUEvent, uPollIterations, fCPUPoll);
+   _check(uEventIterations < uPollIterations, "idle: event loop wakes up less than the polling loop");
+}
+
+int main(int argc, char *argv[])
+{
+   int iSeconds = 2;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-seconds")) && (i < argc-1) )
+         iSeconds = atoi(argv[++i]);
+   }
+   if ( iSeconds < 1 )
+      iSeconds = 1;
+
+   printf("\nTesting event loop...\n");
+   log_disable();
+
+   _test_priority_order();
+   _test_synthetic_load(iSeconds);
+   _test_idle_cpu(1);
+
+   if ( s_iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,411 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/event_loop.h"
+#include "../radio/radio_rx_queue.h"
+#include "../r_vehicle/video_source_udp_batch.h"
+
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <math.h>
+
+// Replays a recorded (or generated) vehicle input trace through an event loop set up like the vehicle
+// router one: camera UDP packets (as from majestic) on a high priority fd source read in batches with a
+// bounded time slice, radio packets pushed to a radio rx queue on a high priority fd source, an IPC timer
+// and a housekeeping timer doing busy work (like the periodic loops). Each packet carries the time it was
+// scheduled at; reports the end-to-end scheduling delay and jitter (scheduled time to handler time) for
+// camera and radio input, and the run time of each handler.
+//
+// Trace file: one input per line: <time in microseconds> <c|r> <size in bytes> (c: camera, r: radio)
+//
+// Usage: test_event_loop_replay [-trace file] [-save file] [-seconds N] [-fps N] [-port N]
+
+#define REPLAY_MAX_EVENTS 400000
+#define REPLAY_CAMERA_PACKET_SIZE 1400
+#define REPLAY_HOUSEKEEPING_BUSY_MICROS 1500
+
+typedef struct
+{
+   u64 uTimeMicros; // from the trace start
+   u8 uType; // 'c' or 'r'
+   u16 uSize;
+} type_replay_event;
+
+typedef struct
+{
+   u64 uTimeScheduledMicros;
+   u32 uIndex;
+} type_replay_packet_header;
+
+static type_replay_event* s_pEvents = NULL;
+static int s_iCountEvents = 0;
+static int s_iCountCamera = 0;
+static int s_iCountRadio = 0;
+static u64 s_uReplayStartMicros = 0;
+static volatile int s_iReplayRunning = 0;
+
+static int s_iSocketTx = -1;
+static int s_iSocketRx = -1;
+static struct sockaddr_in s_AddrCamera;
+static type_udp_batch_reader s_CameraReader;
+static type_radio_rx_queue_wakeup s_Wakeup;
+static type_radio_rx_queue s_Queue;
+static type_radio_rx_queue* s_pQueues[1] = { &s_Queue };
+static type_event_loop s_Loop;
+
+static u32* s_pDelaysCamera = NULL;
+static u32* s_pDelaysRadio = NULL;
+static int s_iCountDelaysCamera = 0;
+static int s_iCountDelaysRadio = 0;
+
+static int s_iFailures = 0;
+
+static void _check(bool bCondition, const char* szMessage)
+{
+   if ( bCondition )
+      return;
+   printf("Failed: %s\n", szMessage);
+   s_iFailures++;
+}
+
+// Camera frames at the given fps, 8 Mbps with a 4x keyframe each second, sent as back to back UDP packets;
+// radio uplink packets every 5 ms with random jitter and random bursts (retransmission requests).
+static void _generate_trace(int iSeconds, int iFPS)
+{
+   u32 uSeed = 1234;
+   u64 uEnd = (u64)iSeconds * 1000000LL;
+   u32 uFrameBytes = 8000000 / 8 / iFPS;
+   for( int iFrame=0; (u64)iFrame * 1000000LL / iFPS < uEnd; iFrame++ )
+   {
+      u64 uTime = (u64)iFrame * 1000000LL / iFPS;
+      u32 uBytes = (0 == (iFrame % iFPS))?(uFrameBytes*4):uFrameBytes;
+      uBytes = uBytes * (80 + rand_r(&uSeed) % 40) / 100;
+      while ( (uBytes > 0) && (s_iCountEvents < REPLAY_MAX_EVENTS) )
+      {
+         u32 uSize = (uBytes > REPLAY_CAMERA_PACKET_SIZE)?REPLAY_CAMERA_PACKET_SIZE:uBytes;
+         if ( uSize < sizeof(type_replay_packet_header) )
+            uSize = sizeof(type_replay_packet_header);
+         s_pEvents[s_iCountEvents].uTimeMicros = uTime;
+         s_pEvents[s_iCountEvents].uType = 'c';
+         s_pEvents[s_iCountEvents].uSize = (u16)uSize;
+         s_iCountEvents++;
+         uBytes = (uBytes > uSize)?(uBytes - uSize):0;
+         uTime += 20;
+      }
+   }
+   for( u64 uTime = 0; (uTime < uEnd) && (s_iCountEvents < REPLAY_MAX_EVENTS); uTime += 5000 )
+   {
+      int iCount = (0 == (rand_r(&uSeed) % 20))?(4 + rand_r(&uSeed) % 8):1;
+      u64 uTimePacket = uTime + rand_r(&uSeed) % 2000;
+      for( int i=0; (i<iCount) && (s_iCountEvents < REPLAY_MAX_EVENTS); i++ )
+      {
+         s_pEvents[s_iCountEvents].uTimeMicros = uTimePacket + (u64)i * 100;
+         s_pEvents[s_iCountEvents].uType = 'r';
+         s_pEvents[s_iCountEvents].uSize = (u16)(40 + rand_r(&uSeed) % 200);
+         s_iCountEvents++;
+      }
+   }
+}
+
+static int _compare_events(const void* p1, const void* p2)
+{
+   const type_replay_event* pE1 = (const type_replay_event*)p1;
+   const type_replay_event* pE2 = (const type_replay_event*)p2;
+   if ( pE1->uTimeMicros < pE2->uTimeMicros )
+      return -1;
+   if ( pE1->uTimeMicros > pE2->uTimeMicros )
+      return 1;
+   return 0;
+}
+
+static int _compare_u32(const void* p1, const void* p2)
+{
+   u32 u1 = *(const u32*)p1;
+   u32 u2 = *(const u32*)p2;
+   return (u1 < u2)?-1:((u1 > u2)?1:0);
+}
+
+static bool _load_trace(const char* szFile)
+{
+   FILE* fd = fopen(szFile, "r");
+   if ( NULL == fd )
+      return false;
+   unsigned long long uTime = 0;
+   char cType = 0;
+   int iSize = 0;
+   while ( (s_iCountEvents < REPLAY_MAX_EVENTS) && (3 == fscanf(fd, "%llu %c %d", &uTime, &cType, &iSize)) )
+   {
+      if ( ((cType != 'c') && (cType != 'r')) || (iSize <= 0) )
+         continue;
+      if ( iSize < (int)sizeof(type_replay_packet_header) )
+         iSize = sizeof(type_replay_packet_header);
+      if ( iSize > MAX_PACKET_TOTAL_SIZE )
+         iSize = MAX_PACKET_TOTAL_SIZE;
+      s_pEvents[s_iCountEvents].uTimeMicros = uTime;
+      s_pEvents[s_iCountEvents].uType = (u8)cType;
+      s_pEvents[s_iCountEvents].uSize = (u16)iSize;
+      s_iCountEvents++;
+   }
+   fclose(fd);
+   return (s_iCountEvents > 0);
+}
+
+static void _save_trace(const char* szFile)
+{
+   FILE* fd = fopen(szFile, "w");
+   if ( NULL == fd )
+   {
+      printf("Failed to create trace file %s\n", szFile);
+      return;
+   }
+   for( int i=0; i<s_iCountEvents; i++ )
+      fprintf(fd, "%llu %c %d\n", (unsigned long long)s_pEvents[i].uTimeMicros, (char)s_pEvents[i].uType, (int)s_pEvents[i].uSize);
+   fclose(fd);
+   printf("Trace saved to %s (%d inputs)\n", szFile, s_iCountEvents);
+}
+
+static void* _thread_replay(void* pParam)
+{
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+   memset(uPacket, 0, sizeof(uPacket));
+   for( int i=0; i<s_iCountEvents; i++ )
+   {
+      u64 uTimeScheduled = s_uReplayStartMicros + s_pEvents[i].uTimeMicros;
+      struct timespec t;
+      t.tv_sec = uTimeScheduled / 1000000LL;
+      t.tv_nsec = (uTimeScheduled % 1000000LL) * 1000LL;
+      while ( EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) ) {}
+
+      type_replay_packet_header header;
+      header.uTimeScheduledMicros = uTimeScheduled;
+      header.uIndex = (u32)i;
+      memcpy(uPacket, &header, sizeof(header));
+      if ( s_pEvents[i].uType == 'c' )
+      {
+         if ( sendto(s_iSocketTx, uPacket, s_pEvents[i].uSize, 0, (struct sockaddr*)&s_AddrCamera, sizeof(s_AddrCamera)) < 0 ) {}
+      }
+      else
+         radio_rx_queue_push(&s_Queue, uPacket, s_pEvents[i].uSize, 0);
+   }
+   s_iReplayRunning = 0;
+   return NULL;
+}
+
+static void _record_delay(u8* pPacket, bool bCamera)
+{
+   type_replay_packet_header header;
+   memcpy(&header, pPacket, sizeof(header));
+   u64 uNow = event_loop_get_time_micros();
+   u32 uDelay = (uNow > header.uTimeScheduledMicros)?(u32)(uNow - header.uTimeScheduledMicros):0;
+   if ( bCamera && (s_iCountDelaysCamera < s_iCountCamera) )
+      s_pDelaysCamera[s_iCountDelaysCamera++] = uDelay;
+   if ( (! bCamera) && (s_iCountDelaysRadio < s_iCountRadio) )
+      s_pDelaysRadio[s_iCountDelaysRadio++] = uDelay;
+}
+
+static int _on_camera_prepare(void* pContext)
+{
+   return video_source_udp_batch_has_pending_packets(&s_CameraReader);
+}
+
+static void _on_camera(void* pContext)
+{
+   // Bounded: stop when the time slice is used up, the rest is read on the next iterations
+   while ( ! event_loop_slice_expired(&s_Loop) )
+   {
+      if ( ! video_source_udp_batch_has_pending_packets(&s_CameraReader) )
+      if ( video_source_udp_batch_read(&s_CameraReader, 0) <= 0 )
+         break;
+      int iLength = 0;
+      u8* pPacket = NULL;
+      while ( NULL != (pPacket = video_source_udp_batch_next_packet(&s_CameraReader, &iLength)) )
+         _record_delay(pPacket, true);
+   }
+}
+
+static int _on_radio_rx_prepare(void* pContext)
+{
+   return radio_rx_queue_wakeup_prepare_wait(&s_Wakeup, s_pQueues, 1);
+}
+
+static void _on_radio_rx_finish(void* pContext)
+{
+   radio_rx_queue_wakeup_finish_wait(&s_Wakeup);
+}
+
+static void _on_radio_rx(void* pContext)
+{
+   int iLength = 0;
+   int iInterface = 0;
+   u8* pPacket = NULL;
+   while ( NULL != (pPacket = radio_rx_queue_borrow(&s_Queue, 0, &iLength, &iInterface)) )
+   {
+      _record_delay(pPacket, false);
+      radio_rx_queue_release(&s_Queue);
+   }
+}
+
+static void _on_ipc(void* pContext)
+{
+}
+
+static void _on_housekeeping(void* pContext)
+{
+   u64 uEnd = event_loop_get_time_micros() + REPLAY_HOUSEKEEPING_BUSY_MICROS;
+   while ( event_loop_get_time_micros() < uEnd ) {}
+}
+
+static void _print_delays(const char* szName, u32* pDelays, int iCount)
+{
+   if ( 0 == iCount )
+   {
+      printf("  %-7s no inputs\n", szName);
+      return;
+   }
+   double fSum = 0, fSumSq = 0;
+   for( int i=0; i<iCount; i++ )
+   {
+      fSum += pDelays[i];
+      fSumSq += (double)pDelays[i] * (double)pDelays[i];
+   }
+   double fMean = fSum / iCount;
+   double fVariance = fSumSq / iCount - fMean * fMean;
+   qsort(pDelays, iCount, sizeof(u32), _compare_u32);
+   printf("  %-7s %6d inputs, delay mean %7.1f us, jitter (std dev) %7.1f us, p50 %6u us, p90 %6u us, p99 %6u us, max %6u us\n",
+      szName, iCount, fMean, (fVariance > 0)?sqrt(fVariance):0.0,
+      pDelays[iCount/2], pDelays[(iCount*90)/100], pDelays[(iCount*99)/100], pDelays[iCount-1]);
+}
+
+int main(int argc, char *argv[])
+{
+   const char* szTraceFile = NULL;
+   const char* szSaveFile = NULL;
+   int iSeconds = 3;
+   int iFPS = 60;
+   int iPort = 5611;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-trace")) && (i < argc-1) )
+         szTraceFile = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-save")) && (i < argc-1) )
+         szSaveFile = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-seconds")) && (i < argc-1) )
+         iSeconds = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-fps")) && (i < argc-1) )
+         iFPS = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-port")) && (i < argc-1) )
+         iPort = atoi(argv[++i]);
+      else
+      {
+         printf("Usage: %s [-trace file] [-save file] [-seconds N] [-fps N] [-port N]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iSeconds < 1 )
+      iSeconds = 1;
+   if ( iFPS < 1 )
+      iFPS = 60;
+
+   printf("\nReplaying camera and radio input through the event loop...\n");
+   log_disable();
+
+   s_pEvents = (type_replay_event*)malloc(REPLAY_MAX_EVENTS * sizeof(type_replay_event));
+   if ( NULL != szTraceFile )
+   {
+      if ( ! _load_trace(szTraceFile) )
+      {
+         printf("Failed to load trace file %s\n", szTraceFile);
+         return 1;
+      }
+   }
+   else
+      _generate_trace(iSeconds, iFPS);
+   qsort(s_pEvents, s_iCountEvents, sizeof(type_replay_event), _compare_events);
+   for( int i=0; i<s_iCountEvents; i++ )
+   {
+      if ( s_pEvents[i].uType == 'c' )
+         s_iCountCamera++;
+      else
+         s_iCountRadio++;
+   }
+   printf("Trace: %d camera packets, %d radio packets, %.1f s\n", s_iCountCamera, s_iCountRadio, (s_iCountEvents > 0)?(double)s_pEvents[s_iCountEvents-1].uTimeMicros/1000000.0:0.0);
+   if ( NULL != szSaveFile )
+      _save_trace(szSaveFile);
+   s_pDelaysCamera = (u32*)malloc((s_iCountCamera+1) * sizeof(u32));
+   s_pDelaysRadio = (u32*)malloc((s_iCountRadio+1) * sizeof(u32));
+
+   // Camera input: UDP socket on localhost, like the majestic stream
+   s_iSocketRx = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+   s_iSocketTx = socket(AF_INET, SOCK_DGRAM, 0);
+   int iRecvSize = 4*1024*1024;
+   setsockopt(s_iSocketRx, SOL_SOCKET, SO_RCVBUF, &iRecvSize, sizeof(iRecvSize));
+   memset(&s_AddrCamera, 0, sizeof(s_AddrCamera));
+   s_AddrCamera.sin_family = AF_INET;
+   s_AddrCamera.sin_port = htons(iPort);
+   s_AddrCamera.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if ( (s_iSocketRx < 0) || (s_iSocketTx < 0) || (0 != bind(s_iSocketRx, (struct sockaddr*)&s_AddrCamera, sizeof(s_AddrCamera))) )
+   {
+      printf("Failed to open the camera UDP sockets on port %d\n", iPort);
+      return 1;
+   }
+   _check(0 != video_source_udp_batch_init(&s_CameraReader, s_iSocketRx, UDP_BATCH_MAX_PACKETS), "init camera batch reader");
+   _check(1 == radio_rx_queue_wakeup_init(&s_Wakeup), "init radio rx wakeup");
+   _check(1 == radio_rx_queue_init(&s_Queue, 1024, &s_Wakeup), "init radio rx queue");
+
+   _check(1 == event_loop_init(&s_Loop), "init event loop");
+   int iSourceCamera = event_loop_add_fd(&s_Loop, "camera", s_iSocketRx, EVENT_LOOP_PRIORITY_HIGH, _on_camera, _on_camera_prepare, NULL, NULL);
+   event_loop_add_fd(&s_Loop, "radio-rx", s_Wakeup.iEventFd, EVENT_LOOP_PRIORITY_HIGH, _on_radio_rx, _on_radio_rx_prepare, _on_radio_rx_finish, NULL);
+   event_loop_add_timer(&s_Loop, "ipc", 5000, EVENT_LOOP_PRIORITY_NORMAL, _on_ipc, NULL);
+   event_loop_add_timer(&s_Loop, "housekeeping", 10000, EVENT_LOOP_PRIORITY_LOW, _on_housekeeping, NULL);
+   event_loop_set_time_slice(&s_Loop, iSourceCamera, 500000 / iFPS);
+
+   s_uReplayStartMicros = event_loop_get_time_micros() + 10000;
+   s_iReplayRunning = 1;
+   pthread_t thread;
+   pthread_create(&thread, NULL, _thread_replay, NULL);
+   while ( s_iReplayRunning )
+      event_loop_run_once(&s_Loop, 100);
+   pthread_join(thread, NULL);
+   for( int i=0; i<10; i++ )
+      event_loop_run_once(&s_Loop, 5);
+
+   printf("End-to-end scheduling delay (input scheduled time to handler):\n");
+   int iCameraReceived = s_iCountDelaysCamera;
+   int iRadioReceived = s_iCountDelaysRadio;
+   _print_delays("camera", s_pDelaysCamera, s_iCountDelaysCamera);
+   _print_delays("radio", s_pDelaysRadio, s_iCountDelaysRadio);
+
+   shared_mem_loop_latency_stats* pStats = event_loop_get_stats(&s_Loop);
+   printf("Handlers run time:\n");
+   for( int i=0; i<pStats->iCountHandlers; i++ )
+   {
+      shared_mem_loop_handler_stats* pHandler = &(pStats->handlers[i]);
+      printf("  %-13s %6u runs, avg %6.1f us, max %6u us, time slice %5u us, slice overruns %u, missed timer ticks %u\n",
+         pHandler->szName, pHandler->uTotalRuns,
+         (pHandler->uTotalRuns > 0)?(double)pHandler->uTotalRunMicros/(double)pHandler->uTotalRuns:0.0,
+         pHandler->uMaxRunMicros, pHandler->uTimeSliceMicros, pHandler->uTotalSliceOverruns, pHandler->uTotalMissedTimerTicks);
+   }
+
+   _check(iRadioReceived == s_iCountRadio, "all radio packets handled");
+   _check(iCameraReceived + (int)s_CameraReader.uTotalDroppedPackets >= s_iCountCamera, "all camera packets handled or counted as dropped by the socket");
+   _check(0 == s_CameraReader.uTotalDroppedPackets, "no camera packets dropped by the socket");
+   _check(pStats->handlers[0].uTotalRuns > 0, "camera handler run");
+
+   event_loop_close(&s_Loop);
+   video_source_udp_batch_free(&s_CameraReader);
+   radio_rx_queue_free(&s_Queue);
+   radio_rx_queue_wakeup_close(&s_Wakeup);
+   close(s_iSocketRx);
+   close(s_iSocketTx);
+   free(s_pEvents);
+   free(s_pDelaysCamera);
+   free(s_pDelaysRadio);
+
+   if ( s_iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,139 @@
+#include "../base/base.h"
+
+#include "../radio/fec.h"
+
+// Checks that every FEC kernel supported on this CPU produces byte-identical
+// output to the scalar reference kernel, for random blocks and erasures.
+
+#define MAX_DATA_PACKETS 32
+#define MAX_FEC_PACKETS 16
+#define MAX_PACKET_SIZE 1500
+#define TEST_ITERATIONS 2000
+
+u8 s_DataOrig[MAX_DATA_PACKETS][MAX_PACKET_SIZE];
+u8 s_FecRef[MAX_FEC_PACKETS][MAX_PACKET_SIZE];
+u8 s_FecTest[MAX_FEC_PACKETS][MAX_PACKET_SIZE];
+u8 s_DataDecodeRef[MAX_DATA_PACKETS][MAX_PACKET_SIZE];
+u8 s_DataDecodeTest[MAX_DATA_PACKETS][MAX_PACKET_SIZE];
+u8 s_FecDecodeRef[MAX_FEC_PACKETS][MAX_PACKET_SIZE];
+u8 s_FecDecodeTest[MAX_FEC_PACKETS][MAX_PACKET_SIZE];
+
+// Encodes with the given kernel, then erases random data packets and decodes them back
+void _run_encode_decode(int iKernel, int iDataPackets, int iFecPackets, int iSize, u8 fecOut[MAX_FEC_PACKETS][MAX_PACKET_SIZE], u8 dataOut[MAX_DATA_PACKETS][MAX_PACKET_SIZE], u8 fecDecode[MAX_FEC_PACKETS][MAX_PACKET_SIZE], unsigned int* pErased, unsigned int* pFecNos, int iErased)
+{
+   u8* pData[MAX_DATA_PACKETS];
+   u8* pFec[MAX_FEC_PACKETS];
+
+   fec_set_kernel(iKernel);
+
+   for( int i=0; i<iDataPackets; i++ )
+      pData[i] = s_DataOrig[i];
+   for( int i=0; i<iFecPackets; i++ )
+   {
+      memset(fecOut[i], 0xA5, MAX_PACKET_SIZE);
+      pFec[i] = fecOut[i];
+   }
+   fec_encode(iSize, pData, iDataPackets, pFec, iFecPackets);
+
+   for( int i=0; i<iDataPackets; i++ )
+   {
+      memcpy(dataOut[i], s_DataOrig[i], MAX_PACKET_SIZE);
+      pData[i] = dataOut[i];
+   }
+   for( int i=0; i<iErased; i++ )
+      memset(dataOut[pErased[i]], 0, iSize);
+
+   for( int i=0; i<iErased; i++ )
+   {
+      memcpy(fecDecode[i], fecOut[pFecNos[i]], MAX_PACKET_SIZE);
+      pFec[i] = fecDecode[i];
+   }
+   if ( iErased > 0 )
+      fec_decode(iSize, pData, iDataPackets, pFec, pFecNos, pErased, iErased);
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting FEC kernels against the scalar reference...\n");
+
+   fec_init();
+   int iDefaultKernel = fec_get_kernel();
+   printf("Default kernel: %s\n", fec_get_kernel_name(iDefaultKernel));
+
+   srand(12345);
+   int iFailures = 0;
+
+   for( int iKernel=0; iKernel<FEC_KERNEL_COUNT; iKernel++ )
+   {
+      if ( iKernel == FEC_KERNEL_SCALAR )
+         continue;
+      if ( ! fec_is_kernel_supported(iKernel) )
+      {
+         printf("Kernel %s: not supported on this CPU, skipped.\n", fec_get_kernel_name(iKernel));
+         continue;
+      }
+
+      int iKernelFailures = 0;
+      for( int iTest=0; iTest<TEST_ITERATIONS; iTest++ )
+      {
+         int iDataPackets = 1 + rand() % MAX_DATA_PACKETS;
+         int iFecPackets = 1 + rand() % MAX_FEC_PACKETS;
+         int iSize = 1 + rand() % MAX_PACKET_SIZE;
+
+         for( int i=0; i<iDataPackets; i++ )
+         for( int k=0; k<MAX_PACKET_SIZE; k++ )
+            s_DataOrig[i][k] = rand() & 0xFF;
+
+         // Pick random distinct erased data packets (sorted) and random distinct fec packets to recover them
+         unsigned int uErased[MAX_FEC_PACKETS];
+         unsigned int uFecNos[MAX_FEC_PACKETS];
+         int iMaxErased = (iFecPackets < iDataPackets)?iFecPackets:iDataPackets;
+         int iErased = rand() % (iMaxErased+1);
+         int iCount = 0;
+         for( int i=0; i<iDataPackets && iCount < iErased; i++ )
+         {
+            if ( (rand() % (iDataPackets - i)) < (iErased - iCount) )
+               uErased[iCount++] = i;
+         }
+         iCount = 0;
+         for( int i=0; i<iFecPackets && iCount < iErased; i++ )
+         {
+            if ( (rand() % (iFecPackets - i)) < (iErased - iCount) )
+               uFecNos[iCount++] = i;
+         }
+
+         _run_encode_decode(FEC_KERNEL_SCALAR, iDataPackets, iFecPackets, iSize, s_FecRef, s_DataDecodeRef, s_FecDecodeRef, uErased, uFecNos, iErased);
+         _run_encode_decode(iKernel, iDataPackets, iFecPackets, iSize, s_FecTest, s_DataDecodeTest, s_FecDecodeTest, uErased, uFecNos, iErased);
+
+         bool bOk = true;
+         for( int i=0; i<iFecPackets; i++ )
+            if ( 0 != memcmp(s_FecRef[i], s_FecTest[i], MAX_PACKET_SIZE) )
+               bOk = false;
+         for( int i=0; i<iDataPackets; i++ )
+         {
+            if ( 0 != memcmp(s_DataDecodeRef[i], s_DataDecodeTest[i], MAX_PACKET_SIZE) )
+               bOk = false;
+            if ( 0 != memcmp(s_DataOrig[i], s_DataDecodeTest[i], iSize) )
+               bOk = false;
+         }
+         if ( ! bOk )
+         {
+            if ( iKernelFailures < 10 )
+               printf("Kernel %s: mismatch on test %d (data: %d, fec: %d, size: %d, erased: %d)\n", fec_get_kernel_name(iKernel), iTest, iDataPackets, iFecPackets, iSize, iErased);
+            iKernelFailures++;
+         }
+      }
+      printf("Kernel %s: %d tests, %d failures.\n", fec_get_kernel_name(iKernel), TEST_ITERATIONS, iKernelFailures);
+      iFailures += iKernelFailures;
+   }
+
+   fec_set_kernel(iDefaultKernel);
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d mismatches.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
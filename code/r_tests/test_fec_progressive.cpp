@@ -0,0 +1,237 @@
+#include "../base/base.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/fec.h"
+#include "../r_vehicle/generic_tx_ecbuffers.h"
+
+// Checks that progressive (per data packet) EC encoding produces output
+// bit-identical to the batch fec_encode, both directly and through GenericTxECBuffers.
+
+#define MAX_PACKET_SIZE 1500
+#define TEST_ITERATIONS 2000
+
+u8 s_Data[MAX_DATA_PACKETS_IN_BLOCK][MAX_PACKET_SIZE];
+u8 s_FecBatch[MAX_FECS_PACKETS_IN_BLOCK][MAX_PACKET_SIZE];
+u8 s_FecProgressive[MAX_FECS_PACKETS_IN_BLOCK][MAX_PACKET_SIZE];
+
+int _test_fec_encode_progressive()
+{
+   int iFailures = 0;
+   u8* pData[MAX_DATA_PACKETS_IN_BLOCK];
+   u8* pFecBatch[MAX_FECS_PACKETS_IN_BLOCK];
+   u8* pFecProgressive[MAX_FECS_PACKETS_IN_BLOCK];
+
+   for( int iTest=0; iTest<TEST_ITERATIONS; iTest++ )
+   {
+      int iDataPackets = 1 + rand() % MAX_DATA_PACKETS_IN_BLOCK;
+      int iECPackets = 1 + rand() % MAX_FECS_PACKETS_IN_BLOCK;
+      int iSize = 1 + rand() % MAX_PACKET_SIZE;
+
+      // Progressive encoding can be started for a larger EC scheme and the block
+      // closed earlier (short block at end of frame), using just the first EC packets.
+      int iECPacketsUsed = 1 + rand() % iECPackets;
+
+      for( int i=0; i<iDataPackets; i++ )
+      {
+         for( int k=0; k<iSize; k++ )
+            s_Data[i][k] = rand() & 0xFF;
+         pData[i] = s_Data[i];
+      }
+      for( int i=0; i<iECPackets; i++ )
+      {
+         memset(s_FecBatch[i], 0x5A, MAX_PACKET_SIZE);
+         memset(s_FecProgressive[i], 0x5A, MAX_PACKET_SIZE);
+         pFecBatch[i] = s_FecBatch[i];
+         pFecProgressive[i] = s_FecProgressive[i];
+      }
+
+      fec_encode(iSize, pData, iDataPackets, pFecBatch, iECPacketsUsed);
+      for( int i=0; i<iDataPackets; i++ )
+         fec_encode_add_data_block(iSize, pData[i], i, pFecProgressive, iECPackets);
+
+      for( int i=0; i<iECPacketsUsed; i++ )
+      {
+         if ( 0 != memcmp(s_FecBatch[i], s_FecProgressive[i], MAX_PACKET_SIZE) )
+         {
+            if ( iFailures < 10 )
+               printf("Mismatch on test %d, EC packet %d (data: %d, ec: %d/%d, size: %d)\n", iTest, i, iDataPackets, iECPacketsUsed, iECPackets, iSize);
+            iFailures++;
+            break;
+         }
+      }
+   }
+   printf("fec_encode_add_data_block: %d tests, %d failures.\n", TEST_ITERATIONS, iFailures);
+   return iFailures;
+}
+
+// Video tx block layout: the EC packets are computed progressively in the slots following the data packets
+// count set at block start. The block data packets count can grow mid-block (frame end packets appended to the
+// block): the data packets then use the EC slots, so the progressive encoding must stop and the EC packets be
+// computed at once at block end. Same rule as VideoTxPacketsBuffer. Returns the blocks with bad data or EC packets.
+int _test_progressive_scheme_growth(bool bStopOnGrowth)
+{
+   static u8 s_Slots[MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_SIZE];
+   int iBadBlocks = 0;
+   int iProgressiveBlocks = 0;
+   u8* pData[MAX_DATA_PACKETS_IN_BLOCK];
+   u8* pFec[MAX_FECS_PACKETS_IN_BLOCK];
+
+   for( int iTest=0; iTest<TEST_ITERATIONS/4; iTest++ )
+   {
+      int iECPackets = 1 + rand() % 8;
+      int iBlockDataPackets = 2 + rand() % 14;
+      int iGrownDataPackets = iBlockDataPackets + 1 + rand() % 5;
+      int iGrowAtPacket = 1 + rand() % (iBlockDataPackets - 1);
+      // Some blocks are shortened instead: the progressive EC packets are still used
+      if ( 0 == (rand() % 4) )
+      {
+         iGrownDataPackets = 1 + rand() % (iBlockDataPackets - 1);
+         iGrowAtPacket = 0;
+      }
+      int iSize = 1 + rand() % MAX_PACKET_SIZE;
+
+      for( int i=0; i<iGrownDataPackets; i++ )
+      for( int k=0; k<MAX_PACKET_SIZE; k++ )
+         s_Data[i][k] = (k < iSize)?(rand() & 0xFF):0;
+
+      // Block start: EC slots follow the first iBlockDataPackets slots
+      int iProgressiveECPackets = iECPackets;
+      int iProgressiveDataPacketsAdded = 0;
+      int iDataPackets = iBlockDataPackets;
+      for( int i=0; i<iGrownDataPackets; i++ )
+      {
+         if ( i == iGrowAtPacket )
+            iDataPackets = iGrownDataPackets;
+         memcpy(s_Slots[i], s_Data[i], MAX_PACKET_SIZE);
+
+         if ( iProgressiveECPackets <= 0 )
+            continue;
+         if ( bStopOnGrowth && ((i >= iBlockDataPackets) || (iDataPackets > iBlockDataPackets)) )
+         {
+            iProgressiveECPackets = 0;
+            continue;
+         }
+         if ( (i != iProgressiveDataPacketsAdded) || (i >= MAX_TOTAL_PACKETS_IN_BLOCK - iProgressiveECPackets) )
+            continue;
+         for( int k=0; k<iProgressiveECPackets; k++ )
+            pFec[k] = s_Slots[iBlockDataPackets + k];
+         fec_encode_add_data_block(iSize, s_Slots[i], i, pFec, iProgressiveECPackets);
+         iProgressiveDataPacketsAdded++;
+      }
+
+      // Block end: EC packets follow the last data packet
+      if ( (iProgressiveECPackets >= iECPackets) && (iProgressiveDataPacketsAdded == iDataPackets) )
+      {
+         iProgressiveBlocks++;
+         for( int k=0; k<iECPackets; k++ )
+            memcpy(s_FecProgressive[k], s_Slots[iBlockDataPackets + k], MAX_PACKET_SIZE);
+         for( int k=0; k<iECPackets; k++ )
+            memcpy(s_Slots[iDataPackets + k], s_FecProgressive[k], MAX_PACKET_SIZE);
+      }
+      else
+      {
+         for( int i=0; i<iDataPackets; i++ )
+            pData[i] = s_Slots[i];
+         for( int k=0; k<iECPackets; k++ )
+            pFec[k] = s_Slots[iDataPackets + k];
+         fec_encode(iSize, pData, iDataPackets, pFec, iECPackets);
+      }
+
+      for( int i=0; i<iDataPackets; i++ )
+         pData[i] = s_Data[i];
+      for( int k=0; k<iECPackets; k++ )
+         pFec[k] = s_FecBatch[k];
+      fec_encode(iSize, pData, iDataPackets, pFec, iECPackets);
+
+      bool bOk = true;
+      for( int i=0; (i<iDataPackets) && bOk; i++ )
+         bOk = (0 == memcmp(s_Slots[i], s_Data[i], iSize));
+      for( int k=0; (k<iECPackets) && bOk; k++ )
+         bOk = (0 == memcmp(s_Slots[iDataPackets + k], s_FecBatch[k], iSize));
+      if ( ! bOk )
+         iBadBlocks++;
+   }
+   printf("Progressive EC with the block data packets changing mid-block (%s): %d blocks, %d progressive, %d bad blocks.\n", bStopOnGrowth?"stop on growth":"no check", TEST_ITERATIONS/4, iProgressiveBlocks, iBadBlocks);
+   return iBadBlocks;
+}
+
+int _test_generic_tx_ec_buffers(bool bEnableCRC)
+{
+   int iFailures = 0;
+   int iBlocks = 8;
+   u32 uDataPackets = 6;
+   u32 uECPackets = 3;
+   int iPacketLength = 400;
+
+   GenericTxECBuffers buffersBatch;
+   GenericTxECBuffers buffersProgressive;
+   buffersBatch.setProgressiveECEncoding(false);
+   buffersProgressive.setProgressiveECEncoding(true);
+   buffersBatch.init(iBlocks, bEnableCRC, uDataPackets, uECPackets, iPacketLength);
+   buffersProgressive.init(iBlocks, bEnableCRC, uDataPackets, uECPackets, iPacketLength);
+
+   u8 uBuffer[2000];
+   u32 uBlockIndex = 0;
+   for( int iTest=0; iTest<500; iTest++ )
+   {
+      int iLength = 1 + rand() % 1500;
+      for( int i=0; i<iLength; i++ )
+         uBuffer[i] = rand() & 0xFF;
+      int iFilledBatch = buffersBatch.addData(uBuffer, iLength);
+      int iFilledProgressive = buffersProgressive.addData(uBuffer, iLength);
+      if ( iFilledBatch != iFilledProgressive )
+      {
+         printf("Different filled packets count: %d / %d\n", iFilledBatch, iFilledProgressive);
+         iFailures++;
+      }
+
+      // Compare all the packets (data and EC) of the last complete blocks
+      while ( true )
+      {
+         int iSizeBatch = 0, iSizeProgressive = 0;
+         u8* pBatch = buffersBatch.getPacket(uBlockIndex, uDataPackets + uECPackets - 1, &iSizeBatch);
+         if ( NULL == pBatch )
+            break;
+         for( u32 u=0; u<uDataPackets + uECPackets; u++ )
+         {
+            pBatch = buffersBatch.getPacket(uBlockIndex, u, &iSizeBatch);
+            u8* pProgressive = buffersProgressive.getPacket(uBlockIndex, u, &iSizeProgressive);
+            if ( (NULL == pBatch) || (NULL == pProgressive) || (iSizeBatch != iSizeProgressive) || (0 != memcmp(pBatch, pProgressive, iSizeBatch)) )
+            {
+               if ( iFailures < 10 )
+                  printf("GenericTxECBuffers mismatch on block %u, packet %u\n", uBlockIndex, u);
+               iFailures++;
+            }
+         }
+         uBlockIndex++;
+      }
+   }
+   printf("GenericTxECBuffers (CRC %s): %u blocks compared, %d failures.\n", bEnableCRC?"on":"off", uBlockIndex, iFailures);
+   return iFailures;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting progressive FEC encoding against batch fec_encode...\n");
+   fec_init();
+   srand(4321);
+
+   int iFailures = 0;
+   iFailures += _test_fec_encode_progressive();
+   iFailures += _test_generic_tx_ec_buffers(false);
+   iFailures += _test_generic_tx_ec_buffers(true);
+   iFailures += _test_progressive_scheme_growth(true);
+   // Folding the data packets that landed in the EC slots must be detected as bad
+   if ( 0 == _test_progressive_scheme_growth(false) )
+   {
+      printf("Progressive EC scheme growth check did not detect the bad blocks.\n");
+      iFailures++;
+   }
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d mismatches.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
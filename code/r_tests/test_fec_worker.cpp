@@ -0,0 +1,224 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+#include "../base/controller_rt_info.h"
+#include "../base/hardware_radio.h"
+#include "../base/packet_pool.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/fec.h"
+#include "../radio/fec_worker.h"
+#include "../r_station/video_rx_buffers.h"
+#include "video_link_fixture.h"
+
+#include <vector>
+#include <algorithm>
+
+// Tests the EC decoding of the station video blocks on the FEC worker threads: the same video stream
+// (EC encoded blocks, random losses, packets in order) goes through the VideoRxPacketsBuffer with the
+// EC decoding done in place (on the router thread) and by the FEC workers. The video packets must be
+// output in the same order, with the same content (checked against the sent video data).
+// Also resets the buffers while blocks are decoded by the workers (their results must be dropped and their
+// buffers not reused meanwhile), and reports the router time spent per received packet in both modes.
+//
+// Usage: test_fec_worker [-packets N] [-threads N] [-data N] [-ec N] [-loss percent]
+
+#define TEST_TEMPLATE_BLOCKS 32
+
+static int s_iBlockDataPackets = 12;
+static int s_iBlockECPackets = 8;
+static int s_iBlockPacketSize = 1200;
+static u8 s_uTemplatePackets[TEST_TEMPLATE_BLOCKS][MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_TOTAL_SIZE];
+static int s_iTemplateLengths[TEST_TEMPLATE_BLOCKS][MAX_TOTAL_PACKETS_IN_BLOCK];
+static u32 s_uRandom = 0x9E3779B9;
+
+typedef struct
+{
+   std::vector<u64> outputed; // block index << 8 | packet index
+   std::vector<u32> routerNanos; // per received packet
+   u32 uLostBlocks;
+   u32 uContentErrors;
+   u32 uResets;
+} type_test_run;
+
+static u64 _test_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+static void _set_packet_headers(u8* pPacket, int iLength, u32 uBlockIndex, int iPacketIndex, u32 uStreamPacketIndex)
+{
+   // Four blocks per frame
+   int iPacketInFrame = (int)(uBlockIndex % 4)*s_iBlockDataPackets + ((iPacketIndex < s_iBlockDataPackets)?iPacketIndex:(s_iBlockDataPackets-1));
+   video_fixture_set_packet_headers(pPacket, iLength, uBlockIndex, iPacketIndex, s_iBlockDataPackets, s_iBlockECPackets, s_iBlockPacketSize,
+      (u16)(uBlockIndex/4), 4*s_iBlockDataPackets, iPacketInFrame, uStreamPacketIndex);
+}
+
+static void _output_packet(type_rx_video_block_info* pBlock, type_rx_video_packet_info* pPacket, void* pContext)
+{
+   type_test_run* pRun = (type_test_run*)pContext;
+   int iHeadersSize = (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   u32 uBlockIndex = pPacket->pPHVS->uCurrentBlockIndex;
+   int iPacketIndex = pPacket->pPHVS->uCurrentBlockPacketIndex;
+   u8* pSent = s_uTemplatePackets[uBlockIndex % TEST_TEMPLATE_BLOCKS][iPacketIndex] + iHeadersSize;
+   int iLength = (int)sizeof(t_packet_header_video_segment_important) + ((t_packet_header_video_segment_important*)pSent)->uVideoDataLength;
+   if ( (uBlockIndex != pBlock->uVideoBlockIndex) || (0 != memcmp(pPacket->pVideoData, pSent, iLength)) )
+      pRun->uContentErrors++;
+   pRun->outputed.push_back(((u64)uBlockIndex << 8) | (u64)iPacketIndex);
+}
+
+// The bottom block is dropped once it's a few blocks behind
+static bool _can_discard_block(VideoRxPacketsBuffer* pRxBuffer, type_rx_video_block_info* pBlock, void* pContext)
+{
+   return (pRxBuffer->getCountBlocksInBuffer() >= 3);
+}
+
+static void _output_available_packets(VideoRxPacketsBuffer* pRxBuffer, type_test_run* pRun)
+{
+   pRun->uLostBlocks += (u32)video_fixture_output_available_packets(pRxBuffer, _output_packet, _can_discard_block, pRun);
+}
+
+// iResetEveryBlocks: empties the buffers while a block is decoded by a worker, about every that many blocks
+static void _run(type_test_run* pRun, int iPackets, int iLossPercent, int iResetEveryBlocks)
+{
+   s_uRandom = 0x12345678;
+   Model model;
+   VideoRxPacketsBuffer* pRxBuffer = new VideoRxPacketsBuffer(0, 0);
+   pRxBuffer->init(&model);
+   pRun->outputed.clear();
+   pRun->routerNanos.clear();
+   pRun->uLostBlocks = 0;
+   pRun->uContentErrors = 0;
+   pRun->uResets = 0;
+
+   int iBlockPackets = s_iBlockDataPackets + s_iBlockECPackets;
+   u32 uLastResetBlock = 0;
+   for( int i=0; i<iPackets; i++ )
+   {
+      u32 uBlockIndex = (u32)(i / iBlockPackets) + 1;
+      int iPacketIndex = i % iBlockPackets;
+      if ( (int)(video_fixture_random(&s_uRandom) % 100) < iLossPercent )
+         continue;
+      u8* pPacket = s_uTemplatePackets[uBlockIndex % TEST_TEMPLATE_BLOCKS][iPacketIndex];
+      int iLength = s_iTemplateLengths[uBlockIndex % TEST_TEMPLATE_BLOCKS][iPacketIndex];
+      _set_packet_headers(pPacket, iLength, uBlockIndex, iPacketIndex, (u32)i);
+
+      // Packets come here much faster than over the radio link: give the workers the time they would have
+      // in real time before the rx buffer fills up behind a block they decode
+      if ( (pRxBuffer->getCountBlocksInBuffer() > 8) && (fec_worker_get_pending_jobs() > 0) )
+         fec_worker_wait_all_completed(1000);
+
+      u64 uStart = _test_time_ns();
+      fec_worker_process_completed();
+      pRxBuffer->checkAddVideoPacket(pPacket, iLength, 0);
+      _output_available_packets(pRxBuffer, pRun);
+      pRun->routerNanos.push_back((u32)(_test_time_ns() - uStart));
+
+      if ( (iResetEveryBlocks > 0) && (uBlockIndex >= uLastResetBlock + (u32)iResetEveryBlocks) && (fec_worker_get_pending_jobs() > 0) )
+      {
+         uLastResetBlock = uBlockIndex;
+         pRxBuffer->emptyBuffers("test reset");
+         pRun->uResets++;
+      }
+   }
+   fec_worker_wait_all_completed(1000);
+   _output_available_packets(pRxBuffer, pRun);
+   delete pRxBuffer;
+}
+
+static void _print_router_times(const char* szName, type_test_run* pRun)
+{
+   std::vector<u32> times = pRun->routerNanos;
+   std::sort(times.begin(), times.end());
+   u64 uTotal = 0;
+   for( size_t i=0; i<times.size(); i++ )
+      uTotal += times[i];
+   size_t uCount = times.size();
+   if ( 0 == uCount )
+      return;
+   printf("  %-8s router time per packet: avg %6.2f us, p99 %6.2f us, p99.9 %6.2f us, max %7.2f us; %u packets out, %u blocks lost\n",
+      szName, (double)uTotal/(double)uCount/1000.0, (double)times[uCount*99/100]/1000.0, (double)times[uCount*999/1000]/1000.0,
+      (double)times[uCount-1]/1000.0, (u32)pRun->outputed.size(), pRun->uLostBlocks);
+}
+
+int main(int argc, char *argv[])
+{
+   int iPackets = 400000;
+   int iThreads = 2;
+   int iLossPercent = 15;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-packets")) && (i < argc-1) )
+         iPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-threads")) && (i < argc-1) )
+         iThreads = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-data")) && (i < argc-1) )
+         s_iBlockDataPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-ec")) && (i < argc-1) )
+         s_iBlockECPackets = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-loss")) && (i < argc-1) )
+         iLossPercent = atoi(argv[++i]);
+   }
+   if ( (s_iBlockDataPackets < 1) || (s_iBlockDataPackets > MAX_DATA_PACKETS_IN_BLOCK) || (s_iBlockECPackets < 1) ||
+        (s_iBlockDataPackets + s_iBlockECPackets > MAX_TOTAL_PACKETS_IN_BLOCK) )
+   {
+      printf("Invalid block scheme.\n");
+      return 1;
+   }
+
+   printf("\nTesting the FEC worker threads: %d packets, blocks %d/%d, %d%% loss, %d threads...\n", iPackets, s_iBlockDataPackets, s_iBlockECPackets, iLossPercent, iThreads);
+   log_disable();
+   hardware_radio_set_simulated_interfaces(1);
+   g_TimeStart = get_current_timestamp_ms();
+   g_TimeNow = g_TimeStart + 10000;
+   memset(&g_SMControllerRTInfo, 0, sizeof(controller_runtime_info));
+   fec_init();
+   video_fixture_build_random_blocks(s_uTemplatePackets, s_iTemplateLengths, TEST_TEMPLATE_BLOCKS, s_iBlockDataPackets, s_iBlockECPackets, s_iBlockPacketSize, &s_uRandom);
+
+   type_packet_pool_stats statsStart;
+   packet_pool_get_stats(&statsStart);
+   int iFailures = 0;
+
+   type_test_run runInPlace;
+   _run(&runInPlace, iPackets, iLossPercent, 0);
+
+   if ( fec_worker_start(iThreads, -1) != iThreads )
+   {
+      printf("Failed to start the FEC worker threads.\n");
+      return 1;
+   }
+   type_test_run runWorkers;
+   _run(&runWorkers, iPackets, iLossPercent, 0);
+   type_fec_worker_stats stats;
+   fec_worker_get_stats(&stats);
+
+   bool bSameOutput = (runInPlace.outputed == runWorkers.outputed);
+   if ( (! bSameOutput) || (0 != runInPlace.uContentErrors) || (0 != runWorkers.uContentErrors) || (0 == stats.uJobsCollected) )
+      iFailures++;
+   printf("Output order in place/workers: %s, content errors: %u/%u, %u blocks decoded by the workers (%u decoded in place, workers busy), avg decode %.1f us, max %u us: %s\n",
+      bSameOutput?"identical":"DIFFERENT", runInPlace.uContentErrors, runWorkers.uContentErrors,
+      stats.uJobsCollected, stats.uJobsRejected, (double)stats.uTotalDecodeMicros/(double)((stats.uJobsCollected > 0)?stats.uJobsCollected:1), stats.uMaxDecodeMicros,
+      ((0 == iFailures) && (stats.uJobsCollected > 0))?"ok":"FAILED");
+   _print_router_times("in place", &runInPlace);
+   _print_router_times("workers", &runWorkers);
+
+   type_test_run runResets;
+   _run(&runResets, iPackets/4, iLossPercent, 20);
+   fec_worker_stop();
+   type_packet_pool_stats statsEnd;
+   packet_pool_get_stats(&statsEnd);
+   bool bResetsOk = (0 == runResets.uContentErrors) && (runResets.uResets > 0) && (statsEnd.uBuffersInUse == statsStart.uBuffersInUse) && (0 == fec_worker_get_pending_jobs());
+   if ( ! bResetsOk )
+      iFailures++;
+   printf("Buffers reset with blocks in the workers: %u resets, %u packets out, content errors: %u, pool buffers in use: %u (start %u): %s\n",
+      runResets.uResets, (u32)runResets.outputed.size(), runResets.uContentErrors, statsEnd.uBuffersInUse, statsStart.uBuffersInUse, bResetsOk?"ok":"FAILED");
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d checks failed.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,346 @@
+#include "../base/base.h"
+#include "../base/latency_trace.h"
+#include "../radio/radio_rx_queue.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+// Video latency tracing, without radio hardware or a camera:
+// - bucket layout: each value falls in a bucket that holds it, with at most 12.5% error;
+// - synthetic replay of a video pipeline: stage delays with known distributions (regular frames,
+//   keyframes, a few retransmission outliers) are replayed in the trace and the p50/p95/p99 read back
+//   from the shared memory are checked against the exact percentiles of the replayed values;
+// - radio rx stage end to end: a producer thread pushes packets with their time in a rx queue (as the
+//   radio rx thread does) and the consumer records the queue time when it borrows them;
+// - lock free counting from several threads on the same stage: no update is lost;
+// - windowed values (snapshot diff), as the OSD and the dump tool show them.
+//
+// Usage: test_latency_trace [-frames N]
+
+#define TEST_SM_NAME "/RUBY_TEST_LATENCY_TRACE"
+#define TEST_THREADS 4
+#define TEST_THREAD_ADDS 250000
+#define TEST_QUEUE_PACKETS 20000
+
+static int s_iFailures = 0;
+
+static void _check(bool bCondition, const char* szMessage)
+{
+   if ( bCondition )
+      return;
+   printf("Failed: %s\n", szMessage);
+   s_iFailures++;
+}
+
+static u32 _exact_percentile(u32* pValues, int iCount, int iPercent)
+{
+   std::sort(pValues, pValues + iCount);
+   int iRank = (int)(((u64)iCount * (u64)iPercent + 99) / 100);
+   if ( iRank < 1 )
+      iRank = 1;
+   return pValues[iRank-1];
+}
+
+static void _check_percentile(const char* szStage, type_latency_trace_histogram* pHist, u32* pValues, int iCount, int iPercent)
+{
+   u32 uExact = _exact_percentile(pValues, iCount, iPercent);
+   u32 uTrace = latency_trace_histogram_get_percentile(pHist, iPercent);
+   char szBuff[256];
+   snprintf(szBuff, sizeof(szBuff), "%s p%d: trace %u us, exact %u us", szStage, iPercent, uTrace, uExact);
+   _check((uTrace >= uExact) && ((u64)uTrace*8 <= (u64)uExact*9 + 8), szBuff);
+}
+
+static void _test_buckets()
+{
+   int iLastBucket = 0;
+   for( u32 u=0; u<(((u32)1)<<LATENCY_TRACE_MAX_POW2) + 1000; u += 1 + u/512 )
+   {
+      int iBucket = latency_trace_get_bucket(u);
+      if ( (iBucket < iLastBucket) || (iBucket >= LATENCY_TRACE_BUCKETS) )
+      {
+         _check(false, "bucket index not increasing with the value");
+         return;
+      }
+      iLastBucket = iBucket;
+      u32 uMax = latency_trace_get_bucket_max_micros(iBucket);
+      if ( iBucket == LATENCY_TRACE_BUCKETS - 1 )
+         continue;
+      if ( (uMax < u) || ((u64)uMax*8 > (u64)u*9 + 8) )
+      {
+         printf("Value %u: bucket %d, bucket max %u\n", u, iBucket, uMax);
+         _check(false, "bucket does not hold the value within 12.5%");
+         return;
+      }
+   }
+   _check(latency_trace_get_bucket(0xFFFFFFFF) == LATENCY_TRACE_BUCKETS - 1, "overflow bucket");
+   printf("Buckets: %d per stage, %d bytes of shared memory per process.\n", LATENCY_TRACE_BUCKETS, (int)sizeof(type_latency_trace_stats));
+}
+
+static void _print_stages(type_latency_trace_stats* pStats)
+{
+   printf("  %-12s %9s %9s %9s %9s %9s\n", "stage", "count", "p50 us", "p95 us", "p99 us", "max us");
+   for( int i=0; i<LATENCY_TRACE_STAGES; i++ )
+   {
+      type_latency_trace_histogram* pHist = &(pStats->stages[i]);
+      printf("  %-12s %9u %9u %9u %9u %9u\n", latency_trace_get_stage_name(i), pHist->uCount,
+         latency_trace_histogram_get_percentile(pHist, 50),
+         latency_trace_histogram_get_percentile(pHist, 95),
+         latency_trace_histogram_get_percentile(pHist, 99),
+         pHist->uMaxMicros);
+   }
+}
+
+// Stage delays of a 60 fps stream: every 30th frame is a keyframe (about 6 times bigger), about 1.5% of the
+// packets are retransmitted (output delayed by a round trip), FEC recovery delays a few blocks.
+static void _test_synthetic_replay(type_latency_trace_stats* pReader, int iCountFrames)
+{
+   u32* pValues[LATENCY_TRACE_STAGES];
+   int iCounts[LATENCY_TRACE_STAGES];
+   for( int i=0; i<LATENCY_TRACE_STAGES; i++ )
+   {
+      pValues[i] = (u32*)malloc(sizeof(u32) * iCountFrames * 48);
+      iCounts[i] = 0;
+   }
+
+   u32 uRandom = 12345;
+   for( int iFrame=0; iFrame<iCountFrames; iFrame++ )
+   {
+      bool bKeyframe = (0 == (iFrame % 30));
+      int iPackets = bKeyframe?48:8; // at most 48 values per stage and frame
+      int iBlocks = (iPackets+7)/8;
+
+      uRandom = uRandom * 1103515245 + 12345;
+      u32 uCapture = 300 + ((uRandom >> 16) % 400) + (bKeyframe?3000:0);
+      pValues[LATENCY_TRACE_STAGE_CAPTURE][iCounts[LATENCY_TRACE_STAGE_CAPTURE]++] = uCapture;
+
+      for( int iBlock=0; iBlock<iBlocks; iBlock++ )
+      {
+         uRandom = uRandom * 1103515245 + 12345;
+         u32 uFEC = uCapture + 150 + ((uRandom >> 16) % 100);
+         pValues[LATENCY_TRACE_STAGE_FEC_BLOCK][iCounts[LATENCY_TRACE_STAGE_FEC_BLOCK]++] = uFEC;
+
+         uRandom = uRandom * 1103515245 + 12345;
+         u32 uBlockComplete = 1500 + ((uRandom >> 16) % 1000);
+         if ( 0 == ((uRandom >> 8) % 50) )
+            uBlockComplete += 15000; // waited for a retransmission
+         pValues[LATENCY_TRACE_STAGE_BLOCK_COMPLETE][iCounts[LATENCY_TRACE_STAGE_BLOCK_COMPLETE]++] = uBlockComplete;
+      }
+
+      for( int iPacket=0; iPacket<iPackets; iPacket++ )
+      {
+         uRandom = uRandom * 1103515245 + 12345;
+         u32 uTx = uCapture + 200 + (u32)iPacket * 250 + ((uRandom >> 16) % 50);
+         pValues[LATENCY_TRACE_STAGE_RADIO_TX][iCounts[LATENCY_TRACE_STAGE_RADIO_TX]++] = uTx;
+
+         uRandom = uRandom * 1103515245 + 12345;
+         u32 uOutput = 40 + ((uRandom >> 16) % 60);
+         if ( 0 == ((uRandom >> 4) % 64) )
+            uOutput += 20000 + ((uRandom >> 16) % 5000); // retransmitted packet
+         pValues[LATENCY_TRACE_STAGE_OUTPUT][iCounts[LATENCY_TRACE_STAGE_OUTPUT]++] = uOutput;
+      }
+   }
+
+   for( int iStage=0; iStage<LATENCY_TRACE_STAGES; iStage++ )
+   for( int i=0; i<iCounts[iStage]; i++ )
+      latency_trace_add(iStage, pValues[iStage][i]);
+
+   type_latency_trace_stats* pSnapshot = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   latency_trace_snapshot(pReader, pSnapshot);
+   printf("Synthetic replay, %d frames (read from the shared memory):\n", iCountFrames);
+   _print_stages(pSnapshot);
+
+   int iPercents[3] = { 50, 95, 99 };
+   for( int iStage=0; iStage<LATENCY_TRACE_STAGES; iStage++ )
+   {
+      if ( 0 == iCounts[iStage] )
+         continue;
+      _check(pSnapshot->stages[iStage].uCount == (u32)iCounts[iStage], "replayed values count");
+      for( int k=0; k<3; k++ )
+         _check_percentile(latency_trace_get_stage_name(iStage), &(pSnapshot->stages[iStage]), pValues[iStage], iCounts[iStage], iPercents[k]);
+   }
+   // Retransmissions must show in the output p99 only
+   _check(latency_trace_histogram_get_percentile(&(pSnapshot->stages[LATENCY_TRACE_STAGE_OUTPUT]), 95) < 200, "output p95 without retransmissions");
+   _check(latency_trace_histogram_get_percentile(&(pSnapshot->stages[LATENCY_TRACE_STAGE_OUTPUT]), 99) > 20000, "output p99 with retransmissions");
+
+   free(pSnapshot);
+   for( int i=0; i<LATENCY_TRACE_STAGES; i++ )
+      free(pValues[i]);
+}
+
+static type_radio_rx_queue s_Queue;
+static type_radio_rx_queue_wakeup s_QueueWakeup;
+
+static void* _thread_queue_producer(void* pArg)
+{
+   u8 uPacket[200];
+   memset(uPacket, 0x55, sizeof(uPacket));
+   for( int i=0; i<TEST_QUEUE_PACKETS; i++ )
+   {
+      while ( ! radio_rx_queue_push_timed(&s_Queue, uPacket, sizeof(uPacket), 0, latency_trace_get_time_micros()) )
+         hardware_sleep_micros(50);
+      if ( 0 == (i % 16) )
+         hardware_sleep_micros(100);
+   }
+   return NULL;
+}
+
+static void _test_radio_rx_stage(type_latency_trace_stats* pReader)
+{
+   type_latency_trace_stats* pBefore = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   type_latency_trace_stats* pAfter = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   type_latency_trace_stats* pWindow = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   latency_trace_snapshot(pReader, pBefore);
+
+   radio_rx_queue_wakeup_init(&s_QueueWakeup);
+   radio_rx_queue_init(&s_Queue, 256, &s_QueueWakeup);
+
+   pthread_t thread;
+   pthread_create(&thread, NULL, &_thread_queue_producer, NULL);
+   int iReceived = 0;
+   int iUntimed = 0;
+   while ( iReceived < TEST_QUEUE_PACKETS )
+   {
+      int iLength = 0;
+      u8* pPacket = radio_rx_queue_borrow(&s_Queue, 100000, &iLength, NULL);
+      if ( NULL == pPacket )
+         continue;
+      iReceived++;
+      u64 uTime = radio_rx_queue_get_borrowed_time_micros(&s_Queue);
+      if ( 0 == uTime )
+         iUntimed++;
+      latency_trace_add_since(LATENCY_TRACE_STAGE_RADIO_RX, uTime);
+      // Main loop busy with something else from time to time: packets wait in the queue
+      if ( 0 == (iReceived % 500) )
+         hardware_sleep_micros(2000);
+   }
+   radio_rx_queue_release(&s_Queue);
+   pthread_join(thread, NULL);
+   radio_rx_queue_free(&s_Queue);
+   radio_rx_queue_wakeup_close(&s_QueueWakeup);
+
+   latency_trace_snapshot(pReader, pAfter);
+   latency_trace_histogram_diff(&(pAfter->stages[LATENCY_TRACE_STAGE_RADIO_RX]), &(pBefore->stages[LATENCY_TRACE_STAGE_RADIO_RX]), &(pWindow->stages[LATENCY_TRACE_STAGE_RADIO_RX]));
+   type_latency_trace_histogram* pHist = &(pWindow->stages[LATENCY_TRACE_STAGE_RADIO_RX]);
+   printf("Radio rx queue stage, %d packets: p50 %u us, p95 %u us, p99 %u us, max %u us\n",
+      pHist->uCount,
+      latency_trace_histogram_get_percentile(pHist, 50),
+      latency_trace_histogram_get_percentile(pHist, 95),
+      latency_trace_histogram_get_percentile(pHist, 99),
+      pHist->uMaxMicros);
+   _check(0 == iUntimed, "rx queue packets without push time");
+   _check(pHist->uCount == TEST_QUEUE_PACKETS, "rx queue stage count (window)");
+   _check(pHist->uMaxMicros >= 1000, "rx queue stage shows the consumer stalls");
+
+   free(pBefore);
+   free(pAfter);
+   free(pWindow);
+}
+
+static void* _thread_adds(void* pArg)
+{
+   int iThread = *(int*)pArg;
+   for( int i=0; i<TEST_THREAD_ADDS; i++ )
+      latency_trace_add(LATENCY_TRACE_STAGE_RADIO_TX, (u32)((i + iThread) % 5000));
+   return NULL;
+}
+
+static void _test_concurrent_adds(type_latency_trace_stats* pReader)
+{
+   type_latency_trace_stats* pBefore = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   type_latency_trace_stats* pAfter = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   type_latency_trace_histogram window;
+   latency_trace_snapshot(pReader, pBefore);
+
+   pthread_t threads[TEST_THREADS];
+   int iThreadIndex[TEST_THREADS];
+   u64 uStart = latency_trace_get_time_micros();
+   for( int i=0; i<TEST_THREADS; i++ )
+   {
+      iThreadIndex[i] = i;
+      pthread_create(&threads[i], NULL, &_thread_adds, &iThreadIndex[i]);
+   }
+   for( int i=0; i<TEST_THREADS; i++ )
+      pthread_join(threads[i], NULL);
+   u64 uDuration = latency_trace_get_time_micros() - uStart;
+
+   latency_trace_snapshot(pReader, pAfter);
+   latency_trace_histogram_diff(&(pAfter->stages[LATENCY_TRACE_STAGE_RADIO_TX]), &(pBefore->stages[LATENCY_TRACE_STAGE_RADIO_TX]), &window);
+
+   u64 uExpectedSum = 0;
+   for( int t=0; t<TEST_THREADS; t++ )
+   for( int i=0; i<TEST_THREAD_ADDS; i++ )
+      uExpectedSum += (u64)((i + t) % 5000);
+   u32 uBucketsTotal = 0;
+   for( int i=0; i<LATENCY_TRACE_BUCKETS; i++ )
+      uBucketsTotal += window.uBuckets[i];
+
+   printf("Concurrent adds: %d threads x %d values, %.1f ns per add.\n", TEST_THREADS, TEST_THREAD_ADDS,
+      (double)uDuration * 1000.0 / (double)(TEST_THREADS * TEST_THREAD_ADDS));
+   _check(window.uCount == TEST_THREADS * TEST_THREAD_ADDS, "concurrent adds count");
+   _check(uBucketsTotal == TEST_THREADS * TEST_THREAD_ADDS, "concurrent adds buckets total");
+   _check(window.uSumMicros == uExpectedSum, "concurrent adds sum");
+   _check(pAfter->stages[LATENCY_TRACE_STAGE_RADIO_TX].uMaxMicros >= 4999, "concurrent adds max");
+
+   free(pBefore);
+   free(pAfter);
+}
+
+int main(int argc, char *argv[])
+{
+   int iCountFrames = 6000;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-frames")) && (i < argc-1) )
+         iCountFrames = atoi(argv[++i]);
+      else
+      {
+         printf("Usage: %s [-frames N]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iCountFrames < 100 )
+      iCountFrames = 100;
+
+   printf("\nTesting the video latency tracing...\n");
+   log_disable();
+
+   _test_buckets();
+
+   // Not initialized: adds are ignored
+   latency_trace_add(LATENCY_TRACE_STAGE_CAPTURE, 100);
+   _check(! latency_trace_is_enabled(), "enabled before init");
+
+   if ( ! latency_trace_init(TEST_SM_NAME) )
+   {
+      printf("Failed to create the shared memory.\n");
+      return 1;
+   }
+   type_latency_trace_stats* pReader = latency_trace_open_for_read(TEST_SM_NAME);
+   if ( NULL == pReader )
+   {
+      printf("Failed to open the shared memory for read.\n");
+      return 1;
+   }
+   _check(0 == pReader->stages[LATENCY_TRACE_STAGE_CAPTURE].uCount, "values added before init");
+   latency_trace_add_since(LATENCY_TRACE_STAGE_CAPTURE, 0);
+   _check(0 == pReader->stages[LATENCY_TRACE_STAGE_CAPTURE].uCount, "untimed value added");
+
+   _test_synthetic_replay(pReader, iCountFrames);
+   _test_radio_rx_stage(pReader);
+   _test_concurrent_adds(pReader);
+
+   latency_trace_close();
+   latency_trace_add(LATENCY_TRACE_STAGE_CAPTURE, 100);
+   _check(! latency_trace_is_enabled(), "enabled after close");
+   latency_trace_close_for_read(pReader);
+   shm_unlink(TEST_SM_NAME);
+
+   if ( s_iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
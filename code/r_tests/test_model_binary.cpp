@@ -0,0 +1,257 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+
+#include <sys/stat.h>
+
+// Checks the binary model file against the text model file: a model saved to both formats must load
+// to the same content from either (compared as text exports and bound checked fields); out of range values
+// are fixed the same way from either format; a reload after a change must copy just
+// the changed sections; a binary file that is corrupted or older than the text file must be ignored.
+// Model text files given on the command line (any text version: 10, 11, 12) are loaded as text,
+// saved in both formats and checked the same way.
+//
+// Usage: test_model_binary [model_file.mdl ...]
+
+#define TEST_FOLDER "/tmp/test_model_binary/"
+
+static int s_iFailures = 0;
+
+static void _check(bool bCondition, const char* szMessage)
+{
+   if ( bCondition )
+      return;
+   printf("Failed: %s\n", szMessage);
+   s_iFailures++;
+}
+
+static bool _files_are_equal(const char* szFile1, const char* szFile2)
+{
+   FILE* fd1 = fopen(szFile1, "rb");
+   FILE* fd2 = fopen(szFile2, "rb");
+   bool bEqual = (NULL != fd1) && (NULL != fd2);
+   while ( bEqual )
+   {
+      int c1 = fgetc(fd1);
+      int c2 = fgetc(fd2);
+      if ( c1 != c2 )
+         bEqual = false;
+      if ( EOF == c1 )
+         break;
+   }
+   if ( NULL != fd1 )
+      fclose(fd1);
+   if ( NULL != fd2 )
+      fclose(fd2);
+   return bEqual;
+}
+
+// Both models must export the same text file
+static bool _models_are_equal(Model* pModel1, Model* pModel2)
+{
+   pModel1->saveToTextFile(TEST_FOLDER "export1.mdl", false);
+   pModel2->saveToTextFile(TEST_FOLDER "export2.mdl", false);
+   return _files_are_equal(TEST_FOLDER "export1.mdl", TEST_FOLDER "export2.mdl");
+}
+
+// Fields bound checked after loading a model file, compared directly (not all are in the text export)
+static bool _sanitized_fields_are_equal(Model* pModel1, Model* pModel2)
+{
+   if ( pModel1->telemetry_params.vehicle_mavlink_id != pModel2->telemetry_params.vehicle_mavlink_id )
+      return false;
+   if ( pModel1->telemetry_params.controller_mavlink_id != pModel2->telemetry_params.controller_mavlink_id )
+      return false;
+   if ( pModel1->telemetry_params.flags != pModel2->telemetry_params.flags )
+      return false;
+   if ( pModel1->telemetry_params.iUpdateRateHz != pModel2->telemetry_params.iUpdateRateHz )
+      return false;
+   if ( pModel1->rxtx_sync_type != pModel2->rxtx_sync_type )
+      return false;
+   if ( pModel1->video_params.iH264Slices != pModel2->video_params.iH264Slices )
+      return false;
+   if ( pModel1->video_params.uMaxAutoKeyframeIntervalMs != pModel2->video_params.uMaxAutoKeyframeIntervalMs )
+      return false;
+   if ( pModel1->osd_params.iCurrentOSDScreen != pModel2->osd_params.iCurrentOSDScreen )
+      return false;
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+   {
+      if ( pModel1->radioInterfacesParams.interface_raw_power[i] != pModel2->radioInterfacesParams.interface_raw_power[i] )
+         return false;
+   }
+   return true;
+}
+
+// Saves the model in both formats, loads it back from each one and compares
+static void _test_round_trip(Model* pModel, const char* szName)
+{
+   char szMessage[256];
+   const char* szFile = TEST_FOLDER "model.mdl";
+   pModel->saveToFile(szFile, false);
+
+   Model* pFromText = new Model();
+   Model* pFromBinary = new Model();
+   snprintf(szMessage, sizeof(szMessage), "%s: load from text file", szName);
+   _check(pFromText->loadFromTextFile(szFile), szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: load from binary file", szName);
+   _check(pFromBinary->loadFromBinaryFile(szFile, true, false), szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: binary file loaded all sections", szName);
+   _check(pFromBinary->getLastLoadedBinarySectionsMask() == (((u32)1) << MODEL_BIN_SECTIONS_COUNT) - 1, szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: text and binary loads are the same", szName);
+   _check(_models_are_equal(pFromText, pFromBinary), szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: text and binary loads have the same validated fields", szName);
+   _check(_sanitized_fields_are_equal(pFromText, pFromBinary), szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: binary load is the same as the saved model", szName);
+   _check(_models_are_equal(pModel, pFromBinary), szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: same save count", szName);
+   _check(pFromText->getSaveCount() == pFromBinary->getSaveCount(), szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: same file version", szName);
+   _check(pFromText->getLoadedFileVersion() == pFromBinary->getLoadedFileVersion(), szMessage);
+   delete pFromText;
+   delete pFromBinary;
+}
+
+static void _test_incremental_reload(Model* pModel)
+{
+   const char* szFile = TEST_FOLDER "model.mdl";
+   pModel->saveToFile(szFile, false);
+
+   Model* pReader = new Model();
+   _check(pReader->loadFromBinaryFile(szFile, true, false), "reader: load from binary file");
+
+   // No change
+   _check(pReader->reloadFromFileIfChanged(szFile, true), "reader: reload, no change");
+   _check(0 == pReader->getLastLoadedBinarySectionsMask(), "reader: no section reloaded when nothing changed");
+
+   // OSD change only
+   pModel->osd_params.osd_flags[0] ^= 0x01;
+   pModel->saveToFile(szFile, false);
+   _check(pReader->reloadFromFileIfChanged(szFile, true), "reader: reload after OSD change");
+   _check(pReader->getLastLoadedBinarySectionsMask() == (((u32)1) << MODEL_BIN_SECTION_OSD), "reader: only the OSD section reloaded");
+   _check(_models_are_equal(pModel, pReader), "reader: same content after OSD change");
+
+   // Radio and stats changes; stats are not loaded when not requested
+   pModel->radioLinksParams.link_frequency_khz[0] += 5000;
+   pModel->m_Stats.uTotalFlights++;
+   pModel->saveToFile(szFile, false);
+   u32 uFlights = pReader->m_Stats.uTotalFlights;
+   _check(pReader->reloadFromFileIfChanged(szFile, false), "reader: reload after radio change");
+   _check(pReader->getLastLoadedBinarySectionsMask() == (((u32)1) << MODEL_BIN_SECTION_RADIO), "reader: only the radio section reloaded");
+   _check(pReader->m_Stats.uTotalFlights == uFlights, "reader: stats not reloaded");
+   _check(pReader->reloadFromFileIfChanged(szFile, true), "reader: reload with stats");
+   _check(0 == pReader->getLastLoadedBinarySectionsMask(), "reader: no reload for the same save count");
+   _check(pReader->loadFromBinaryFile(szFile, true, false), "reader: full load with stats");
+   _check(_models_are_equal(pModel, pReader), "reader: same content after radio and stats change");
+
+   // Text file changed without the binary file: the binary file must not be used
+   pModel->osd_params.osd_flags[0] ^= 0x01;
+   pModel->saveToTextFile(szFile, false);
+   _check(! pReader->loadFromBinaryFile(szFile, true, false), "reader: binary file older than the text file is ignored");
+   _check(pReader->loadFromFile(szFile, true), "reader: load falls back to the text file");
+   _check(_models_are_equal(pModel, pReader), "reader: same content from the text file");
+
+   // Corrupted binary file: ignored, model content unchanged
+   pModel->saveToFile(szFile, false);
+   char szBinFile[256];
+   strcpy(szBinFile, szFile);
+   strcpy(szBinFile + strlen(szBinFile) - 3, "mdb");
+   struct stat statBin;
+   _check(0 == stat(szBinFile, &statBin), "binary file saved");
+   FILE* fd = fopen(szBinFile, "r+b");
+   if ( NULL != fd )
+   {
+      fseek(fd, (long)statBin.st_size - 16, SEEK_SET);
+      int c = fgetc(fd);
+      fseek(fd, (long)statBin.st_size - 16, SEEK_SET);
+      fputc(c ^ 0x5A, fd);
+      fclose(fd);
+   }
+   // Keep the text file time and size as saved with the binary file
+   _check(! pReader->loadFromBinaryFile(szFile, true, false), "reader: corrupted binary file is ignored");
+   delete pReader;
+}
+
+// Out of range values saved in the files must be fixed the same way when loading from either format
+static void _test_invalid_values()
+{
+   const char* szFile = TEST_FOLDER "model.mdl";
+   Model* pModel = new Model();
+   pModel->resetToDefaults(true);
+   pModel->telemetry_params.vehicle_mavlink_id = 0;
+   pModel->telemetry_params.controller_mavlink_id = 1000;
+   pModel->telemetry_params.flags = 0;
+   pModel->telemetry_params.iUpdateRateHz = 500;
+   pModel->rxtx_sync_type = RXTX_SYNC_TYPE_LAST + 3;
+   pModel->video_params.iH264Slices = 100;
+   pModel->video_params.uMaxAutoKeyframeIntervalMs = 1;
+   pModel->osd_params.iCurrentOSDScreen = -2;
+   pModel->radioInterfacesParams.interface_raw_power[0] = 500;
+   pModel->saveToFile(szFile, false);
+
+   Model* pFromText = new Model();
+   Model* pFromBinary = new Model();
+   _check(pFromText->loadFromTextFile(szFile), "invalid values: load from text file");
+   _check(pFromBinary->loadFromBinaryFile(szFile, true, false), "invalid values: load from binary file");
+   _check(pFromBinary->telemetry_params.vehicle_mavlink_id == DEFAULT_MAVLINK_SYS_ID_VEHICLE, "invalid values: vehicle mavlink id fixed");
+   _check(pFromBinary->telemetry_params.controller_mavlink_id == DEFAULT_MAVLINK_SYS_ID_CONTROLLER, "invalid values: controller mavlink id fixed");
+   _check(0 != pFromBinary->telemetry_params.flags, "invalid values: telemetry flags fixed");
+   _check(pFromBinary->rxtx_sync_type == RXTX_SYNC_TYPE_BASIC, "invalid values: rxtx sync type fixed");
+   _check((pFromBinary->video_params.iH264Slices >= 1) && (pFromBinary->video_params.iH264Slices <= 16), "invalid values: h264 slices fixed");
+   _check(pFromBinary->osd_params.iCurrentOSDScreen >= 0, "invalid values: osd screen fixed");
+   _check(_sanitized_fields_are_equal(pFromText, pFromBinary), "invalid values: text and binary loads have the same validated fields");
+   _check(_models_are_equal(pFromText, pFromBinary), "invalid values: text and binary loads are the same");
+
+   // Sections changed by the validation are copied again on the next reload
+   pModel->uDeveloperFlags ^= 0x01;
+   pModel->saveToFile(szFile, false);
+   _check(pFromBinary->reloadFromFileIfChanged(szFile, true), "invalid values: reload");
+   _check(pFromBinary->getLastLoadedBinarySectionsMask() & (((u32)1) << MODEL_BIN_SECTION_TELEMETRY), "invalid values: validated section reloaded");
+   _check(pFromBinary->telemetry_params.vehicle_mavlink_id == DEFAULT_MAVLINK_SYS_ID_VEHICLE, "invalid values: vehicle mavlink id fixed after reload");
+   delete pFromText;
+   delete pFromBinary;
+   delete pModel;
+}
+
+int main(int argc, char *argv[])
+{
+   printf("\nTesting binary model files...\n");
+   log_disable();
+   if ( system("mkdir -p " TEST_FOLDER) ) {}
+
+   Model* pModel = new Model();
+   pModel->resetToDefaults(true);
+   strcpy(pModel->vehicle_name, "TestBin");
+   pModel->osd_params.osd_flags[0] = 0x1234;
+   pModel->radioLinksParams.link_frequency_khz[0] = 5745000;
+   pModel->m_Stats.uTotalFlights = 7;
+   pModel->video_params.iVideoFPS = 60;
+   _test_round_trip(pModel, "defaults");
+   _test_incremental_reload(pModel);
+   delete pModel;
+   _test_invalid_values();
+
+   for( int i=1; i<argc; i++ )
+   {
+      Model* pModelFile = new Model();
+      if ( ! pModelFile->loadFromTextFile(argv[i]) )
+      {
+         printf("Failed to load text model file %s\n", argv[i]);
+         s_iFailures++;
+      }
+      else
+      {
+         printf("Model file %s, text version %d\n", argv[i], pModelFile->getLoadedFileVersion());
+         _test_round_trip(pModelFile, argv[i]);
+      }
+      delete pModelFile;
+   }
+
+   if ( system("rm -rf " TEST_FOLDER) ) {}
+
+   if ( s_iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,310 @@
+#include "../base/base.h"
+#include "../base/packet_pool.h"
+#include "../radio/radio_rx_queue.h"
+#include "../radio/radiopacketsqueue.h"
+
+#include <pthread.h>
+
+// Tests the packet buffers pool: reference counting, headroom and alignment, hand off detection
+// (only whole pool buffers can be passed by reference), the packets queues holding pool buffers
+// (queued by reference or copied, popped packets modified in place), and a producer thread
+// allocating packets pushed on a radio rx queue while the consumer thread releases them,
+// keeping some of them referenced for a while (as the video rx buffers do).
+//
+// Usage: test_packet_pool [-packets N]
+
+static int _test_ref_counting()
+{
+   int iOk = 1;
+   type_packet_pool_stats stats;
+   packet_pool_get_stats(&stats);
+   u32 uInUseStart = stats.uBuffersInUse;
+
+   u8* pBuffer = packet_pool_alloc();
+   if ( (NULL == pBuffer) || (1 != packet_pool_get_ref_count(pBuffer)) || (0 != packet_pool_get_length(pBuffer)) )
+      iOk = 0;
+   if ( 0 != (((unsigned long)pBuffer) % PACKET_POOL_CACHE_LINE) )
+      iOk = 0;
+   if ( packet_pool_get_headroom(pBuffer) != pBuffer - PACKET_POOL_HEADROOM )
+      iOk = 0;
+   // Headroom and the whole data area are writable
+   memset(packet_pool_get_headroom(pBuffer), 0xA5, PACKET_POOL_HEADROOM + PACKET_POOL_DATA_SIZE);
+   packet_pool_set_length(pBuffer, 100);
+   if ( 100 != packet_pool_get_length(pBuffer) )
+      iOk = 0;
+   packet_pool_ref(pBuffer);
+   packet_pool_ref(pBuffer);
+   if ( 3 != packet_pool_get_ref_count(pBuffer) )
+      iOk = 0;
+   packet_pool_unref(pBuffer);
+   packet_pool_unref(pBuffer);
+   packet_pool_get_stats(&stats);
+   if ( stats.uBuffersInUse != uInUseStart + 1 )
+      iOk = 0;
+   packet_pool_unref(pBuffer);
+   packet_pool_get_stats(&stats);
+   if ( stats.uBuffersInUse != uInUseStart )
+      iOk = 0;
+
+   // Freed buffers are reused, the pool grows past a slab
+   u8* pBuffers[PACKET_POOL_SLAB_BUFFERS + 10];
+   for( int i=0; i<PACKET_POOL_SLAB_BUFFERS + 10; i++ )
+   {
+      pBuffers[i] = packet_pool_alloc();
+      if ( NULL == pBuffers[i] )
+         iOk = 0;
+      else
+         memset(pBuffers[i], i, PACKET_POOL_DATA_SIZE);
+   }
+   for( int i=0; i<PACKET_POOL_SLAB_BUFFERS + 10; i++ )
+   {
+      if ( (NULL != pBuffers[i]) && ((pBuffers[i][0] != (u8)i) || (pBuffers[i][PACKET_POOL_DATA_SIZE-1] != (u8)i)) )
+         iOk = 0;
+      packet_pool_unref(pBuffers[i]);
+   }
+   packet_pool_get_stats(&stats);
+   if ( (stats.uBuffersInUse != uInUseStart) || (stats.uSlabs < 2) )
+      iOk = 0;
+   printf("Reference counting, headroom, alignment: %s\n", iOk?"ok":"FAILED");
+   return iOk;
+}
+
+static int _test_handoff()
+{
+   int iOk = 1;
+   u8 uPacket[200];
+   for( int i=0; i<(int)sizeof(uPacket); i++ )
+      uPacket[i] = (u8)(i*3);
+
+   packet_pool_set_handoff_enabled(1);
+   u8* pBuffer = packet_pool_alloc_copy(uPacket, sizeof(uPacket));
+   if ( (NULL == pBuffer) || (0 != memcmp(pBuffer, uPacket, sizeof(uPacket))) || ((int)sizeof(uPacket) != packet_pool_get_length(pBuffer)) )
+      iOk = 0;
+   if ( packet_pool_get_handoff_buffer(pBuffer, sizeof(uPacket)) != pBuffer )
+      iOk = 0;
+   // Part of a pool buffer, not a pool buffer, or hand off disabled: must be copied
+   if ( NULL != packet_pool_get_handoff_buffer(pBuffer, sizeof(uPacket)-1) )
+      iOk = 0;
+   if ( NULL != packet_pool_get_handoff_buffer(pBuffer+10, sizeof(uPacket)-10) )
+      iOk = 0;
+   if ( NULL != packet_pool_get_handoff_buffer(uPacket, sizeof(uPacket)) )
+      iOk = 0;
+   packet_pool_set_handoff_enabled(0);
+   if ( NULL != packet_pool_get_handoff_buffer(pBuffer, sizeof(uPacket)) )
+      iOk = 0;
+   packet_pool_set_handoff_enabled(1);
+   packet_pool_unref(pBuffer);
+   // Freed buffers can't be handed off
+   if ( NULL != packet_pool_get_handoff_buffer(pBuffer, sizeof(uPacket)) )
+      iOk = 0;
+   printf("Hand off detection: %s\n", iOk?"ok":"FAILED");
+   return iOk;
+}
+
+static int _test_packets_queue()
+{
+   int iOk = 1;
+   type_packet_pool_stats stats;
+   packet_pool_get_stats(&stats);
+   u32 uInUseStart = stats.uBuffersInUse;
+
+   t_packet_queue* pQueue = (t_packet_queue*)malloc(sizeof(t_packet_queue));
+   memset(pQueue, 0, sizeof(t_packet_queue));
+   packets_queue_init(pQueue);
+
+   u8 uPacket[300];
+   memset(uPacket, 0x11, sizeof(uPacket));
+   u8* pBuffer = packet_pool_alloc_copy(uPacket, sizeof(uPacket));
+   pBuffer[0] = 0x22;
+
+   // Pool buffer: queued by reference; other packets: copied
+   packets_queue_add_packet2(pQueue, pBuffer, sizeof(uPacket), 0, 0);
+   if ( 2 != packet_pool_get_ref_count(pBuffer) )
+      iOk = 0;
+   packets_queue_add_packet2(pQueue, uPacket, sizeof(uPacket), 0, 0);
+   int iLength = 0;
+   if ( packets_queue_peek_packet(pQueue, 0, &iLength) != pBuffer )
+      iOk = 0;
+
+   // Popped packets can be changed in place: a packet still referenced by someone else is copied
+   u8* pPopped = packets_queue_pop_packet(pQueue, &iLength);
+   if ( (NULL == pPopped) || (pPopped == pBuffer) || (iLength != (int)sizeof(uPacket)) || (0 != memcmp(pPopped, pBuffer, sizeof(uPacket))) )
+      iOk = 0;
+   if ( NULL != pPopped )
+      pPopped[0] = 0x33;
+   if ( (pBuffer[0] != 0x22) || (1 != packet_pool_get_ref_count(pBuffer)) )
+      iOk = 0;
+
+   // Not referenced by anyone else: popped without a copy
+   packets_queue_add_packet2(pQueue, pBuffer, sizeof(uPacket), 0, 0);
+   packet_pool_unref(pBuffer);
+   pPopped = packets_queue_pop_packet(pQueue, &iLength);
+   if ( (NULL == pPopped) || (0 != memcmp(pPopped, uPacket, sizeof(uPacket))) )
+      iOk = 0;
+   pPopped = packets_queue_pop_packet(pQueue, &iLength);
+   if ( (pPopped != pBuffer) || (pPopped[0] != 0x22) )
+      iOk = 0;
+   if ( NULL != packets_queue_pop_packet(pQueue, &iLength) )
+      iOk = 0;
+
+   // Init releases everything, including the queued and popped packets
+   for( int i=0; i<MAX_PACKETS_IN_QUEUE + 5; i++ )
+      packets_queue_add_packet2(pQueue, uPacket, sizeof(uPacket), 0, 0);
+   packets_queue_pop_packet(pQueue, &iLength);
+   packets_queue_init(pQueue);
+   packet_pool_get_stats(&stats);
+   if ( stats.uBuffersInUse != uInUseStart )
+      iOk = 0;
+   free(pQueue);
+   printf("Packets queues: %s\n", iOk?"ok":"FAILED");
+   return iOk;
+}
+
+typedef struct
+{
+   type_radio_rx_queue* pQueue;
+   u32 uPacketsToPush;
+   u32 uDropped;
+} type_test_producer;
+
+static void* _thread_producer(void* pArg)
+{
+   type_test_producer* pProducer = (type_test_producer*)pArg;
+   for( u32 u=0; u<pProducer->uPacketsToPush; u++ )
+   {
+      u8* pBuffer = packet_pool_alloc();
+      if ( NULL == pBuffer )
+      {
+         pProducer->uDropped++;
+         continue;
+      }
+      int iLength = 20 + (int)((u * 37) % 1000);
+      memcpy(pBuffer, &u, sizeof(u32));
+      for( int i=4; i<iLength; i++ )
+         pBuffer[i] = (u8)(u + i);
+      packet_pool_set_length(pBuffer, iLength);
+      if ( ! radio_rx_queue_push_buffer(pProducer->pQueue, pBuffer, iLength, 0, 0) )
+         pProducer->uDropped++;
+      if ( 0 == (u % 64) )
+         hardware_sleep_micros(50);
+   }
+   packet_pool_flush_thread_cache();
+   return NULL;
+}
+
+#define TEST_KEPT_PACKETS 48
+
+static int _check_packet(u8* pPacket, int iLength, u32* puSequence)
+{
+   u32 uSequence = 0;
+   memcpy(&uSequence, pPacket, sizeof(u32));
+   if ( iLength != 20 + (int)((uSequence * 37) % 1000) )
+      return 0;
+   for( int i=4; i<iLength; i++ )
+      if ( pPacket[i] != (u8)(uSequence + i) )
+         return 0;
+   if ( NULL != puSequence )
+      *puSequence = uSequence;
+   return 1;
+}
+
+static int _test_threads(u32 uPackets)
+{
+   int iOk = 1;
+   type_packet_pool_stats stats;
+   packet_pool_get_stats(&stats);
+   u32 uInUseStart = stats.uBuffersInUse;
+
+   type_radio_rx_queue queue;
+   radio_rx_queue_init(&queue, 256, NULL);
+   type_test_producer producer;
+   producer.pQueue = &queue;
+   producer.uPacketsToPush = uPackets;
+   producer.uDropped = 0;
+   pthread_t thread;
+   pthread_create(&thread, NULL, _thread_producer, &producer);
+
+   // Consumer keeps a reference to some of the packets, released later
+   u8* pKept[TEST_KEPT_PACKETS];
+   int iKeptLength[TEST_KEPT_PACKETS];
+   memset(pKept, 0, sizeof(pKept));
+   u32 uReceived = 0;
+   u32 uLastSequence = 0;
+   int iKeep = 0;
+   while ( uReceived + producer.uDropped < uPackets )
+   {
+      int iLength = 0;
+      u8* pPacket = radio_rx_queue_borrow(&queue, 1000, &iLength, NULL);
+      if ( NULL == pPacket )
+         continue;
+      u32 uSequence = 0;
+      if ( (! _check_packet(pPacket, iLength, &uSequence)) || ((uReceived > 0) && (uSequence <= uLastSequence)) )
+         iOk = 0;
+      uLastSequence = uSequence;
+      uReceived++;
+      if ( 0 == (uSequence % 3) )
+      {
+         if ( NULL != packet_pool_get_handoff_buffer(pPacket, iLength) )
+         {
+            packet_pool_unref(pKept[iKeep]);
+            packet_pool_ref(pPacket);
+            pKept[iKeep] = pPacket;
+            iKeptLength[iKeep] = iLength;
+            iKeep = (iKeep + 1) % TEST_KEPT_PACKETS;
+         }
+         else
+            iOk = 0;
+      }
+      radio_rx_queue_release(&queue);
+   }
+   pthread_join(thread, NULL);
+
+   // Kept packets were not reused by the producer
+   for( int i=0; i<TEST_KEPT_PACKETS; i++ )
+   {
+      if ( NULL == pKept[i] )
+         continue;
+      if ( ! _check_packet(pKept[i], iKeptLength[i], NULL) )
+         iOk = 0;
+      packet_pool_unref(pKept[i]);
+   }
+   radio_rx_queue_free(&queue);
+   packet_pool_flush_thread_cache();
+
+   packet_pool_get_stats(&stats);
+   if ( stats.uBuffersInUse != uInUseStart )
+      iOk = 0;
+   printf("Producer/consumer threads, %u packets (%u received, %u dropped), pool: %u buffers: %s\n", uPackets, uReceived, producer.uDropped, stats.uBuffersTotal, iOk?"ok":"FAILED");
+   return iOk;
+}
+
+int main(int argc, char *argv[])
+{
+   u32 uPackets = 500000;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-packets")) && (i < argc-1) )
+         uPackets = (u32)atoi(argv[++i]);
+   }
+
+   printf("\nTesting the packet buffers pool...\n");
+   log_disable();
+
+   int iFailures = 0;
+   if ( ! _test_ref_counting() )
+      iFailures++;
+   if ( ! _test_handoff() )
+      iFailures++;
+   if ( ! _test_packets_queue() )
+      iFailures++;
+   if ( ! _test_threads(uPackets) )
+      iFailures++;
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d checks failed.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
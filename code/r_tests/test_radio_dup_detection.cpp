@@ -0,0 +1,216 @@
+#include "../base/base.h"
+#include "../base/hardware_radio.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/radio_duplicate_det.h"
+
+#include <vector>
+#include <set>
+#include <algorithm>
+
+// Property test of the radio rx duplicate detection: streams of packets from several vehicles, with
+// random reordering and duplicates (as received on several radio interfaces), starting at random stream
+// packet indexes (some wrap around the stream index range). The first copy of each packet must be
+// accepted and all the other copies rejected. Also checks the hash collisions of the previous
+// implementation (index N+512 received before a late copy of N) and the stream restart detection.
+//
+// Usage: test_radio_dup_detection [-seed N] [-rounds N]
+
+extern u32 s_uRadioRxTimeNow;
+
+static u32 s_uRandomState = 1;
+
+static u32 _test_random()
+{
+   s_uRandomState ^= s_uRandomState << 13;
+   s_uRandomState ^= s_uRandomState >> 17;
+   s_uRandomState ^= s_uRandomState << 5;
+   return s_uRandomState;
+}
+
+typedef struct
+{
+   u32 uVehicleId;
+   u32 uStreamId;
+   u32 uStreamPacketIndex;
+} type_test_packet;
+
+static int _check_packet(type_test_packet* pPacket)
+{
+   t_packet_header PH;
+   radio_packet_init(&PH, PACKET_COMPONENT_VIDEO, PACKET_TYPE_VIDEO_DATA, pPacket->uStreamId);
+   PH.vehicle_id_src = pPacket->uVehicleId;
+   PH.stream_packet_idx |= pPacket->uStreamPacketIndex & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+   PH.total_length = sizeof(t_packet_header);
+   return radio_dup_detection_is_duplicate_on_stream(0, (u8*)&PH, sizeof(t_packet_header), s_uRadioRxTimeNow);
+}
+
+// One stream: iCount packets from uStartIndex, each one displaced by up to iMaxDisplacement positions,
+// extra copies (up to 3) delayed by up to iMaxDisplacement positions
+static void _build_stream(std::vector<type_test_packet>& packets, u32 uVehicleId, u32 uStreamId, u32 uStartIndex, int iCount, int iMaxDisplacement, int iDuplicatePercent)
+{
+   std::vector<std::pair<u64, type_test_packet> > keyed;
+   for( int i=0; i<iCount; i++ )
+   {
+      type_test_packet packet;
+      packet.uVehicleId = uVehicleId;
+      packet.uStreamId = uStreamId;
+      packet.uStreamPacketIndex = (uStartIndex + (u32)i) & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+      u64 uPosition = (u64)i * 1000 + (_test_random() % (u32)(iMaxDisplacement/2 + 1)) * 1000 + (_test_random() % 1000);
+      keyed.push_back(std::make_pair(uPosition, packet));
+      int iCopies = 0;
+      while ( (iCopies < 3) && ((int)(_test_random() % 100) < iDuplicatePercent) )
+      {
+         iCopies++;
+         u64 uCopyPosition = uPosition + (_test_random() % (u32)(iMaxDisplacement/2 + 1)) * 1000 + (_test_random() % 1000);
+         keyed.push_back(std::make_pair(uCopyPosition, packet));
+      }
+   }
+   std::stable_sort(keyed.begin(), keyed.end(),
+      [](const std::pair<u64, type_test_packet>& a, const std::pair<u64, type_test_packet>& b) { return a.first < b.first; });
+   for( size_t i=0; i<keyed.size(); i++ )
+      packets.push_back(keyed[i].second);
+}
+
+static int _test_random_streams(int iRounds)
+{
+   int iFailures = 0;
+   u32 uTotalPackets = 0;
+   u32 uTotalDuplicates = 0;
+   for( int iRound=0; iRound<iRounds; iRound++ )
+   {
+      radio_duplicate_detection_init();
+      int iVehicles = 1 + (int)(_test_random() % MAX_CONCURENT_VEHICLES);
+      std::vector< std::vector<type_test_packet> > streams;
+      for( int v=0; v<iVehicles; v++ )
+      for( u32 uStream=0; uStream<MAX_RADIO_STREAMS; uStream++ )
+      {
+         u32 uStartIndex = _test_random() & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+         // Some streams wrap around the max stream packet index
+         if ( 0 == (_test_random() % 3) )
+            uStartIndex = PACKET_FLAGS_MASK_STREAM_PACKET_IDX - (_test_random() % 3000);
+         // Data streams are reset (restart detection) by packets more than 50 packets back
+         bool bVideoOrAudio = (uStream == STREAM_ID_AUDIO) || (uStream >= STREAM_ID_VIDEO_1);
+         int iMaxDisplacement = bVideoOrAudio?(int)(200 + _test_random() % 1500):(int)(_test_random() % 40);
+         std::vector<type_test_packet> packets;
+         _build_stream(packets, 1000 + v, uStream, uStartIndex, 3000 + (int)(_test_random() % 3000), iMaxDisplacement, 20 + (int)(_test_random() % 60));
+         streams.push_back(packets);
+      }
+
+      // Interleave the streams randomly, keeping the order inside each stream
+      std::vector<size_t> positions(streams.size(), 0);
+      std::set< std::pair<u64, u32> > seen;
+      int iRoundFailures = 0;
+      size_t uRemaining = 0;
+      for( size_t i=0; i<streams.size(); i++ )
+         uRemaining += streams[i].size();
+      while ( uRemaining > 0 )
+      {
+         size_t uStream = _test_random() % streams.size();
+         if ( positions[uStream] >= streams[uStream].size() )
+            continue;
+         type_test_packet* pPacket = &streams[uStream][positions[uStream]];
+         positions[uStream]++;
+         uRemaining--;
+         s_uRadioRxTimeNow++;
+
+         std::pair<u64, u32> key(((u64)pPacket->uVehicleId << 8) | pPacket->uStreamId, pPacket->uStreamPacketIndex);
+         int bExpectedDuplicate = (seen.find(key) != seen.end())?1:0;
+         seen.insert(key);
+         int bDuplicate = _check_packet(pPacket);
+         uTotalPackets++;
+         if ( bDuplicate )
+            uTotalDuplicates++;
+         if ( bDuplicate != bExpectedDuplicate )
+         {
+            if ( iRoundFailures < 5 )
+               printf("  round %d: VID %u stream %u packet %u: %s, expected %s\n", iRound, pPacket->uVehicleId, pPacket->uStreamId, pPacket->uStreamPacketIndex,
+                  bDuplicate?"duplicate":"new", bExpectedDuplicate?"duplicate":"new");
+            iRoundFailures++;
+         }
+      }
+      if ( iRoundFailures > 0 )
+         iFailures++;
+   }
+   printf("Random reorder/duplicates, %d rounds: %u packets, %u duplicates: %s\n", iRounds, uTotalPackets, uTotalDuplicates, (0 == iFailures)?"ok":"FAILED");
+   return (0 == iFailures)?1:0;
+}
+
+static int _test_hash_collision_and_restart()
+{
+   radio_duplicate_detection_init();
+   int iOk = 1;
+   type_test_packet packet;
+   packet.uVehicleId = 77;
+   packet.uStreamId = STREAM_ID_VIDEO_1;
+
+   // 0..600 received, then a late copy of 10 (same slot as 522 in a 512 entries hash)
+   for( u32 u=0; u<=600; u++ )
+   {
+      packet.uStreamPacketIndex = u;
+      if ( _check_packet(&packet) )
+         iOk = 0;
+   }
+   packet.uStreamPacketIndex = 10;
+   if ( ! _check_packet(&packet) )
+   {
+      printf("  Late copy of packet 10 after packet 522 was not detected.\n");
+      iOk = 0;
+   }
+   if ( radio_dup_detection_get_max_received_packet_index_for_stream(77, STREAM_ID_VIDEO_1) != 600 )
+      iOk = 0;
+
+   // Vehicle restarted: stream indexes start again from 0
+   for( u32 u=601; u<=5000; u++ )
+   {
+      packet.uStreamPacketIndex = u;
+      _check_packet(&packet);
+   }
+   packet.uStreamPacketIndex = 0;
+   if ( _check_packet(&packet) || (! radio_dup_detection_is_vehicle_restarted(77)) )
+   {
+      printf("  Stream restart not detected.\n");
+      iOk = 0;
+   }
+   packet.uStreamPacketIndex = 1;
+   if ( _check_packet(&packet) )
+      iOk = 0;
+   packet.uStreamPacketIndex = 0;
+   if ( ! _check_packet(&packet) )
+      iOk = 0;
+   printf("Late copies past the old hash size, stream restart: %s\n", iOk?"ok":"FAILED");
+   return iOk;
+}
+
+int main(int argc, char *argv[])
+{
+   int iRounds = 20;
+   s_uRandomState = 12345;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-seed")) && (i < argc-1) )
+         s_uRandomState = (u32)atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-rounds")) && (i < argc-1) )
+         iRounds = atoi(argv[++i]);
+   }
+   if ( 0 == s_uRandomState )
+      s_uRandomState = 1;
+
+   printf("\nTesting the radio duplicate detection...\n");
+   log_disable();
+   hardware_radio_set_simulated_interfaces(1);
+   s_uRadioRxTimeNow = 100000;
+
+   int iFailures = 0;
+   if ( ! _test_hash_collision_and_restart() )
+      iFailures++;
+   if ( ! _test_random_streams(iRounds) )
+      iFailures++;
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d checks failed.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,349 @@
+#include "../base/base.h"
+#include "../base/hardware.h"
+#include "../base/hardware_radio.h"
+#include "../radio/radiolink.h"
+#include "../radio/radio_link_sim.h"
+#include "../radio/radiopackets2.h"
+
+#include <poll.h>
+#include <vector>
+
+// Checks the radio link simulator without Wi-Fi hardware: frames written on a radio port are
+// read back on that port, with the configured loss, burst loss, delay, rate and reordering,
+// and a full Ruby packet goes through radiolink (build, write, read, radiotap parse, CRC check)
+// over two simulated interfaces.
+//
+// Usage: test_radio_link_sim [-frames N] [-port base_udp_port]
+
+#define TEST_FRAME_SIZE 1000
+#define TEST_RADIO_PORT 3
+
+static u64 _test_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000;
+}
+
+// Legacy radiotap tx header + IEEE data header (port in the first address byte) + index
+static int _build_frame(u8* pFrame, u32 uIndex)
+{
+   static const u8 s_uRadiotap[] = { 0x00, 0x00, 0x0c, 0x00, 0x04, 0x80, 0x00, 0x00, 0x30, 0x08, 0x00, 0x00 };
+   memset(pFrame, 0, TEST_FRAME_SIZE);
+   memcpy(pFrame, s_uRadiotap, sizeof(s_uRadiotap));
+   u8* pIEEE = pFrame + sizeof(s_uRadiotap);
+   pIEEE[0] = 0x08;
+   pIEEE[1] = 0x01;
+   pIEEE[4] = (TEST_RADIO_PORT << 4) | 0x0F;
+   memcpy(pIEEE + 24, &uIndex, sizeof(u32));
+   return TEST_FRAME_SIZE;
+}
+
+// Reads frames until none arrives for uIdleMicros. Returns the indexes, in arrival order.
+static void _read_frames(type_radio_link_sim_rx* pRx, std::vector<u32>& indexes, std::vector<u64>* pTimes, u32 uIdleMicros, int* piBadFrames)
+{
+   // uIdleMicros 0: only reads the frames already available
+   u64 uLastFrameTime = _test_time_micros();
+   do
+   {
+      struct pollfd pfd;
+      pfd.fd = pRx->iSocket;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if ( poll(&pfd, 1, (0 == uIdleMicros)?0:5) <= 0 )
+         continue;
+      int iLength = 0;
+      u8* pFrame = NULL;
+      while ( NULL != (pFrame = radio_link_sim_rx_next_frame(pRx, &iLength)) )
+      {
+         uLastFrameTime = _test_time_micros();
+         int iRadiotapLength = pFrame[2] | (((int)pFrame[3]) << 8);
+         // rx header: flags, rate, signal, noise, antenna; the tx rate is kept
+         if ( (iRadiotapLength != 13) || (pFrame[9] != 0x30) || ((int8_t)pFrame[10] != -42) || (iLength != TEST_FRAME_SIZE - 12 + iRadiotapLength) )
+            (*piBadFrames)++;
+         u32 uIndex = 0;
+         memcpy(&uIndex, pFrame + iRadiotapLength + 24, sizeof(u32));
+         indexes.push_back(uIndex);
+         if ( NULL != pTimes )
+            pTimes->push_back(uLastFrameTime);
+      }
+   }
+   while ( _test_time_micros() - uLastFrameTime < uIdleMicros );
+}
+
+static int _run_link(u16 uBasePort, const char* szParams, int iFrames, u32 uSendGapMicros, std::vector<u32>& indexes, std::vector<u64>& times, u64* puTimeStart, type_radio_link_sim_stats* pStats)
+{
+   type_radio_link_sim_params params;
+   radio_link_sim_set_default_params(&params);
+   params.iSignalDBM = -42;
+   params.uSeed = 1234;
+   if ( ! radio_link_sim_parse_params(szParams, &params) )
+   {
+      printf("Failed to parse link params [%s]\n", szParams);
+      return 0;
+   }
+
+   type_radio_link_sim_rx rx;
+   type_radio_link_sim_tx tx;
+   if ( radio_link_sim_rx_open(&rx, uBasePort, TEST_RADIO_PORT, params.iSignalDBM, params.iNoiseDBM) < 0 )
+      return 0;
+   if ( radio_link_sim_tx_open(&tx, uBasePort, &params) < 0 )
+   {
+      radio_link_sim_rx_close(&rx);
+      return 0;
+   }
+
+   int iBadFrames = 0;
+   u8 uFrame[TEST_FRAME_SIZE];
+   indexes.clear();
+   times.clear();
+   *puTimeStart = _test_time_micros();
+   for( int i=0; i<iFrames; i++ )
+   {
+      int iLength = _build_frame(uFrame, (u32)i);
+      radio_link_sim_tx_write(&tx, uFrame, iLength);
+      if ( 0 != uSendGapMicros )
+         hardware_sleep_micros(uSendGapMicros);
+      // Keep the socket buffer drained when there is no delivery thread
+      if ( (i % 16) == 15 )
+         _read_frames(&rx, indexes, &times, 0, &iBadFrames);
+   }
+   _read_frames(&rx, indexes, &times, 300000, &iBadFrames);
+   radio_link_sim_tx_get_stats(&tx, pStats);
+   radio_link_sim_tx_close(&tx);
+   radio_link_sim_rx_close(&rx);
+
+   if ( iBadFrames > 0 )
+   {
+      printf("  %d frames with a bad rx radiotap header or length\n", iBadFrames);
+      return 0;
+   }
+   return 1;
+}
+
+static int _test_perfect_link(u16 uBasePort, int iFrames)
+{
+   std::vector<u32> indexes;
+   std::vector<u64> times;
+   u64 uTimeStart = 0;
+   type_radio_link_sim_stats stats;
+   if ( ! _run_link(uBasePort, "", iFrames, 0, indexes, times, &uTimeStart, &stats) )
+      return 0;
+   int iOk = ((int)indexes.size() == iFrames)?1:0;
+   for( size_t i=0; iOk && (i<indexes.size()); i++ )
+      if ( indexes[i] != (u32)i )
+         iOk = 0;
+   printf("Perfect link: %d of %d frames received in order: %s\n", (int)indexes.size(), iFrames, iOk?"ok":"FAILED");
+   return iOk;
+}
+
+static int _test_random_loss(u16 uBasePort, int iFrames)
+{
+   std::vector<u32> indexes;
+   std::vector<u64> times;
+   u64 uTimeStart = 0;
+   type_radio_link_sim_stats stats;
+   if ( ! _run_link(uBasePort, "loss=10", iFrames, 0, indexes, times, &uTimeStart, &stats) )
+      return 0;
+   double fLoss = 100.0 * (double)(iFrames - (int)indexes.size()) / (double)iFrames;
+   int iOk = ((fLoss > 8.0) && (fLoss < 12.0) && ((int)stats.uFramesLostRandom == iFrames - (int)indexes.size()))?1:0;
+   printf("Random loss 10%%: %.2f%% lost (%u counted): %s\n", fLoss, stats.uFramesLostRandom, iOk?"ok":"FAILED");
+   return iOk;
+}
+
+static int _test_burst_loss(u16 uBasePort, int iFrames)
+{
+   std::vector<u32> indexes;
+   std::vector<u64> times;
+   u64 uTimeStart = 0;
+   type_radio_link_sim_stats stats;
+   // Bursts start on 1% of the frames and last 10 frames on average, all lost
+   if ( ! _run_link(uBasePort, "burst=1:10:100", iFrames, 0, indexes, times, &uTimeStart, &stats) )
+      return 0;
+
+   // Average length of the runs of lost frames
+   int iRuns = 0;
+   int iLost = 0;
+   u32 uExpected = 0;
+   for( size_t i=0; i<=indexes.size(); i++ )
+   {
+      u32 uIndex = (i < indexes.size())?indexes[i]:(u32)iFrames;
+      if ( uIndex > uExpected )
+      {
+         iRuns++;
+         iLost += (int)(uIndex - uExpected);
+      }
+      uExpected = uIndex+1;
+   }
+   double fAverageRun = (iRuns > 0)?((double)iLost/(double)iRuns):0.0;
+   int iOk = ((stats.uBursts > 0) && (fAverageRun > 5.0) && (fAverageRun < 20.0) && ((int)stats.uFramesLostBurst == iLost))?1:0;
+   printf("Burst loss: %u bursts, %d frames lost in %d runs, %.1f frames per run: %s\n", stats.uBursts, iLost, iRuns, fAverageRun, iOk?"ok":"FAILED");
+   return iOk;
+}
+
+static int _test_delay_and_rate(u16 uBasePort)
+{
+   std::vector<u32> indexes;
+   std::vector<u64> times;
+   u64 uTimeStart = 0;
+   type_radio_link_sim_stats stats;
+   // 100 frames of 1000 bytes at 2 Mbps: 4 ms each, 400 ms in total, plus 20 ms delay
+   int iFrames = 100;
+   if ( ! _run_link(uBasePort, "delay=20,rate=2000", iFrames, 0, indexes, times, &uTimeStart, &stats) )
+      return 0;
+   int iOk = ((int)indexes.size() == iFrames)?1:0;
+   u64 uFirst = (times.size() > 0)?(times[0] - uTimeStart):0;
+   u64 uLast = (times.size() > 0)?(times[times.size()-1] - uTimeStart):0;
+   if ( (uFirst < 24000) || (uFirst > 60000) )
+      iOk = 0;
+   if ( (uLast < 420000) || (uLast > 520000) )
+      iOk = 0;
+   for( size_t i=0; iOk && (i<indexes.size()); i++ )
+      if ( indexes[i] != (u32)i )
+         iOk = 0;
+   printf("Delay 20 ms, rate 2 Mbps: first frame after %.1f ms, last after %.1f ms (expected 24, 420): %s\n", (double)uFirst/1000.0, (double)uLast/1000.0, iOk?"ok":"FAILED");
+   return iOk;
+}
+
+static int _test_reorder_and_queue(u16 uBasePort)
+{
+   std::vector<u32> indexes;
+   std::vector<u64> times;
+   u64 uTimeStart = 0;
+   type_radio_link_sim_stats stats;
+   int iFrames = 500;
+   if ( ! _run_link(uBasePort, "reorder=10:5", iFrames, 200, indexes, times, &uTimeStart, &stats) )
+      return 0;
+   int iLate = 0;
+   for( size_t i=1; i<indexes.size(); i++ )
+      if ( indexes[i] < indexes[i-1] )
+         iLate++;
+   int iOk = (((int)indexes.size() == iFrames) && (stats.uFramesReordered > 20) && (iLate > 0))?1:0;
+   printf("Reorder 10%% by 5 ms: %u frames held back, %d arrivals out of order: %s\n", stats.uFramesReordered, iLate, iOk?"ok":"FAILED");
+
+   // 1 Mbps link, 20 ms queue: a burst of 100 frames (800 ms of air time) keeps only the first ones
+   if ( ! _run_link(uBasePort, "rate=1000,queue=20", 100, 0, indexes, times, &uTimeStart, &stats) )
+      return 0;
+   int iQueueOk = ((indexes.size() >= 2) && (indexes.size() <= 5) && ((int)stats.uFramesDroppedQueue == 100 - (int)indexes.size()))?1:0;
+   printf("Rate 1 Mbps, 20 ms queue: %d of 100 frames delivered, %u dropped: %s\n", (int)indexes.size(), stats.uFramesDroppedQueue, iQueueOk?"ok":"FAILED");
+   return iOk && iQueueOk;
+}
+
+static int _test_radiolink(u16 uBasePort)
+{
+   if ( ! hardware_radio_set_simulated_interfaces(2) )
+      return 0;
+   type_radio_link_sim_params params;
+   radio_link_sim_set_default_params(&params);
+   params.iSignalDBM = -61;
+   params.iNoiseDBM = -95;
+   radio_init_link_structures();
+   radio_set_use_link_simulator(-1, uBasePort, &params);
+
+   int iOk = 1;
+   if ( (radio_open_interface_for_write(0) < 0) || (radio_open_interface_for_read(1, RADIO_PORT_ROUTER_DOWNLINK) < 0) )
+   {
+      printf("Failed to open the simulated radio interfaces.\n");
+      return 0;
+   }
+
+   int iPackets = 50;
+   int iReceived = 0;
+   for( int i=0; i<iPackets; i++ )
+   {
+      t_packet_header PH;
+      radio_packet_init(&PH, PACKET_COMPONENT_RUBY, PACKET_TYPE_VIDEO_DATA, STREAM_ID_VIDEO_1);
+      PH.vehicle_id_src = 1;
+      PH.total_length = sizeof(t_packet_header) + 200;
+      u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+      memcpy(uPacket, &PH, sizeof(t_packet_header));
+      for( int k=0; k<200; k++ )
+         uPacket[sizeof(t_packet_header)+k] = (u8)(i+k);
+      u8 uRawPacket[MAX_PACKET_TOTAL_SIZE];
+      int iLength = radio_build_new_raw_ieee_packet(0, uRawPacket, uPacket, PH.total_length, RADIO_PORT_ROUTER_DOWNLINK, 0);
+      if ( ! radio_write_raw_ieee_packet(0, uRawPacket, iLength, 0) )
+         iOk = 0;
+   }
+
+   radio_hw_info_t* pRadioInfo = hardware_get_radio_info(1);
+   u64 uTimeStart = _test_time_micros();
+   while ( (iReceived < iPackets) && (_test_time_micros() - uTimeStart < 500000) )
+   {
+      struct pollfd pfd;
+      pfd.fd = pRadioInfo->runtimeInterfaceInfoRx.selectable_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if ( poll(&pfd, 1, 10) <= 0 )
+         continue;
+      int iLength = 0;
+      u8* pData = NULL;
+      while ( NULL != (pData = radio_process_wlan_data_in(1, &iLength, NULL, get_current_timestamp_ms())) )
+      {
+         int bCRCOk = 0;
+         int iPacketLength = packet_process_and_check(1, pData, iLength, &bCRCOk);
+         t_packet_header* pPH = (t_packet_header*)pData;
+         if ( (iPacketLength != (int)sizeof(t_packet_header) + 200) || (! bCRCOk) || (pPH->packet_type != PACKET_TYPE_VIDEO_DATA) )
+            iOk = 0;
+         else if ( pData[sizeof(t_packet_header)+1] != (u8)(iReceived+1) )
+            iOk = 0;
+         iReceived++;
+      }
+   }
+   if ( iReceived != iPackets )
+      iOk = 0;
+   if ( pRadioInfo->runtimeInterfaceInfoRx.radioHwRxInfo.signalInfoAll.iDbmLast != -61 )
+      iOk = 0;
+   if ( pRadioInfo->runtimeInterfaceInfoRx.radioHwRxInfo.signalInfoAll.iDbmNoiseLast != -95 )
+      iOk = 0;
+
+   type_radio_link_sim_stats stats;
+   if ( (! radio_get_link_simulator_stats(0, &stats)) || ((int)stats.uFramesDelivered != iPackets) )
+      iOk = 0;
+
+   radio_close_interface_for_write(0);
+   radio_close_interface_for_read(1);
+   radio_set_use_link_simulator(-1, 0, NULL);
+   printf("Radiolink over two simulated interfaces: %d of %d packets, CRC and signal %d/%d dBm: %s\n", iReceived, iPackets,
+      pRadioInfo->runtimeInterfaceInfoRx.radioHwRxInfo.signalInfoAll.iDbmLast, pRadioInfo->runtimeInterfaceInfoRx.radioHwRxInfo.signalInfoAll.iDbmNoiseLast, iOk?"ok":"FAILED");
+   return iOk;
+}
+
+int main(int argc, char *argv[])
+{
+   int iFrames = 20000;
+   int iBasePort = RADIO_LINK_SIM_DEFAULT_BASE_PORT + 100;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-frames")) && (i < argc-1) )
+         iFrames = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-port")) && (i < argc-1) )
+         iBasePort = atoi(argv[++i]);
+   }
+   if ( iFrames < 1000 )
+      iFrames = 1000;
+
+   printf("\nTesting the radio link simulator, %d frames, UDP base port %d...\n", iFrames, iBasePort);
+   log_disable();
+
+   int iFailures = 0;
+   if ( ! _test_perfect_link((u16)iBasePort, iFrames) )
+      iFailures++;
+   if ( ! _test_random_loss((u16)iBasePort, iFrames) )
+      iFailures++;
+   if ( ! _test_burst_loss((u16)iBasePort, iFrames) )
+      iFailures++;
+   if ( ! _test_delay_and_rate((u16)iBasePort) )
+      iFailures++;
+   if ( ! _test_reorder_and_queue((u16)iBasePort) )
+      iFailures++;
+   if ( ! _test_radiolink((u16)iBasePort) )
+      iFailures++;
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d checks failed.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
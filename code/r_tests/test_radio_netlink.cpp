@@ -0,0 +1,168 @@
+#include "../base/base.h"
+#include "../base/hardware_radio_netlink.h"
+
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/nl80211.h>
+
+// Checks the in process netlink backend against the ip/iw commands it replaces:
+// rtnetlink link up/down and MTU on a veth pair (created by the test, needs root), with the link
+// state read back using ioctl; operations per second using netlink vs. using the ip command.
+// nl80211: lists the wireless interfaces and their phys supported frequencies; skipped if there
+// are no nl80211 interfaces (no radio cards, no mac80211_hwsim).
+//
+// Usage: test_radio_netlink [-count N]
+
+#define TEST_VETH "rtstnl0"
+#define TEST_VETH_PEER "rtstnl1"
+
+static int s_iFailures = 0;
+
+static void _check(bool bCondition, const char* szMessage)
+{
+   if ( bCondition )
+      return;
+   printf("Failed: %s\n", szMessage);
+   s_iFailures++;
+}
+
+static u64 _test_time_ns()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000000LL + (u64)t.tv_nsec;
+}
+
+// Returns the interface flags and MTU as seen by the kernel, -1 on failure
+static int _get_link_info(const char* szInterface, int* piMTU)
+{
+   int iSocket = socket(AF_INET, SOCK_DGRAM, 0);
+   if ( iSocket < 0 )
+      return -1;
+   struct ifreq ifr;
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, szInterface, IFNAMSIZ-1);
+   int iFlags = -1;
+   if ( 0 == ioctl(iSocket, SIOCGIFFLAGS, &ifr) )
+      iFlags = ifr.ifr_flags;
+   if ( (NULL != piMTU) && (0 == ioctl(iSocket, SIOCGIFMTU, &ifr)) )
+      *piMTU = ifr.ifr_mtu;
+   close(iSocket);
+   return iFlags;
+}
+
+static void _test_rtnetlink(int iCount)
+{
+   if ( system("ip link del " TEST_VETH " >/dev/null 2>&1") ) {}
+   if ( 0 != system("ip link add " TEST_VETH " type veth peer name " TEST_VETH_PEER " >/dev/null 2>&1") )
+   {
+      printf("rtnetlink: can't create a veth pair (not root or no veth support), skipped.\n");
+      return;
+   }
+
+   _check(hardware_radio_netlink_set_link_up(TEST_VETH, 1), "rtnetlink: set link up");
+   int iFlags = _get_link_info(TEST_VETH, NULL);
+   _check((iFlags >= 0) && (iFlags & IFF_UP), "rtnetlink: link is up");
+   _check(hardware_radio_netlink_set_link_up(TEST_VETH, 0), "rtnetlink: set link down");
+   iFlags = _get_link_info(TEST_VETH, NULL);
+   _check((iFlags >= 0) && (!(iFlags & IFF_UP)), "rtnetlink: link is down");
+
+   int iMTU = 0;
+   _check(hardware_radio_netlink_set_mtu(TEST_VETH, 1400), "rtnetlink: set MTU");
+   _get_link_info(TEST_VETH, &iMTU);
+   _check(1400 == iMTU, "rtnetlink: MTU is 1400");
+   _check(!(_get_link_info(TEST_VETH, NULL) & IFF_UP), "rtnetlink: MTU change keeps the link down");
+
+   _check(! hardware_radio_netlink_set_link_up("rtstnlnone", 1), "rtnetlink: missing interface fails");
+   _check(-ENODEV == hardware_radio_netlink_get_last_error(), "rtnetlink: missing interface error is ENODEV");
+
+   // The fallback helpers must use netlink: no command output
+   char szOutput[256];
+   strcpy(szOutput, "x");
+   _check(1 == hardware_radio_set_link_up(TEST_VETH, 1, szOutput), "helper: set link up");
+   _check(0 == szOutput[0], "helper: no command output");
+   _check(_get_link_info(TEST_VETH, NULL) & IFF_UP, "helper: link is up");
+   _check(1 == hardware_radio_set_mtu(TEST_VETH, 1500, szOutput), "helper: set MTU");
+   _get_link_info(TEST_VETH, &iMTU);
+   _check(1500 == iMTU, "helper: MTU is 1500");
+
+   u64 uTime = _test_time_ns();
+   for( int i=0; i<iCount; i++ )
+      if ( ! hardware_radio_netlink_set_link_up(TEST_VETH, i%2) )
+         s_iFailures++;
+   double fNetlinkUs = (double)(_test_time_ns() - uTime) / 1000.0 / (double)iCount;
+
+   int iCountCommand = (iCount > 50)?50:iCount;
+   uTime = _test_time_ns();
+   for( int i=0; i<iCountCommand; i++ )
+      if ( 0 != system((i%2)?"ip link set dev " TEST_VETH " up":"ip link set dev " TEST_VETH " down") )
+         s_iFailures++;
+   double fCommandUs = (double)(_test_time_ns() - uTime) / 1000.0 / (double)iCountCommand;
+
+   printf("rtnetlink link up/down: netlink %.1f us/op (%.0f ops/sec), ip command %.1f us/op (%.0f ops/sec), %.0fx\n",
+      fNetlinkUs, 1000000.0/fNetlinkUs, fCommandUs, 1000000.0/fCommandUs, fCommandUs/fNetlinkUs);
+
+   if ( system("ip link del " TEST_VETH " >/dev/null 2>&1") ) {}
+}
+
+static void _test_nl80211()
+{
+   if ( ! hardware_radio_netlink_init() )
+   {
+      printf("nl80211: not available (error %d), skipped.\n", hardware_radio_netlink_get_last_error());
+      return;
+   }
+   type_radio_netlink_interface interfaces[RADIO_NETLINK_MAX_INTERFACES];
+   int iCount = hardware_radio_netlink_get_interfaces(interfaces, RADIO_NETLINK_MAX_INTERFACES);
+   _check(iCount >= 0, "nl80211: list interfaces");
+   if ( iCount <= 0 )
+   {
+      printf("nl80211: no wireless interfaces, skipped.\n");
+      return;
+   }
+   for( int i=0; i<iCount; i++ )
+   {
+      type_radio_netlink_interface info;
+      _check(hardware_radio_netlink_get_interface(interfaces[i].szName, &info), "nl80211: get interface");
+      _check(info.iIfIndex == interfaces[i].iIfIndex, "nl80211: same interface index");
+      _check(info.iPhyIndex == interfaces[i].iPhyIndex, "nl80211: same phy index");
+      u32 uFrequencies[RADIO_NETLINK_MAX_PHY_FREQUENCIES];
+      int iFrequencies = hardware_radio_netlink_get_phy_frequencies(interfaces[i].iPhyIndex, uFrequencies, RADIO_NETLINK_MAX_PHY_FREQUENCIES);
+      _check(iFrequencies > 0, "nl80211: phy frequencies");
+      printf("nl80211: %s, phy%d, type %u, frequency %u MHz, MAC %02X:%02X:%02X:%02X:%02X:%02X, %d frequencies supported\n",
+         interfaces[i].szName, interfaces[i].iPhyIndex, interfaces[i].uIfType, interfaces[i].uFrequencyMhz,
+         interfaces[i].uMAC[0], interfaces[i].uMAC[1], interfaces[i].uMAC[2], interfaces[i].uMAC[3], interfaces[i].uMAC[4], interfaces[i].uMAC[5], iFrequencies);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   int iCount = 1000;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-count")) && (i < argc-1) )
+         iCount = atoi(argv[++i]);
+      else
+      {
+         printf("Usage: %s [-count N]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iCount < 2 )
+      iCount = 2;
+
+   printf("\nTesting radio netlink backend...\n");
+   log_disable();
+   _test_rtnetlink(iCount);
+   _test_nl80211();
+   hardware_radio_netlink_close();
+
+   if ( s_iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
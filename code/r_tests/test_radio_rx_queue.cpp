@@ -0,0 +1,224 @@
+#include "../base/base.h"
+#include "../radio/radio_rx_queue.h"
+
+#include <pthread.h>
+
+// Stress test for the single producer / single consumer radio rx queues:
+// a producer thread pushes sequence numbered packets on a high and a regular priority queue
+// (sharing the same wakeup event), the consumer reads them in place, with and without waiting,
+// and checks ordering, content and that consumed + dropped packets account for all the pushed ones.
+//
+// Usage: test_radio_rx_queue [-packets N] [-queue N]
+
+typedef struct
+{
+   type_radio_rx_queue* pQueues[2];
+   u32 uPacketsToPush;
+   int iLossless; // Producer waits for room in the queues instead of dropping packets
+   u32 uPushed[2];
+   u32 uDropped[2];
+   volatile int iDone;
+} type_test_producer;
+
+static void _build_packet(u8* pBuffer, int iQueue, u32 uSequence, int* pLength)
+{
+   int iLength = 20 + (int)((uSequence * 37) % 200);
+   memcpy(pBuffer, &uSequence, sizeof(u32));
+   pBuffer[4] = (u8)iQueue;
+   for( int i=5; i<iLength; i++ )
+      pBuffer[i] = (u8)(uSequence + i);
+   *pLength = iLength;
+}
+
+static void* _thread_producer(void* pArg)
+{
+   type_test_producer* pProducer = (type_test_producer*)pArg;
+   u8 uBuffer[MAX_PACKET_TOTAL_SIZE];
+   u32 uSequence[2] = { 0, 0 };
+   for( u32 u=0; u<pProducer->uPacketsToPush; u++ )
+   {
+      // About one in 8 packets goes to the high priority queue
+      int iQueue = ((u % 8) == 0)?0:1;
+      int iLength = 0;
+      _build_packet(uBuffer, iQueue, uSequence[iQueue], &iLength);
+      if ( pProducer->iLossless )
+      while ( radio_rx_queue_get_count(pProducer->pQueues[iQueue]) >= (int)pProducer->pQueues[iQueue]->uQueueSize )
+         sched_yield();
+      if ( radio_rx_queue_push(pProducer->pQueues[iQueue], uBuffer, iLength, iQueue) )
+         pProducer->uPushed[iQueue]++;
+      else
+         pProducer->uDropped[iQueue]++;
+      uSequence[iQueue]++;
+
+      // Pauses now and then, so the consumer also has to block and be woken up
+      if ( (u % 100000) == 99999 )
+         hardware_sleep_micros(500);
+   }
+   __atomic_store_n(&pProducer->iDone, 1, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+// Returns the number of errors
+int _run_test(u32 uPacketsCount, int iQueueSize, int iLossless)
+{
+   printf("\nTesting SPSC radio rx queues (%s), %u packets, queues of %d packets...\n", iLossless?"lossless":"with drops", uPacketsCount, iQueueSize);
+
+   type_radio_rx_queue_wakeup wakeup;
+   type_radio_rx_queue queues[2];
+   if ( ! radio_rx_queue_wakeup_init(&wakeup) )
+   {
+      printf("Failed to create the wakeup event.\n");
+      return 1;
+   }
+   if ( (! radio_rx_queue_init(&queues[0], iQueueSize/2, &wakeup)) || (! radio_rx_queue_init(&queues[1], iQueueSize, &wakeup)) )
+   {
+      printf("Failed to allocate the queues.\n");
+      return 1;
+   }
+
+   type_test_producer producer;
+   memset(&producer, 0, sizeof(producer));
+   producer.pQueues[0] = &queues[0];
+   producer.pQueues[1] = &queues[1];
+   producer.uPacketsToPush = uPacketsCount;
+   producer.iLossless = iLossless;
+
+   pthread_t thread;
+   if ( 0 != pthread_create(&thread, NULL, &_thread_producer, &producer) )
+   {
+      printf("Failed to create the producer thread.\n");
+      return 1;
+   }
+
+   int iFailures = 0;
+   u32 uConsumed[2] = { 0, 0 };
+   u32 uLastSequence[2] = { 0, 0 };
+   int iHasLastSequence[2] = { 0, 0 };
+   u32 uGaps[2] = { 0, 0 };
+   u32 uEmptyWaits = 0;
+   u32 uLoops = 0;
+   u32 uTimeStart = get_current_timestamp_ms();
+
+   while ( true )
+   {
+      int iDone = __atomic_load_n(&producer.iDone, __ATOMIC_ACQUIRE);
+      uLoops++;
+      int iGotAny = 0;
+      for( int iQueue=0; iQueue<2; iQueue++ )
+      {
+         // Same pattern as the router: wait on the high priority queue, then read all the others without waiting
+         u32 uTimeout = ((0 == iQueue) && (! iDone))?2000:0;
+         if ( (uLoops % 3) == 0 )
+            uTimeout = 0;
+         int iCountMax = (0 == iQueue)?10:50;
+         for( int k=0; k<iCountMax; k++ )
+         {
+            int iLength = 0;
+            int iInterface = -1;
+            u8* pPacket = radio_rx_queue_borrow(&queues[iQueue], uTimeout, &iLength, &iInterface);
+            uTimeout = 0;
+            if ( NULL == pPacket )
+            {
+               if ( 0 == k )
+                  uEmptyWaits++;
+               break;
+            }
+            iGotAny = 1;
+            uConsumed[iQueue]++;
+
+            u32 uSequence = 0;
+            memcpy(&uSequence, pPacket, sizeof(u32));
+            int iExpectedLength = 0;
+            u8 uExpected[MAX_PACKET_TOTAL_SIZE];
+            _build_packet(uExpected, iQueue, uSequence, &iExpectedLength);
+            if ( (iLength != iExpectedLength) || (iInterface != iQueue) || (0 != memcmp(pPacket, uExpected, iLength)) )
+            {
+               if ( iFailures < 10 )
+                  printf("Invalid packet on queue %d, sequence %u, length %d\n", iQueue, uSequence, iLength);
+               iFailures++;
+            }
+            if ( iHasLastSequence[iQueue] && (uSequence <= uLastSequence[iQueue]) )
+            {
+               if ( iFailures < 10 )
+                  printf("Packet out of order on queue %d: %u after %u\n", iQueue, uSequence, uLastSequence[iQueue]);
+               iFailures++;
+            }
+            if ( iHasLastSequence[iQueue] && (uSequence > uLastSequence[iQueue] + 1) )
+               uGaps[iQueue] += uSequence - uLastSequence[iQueue] - 1;
+            else if ( (! iHasLastSequence[iQueue]) && (uSequence > 0) )
+               uGaps[iQueue] += uSequence;
+            uLastSequence[iQueue] = uSequence;
+            iHasLastSequence[iQueue] = 1;
+         }
+      }
+      if ( iDone && (! iGotAny) && (0 == radio_rx_queue_get_count(&queues[0])) && (0 == radio_rx_queue_get_count(&queues[1])) )
+         break;
+      if ( get_current_timestamp_ms() > uTimeStart + 60000 )
+      {
+         printf("Timed out.\n");
+         iFailures++;
+         break;
+      }
+   }
+   pthread_join(thread, NULL);
+   radio_rx_queue_release(&queues[0]);
+   radio_rx_queue_release(&queues[1]);
+   u32 uDuration = get_current_timestamp_ms() - uTimeStart;
+
+   for( int iQueue=0; iQueue<2; iQueue++ )
+   {
+      printf("Queue %d (%u slots): pushed %u, dropped %u, consumed %u, sequence gaps %u.\n",
+         iQueue, queues[iQueue].uQueueSize, producer.uPushed[iQueue], producer.uDropped[iQueue], uConsumed[iQueue], uGaps[iQueue]);
+      if ( (uConsumed[iQueue] != producer.uPushed[iQueue]) || (uConsumed[iQueue] != queues[iQueue].uTotalConsumedPackets) )
+         iFailures++;
+      if ( (queues[iQueue].uDroppedPackets != producer.uDropped[iQueue]) || (queues[iQueue].uTotalPackets != producer.uPushed[iQueue]) )
+         iFailures++;
+      if ( iLossless && (0 != producer.uDropped[iQueue]) )
+         iFailures++;
+      // Every dropped packet must show up as a gap in the consumed sequence numbers and nothing else
+      u32 uTail = 0;
+      u32 uPushedTotal = producer.uPushed[iQueue] + producer.uDropped[iQueue];
+      if ( iHasLastSequence[iQueue] && (uPushedTotal > uLastSequence[iQueue] + 1) )
+         uTail = uPushedTotal - uLastSequence[iQueue] - 1;
+      if ( uGaps[iQueue] + uTail != producer.uDropped[iQueue] )
+         iFailures++;
+   }
+   printf("Done in %u ms (%.1f M packets/sec), %u empty reads/waits.\n", uDuration, (float)uPacketsCount/1000.0/(float)(uDuration+1), uEmptyWaits);
+
+   radio_rx_queue_free(&queues[0]);
+   radio_rx_queue_free(&queues[1]);
+   radio_rx_queue_wakeup_close(&wakeup);
+
+   if ( iFailures > 0 )
+      printf("%d errors.\n", iFailures);
+   return iFailures;
+}
+
+int main(int argc, char *argv[])
+{
+   u32 uPacketsCount = 4000000;
+   int iQueueSize = 2000;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-packets")) && (i < argc-1) )
+         uPacketsCount = (u32)atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-queue")) && (i < argc-1) )
+         iQueueSize = atoi(argv[++i]);
+   }
+   if ( iQueueSize < 4 )
+      iQueueSize = 4;
+
+   log_disable();
+
+   int iFailures = 0;
+   iFailures += _run_test(uPacketsCount, iQueueSize, 0);
+   iFailures += _run_test(uPacketsCount, iQueueSize, 1);
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
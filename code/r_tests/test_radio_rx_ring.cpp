@@ -0,0 +1,238 @@
+#include "../base/base.h"
+#include "../radio/radio_rx_ring.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+// Checks the TPACKET_V3 mmap rx ring without Wi-Fi hardware: radiotap + IEEE frames
+// are injected on one end of a veth pair and read from the ring on the other end,
+// through a BPF filter equivalent to the one radiolink compiles for the Ruby ports.
+// Needs root (creates and removes a veth pair).
+//
+// Usage: test_radio_rx_ring [-frames N]
+
+#define TEST_IF_TX "rxringtst0"
+#define TEST_IF_RX "rxringtst1"
+#define TEST_PORT 0x1F
+#define TEST_OTHER_PORT 0x2F
+#define TEST_PAYLOAD_SIZE 1000
+#define TEST_MAX_FRAMES_PER_DRAIN 512
+#define TEST_BURST_SIZE 256
+
+static u8 s_uRadiotapHeader[] = { 0x00, 0x00, 0x0d, 0x00, 0x00, 0x80, 0x08, 0x00, 0x08, 0x00, 0x37, 0x30, 0x00 };
+static u8 s_uIEEEHeader[] = {
+   0x08, 0x01, 0x00, 0x00,
+   0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+   0x13, 0x12, 0x34, 0x56, 0x78, 0x90,
+   0x13, 0x12, 0x34, 0x56, 0x78, 0x90,
+   0x00, 0x00 };
+
+// Same checks as the radiolink pcap filter: data frame, Ruby MAC and port; skips the radiotap header of any length
+static struct sock_filter s_FilterCode[] = {
+   BPF_STMT(BPF_LD + BPF_B + BPF_ABS, 3),
+   BPF_STMT(BPF_ALU + BPF_LSH + BPF_K, 8),
+   BPF_STMT(BPF_MISC + BPF_TAX, 0),
+   BPF_STMT(BPF_LD + BPF_B + BPF_ABS, 2),
+   BPF_STMT(BPF_ALU + BPF_OR + BPF_X, 0),
+   BPF_STMT(BPF_MISC + BPF_TAX, 0),
+   BPF_STMT(BPF_LD + BPF_H + BPF_IND, 0),
+   BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, 0x0801, 0, 5),
+   BPF_STMT(BPF_LD + BPF_W + BPF_IND, 10),
+   BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, 0x13123456, 0, 3),
+   BPF_STMT(BPF_LD + BPF_B + BPF_IND, 4),
+   BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, TEST_PORT, 0, 1),
+   BPF_STMT(BPF_RET + BPF_K, 0xFFFF),
+   BPF_STMT(BPF_RET + BPF_K, 0),
+};
+
+static u8 s_uFrame[sizeof(s_uRadiotapHeader) + sizeof(s_uIEEEHeader) + TEST_PAYLOAD_SIZE];
+
+int _build_frame(u8 uPort, u32 uIndex)
+{
+   int iPos = 0;
+   memcpy(s_uFrame, s_uRadiotapHeader, sizeof(s_uRadiotapHeader));
+   iPos += sizeof(s_uRadiotapHeader);
+   memcpy(s_uFrame + iPos, s_uIEEEHeader, sizeof(s_uIEEEHeader));
+   s_uFrame[iPos + 4] = uPort;
+   iPos += sizeof(s_uIEEEHeader);
+   memcpy(s_uFrame + iPos, &uIndex, sizeof(u32));
+   for( int i=sizeof(u32); i<TEST_PAYLOAD_SIZE; i++ )
+      s_uFrame[iPos + i] = (u8)(uIndex + i);
+   return iPos + TEST_PAYLOAD_SIZE;
+}
+
+// Returns the frame index or -1 if the frame content is not valid
+int _check_frame(u8* pFrame, int iLength)
+{
+   int iHeaders = sizeof(s_uRadiotapHeader) + sizeof(s_uIEEEHeader);
+   if ( iLength != iHeaders + TEST_PAYLOAD_SIZE )
+      return -1;
+   if ( pFrame[iHeaders - sizeof(s_uIEEEHeader) + 4] != TEST_PORT )
+      return -1;
+   u32 uIndex = 0;
+   memcpy(&uIndex, pFrame + iHeaders, sizeof(u32));
+   for( int i=sizeof(u32); i<TEST_PAYLOAD_SIZE; i++ )
+      if ( pFrame[iHeaders + i] != (u8)(uIndex + i) )
+         return -1;
+   return (int)uIndex;
+}
+
+void _remove_interfaces()
+{
+   if ( system("ip link del " TEST_IF_TX " >/dev/null 2>&1") ) {}
+}
+
+int main(int argc, char *argv[])
+{
+   int iFramesCount = 1000;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-frames")) && (i < argc-1) )
+         iFramesCount = atoi(argv[++i]);
+   }
+   if ( iFramesCount < 1 )
+      iFramesCount = 1;
+
+   printf("\nTesting mmap rx ring (TPACKET_V3) on a veth pair, %d frames...\n", iFramesCount);
+   log_disable();
+
+   _remove_interfaces();
+   if ( 0 != system("ip link add " TEST_IF_TX " type veth peer name " TEST_IF_RX " >/dev/null 2>&1") )
+   {
+      printf("Can't create veth interfaces (needs root and veth support), skipped.\n");
+      return 0;
+   }
+   if ( 0 != system("ip link set " TEST_IF_TX " up && ip link set " TEST_IF_RX " up") )
+   {
+      printf("Failed to bring up the veth interfaces.\n");
+      _remove_interfaces();
+      return 1;
+   }
+
+   int iFailures = 0;
+   if ( radio_rx_ring_get_interface_arp_type(TEST_IF_RX) != ARPHRD_ETHER )
+   {
+      printf("Invalid interface type returned for %s\n", TEST_IF_RX);
+      iFailures++;
+   }
+
+   struct bpf_program filter;
+   filter.bf_len = sizeof(s_FilterCode)/sizeof(s_FilterCode[0]);
+   filter.bf_insns = (struct bpf_insn*)s_FilterCode;
+
+   type_radio_rx_ring ring;
+   int iRingFd = radio_rx_ring_open(&ring, TEST_IF_RX, &filter);
+   if ( iRingFd < 0 )
+   {
+      printf("Failed to open rx ring on %s\n", TEST_IF_RX);
+      _remove_interfaces();
+      return 1;
+   }
+
+   int iTxSocket = socket(AF_PACKET, SOCK_RAW, 0);
+   struct sockaddr_ll ll_addr;
+   memset(&ll_addr, 0, sizeof(ll_addr));
+   ll_addr.sll_family = AF_PACKET;
+   ll_addr.sll_ifindex = if_nametoindex(TEST_IF_TX);
+   if ( (iTxSocket < 0) || (0 != bind(iTxSocket, (struct sockaddr*)&ll_addr, sizeof(ll_addr))) )
+   {
+      printf("Failed to open tx socket on %s\n", TEST_IF_TX);
+      radio_rx_ring_close(&ring);
+      _remove_interfaces();
+      return 1;
+   }
+
+   // Frames are sent in bursts; every 4th frame goes to another port and must be filtered out by the kernel.
+   // After each burst, alternate between draining whole blocks and reading frame by frame.
+   u8* pFrames[TEST_MAX_FRAMES_PER_DRAIN];
+   int iFramesLengths[TEST_MAX_FRAMES_PER_DRAIN];
+   int iExpected = 0;
+   int iReceived = 0;
+   int iReads = 0;
+   int iMaxFramesPerDrain = 0;
+   int iSent = 0;
+   while ( iSent < iFramesCount )
+   {
+      for( int i=0; (i<TEST_BURST_SIZE) && (iSent < iFramesCount); i++, iSent++ )
+      {
+         bool bOtherPort = ((iSent % 4) == 3);
+         int iLength = _build_frame(bOtherPort?TEST_OTHER_PORT:TEST_PORT, bOtherPort?0xFFFFFFFF:(u32)iExpected);
+         if ( send(iTxSocket, s_uFrame, iLength, 0) != iLength )
+         {
+            printf("Failed to send frame %d\n", iSent);
+            iFailures++;
+         }
+         if ( ! bOtherPort )
+            iExpected++;
+      }
+
+      u32 uTimeStart = get_current_timestamp_ms();
+      while ( (iReceived < iExpected) && (get_current_timestamp_ms() < uTimeStart + 1000) )
+      {
+         struct pollfd fds;
+         fds.fd = iRingFd;
+         fds.events = POLLIN;
+         fds.revents = 0;
+         if ( (radio_rx_ring_get_pending_frames(&ring) == 0) && (poll(&fds, 1, 50) <= 0) )
+            continue;
+
+         int iCount = 0;
+         if ( (iReads % 2) == 0 )
+         {
+            iCount = radio_rx_ring_drain_block(&ring, pFrames, iFramesLengths, TEST_MAX_FRAMES_PER_DRAIN);
+            for( int i=0; i<iCount; i++ )
+            {
+               int iIndex = _check_frame(pFrames[i], iFramesLengths[i]);
+               if ( iIndex != iReceived )
+               {
+                  if ( iFailures < 10 )
+                     printf("Invalid frame received: index %d, expected %d, length %d\n", iIndex, iReceived, iFramesLengths[i]);
+                  iFailures++;
+               }
+               iReceived++;
+            }
+            if ( iCount > iMaxFramesPerDrain )
+               iMaxFramesPerDrain = iCount;
+         }
+         else
+         {
+            int iLength = 0;
+            u8* pFrame = NULL;
+            while ( NULL != (pFrame = radio_rx_ring_next_frame(&ring, &iLength)) )
+            {
+               int iIndex = _check_frame(pFrame, iLength);
+               if ( iIndex != iReceived )
+               {
+                  if ( iFailures < 10 )
+                     printf("Invalid frame received: index %d, expected %d, length %d\n", iIndex, iReceived, iLength);
+                  iFailures++;
+               }
+               iReceived++;
+            }
+         }
+         iReads++;
+      }
+   }
+   close(iTxSocket);
+
+   printf("Received %d of %d frames in %u blocks (%d reads, max %d frames per drained block).\n", iReceived, iExpected, ring.uTotalBlocksRead, iReads, iMaxFramesPerDrain);
+   if ( iReceived != iExpected )
+      iFailures++;
+
+   radio_rx_ring_close(&ring);
+   _remove_interfaces();
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
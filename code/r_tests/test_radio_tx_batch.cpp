@@ -0,0 +1,243 @@
+#include "../base/base.h"
+#include "../radio/radio_tx_batch.h"
+
+#include <dlfcn.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+// Checks batched raw frames tx without Wi-Fi hardware: frames are sent on one end of
+// a veth pair, per frame with write() and then batched with sendmmsg(), and counted on
+// the other end. The send syscalls are counted by interposing write() and sendmmsg().
+// Needs root (creates and removes a veth pair).
+//
+// Usage: test_radio_tx_batch [-frames N] [-burst N]
+
+#define TEST_IF_TX "txbatchtst0"
+#define TEST_IF_RX "txbatchtst1"
+#define TEST_FRAME_SIZE 1200
+#define TEST_MAGIC 0xB7A7C4ED
+
+static u32 s_uCountSyscallsWrite = 0;
+static u32 s_uCountSyscallsSendmmsg = 0;
+
+extern "C" ssize_t write(int fd, const void* pBuffer, size_t uCount)
+{
+   static ssize_t (*s_pRealWrite)(int, const void*, size_t) = NULL;
+   if ( NULL == s_pRealWrite )
+      s_pRealWrite = (ssize_t (*)(int, const void*, size_t)) dlsym(RTLD_NEXT, "write");
+   s_uCountSyscallsWrite++;
+   return s_pRealWrite(fd, pBuffer, uCount);
+}
+
+extern "C" int sendmmsg(int fd, struct mmsghdr* pMessages, unsigned int uCount, int iFlags)
+{
+   static int (*s_pRealSendmmsg)(int, struct mmsghdr*, unsigned int, int) = NULL;
+   if ( NULL == s_pRealSendmmsg )
+      s_pRealSendmmsg = (int (*)(int, struct mmsghdr*, unsigned int, int)) dlsym(RTLD_NEXT, "sendmmsg");
+   s_uCountSyscallsSendmmsg++;
+   return s_pRealSendmmsg(fd, pMessages, uCount, iFlags);
+}
+
+int _open_socket(const char* szInterface, bool bForRead)
+{
+   int iSocket = socket(AF_PACKET, SOCK_RAW, bForRead?htons(ETH_P_ALL):0);
+   if ( iSocket < 0 )
+      return -1;
+   struct sockaddr_ll ll_addr;
+   memset(&ll_addr, 0, sizeof(ll_addr));
+   ll_addr.sll_family = AF_PACKET;
+   ll_addr.sll_protocol = bForRead?htons(ETH_P_ALL):0;
+   ll_addr.sll_ifindex = if_nametoindex(szInterface);
+   if ( 0 != bind(iSocket, (struct sockaddr*)&ll_addr, sizeof(ll_addr)) )
+   {
+      close(iSocket);
+      return -1;
+   }
+   if ( bForRead )
+   {
+      int iSize = 8*1024*1024;
+      setsockopt(iSocket, SOL_SOCKET, SO_RCVBUF, &iSize, sizeof(iSize));
+      fcntl(iSocket, F_SETFL, O_NONBLOCK);
+   }
+   return iSocket;
+}
+
+void _build_frame(u8* pBuffer, u32 uIndex)
+{
+   memset(pBuffer, 0xFF, 6);
+   u32 uMagic = TEST_MAGIC;
+   memcpy(pBuffer + 14, &uMagic, sizeof(u32));
+   memcpy(pBuffer + 18, &uIndex, sizeof(u32));
+   for( int i=22; i<TEST_FRAME_SIZE; i++ )
+      pBuffer[i] = (u8)(uIndex + i);
+}
+
+// Returns the number of valid frames received, in order, starting with frame index uFirstIndex
+int _receive_frames(int iSocket, u32 uFirstIndex, int iExpected)
+{
+   u8 uBuffer[2048];
+   int iReceived = 0;
+   u32 uTimeStart = get_current_timestamp_ms();
+   while ( (iReceived < iExpected) && (get_current_timestamp_ms() < uTimeStart + 1000) )
+   {
+      int iLength = recv(iSocket, uBuffer, sizeof(uBuffer), 0);
+      if ( iLength <= 0 )
+      {
+         hardware_sleep_ms(1);
+         continue;
+      }
+      u32 uMagic = 0, uIndex = 0;
+      memcpy(&uMagic, uBuffer + 14, sizeof(u32));
+      if ( (iLength != TEST_FRAME_SIZE) || (uMagic != TEST_MAGIC) )
+         continue;
+      memcpy(&uIndex, uBuffer + 18, sizeof(u32));
+      if ( uIndex != uFirstIndex + (u32)iReceived )
+      {
+         printf("Frame received out of order: %u, expected %u\n", uIndex, uFirstIndex + (u32)iReceived);
+         return iReceived;
+      }
+      bool bOk = true;
+      for( int i=22; i<TEST_FRAME_SIZE; i++ )
+         if ( uBuffer[i] != (u8)(uIndex + i) )
+            bOk = false;
+      if ( ! bOk )
+      {
+         printf("Invalid content for frame %u\n", uIndex);
+         return iReceived;
+      }
+      iReceived++;
+   }
+   return iReceived;
+}
+
+void _remove_interfaces()
+{
+   if ( system("ip link del " TEST_IF_TX " >/dev/null 2>&1") ) {}
+}
+
+int main(int argc, char *argv[])
+{
+   int iFramesCount = 512;
+   int iBurstSize = 16;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-frames")) && (i < argc-1) )
+         iFramesCount = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-burst")) && (i < argc-1) )
+         iBurstSize = atoi(argv[++i]);
+   }
+   if ( iFramesCount < 1 )
+      iFramesCount = 1;
+   if ( iBurstSize < 1 )
+      iBurstSize = 1;
+
+   printf("\nTesting batched radio tx on a veth pair, %d frames, bursts of %d frames...\n", iFramesCount, iBurstSize);
+   log_disable();
+
+   _remove_interfaces();
+   if ( 0 != system("ip link add " TEST_IF_TX " type veth peer name " TEST_IF_RX " >/dev/null 2>&1") )
+   {
+      printf("Can't create veth interfaces (needs root and veth support), skipped.\n");
+      return 0;
+   }
+   if ( 0 != system("ip link set " TEST_IF_TX " up && ip link set " TEST_IF_RX " up") )
+   {
+      printf("Failed to bring up the veth interfaces.\n");
+      _remove_interfaces();
+      return 1;
+   }
+
+   int iTxSocket = _open_socket(TEST_IF_TX, false);
+   int iRxSocket = _open_socket(TEST_IF_RX, true);
+   if ( (iTxSocket < 0) || (iRxSocket < 0) )
+   {
+      printf("Failed to open the test sockets.\n");
+      _remove_interfaces();
+      return 1;
+   }
+
+   int iFailures = 0;
+   u8 uFrame[TEST_FRAME_SIZE];
+
+   // Per frame writes, as the regular radio tx does
+   s_uCountSyscallsWrite = 0;
+   for( int i=0; i<iFramesCount; i++ )
+   {
+      _build_frame(uFrame, (u32)i);
+      if ( write(iTxSocket, uFrame, TEST_FRAME_SIZE) != TEST_FRAME_SIZE )
+         iFailures++;
+      if ( (i % iBurstSize) == iBurstSize-1 )
+      if ( _receive_frames(iRxSocket, (u32)(i+1-iBurstSize), iBurstSize) != iBurstSize )
+         iFailures++;
+   }
+   u32 uSyscallsPerFrame = s_uCountSyscallsWrite;
+   _receive_frames(iRxSocket, (u32)(iFramesCount - (iFramesCount % iBurstSize)), iFramesCount % iBurstSize);
+
+   // Batched: frames are built in place in the batch buffers and each burst is flushed with one syscall
+   type_radio_tx_batch batch;
+   if ( ! radio_tx_batch_init(&batch) )
+   {
+      printf("Failed to init the tx batch.\n");
+      _remove_interfaces();
+      return 1;
+   }
+
+   // Bursts larger than the batch are flushed in several syscalls, as radiolink does when a batch gets full
+   s_uCountSyscallsWrite = 0;
+   s_uCountSyscallsSendmmsg = 0;
+   u32 uFirstIndex = (u32)iFramesCount;
+   int iReceivedBatched = 0;
+   for( int i=0; i<iFramesCount; i++ )
+   {
+      if ( radio_tx_batch_is_full(&batch) )
+      if ( radio_tx_batch_flush(&batch, iTxSocket) != RADIO_TX_BATCH_MAX_FRAMES )
+         iFailures++;
+      u8* pBuffer = radio_tx_batch_get_next_frame_buffer(&batch);
+      _build_frame(pBuffer, uFirstIndex + (u32)i);
+      if ( ! radio_tx_batch_add_frame(&batch, pBuffer, TEST_FRAME_SIZE) )
+         iFailures++;
+
+      if ( ((i % iBurstSize) == iBurstSize-1) || (i == iFramesCount-1) )
+      {
+         int iCount = radio_tx_batch_get_frames_count(&batch);
+         if ( radio_tx_batch_flush(&batch, iTxSocket) != iCount )
+            iFailures++;
+         iReceivedBatched += _receive_frames(iRxSocket, uFirstIndex + (u32)iReceivedBatched, i + 1 - iReceivedBatched);
+      }
+   }
+
+   int iExpectedSyscalls = 0;
+   for( int i=0; i<iFramesCount; i += iBurstSize )
+   {
+      int iCount = iFramesCount - i;
+      if ( iCount > iBurstSize )
+         iCount = iBurstSize;
+      iExpectedSyscalls += (iCount + RADIO_TX_BATCH_MAX_FRAMES - 1) / RADIO_TX_BATCH_MAX_FRAMES;
+   }
+
+   printf("Per frame tx: %u syscalls for %d frames.\n", uSyscallsPerFrame, iFramesCount);
+   printf("Batched tx: %u sendmmsg + %u write syscalls for %d frames (expected %d), received %d frames.\n",
+      s_uCountSyscallsSendmmsg, s_uCountSyscallsWrite, iFramesCount, iExpectedSyscalls, iReceivedBatched);
+
+   if ( (int)s_uCountSyscallsSendmmsg != iExpectedSyscalls || (0 != s_uCountSyscallsWrite) )
+      iFailures++;
+   if ( iReceivedBatched != iFramesCount )
+      iFailures++;
+   if ( batch.uTotalFramesSent != (u32)iFramesCount )
+      iFailures++;
+
+   radio_tx_batch_free(&batch);
+   close(iTxSocket);
+   close(iRxSocket);
+   _remove_interfaces();
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,197 @@
+#include "../base/base.h"
+#include "../base/shared_mem.h"
+
+#include <stddef.h>
+#include <sys/wait.h>
+
+// Checks the seqlock versioned shared memory sections with a writer process and a reader process,
+// on a shared_mem_radio_stats_versioned object (test shared memory name, not the router one).
+// The writer fills each changed section with a single byte value, so a torn read shows up as
+// a section with mixed values. Runs a fast writer (max contention) and a paced writer (as the router does),
+// then the same fast writer with plain memcpy reads, to check the test does detect torn reads.
+// Also reports how many bytes the readers did copy compared to copying the full struct on each read.
+//
+// Usage: test_shared_mem_seqlock [-ms N]
+
+#define TEST_SHARED_MEM_NAME "/RUBY_TEST_SHARED_MEM_SEQLOCK"
+
+typedef struct
+{
+   u32 uOffset;
+   u32 uSize;
+} type_test_region;
+
+static type_test_region s_Regions[SHARED_MEM_RADIO_STATS_SECTIONS];
+static int s_iCountRegions = 0;
+
+void _add_region(u32 uOffset, u32 uSize)
+{
+   s_Regions[s_iCountRegions].uOffset = uOffset;
+   s_Regions[s_iCountRegions].uSize = uSize;
+   s_iCountRegions++;
+}
+
+// Same split as the one used by shared_mem_radio_stats_publish
+void _init_regions()
+{
+   s_iCountRegions = 0;
+   _add_region(0, offsetof(shared_mem_radio_stats, radio_streams));
+   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
+      _add_region(offsetof(shared_mem_radio_stats, radio_streams) + i*sizeof(shared_mem_radio_stats_stream)*MAX_RADIO_STREAMS, sizeof(shared_mem_radio_stats_stream)*MAX_RADIO_STREAMS);
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+      _add_region(offsetof(shared_mem_radio_stats, radio_interfaces) + i*sizeof(shared_mem_radio_stats_radio_interface), sizeof(shared_mem_radio_stats_radio_interface));
+   _add_region(offsetof(shared_mem_radio_stats, radio_links), sizeof(shared_mem_radio_stats) - offsetof(shared_mem_radio_stats, radio_links));
+}
+
+// Returns the number of regions with mixed byte values
+int _count_torn_regions(u8* pStats)
+{
+   int iCount = 0;
+   for( int i=0; i<s_iCountRegions; i++ )
+   {
+      u8* pRegion = pStats + s_Regions[i].uOffset;
+      for( u32 u=1; u<s_Regions[i].uSize; u++ )
+      {
+         if ( pRegion[u] != pRegion[0] )
+         {
+            iCount++;
+            break;
+         }
+      }
+   }
+   return iCount;
+}
+
+// Writer process: the header and the first radio interface change on each update, the first
+// vehicle streams on each 4th update, everything else on each 64th update.
+void _run_writer(shared_mem_radio_stats_versioned* pShared, int iDurationMs, u32 uUpdateIntervalMicros, bool bUseSeqlock)
+{
+   static shared_mem_radio_stats s_Local;
+   memset(&s_Local, 0, sizeof(s_Local));
+   u32 uCounter = 0;
+   u32 uTimeEnd = get_current_timestamp_ms() + (u32)iDurationMs;
+   while ( get_current_timestamp_ms() < uTimeEnd )
+   {
+      uCounter++;
+      for( int i=0; i<s_iCountRegions; i++ )
+      {
+         bool bChange = false;
+         if ( (0 == i) || (1 + MAX_CONCURENT_VEHICLES == i) )
+            bChange = true;
+         else if ( 1 == i )
+            bChange = ((uCounter % 4) == 0);
+         else
+            bChange = ((uCounter % 64) == 0);
+         if ( bChange )
+            memset(((u8*)&s_Local) + s_Regions[i].uOffset, (int)(uCounter & 0xFF), s_Regions[i].uSize);
+      }
+      if ( bUseSeqlock )
+         shared_mem_radio_stats_publish(pShared, &s_Local);
+      else
+         memcpy(&(pShared->stats), &s_Local, sizeof(shared_mem_radio_stats));
+      if ( 0 != uUpdateIntervalMicros )
+         hardware_sleep_micros(uUpdateIntervalMicros);
+   }
+}
+
+// Returns the number of torn reads detected
+int _run_test(const char* szName, shared_mem_radio_stats_versioned* pSharedWrite, shared_mem_radio_stats_versioned* pSharedRead, int iDurationMs, u32 uWriterIntervalMicros, bool bUseSeqlock)
+{
+   static shared_mem_radio_stats s_Snapshot;
+   memset(&s_Snapshot, 0, sizeof(s_Snapshot));
+   memset(&(pSharedWrite->stats), 0, sizeof(shared_mem_radio_stats));
+   shared_mem_seqlocks_init(pSharedWrite->locks, SHARED_MEM_RADIO_STATS_SECTIONS);
+
+   shared_mem_sections_reader reader;
+   shared_mem_sections_reader_reset(&reader);
+
+   fflush(stdout);
+   pid_t pid = fork();
+   if ( pid < 0 )
+   {
+      printf("Failed to fork the writer process.\n");
+      return 1;
+   }
+   if ( 0 == pid )
+   {
+      _run_writer(pSharedWrite, iDurationMs, uWriterIntervalMicros, bUseSeqlock);
+      _exit(0);
+   }
+
+   u32 uCountReads = 0;
+   u32 uCountTornReads = 0;
+   u32 uTimeStart = get_current_timestamp_ms();
+   int iStatus = 0;
+   while ( 0 == waitpid(pid, &iStatus, WNOHANG) )
+   {
+      if ( bUseSeqlock )
+         shared_mem_radio_stats_read(pSharedRead, &s_Snapshot, &reader);
+      else
+         memcpy(&s_Snapshot, &(pSharedRead->stats), sizeof(shared_mem_radio_stats));
+      uCountReads++;
+      if ( _count_torn_regions((u8*)&s_Snapshot) > 0 )
+         uCountTornReads++;
+      // Reader is paced to about a read each 100 microseconds, more often than central does
+      hardware_sleep_micros(100);
+   }
+   u32 uDurationMs = get_current_timestamp_ms() - uTimeStart;
+   if ( 0 == uDurationMs )
+      uDurationMs = 1;
+
+   u64 uBytesFull = (u64)uCountReads * (u64)sizeof(shared_mem_radio_stats);
+   printf("%s: %u reads in %u ms, %u torn reads.\n", szName, uCountReads, uDurationMs, uCountTornReads);
+   if ( bUseSeqlock )
+   {
+      printf("   Copied %llu kB (%.1f%% of full copies: %llu kB), skipped %llu kB unchanged, %u retries, %u failed section reads.\n",
+         reader.uTotalBytesCopied/1024, (uBytesFull > 0)?(100.0*(double)reader.uTotalBytesCopied/(double)uBytesFull):0.0,
+         uBytesFull/1024, reader.uTotalBytesSkipped/1024, reader.uTotalRetries, reader.uTotalFailedReads);
+      printf("   Copy bandwidth: %.2f MB/s, full copies would use %.2f MB/s.\n",
+         (double)reader.uTotalBytesCopied/1024.0/1024.0*1000.0/(double)uDurationMs, (double)uBytesFull/1024.0/1024.0*1000.0/(double)uDurationMs);
+   }
+   return (int)uCountTornReads;
+}
+
+int main(int argc, char *argv[])
+{
+   int iDurationMs = 1000;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-ms")) && (i < argc-1) )
+         iDurationMs = atoi(argv[++i]);
+   }
+   if ( iDurationMs < 100 )
+      iDurationMs = 100;
+
+   printf("\nTesting seqlock versioned shared memory (%d sections, %d bytes), %d ms per test...\n",
+      SHARED_MEM_RADIO_STATS_SECTIONS, (int)sizeof(shared_mem_radio_stats), iDurationMs);
+   log_disable();
+   _init_regions();
+
+   shared_mem_radio_stats_versioned* pSharedWrite = (shared_mem_radio_stats_versioned*)open_shared_mem_for_write(TEST_SHARED_MEM_NAME, sizeof(shared_mem_radio_stats_versioned));
+   shared_mem_radio_stats_versioned* pSharedRead = (shared_mem_radio_stats_versioned*)open_shared_mem_for_read(TEST_SHARED_MEM_NAME, sizeof(shared_mem_radio_stats_versioned));
+   if ( (NULL == pSharedWrite) || (NULL == pSharedRead) )
+   {
+      printf("Failed to open the test shared memory.\n");
+      shm_unlink(TEST_SHARED_MEM_NAME);
+      return 1;
+   }
+
+   int iFailures = 0;
+   iFailures += _run_test("Seqlock, fast writer", pSharedWrite, pSharedRead, iDurationMs, 0, true);
+   iFailures += _run_test("Seqlock, writer updating each 1 ms", pSharedWrite, pSharedRead, iDurationMs, 1000, true);
+   int iTornUnsafe = _run_test("Plain memcpy, fast writer", pSharedWrite, pSharedRead, iDurationMs, 0, false);
+   if ( 0 == iTornUnsafe )
+      printf("   (no torn reads detected without the seqlock on this run)\n");
+
+   munmap(pSharedWrite, sizeof(shared_mem_radio_stats_versioned));
+   munmap(pSharedRead, sizeof(shared_mem_radio_stats_versioned));
+   shm_unlink(TEST_SHARED_MEM_NAME);
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d torn reads with the seqlock.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
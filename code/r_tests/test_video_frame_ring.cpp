@@ -0,0 +1,520 @@
+#include "../base/base.h"
+#include "../base/video_frame_ring.h"
+
+#include <sys/wait.h>
+#include <signal.h>
+
+// Pumps a recorded H264/H265 stream (or a generated one) through the SM video frames ring, from a
+// producer process (as the router does: video packet sized writes, publish on NAL end) to a consumer
+// process (as the player does: acquire, hand the data to the decoder, release). Each frame carries its
+// index after the stream data, so the consumer checks every frame it gets against the input stream.
+// First pass is paced at the stream FPS and reports the per frame handoff latency (publish to consumer)
+// and the latency from the first data written; second pass runs the producer as fast as it can with a
+// consumer holding each frame for a while (ring full: reclaimed and dropped frames) and checks no frame
+// referenced by the consumer gets overwritten. A consumer killed while holding a frame must not block
+// the producer once a new consumer opens the ring. Reports the copies per stream byte on the way from the
+// router to the decoder input (the previous byte ring did 2: router to SM, SM to the player buffer).
+//
+// Usage: test_video_frame_ring [-file stream.h264] [-h265] [-frames N] [-fps N]
+
+#define TEST_RING_NAME "/RUBY_TEST_VIDEO_FRAME_RING"
+#define TEST_PACKET_SIZE 1100
+#define TEST_MAX_FRAMES 20000
+
+typedef struct
+{
+   u32 uOffset;
+   u32 uLength;
+   u32 uCRC;
+} type_test_frame;
+
+static u8* s_pStream = NULL;
+static u32 s_uStreamSize = 0;
+static type_test_frame s_Frames[TEST_MAX_FRAMES];
+static int s_iCountFrames = 0;
+static int s_iFailures = 0;
+
+static void _check(bool bCondition, const char* szMessage)
+{
+   if ( bCondition )
+      return;
+   printf("Failed: %s\n", szMessage);
+   s_iFailures++;
+}
+
+static int _is_vcl_nal(u8 uNALHeader, bool bH265)
+{
+   if ( bH265 )
+   {
+      int iType = (uNALHeader >> 1) & 0x3F;
+      return (iType < 32)?1:0;
+   }
+   int iType = uNALHeader & 0x1F;
+   return ((iType >= 1) && (iType <= 5))?1:0;
+}
+
+// Frames: non VCL NALs (SPS, PPS, SEI...) go with the next VCL NAL
+static void _split_stream_in_frames(bool bH265)
+{
+   s_iCountFrames = 0;
+   u32 uFrameStart = 0;
+   bool bFrameHasVCL = false;
+   for( u32 u=0; u+4 < s_uStreamSize; u++ )
+   {
+      if ( (s_pStream[u] != 0) || (s_pStream[u+1] != 0) || (s_pStream[u+2] != 1) )
+         continue;
+      u32 uNALStart = u;
+      if ( (u > 0) && (s_pStream[u-1] == 0) )
+         uNALStart = u-1;
+      if ( bFrameHasVCL && (uNALStart > uFrameStart) && (s_iCountFrames < TEST_MAX_FRAMES) )
+      {
+         s_Frames[s_iCountFrames].uOffset = uFrameStart;
+         s_Frames[s_iCountFrames].uLength = uNALStart - uFrameStart;
+         s_iCountFrames++;
+         uFrameStart = uNALStart;
+         bFrameHasVCL = false;
+      }
+      if ( _is_vcl_nal(s_pStream[u+3], bH265) )
+         bFrameHasVCL = true;
+      u += 2;
+   }
+   if ( (uFrameStart < s_uStreamSize) && (s_iCountFrames < TEST_MAX_FRAMES) )
+   {
+      s_Frames[s_iCountFrames].uOffset = uFrameStart;
+      s_Frames[s_iCountFrames].uLength = s_uStreamSize - uFrameStart;
+      s_iCountFrames++;
+   }
+}
+
+// H264 like stream: SPS+PPS+IDR every 30 frames (about 60 KB), P frames of 4-16 KB
+static void _generate_stream(int iCountFrames)
+{
+   s_uStreamSize = 0;
+   s_pStream = (u8*)malloc(iCountFrames * 70000);
+   u32 uRand = 12345;
+   for( int i=0; i<iCountFrames; i++ )
+   {
+      u32 uSize = 4000 + ((uRand >> 8) % 12000);
+      u8 uType = 1;
+      if ( (i % 30) == 0 )
+      {
+         u8 uParams[] = { 0,0,0,1,0x67,0x42,0x00,0x1F, 0,0,0,1,0x68,0xCE,0x3C,0x80 };
+         memcpy(&s_pStream[s_uStreamSize], uParams, sizeof(uParams));
+         s_uStreamSize += sizeof(uParams);
+         uSize = 60000;
+         uType = 5;
+      }
+      s_pStream[s_uStreamSize++] = 0;
+      s_pStream[s_uStreamSize++] = 0;
+      s_pStream[s_uStreamSize++] = 0;
+      s_pStream[s_uStreamSize++] = 1;
+      s_pStream[s_uStreamSize++] = 0x60 | uType;
+      for( u32 u=0; u<uSize; u++ )
+      {
+         uRand = uRand * 1103515245 + 12345;
+         u8 uByte = (u8)(uRand >> 16);
+         // No start codes in the payload
+         if ( (u >= 2) && (s_pStream[s_uStreamSize-1] == 0) && (s_pStream[s_uStreamSize-2] == 0) && (uByte <= 3) )
+            uByte = 0x55;
+         s_pStream[s_uStreamSize++] = uByte;
+      }
+   }
+}
+
+static bool _load_stream(const char* szFile)
+{
+   FILE* fd = fopen(szFile, "rb");
+   if ( NULL == fd )
+      return false;
+   fseek(fd, 0, SEEK_END);
+   long lSize = ftell(fd);
+   fseek(fd, 0, SEEK_SET);
+   s_pStream = (u8*)malloc(lSize+1);
+   s_uStreamSize = (u32)fread(s_pStream, 1, lSize, fd);
+   fclose(fd);
+   return (s_uStreamSize > 0);
+}
+
+static void _run_producer(type_video_frame_ring* pRing, int iCountFrames, int iFPS)
+{
+   u64 uTimeStart = video_frame_ring_get_time_micros();
+   for( int i=0; i<iCountFrames; i++ )
+   {
+      if ( iFPS > 0 )
+      {
+         u64 uTimeFrame = uTimeStart + (u64)i * 1000000LL / (u64)iFPS;
+         u64 uTimeNow = video_frame_ring_get_time_micros();
+         if ( uTimeFrame > uTimeNow )
+            hardware_sleep_micros((u32)(uTimeFrame - uTimeNow));
+      }
+      type_test_frame* pFrame = &s_Frames[i % s_iCountFrames];
+      u32 uPos = 0;
+      while ( uPos < pFrame->uLength )
+      {
+         u32 uSize = pFrame->uLength - uPos;
+         if ( uSize > TEST_PACKET_SIZE )
+            uSize = TEST_PACKET_SIZE;
+         video_frame_ring_write(pRing, &s_pStream[pFrame->uOffset + uPos], uSize);
+         uPos += uSize;
+      }
+      u32 uIndex = (u32)i;
+      video_frame_ring_write(pRing, (u8*)&uIndex, sizeof(u32));
+      video_frame_ring_publish(pRing, VIDEO_FRAME_RING_FLAG_NAL_END);
+   }
+}
+
+static int _compare_u32(const void* p1, const void* p2)
+{
+   u32 u1 = *(const u32*)p1;
+   u32 u2 = *(const u32*)p2;
+   return (u1 < u2)?-1:((u1 > u2)?1:0);
+}
+
+static void _print_percentiles(const char* szName, u32* pValues, int iCount)
+{
+   if ( iCount <= 0 )
+      return;
+   qsort(pValues, iCount, sizeof(u32), _compare_u32);
+   printf("   %-28s p50: %6u us, p90: %6u us, p99: %6u us, max: %6u us\n", szName,
+      pValues[iCount/2], pValues[(iCount*90)/100], pValues[(iCount*99)/100], pValues[iCount-1]);
+}
+
+// Returns the number of frames consumed
+static int _run_pass(const char* szName, int iCountFrames, int iFPS, u32 uHoldMicros, bool bPrintLatencies)
+{
+   type_video_frame_ring ringProducer;
+   type_video_frame_ring ringConsumer;
+   if ( (! video_frame_ring_create(&ringProducer, TEST_RING_NAME)) || (! video_frame_ring_open(&ringConsumer, TEST_RING_NAME)) )
+   {
+      _check(false, "create and open the ring");
+      return 0;
+   }
+
+   printf("\n%s: %d frames, %s, consumer holds each frame %u us\n", szName, iCountFrames, (iFPS > 0)?"paced":"producer as fast as possible", uHoldMicros);
+
+   pid_t pid = fork();
+   if ( 0 == pid )
+   {
+      _run_producer(&ringProducer, iCountFrames, iFPS);
+      _exit(0);
+   }
+
+   u32* pHandoff = (u32*)malloc(iCountFrames * sizeof(u32));
+   u32* pFromFirstData = (u32*)malloc(iCountFrames * sizeof(u32));
+   int iConsumed = 0;
+   int iBadFrames = 0;
+   u64 uConsumedBytes = 0;
+   bool bProducerDone = false;
+   type_video_frame_ring_frame frame;
+
+   while ( 1 )
+   {
+      if ( ! video_frame_ring_acquire(&ringConsumer, 20000, &frame) )
+      {
+         if ( bProducerDone )
+            break;
+         int iStatus = 0;
+         if ( waitpid(pid, &iStatus, WNOHANG) == pid )
+            bProducerDone = true;
+         continue;
+      }
+      u64 uTimeNow = video_frame_ring_get_time_micros();
+      if ( iConsumed < iCountFrames )
+      {
+         pHandoff[iConsumed] = (u32)(uTimeNow - frame.uTimePublishedMicros);
+         pFromFirstData[iConsumed] = (u32)(uTimeNow - frame.uTimeFirstDataMicros);
+      }
+
+      u32 uIndex = 0;
+      bool bValid = (frame.uLength > sizeof(u32)) && (frame.uFlags & VIDEO_FRAME_RING_FLAG_NAL_END);
+      if ( bValid )
+      {
+         memcpy(&uIndex, frame.pData + frame.uLength - sizeof(u32), sizeof(u32));
+         bValid = (uIndex < (u32)iCountFrames);
+      }
+      if ( bValid )
+      {
+         type_test_frame* pTestFrame = &s_Frames[uIndex % s_iCountFrames];
+         bValid = (frame.uLength == pTestFrame->uLength + sizeof(u32)) &&
+                  (base_compute_crc32(frame.pData, (int)pTestFrame->uLength) == pTestFrame->uCRC);
+      }
+      // Data must stay the same while the frame is referenced (the decoder reads it)
+      if ( bValid && (uHoldMicros > 0) )
+      {
+         u32 uCRC = base_compute_crc32(frame.pData, (int)frame.uLength);
+         hardware_sleep_micros(uHoldMicros);
+         bValid = (uCRC == base_compute_crc32(frame.pData, (int)frame.uLength));
+      }
+      if ( ! bValid )
+         iBadFrames++;
+      uConsumedBytes += frame.uLength;
+      iConsumed++;
+      video_frame_ring_release(&ringConsumer, &frame);
+   }
+   if ( ! bProducerDone )
+      waitpid(pid, NULL, 0);
+
+   type_video_frame_ring_header* pHeader = ringConsumer.pHeader;
+   u32 uPublished = pHeader->uTotalFramesPublished;
+   u32 uDropped = pHeader->uTotalFramesDropped;
+   u32 uSkipped = pHeader->uTotalFramesSkipped;
+   printf("   frames published: %u, dropped by the producer: %u, consumed: %d, skipped (reclaimed before read): %u\n", uPublished, uDropped, iConsumed, uSkipped);
+
+   // Router to decoder input: the router copy into the ring plus the partial frames moved at the ring end;
+   // the consumer copies nothing (the decoder input packet points to the ring data)
+   double fCopiesPerByte = 0.0;
+   if ( pHeader->uTotalBytesPublished > 0 )
+      fCopiesPerByte = (double)((u64)pHeader->uTotalBytesPublished + (u64)pHeader->uTotalBytesMoved) / (double)pHeader->uTotalBytesPublished;
+   printf("   bytes published: %u, moved: %u, consumed: %llu, copies per byte: %.3f (byte ring: 2.000)\n",
+      pHeader->uTotalBytesPublished, pHeader->uTotalBytesMoved, (unsigned long long)uConsumedBytes, fCopiesPerByte);
+
+   char szMessage[256];
+   snprintf(szMessage, sizeof(szMessage), "%s: %d bad or overwritten frames", szName, iBadFrames);
+   _check(0 == iBadFrames, szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: all frames accounted for (published + dropped)", szName);
+   _check(uPublished + uDropped == (u32)iCountFrames, szMessage);
+   snprintf(szMessage, sizeof(szMessage), "%s: all published frames consumed or skipped", szName);
+   _check((u32)iConsumed + uSkipped == uPublished, szMessage);
+
+   if ( bPrintLatencies )
+   {
+      int iCount = (iConsumed < iCountFrames)?iConsumed:iCountFrames;
+      _print_percentiles("handoff (publish to read):", pHandoff, iCount);
+      _print_percentiles("first data written to read:", pFromFirstData, iCount);
+   }
+   free(pHandoff);
+   free(pFromFirstData);
+
+   video_frame_ring_close(&ringConsumer);
+   video_frame_ring_close(&ringProducer);
+   shm_unlink(TEST_RING_NAME);
+   return iConsumed;
+}
+
+// Single process: a referenced frame is never overwritten, the producer drops frames instead
+static void _test_referenced_frame()
+{
+   type_video_frame_ring ringProducer;
+   type_video_frame_ring ringConsumer;
+   if ( (! video_frame_ring_create(&ringProducer, TEST_RING_NAME)) || (! video_frame_ring_open(&ringConsumer, TEST_RING_NAME)) )
+   {
+      _check(false, "create and open the ring");
+      return;
+   }
+   type_video_frame_ring_frame frame;
+   _check(0 == video_frame_ring_acquire(&ringConsumer, 2000, &frame), "no frame to acquire on an empty ring");
+
+   static u8 s_uBuffer[100000];
+   for( int i=0; i<(int)sizeof(s_uBuffer); i++ )
+      s_uBuffer[i] = (u8)i;
+   video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+   _check(1 == video_frame_ring_publish(&ringProducer, 0), "publish a frame");
+   _check(1 == video_frame_ring_acquire(&ringConsumer, 0, &frame), "acquire the published frame");
+   u32 uCRC = base_compute_crc32(frame.pData, (int)frame.uLength);
+
+   int iPublished = 0;
+   for( int i=0; i<2*VIDEO_FRAME_RING_MAX_FRAMES; i++ )
+   {
+      memset(s_uBuffer, i, sizeof(s_uBuffer));
+      video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+      iPublished += video_frame_ring_publish(&ringProducer, 0);
+   }
+   _check(iPublished < 2*VIDEO_FRAME_RING_MAX_FRAMES, "producer drops frames while the oldest frame is referenced");
+   _check(uCRC == base_compute_crc32(frame.pData, (int)frame.uLength), "referenced frame not overwritten");
+   video_frame_ring_release(&ringConsumer, &frame);
+
+   // Frames published before the drops are intact; the first one after them has the discontinuity flag
+   memset(s_uBuffer, 0xAA, sizeof(s_uBuffer));
+   video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+   _check(1 == video_frame_ring_publish(&ringProducer, 0), "publish after the referenced frame was released");
+   int iRead = 0;
+   bool bIntact = true;
+   while ( video_frame_ring_acquire(&ringConsumer, 0, &frame) )
+   {
+      iRead++;
+      if ( (frame.pData[0] != (u8)(iRead-1)) && (iRead < iPublished + 1) )
+         bIntact = false;
+      if ( iRead == iPublished + 1 )
+      {
+         _check(frame.pData[0] == 0xAA, "last published frame content");
+         _check(frame.uFlags & VIDEO_FRAME_RING_FLAG_DISCONTINUITY, "discontinuity flag after dropped frames");
+      }
+      video_frame_ring_release(&ringConsumer, &frame);
+   }
+   _check(bIntact, "published frames intact after the drops");
+   _check(iRead == iPublished + 1, "all published frames read");
+
+   // Consumer not reading: the producer reclaims unread frames, the consumer skips them
+   for( int i=0; i<2*VIDEO_FRAME_RING_MAX_FRAMES; i++ )
+   {
+      video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+      video_frame_ring_publish(&ringProducer, 0);
+   }
+   _check(1 == video_frame_ring_acquire(&ringConsumer, 0, &frame), "acquire after the producer reclaimed unread frames");
+   _check(frame.uSkippedBefore > 0, "reclaimed frames reported as skipped");
+   video_frame_ring_release(&ringConsumer, &frame);
+
+   video_frame_ring_close(&ringConsumer);
+   video_frame_ring_close(&ringProducer);
+   shm_unlink(TEST_RING_NAME);
+}
+
+// A player killed while it holds a frame leaves the frame referenced: the producer can not reclaim it
+// and drops all new frames until the next consumer opens the ring and drops the stale references
+static void _test_consumer_killed()
+{
+   type_video_frame_ring ringProducer;
+   if ( ! video_frame_ring_create(&ringProducer, TEST_RING_NAME) )
+   {
+      _check(false, "create the ring");
+      return;
+   }
+   int pipeFd[2];
+   if ( 0 != pipe(pipeFd) )
+   {
+      _check(false, "create the pipe");
+      video_frame_ring_close(&ringProducer);
+      shm_unlink(TEST_RING_NAME);
+      return;
+   }
+
+   pid_t pid = fork();
+   if ( 0 == pid )
+   {
+      // Consumer: acquires a frame and waits to be killed while holding it
+      close(pipeFd[0]);
+      type_video_frame_ring ringConsumer;
+      type_video_frame_ring_frame frame;
+      u8 uResult = video_frame_ring_open(&ringConsumer, TEST_RING_NAME)?1:0;
+      if ( write(pipeFd[1], &uResult, 1) != 1 )
+         _exit(1);
+      uResult = (uResult && video_frame_ring_acquire(&ringConsumer, 2000000, &frame))?1:0;
+      if ( write(pipeFd[1], &uResult, 1) != 1 )
+         _exit(1);
+      while ( 1 )
+         hardware_sleep_ms(100);
+   }
+   close(pipeFd[1]);
+
+   static u8 s_uBuffer[100000];
+   memset(s_uBuffer, 0x55, sizeof(s_uBuffer));
+   // Wait for the consumer to open the ring, then publish the frame it acquires
+   u8 uResult = 0;
+   if ( read(pipeFd[0], &uResult, 1) != 1 )
+      uResult = 0;
+   video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+   video_frame_ring_publish(&ringProducer, 0);
+   if ( (1 != uResult) || (read(pipeFd[0], &uResult, 1) != 1) )
+      uResult = 0;
+   close(pipeFd[0]);
+   _check(1 == uResult, "killed consumer acquired a frame");
+   kill(pid, SIGKILL);
+   waitpid(pid, NULL, 0);
+
+   int iPublished = 0;
+   for( int i=0; i<2*VIDEO_FRAME_RING_MAX_FRAMES; i++ )
+   {
+      video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+      iPublished += video_frame_ring_publish(&ringProducer, 0);
+   }
+   _check(iPublished < 2*VIDEO_FRAME_RING_MAX_FRAMES, "producer drops frames while the killed consumer holds a frame");
+
+   // New consumer: the stale reference is dropped, the producer reclaims frames again
+   type_video_frame_ring ringConsumer;
+   if ( ! video_frame_ring_open(&ringConsumer, TEST_RING_NAME) )
+   {
+      _check(false, "open the ring again");
+      video_frame_ring_close(&ringProducer);
+      shm_unlink(TEST_RING_NAME);
+      return;
+   }
+   iPublished = 0;
+   for( int i=0; i<2*VIDEO_FRAME_RING_MAX_FRAMES; i++ )
+   {
+      video_frame_ring_write(&ringProducer, s_uBuffer, sizeof(s_uBuffer));
+      iPublished += video_frame_ring_publish(&ringProducer, 0);
+   }
+   _check(iPublished == 2*VIDEO_FRAME_RING_MAX_FRAMES, "producer publishes all frames after a new consumer opened the ring");
+
+   type_video_frame_ring_frame frame;
+   _check(1 == video_frame_ring_acquire(&ringConsumer, 0, &frame), "new consumer acquires a frame");
+   video_frame_ring_release(&ringConsumer, &frame);
+
+   video_frame_ring_close(&ringConsumer);
+   video_frame_ring_close(&ringProducer);
+   shm_unlink(TEST_RING_NAME);
+}
+
+int main(int argc, char *argv[])
+{
+   const char* szFile = NULL;
+   bool bH265 = false;
+   int iCountFrames = 600;
+   int iFPS = 60;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-file")) && (i < argc-1) )
+         szFile = argv[++i];
+      else if ( 0 == strcmp(argv[i], "-h265") )
+         bH265 = true;
+      else if ( (0 == strcmp(argv[i], "-frames")) && (i < argc-1) )
+         iCountFrames = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-fps")) && (i < argc-1) )
+         iFPS = atoi(argv[++i]);
+      else
+      {
+         printf("Usage: %s [-file stream.h264] [-h265] [-frames N] [-fps N]\n", argv[0]);
+         return 0;
+      }
+   }
+   if ( iCountFrames < 10 )
+      iCountFrames = 10;
+   if ( iCountFrames > TEST_MAX_FRAMES )
+      iCountFrames = TEST_MAX_FRAMES;
+   if ( iFPS < 1 )
+      iFPS = 1;
+
+   printf("\nTesting the SM video frames ring...\n");
+   log_disable();
+
+   if ( NULL != szFile )
+   {
+      if ( ! _load_stream(szFile) )
+      {
+         printf("Failed to read stream file %s\n", szFile);
+         return 1;
+      }
+      _split_stream_in_frames(bH265);
+   }
+   else
+   {
+      _generate_stream(300);
+      _split_stream_in_frames(false);
+   }
+   for( int i=0; i<s_iCountFrames; i++ )
+   {
+      if ( s_Frames[i].uLength + sizeof(u32) > VIDEO_FRAME_RING_MAX_FRAME_SIZE )
+         s_Frames[i].uLength = VIDEO_FRAME_RING_MAX_FRAME_SIZE - sizeof(u32);
+      s_Frames[i].uCRC = base_compute_crc32(&s_pStream[s_Frames[i].uOffset], (int)s_Frames[i].uLength);
+   }
+   printf("Stream: %u bytes, %d frames%s\n", s_uStreamSize, s_iCountFrames, (NULL == szFile)?" (generated)":"");
+   if ( s_iCountFrames < 1 )
+   {
+      printf("No frames in the stream.\n");
+      return 1;
+   }
+
+   _test_referenced_frame();
+   _test_consumer_killed();
+   _run_pass("Paced stream", iCountFrames, iFPS, 0, true);
+   _run_pass("Fast producer, slow consumer", iCountFrames*4, 0, 500, false);
+
+   free(s_pStream);
+   if ( s_iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
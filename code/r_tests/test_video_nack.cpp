@@ -0,0 +1,575 @@
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/models.h"
+#include "../base/controller_rt_info.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/radio_link_sim.h"
+#include "../radio/fec.h"
+#include "../radio/video_nack.h"
+#include "../r_station/video_rx_buffers.h"
+#include "video_link_fixture.h"
+
+// Tests the retransmission requests scheduler (video_nack): RTT estimation from request/response pairs,
+// requests timeouts, playout deadline, coalesced requests encoding and the requests build/parse. Then runs a
+// video stream over the radio link simulator (lossy downlink and uplink, with delay), the station selecting and
+// encoding the requests with the station code and the vehicle parsing them with the vehicle code: as before (a
+// request each few ms for all the missing packets, one entry per packet) and with the scheduler (packets in flight
+// not requested again until their RTO, coalesced requests). Reports the uplink bytes per recovered packet,
+// the packets resent by the vehicle and the recovery rate.
+//
+// Usage: test_video_nack [-seconds N] [-port base_udp_port] [-link "params"] [-uplink "params"]
+
+#define TEST_HISTORY_BLOCKS 256
+#define TEST_BLOCK_DATA_PACKETS 8
+#define TEST_BLOCK_EC_PACKETS 2
+#define TEST_BLOCK_PACKET_SIZE 400
+#define TEST_BLOCK_INTERVAL_MICROS 4000
+#define TEST_WINDOW_MS 100
+#define TEST_LEGACY_MIN_INTERVAL_MS 5
+#define TEST_LEGACY_MAX_INTERVAL_MS 10
+#define TEST_TOP_BLOCK_GAP_MS 5
+
+typedef struct
+{
+   u8 uPackets[MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_TOTAL_SIZE];
+   int iPacketsLength[MAX_TOTAL_PACKETS_IN_BLOCK];
+   u32 uBlockIndex;
+} type_test_sent_block;
+
+typedef struct
+{
+   int bNack;
+   type_video_nack_state nack;
+   u32 uNextRequestId;
+   u32 uLastRequestTime;
+   u32 uRequestInterval;
+
+   u32 uBlocksSent;
+   u32 uRequests;
+   u32 uRequestedPackets;
+   u32 uVehicleRequestedPackets; // as parsed by the vehicle
+   u32 uInvalidRequests;
+   u64 uUplinkBytes;
+   u32 uResentPackets;
+   u32 uRecoveredPackets; // retransmitted packets added to the rx buffer
+   u32 uBlocksRecovered; // output blocks with retransmitted packets
+   u32 uBlocksLost;
+   type_radio_link_sim_stats statsDownlink;
+   type_radio_link_sim_stats statsUplink;
+} type_test_run;
+
+static type_test_sent_block* s_pSentBlocks = NULL;
+static u32 s_uNextBlockIndex = 0;
+static u32 s_uNextStreamPacketIndex = 0;
+static int s_iFailures = 0;
+
+static void _check(int iOk, const char* szWhat)
+{
+   if ( ! iOk )
+   {
+      printf("  FAILED: %s\n", szWhat);
+      s_iFailures++;
+   }
+}
+
+//------------------------------------------------------------
+// Scheduler checks
+
+static void _test_rtt_estimator()
+{
+   type_video_nack_state state;
+   video_nack_init(&state);
+   _check(video_nack_get_srtt_ms(&state) == VIDEO_NACK_DEFAULT_RTT_MS, "default RTT");
+   _check(video_nack_get_rto_ms(&state) == 3*VIDEO_NACK_DEFAULT_RTT_MS, "default RTO");
+
+   // 30 ms round trips, then a larger one
+   u32 uTime = 1000;
+   for( u32 u=1; u<=20; u++ )
+   {
+      video_nack_on_request_sent(&state, u, uTime, 1, 20);
+      _check(video_nack_on_response(&state, u, uTime + 30) == 30, "RTT sample");
+      _check(video_nack_on_response(&state, u, uTime + 31) == -1, "only the first response is a sample");
+      uTime += 50;
+   }
+   _check(video_nack_on_response(&state, 100, uTime) == -1, "unknown request id");
+   _check(video_nack_get_srtt_ms(&state) == 30, "smoothed RTT");
+   _check((video_nack_get_rto_ms(&state) >= 30) && (video_nack_get_rto_ms(&state) <= 35), "RTO on a stable RTT");
+   video_nack_on_request_sent(&state, 21, uTime, 1, 20);
+   video_nack_on_response(&state, 21, uTime + 110);
+   _check((video_nack_get_srtt_ms(&state) > 30) && (video_nack_get_rto_ms(&state) > 60), "RTO after a late response");
+
+   // Responses to older requests still in flight
+   video_nack_on_request_sent(&state, 22, uTime, 1, 20);
+   video_nack_on_request_sent(&state, 23, uTime + 5, 1, 20);
+   _check(video_nack_on_response(&state, 22, uTime + 40) == 40, "response to an older request in flight");
+   _check(video_nack_on_response(&state, 23, uTime + 41) == 36, "response to the newest request");
+   printf("RTT estimator: srtt %u ms, rto %u ms, %u samples (min %u, max %u ms)\n",
+      video_nack_get_srtt_ms(&state), video_nack_get_rto_ms(&state), state.uCountSamples, state.uMinSampleMs, state.uMaxSampleMs);
+}
+
+static void _test_in_flight_and_deadline()
+{
+   type_video_nack_state state;
+   video_nack_init(&state);
+   u32 uTime = 5000;
+   video_nack_on_request_sent(&state, 1, uTime - 30, 1, 20);
+   video_nack_on_response(&state, 1, uTime);
+   u32 uRTO = video_nack_get_rto_ms(&state);
+
+   u32 uRequestedTimes[MAX_TOTAL_PACKETS_IN_BLOCK];
+   memset(uRequestedTimes, 0, sizeof(uRequestedTimes));
+   uRequestedTimes[1] = uTime - uRTO + 1; // in flight
+   uRequestedTimes[2] = uTime - uRTO; // timed out
+   u32 uMissing = 0x0F;
+   u32 uRequested = 0x06;
+   _check(video_nack_get_packets_to_request(&state, uMissing, uRequested, uRequestedTimes, 0, uTime) == 0x0D, "in flight packets not requested again");
+   _check(state.uCountSuppressedPackets == 1, "suppressed packets count");
+
+   // A retry after the RTO would come past the deadline: retried halfway to the last useful time (deadline - srtt - rttvar)
+   u32 uDeadline = uTime + 50;
+   _check(video_nack_get_packets_to_request(&state, 0x02, 0x02, uRequestedTimes, uDeadline, uTime) == 0, "in flight packet before its last useful retry");
+   _check(video_nack_get_packets_to_request(&state, 0x02, 0x02, uRequestedTimes, uDeadline, uTime + 5) == 0x02, "in flight packet retried before its deadline");
+
+   // Block discarded at block time + 100 ms, the response comes in a RTT
+   _check(! video_nack_is_past_deadline(&state, 11, uTime - 60, 100, uTime), "block before its deadline");
+   _check(video_nack_is_past_deadline(&state, 10, uTime - 80, 100, uTime), "block past its deadline");
+   _check(! video_nack_is_past_deadline(&state, 12, 0, 100, uTime), "block never received");
+   _check(video_nack_is_past_deadline(&state, 10, uTime - 80, 100, uTime + 10), "block still past its deadline");
+   _check(video_nack_is_past_deadline(&state, 11, uTime - 60, 100, uTime + 40), "next block past its deadline");
+   _check(state.uCountSkippedBlocks == 2, "skipped blocks counted once");
+   printf("Requests timeouts and deadlines: rto %u ms\n", uRTO);
+}
+
+static void _test_coalesced_encoding()
+{
+   u32 uBlocks[4] = { 1000, 1001, 1200, 1256 };
+   u32 uMasks[4] = { 0x05, VIDEO_NACK_MASK_FULL_BLOCK, 0x80000000, 0x01 };
+   u8 uBuffer[64];
+   int iLength = 0;
+   int iCount = video_nack_encode_blocks(uBuffer, uBlocks, uMasks, 4, &iLength);
+   _check((3 == iCount) && (iLength == (int)sizeof(u32) + 3*5), "encoded blocks stop at the first block too far");
+
+   u32 uBlocksOut[4];
+   u32 uMasksOut[4];
+   _check(video_nack_decode_blocks(uBuffer, iLength, 3, uBlocksOut, uMasksOut) == 3, "decoded blocks");
+   for( int i=0; i<3; i++ )
+      _check((uBlocksOut[i] == uBlocks[i]) && (uMasksOut[i] == uMasks[i]), "decoded block and mask");
+   _check(video_nack_decode_blocks(uBuffer, iLength-1, 3, uBlocksOut, uMasksOut) == -1, "truncated request");
+   _check(video_nack_count_requests(uMasksOut, 3) == 4, "full block request counts as one request");
+   printf("Coalesced requests: 3 blocks (3 packets + 1 full block) in %d bytes (%d bytes as individual entries)\n",
+      iLength, (3+1)*(int)(sizeof(u32)+sizeof(u8)));
+}
+
+// Same blocks masks from the individual entries and the coalesced requests, as the station builds them
+static void _test_request_build_parse()
+{
+   u32 uBlocks[3] = { 70, 71, 75 };
+   u32 uMasks[3] = { 0x0A, VIDEO_NACK_MASK_FULL_BLOCK, 0x01 };
+   u8 uLegacy[128];
+   u8 uCoalesced[128];
+   int iLegacyLength = video_nack_build_request(uLegacy, 7, 1, VIDEO_NACK_FLAG_COALESCED | 0x01, uBlocks, uMasks, 3, 0);
+   int iCoalescedLength = video_nack_build_request(uCoalesced, 8, 1, 0x01, uBlocks, uMasks, 3, 1);
+   _check(iLegacyLength == (int)(sizeof(u32) + 3*sizeof(u8)) + 4*(int)(sizeof(u32) + sizeof(u8)), "individual entries request length");
+   _check(iCoalescedLength == (int)(sizeof(u32) + 3*sizeof(u8) + sizeof(u32)) + 3*(int)(sizeof(u8) + sizeof(u32)), "coalesced request length");
+
+   type_video_nack_request legacy;
+   type_video_nack_request coalesced;
+   _check(video_nack_parse_request(uLegacy, iLegacyLength, &legacy) == iLegacyLength, "individual entries request parsed");
+   _check(video_nack_parse_request(uCoalesced, iCoalescedLength, &coalesced) == iCoalescedLength, "coalesced request parsed");
+   _check((7 == legacy.uRequestId) && (1 == legacy.uVideoStreamIndex) && (0x01 == legacy.uFlags) && (4 == legacy.iCountEntries), "individual entries request header");
+   _check((8 == coalesced.uRequestId) && ((0x01 | VIDEO_NACK_FLAG_COALESCED) == coalesced.uFlags) && (3 == coalesced.iCountEntries), "coalesced request header");
+   _check((3 == legacy.iCountBlocks) && (3 == coalesced.iCountBlocks), "requested blocks");
+   for( int i=0; i<3; i++ )
+   {
+      _check((legacy.uBlockIndexes[i] == uBlocks[i]) && (legacy.uMasks[i] == uMasks[i]), "individual entries block and mask");
+      _check((coalesced.uBlockIndexes[i] == uBlocks[i]) && (coalesced.uMasks[i] == uMasks[i]), "coalesced block and mask");
+   }
+   _check(video_nack_count_requests(legacy.uMasks, legacy.iCountBlocks) == legacy.iCountEntries, "packets count of the individual entries");
+   _check(video_nack_parse_request(uLegacy, iLegacyLength-1, &legacy) == -1, "truncated individual entries request");
+   printf("Requests build/parse: %d bytes as individual entries, %d bytes coalesced\n", iLegacyLength, iCoalescedLength);
+}
+
+//------------------------------------------------------------
+// Vehicle side
+
+// A block per frame, EC encoded
+static void _vehicle_send_block()
+{
+   type_test_sent_block* pBlock = &s_pSentBlocks[s_uNextBlockIndex % TEST_HISTORY_BLOCKS];
+   pBlock->uBlockIndex = s_uNextBlockIndex;
+   int iHeadersSize = (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   int iVideoDataSize = TEST_BLOCK_PACKET_SIZE - (int)sizeof(t_packet_header_video_segment_important);
+
+   for( int k=0; k<TEST_BLOCK_DATA_PACKETS + TEST_BLOCK_EC_PACKETS; k++ )
+   {
+      u8* pPacket = pBlock->uPackets[k];
+      memset(pPacket, 0, iHeadersSize + TEST_BLOCK_PACKET_SIZE);
+      video_fixture_set_packet_headers(pPacket, 0, s_uNextBlockIndex, k, TEST_BLOCK_DATA_PACKETS, TEST_BLOCK_EC_PACKETS, TEST_BLOCK_PACKET_SIZE,
+         (u16)s_uNextBlockIndex, TEST_BLOCK_DATA_PACKETS, (k < TEST_BLOCK_DATA_PACKETS)?k:(TEST_BLOCK_DATA_PACKETS-1), s_uNextStreamPacketIndex++);
+      if ( k >= TEST_BLOCK_DATA_PACKETS )
+         continue;
+      t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(pPacket + iHeadersSize);
+      pPHVSImp->uVideoDataLength = (u16)iVideoDataSize;
+      u8* pVideoData = pPacket + iHeadersSize + sizeof(t_packet_header_video_segment_important);
+      for( int i=0; i<iVideoDataSize; i++ )
+         pVideoData[i] = (u8)(s_uNextBlockIndex + k + i);
+   }
+   video_fixture_encode_block(pBlock->uPackets, pBlock->iPacketsLength, TEST_BLOCK_DATA_PACKETS, TEST_BLOCK_EC_PACKETS, TEST_BLOCK_PACKET_SIZE);
+
+   for( int k=0; k<TEST_BLOCK_DATA_PACKETS + TEST_BLOCK_EC_PACKETS; k++ )
+      video_fixture_send_packet(true, pBlock->uPackets[k], pBlock->iPacketsLength[k]);
+   s_uNextBlockIndex++;
+}
+
+static void _vehicle_resend_packet(type_test_run* pRun, u32 uRequestId, u32 uBlockIndex, u32 uPacketIndex)
+{
+   type_test_sent_block* pBlock = &s_pSentBlocks[uBlockIndex % TEST_HISTORY_BLOCKS];
+   if ( (pBlock->uBlockIndex != uBlockIndex) || (uBlockIndex >= s_uNextBlockIndex) )
+      return;
+   if ( 0xFF == uPacketIndex )
+   {
+      for( u32 k=0; k<TEST_BLOCK_DATA_PACKETS; k++ )
+         _vehicle_resend_packet(pRun, uRequestId, uBlockIndex, k);
+      return;
+   }
+   if ( uPacketIndex >= TEST_BLOCK_DATA_PACKETS + TEST_BLOCK_EC_PACKETS )
+      return;
+
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+   memcpy(uPacket, pBlock->uPackets[uPacketIndex], pBlock->iPacketsLength[uPacketIndex]);
+   t_packet_header* pPH = (t_packet_header*)uPacket;
+   t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(uPacket + sizeof(t_packet_header));
+   pPH->packet_flags |= PACKET_FLAGS_BIT_RETRANSMITED;
+   pPHVS->uStreamInfoFlags = VIDEO_STREAM_INFO_FLAG_RETRANSMISSION_ID;
+   pPHVS->uStreamInfo = uRequestId;
+   video_fixture_send_packet(true, uPacket, pBlock->iPacketsLength[uPacketIndex]);
+   pRun->uResentPackets++;
+}
+
+// Resends the requested packets as the vehicle does, from the parsed request
+static void _vehicle_on_packet(u8* pPacket, int iLength, void* pContext)
+{
+   type_test_run* pRun = (type_test_run*)pContext;
+   if ( ((t_packet_header*)pPacket)->packet_type != PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS )
+      return;
+   type_video_nack_request request;
+   if ( video_nack_parse_request(pPacket + sizeof(t_packet_header), iLength - (int)sizeof(t_packet_header), &request) < 0 )
+   {
+      pRun->uInvalidRequests++;
+      return;
+   }
+   pRun->uVehicleRequestedPackets += (u32)video_nack_count_requests(request.uMasks, request.iCountBlocks);
+   for( int i=0; i<request.iCountBlocks; i++ )
+   {
+      if ( VIDEO_NACK_MASK_FULL_BLOCK == request.uMasks[i] )
+      {
+         _vehicle_resend_packet(pRun, request.uRequestId, request.uBlockIndexes[i], 0xFF);
+         continue;
+      }
+      for( u32 uMask = request.uMasks[i]; 0 != uMask; uMask &= uMask - 1 )
+         _vehicle_resend_packet(pRun, request.uRequestId, request.uBlockIndexes[i], (u32)__builtin_ctz(uMask));
+   }
+}
+
+//------------------------------------------------------------
+// Station side
+
+static void _station_output_packet(type_rx_video_block_info* pBlock, type_rx_video_packet_info* pPacket, void* pContext)
+{
+   type_test_run* pRun = (type_test_run*)pContext;
+   if ( (pPacket->pPHVS->uCurrentBlockPacketIndex == pBlock->iBlockDataPackets-1) && video_fixture_block_has_retransmitted_packets(pBlock) )
+      pRun->uBlocksRecovered++;
+}
+
+// Incomplete bottom block, discarded at the end of the retransmission window
+static bool _station_can_discard_block(VideoRxPacketsBuffer* pRxBuffer, type_rx_video_block_info* pBlock, void* pContext)
+{
+   return (0 != pBlock->uReceivedTime) && (g_TimeNow >= pBlock->uReceivedTime + TEST_WINDOW_MS);
+}
+
+static void _station_output_available_packets(type_test_run* pRun, VideoRxPacketsBuffer* pRxBuffer)
+{
+   pRun->uBlocksLost += (u32)video_fixture_output_available_packets(pRxBuffer, _station_output_packet, _station_can_discard_block, pRun);
+}
+
+// Same selection of missing packets as the station processor: the packets the EC packets can not
+// recover, from all the blocks but the top one (requested once no packet of it came for a few ms).
+// Before: all of them on each request (a request each 5 to 10 ms), one entry per packet.
+// Scheduler: packets in flight are not requested again until their RTO, blocks past their deadline are skipped, coalesced requests.
+static void _station_request_missing_packets(type_test_run* pRun, VideoRxPacketsBuffer* pRxBuffer)
+{
+   int iCountBlocks = pRxBuffer->getCountBlocksInBuffer();
+   if ( 0 == iCountBlocks )
+      return;
+   if ( g_TimeNow < pRun->uLastRequestTime + pRun->uRequestInterval )
+      return;
+   if ( g_TimeNow >= pRun->uLastRequestTime + TEST_WINDOW_MS )
+      pRun->uRequestInterval = TEST_LEGACY_MIN_INTERVAL_MS;
+
+   u32 uBlockIndexes[MAX_RXTX_BLOCKS_BUFFER];
+   u32 uMasks[MAX_RXTX_BLOCKS_BUFFER];
+   int iCountRequestedBlocks = 0;
+   int iCountRequested = 0;
+   bool bReRequested = false;
+
+   for( int i=0; (i<iCountBlocks) && (iCountRequested < DEFAULT_VIDEO_RETRANS_MAX_PCOUNT); i++ )
+   {
+      type_rx_video_block_info* pBlock = pRxBuffer->getBlockInBufferFromBottom(i);
+      if ( (i == iCountBlocks-1) && (g_TimeNow < pBlock->uReceivedTime + TEST_TOP_BLOCK_GAP_MS) )
+         break;
+      if ( pRun->bNack && video_nack_is_past_deadline(&pRun->nack, pBlock->uVideoBlockIndex, pBlock->uReceivedTime, TEST_WINDOW_MS, g_TimeNow) )
+         continue;
+
+      u32 uNeededMask = 0;
+      int iNeeded = 1;
+      if ( 0 == pBlock->iRecvDataPackets + pBlock->iRecvECPackets )
+         uNeededMask = VIDEO_RX_PACKET_BIT(0);
+      else
+      {
+         iNeeded = pBlock->iBlockDataPackets - pBlock->iRecvDataPackets - pBlock->iRecvECPackets;
+         u32 uMissing = pBlock->uAllocatedMask & (~pBlock->uReceivedMask) & VIDEO_RX_PACKETS_MASK(pBlock->iBlockDataPackets);
+         while ( (0 != uMissing) && (iNeeded > 0) )
+         {
+            uNeededMask |= uMissing & (~(uMissing - 1));
+            uMissing &= uMissing - 1;
+            iNeeded--;
+         }
+      }
+      u32 uRequestMask = uNeededMask;
+      if ( pRun->bNack )
+         uRequestMask = video_nack_get_packets_to_request(&pRun->nack, uNeededMask, pBlock->uRequestedMask, pBlock->uPacketsRequestedTime,
+            (0 != pBlock->uReceivedTime)?(pBlock->uReceivedTime + TEST_WINDOW_MS):0, g_TimeNow);
+      if ( 0 == uRequestMask )
+         continue;
+      while ( __builtin_popcount(uRequestMask) > DEFAULT_VIDEO_RETRANS_MAX_PCOUNT - iCountRequested )
+         uRequestMask &= ~(1u << (31 - __builtin_clz(uRequestMask)));
+
+      for( u32 uMask = uRequestMask; 0 != uMask; uMask &= uMask - 1 )
+      {
+         int k = __builtin_ctz(uMask);
+         if ( pBlock->uRequestedMask & VIDEO_RX_PACKET_BIT(k) )
+            bReRequested = true;
+         pBlock->uRequestedMask |= VIDEO_RX_PACKET_BIT(k);
+         pBlock->uPacketsRequestedTime[k] = g_TimeNow;
+      }
+      iCountRequested += __builtin_popcount(uRequestMask);
+      uBlockIndexes[iCountRequestedBlocks] = pBlock->uVideoBlockIndex;
+      uMasks[iCountRequestedBlocks] = (0 == pBlock->iRecvDataPackets + pBlock->iRecvECPackets)?VIDEO_NACK_MASK_FULL_BLOCK:uRequestMask;
+      iCountRequestedBlocks++;
+   }
+   if ( 0 == iCountRequested )
+      return;
+
+   u8 uPacket[MAX_PACKET_TOTAL_SIZE];
+   t_packet_header PH;
+   radio_packet_init(&PH, PACKET_COMPONENT_VIDEO, PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS, STREAM_ID_DATA);
+   PH.packet_flags |= PACKET_FLAGS_BIT_HIGH_PRIORITY;
+   PH.vehicle_id_dest = 1;
+   pRun->uNextRequestId++;
+   PH.total_length = (u16)(sizeof(t_packet_header) + video_nack_build_request(uPacket + sizeof(t_packet_header), pRun->uNextRequestId, 0,
+      bReRequested?0x01:0, uBlockIndexes, uMasks, iCountRequestedBlocks, pRun->bNack));
+   memcpy(uPacket, &PH, sizeof(t_packet_header));
+   video_fixture_send_packet(false, uPacket, PH.total_length);
+
+   if ( pRun->bNack )
+      video_nack_on_request_sent(&pRun->nack, pRun->uNextRequestId, g_TimeNow, iCountRequested, PH.total_length);
+   if ( pRun->uRequestInterval < TEST_LEGACY_MAX_INTERVAL_MS )
+      pRun->uRequestInterval++;
+   pRun->uLastRequestTime = g_TimeNow;
+   pRun->uRequests++;
+   pRun->uRequestedPackets += iCountRequested;
+   pRun->uUplinkBytes += PH.total_length;
+}
+
+typedef struct
+{
+   type_test_run* pRun;
+   VideoRxPacketsBuffer* pRxBuffer;
+} type_test_station;
+
+static void _station_on_packet(u8* pPacket, int iLength, void* pContext)
+{
+   type_test_station* pStation = (type_test_station*)pContext;
+   t_packet_header* pPH = (t_packet_header*)pPacket;
+   if ( pPH->packet_type != PACKET_TYPE_VIDEO_DATA )
+      return;
+   t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(pPacket + sizeof(t_packet_header));
+   bool bRetransmitted = (pPH->packet_flags & PACKET_FLAGS_BIT_RETRANSMITED)?true:false;
+   if ( bRetransmitted && pStation->pRun->bNack && (pPHVS->uStreamInfoFlags == VIDEO_STREAM_INFO_FLAG_RETRANSMISSION_ID) )
+      video_nack_on_response(&pStation->pRun->nack, pPHVS->uStreamInfo, g_TimeNow);
+   if ( ! pStation->pRxBuffer->checkAddVideoPacket(pPacket, iLength, video_fixture_time_micros()) )
+      return;
+   if ( bRetransmitted )
+      pStation->pRun->uRecoveredPackets++;
+   _station_output_available_packets(pStation->pRun, pStation->pRxBuffer);
+}
+
+//------------------------------------------------------------
+
+static int _run(type_test_run* pRun, int bNack, u16 uBasePort, const char* szLinkParams, const char* szUplinkParams, int iSeconds)
+{
+   memset(pRun, 0, sizeof(type_test_run));
+   pRun->bNack = bNack;
+   pRun->uRequestInterval = TEST_LEGACY_MIN_INTERVAL_MS;
+   video_nack_init(&pRun->nack);
+
+   type_radio_link_sim_params paramsDownlink;
+   type_radio_link_sim_params paramsUplink;
+   radio_link_sim_set_default_params(&paramsDownlink);
+   radio_link_sim_set_default_params(&paramsUplink);
+   // Same losses for both runs
+   paramsDownlink.uSeed = 1234;
+   paramsUplink.uSeed = 5678;
+   if ( (! radio_link_sim_parse_params(szLinkParams, &paramsDownlink)) || (! radio_link_sim_parse_params(szUplinkParams, &paramsUplink)) )
+   {
+      printf("Invalid link parameters.\n");
+      return 0;
+   }
+   if ( ! video_fixture_open_sim_link(uBasePort, &paramsDownlink, &paramsUplink) )
+   {
+      printf("Failed to open the simulated links (UDP ports %d+).\n", (int)uBasePort);
+      return 0;
+   }
+
+   Model model;
+   VideoRxPacketsBuffer* pRxBuffer = new VideoRxPacketsBuffer(0, 0);
+   pRxBuffer->init(&model);
+   memset(s_pSentBlocks, 0xFF, TEST_HISTORY_BLOCKS * sizeof(type_test_sent_block));
+   s_uNextBlockIndex = 0;
+   type_test_station station;
+   station.pRun = pRun;
+   station.pRxBuffer = pRxBuffer;
+
+   u64 uTimeStart = video_fixture_time_micros();
+   u64 uTimeEndSend = uTimeStart + (u64)iSeconds * 1000000LL;
+   u64 uTimeEnd = uTimeEndSend + (TEST_WINDOW_MS + 200) * 1000LL;
+   u64 uTimeNextBlock = uTimeStart;
+   while ( 1 )
+   {
+      u64 uTimeNow = video_fixture_time_micros();
+      if ( uTimeNow >= uTimeEnd )
+         break;
+      g_TimeNow = get_current_timestamp_ms();
+      if ( (uTimeNow >= uTimeNextBlock) && (uTimeNow < uTimeEndSend) )
+      {
+         _vehicle_send_block();
+         pRun->uBlocksSent++;
+         uTimeNextBlock += TEST_BLOCK_INTERVAL_MICROS;
+      }
+
+      _station_request_missing_packets(pRun, pRxBuffer);
+      _station_output_available_packets(pRun, pRxBuffer);
+
+      bool bStationHasPackets = false;
+      bool bVehicleHasPackets = false;
+      if ( ! video_fixture_poll_sim_link(1, &bStationHasPackets, &bVehicleHasPackets) )
+         continue;
+      g_TimeNow = get_current_timestamp_ms();
+      if ( bStationHasPackets )
+         video_fixture_read_packets(false, _station_on_packet, &station);
+      if ( bVehicleHasPackets )
+         video_fixture_read_packets(true, _vehicle_on_packet, pRun);
+   }
+
+   video_fixture_close_sim_link(&pRun->statsDownlink, &pRun->statsUplink);
+   delete pRxBuffer;
+   return 1;
+}
+
+static double _bytes_per_recovered_packet(type_test_run* pRun)
+{
+   if ( 0 == pRun->uRecoveredPackets )
+      return 0.0;
+   return (double)pRun->uUplinkBytes / (double)pRun->uRecoveredPackets;
+}
+
+static double _recovery_rate(type_test_run* pRun)
+{
+   if ( 0 == pRun->uBlocksRecovered + pRun->uBlocksLost )
+      return 100.0;
+   return 100.0 * (double)pRun->uBlocksRecovered / (double)(pRun->uBlocksRecovered + pRun->uBlocksLost);
+}
+
+static void _print_run(const char* szName, type_test_run* pRun)
+{
+   printf("%-10s: %u blocks sent, %u requests (%u packets, %llu bytes), %u packets resent, %u recovered (%.1f uplink bytes per recovered packet)\n",
+      szName, pRun->uBlocksSent, pRun->uRequests, pRun->uRequestedPackets, (unsigned long long)pRun->uUplinkBytes,
+      pRun->uResentPackets, pRun->uRecoveredPackets, _bytes_per_recovered_packet(pRun));
+   printf("%-10s  blocks: %u recovered by retransmissions, %u lost, recovery rate %.2f%%; downlink lost %u frames, uplink lost %u frames\n",
+      "", pRun->uBlocksRecovered, pRun->uBlocksLost, _recovery_rate(pRun),
+      pRun->statsDownlink.uFramesLostRandom + pRun->statsDownlink.uFramesLostBurst, pRun->statsUplink.uFramesLostRandom + pRun->statsUplink.uFramesLostBurst);
+}
+
+int main(int argc, char *argv[])
+{
+   int iSeconds = 3;
+   int iBasePort = RADIO_LINK_SIM_DEFAULT_BASE_PORT;
+   const char* szLinkParams = "loss=3,burst=0.5:25:70,delay=10,jitter=2";
+   const char* szUplinkParams = "loss=3,delay=10,jitter=2";
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-seconds")) && (i < argc-1) )
+         iSeconds = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-port")) && (i < argc-1) )
+         iBasePort = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-link")) && (i < argc-1) )
+         szLinkParams = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-uplink")) && (i < argc-1) )
+         szUplinkParams = argv[++i];
+   }
+   if ( iSeconds < 1 )
+      iSeconds = 1;
+
+   printf("\nTesting the video retransmission requests scheduler...\n");
+   log_disable();
+   g_TimeStart = get_current_timestamp_ms();
+   g_TimeNow = g_TimeStart;
+   memset(&g_SMControllerRTInfo, 0, sizeof(controller_runtime_info));
+   fec_init();
+
+   _test_rtt_estimator();
+   _test_in_flight_and_deadline();
+   _test_coalesced_encoding();
+   _test_request_build_parse();
+
+   printf("Video stream over the link simulator: %d s, a block (%d/%d) each %d ms, window %d ms\n", iSeconds,
+      TEST_BLOCK_DATA_PACKETS, TEST_BLOCK_EC_PACKETS, TEST_BLOCK_INTERVAL_MICROS/1000, TEST_WINDOW_MS);
+   printf("Downlink: %s\nUplink: %s\n", szLinkParams, szUplinkParams);
+   s_pSentBlocks = (type_test_sent_block*)malloc(TEST_HISTORY_BLOCKS * sizeof(type_test_sent_block));
+   if ( NULL == s_pSentBlocks )
+      return 1;
+
+   type_test_run runLegacy;
+   type_test_run runNack;
+   if ( (! _run(&runLegacy, 0, (u16)iBasePort, szLinkParams, szUplinkParams, iSeconds)) ||
+        (! _run(&runNack, 1, (u16)iBasePort, szLinkParams, szUplinkParams, iSeconds)) )
+   {
+      free(s_pSentBlocks);
+      printf("FAILED: could not run the link simulator.\n");
+      return 1;
+   }
+   free(s_pSentBlocks);
+
+   _print_run("before", &runLegacy);
+   _print_run("scheduler", &runNack);
+   printf("scheduler : retr rtt %u ms (min %u, max %u, %u samples), rto %u ms, %u requests of packets in flight suppressed, %u blocks past deadline skipped\n",
+      video_nack_get_srtt_ms(&runNack.nack), runNack.nack.uMinSampleMs, runNack.nack.uMaxSampleMs, runNack.nack.uCountSamples,
+      video_nack_get_rto_ms(&runNack.nack), runNack.nack.uCountSuppressedPackets, runNack.nack.uCountSkippedBlocks);
+
+   _check((runLegacy.uRecoveredPackets > 0) && (runNack.uRecoveredPackets > 0), "packets recovered by retransmissions");
+   _check((0 == runLegacy.uInvalidRequests) && (0 == runNack.uInvalidRequests), "requests parsed by the vehicle");
+   _check((runLegacy.uVehicleRequestedPackets <= runLegacy.uRequestedPackets) && (runNack.uVehicleRequestedPackets <= runNack.uRequestedPackets) &&
+      (runNack.uVehicleRequestedPackets > 0), "packets requested as parsed by the vehicle");
+   _check(runNack.nack.uCountSamples > 0, "RTT samples");
+   _check(_bytes_per_recovered_packet(&runNack) < 0.75 * _bytes_per_recovered_packet(&runLegacy), "fewer uplink bytes per recovered packet");
+   _check(runNack.uResentPackets < runLegacy.uResentPackets, "fewer packets resent by the vehicle");
+   _check(_recovery_rate(&runNack) >= _recovery_rate(&runLegacy) - 5.0, "recovery rate");
+
+   if ( 0 != s_iFailures )
+   {
+      printf("FAILED: %d checks failed.\n", s_iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,246 @@
+#include "../base/base.h"
+#include "../radio/radio_tx_pacer.h"
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <vector>
+
+// Checks the radio tx pacer without Wi-Fi hardware: bursts of frames are pushed with a
+// target gap and written by the pacer thread to a fake radio sink (/dev/null, with write()
+// interposed to timestamp each frame). Checks that no frame goes out sooner than its gap,
+// that the producer never sleeps on the gaps, that the pacer stats match and that discarded
+// frames are not written.
+// Compares the achieved gaps with the ones of the previous sleep based pacing.
+//
+// Usage: test_video_tx_pacing [-frames N] [-burst N] [-gap micros]
+
+#define TEST_FRAME_SIZE 1200
+#define TEST_MAX_FRAMES 100000
+
+static int s_iSinkFd = -1;
+static u64 s_uSinkTimes[TEST_MAX_FRAMES];
+static volatile int s_iSinkFramesCount = 0;
+
+static u64 _test_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000;
+}
+
+extern "C" ssize_t write(int fd, const void* pBuffer, size_t uCount)
+{
+   static ssize_t (*s_pRealWrite)(int, const void*, size_t) = NULL;
+   if ( NULL == s_pRealWrite )
+      s_pRealWrite = (ssize_t (*)(int, const void*, size_t)) dlsym(RTLD_NEXT, "write");
+   if ( (fd == s_iSinkFd) && (fd >= 0) && (s_iSinkFramesCount < TEST_MAX_FRAMES) )
+   {
+      s_uSinkTimes[s_iSinkFramesCount] = _test_time_micros();
+      s_iSinkFramesCount = s_iSinkFramesCount + 1;
+   }
+   return s_pRealWrite(fd, pBuffer, uCount);
+}
+
+static u64 _percentile(std::vector<u64>& samples, double fPercent)
+{
+   if ( samples.empty() )
+      return 0;
+   size_t uIndex = (size_t)((fPercent/100.0) * (double)(samples.size()-1) + 0.5);
+   std::nth_element(samples.begin(), samples.begin() + uIndex, samples.end());
+   return samples[uIndex];
+}
+
+// Returns the gaps between consecutive sink writes inside each burst (the first frame of a burst is not paced)
+static void _get_burst_gaps(int iFramesCount, int iBurstSize, std::vector<u64>& gaps)
+{
+   gaps.clear();
+   for( int i=1; i<iFramesCount; i++ )
+   {
+      if ( (i % iBurstSize) == 0 )
+         continue;
+      gaps.push_back(s_uSinkTimes[i] - s_uSinkTimes[i-1]);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   int iFramesCount = 2000;
+   int iBurstSize = 32;
+   int iGapMicros = 300;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-frames")) && (i < argc-1) )
+         iFramesCount = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-burst")) && (i < argc-1) )
+         iBurstSize = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-gap")) && (i < argc-1) )
+         iGapMicros = atoi(argv[++i]);
+   }
+   iFramesCount = std::max(2, std::min(iFramesCount, TEST_MAX_FRAMES/2));
+   iBurstSize = std::max(2, std::min(iBurstSize, RADIO_TX_PACER_DEFAULT_QUEUE_SIZE));
+   iGapMicros = std::max(10, iGapMicros);
+
+   printf("\nTesting paced radio tx, %d frames, bursts of %d frames, %d us gap...\n", iFramesCount, iBurstSize, iGapMicros);
+   log_disable();
+
+   s_iSinkFd = open("/dev/null", O_WRONLY);
+   if ( s_iSinkFd < 0 )
+   {
+      printf("Failed to open the fake radio sink.\n");
+      return 1;
+   }
+
+   int iFailures = 0;
+   u8 uFrame[TEST_FRAME_SIZE];
+   memset(uFrame, 0x5A, sizeof(uFrame));
+   std::vector<u64> gaps;
+
+   // Previous pacing: the sender sleeps 3/4 of the gap between frames
+   s_iSinkFramesCount = 0;
+   u64 uLastSentTime = 0;
+   for( int i=0; i<iFramesCount; i++ )
+   {
+      if ( (i % iBurstSize) == 0 )
+         hardware_sleep_ms(2);
+      else
+      {
+         u64 uTimeNow = _test_time_micros();
+         if ( uTimeNow < uLastSentTime + (u64)iGapMicros )
+            hardware_sleep_micros(((uLastSentTime + (u64)iGapMicros - uTimeNow)*3)/4);
+      }
+      uLastSentTime = _test_time_micros();
+      if ( write(s_iSinkFd, uFrame, TEST_FRAME_SIZE) != TEST_FRAME_SIZE )
+         iFailures++;
+   }
+   _get_burst_gaps(iFramesCount, iBurstSize, gaps);
+   u64 uSleepMin = *std::min_element(gaps.begin(), gaps.end());
+   u64 uSleepP50 = _percentile(gaps, 50.0);
+   u64 uSleepP99 = _percentile(gaps, 99.0);
+   printf("Sleep pacing: achieved gap min %llu us, p50 %llu us, p99 %llu us.\n", uSleepMin, uSleepP50, uSleepP99);
+
+   // Pacer thread: the producer just queues the frames
+   shared_mem_radio_tx_pacing_stats stats;
+   type_radio_tx_pacer pacer;
+   if ( (! radio_tx_pacer_init(&pacer, RADIO_TX_PACER_DEFAULT_QUEUE_SIZE, &stats)) || (! radio_tx_pacer_start(&pacer, 0)) )
+   {
+      printf("Failed to start the tx pacer.\n");
+      close(s_iSinkFd);
+      return 1;
+   }
+
+   s_iSinkFramesCount = 0;
+   u64 uMaxPushMicros = 0;
+   u64 uTotalPushMicros = 0;
+   for( int i=0; i<iFramesCount; i++ )
+   {
+      if ( (i % iBurstSize) == 0 )
+      {
+         if ( ! radio_tx_pacer_wait_empty(&pacer, 1000) )
+            iFailures++;
+         hardware_sleep_ms(2);
+      }
+      // Build the frame in place, as radiolink does
+      u8* pBuffer = radio_tx_pacer_get_next_frame_buffer(&pacer);
+      if ( NULL == pBuffer )
+      {
+         iFailures++;
+         continue;
+      }
+      memcpy(pBuffer, uFrame, TEST_FRAME_SIZE);
+      u64 uTimeStart = _test_time_micros();
+      if ( ! radio_tx_pacer_push(&pacer, s_iSinkFd, pBuffer, TEST_FRAME_SIZE, (u32)iGapMicros) )
+         iFailures++;
+      u64 uDelta = _test_time_micros() - uTimeStart;
+      uTotalPushMicros += uDelta;
+      if ( uDelta > uMaxPushMicros )
+         uMaxPushMicros = uDelta;
+   }
+   if ( ! radio_tx_pacer_wait_empty(&pacer, 1000) )
+      iFailures++;
+
+   // Frames with no gap are written right away and are not part of the pacing stats
+   int iUnpacedFrames = 16;
+   for( int i=0; i<iUnpacedFrames; i++ )
+      if ( ! radio_tx_pacer_push(&pacer, s_iSinkFd, uFrame, TEST_FRAME_SIZE, 0) )
+         iFailures++;
+   if ( ! radio_tx_pacer_wait_empty(&pacer, 1000) )
+      iFailures++;
+   radio_tx_pacer_stop(&pacer);
+
+   int iSinkFrames = s_iSinkFramesCount;
+   _get_burst_gaps(iFramesCount, iBurstSize, gaps);
+   u64 uPacedMin = *std::min_element(gaps.begin(), gaps.end());
+   u64 uPacedP50 = _percentile(gaps, 50.0);
+   u64 uPacedP99 = _percentile(gaps, 99.0);
+   printf("Pacer thread: achieved gap min %llu us, p50 %llu us, p99 %llu us, max lateness %u us.\n", uPacedMin, uPacedP50, uPacedP99, stats.uMaxLatenessMicros);
+   printf("Producer push time: avg %.2f us, max %llu us (%d frames, %d us of gaps per burst).\n",
+      (double)uTotalPushMicros/(double)iFramesCount, uMaxPushMicros, iFramesCount, (iBurstSize-1)*iGapMicros);
+
+   int iExpectedPaced = (int)gaps.size();
+   u32 uHistogramGaps = 0;
+   u32 uHistogramLateness = 0;
+   for( int i=0; i<RADIO_TX_PACING_GAP_HISTOGRAM_BUCKETS; i++ )
+      uHistogramGaps += stats.uHistogramAchievedGap[i];
+   for( int i=0; i<RADIO_TX_PACING_LATENESS_HISTOGRAM_BUCKETS; i++ )
+      uHistogramLateness += stats.uHistogramLateness[i];
+   printf("Pacer stats: %u frames, %u paced (expected %d), histograms: %u/%u samples, %u write errors, %u dropped, max queued %u.\n",
+      stats.uTotalFrames, stats.uTotalPacedFrames, iExpectedPaced, uHistogramGaps, uHistogramLateness,
+      stats.uTotalWriteErrors, stats.uTotalDroppedFrames, stats.uMaxQueuedFrames);
+
+   if ( iSinkFrames != iFramesCount + iUnpacedFrames )
+   {
+      printf("Sink got %d frames, expected %d\n", iSinkFrames, iFramesCount + iUnpacedFrames);
+      iFailures++;
+   }
+   if ( uPacedMin < (u64)iGapMicros )
+   {
+      printf("Frame sent sooner than its gap: %llu us\n", uPacedMin);
+      iFailures++;
+   }
+   // The producer must not wait for the gaps (only for the queue)
+   if ( uTotalPushMicros >= (u64)(iFramesCount/iBurstSize) * (u64)((iBurstSize-1)*iGapMicros) / 4 )
+   {
+      printf("Producer spent too much time pushing frames.\n");
+      iFailures++;
+   }
+   if ( (stats.uTotalFrames != (u32)(iFramesCount + iUnpacedFrames)) || (stats.uTotalPacedFrames != (u32)iExpectedPaced) )
+      iFailures++;
+   if ( (uHistogramGaps != stats.uTotalPacedFrames) || (uHistogramLateness != stats.uTotalPacedFrames) )
+      iFailures++;
+   if ( (0 != stats.uTotalWriteErrors) || (0 != stats.uTotalDroppedFrames) )
+      iFailures++;
+
+   // Discarding the queued frames (as on closing a radio interface): none is written afterwards
+   int iDiscardFrames = 8;
+   if ( ! radio_tx_pacer_start(&pacer, 0) )
+      iFailures++;
+   for( int i=0; i<iDiscardFrames; i++ )
+      if ( ! radio_tx_pacer_push(&pacer, s_iSinkFd, uFrame, TEST_FRAME_SIZE, 100000) )
+         iFailures++;
+   hardware_sleep_ms(20);
+   if ( ! radio_tx_pacer_discard_pending(&pacer) )
+      iFailures++;
+   int iSinkFramesAfterDiscard = s_iSinkFramesCount;
+   hardware_sleep_ms(150);
+   if ( (s_iSinkFramesCount != iSinkFramesAfterDiscard) || (s_iSinkFramesCount - iSinkFrames > 1) || (0 != radio_tx_pacer_get_queued_frames(&pacer)) )
+   {
+      printf("Frames written after being discarded: %d\n", s_iSinkFramesCount - iSinkFrames - 1);
+      iFailures++;
+   }
+   if ( (int)stats.uTotalDroppedFrames < iDiscardFrames - 1 )
+      iFailures++;
+   if ( (! radio_tx_pacer_is_running(&pacer)) || (! radio_tx_pacer_push(&pacer, s_iSinkFd, uFrame, TEST_FRAME_SIZE, 0)) || (! radio_tx_pacer_wait_empty(&pacer, 1000)) )
+      iFailures++;
+   radio_tx_pacer_stop(&pacer);
+
+   radio_tx_pacer_free(&pacer);
+   close(s_iSinkFd);
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
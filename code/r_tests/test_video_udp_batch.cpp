@@ -0,0 +1,389 @@
+#include "../base/base.h"
+#include "../r_vehicle/video_source_udp_batch.h"
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+
+// Checks the batched (recvmmsg) UDP reader used for the majestic RTP video stream:
+// an RTP H264/H265 stream is replayed over loopback UDP at faster than real time, frame by frame
+// in bursts as majestic sends it, and read back on a socket set up as the majestic input socket.
+// Every packet must arrive, in order and unchanged, without socket rx queue overflows.
+// The stream is synthetic (60 fps, 16 Mbps, FU fragmented NALs) unless a capture file
+// (classic pcap, Ethernet/Linux cooked/raw IPv4, UDP) is given.
+//
+// Usage: test_video_udp_batch [-capture file.pcap] [-port N] [-seconds N] [-speed N]
+
+#define TEST_UDP_PORT 5677
+#define TEST_RTP_PAYLOAD 1400
+#define TEST_FPS 60
+#define TEST_BITRATE 16000000
+
+typedef struct
+{
+   u32 uTimeUs; // Relative to stream start
+   std::vector<u8> data;
+} type_test_packet;
+
+static std::vector<type_test_packet> s_Packets;
+static double s_fSpeed = 2.0;
+static int s_iSenderSocket = -1;
+static volatile int s_iSenderDone = 0;
+static u32 s_uSendFailures = 0;
+
+static u64 _time_us()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000;
+}
+
+static void _add_rtp_packet(u32 uTimeUs, u16 uSeq, u32 uRTPTimestamp, bool bMarker, const u8* pHeader, int iHeaderLength, int iPayloadLength)
+{
+   type_test_packet packet;
+   packet.uTimeUs = uTimeUs;
+   packet.data.resize(12 + iHeaderLength + iPayloadLength);
+   u8* p = &packet.data[0];
+   p[0] = 0x80;
+   p[1] = (bMarker?0x80:0x00) | 96;
+   p[2] = (uSeq >> 8) & 0xFF;
+   p[3] = uSeq & 0xFF;
+   p[4] = (uRTPTimestamp >> 24) & 0xFF;
+   p[5] = (uRTPTimestamp >> 16) & 0xFF;
+   p[6] = (uRTPTimestamp >> 8) & 0xFF;
+   p[7] = uRTPTimestamp & 0xFF;
+   u32 uSSRC = 0x52554259;
+   memcpy(p+8, &uSSRC, sizeof(u32));
+   memcpy(p+12, pHeader, iHeaderLength);
+   for( int i=0; i<iPayloadLength; i++ )
+      p[12 + iHeaderLength + i] = (u8)(uSeq * 7 + i);
+   s_Packets.push_back(packet);
+}
+
+// Builds an FU fragmented stream: one NAL per frame, key frame (4x larger) every second
+static void _build_synthetic_stream(bool bH265, int iSeconds)
+{
+   int iFrames = iSeconds * TEST_FPS;
+   int iFrameBytes = TEST_BITRATE / 8 / TEST_FPS;
+   u16 uSeq = 0;
+   for( int iFrame=0; iFrame<iFrames; iFrame++ )
+   {
+      bool bKeyFrame = ((iFrame % TEST_FPS) == 0);
+      int iBytes = bKeyFrame?(iFrameBytes*4):iFrameBytes;
+      u32 uTimeUs = (u32)((u64)iFrame * 1000000 / TEST_FPS);
+      u32 uRTPTimestamp = (u32)((u64)iFrame * 90000 / TEST_FPS);
+      int iPackets = (iBytes + TEST_RTP_PAYLOAD - 1) / TEST_RTP_PAYLOAD;
+      for( int i=0; i<iPackets; i++ )
+      {
+         u8 uHeader[3];
+         int iHeaderLength = 0;
+         u8 uFlags = ((0 == i)?0x80:0x00) | ((i == iPackets-1)?0x40:0x00);
+         if ( bH265 )
+         {
+            uHeader[0] = 49 << 1;
+            uHeader[1] = 1;
+            uHeader[2] = uFlags | (bKeyFrame?19:1);
+            iHeaderLength = 3;
+         }
+         else
+         {
+            uHeader[0] = 0x60 | 28;
+            uHeader[1] = uFlags | (bKeyFrame?5:1);
+            iHeaderLength = 2;
+         }
+         int iPayload = TEST_RTP_PAYLOAD;
+         if ( i == iPackets-1 )
+            iPayload = iBytes - i * TEST_RTP_PAYLOAD;
+         _add_rtp_packet(uTimeUs, uSeq, uRTPTimestamp, (i == iPackets-1), uHeader, iHeaderLength, iPayload);
+         uSeq++;
+      }
+   }
+}
+
+static u32 _read_u32(const u8* p, bool bSwap)
+{
+   u32 u = 0;
+   memcpy(&u, p, sizeof(u32));
+   return bSwap?__builtin_bswap32(u):u;
+}
+
+// Loads the UDP payloads (to iPort, or any port if 0) from a classic pcap capture. Returns false on error.
+static bool _load_capture(const char* szFile, int iPort)
+{
+   FILE* fd = fopen(szFile, "rb");
+   if ( NULL == fd )
+   {
+      printf("Can't open capture file %s\n", szFile);
+      return false;
+   }
+   u8 uHeader[24];
+   if ( 1 != fread(uHeader, sizeof(uHeader), 1, fd) )
+   {
+      fclose(fd);
+      printf("Invalid capture file %s\n", szFile);
+      return false;
+   }
+   u32 uMagic = _read_u32(uHeader, false);
+   bool bSwap = ((uMagic == 0xd4c3b2a1) || (uMagic == 0x4d3cb2a1));
+   bool bNanoSec = ((uMagic == 0xa1b23c4d) || (uMagic == 0x4d3cb2a1));
+   if ( (uMagic != 0xa1b2c3d4) && (uMagic != 0xa1b23c4d) && (! bSwap) )
+   {
+      fclose(fd);
+      printf("Unsupported capture file format (only classic pcap is supported): %s\n", szFile);
+      return false;
+   }
+   u32 uLinkType = _read_u32(uHeader+20, bSwap);
+   int iLinkHeader = 0;
+   if ( 1 == uLinkType )
+      iLinkHeader = 14;
+   else if ( 113 == uLinkType )
+      iLinkHeader = 16;
+   else if ( (101 != uLinkType) && (228 != uLinkType) )
+   {
+      fclose(fd);
+      printf("Unsupported capture link type %u\n", uLinkType);
+      return false;
+   }
+
+   u8 uRecord[16];
+   static u8 s_uFrame[65536];
+   u64 uFirstTimeUs = 0;
+   bool bFirst = true;
+   while ( 1 == fread(uRecord, sizeof(uRecord), 1, fd) )
+   {
+      u32 uCaptured = _read_u32(uRecord+8, bSwap);
+      if ( (uCaptured > sizeof(s_uFrame)) || (1 != fread(s_uFrame, uCaptured, 1, fd)) )
+         break;
+      u64 uTimeUs = (u64)_read_u32(uRecord, bSwap) * 1000000 + (u64)(_read_u32(uRecord+4, bSwap) / (bNanoSec?1000:1));
+
+      if ( (int)uCaptured < iLinkHeader + 28 )
+         continue;
+      if ( (1 == uLinkType) && ((s_uFrame[12] != 0x08) || (s_uFrame[13] != 0x00)) )
+         continue;
+      if ( (113 == uLinkType) && ((s_uFrame[14] != 0x08) || (s_uFrame[15] != 0x00)) )
+         continue;
+      u8* pIP = s_uFrame + iLinkHeader;
+      int iIPHeader = (pIP[0] & 0x0F) * 4;
+      if ( ((pIP[0] >> 4) != 4) || (pIP[9] != 17) )
+         continue;
+      // Skip fragments
+      if ( ((pIP[6] & 0x3F) != 0) || (pIP[7] != 0) )
+         continue;
+      u8* pUDP = pIP + iIPHeader;
+      int iUDPLength = ((int)pUDP[4] << 8) | pUDP[5];
+      int iDestPort = ((int)pUDP[2] << 8) | pUDP[3];
+      if ( (iPort > 0) && (iDestPort != iPort) )
+         continue;
+      if ( (iUDPLength <= 8) || (pUDP + iUDPLength > s_uFrame + uCaptured) )
+         continue;
+      if ( (iUDPLength - 8 > MAX_PACKET_TOTAL_SIZE) || ((pUDP[8] >> 6) != 2) )
+         continue;
+
+      if ( bFirst )
+         uFirstTimeUs = uTimeUs;
+      bFirst = false;
+      type_test_packet packet;
+      packet.uTimeUs = (u32)(uTimeUs - uFirstTimeUs);
+      packet.data.assign(pUDP + 8, pUDP + iUDPLength);
+      s_Packets.push_back(packet);
+   }
+   fclose(fd);
+   return true;
+}
+
+static void* _thread_sender(void* pParam)
+{
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = htons(TEST_UDP_PORT);
+
+   u64 uTimeStart = _time_us();
+   for( size_t i=0; i<s_Packets.size(); i++ )
+   {
+      u64 uTimeSend = uTimeStart + (u64)((double)s_Packets[i].uTimeUs / s_fSpeed);
+      u64 uTimeNow = _time_us();
+      if ( uTimeSend > uTimeNow )
+         hardware_sleep_micros((u32)(uTimeSend - uTimeNow));
+      if ( sendto(s_iSenderSocket, &(s_Packets[i].data[0]), s_Packets[i].data.size(), 0, (struct sockaddr*)&addr, sizeof(addr)) != (int)s_Packets[i].data.size() )
+         s_uSendFailures++;
+   }
+   __atomic_store_n(&s_iSenderDone, 1, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+// Same socket setup as the majestic input socket
+static int _open_receive_socket()
+{
+   int iSocket = socket(AF_INET, SOCK_DGRAM, 0);
+   if ( iSocket < 0 )
+      return -1;
+   int iOptVal = 1;
+   setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iOptVal, sizeof(iOptVal));
+   setsockopt(iSocket, SOL_SOCKET, SO_RXQ_OVFL, &iOptVal, sizeof(iOptVal));
+   int iRecvSize = 512*1024;
+   setsockopt(iSocket, SOL_SOCKET, SO_RCVBUF, &iRecvSize, sizeof(iRecvSize));
+
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = htons(TEST_UDP_PORT);
+   if ( bind(iSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 )
+   {
+      close(iSocket);
+      return -1;
+   }
+   fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL, 0) | O_NONBLOCK);
+   return iSocket;
+}
+
+// Replays s_Packets and checks what the batch reader gets. Returns the number of errors.
+static int _run_replay(const char* szName)
+{
+   int iFailures = 0;
+   int iSocket = _open_receive_socket();
+   s_iSenderSocket = socket(AF_INET, SOCK_DGRAM, 0);
+   if ( (iSocket < 0) || (s_iSenderSocket < 0) )
+   {
+      printf("Failed to open the test UDP sockets.\n");
+      return 1;
+   }
+   int iSendSize = 1024*1024;
+   setsockopt(s_iSenderSocket, SOL_SOCKET, SO_SNDBUF, &iSendSize, sizeof(iSendSize));
+
+   type_udp_batch_reader reader;
+   if ( ! video_source_udp_batch_init(&reader, iSocket, UDP_BATCH_MAX_PACKETS) )
+   {
+      printf("Failed to init the UDP batch reader.\n");
+      return 1;
+   }
+
+   s_iSenderDone = 0;
+   s_uSendFailures = 0;
+   pthread_t thread;
+   if ( 0 != pthread_create(&thread, NULL, &_thread_sender, NULL) )
+   {
+      printf("Failed to create the sender thread.\n");
+      return 1;
+   }
+
+   size_t uReceived = 0;
+   u64 uReceivedBytes = 0;
+   u64 uTimeStart = _time_us();
+   u64 uTimeLastData = uTimeStart;
+   while ( true )
+   {
+      int iCount = video_source_udp_batch_read(&reader, 1000);
+      if ( iCount < 0 )
+      {
+         iFailures++;
+         break;
+      }
+      if ( 0 == iCount )
+      {
+         if ( __atomic_load_n(&s_iSenderDone, __ATOMIC_ACQUIRE) && (_time_us() > uTimeLastData + 200000) )
+            break;
+         continue;
+      }
+      uTimeLastData = _time_us();
+
+      int iLength = 0;
+      u8* pPacket = NULL;
+      while ( NULL != (pPacket = video_source_udp_batch_next_packet(&reader, &iLength)) )
+      {
+         bool bOk = (uReceived < s_Packets.size());
+         if ( bOk && ((size_t)iLength != s_Packets[uReceived].data.size()) )
+            bOk = false;
+         if ( bOk && (0 != memcmp(pPacket, &(s_Packets[uReceived].data[0]), iLength)) )
+            bOk = false;
+         if ( ! bOk )
+         {
+            if ( iFailures < 10 )
+            {
+               u16 uSeq = (iLength > 4)?(((u16)pPacket[2] << 8) | pPacket[3]):0;
+               printf("Invalid or out of order packet %d (RTP seq %u, %d bytes)\n", (int)uReceived, uSeq, iLength);
+            }
+            iFailures++;
+         }
+         uReceived++;
+         uReceivedBytes += (u64)iLength;
+      }
+   }
+   pthread_join(thread, NULL);
+   u64 uDurationUs = _time_us() - uTimeStart;
+
+   printf("%s: received %d of %d packets in %u recvmmsg calls (avg %.1f, max %d packets per call), %u dropped by socket, %.1f Mbps.\n",
+      szName, (int)uReceived, (int)s_Packets.size(), reader.uTotalReads,
+      (reader.uTotalReads > 0)?((float)reader.uTotalPackets/(float)reader.uTotalReads):0.0,
+      reader.iMaxBatchSize, reader.uTotalDroppedPackets,
+      (double)uReceivedBytes * 8.0 / (double)uDurationUs);
+
+   if ( uReceived != s_Packets.size() )
+      iFailures++;
+   if ( (0 != reader.uTotalDroppedPackets) || (0 != reader.uTotalTruncatedPackets) || (0 != s_uSendFailures) )
+      iFailures++;
+
+   video_source_udp_batch_free(&reader);
+   close(iSocket);
+   close(s_iSenderSocket);
+   s_iSenderSocket = -1;
+   return iFailures;
+}
+
+int main(int argc, char *argv[])
+{
+   const char* szCapture = NULL;
+   int iPort = 0;
+   int iSeconds = 4;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( (0 == strcmp(argv[i], "-capture")) && (i < argc-1) )
+         szCapture = argv[++i];
+      else if ( (0 == strcmp(argv[i], "-port")) && (i < argc-1) )
+         iPort = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-seconds")) && (i < argc-1) )
+         iSeconds = atoi(argv[++i]);
+      else if ( (0 == strcmp(argv[i], "-speed")) && (i < argc-1) )
+         s_fSpeed = atof(argv[++i]);
+   }
+   if ( iSeconds < 1 )
+      iSeconds = 1;
+   if ( s_fSpeed < 0.1 )
+      s_fSpeed = 0.1;
+
+   printf("\nTesting batched UDP reads of the RTP video stream, replayed at %.1fx real time...\n", s_fSpeed);
+   log_disable();
+
+   int iFailures = 0;
+   if ( NULL != szCapture )
+   {
+      if ( ! _load_capture(szCapture, iPort) )
+         return 1;
+      if ( s_Packets.empty() )
+      {
+         printf("No RTP packets found in capture %s\n", szCapture);
+         return 1;
+      }
+      iFailures += _run_replay(szCapture);
+   }
+   else
+   {
+      _build_synthetic_stream(false, iSeconds);
+      iFailures += _run_replay("H264");
+      s_Packets.clear();
+      _build_synthetic_stream(true, iSeconds);
+      iFailures += _run_replay("H265");
+   }
+
+   if ( iFailures > 0 )
+   {
+      printf("FAILED: %d errors.\n", iFailures);
+      return 1;
+   }
+   printf("PASSED.\n");
+   return 0;
+}
@@ -0,0 +1,247 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../base/hardware_radio.h"
+#include "../radio/radiolink.h"
+#include "../radio/fec.h"
+#include "video_link_fixture.h"
+
+#include <poll.h>
+
+controller_runtime_info g_SMControllerRTInfo;
+u32 g_TimeLastVideoParametersOrProfileChanged = 0;
+
+u32 video_fixture_random(u32* puState)
+{
+   *puState ^= *puState << 13;
+   *puState ^= *puState >> 17;
+   *puState ^= *puState << 5;
+   return *puState;
+}
+
+u64 video_fixture_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000;
+}
+
+void video_fixture_set_packet_headers(u8* pPacket, int iLength, u32 uBlockIndex, int iPacketIndex, int iDataPackets, int iECPackets, int iPacketSize,
+   u16 uFrameIndex, int iFramePackets, int iPacketInFrame, u32 uStreamPacketIndex)
+{
+   t_packet_header* pPH = (t_packet_header*)pPacket;
+   t_packet_header_video_segment* pPHVS = (t_packet_header_video_segment*)(pPacket + sizeof(t_packet_header));
+   radio_packet_init(pPH, PACKET_COMPONENT_VIDEO | PACKET_FLAGS_BIT_HEADERS_ONLY_CRC, PACKET_TYPE_VIDEO_DATA, STREAM_ID_VIDEO_1);
+   pPH->vehicle_id_src = 1;
+   pPH->stream_packet_idx |= uStreamPacketIndex & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+   pPH->total_length = (u16)iLength;
+   memset(pPHVS, 0, sizeof(t_packet_header_video_segment));
+   pPHVS->uVideoStreamIndexAndType = 0 | (VIDEO_TYPE_H264 << 4);
+   pPHVS->uCurrentBlockIndex = uBlockIndex;
+   pPHVS->uCurrentBlockPacketIndex = (u8)iPacketIndex;
+   pPHVS->uCurrentBlockPacketSize = (u16)iPacketSize;
+   pPHVS->uCurrentBlockDataPackets = (u8)iDataPackets;
+   pPHVS->uCurrentBlockECPackets = (u8)iECPackets;
+   pPHVS->uH264FrameIndex = uFrameIndex;
+
+   int iCountToEOF = iFramePackets - 1 - iPacketInFrame;
+   pPHVS->uFramePacketsInfo = (u16)((((u16)((iFramePackets > 255)?255:iFramePackets)) << 8) | ((u16)(iPacketInFrame & 0xFF)));
+   pPHVS->uVideoStatusFlags2 = (u32)((iCountToEOF > 255)?255:iCountToEOF) & VIDEO_STATUS_FLAGS2_MASK_EOF_COUNTER;
+   if ( 0 == iCountToEOF )
+      pPHVS->uVideoStatusFlags2 |= VIDEO_STATUS_FLAGS2_IS_END_OF_FRAME | VIDEO_STATUS_FLAGS2_IS_NAL_END;
+   if ( 0 == iPacketInFrame )
+      pPHVS->uVideoStatusFlags2 |= VIDEO_STATUS_FLAGS2_IS_NAL_START;
+}
+
+void video_fixture_encode_block(u8 (*pPackets)[MAX_PACKET_TOTAL_SIZE], int* piLengths, int iDataPackets, int iECPackets, int iPacketSize)
+{
+   int iHeadersSize = (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   u8* pDataPointers[MAX_TOTAL_PACKETS_IN_BLOCK];
+   u8* pECPointers[MAX_TOTAL_PACKETS_IN_BLOCK];
+   for( int k=0; k<iDataPackets + iECPackets; k++ )
+   {
+      t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(pPackets[k] + iHeadersSize);
+      if ( k < iDataPackets )
+      {
+         piLengths[k] = iHeadersSize + (int)sizeof(t_packet_header_video_segment_important) + pPHVSImp->uVideoDataLength;
+         pDataPointers[k] = (u8*)pPHVSImp;
+      }
+      else
+      {
+         memset(pPHVSImp, 0, iPacketSize);
+         piLengths[k] = iHeadersSize + iPacketSize;
+         pECPointers[k-iDataPackets] = (u8*)pPHVSImp;
+      }
+      ((t_packet_header*)pPackets[k])->total_length = (u16)piLengths[k];
+   }
+   if ( iECPackets > 0 )
+      fec_encode(iPacketSize, pDataPointers, iDataPackets, pECPointers, iECPackets);
+}
+
+void video_fixture_build_random_blocks(u8 (*pPackets)[MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_TOTAL_SIZE], int (*piLengths)[MAX_TOTAL_PACKETS_IN_BLOCK],
+   int iCountBlocks, int iDataPackets, int iECPackets, int iPacketSize, u32* puRandom)
+{
+   int iHeadersSize = (int)(sizeof(t_packet_header) + sizeof(t_packet_header_video_segment));
+   int iVideoDataSize = iPacketSize - (int)sizeof(t_packet_header_video_segment_important);
+   for( int b=0; b<iCountBlocks; b++ )
+   {
+      for( int k=0; k<iDataPackets; k++ )
+      {
+         u8* pPacket = pPackets[b][k];
+         memset(pPacket, 0, MAX_PACKET_TOTAL_SIZE);
+         t_packet_header_video_segment_important* pPHVSImp = (t_packet_header_video_segment_important*)(pPacket + iHeadersSize);
+         int iChunk = iVideoDataSize - (int)(video_fixture_random(puRandom) % (u32)(iVideoDataSize/8));
+         pPHVSImp->uVideoDataLength = (u16)iChunk;
+         u8* pVideo = pPacket + iHeadersSize + sizeof(t_packet_header_video_segment_important);
+         for( int i=0; i<iChunk; i++ )
+            pVideo[i] = (u8)video_fixture_random(puRandom);
+      }
+      video_fixture_encode_block(pPackets[b], piLengths[b], iDataPackets, iECPackets, iPacketSize);
+   }
+}
+
+int video_fixture_output_available_packets(VideoRxPacketsBuffer* pRxBuffer, video_fixture_output_packet_cb pfnOutput, video_fixture_can_discard_cb pfnCanDiscard, void* pContext)
+{
+   int iCountDiscarded = 0;
+   type_rx_video_block_info* pBlock = NULL;
+   while ( pRxBuffer->getCountBlocksInBuffer() != 0 )
+   {
+      type_rx_video_packet_info* pPacket = pRxBuffer->getBottomBlockAndPacketInBuffer(&pBlock);
+      if ( (0 != pBlock->uReceivedTime) && (NULL != pPacket) )
+      {
+         if ( NULL != pfnOutput )
+            pfnOutput(pBlock, pPacket, pContext);
+         pRxBuffer->advanceBottomPacketInBuffer();
+         continue;
+      }
+      if ( (NULL == pfnCanDiscard) || (! pfnCanDiscard(pRxBuffer, pBlock, pContext)) )
+         break;
+      if ( ! pRxBuffer->discardBottomBlockIfIncomplete() )
+         break;
+      iCountDiscarded++;
+   }
+   return iCountDiscarded;
+}
+
+bool video_fixture_block_has_retransmitted_packets(type_rx_video_block_info* pBlock)
+{
+   for( int k=0; k<pBlock->iBlockDataPackets + pBlock->iBlockECPackets; k++ )
+   {
+      if ( (pBlock->uReceivedMask & (~pBlock->uReconstructedMask) & VIDEO_RX_PACKET_BIT(k)) &&
+           (pBlock->packets[k].pPH->packet_flags & PACKET_FLAGS_BIT_RETRANSMITED) )
+         return true;
+   }
+   return false;
+}
+
+int video_fixture_open_sim_link(u16 uBasePort, type_radio_link_sim_params* pParamsDownlink, type_radio_link_sim_params* pParamsUplink)
+{
+   hardware_radio_set_simulated_interfaces(2);
+   radio_init_link_structures();
+   radio_set_use_link_simulator(0, uBasePort, pParamsDownlink);
+   radio_set_use_link_simulator(1, uBasePort, pParamsUplink);
+   if ( (radio_open_interface_for_write(0) < 0) || (radio_open_interface_for_read(0, RADIO_PORT_ROUTER_UPLINK) < 0) ||
+        (radio_open_interface_for_write(1) < 0) || (radio_open_interface_for_read(1, RADIO_PORT_ROUTER_DOWNLINK) < 0) )
+   {
+      video_fixture_close_sim_link(NULL, NULL);
+      return 0;
+   }
+   return 1;
+}
+
+void video_fixture_close_sim_link(type_radio_link_sim_stats* pStatsDownlink, type_radio_link_sim_stats* pStatsUplink)
+{
+   if ( NULL != pStatsDownlink )
+   {
+      memset(pStatsDownlink, 0, sizeof(type_radio_link_sim_stats));
+      radio_get_link_simulator_stats(0, pStatsDownlink);
+   }
+   if ( NULL != pStatsUplink )
+   {
+      memset(pStatsUplink, 0, sizeof(type_radio_link_sim_stats));
+      radio_get_link_simulator_stats(1, pStatsUplink);
+   }
+   radio_close_interface_for_read(0);
+   radio_close_interface_for_read(1);
+   radio_close_interface_for_write(0);
+   radio_close_interface_for_write(1);
+   radio_set_use_link_simulator(-1, 0, NULL);
+}
+
+int video_fixture_send_packet(bool bVehicle, u8* pPacket, int iLength)
+{
+   int iInterface = bVehicle?0:1;
+   u8 uRawPacket[MAX_PACKET_TOTAL_SIZE + 128];
+   int iRawLength = radio_build_new_raw_ieee_packet(iInterface, uRawPacket, pPacket, iLength, bVehicle?RADIO_PORT_ROUTER_DOWNLINK:RADIO_PORT_ROUTER_UPLINK, 0);
+   if ( iRawLength <= 0 )
+      return 0;
+   return radio_write_raw_ieee_packet(iInterface, uRawPacket, iRawLength, 0);
+}
+
+void video_fixture_read_packets(bool bVehicle, video_fixture_packet_cb pfnPacket, void* pContext)
+{
+   int iInterface = bVehicle?0:1;
+   int iLength = 0;
+   u8* pData = NULL;
+   while ( NULL != (pData = radio_process_wlan_data_in(iInterface, &iLength, NULL, g_TimeNow)) )
+   {
+      while ( iLength >= (int)sizeof(t_packet_header) )
+      {
+         int bCRCOk = 0;
+         int iPacketLength = packet_process_and_check(iInterface, pData, iLength, &bCRCOk);
+         if ( (iPacketLength <= 0) || (iPacketLength > iLength) )
+            break;
+         if ( bCRCOk )
+            pfnPacket(pData, iPacketLength, pContext);
+         pData += iPacketLength;
+         iLength -= iPacketLength;
+      }
+   }
+}
+
+int video_fixture_poll_sim_link(int iTimeoutMs, bool* pbStationHasPackets, bool* pbVehicleHasPackets)
+{
+   struct pollfd pfd[2];
+   pfd[0].fd = hardware_get_radio_info(1)->runtimeInterfaceInfoRx.selectable_fd;
+   pfd[0].events = POLLIN;
+   pfd[0].revents = 0;
+   pfd[1].fd = hardware_get_radio_info(0)->runtimeInterfaceInfoRx.selectable_fd;
+   pfd[1].events = POLLIN;
+   pfd[1].revents = 0;
+   *pbStationHasPackets = false;
+   *pbVehicleHasPackets = false;
+   if ( poll(pfd, 2, iTimeoutMs) <= 0 )
+      return 0;
+   *pbStationHasPackets = (pfd[0].revents & POLLIN)?true:false;
+   *pbVehicleHasPackets = (pfd[1].revents & POLLIN)?true:false;
+   return 1;
+}
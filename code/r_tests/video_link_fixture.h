@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../base/base.h"
+#include "../base/controller_rt_info.h"
+#include "../radio/radiopackets2.h"
+#include "../radio/radio_link_sim.h"
+#include "../r_station/video_rx_buffers.h"
+
+// Shared by the video link tests and benchmarks: vehicle video blocks (packet headers as the vehicle
+// router sets them, EC encoding), the station in order output of the rx buffer and a vehicle/station
+// link over the radio link simulator (simulated interface 0: vehicle, simulated interface 1: station).
+// Defines the globals the station video rx buffer uses.
+
+extern controller_runtime_info g_SMControllerRTInfo;
+extern u32 g_TimeLastVideoParametersOrProfileChanged;
+
+u32 video_fixture_random(u32* puState);
+u64 video_fixture_time_micros();
+
+// Video packet headers. iPacketInFrame is the frame packet of a data packet (of the last data packet of the block for EC packets)
+void video_fixture_set_packet_headers(u8* pPacket, int iLength, u32 uBlockIndex, int iPacketIndex, int iDataPackets, int iECPackets, int iPacketSize,
+   u16 uFrameIndex, int iFramePackets, int iPacketInFrame, u32 uStreamPacketIndex);
+// EC encodes a block: the data packets video data (and its length) must be set. Sets the packets lengths (and their headers total length).
+void video_fixture_encode_block(u8 (*pPackets)[MAX_PACKET_TOTAL_SIZE], int* piLengths, int iDataPackets, int iECPackets, int iPacketSize);
+// EC encoded blocks with random video data (variable length data packets), the headers are set when sent
+void video_fixture_build_random_blocks(u8 (*pPackets)[MAX_TOTAL_PACKETS_IN_BLOCK][MAX_PACKET_TOTAL_SIZE], int (*piLengths)[MAX_TOTAL_PACKETS_IN_BLOCK],
+   int iCountBlocks, int iDataPackets, int iECPackets, int iPacketSize, u32* puRandom);
+
+typedef void (*video_fixture_output_packet_cb)(type_rx_video_block_info* pBlock, type_rx_video_packet_info* pPacket, void* pContext);
+// Returns true if the incomplete bottom block can be discarded now
+typedef bool (*video_fixture_can_discard_cb)(VideoRxPacketsBuffer* pRxBuffer, type_rx_video_block_info* pBlock, void* pContext);
+
+// Outputs the available video packets in order, discards the incomplete bottom block when pfnCanDiscard allows it.
+// Returns the number of blocks discarded.
+int video_fixture_output_available_packets(VideoRxPacketsBuffer* pRxBuffer, video_fixture_output_packet_cb pfnOutput, video_fixture_can_discard_cb pfnCanDiscard, void* pContext);
+// True if a received (not EC recovered) packet of the block was a retransmitted one
+bool video_fixture_block_has_retransmitted_packets(type_rx_video_block_info* pBlock);
+
+typedef void (*video_fixture_packet_cb)(u8* pPacket, int iLength, void* pContext);
+
+// Returns 1 if the simulated interfaces were opened
+int video_fixture_open_sim_link(u16 uBasePort, type_radio_link_sim_params* pParamsDownlink, type_radio_link_sim_params* pParamsUplink);
+void video_fixture_close_sim_link(type_radio_link_sim_stats* pStatsDownlink, type_radio_link_sim_stats* pStatsUplink);
+// Sends on the downlink (bVehicle) or the uplink
+int video_fixture_send_packet(bool bVehicle, u8* pPacket, int iLength);
+// Reads the packets received by the vehicle (bVehicle) or the station, calls pfnPacket for each valid one
+void video_fixture_read_packets(bool bVehicle, video_fixture_packet_cb pfnPacket, void* pContext);
+// Waits up to iTimeoutMs for received packets. Returns 0 on timeout
+int video_fixture_poll_sim_link(int iTimeoutMs, bool* pbStationHasPackets, bool* pbVehicleHasPackets);
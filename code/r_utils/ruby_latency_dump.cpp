@@ -0,0 +1,164 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/shared_mem.h"
+#include "../base/latency_trace.h"
+
+// Prints the video pipeline latency per stage (count, mean, p50/p95/p99, max),
+// as published by the vehicle and/or station routers (see latency_trace.h)
+
+static bool s_bQuit = false;
+
+void handle_sigint(int sig)
+{
+   s_bQuit = true;
+}
+
+static void _print_stats(const char* szTitle, type_latency_trace_stats* pStats, int iFirstStage, int iLastStage)
+{
+   printf("%s:\n", szTitle);
+   printf("  %-12s %9s %9s %9s %9s %9s %9s\n", "stage", "count", "mean us", "p50 us", "p95 us", "p99 us", "max us");
+   for( int i=iFirstStage; i<=iLastStage; i++ )
+   {
+      type_latency_trace_histogram* pHist = &(pStats->stages[i]);
+      if ( 0 == pHist->uCount )
+      {
+         printf("  %-12s %9u %9s %9s %9s %9s %9s\n", latency_trace_get_stage_name(i), 0, "-", "-", "-", "-", "-");
+         continue;
+      }
+      printf("  %-12s %9u %9u %9u %9u %9u %9u\n", latency_trace_get_stage_name(i),
+         pHist->uCount, (u32)(pHist->uSumMicros/pHist->uCount),
+         latency_trace_histogram_get_percentile(pHist, 50),
+         latency_trace_histogram_get_percentile(pHist, 95),
+         latency_trace_histogram_get_percentile(pHist, 99),
+         pHist->uMaxMicros);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   if ( (argc > 1) && (0 == strcmp(argv[argc-1], "-v")) )
+   {
+      printf("%d.%d (b-%d)", SYSTEM_SW_VERSION_MAJOR, SYSTEM_SW_VERSION_MINOR, SYSTEM_SW_BUILD_NUMBER);
+      return 0;
+   }
+
+   bool bStation = true;
+   bool bVehicle = true;
+   int iWatchSeconds = 0;
+   for( int i=1; i<argc; i++ )
+   {
+      if ( 0 == strcmp(argv[i], "-station") )
+         bVehicle = false;
+      else if ( 0 == strcmp(argv[i], "-vehicle") )
+         bStation = false;
+      else if ( (0 == strcmp(argv[i], "-watch")) && (i < argc-1) )
+         iWatchSeconds = atoi(argv[++i]);
+      else
+      {
+         printf("Usage: ruby_latency_dump [-station | -vehicle] [-watch seconds]\n");
+         printf("  -watch: prints the values over each interval, until stopped\n");
+         return 0;
+      }
+   }
+
+   log_disable();
+
+   type_latency_trace_stats* pSMStats[2] = { NULL, NULL };
+   const char* szNames[2] = { "Vehicle", "Station" };
+   int iFirstStage[2] = { LATENCY_TRACE_STAGE_CAPTURE, LATENCY_TRACE_STAGE_RADIO_RX };
+   int iLastStage[2] = { LATENCY_TRACE_STAGE_RADIO_RX, LATENCY_TRACE_STAGE_OUTPUT };
+   if ( bVehicle )
+      pSMStats[0] = latency_trace_open_for_read(SHARED_MEM_LATENCY_TRACE_VEHICLE);
+   if ( bStation )
+      pSMStats[1] = latency_trace_open_for_read(SHARED_MEM_LATENCY_TRACE_STATION);
+
+   if ( (NULL == pSMStats[0]) && (NULL == pSMStats[1]) )
+   {
+      printf("No latency trace published (the router is not running?)\n");
+      return -1;
+   }
+
+   type_latency_trace_stats* pCurrent = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   type_latency_trace_stats* pPrevious = (type_latency_trace_stats*)calloc(2, sizeof(type_latency_trace_stats));
+   type_latency_trace_stats* pWindow = (type_latency_trace_stats*)malloc(sizeof(type_latency_trace_stats));
+   if ( (NULL == pCurrent) || (NULL == pPrevious) || (NULL == pWindow) )
+      return -1;
+
+   for( int i=0; i<2; i++ )
+   {
+      if ( NULL == pSMStats[i] )
+         continue;
+      latency_trace_snapshot(pSMStats[i], &pPrevious[i]);
+      if ( 0 == iWatchSeconds )
+         _print_stats(szNames[i], &pPrevious[i], iFirstStage[i], iLastStage[i]);
+   }
+
+   if ( iWatchSeconds > 0 )
+   {
+      signal(SIGINT, handle_sigint);
+      signal(SIGTERM, handle_sigint);
+      signal(SIGQUIT, handle_sigint);
+   }
+
+   while ( (iWatchSeconds > 0) && (! s_bQuit) )
+   {
+      sleep(iWatchSeconds);
+      if ( s_bQuit )
+         break;
+      printf("\nLast %d seconds:\n", iWatchSeconds);
+      for( int i=0; i<2; i++ )
+      {
+         if ( NULL == pSMStats[i] )
+            continue;
+         latency_trace_snapshot(pSMStats[i], pCurrent);
+         for( int k=0; k<LATENCY_TRACE_STAGES; k++ )
+            latency_trace_histogram_diff(&(pCurrent->stages[k]), &(pPrevious[i].stages[k]), &(pWindow->stages[k]));
+         memcpy(&pPrevious[i], pCurrent, sizeof(type_latency_trace_stats));
+         _print_stats(szNames[i], pWindow, iFirstStage[i], iLastStage[i]);
+      }
+      fflush(stdout);
+   }
+
+   free(pCurrent);
+   free(pPrevious);
+   free(pWindow);
+   latency_trace_close_for_read(pSMStats[0]);
+   latency_trace_close_for_read(pSMStats[1]);
+   return 0;
+}
@@ -40,9 +40,19 @@
 #include "../base/config.h"
 #include "../base/hardware.h"
 
+#include "../base/log_ring.h"
+
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
+#include <dirent.h>
+#include <signal.h>
+
+#define LOGGER_MAX_RINGS 32
+#define LOGGER_MAX_LINES_PER_BATCH 1024
+#define LOGGER_BATCH_BUFFER_SIZE 262144
+#define LOGGER_IDLE_SLEEP_MS 10
+#define LOGGER_RINGS_SCAN_INTERVAL_MS 100
 
 bool g_bQuit = false;
 int s_iCounter = 0;
@@ -50,6 +60,44 @@ int s_iLogKeyId = LOGGER_MESSAGE_QUEUE_ID;
 
 char s_szLogMsg[256];
 
+typedef struct
+{
+   type_log_ring* pRing;
+   char szName[64];
+   u32 uTimeFirstStaleSlot;
+   u32 uLastDroppedCount;
+} type_logger_ring;
+
+type_logger_ring s_LoggerRings[LOGGER_MAX_RINGS];
+int s_iCountLoggerRings = 0;
+
+// Lines read from the message queue and the rings in one pass, sorted by time before writing them
+typedef struct
+{
+   u32 uTime;
+   u32 uIndex;
+   u32 uOffset;
+   u32 uLength;
+} type_logger_line;
+
+type_logger_line s_BatchLines[LOGGER_MAX_LINES_PER_BATCH];
+int s_iCountBatchLines = 0;
+char s_szBatchText[LOGGER_BATCH_BUFFER_SIZE];
+u32 s_uBatchTextSize = 0;
+u32 s_uLastMsgQueueLineTime = 0;
+
+// Output for each log file, written with one open/write/close per batch
+typedef struct
+{
+   char szFile[256];
+   char szBuffer[LOGGER_BATCH_BUFFER_SIZE];
+   u32 uSize;
+} type_logger_output;
+
+type_logger_output s_OutputSystem;
+type_logger_output s_OutputErrors;
+type_logger_output s_OutputSoftErrors;
+
 void _log_logger_message(const char* szMsg)
 {
    s_iCounter++;
@@ -111,6 +159,200 @@ int _open_msg_queue()
 }
 
 
+void _output_flush(type_logger_output* pOutput)
+{
+   if ( 0 == pOutput->uSize )
+      return;
+   FILE* fd = fopen(pOutput->szFile, "a+");
+   if ( NULL != fd )
+   {
+      fwrite(pOutput->szBuffer, 1, pOutput->uSize, fd);
+      fclose(fd);
+   }
+   pOutput->uSize = 0;
+}
+
+void _output_add_line(type_logger_output* pOutput, const char* szText, u32 uLength)
+{
+   if ( pOutput->uSize + uLength + 1 > sizeof(pOutput->szBuffer) )
+      _output_flush(pOutput);
+   if ( uLength + 1 > sizeof(pOutput->szBuffer) )
+      uLength = sizeof(pOutput->szBuffer) - 1;
+   memcpy(pOutput->szBuffer + pOutput->uSize, szText, uLength);
+   pOutput->uSize += uLength;
+   pOutput->szBuffer[pOutput->uSize++] = '\n';
+}
+
+void _rings_scan()
+{
+   // Remove the rings of the processes that ended, once they are empty
+   for( int i=0; i<s_iCountLoggerRings; i++ )
+   {
+      type_log_ring* pRing = s_LoggerRings[i].pRing;
+      if ( (0 == kill(pRing->iPid, 0)) || (errno != ESRCH) || (log_ring_get_pending_count(pRing) > 0) )
+         continue;
+      log_line("Removed log ring %s of ended process %s (PID %d), %u lines dropped.", s_LoggerRings[i].szName, pRing->szComponentName, pRing->iPid, pRing->uTotalDropped);
+      log_ring_close(pRing);
+      shm_unlink(s_LoggerRings[i].szName);
+      s_LoggerRings[i] = s_LoggerRings[s_iCountLoggerRings-1];
+      s_iCountLoggerRings--;
+      i--;
+   }
+
+   DIR* pDir = opendir("/dev/shm");
+   if ( NULL == pDir )
+      return;
+   struct dirent* pEntry = NULL;
+   while ( (NULL != (pEntry = readdir(pDir))) && (s_iCountLoggerRings < LOGGER_MAX_RINGS) )
+   {
+      if ( 0 != strncmp(pEntry->d_name, LOG_RING_SHM_PREFIX, strlen(LOG_RING_SHM_PREFIX)) )
+         continue;
+      char szName[64];
+      snprintf(szName, sizeof(szName), "/%s", pEntry->d_name);
+      bool bOpened = false;
+      for( int i=0; i<s_iCountLoggerRings; i++ )
+      {
+         if ( 0 == strcmp(s_LoggerRings[i].szName, szName) )
+            bOpened = true;
+      }
+      if ( bOpened )
+         continue;
+      type_log_ring* pRing = log_ring_open(szName);
+      if ( NULL == pRing )
+         continue;
+      memset(&s_LoggerRings[s_iCountLoggerRings], 0, sizeof(type_logger_ring));
+      s_LoggerRings[s_iCountLoggerRings].pRing = pRing;
+      strcpy(s_LoggerRings[s_iCountLoggerRings].szName, szName);
+      s_iCountLoggerRings++;
+      log_line("Opened log ring %s of process %s (PID %d), %d pending lines.", szName, pRing->szComponentName, pRing->iPid, log_ring_get_pending_count(pRing));
+   }
+   closedir(pDir);
+}
+
+int _compare_batch_lines(const void* pA, const void* pB)
+{
+   const type_logger_line* pLineA = (const type_logger_line*)pA;
+   const type_logger_line* pLineB = (const type_logger_line*)pB;
+   if ( pLineA->uTime != pLineB->uTime )
+      return (pLineA->uTime < pLineB->uTime)?-1:1;
+   return (pLineA->uIndex < pLineB->uIndex)?-1:1;
+}
+
+bool _batch_has_room()
+{
+   if ( s_iCountBatchLines >= LOGGER_MAX_LINES_PER_BATCH )
+      return false;
+   if ( s_uBatchTextSize + 2*MAX_SERVICE_LOG_ENTRY_LENGTH > sizeof(s_szBatchText) )
+      return false;
+   return true;
+}
+
+// The line text is already in s_szBatchText at s_uBatchTextSize
+void _batch_add_line(u32 uTime, int iLineLength)
+{
+   if ( iLineLength > 2*MAX_SERVICE_LOG_ENTRY_LENGTH-1 )
+      iLineLength = 2*MAX_SERVICE_LOG_ENTRY_LENGTH-1;
+   s_BatchLines[s_iCountBatchLines].uTime = uTime;
+   s_BatchLines[s_iCountBatchLines].uIndex = (u32)s_iCountBatchLines;
+   s_BatchLines[s_iCountBatchLines].uOffset = s_uBatchTextSize;
+   s_BatchLines[s_iCountBatchLines].uLength = (u32)iLineLength;
+   s_uBatchTextSize += (u32)iLineLength;
+   s_iCountBatchLines++;
+}
+
+// Message queue lines are already formatted: "S<boot>-<h>:<mm>:<ss>.<ms> <loop> <component>: <text>".
+// Lines without a valid time keep the time of the previous line.
+u32 _msgqueue_get_line_time(const char* szText)
+{
+   int iBoot = 0, iHours = 0, iMinutes = 0, iSeconds = 0, iMilis = 0;
+   if ( 5 == sscanf(szText, "S%d-%d:%d:%d.%d", &iBoot, &iHours, &iMinutes, &iSeconds, &iMilis) )
+   if ( (iHours >= 0) && (iMinutes >= 0) && (iSeconds >= 0) && (iMilis >= 0) )
+      s_uLastMsgQueueLineTime = (((u32)iHours*60 + (u32)iMinutes)*60 + (u32)iSeconds)*1000 + (u32)iMilis;
+   return s_uLastMsgQueueLineTime;
+}
+
+// Returns the number of lines read from the message queue
+int _msgqueue_read_batch(int* piLogMsgQueue)
+{
+   type_log_message_buffer logMessage;
+   int iCountLines = 0;
+   while ( (!g_bQuit) && _batch_has_room() )
+   {
+      int len = msgrcv(*piLogMsgQueue, &logMessage, MAX_SERVICE_LOG_ENTRY_LENGTH, 0, MSG_NOERROR | IPC_NOWAIT);
+      if ( len < 0 )
+      if ( (errno == ENOMSG) || (errno == EINTR) )
+         break;
+      if ( len <= 0 )
+      {
+          sprintf(s_szLogMsg, "Failed to read log message queue. Error code: %d, (%s)", errno, strerror(errno));
+          log_line(s_szLogMsg);
+          _log_logger_message(s_szLogMsg);
+          *piLogMsgQueue = _open_msg_queue();
+          if ( *piLogMsgQueue < 0 )
+             g_bQuit = true;
+          break;
+      }
+      logMessage.text[len-1] = 0;
+      iCountLines++;
+      u32 uLength = strlen(logMessage.text);
+      memcpy(s_szBatchText + s_uBatchTextSize, logMessage.text, uLength);
+      _batch_add_line(_msgqueue_get_line_time(logMessage.text), (int)uLength);
+      if ( logMessage.type == 2 )
+         _output_add_line(&s_OutputSoftErrors, logMessage.text, uLength);
+      if ( logMessage.type == 3 )
+         _output_add_line(&s_OutputErrors, logMessage.text, uLength);
+   }
+   return iCountLines;
+}
+
+// Returns the number of lines read from all the rings
+int _rings_read_batch()
+{
+   int iCountLines = 0;
+   char szText[MAX_SERVICE_LOG_ENTRY_LENGTH];
+   char szTime[64];
+
+   for( int i=0; i<s_iCountLoggerRings; i++ )
+   {
+      type_logger_ring* pLoggerRing = &s_LoggerRings[i];
+      while ( _batch_has_room() )
+      {
+         u32 uTime = 0, uLoopCounter = 0;
+         int iLength = log_ring_read_line(pLoggerRing->pRing, szText, sizeof(szText), &uTime, &uLoopCounter, &pLoggerRing->uTimeFirstStaleSlot);
+         if ( iLength < 0 )
+            continue;
+         if ( 0 == iLength )
+            break;
+         log_format_time_loop_counter(uTime, uLoopCounter, szTime);
+         int iLineLength = snprintf(s_szBatchText + s_uBatchTextSize, 2*MAX_SERVICE_LOG_ENTRY_LENGTH, "S%s %s: %s", szTime, pLoggerRing->pRing->szComponentName, szText);
+         if ( iLineLength <= 0 )
+            continue;
+         _batch_add_line(uTime, iLineLength);
+         iCountLines++;
+      }
+
+      u32 uDropped = pLoggerRing->pRing->uTotalDropped;
+      if ( uDropped != pLoggerRing->uLastDroppedCount )
+      {
+         snprintf(szText, sizeof(szText), "S[Logger] %u log lines dropped by %s (log ring full)", uDropped - pLoggerRing->uLastDroppedCount, pLoggerRing->pRing->szComponentName);
+         _output_add_line(&s_OutputSystem, szText, strlen(szText));
+         pLoggerRing->uLastDroppedCount = uDropped;
+      }
+   }
+
+   return iCountLines;
+}
+
+void _batch_write()
+{
+   if ( s_iCountBatchLines > 1 )
+      qsort(s_BatchLines, s_iCountBatchLines, sizeof(type_logger_line), _compare_batch_lines);
+   for( int i=0; i<s_iCountBatchLines; i++ )
+      _output_add_line(&s_OutputSystem, s_szBatchText + s_BatchLines[i].uOffset, s_BatchLines[i].uLength);
+   s_iCountBatchLines = 0;
+   s_uBatchTextSize = 0;
+}
+
 void _log_platform(bool bNewLine)
 {
    #if defined(HW_PLATFORM_OPENIPC_CAMERA)
@@ -152,8 +394,6 @@ int main(int argc, char *argv[])
    log_init_local_only("RubyLogger");
    log_arguments(argc, argv);
 
-   type_log_message_buffer logMessage;
-
    int iLogMsgQueue = _open_msg_queue();
 
    if ( iLogMsgQueue < 0 )
@@ -166,73 +406,36 @@ int main(int argc, char *argv[])
 
    _log_logger_message("Started");
 
-   char szFileLog[256];
-   strcpy(szFileLog, FOLDER_LOGS);
-   strcat(szFileLog, LOG_FILE_SYSTEM);
-   char szFileErrors[256];
-   strcpy(szFileErrors, FOLDER_LOGS);
-   strcat(szFileErrors, LOG_FILE_ERRORS);
-   char szFileSoft[256];
-   strcpy(szFileSoft, FOLDER_LOGS);
-   strcat(szFileSoft, LOG_FILE_ERRORS_SOFT);
+   strcpy(s_OutputSystem.szFile, FOLDER_LOGS);
+   strcat(s_OutputSystem.szFile, LOG_FILE_SYSTEM);
+   strcpy(s_OutputErrors.szFile, FOLDER_LOGS);
+   strcat(s_OutputErrors.szFile, LOG_FILE_ERRORS);
+   strcpy(s_OutputSoftErrors.szFile, FOLDER_LOGS);
+   strcat(s_OutputSoftErrors.szFile, LOG_FILE_ERRORS_SOFT);
 
+   // Processes send the errors (and log lines when they don't have a log ring) on the message queue;
+   // regular log lines are read from the processes log rings. Everything is written in batches.
+   u32 uTimeLastRingsScan = 0;
    while ( !g_bQuit )
    {
-      // This is blocking
-      int len = msgrcv(iLogMsgQueue, &logMessage, MAX_SERVICE_LOG_ENTRY_LENGTH, 0, MSG_NOERROR);
-      if ( g_bQuit )
-         break;
-      
-      if ( len <= 0 )
+      u32 uTimeNow = get_current_timestamp_ms();
+      if ( uTimeNow >= uTimeLastRingsScan + LOGGER_RINGS_SCAN_INTERVAL_MS )
       {
-          sprintf(s_szLogMsg, "Failed to read log message queue. Error code: %d, (%s)", errno, strerror(errno));
-          log_line(s_szLogMsg);
-          _log_logger_message(s_szLogMsg);
-          iLogMsgQueue = _open_msg_queue();
-          if ( iLogMsgQueue < 0 )
-          {
-             g_bQuit = true;
-             break;
-          }
-          else
-             continue;
+         uTimeLastRingsScan = uTimeNow;
+         _rings_scan();
       }
-      logMessage.text[len-1] = 0;
-      //sprintf(szTmp, "len %d", len);
-      //_log_logger_message(szTmp);
-      //_log_logger_message(logMessage.text);
-      //log_line("Received message type: %d, length: %d bytes", logMessage.type, len);
 
-      //if ( logMessage.type == 1 )
-      if ( 1 )
-      {
-         FILE* fd = fopen(szFileLog, "a+");
-         if ( NULL != fd )
-         {
-            fprintf(fd, "%s\n", logMessage.text);
-            fclose(fd);
-         }
-      }
+      // Message queue and rings lines are written together, in time order
+      int iCountLines = _msgqueue_read_batch(&iLogMsgQueue);
+      iCountLines += _rings_read_batch();
+      _batch_write();
 
-      if ( logMessage.type == 2 )
-      {
-         FILE* fd = fopen(szFileSoft, "a+");
-         if ( NULL != fd )
-         {
-            fprintf(fd, "%s\n", logMessage.text);
-            fclose(fd);
-         }
-      }
+      _output_flush(&s_OutputSystem);
+      _output_flush(&s_OutputSoftErrors);
+      _output_flush(&s_OutputErrors);
 
-      if ( logMessage.type == 3 )
-      {
-         FILE* fd = fopen(szFileErrors, "a+");
-         if ( NULL != fd )
-         {
-            fprintf(fd, "%s\n", logMessage.text);
-            fclose(fd);
-         }
-      }
+      if ( 0 == iCountLines )
+         hardware_sleep_ms(LOGGER_IDLE_SLEEP_MS);
    }
 
    if ( iLogMsgQueue >= 0 )
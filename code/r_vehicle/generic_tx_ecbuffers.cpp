@@ -43,6 +43,7 @@
 GenericTxECBuffers::GenericTxECBuffers()
 {
    m_bEnableCRC = false;
+   m_bProgressiveECEncoding = true;
    m_iMaxBlocks = 0;
    m_pBlocks = NULL;
    m_uBlockDataPackets = 0;
@@ -51,6 +52,7 @@ GenericTxECBuffers::GenericTxECBuffers()
 
    m_uCurrentBlockIndex = 0;
    m_uCurrentBlockPacketIndex = 0;
+   m_uProgressiveECDataPacketsAdded = 0;
    m_iBottomBufferIndex = 0;
    m_iTopBufferIndex = 0;
    m_iBottomBufferIndexFirstUnsend = 0;
@@ -96,6 +98,7 @@ void GenericTxECBuffers::_reinitBuffers()
 
    m_uCurrentBlockIndex = 0;
    m_uCurrentBlockPacketIndex = 0;
+   m_uProgressiveECDataPacketsAdded = 0;
    m_iBottomBufferIndex = 0;
    m_iTopBufferIndex = 0;
    m_iBottomBufferIndexFirstUnsend = 0;
@@ -135,6 +138,28 @@ void GenericTxECBuffers::_reinitBuffers()
    }
 }
 
+void GenericTxECBuffers::setProgressiveECEncoding(bool bEnable)
+{
+   m_bProgressiveECEncoding = bEnable;
+}
+
+// Folds a just completed data packet into the EC packets of the current block,
+// so the EC data is ready as soon as the last data packet of the block is added.
+void GenericTxECBuffers::_addDataPacketToECData(u32 uPacketIndex)
+{
+   if ( (! m_bProgressiveECEncoding) || (0 == m_uBlockECPackets) || (NULL == m_pBlocks) )
+      return;
+   // Data packets must be added in order, otherwise the block falls back to full encoding when closed
+   if ( uPacketIndex != m_uProgressiveECDataPacketsAdded )
+      return;
+
+   for(u32 u=0; u<m_uBlockECPackets; u++ )
+      m_p_ec_ec_packets[u] = &(m_pBlocks[m_iTopBufferIndex].pPackets[u + m_uBlockDataPackets]->uPacketData[0]);
+
+   fec_encode_add_data_block(m_iBlockPacketLength, &(m_pBlocks[m_iTopBufferIndex].pPackets[uPacketIndex]->uPacketData[0]), uPacketIndex, m_p_ec_ec_packets, (unsigned int)m_uBlockECPackets);
+   m_uProgressiveECDataPacketsAdded++;
+}
+
 void GenericTxECBuffers::_computeECDataOnCurrentBlock()
 {
    if ( 0 == m_uBlockECPackets )
@@ -142,13 +167,17 @@ void GenericTxECBuffers::_computeECDataOnCurrentBlock()
    if ( (NULL == m_pBlocks) || (m_pBlocks[m_iTopBufferIndex].iFilledPackets < (int)m_uBlockDataPackets) )
       return;
 
-   for(u32 u=0; u<m_uBlockDataPackets; u++ )
-      m_p_ec_data_packets[u] = &(m_pBlocks[m_iTopBufferIndex].pPackets[u]->uPacketData[0]);
+   // EC data is already computed if all data packets were added progressively
+   if ( m_uProgressiveECDataPacketsAdded != m_uBlockDataPackets )
+   {
+      for(u32 u=0; u<m_uBlockDataPackets; u++ )
+         m_p_ec_data_packets[u] = &(m_pBlocks[m_iTopBufferIndex].pPackets[u]->uPacketData[0]);
 
-   for(u32 u=0; u<m_uBlockECPackets; u++ )
-      m_p_ec_ec_packets[u] = &(m_pBlocks[m_iTopBufferIndex].pPackets[u + m_uBlockDataPackets]->uPacketData[0]);
+      for(u32 u=0; u<m_uBlockECPackets; u++ )
+         m_p_ec_ec_packets[u] = &(m_pBlocks[m_iTopBufferIndex].pPackets[u + m_uBlockDataPackets]->uPacketData[0]);
 
-   fec_encode(m_iBlockPacketLength, m_p_ec_data_packets, (unsigned int)m_uBlockDataPackets, m_p_ec_ec_packets, (unsigned int)m_uBlockECPackets);
+      fec_encode(m_iBlockPacketLength, m_p_ec_data_packets, (unsigned int)m_uBlockDataPackets, m_p_ec_ec_packets, (unsigned int)m_uBlockECPackets);
+   }
    
    for(u32 u=0; u<m_uBlockECPackets; u++ )
    {
@@ -194,12 +223,14 @@ int GenericTxECBuffers::addData(u8* pData, int iDataLength)
             u32 uCRC = base_compute_crc32(&(m_pBlocks[m_iTopBufferIndex].pPackets[m_uCurrentBlockPacketIndex]->uPacketData[sizeof(u32)]), m_iBlockPacketLength - sizeof(u32));
             memcpy(&(m_pBlocks[m_iTopBufferIndex].pPackets[m_uCurrentBlockPacketIndex]->uPacketData[0]), (u8*)&uCRC, sizeof(u32));
          }
+         _addDataPacketToECData(m_uCurrentBlockPacketIndex);
          m_pBlocks[m_iTopBufferIndex].iFilledPackets++;
          m_uCurrentBlockPacketIndex++;
          if ( m_uCurrentBlockPacketIndex >= m_uBlockDataPackets )
          {
             _computeECDataOnCurrentBlock();
             m_uCurrentBlockPacketIndex = 0;
+            m_uProgressiveECDataPacketsAdded = 0;
             m_uCurrentBlockIndex++;
             m_iTopBufferIndex++;
             if ( m_iTopBufferIndex >= m_iMaxBlocks )
@@ -24,6 +24,7 @@ class GenericTxECBuffers
       virtual ~GenericTxECBuffers();
 
       void init(int iMaxBlocks, bool bEnableCRC, u32 uDataPackets, u32 uECPackets, int iPacketLength);
+      void setProgressiveECEncoding(bool bEnable);
       int addData(u8* pData, int iDataLength);
       int getUnsendPacketsCount();
       type_generic_tx_ec_packet* getMarkFirstUnsendPacket(u32* puBlockIndex, int* piBufferIndex, int* piPacketIndex);
@@ -34,7 +35,10 @@ class GenericTxECBuffers
       void _deleteBuffers();
       void _reinitBuffers();
       void _computeECDataOnCurrentBlock();
+      void _addDataPacketToECData(u32 uPacketIndex);
       bool m_bEnableCRC;
+      bool m_bProgressiveECEncoding;
+      u32  m_uProgressiveECDataPacketsAdded;
       int  m_iMaxBlocks;
       type_generic_tx_ec_block* m_pBlocks;
       u32  m_uBlockDataPackets;
@@ -951,6 +951,8 @@ bool _send_packet_to_wifi_radio_interface(int iLocalRadioLinkId, int iRadioInter
          if ( (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_DATA) || (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_ALL) )
             be = 1;
       }
+      if ( be && (g_pCurrentModel->enc_flags & MODEL_ENC_FLAG_ENC_AEAD) )
+         be = ENC_MODE_AEAD;
    }
 
    int iDataRateTx = _compute_packet_downlink_datarate_radioflags_tx_power(pPacketData, iVehicleRadioLinkId, iRadioInterfaceIndex);
@@ -966,13 +968,22 @@ bool _send_packet_to_wifi_radio_interface(int iLocalRadioLinkId, int iRadioInter
       }
    }
 
-   int totalLength = radio_build_new_raw_ieee_packet(iLocalRadioLinkId, s_RadioRawPacket, pPacketData, nPacketLength, RADIO_PORT_ROUTER_DOWNLINK, be);
-
    int iRepeatCount = 0;
    if ( pPH->packet_type == PACKET_TYPE_VIDEO_ADAPTIVE_VIDEO_PARAMS_ACK )
       iRepeatCount++;
 
-   if ( radio_write_raw_ieee_packet(iRadioInterfaceIndex, s_RadioRawPacket, totalLength, iRepeatCount) )
+   // If a tx batch or paced tx is in progress, build the radio frame directly in the batch/pacer queue
+   u8* pRawPacket = NULL;
+   if ( 0 == iRepeatCount )
+      pRawPacket = radio_get_tx_batch_frame_buffer(iRadioInterfaceIndex);
+   if ( (NULL == pRawPacket) && (0 == iRepeatCount) )
+      pRawPacket = radio_get_paced_tx_frame_buffer(iRadioInterfaceIndex);
+   if ( NULL == pRawPacket )
+      pRawPacket = s_RadioRawPacket;
+
+   int totalLength = radio_build_new_raw_ieee_packet(iLocalRadioLinkId, pRawPacket, pPacketData, nPacketLength, RADIO_PORT_ROUTER_DOWNLINK, be);
+
+   if ( radio_write_raw_ieee_packet(iRadioInterfaceIndex, pRawPacket, totalLength, iRepeatCount) )
    {       
       radio_stats_update_on_packet_sent_on_radio_interface(&g_SM_RadioStats, g_TimeNow, iRadioInterfaceIndex, nPacketLength);
       radio_stats_set_tx_radio_datarate_for_packet(&g_SM_RadioStats, iRadioInterfaceIndex, iLocalRadioLinkId, iDataRateTx, bIsAudioVideoPacket?1:0);
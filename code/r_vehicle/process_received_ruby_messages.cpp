@@ -224,6 +224,12 @@ int process_received_ruby_message_from_controller(int iInterfaceIndex, u8* pPack
 
       if ( (uDeveloperFlags & DEVELOPER_FLAGS_USE_PCAP_RADIO_TX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_PCAP_RADIO_TX) )
          bUpdated = true;
+      if ( (uDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX) )
+         bUpdated = true;
+      if ( (uDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX) )
+         bUpdated = true;
+      if ( (uDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX) )
+         bUpdated = true;
 
       if ( bUpdated )
          saveCurrentModel();
@@ -36,6 +36,7 @@
 #include "../radio/radiolink.h"
 #include "../radio/radiopackets2.h"
 #include "../radio/fec.h"
+#include "../radio/video_nack.h"
 #include "../base/camera_utils.h"
 #include "../base/parser_h264.h"
 #include "../common/string_utils.h"
@@ -271,15 +272,25 @@ bool process_data_tx_video_command(int iRadioInterface, u8* pPacketBuffer)
       
       if ( uRetrId == s_uLastRecvRetransmissionId )
       {
-         log_line("[TxVideoProc] Received duplicate retr request id %u from controller for %d packets, flags: %s %s, last request was %u ms ago. Ignored.",
-            uRetrId, (int)uCount, (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
+         log_line("[TxVideoProc] Received duplicate retr request id %u from controller for %d %s, flags: %s %s, last request was %u ms ago. Ignored.",
+            uRetrId, (int)uCount, (uFlags & VIDEO_NACK_FLAG_COALESCED)?"blocks":"packets", (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
             g_TimeNow - s_uTimeLastRetransmissionRequest);
          s_uTimeLastRetransmissionRequest = g_TimeNow;
          return false;
       }
 
-      log_line("[TxVideoProc] Received retr request id %u from controller for %d packets, flags: %s %s, lost retransmissions requests: %d, last request was %u ms ago.",
-         uRetrId, (int)uCount, (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
+      // Individual packets requests are parsed to the same per block masks as the coalesced requests
+      type_video_nack_request request;
+      int iParsedLength = video_nack_parse_request(pPacketBuffer + sizeof(t_packet_header), (int)pPH->total_length - (int)sizeof(t_packet_header), &request);
+      if ( iParsedLength < 0 )
+      {
+         log_softerror_and_alarm("[TxVideoProc] Received invalid retr request id %u from controller for %d %s, length: %d bytes. Ignored.", uRetrId, (int)uCount, (uFlags & VIDEO_NACK_FLAG_COALESCED)?"blocks":"packets", (int)pPH->total_length);
+         return false;
+      }
+      int iCountPackets = video_nack_count_requests(request.uMasks, request.iCountBlocks);
+
+      log_line("[TxVideoProc] Received retr request id %u from controller for %d packets (%d %s), flags: %s %s, lost retransmissions requests: %d, last request was %u ms ago.",
+         uRetrId, iCountPackets, (int)uCount, (uFlags & VIDEO_NACK_FLAG_COALESCED)?"blocks":"entries", (uFlags & 0x01)?"has re-requested packets":"", (uFlags & (0x01<<2))?"has frame eof request":"",
          uRetrId - s_uLastRecvRetransmissionId - 1, g_TimeNow - s_uTimeLastRetransmissionRequest);
       s_uTimeLastRetransmissionRequest = g_TimeNow;
 
@@ -288,21 +299,25 @@ bool process_data_tx_video_command(int iRadioInterface, u8* pPacketBuffer)
       {
          if ( iCounter > 0 )
             log_line("[TxVideoProc] Duplicate the retransmission id %u", uRetrId);
-         u8* pDataPackets = pPacketBuffer + sizeof(t_packet_header) + sizeof(u32) + 3*sizeof(u8);
-         for( int i=0; i<(int)uCount; i++ )
+         for( int i=0; i<request.iCountBlocks; i++ )
          {
-            u32 uBlockId = 0;
-            u8 uPacketIndex = 0;
-            memcpy(&uBlockId, pDataPackets, sizeof(u32));
-            pDataPackets += sizeof(u32);
-            uPacketIndex = (u8) *pDataPackets;
-            pDataPackets++;
-            if ( uPacketIndex == 0xFF )
-               log_line("[TxVideoProc] Received request for full video block [%u] in retr id %u", uBlockId, uRetrId);
-            g_pVideoTxBuffers->resendVideoPacket(uRetrId, uBlockId, (u32)uPacketIndex);
+            if ( VIDEO_NACK_MASK_FULL_BLOCK == request.uMasks[i] )
+            {
+               log_line("[TxVideoProc] Received request for full video block [%u] in retr id %u", request.uBlockIndexes[i], uRetrId);
+               g_pVideoTxBuffers->resendVideoPacket(uRetrId, request.uBlockIndexes[i], 0xFF);
+               continue;
+            }
+            u32 uMask = request.uMasks[i];
+            while ( 0 != uMask )
+            {
+               u32 uPacketIndex = (u32)__builtin_ctz(uMask);
+               uMask &= uMask - 1;
+               g_pVideoTxBuffers->resendVideoPacket(uRetrId, request.uBlockIndexes[i], uPacketIndex);
+            }
          }
-         if ( uFlags & (0x01<<2) )
+         if ( (uFlags & (0x01<<2)) && ((int)sizeof(t_packet_header) + iParsedLength + (int)(sizeof(u16) + sizeof(u8)) <= (int)pPH->total_length) )
          {
+             u8* pDataPackets = pPacketBuffer + sizeof(t_packet_header) + iParsedLength;
              u16 uFrameIndex = 0;
              memcpy(&uFrameIndex, pDataPackets, sizeof(u16));
              pDataPackets += sizeof(u16);
@@ -320,9 +335,9 @@ bool process_data_tx_video_command(int iRadioInterface, u8* pPacketBuffer)
             iMaxCountThreshold = 8;
 
          if ( (g_pCurrentModel->video_link_profiles[g_pCurrentModel->video_params.iCurrentVideoProfile].uProfileFlags & VIDEO_PROFILE_FLAG_RETRANSMISSIONS_AGGRESIVE) || (uFlags & 0x01) )
-         if ( (s_uLastRecvRetransmissionId != uRetrId) && (uCount < iMaxCountThreshold) )
+         if ( (s_uLastRecvRetransmissionId != uRetrId) && (iCountPackets < iMaxCountThreshold) )
             bDuplicate = true;
-         if ( uCount < iMaxCountThreshold )
+         if ( iCountPackets < iMaxCountThreshold )
          if ( uFlags & 0x01 )
             bDuplicate = true;
 
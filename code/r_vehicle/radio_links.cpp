@@ -631,6 +631,21 @@ bool radio_links_restart(bool bAsync)
    else
       radio_set_use_pcap_for_tx(0);
 
+   if ( g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX )
+      radio_set_use_mmap_ring_for_rx(-1, 1);
+   else
+      radio_set_use_mmap_ring_for_rx(-1, 0);
+
+   if ( g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX )
+      radio_set_use_batched_tx(1);
+   else
+      radio_set_use_batched_tx(0);
+
+   if ( g_pCurrentModel->uDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX )
+      radio_set_use_paced_tx(1, g_pSM_RadioTxPacingStats, g_pCurrentModel->processesPriorities.iThreadPriorityRadioTx);
+   else
+      radio_set_use_paced_tx(0, NULL, 0);
+
    if ( g_pCurrentModel->radioLinksParams.uGlobalRadioLinksFlags & MODEL_RADIOLINKS_FLAGS_BYPASS_SOCKETS_BUFFERS )
       radio_set_bypass_socket_buffers(1);
    else
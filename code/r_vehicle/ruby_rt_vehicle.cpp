@@ -104,6 +104,8 @@
 #include "video_source_majestic.h"
 #include "video_tx_buffers.h"
 #include "negociate_radio.h"
+#include "../base/event_loop.h"
+#include "../base/latency_trace.h"
 
 #define MAX_RECV_UPLINK_HISTORY 12
 #define SEND_ALARM_MAX_COUNT 5
@@ -213,6 +215,17 @@ void checkDeveloperFlagsChanges(u32 uOldDeveloperFlags, u32 uNewDeveloperFlags)
       log_line("Radio Tx mode (PPCAP/Socket) changed. Must reinit radio interfaces (async)...");
       radio_links_restart(true);
    }
+   else if ( (uNewDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_MMAP_RING_RADIO_RX) )
+   {
+      log_line("Radio Rx mode (PPCAP/mmap ring) changed. Must reinit radio interfaces (async)...");
+      radio_links_restart(true);
+   }
+
+   if ( (uNewDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX) )
+      radio_set_use_batched_tx((uNewDeveloperFlags & DEVELOPER_FLAGS_USE_BATCHED_RADIO_TX)?1:0);
+
+   if ( (uNewDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX ) != (uOldDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX) )
+      radio_set_use_paced_tx((uNewDeveloperFlags & DEVELOPER_FLAGS_USE_PACED_VIDEO_TX)?1:0, g_pSM_RadioTxPacingStats, g_pCurrentModel->processesPriorities.iThreadPriorityRadioTx);
 }
 
 void close_and_mark_sik_interfaces_to_reopen()
@@ -991,7 +1004,39 @@ void _broadcast_router_ready()
    log_line("Broadcasted that router is ready.");
 }
 
-void _try_receive_packets(u32 uReadFrameDuration)
+void _check_link_from_controller_lost()
+{
+   if ( (0 != radio_links_get_last_start_time()) && (g_TimeNow > radio_links_get_last_start_time() + 3000) )
+   if ( (NULL != g_pProcessStats) && (0 != g_pProcessStats->lastRadioRxTime) && (g_TimeNow > TIMEOUT_LINK_TO_CONTROLLER_LOST) && (g_pProcessStats->lastRadioRxTime + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow) )
+   {
+      if ( g_TimeLastReceivedFastRadioPacketFromController + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow )
+      if ( g_TimeLastReceivedSlowRadioPacketFromController + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow )
+      if ( g_bHasFastUplinkFromController || g_bHasSlowUplinkFromController )
+      {
+         bool bHadSlowSpeedLink = g_bHasSlowUplinkFromController;
+         bool bHadHighSpeedLink = g_bHasFastUplinkFromController;
+
+         log_line("Link from controller lost. Last received fast radio packet: %u ms ago. Last received slow radio packet: %u ms ago.",
+             g_TimeNow - g_TimeLastReceivedFastRadioPacketFromController,
+             g_TimeNow - g_TimeLastReceivedSlowRadioPacketFromController);
+
+         g_bHasFastUplinkFromController = false;
+         g_bHasSlowUplinkFromController = false;
+
+         if ( bHadHighSpeedLink )
+            g_LastTimeLostFastLinkFromController = g_TimeNow;
+         if ( bHadSlowSpeedLink )
+            g_LastTimeLostSlowLinkFromController = g_TimeNow;
+
+         adaptive_video_on_uplink_lost();
+         //if ( g_pCurrentModel->osd_params.osd_preferences[g_pCurrentModel->osd_params.iCurrentOSDScreen] & OSD_PREFERENCES_BIT_FLAG_SHOW_CONTROLLER_LINK_LOST_ALARM )
+            send_alarm_to_controller(ALARM_ID_LINK_TO_CONTROLLER_LOST, bHadHighSpeedLink?1:0, bHadSlowSpeedLink?1:0, 10);
+      }
+   }
+}
+
+// bWaitForPackets: wait a bit for high priority packets if none are available (polling main loop)
+void _try_receive_packets(u32 uReadFrameDuration, bool bWaitForPackets)
 {
    // Receive any high priority packets, if any
 
@@ -1006,7 +1051,9 @@ void _try_receive_packets(u32 uReadFrameDuration)
 
    u32 uTimeStart = g_TimeNow;
    u32 uTimeoutMicros = 300;
-   if ( (uReadFrameDuration > 0) && (g_pCurrentModel->video_params.iVideoFPS > 0) && (uReadFrameDuration < (u32)1000/g_pCurrentModel->video_params.iVideoFPS/2) )
+   if ( ! bWaitForPackets )
+      uTimeoutMicros = 0;
+   else if ( (uReadFrameDuration > 0) && (g_pCurrentModel->video_params.iVideoFPS > 0) && (uReadFrameDuration < (u32)1000/g_pCurrentModel->video_params.iVideoFPS/2) )
    {
       uTimeoutMicros = (u32)1000*1000/g_pCurrentModel->video_params.iVideoFPS/2;
       if ( uTimeoutMicros > 2000 )
@@ -1075,33 +1122,7 @@ void _try_receive_packets(u32 uReadFrameDuration)
    // Check Radio Rx state
 
    if ( (0 == iCountConsumedHighPrio) && (0 == iCountConsumedRegPrio) )
-   if ( (0 != radio_links_get_last_start_time()) && (g_TimeNow > radio_links_get_last_start_time() + 3000) )
-   if ( (NULL != g_pProcessStats) && (0 != g_pProcessStats->lastRadioRxTime) && (g_TimeNow > TIMEOUT_LINK_TO_CONTROLLER_LOST) && (g_pProcessStats->lastRadioRxTime + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow) )
-   {
-      if ( g_TimeLastReceivedFastRadioPacketFromController + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow )
-      if ( g_TimeLastReceivedSlowRadioPacketFromController + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow )
-      if ( g_bHasFastUplinkFromController || g_bHasSlowUplinkFromController )
-      {
-         bool bHadSlowSpeedLink = g_bHasSlowUplinkFromController;
-         bool bHadHighSpeedLink = g_bHasFastUplinkFromController;
-
-         log_line("Link from controller lost. Last received fast radio packet: %u ms ago. Last received slow radio packet: %u ms ago.",
-             g_TimeNow - g_TimeLastReceivedFastRadioPacketFromController,
-             g_TimeNow - g_TimeLastReceivedSlowRadioPacketFromController);
-
-         g_bHasFastUplinkFromController = false;
-         g_bHasSlowUplinkFromController = false;
-
-         if ( bHadHighSpeedLink )
-            g_LastTimeLostFastLinkFromController = g_TimeNow;
-         if ( bHadSlowSpeedLink )
-            g_LastTimeLostSlowLinkFromController = g_TimeNow;
-
-         adaptive_video_on_uplink_lost();
-         //if ( g_pCurrentModel->osd_params.osd_preferences[g_pCurrentModel->osd_params.iCurrentOSDScreen] & OSD_PREFERENCES_BIT_FLAG_SHOW_CONTROLLER_LINK_LOST_ALARM )
-            send_alarm_to_controller(ALARM_ID_LINK_TO_CONTROLLER_LOST, bHadHighSpeedLink?1:0, bHadSlowSpeedLink?1:0, 10);
-      }
-   }
+      _check_link_from_controller_lost();
 }
 
 void handle_sigint(int sig) 
@@ -1114,6 +1135,10 @@ void handle_sigint(int sig)
 } 
 
 void _main_loop2();
+bool _vehicle_event_loop_init();
+void _vehicle_event_loop_close();
+bool _vehicle_event_loop_is_active();
+void _main_loop_event_driven();
 
 int main(int argc, char *argv[])
 {
@@ -1248,12 +1273,19 @@ int main(int argc, char *argv[])
    packet_utils_init();
    radio_duplicate_detection_init();
 
+   g_pSM_RadioTxPacingStats = shared_mem_radio_tx_pacing_stats_open_for_write();
+   if ( NULL == g_pSM_RadioTxPacingStats )
+      log_softerror_and_alarm("Start sequence: Failed to open radio tx pacing stats shared memory for write.");
+   else
+      memset((u8*)g_pSM_RadioTxPacingStats, 0, sizeof(shared_mem_radio_tx_pacing_stats));
+
    if ( ! radio_links_restart(false) )
    {
       g_bQuit = true;
       packet_utils_uninit();
       shared_mem_process_stats_close(SHARED_MEM_WATCHDOG_ROUTER_TX, g_pProcessStats);
       radio_link_cleanup();
+      shared_mem_radio_tx_pacing_stats_close(g_pSM_RadioTxPacingStats);
       return -1;
    }
 
@@ -1295,6 +1327,8 @@ int main(int argc, char *argv[])
   
    log_line("Start sequence: Done setting up radio stats history.");
 
+   latency_trace_init(SHARED_MEM_LATENCY_TRACE_VEHICLE);
+
    g_TimeNow = get_current_timestamp_ms();
    video_sources_init();
 
@@ -1415,6 +1449,28 @@ int main(int argc, char *argv[])
    u32 uLastLoopTime = g_TimeNow;
    g_pProcessStats->uLoopTimer1 = g_pProcessStats->uLoopTimer2 = g_pProcessStats->uLoopTimer3 = g_pProcessStats->uLoopTimer4 = g_TimeNow;
 
+   _vehicle_event_loop_init();
+
+   while ( (!g_bQuit) && _vehicle_event_loop_is_active() )
+   {
+      g_TimeNow = get_current_timestamp_ms();
+      g_pProcessStats->lastActiveTime = g_TimeNow;
+      g_pProcessStats->uLoopSubStep = 0;
+      g_pProcessStats->uLoopCounter++;
+      g_uLoopCounter++;
+
+      _main_loop_event_driven();
+      if ( NULL != g_pProcessStats )
+         g_pProcessStats->uLoopSubStep = 0xFF;
+
+      if ( is_semaphore_signaled_clear(s_pSemaphoreStop, SEMAPHORE_STOP_VEHICLE_ROUTER) )
+      {
+         log_line("Semaphore to stop is set. Quit now.");
+         g_bQuit = true;
+         break;
+      }
+   }
+
    while ( !g_bQuit )
    {
       g_TimeNow = get_current_timestamp_ms();
@@ -1479,6 +1535,7 @@ int main(int argc, char *argv[])
 
    log_line("Stopping...");
 
+   _vehicle_event_loop_close();
    if ( NULL != s_pSemaphoreStop )
       sem_close(s_pSemaphoreStop);
    sem_unlink(SEMAPHORE_STOP_VEHICLE_ROUTER);
@@ -1494,6 +1551,9 @@ int main(int argc, char *argv[])
    delete g_pProcessorTxVideo;
    delete g_pVideoTxBuffers;
    shared_mem_radio_stats_rx_hist_close(g_pSM_HistoryRxStats);
+   shared_mem_radio_tx_pacing_stats_close(g_pSM_RadioTxPacingStats);
+   g_pSM_RadioTxPacingStats = NULL;
+   latency_trace_close();
    //shared_mem_video_frames_stats_close(g_pSM_VideoInfoStatsCameraOutput);
    //shared_mem_video_frames_stats_radio_out_close(g_pSM_VideoInfoStatsRadioOut);
    shared_mem_process_stats_close(SHARED_MEM_WATCHDOG_ROUTER_TX, g_pProcessStats);
@@ -1638,13 +1698,24 @@ void _show_cam_hist_dbg_stats()
    log_line("* Cam send pctks others time (avg/min/max) ms: %.1f ms, %u ms, %u ms", fTimeSendOtherAvg, uTimeSendOtherMin, uTimeSendOtherMax);
 }
 
-void _main_loop2()
+// Event loop of the router (see _main_loop_event_driven)
+static type_event_loop s_VehicleEventLoop;
+static bool s_bVehicleEventLoopActive = false;
+static int s_iVehicleEventLoopSourceCamera = -1;
+static int s_iVehicleEventLoopSourceRadioRx = -1;
+static u32 s_uVehicleCameraInputOpenCount = 0;
+static u32 s_uVehicleRadioRxStartCount = 0;
+static bool s_bVehicleCameraMidFrame = false;
+static u32 s_uVehicleLastFrameReadAndSendAllDuration = 0;
+static shared_mem_loop_latency_stats_versioned* s_pSMLoopLatency = NULL;
+
+#define VEHICLE_EVENT_LOOP_IPC_PERIOD_MICROS 5000
+#define VEHICLE_EVENT_LOOP_HOUSEKEEPING_PERIOD_MICROS 10000
+
+// Reads the camera data of the current video frame (as much as available) and sends it; after a frame end
+// sends the other pending radio packets too. In the event loop the reads stop when the handler time slice is used up.
+void _main_loop_read_and_send_camera_data(bool bHasCamera, bool* pbReadAnyCameraFrameData, bool* pbEndOfFrame, u32* puLastVideoFrameReadAndSendAllDuration)
 {
-   g_pProcessStats->uLoopSubStep = 1;
-   _update_main_loop_debug_info();
-   g_pProcessStats->uLoopSubStep = 2;
-   
-   bool bHasCamera = g_pCurrentModel->hasCamera();
    bool bEndOfFrame = false;
    bool bReadAnyCameraFrameData = false;
    u32 uLastCameraReadDuration = 0;
@@ -1674,7 +1745,7 @@ void _main_loop2()
             uLastCameraReadDuration = g_TimeNow - uTimeStartFrame;
             adaptive_video_on_end_of_frame();
          }
-      } while ( bReadAnyCameraFrameData && (!bEndOfFrame) && (iCountReadCamera > 0) );
+      } while ( bReadAnyCameraFrameData && (!bEndOfFrame) && (iCountReadCamera > 0) && (! event_loop_slice_expired(&s_VehicleEventLoop)) );
 
       g_pProcessStats->uLoopCounter1 = get_current_timestamp_ms() - g_pProcessStats->uLoopCounter1;
 
@@ -1753,25 +1824,28 @@ void _main_loop2()
       _show_cam_hist_dbg_stats();
    }
 
-   if ( g_pCurrentModel->relay_params.uRelayedVehicleId != 0 )
-   if ( packets_queue_has_packets(&g_QueueRelayRadioPacketsOutToRelayedVehicle) )
-   {
-      g_TimeNow = get_current_timestamp_ms();
-      radio_rx_check_update_eof(g_TimeNow, (((u32)g_pCurrentModel->video_link_profiles[g_pCurrentModel->video_params.iCurrentVideoProfile].uProfileFlags) & VIDEO_PROFILE_FLAG_MASK_RETRANSMISSIONS_GUARD_MASK)>>8, g_pCurrentModel->video_params.iVideoFPS, g_pCurrentModel->getCurrentVideoProfileMaxRetransmissionWindow());
-      bool bIsEOF = radio_rx_is_eof_detected()?true:false;
-
-      if ( bIsEOF || (g_TimeNow > g_QueueRelayRadioPacketsOutToRelayedVehicle.timeFirstPacket + 55) )
-         relay_send_outgoing_radio_packets_to_relayed_vehicle();
-   }
+   *pbReadAnyCameraFrameData = bReadAnyCameraFrameData;
+   *pbEndOfFrame = bEndOfFrame;
+   *puLastVideoFrameReadAndSendAllDuration = uLastVideoFrameReadAndSendAllDuration;
+}
 
-   g_pProcessStats->uLoopTimer2 = get_current_timestamp_ms();
-   g_pProcessStats->uLoopSubStep = 15;
+void _main_loop_check_send_relay_packets()
+{
+   if ( g_pCurrentModel->relay_params.uRelayedVehicleId == 0 )
+      return;
+   if ( ! packets_queue_has_packets(&g_QueueRelayRadioPacketsOutToRelayedVehicle) )
+      return;
 
-   if ( bEndOfFrame || (!bReadAnyCameraFrameData) )
-      _try_receive_packets(uLastVideoFrameReadAndSendAllDuration);
+   g_TimeNow = get_current_timestamp_ms();
+   radio_rx_check_update_eof(g_TimeNow, (((u32)g_pCurrentModel->video_link_profiles[g_pCurrentModel->video_params.iCurrentVideoProfile].uProfileFlags) & VIDEO_PROFILE_FLAG_MASK_RETRANSMISSIONS_GUARD_MASK)>>8, g_pCurrentModel->video_params.iVideoFPS, g_pCurrentModel->getCurrentVideoProfileMaxRetransmissionWindow());
+   bool bIsEOF = radio_rx_is_eof_detected()?true:false;
 
-   g_pProcessStats->uLoopTimer3 = get_current_timestamp_ms();
+   if ( bIsEOF || (g_TimeNow > g_QueueRelayRadioPacketsOutToRelayedVehicle.timeFirstPacket + 55) )
+      relay_send_outgoing_radio_packets_to_relayed_vehicle();
+}
 
+void _main_loop_check_fast_uplink_lost()
+{
    if ( g_TimeLastReceivedFastRadioPacketFromController + TIMEOUT_LINK_TO_CONTROLLER_LOST < g_TimeNow )
    if ( g_bHasFastUplinkFromController )
    if ( (0 != radio_links_get_last_start_time()) && (g_TimeNow > radio_links_get_last_start_time() + 3000) )
@@ -1786,6 +1860,124 @@ void _main_loop2()
       //if ( g_pCurrentModel->osd_params.osd_preferences[g_pCurrentModel->osd_params.iCurrentOSDScreen] & OSD_PREFERENCES_BIT_FLAG_SHOW_CONTROLLER_LINK_LOST_ALARM )
          send_alarm_to_controller(ALARM_ID_LINK_TO_CONTROLLER_LOST, 1, 0, 10);
    }
+}
+
+void _main_loop_process_ipc()
+{
+   _read_ipc_pipes(g_TimeNow);
+   g_pProcessStats->uLoopSubStep = 28;
+
+   _consume_ipc_messages();
+   g_pProcessStats->uLoopSubStep = 29;
+}
+
+// Returns true if the current main loop must stop (router quits or the radio interfaces were reinitialized)
+bool _main_loop_periodic(bool bHasCamera, bool bCanRunAdaptiveVideo)
+{
+   if ( bHasCamera )
+   {
+      process_data_tx_video_loop();
+      if ( bCanRunAdaptiveVideo )
+         adaptive_video_periodic_loop();
+   }
+   g_pProcessStats->uLoopSubStep = 45;
+
+   if ( bHasCamera )
+   if ( video_sources_periodic_health_checks() )
+   {
+      log_line("Router is marked for restart due to video sources periodic health checks. Quit it.");
+      if ( hw_process_exists("sysupgrade") )
+      {
+         log_softerror_and_alarm("Sysupgrade is in progress. Don't do anything else. Just quit.");
+         g_bQuit = true;
+         return true;
+      }
+      if ( packets_queue_has_packets(&g_QueueRadioPacketsOut) )
+      {
+         //g_iDbgCamHistSendOtherCount[g_iDbgCamHistBuffIndex] += process_and_send_packets(false);
+         process_and_send_packets(false);
+      }
+      log_line("Done sending pending radio packets. Quit now.");
+      g_bQuit = true;
+      return true;
+   }
+
+
+   g_pProcessStats->uLoopSubStep = 46;
+   _check_rx_loop_consistency();
+   g_pProcessStats->uLoopSubStep = 47;
+   
+   if ( periodicLoop() )
+   {
+      reinit_radio_interfaces();
+      return true;
+   }
+
+   if ( 0 != s_uStartTimeFlagSendRadioConfigToController )
+   if ( g_TimeNow < s_uStartTimeFlagSendRadioConfigToController + 1000 )
+      send_radio_config_to_controller();
+
+   _synchronize_shared_mems();
+   g_pProcessStats->uLoopSubStep = 49;
+   send_pending_alarms_to_controller();
+   g_pProcessStats->uLoopSubStep = 50;
+
+   if ( bHasCamera && (NULL != g_pProcessorTxAudio) )
+      g_pProcessorTxAudio->tryReadAudioInputStream();
+   g_pProcessStats->uLoopSubStep = 51;
+   return false;
+}
+
+// Send radio packets right away if:
+// * there is no camera (video feed) or it is configuring now
+// otherways, they get sent after a video frame end
+void _main_loop_check_send_pending_radio_packets(bool bHasCamera)
+{
+   if ( ! packets_queue_has_packets(&g_QueueRadioPacketsOut) )
+      return;
+
+   bool bSendNow = false;
+   if ( ! bHasCamera )
+      bSendNow = true;
+   if ( ! video_sources_has_stream_data() )
+      bSendNow = true;
+   if ( video_sources_last_stream_data() < g_TimeNow - 70 )
+      bSendNow = true;
+   if ( 0 == video_sources_get_capture_start_time() )
+      bSendNow = true;
+   //if ( bEndOfFrame || (!bReadAnyCameraFrameData) )
+   //   bSendNow = true;
+   if ( bSendNow )
+   {
+      g_iDbgCamHistSendOtherCount[g_iDbgCamHistBuffIndex] += process_and_send_packets(false);
+      process_and_send_packets(false);
+   }
+}
+
+void _main_loop2()
+{
+   g_pProcessStats->uLoopSubStep = 1;
+   _update_main_loop_debug_info();
+   g_pProcessStats->uLoopSubStep = 2;
+   
+   bool bHasCamera = g_pCurrentModel->hasCamera();
+   bool bEndOfFrame = false;
+   bool bReadAnyCameraFrameData = false;
+   u32 uLastVideoFrameReadAndSendAllDuration = 0;
+
+   _main_loop_read_and_send_camera_data(bHasCamera, &bReadAnyCameraFrameData, &bEndOfFrame, &uLastVideoFrameReadAndSendAllDuration);
+
+   _main_loop_check_send_relay_packets();
+
+   g_pProcessStats->uLoopTimer2 = get_current_timestamp_ms();
+   g_pProcessStats->uLoopSubStep = 15;
+
+   if ( bEndOfFrame || (!bReadAnyCameraFrameData) )
+      _try_receive_packets(uLastVideoFrameReadAndSendAllDuration, true);
+
+   g_pProcessStats->uLoopTimer3 = get_current_timestamp_ms();
+
+   _main_loop_check_fast_uplink_lost();
 
    //-------------------------------------------
    // Process IPCs
@@ -1794,12 +1986,7 @@ void _main_loop2()
    if ( g_TimeNow >= s_uMainLoopIPCCheckLastTime + 10 )
    {
       s_uMainLoopIPCCheckLastTime = g_TimeNow;
-
-      _read_ipc_pipes(g_TimeNow);
-      g_pProcessStats->uLoopSubStep = 28;
-
-      _consume_ipc_messages();
-      g_pProcessStats->uLoopSubStep = 29;
+      _main_loop_process_ipc();
    }
 
    g_pProcessStats->uLoopTimer4 = get_current_timestamp_ms();
@@ -1812,80 +1999,179 @@ void _main_loop2()
    if ( g_TimeNow > s_uMainLoopPeriodicCheckLastTime + 10 )
    {
       s_uMainLoopPeriodicCheckLastTime = g_TimeNow;
+      if ( _main_loop_periodic(bHasCamera, bEndOfFrame || (!bReadAnyCameraFrameData)) )
+         return;
+   }
 
-      if ( bHasCamera )
-      {
-         process_data_tx_video_loop();
-         if ( bEndOfFrame || (!bReadAnyCameraFrameData) )
-            adaptive_video_periodic_loop();
-      }
-      g_pProcessStats->uLoopSubStep = 45;
+   _main_loop_check_send_pending_radio_packets(bHasCamera);
+}
 
-      if ( bHasCamera )
-      if ( video_sources_periodic_health_checks() )
-      {
-         log_line("Router is marked for restart due to video sources periodic health checks. Quit it.");
-         if ( hw_process_exists("sysupgrade") )
-         {
-            log_softerror_and_alarm("Sysupgrade is in progress. Don't do anything else. Just quit.");
-            g_bQuit = true;
-            return;
-         }
-         if ( packets_queue_has_packets(&g_QueueRadioPacketsOut) )
-         {
-            //g_iDbgCamHistSendOtherCount[g_iDbgCamHistBuffIndex] += process_and_send_packets(false);
-            process_and_send_packets(false);
-         }
-         log_line("Done sending pending radio packets. Quit now.");
-         g_bQuit = true;
-         return;
-      }
+//------------------------------------------------------------
+// Event driven main loop: the camera input and the radio rx queues wakeup are waited on with epoll,
+// IPC and the periodic loops run on timers. Camera and radio rx handlers have priority over the others.
 
+static int _vehicle_event_loop_camera_prepare_wait(void* pContext)
+{
+   return video_sources_has_pending_read_data()?1:0;
+}
 
-      g_pProcessStats->uLoopSubStep = 46;
-      _check_rx_loop_consistency();
-      g_pProcessStats->uLoopSubStep = 47;
-      
-      if ( periodicLoop() )
-      {
-         reinit_radio_interfaces();
-         return;
-      }
+static void _vehicle_event_loop_on_camera(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   bool bReadAnyCameraFrameData = false;
+   bool bEndOfFrame = false;
+   u32 uLastVideoFrameReadAndSendAllDuration = 0;
+   _main_loop_read_and_send_camera_data(g_pCurrentModel->hasCamera(), &bReadAnyCameraFrameData, &bEndOfFrame, &uLastVideoFrameReadAndSendAllDuration);
+   if ( bReadAnyCameraFrameData )
+      s_bVehicleCameraMidFrame = ! bEndOfFrame;
+   if ( bReadAnyCameraFrameData && bEndOfFrame )
+      s_uVehicleLastFrameReadAndSendAllDuration = uLastVideoFrameReadAndSendAllDuration;
+}
 
-      if ( 0 != s_uStartTimeFlagSendRadioConfigToController )
-      if ( g_TimeNow < s_uStartTimeFlagSendRadioConfigToController + 1000 )
-         send_radio_config_to_controller();
-
-      _synchronize_shared_mems();
-      g_pProcessStats->uLoopSubStep = 49;
-      send_pending_alarms_to_controller();
-      g_pProcessStats->uLoopSubStep = 50;
-
-      if ( bHasCamera && (NULL != g_pProcessorTxAudio) )
-         g_pProcessorTxAudio->tryReadAudioInputStream();
-      g_pProcessStats->uLoopSubStep = 51;
-   }
-
-   // Send radio packets right away if:
-   // * there is no camera (video feed) or it is configuring now
-   // otherways, they get sent after a video frame end
-   if ( packets_queue_has_packets(&g_QueueRadioPacketsOut) )
-   {
-      bool bSendNow = false;
-      if ( ! bHasCamera )
-         bSendNow = true;
-      if ( ! video_sources_has_stream_data() )
-         bSendNow = true;
-      if ( video_sources_last_stream_data() < g_TimeNow - 70 )
-         bSendNow = true;
-      if ( 0 == video_sources_get_capture_start_time() )
-         bSendNow = true;
-      //if ( bEndOfFrame || (!bReadAnyCameraFrameData) )
-      //   bSendNow = true;
-      if ( bSendNow )
-      {
-         g_iDbgCamHistSendOtherCount[g_iDbgCamHistBuffIndex] += process_and_send_packets(false);
-         process_and_send_packets(false);
-      }
+static int _vehicle_event_loop_radio_rx_prepare_wait(void* pContext)
+{
+   return radio_rx_prepare_wait();
+}
+
+static void _vehicle_event_loop_radio_rx_finish_wait(void* pContext)
+{
+   radio_rx_finish_wait();
+}
+
+static void _vehicle_event_loop_on_radio_rx(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   g_pProcessStats->uLoopTimer2 = g_TimeNow;
+   _try_receive_packets(s_uVehicleLastFrameReadAndSendAllDuration, false);
+   g_pProcessStats->uLoopTimer3 = get_current_timestamp_ms();
+}
+
+static void _vehicle_event_loop_on_ipc(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   _main_loop_process_ipc();
+   g_pProcessStats->uLoopTimer4 = get_current_timestamp_ms();
+}
+
+static void _vehicle_event_loop_on_housekeeping(void* pContext)
+{
+   g_TimeNow = get_current_timestamp_ms();
+   _update_main_loop_debug_info();
+   _main_loop_check_fast_uplink_lost();
+   _check_link_from_controller_lost();
+   _main_loop_periodic(g_pCurrentModel->hasCamera(), ! s_bVehicleCameraMidFrame);
+}
+
+// Camera reads are bounded to half a video frame time on each run
+static u32 _vehicle_event_loop_get_camera_time_slice_micros()
+{
+   if ( (NULL == g_pCurrentModel) || (g_pCurrentModel->video_params.iVideoFPS <= 0) )
+      return 5000;
+   u32 uSlice = 500000 / (u32)g_pCurrentModel->video_params.iVideoFPS;
+   if ( uSlice < 1000 )
+      uSlice = 1000;
+   return uSlice;
+}
+
+// Returns false if the event loop can't be used; the polling main loop is used then
+bool _vehicle_event_loop_init()
+{
+   if ( radio_rx_get_wakeup_fd() < 0 )
+   {
+      log_softerror_and_alarm("[EventLoop] Radio rx has no wakeup fd. Using the polling main loop.");
+      return false;
+   }
+   if ( ! event_loop_init(&s_VehicleEventLoop) )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to create the event loop. Using the polling main loop.");
+      return false;
+   }
+
+   s_uVehicleRadioRxStartCount = radio_rx_get_start_count();
+   int iCameraFd = video_sources_get_read_fd(&s_uVehicleCameraInputOpenCount);
+   s_iVehicleEventLoopSourceCamera = event_loop_add_fd(&s_VehicleEventLoop, "camera", iCameraFd, EVENT_LOOP_PRIORITY_HIGH,
+      _vehicle_event_loop_on_camera, _vehicle_event_loop_camera_prepare_wait, NULL, NULL);
+   s_iVehicleEventLoopSourceRadioRx = event_loop_add_fd(&s_VehicleEventLoop, "radio-rx", radio_rx_get_wakeup_fd(), EVENT_LOOP_PRIORITY_HIGH,
+      _vehicle_event_loop_on_radio_rx, _vehicle_event_loop_radio_rx_prepare_wait, _vehicle_event_loop_radio_rx_finish_wait, NULL);
+   // IPC channels are message queues by default (no fd to wait on), so they are polled
+   int iSourceIPC = event_loop_add_timer(&s_VehicleEventLoop, "ipc", VEHICLE_EVENT_LOOP_IPC_PERIOD_MICROS, EVENT_LOOP_PRIORITY_NORMAL, _vehicle_event_loop_on_ipc, NULL);
+   int iSourceHousekeeping = event_loop_add_timer(&s_VehicleEventLoop, "housekeeping", VEHICLE_EVENT_LOOP_HOUSEKEEPING_PERIOD_MICROS, EVENT_LOOP_PRIORITY_LOW, _vehicle_event_loop_on_housekeeping, NULL);
+
+   if ( (s_iVehicleEventLoopSourceCamera < 0) || (s_iVehicleEventLoopSourceRadioRx < 0) || (iSourceIPC < 0) || (iSourceHousekeeping < 0) )
+   {
+      log_softerror_and_alarm("[EventLoop] Failed to add the event loop sources. Using the polling main loop.");
+      event_loop_close(&s_VehicleEventLoop);
+      return false;
+   }
+   event_loop_set_time_slice(&s_VehicleEventLoop, s_iVehicleEventLoopSourceCamera, _vehicle_event_loop_get_camera_time_slice_micros());
+
+   s_pSMLoopLatency = shared_mem_loop_latency_stats_open_for_write(SHARED_MEM_LOOP_LATENCY_VEHICLE);
+   if ( NULL == s_pSMLoopLatency )
+      log_softerror_and_alarm("[EventLoop] Failed to open shared mem for loop latency stats for write!");
+   event_loop_set_shared_stats(&s_VehicleEventLoop, s_pSMLoopLatency);
+
+   s_bVehicleEventLoopActive = true;
+   log_line("[EventLoop] Using the event driven main loop (camera fd: %d, camera time slice: %u us).", iCameraFd, _vehicle_event_loop_get_camera_time_slice_micros());
+   return true;
+}
+
+void _vehicle_event_loop_close()
+{
+   if ( ! s_bVehicleEventLoopActive )
+      return;
+   event_loop_close(&s_VehicleEventLoop);
+   shared_mem_loop_latency_stats_close(s_pSMLoopLatency);
+   s_pSMLoopLatency = NULL;
+   s_bVehicleEventLoopActive = false;
+}
+
+bool _vehicle_event_loop_is_active()
+{
+   return s_bVehicleEventLoopActive;
+}
+
+void _main_loop_event_driven()
+{
+   bool bHasCamera = g_pCurrentModel->hasCamera();
+
+   // Inputs reopened (camera restarted, radio interfaces reinitialized): watch the new fds
+   u32 uOpenCount = 0;
+   int iCameraFd = video_sources_get_read_fd(&uOpenCount);
+   if ( (iCameraFd != s_VehicleEventLoop.sources[s_iVehicleEventLoopSourceCamera].iFd) || (uOpenCount != s_uVehicleCameraInputOpenCount) )
+   {
+      s_uVehicleCameraInputOpenCount = uOpenCount;
+      event_loop_set_fd(&s_VehicleEventLoop, s_iVehicleEventLoopSourceCamera, iCameraFd);
+      event_loop_set_time_slice(&s_VehicleEventLoop, s_iVehicleEventLoopSourceCamera, _vehicle_event_loop_get_camera_time_slice_micros());
+   }
+   if ( radio_rx_get_start_count() != s_uVehicleRadioRxStartCount )
+   {
+      s_uVehicleRadioRxStartCount = radio_rx_get_start_count();
+      event_loop_set_fd(&s_VehicleEventLoop, s_iVehicleEventLoopSourceRadioRx, radio_rx_get_wakeup_fd());
+      log_line("[EventLoop] Radio rx restarted, updated wakeup fd.");
+   }
+
+   // The camera input is opened on the first read attempts: poll it until it's opened
+   bool bPollCamera = bHasCamera && (iCameraFd < 0);
+   event_loop_run_once(&s_VehicleEventLoop, bPollCamera?2:100);
+   g_TimeNow = get_current_timestamp_ms();
+
+   if ( bPollCamera || (! bHasCamera) )
+      _vehicle_event_loop_on_camera(NULL);
+
+   _main_loop_check_send_relay_packets();
+   _main_loop_check_send_pending_radio_packets(bHasCamera);
+
+   u32 uMaxMicros = 6000 + s_uLastFrameExpectedTxTimeMicros;
+   if ( s_VehicleEventLoop.uLastIterationMicros > uMaxMicros )
+   if ( g_TimeNow > g_TimeStart + 10000 )
+   {
+      log_softerror_and_alarm("Event loop iteration (tx was expected to be %.1f ms) took too long: %u us; cnt1 (read cam ms): %u, cnt4 (sent pckts ms): %u, cnt2: %u, cnt3: %u, cnt5 (sent pckts): %d",
+         (float)s_uLastFrameExpectedTxTimeMicros/1000.0, s_VehicleEventLoop.uLastIterationMicros,
+         g_pProcessStats->uLoopCounter1, g_pProcessStats->uLoopCounter4,
+         g_pProcessStats->uLoopCounter2, g_pProcessStats->uLoopCounter3,
+         g_pProcessStats->uLoopCounter5);
+      if ( bHasCamera )
+      if ( g_pCurrentModel->isActiveCameraCSICompatible() || g_pCurrentModel->isActiveCameraVeye() )
+         video_source_csi_log_input_data();
    }
-}
\ No newline at end of file
+}
@@ -64,6 +64,7 @@ extern bool g_bRadioReinitialized;
 extern shared_mem_radio_stats g_SM_RadioStats;
 extern shared_mem_radio_stats_rx_hist* g_pSM_HistoryRxStats;
 extern shared_mem_radio_stats_rx_hist g_SM_HistoryRxStats;
+extern shared_mem_radio_tx_pacing_stats* g_pSM_RadioTxPacingStats;
 
 extern bool g_bVehicleArmed;
 extern int g_iVehicleSOCTemperatureC;
@@ -68,6 +68,7 @@ static type_camera_parameters s_LastAppliedVeyeCameraParams;
 static video_parameters_t s_LastAppliedVeyeVideoParams;
 
 int s_fInputVideoStreamCSIPipe = -1;
+u32 s_uInputVideoStreamCSIPipeOpenCount = 0;
 char s_szInputVideoStreamCSIPipeName[128];
 bool s_bInputVideoStreamCSIPipeOpenFailed = false;
 u8 s_uInputVideoCSIPipeBuffer[65536];
@@ -388,12 +389,20 @@ int _video_source_csi_open(const char* szPipeName)
    }
 
    s_bInputVideoStreamCSIPipeOpenFailed = false;
+   s_uInputVideoStreamCSIPipeOpenCount++;
    log_line("[VideoSourceCSI] Opened video input stream: %s", s_szInputVideoStreamCSIPipeName);
    log_line("[VideoSourceCSI] Pipe read end flags: %s", str_get_pipe_flags(fcntl(s_fInputVideoStreamCSIPipe, F_GETFL)));
    
    return s_fInputVideoStreamCSIPipe;
 }
 
+int video_source_csi_get_read_fd(u32* puOpenCount)
+{
+   if ( NULL != puOpenCount )
+      *puOpenCount = s_uInputVideoStreamCSIPipeOpenCount;
+   return s_fInputVideoStreamCSIPipe;
+}
+
 void video_source_csi_flush_discard()
 {
    log_line("[VideoSourceCSI] Flushing video stream input buffer (pipe)...");
@@ -1088,6 +1097,12 @@ void video_source_csi_update_camera_params(Model* pModel, int iCameraIndex)
 void video_source_csi_log_input_data() {}
 u32 video_source_csi_get_debug_videobitrate() {return 0;}
 void video_source_csi_flush_discard() {}
+int video_source_csi_get_read_fd(u32* puOpenCount)
+{
+   if ( NULL != puOpenCount )
+      *puOpenCount = 0;
+   return -1;
+}
 int video_source_csi_get_buffer_size() {return 0;}
 u8* video_source_csi_read(int* piReadSize, u32* puOutTimeDataAvailable)
 {
@@ -2,6 +2,8 @@
 #include "../base/base.h"
 
 void video_source_csi_flush_discard();
+// Input pipe fd, -1 if not opened. The open count changes each time the pipe is (re)opened.
+int video_source_csi_get_read_fd(u32* puOpenCount);
 int video_source_csi_get_buffer_size();
 void video_source_csi_log_input_data();
 u32 video_source_csi_get_debug_videobitrate();
@@ -52,6 +52,7 @@
 #include <sched.h>
 
 #include "video_source_majestic.h"
+#include "video_source_udp_batch.h"
 #include "video_sources.h"
 #include "video_tx_buffers.h"
 #include "events.h"
@@ -70,6 +71,7 @@
 //To fix extern ParserH264 s_ParserH264CameraOutput;
 
 int s_fInputVideoStreamUDPSocket = -1;
+u32 s_uInputVideoStreamUDPSocketOpenCount = 0;
 int s_iInputVideoStreamUDPPort = 5600;
 bool s_bInputVideoStreamUSDPSocketSetupNonBlocking = false;
 u16 s_uLastRTPSeqNumberInUDPFrames[256];
@@ -78,6 +80,9 @@ u16 s_uLastRTPSeqNumberInUDPFramesSkipCounter[256];
 bool s_bLogStartOfInputVideoData = true;
 
 u8 s_uInputVideoUDPBuffer[MAX_PACKET_TOTAL_SIZE];
+u8* s_pInputVideoUDPData = s_uInputVideoUDPBuffer; // Last read UDP packet (from the sync read buffer or from the async batch)
+type_udp_batch_reader s_UDPBatchReader;
+bool s_bUDPBatchReaderInitialized = false;
 u8 s_uOutputUDPNALFrameSegment[MAX_PACKET_TOTAL_SIZE+10];
 u8 s_uInputMajAudioBuffer[MAX_AUDIO_MAJ_BUFFER];
 int s_iInputMajAudioBufferBytes = 0;
@@ -85,6 +90,7 @@ int s_iInputMajAudioBufferBytes = 0;
 u32 s_uDebugTimeLastUDPVideoInputCheck = 0;
 u32 s_uDebugUDPInputBytes = 0;
 u32 s_uDebugUDPInputReads = 0;
+u32 s_uDebugUDPInputSyscalls = 0;
 
 u32 s_uLastNALType = 0;
 bool s_bLastReadIsSingleNAL = false;
@@ -227,7 +233,13 @@ int _video_source_majestic_open(int iUDPPort)
       return -1;
    }
 
+   s_uInputVideoStreamUDPSocketOpenCount++;
    log_line("[VideoSourceMaj] Opened read socket on port %d for reading video stream. socket fd = %d", s_iInputVideoStreamUDPPort, s_fInputVideoStreamUDPSocket);
+
+   if ( ! s_bUDPBatchReaderInitialized )
+      s_bUDPBatchReaderInitialized = (0 != video_source_udp_batch_init(&s_UDPBatchReader, s_fInputVideoStreamUDPSocket, UDP_BATCH_MAX_PACKETS));
+   else
+      video_source_udp_batch_set_socket(&s_UDPBatchReader, s_fInputVideoStreamUDPSocket);
    
    return s_fInputVideoStreamUDPSocket;
 }
@@ -406,20 +418,74 @@ void* _thread_restart_majestic(void *argument)
    return NULL;
 }
 
-uint32_t extract_udp_rxq_overflow(struct msghdr *msg)
+static int s_iRxUDPOverflowCounter = 0;
+
+// Returns true if the UDP socket was reopened (too many overflows)
+bool _video_source_majestic_on_udp_rxq_overflow(u32 uDroppedCount)
 {
-    struct cmsghdr *cmsg;
-    uint32_t rtn;
-
-    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
-    {
-        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
-        {
-            memcpy(&rtn, CMSG_DATA(cmsg), sizeof(rtn));
-            return rtn;
-        }
-    }
-    return 0;
+   if ( s_bIsRestartingMajestic )
+   {
+      log_line("[VideoSourceMaj] UDP dropped %u packets while restarting majestic.", uDroppedCount);
+      return false;
+   }
+   log_softerror_and_alarm("[VideoSourceMaj] UDP rxq overflow: %u packets dropped (total socket drops: %u), overflow counter: %d", uDroppedCount, s_UDPBatchReader.uLastRxqOverflowCounter, s_iRxUDPOverflowCounter);
+   log_softerror_and_alarm("[VideoSourceMaj] Last 4 majestic UDP reads: %u ms ago, %u ms ago, %u ms ago, %u ms ago",
+      s_uLastVideoSourceReadTimestamps[1] - g_TimeNow, s_uLastVideoSourceReadTimestamps[2] - g_TimeNow, s_uLastVideoSourceReadTimestamps[3] - g_TimeNow, s_uLastVideoSourceReadTimestamps[4] - g_TimeNow );
+   s_iRxUDPOverflowCounter++;
+   if ( uDroppedCount > 1 )
+   if ( g_TimeNow > s_uLastAlarmUDPOveflowTimestamp + 10000 )
+   if ( g_TimeNow > g_TimeStart + 10000 )
+   if ( g_TimeNow > hardware_camera_maj_get_last_change_time() + 3000 )
+   {
+      s_uLastAlarmUDPOveflowTimestamp = g_TimeNow;
+      u32 uFlags2 = 0;
+      u32 uDelta = s_uLastVideoSourceReadTimestamps[0] - s_uLastVideoSourceReadTimestamps[1];
+      if ( uDelta > 255 )
+         uDelta = 255;
+      uFlags2 |= uDelta & 0xFF;
+      uDelta = s_uLastVideoSourceReadTimestamps[1] - s_uLastVideoSourceReadTimestamps[2];
+      if ( uDelta > 255 )
+         uDelta = 255;
+      uFlags2 |= (uDelta & 0xFF) << 8;
+      uDelta = s_uLastVideoSourceReadTimestamps[2] - s_uLastVideoSourceReadTimestamps[3];
+      if ( uDelta > 255 )
+         uDelta = 255;
+      uFlags2 |= (uDelta & 0xFF) << 16;
+      
+      send_alarm_to_controller(ALARM_ID_DEVELOPER_ALARM, ALARM_FLAG_DEVELOPER_ALARM_UDP_SKIPPED | ((uDroppedCount & 0xFF) << 8), uFlags2, 5);
+   }
+
+   if ( s_iRxUDPOverflowCounter <= 10 )
+      return false;
+
+   log_softerror_and_alarm("[VideoSourceMaj] Too many UDP overflows: Reopen UDP port...");
+   if ( -1 != s_fInputVideoStreamUDPSocket )
+   {
+      close(s_fInputVideoStreamUDPSocket);
+      log_line("[VideoSourceMaj] Closed input UDP socket.");
+   }
+   else
+      log_line("[VideoSourceMaj] No input UDP socket to close.");
+   s_fInputVideoStreamUDPSocket = -1;
+   _video_source_majestic_open(MAJESTIC_UDP_PORT);
+   s_iRxUDPOverflowCounter = 0;
+   video_source_majestic_clear_input_buffers();
+   log_softerror_and_alarm("[VideoSourceMaj] Too many UDP overflows: Reopened UDP port.");
+   return true;
+}
+
+int video_source_majestic_get_read_fd(u32* puOpenCount)
+{
+   if ( NULL != puOpenCount )
+      *puOpenCount = s_uInputVideoStreamUDPSocketOpenCount;
+   return s_fInputVideoStreamUDPSocket;
+}
+
+bool video_source_majestic_has_pending_read_data()
+{
+   if ( (! s_bUDPBatchReaderInitialized) || (s_UDPBatchReader.iSocketFd != s_fInputVideoStreamUDPSocket) )
+      return false;
+   return video_source_udp_batch_has_pending_packets(&s_UDPBatchReader)?true:false;
 }
 
 int _video_source_majestic_try_read_input_udp_data(bool bAsync)
@@ -439,127 +505,42 @@ int _video_source_majestic_try_read_input_udp_data(bool bAsync)
          log_line("[VideoSourceMaj] Done first time video USD socket setup.");
       }
 
-      static uint8_t cmsgbuf[CMSG_SPACE(sizeof(uint32_t))];
-
-      //static int nfds = 1;
-      //static struct pollfd fds[2];
-      //memset(fds, '\0', sizeof(fds));
-      //fds[0].fd = s_fInputVideoStreamUDPSocket;
-      //fds[0].events = POLLIN;
-      //int res = poll(fds, nfds, 1);
-      fd_set fdSet;
-      FD_ZERO(&fdSet);
-      FD_SET(s_fInputVideoStreamUDPSocket, &fdSet);
-      struct timeval timeWait;
-      timeWait.tv_sec = 0;
-      timeWait.tv_usec = 100;
-      int res = select(s_fInputVideoStreamUDPSocket+1, &fdSet, NULL, NULL, &timeWait);
-      if ( res < 0 )
-      {
-         log_error_and_alarm("[VideoSourceMaj] Failed to poll UDP socket.");
-         return -1;
-      }
-      if ( 0 == res )
-         return 0;
-      /*
-      if (fds[0].revents & (POLLERR | POLLNVAL))
-      {
-         log_softerror_and_alarm("[VideoSourceMaj] Socket error pooling: %s", strerror(errno));
-         return -1;
-      }
-      if ( ! (fds[0].revents & POLLIN) )
-         return 0;
-      */
-      if ( 0 == FD_ISSET(s_fInputVideoStreamUDPSocket, &fdSet) )
-         return 0;
-      struct iovec iov = { .iov_base = (void*)s_uInputVideoUDPBuffer,
-                                            .iov_len = sizeof(s_uInputVideoUDPBuffer) };
-      struct msghdr msghdr = { .msg_name = NULL,
-                               .msg_namelen = 0,
-                               .msg_iov = &iov,
-                               .msg_iovlen = 1,
-                               .msg_control = &cmsgbuf,
-                               .msg_controllen = sizeof(cmsgbuf),
-                               .msg_flags = 0 };
-
-      memset(cmsgbuf, '\0', sizeof(cmsgbuf));
-
-      nRecvBytes = recvmsg(s_fInputVideoStreamUDPSocket, &msghdr, 0);
-      if ( nRecvBytes < 0 )
-      {
-         log_softerror_and_alarm("[VideoSourceMaj] Failed to recvmsg from UDP socket, error: %s", strerror(errno));
+      if ( ! s_bUDPBatchReaderInitialized )
          return -1;
-      }
 
-      for(int i=4; i>0; i--)
-         s_uLastVideoSourceReadTimestamps[i] = s_uLastVideoSourceReadTimestamps[i-1];
-      s_uLastVideoSourceReadTimestamps[0] = g_TimeNow;
+      // A closed/reopened socket invalidates any packets still pending in the batch
+      if ( s_UDPBatchReader.iSocketFd != s_fInputVideoStreamUDPSocket )
+         video_source_udp_batch_set_socket(&s_UDPBatchReader, s_fInputVideoStreamUDPSocket);
 
-      if ( nRecvBytes > MAX_PACKET_TOTAL_SIZE )
+      // Serve packets already read in the last batch, if any; read a new batch (up to 32 packets in one syscall) only when empty
+      if ( ! video_source_udp_batch_has_pending_packets(&s_UDPBatchReader) )
       {
-         log_softerror_and_alarm("[VideoSourceMaj] Read too much data %d bytes from UDP socket", nRecvBytes);
-         nRecvBytes = MAX_PACKET_TOTAL_SIZE;
+         int iCount = video_source_udp_batch_read(&s_UDPBatchReader, 100);
+         if ( iCount < 0 )
+            return -1;
+         if ( 0 == iCount )
+            return 0;
+
+         s_uDebugUDPInputSyscalls++;
+         for(int i=4; i>0; i--)
+            s_uLastVideoSourceReadTimestamps[i] = s_uLastVideoSourceReadTimestamps[i-1];
+         s_uLastVideoSourceReadTimestamps[0] = g_TimeNow;
+
+         if ( s_UDPBatchReader.uLastReadNewDrops > 0 )
+         {
+            if ( _video_source_majestic_on_udp_rxq_overflow(s_UDPBatchReader.uLastReadNewDrops) )
+               return 0;
+         }
+         else
+            s_iRxUDPOverflowCounter = 0;
       }
 
-      static uint32_t rxq_overflow = 0;
-      uint32_t cur_rxq_overflow = extract_udp_rxq_overflow(&msghdr);
-      static int s_iRxUDPOverflowCounter = 0;
-      if (cur_rxq_overflow != rxq_overflow)
+      s_pInputVideoUDPData = video_source_udp_batch_next_packet(&s_UDPBatchReader, &nRecvBytes);
+      if ( NULL == s_pInputVideoUDPData )
       {
-          u32 uDroppedCount = cur_rxq_overflow - rxq_overflow;
-          if ( s_bIsRestartingMajestic )
-             log_line("[VideoSourceMaj] UDP dropped %u packets while restarting majestic.", uDroppedCount);
-          else
-          {
-             log_softerror_and_alarm("[VideoSourceMaj] UDP rxq overflow: %u packets dropped (from %u to %u), overflow counter: %d", uDroppedCount, rxq_overflow, cur_rxq_overflow, s_iRxUDPOverflowCounter);
-             log_softerror_and_alarm("[VideoSourceMaj] Last 4 majestic UDP reads: %u ms ago, %u ms ago, %u ms ago, %u ms ago",
-                s_uLastVideoSourceReadTimestamps[1] - g_TimeNow, s_uLastVideoSourceReadTimestamps[2] - g_TimeNow, s_uLastVideoSourceReadTimestamps[3] - g_TimeNow, s_uLastVideoSourceReadTimestamps[4] - g_TimeNow );
-             s_iRxUDPOverflowCounter++;
-             if ( cur_rxq_overflow > rxq_overflow + 1 )
-             if ( g_TimeNow > s_uLastAlarmUDPOveflowTimestamp + 10000 )
-             if ( g_TimeNow > g_TimeStart + 10000 )
-             if ( g_TimeNow > hardware_camera_maj_get_last_change_time() + 3000 )
-             {
-                s_uLastAlarmUDPOveflowTimestamp = g_TimeNow;
-                u32 uFlags2 = 0;
-                u32 uDelta = s_uLastVideoSourceReadTimestamps[0] - s_uLastVideoSourceReadTimestamps[1];
-                if ( uDelta > 255 )
-                   uDelta = 255;
-                uFlags2 |= uDelta & 0xFF;
-                uDelta = s_uLastVideoSourceReadTimestamps[1] - s_uLastVideoSourceReadTimestamps[2];
-                if ( uDelta > 255 )
-                   uDelta = 255;
-                uFlags2 |= (uDelta & 0xFF) << 8;
-                uDelta = s_uLastVideoSourceReadTimestamps[2] - s_uLastVideoSourceReadTimestamps[3];
-                if ( uDelta > 255 )
-                   uDelta = 255;
-                uFlags2 |= (uDelta & 0xFF) << 16;
-                
-                send_alarm_to_controller(ALARM_ID_DEVELOPER_ALARM, ALARM_FLAG_DEVELOPER_ALARM_UDP_SKIPPED | ((uDroppedCount & 0xFF) << 8), uFlags2, 5);
-             }
-
-             if ( s_iRxUDPOverflowCounter > 10 )
-             {
-                log_softerror_and_alarm("[VideoSourceMaj] Too many UDP overflows: Reopen UDP port...");
-                if ( -1 != s_fInputVideoStreamUDPSocket )
-                {
-                   close(s_fInputVideoStreamUDPSocket);
-                   log_line("[VideoSourceMaj] Closed input UDP socket.");
-                }
-                else
-                   log_line("[VideoSourceMaj] No input UDP socket to close.");
-                s_fInputVideoStreamUDPSocket = -1;
-                _video_source_majestic_open(MAJESTIC_UDP_PORT);
-                video_source_majestic_clear_input_buffers();
-                s_iRxUDPOverflowCounter = 0;
-                nRecvBytes = 0;
-                log_softerror_and_alarm("[VideoSourceMaj] Too many UDP overflows: Reopened UDP port.");
-             }
-          }
-          rxq_overflow = cur_rxq_overflow;
+         s_pInputVideoUDPData = s_uInputVideoUDPBuffer;
+         return 0;
       }
-      else
-         s_iRxUDPOverflowCounter = 0;
    }
    else
    {
@@ -602,6 +583,7 @@ int _video_source_majestic_try_read_input_udp_data(bool bAsync)
       }
       if ( nRecvBytes == 0 )
          return 0;
+      s_pInputVideoUDPData = s_uInputVideoUDPBuffer;
    }
    return nRecvBytes;
 }
@@ -836,7 +818,7 @@ u8* video_source_majestic_read(int* piReadSize, bool bAsync, u32* puOutTimeDataA
    s_uDebugUDPInputBytes += iRecvBytes;
    s_uDebugUDPInputReads++;
 
-   int iOutputBytes = _video_source_majestic_parse_rtp_data(s_uInputVideoUDPBuffer, iRecvBytes);
+   int iOutputBytes = _video_source_majestic_parse_rtp_data(s_pInputVideoUDPData, iRecvBytes);
 
    *piReadSize = iOutputBytes;
    if ( iOutputBytes <= 0 )
@@ -917,12 +899,20 @@ bool video_source_majestic_periodic_health_checks()
       char szBitrate[64];
       str_format_bitrate(s_uDebugUDPInputBytes/10*8, szBitrate);
 
-      log_line("[VideoSourceMaj] Input video data: %u bytes/sec, %s, %u reads/sec",
-         s_uDebugUDPInputBytes/10, szBitrate, s_uDebugUDPInputReads/10);
+      log_line("[VideoSourceMaj] Input video data: %u bytes/sec, %s, %u reads/sec, %u read syscalls/sec",
+         s_uDebugUDPInputBytes/10, szBitrate, s_uDebugUDPInputReads/10, s_uDebugUDPInputSyscalls/10);
+      if ( s_bUDPBatchReaderInitialized && (s_UDPBatchReader.uTotalReads > 0) )
+      {
+         log_line("[VideoSourceMaj] UDP batched reads: avg %.1f packets/read, max %d packets/read, %u packets dropped by socket, %u truncated",
+            (float)s_UDPBatchReader.uTotalPackets/(float)s_UDPBatchReader.uTotalReads, s_UDPBatchReader.iMaxBatchSize,
+            s_UDPBatchReader.uTotalDroppedPackets, s_UDPBatchReader.uTotalTruncatedPackets);
+         video_source_udp_batch_reset_stats(&s_UDPBatchReader);
+      }
       s_uDebugTimeLastUDPVideoInputCheck = g_TimeNow;
       // To fix log_line("[VideoSourceMaj] Detected video stream fps: %d, slices: %d", (int)s_ParserH264CameraOutput.getDetectedFPS(), s_ParserH264CameraOutput.getDetectedSlices());
       s_uDebugUDPInputBytes = 0;
       s_uDebugUDPInputReads = 0;
+      s_uDebugUDPInputSyscalls = 0;
    }
 
    if ( s_bIsRestartingMajestic || g_bVideoPaused )
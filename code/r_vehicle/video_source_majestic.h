@@ -10,6 +10,10 @@ u32 video_source_majestic_start_program(u32 uOverwriteInitialBitrate, int iOverw
 void video_source_majestic_stop_program();
 u32 video_source_majestic_get_program_start_time();
 
+// Input UDP socket, -1 if not opened. The open count changes each time the socket is (re)opened.
+int video_source_majestic_get_read_fd(u32* puOpenCount);
+// Packets already read from the socket in the last batch and not consumed yet
+bool video_source_majestic_has_pending_read_data();
 // Returns the buffer and number of bytes read
 u8* video_source_majestic_read(int* piReadSize, bool bAsync, u32* puOutTimeDataAvailable);
 int video_source_majestic_get_audio_data(u8* pOutputBuffer, int iMaxToRead);
@@ -0,0 +1,211 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../base/base.h"
+#include <sys/select.h>
+#include "video_source_udp_batch.h"
+
+int video_source_udp_batch_init(type_udp_batch_reader* pReader, int iSocketFd, int iMaxPacketsPerRead)
+{
+   if ( NULL == pReader )
+      return 0;
+   memset(pReader, 0, sizeof(type_udp_batch_reader));
+   pReader->pSlab = (u8*) malloc(UDP_BATCH_MAX_PACKETS * MAX_PACKET_TOTAL_SIZE);
+   if ( NULL == pReader->pSlab )
+   {
+      log_error_and_alarm("[UDPBatch] Failed to allocate UDP batch buffers.");
+      return 0;
+   }
+   if ( iMaxPacketsPerRead < 1 )
+      iMaxPacketsPerRead = 1;
+   if ( iMaxPacketsPerRead > UDP_BATCH_MAX_PACKETS )
+      iMaxPacketsPerRead = UDP_BATCH_MAX_PACKETS;
+   pReader->iMaxPacketsPerRead = iMaxPacketsPerRead;
+
+   for( int i=0; i<UDP_BATCH_MAX_PACKETS; i++ )
+   {
+      pReader->iovecs[i].iov_base = pReader->pSlab + i * MAX_PACKET_TOTAL_SIZE;
+      pReader->iovecs[i].iov_len = MAX_PACKET_TOTAL_SIZE;
+      pReader->messages[i].msg_hdr.msg_iov = &(pReader->iovecs[i]);
+      pReader->messages[i].msg_hdr.msg_iovlen = 1;
+   }
+   video_source_udp_batch_set_socket(pReader, iSocketFd);
+   return 1;
+}
+
+void video_source_udp_batch_free(type_udp_batch_reader* pReader)
+{
+   if ( NULL == pReader )
+      return;
+   if ( NULL != pReader->pSlab )
+      free(pReader->pSlab);
+   pReader->pSlab = NULL;
+   pReader->iPacketsCount = 0;
+   pReader->iNextPacket = 0;
+}
+
+void video_source_udp_batch_set_socket(type_udp_batch_reader* pReader, int iSocketFd)
+{
+   if ( NULL == pReader )
+      return;
+   pReader->iSocketFd = iSocketFd;
+   pReader->iPacketsCount = 0;
+   pReader->iNextPacket = 0;
+   pReader->iHasRxqOverflowInfo = 0;
+   pReader->uLastRxqOverflowCounter = 0;
+   pReader->uLastReadNewDrops = 0;
+}
+
+void video_source_udp_batch_reset_stats(type_udp_batch_reader* pReader)
+{
+   if ( NULL == pReader )
+      return;
+   pReader->uTotalReads = 0;
+   pReader->uTotalPackets = 0;
+   pReader->uTotalDroppedPackets = 0;
+   pReader->uTotalTruncatedPackets = 0;
+   pReader->iLastBatchSize = 0;
+   pReader->iMaxBatchSize = 0;
+}
+
+int video_source_udp_batch_has_pending_packets(type_udp_batch_reader* pReader)
+{
+   if ( NULL == pReader )
+      return 0;
+   return (pReader->iNextPacket < pReader->iPacketsCount)?1:0;
+}
+
+// Each message carries the socket drops counter at the time it was queued; use the latest one
+static void _video_source_udp_batch_update_overflow(type_udp_batch_reader* pReader, struct msghdr* pMsgHdr)
+{
+   for( struct cmsghdr* pCMsg = CMSG_FIRSTHDR(pMsgHdr); NULL != pCMsg; pCMsg = CMSG_NXTHDR(pMsgHdr, pCMsg) )
+   {
+      if ( (pCMsg->cmsg_level != SOL_SOCKET) || (pCMsg->cmsg_type != SO_RXQ_OVFL) )
+         continue;
+      u32 uCounter = 0;
+      memcpy(&uCounter, CMSG_DATA(pCMsg), sizeof(u32));
+      if ( pReader->iHasRxqOverflowInfo && (uCounter != pReader->uLastRxqOverflowCounter) )
+         pReader->uLastReadNewDrops += uCounter - pReader->uLastRxqOverflowCounter;
+      else if ( (! pReader->iHasRxqOverflowInfo) && (0 != uCounter) )
+         pReader->uLastReadNewDrops += uCounter;
+      pReader->uLastRxqOverflowCounter = uCounter;
+      pReader->iHasRxqOverflowInfo = 1;
+      return;
+   }
+}
+
+int video_source_udp_batch_read(type_udp_batch_reader* pReader, u32 uTimeoutMicros)
+{
+   if ( (NULL == pReader) || (NULL == pReader->pSlab) || (pReader->iSocketFd < 0) )
+      return -1;
+
+   pReader->iPacketsCount = 0;
+   pReader->iNextPacket = 0;
+   pReader->uLastReadNewDrops = 0;
+
+   if ( uTimeoutMicros > 0 )
+   {
+      fd_set fdSet;
+      FD_ZERO(&fdSet);
+      FD_SET(pReader->iSocketFd, &fdSet);
+      struct timeval timeWait;
+      timeWait.tv_sec = uTimeoutMicros / 1000000;
+      timeWait.tv_usec = uTimeoutMicros % 1000000;
+      int iRes = select(pReader->iSocketFd+1, &fdSet, NULL, NULL, &timeWait);
+      if ( iRes < 0 )
+      {
+         if ( EINTR == errno )
+            return 0;
+         log_softerror_and_alarm("[UDPBatch] Failed to select UDP socket, error: %d, %s", errno, strerror(errno));
+         return -1;
+      }
+      if ( (0 == iRes) || (0 == FD_ISSET(pReader->iSocketFd, &fdSet)) )
+         return 0;
+   }
+
+   for( int i=0; i<pReader->iMaxPacketsPerRead; i++ )
+   {
+      pReader->messages[i].msg_hdr.msg_name = NULL;
+      pReader->messages[i].msg_hdr.msg_namelen = 0;
+      pReader->messages[i].msg_hdr.msg_control = pReader->uControlBuffers[i];
+      pReader->messages[i].msg_hdr.msg_controllen = sizeof(pReader->uControlBuffers[i]);
+      pReader->messages[i].msg_hdr.msg_flags = 0;
+      pReader->messages[i].msg_len = 0;
+   }
+
+   int iCount = recvmmsg(pReader->iSocketFd, pReader->messages, pReader->iMaxPacketsPerRead, MSG_DONTWAIT, NULL);
+   if ( iCount < 0 )
+   {
+      if ( (EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno) )
+         return 0;
+      log_softerror_and_alarm("[UDPBatch] Failed to recvmmsg from UDP socket, error: %d, %s", errno, strerror(errno));
+      return -1;
+   }
+   if ( 0 == iCount )
+      return 0;
+
+   for( int i=0; i<iCount; i++ )
+   {
+      if ( pReader->messages[i].msg_hdr.msg_flags & MSG_TRUNC )
+      {
+         log_softerror_and_alarm("[UDPBatch] Read too much data from UDP socket (more than %d bytes)", MAX_PACKET_TOTAL_SIZE);
+         pReader->uTotalTruncatedPackets++;
+      }
+   }
+   _video_source_udp_batch_update_overflow(pReader, &(pReader->messages[iCount-1].msg_hdr));
+
+   pReader->iPacketsCount = iCount;
+   pReader->iLastBatchSize = iCount;
+   if ( iCount > pReader->iMaxBatchSize )
+      pReader->iMaxBatchSize = iCount;
+   pReader->uTotalReads++;
+   pReader->uTotalPackets += (u32)iCount;
+   pReader->uTotalDroppedPackets += pReader->uLastReadNewDrops;
+   return iCount;
+}
+
+u8* video_source_udp_batch_next_packet(type_udp_batch_reader* pReader, int* piLength)
+{
+   if ( NULL != piLength )
+      *piLength = 0;
+   if ( (NULL == pReader) || (pReader->iNextPacket >= pReader->iPacketsCount) )
+      return NULL;
+
+   int iIndex = pReader->iNextPacket;
+   pReader->iNextPacket++;
+   int iLength = (int)pReader->messages[iIndex].msg_len;
+   if ( iLength > MAX_PACKET_TOTAL_SIZE )
+      iLength = MAX_PACKET_TOTAL_SIZE;
+   if ( NULL != piLength )
+      *piLength = iLength;
+   return pReader->pSlab + iIndex * MAX_PACKET_TOTAL_SIZE;
+}
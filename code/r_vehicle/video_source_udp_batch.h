@@ -0,0 +1,50 @@
+#pragma once
+#include "../base/base.h"
+#include "../radio/radiopackets2.h"
+#include <sys/socket.h>
+
+// Batched reader for UDP video sources (majestic RTP stream):
+// pulls up to UDP_BATCH_MAX_PACKETS datagrams per syscall (recvmmsg) into a preallocated slab,
+// then hands them out one by one, in place.
+
+#define UDP_BATCH_MAX_PACKETS 32
+
+typedef struct
+{
+   int iSocketFd;
+   int iMaxPacketsPerRead;
+   int iPacketsCount; // Packets received in the current batch
+   int iNextPacket;   // Next packet to hand out from the current batch
+
+   u8* pSlab; // UDP_BATCH_MAX_PACKETS * MAX_PACKET_TOTAL_SIZE bytes
+   struct mmsghdr messages[UDP_BATCH_MAX_PACKETS];
+   struct iovec iovecs[UDP_BATCH_MAX_PACKETS];
+   u8 uControlBuffers[UDP_BATCH_MAX_PACKETS][CMSG_SPACE(sizeof(u32))];
+
+   // Socket rx queue overflow (SO_RXQ_OVFL) tracking
+   int iHasRxqOverflowInfo;
+   u32 uLastRxqOverflowCounter;
+   u32 uLastReadNewDrops; // Packets dropped by the kernel before the last read
+
+   // Stats
+   u32 uTotalReads; // recvmmsg syscalls that returned packets
+   u32 uTotalPackets;
+   u32 uTotalDroppedPackets;
+   u32 uTotalTruncatedPackets;
+   int iLastBatchSize;
+   int iMaxBatchSize;
+} type_udp_batch_reader;
+
+// iMaxPacketsPerRead is clamped to UDP_BATCH_MAX_PACKETS. Returns 0 on failure.
+int video_source_udp_batch_init(type_udp_batch_reader* pReader, int iSocketFd, int iMaxPacketsPerRead);
+void video_source_udp_batch_free(type_udp_batch_reader* pReader);
+// Discards pending packets (and overflow tracking) and uses a new socket
+void video_source_udp_batch_set_socket(type_udp_batch_reader* pReader, int iSocketFd);
+void video_source_udp_batch_reset_stats(type_udp_batch_reader* pReader);
+
+int video_source_udp_batch_has_pending_packets(type_udp_batch_reader* pReader);
+// Waits up to uTimeoutMicros for data, then reads a new batch. Call only when there are no pending packets.
+// Returns the number of packets read, 0 if none, -1 on error.
+int video_source_udp_batch_read(type_udp_batch_reader* pReader, u32 uTimeoutMicros);
+// Returns the next packet from the current batch (valid until the next read) or NULL.
+u8* video_source_udp_batch_next_packet(type_udp_batch_reader* pReader, int* piLength);
@@ -39,6 +39,7 @@
 #include "../base/ruby_ipc.h"
 #include "../base/camera_utils.h"
 #include "../base/utils.h"
+#include "../base/latency_trace.h"
 #include "../common/string_utils.h"
 
 #include <errno.h>
@@ -64,6 +65,7 @@ u32 s_uTotalVideoSourceReadBytes = 0;
 u32 s_uLastSetVideoBitrateBPS = 0;
 int s_iLastSetIPQDelta = -1000;
 int s_iLastSetVideoKeyframeMs = 0;
+u64 s_uLatencyTraceFrameStartMicros = 0;
 
 void video_sources_init()
 {
@@ -204,6 +206,26 @@ u32 video_sources_get_capture_start_time()
    return video_source_majestic_get_program_start_time(); 
 }
 
+int video_sources_get_read_fd(u32* puOpenCount)
+{
+   if ( NULL != puOpenCount )
+      *puOpenCount = 0;
+   if ( ! g_pCurrentModel->hasCamera() )
+      return -1;
+   if ( g_pCurrentModel->isActiveCameraCSICompatible() || g_pCurrentModel->isActiveCameraVeye() )
+      return video_source_csi_get_read_fd(puOpenCount);
+   if ( g_pCurrentModel->isActiveCameraOpenIPC() )
+      return video_source_majestic_get_read_fd(puOpenCount);
+   return -1;
+}
+
+bool video_sources_has_pending_read_data()
+{
+   if ( g_pCurrentModel->hasCamera() && g_pCurrentModel->isActiveCameraOpenIPC() )
+      return video_source_majestic_has_pending_read_data();
+   return false;
+}
+
 void video_sources_flush_discard_all_pending_data()
 {
    log_line("[VideoSources] Clear video pipes...");
@@ -215,6 +237,20 @@ void video_sources_flush_discard_all_pending_data()
    log_line("[VideoSources] Done clear video pipes.");
 }
 
+// Capture stage: from the first data of a frame read from the camera to the end of the frame read (can span several calls)
+static void _video_sources_trace_frame_data(bool bEndOfFrame)
+{
+   if ( ! latency_trace_is_enabled() )
+      return;
+   if ( 0 == s_uLatencyTraceFrameStartMicros )
+      s_uLatencyTraceFrameStartMicros = latency_trace_get_time_micros();
+   if ( bEndOfFrame )
+   {
+      latency_trace_add_since(LATENCY_TRACE_STAGE_CAPTURE, s_uLatencyTraceFrameStartMicros);
+      s_uLatencyTraceFrameStartMicros = 0;
+   }
+}
+
 // Returns true if any frame data has been read
 bool video_sources_try_read_camera_frame(bool* pbOutEndOfFrameDetected)
 {
@@ -320,6 +356,7 @@ bool video_sources_try_read_camera_frame(bool* pbOutEndOfFrameDetected)
          bEndOfFrame = false;
          if ( (iTotalBytes > iThresholdBytes) && (iReadSize > iThresholdBytes) && (iReadSize != video_source_csi_get_buffer_size()) )
             bEndOfFrame = true;
+         _video_sources_trace_frame_data(bEndOfFrame);
          if ( NULL != g_pVideoTxBuffers )
             g_pVideoTxBuffers->appendDataToCurrentFrame(pVideoData, iReadSize, uNALPresenceFlags, bEndOfFrame, uTimeDataAvailable);
 
@@ -397,6 +434,7 @@ bool video_sources_try_read_camera_frame(bool* pbOutEndOfFrameDetected)
          if ( bEnd && (iTotalBytes > 0) )
          if ( ! parser_h264_is_signaling_nal(uNALType) )
             bEndOfFrame = true;
+         _video_sources_trace_frame_data(bEndOfFrame);
          if ( NULL != g_pVideoTxBuffers )
             g_pVideoTxBuffers->appendDataToCurrentFrame(pVideoData, iReadSize, uNALPresenceFlags, bEndOfFrame, uTimeDataAvailable);
 
@@ -14,6 +14,11 @@ bool video_sources_is_caputure_process_running();
 u32  video_sources_get_capture_start_time();
 void video_sources_flush_discard_all_pending_data();
 bool video_sources_try_read_camera_frame(bool* pbOutEndOfFrameDetected);
+// For waiting on the camera input in an event loop: fd of the active video source input (-1 if not opened yet)
+// and its open count (changes when the input is reopened, even with the same fd number)
+int  video_sources_get_read_fd(u32* puOpenCount);
+// Input data already read from the fd and not consumed yet
+bool video_sources_has_pending_read_data();
 bool video_sources_has_stream_data();
 u32  video_sources_last_stream_data();
 
@@ -38,7 +38,9 @@
 #include "packets_utils.h"
 #include "../common/string_utils.h"
 #include "../base/hardware_cam_maj.h"
+#include "../base/latency_trace.h"
 #include "../radio/fec.h"
+#include "../radio/radiolink.h"
 #include "adaptive_video.h"
 #include "processor_tx_video.h"
 #include "processor_relay.h"
@@ -78,6 +80,7 @@ VideoTxPacketsBuffer::VideoTxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
       m_VideoPackets[i][k].pPHVS = NULL;
       m_VideoPackets[i][k].pPHVSImp = NULL;
       m_VideoPackets[i][k].bEmpty = true;
+      m_VideoPackets[i][k].uTraceTimeCaptureMicros = 0;
    }
    m_uCurrentH264FrameIndex = 0;
    m_iCurrentBufferIndexToSend = 0;
@@ -86,6 +89,11 @@ VideoTxPacketsBuffer::VideoTxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    m_iNextBufferPacketIndexToFill = 0;
 
    m_uCustomECScheme = 0;
+   m_bProgressiveECEncoding = true;
+   m_iProgressiveECDataPacketsAdded = 0;
+   m_iProgressiveECPackets = 0;
+   m_iProgressiveECBlockDataPackets = 0;
+   m_iProgressiveECPacketSize = 0;
    m_uLastAppliedECSchemeDataPackets = 0;
    m_uLastAppliedECSchemeECPackets = 0;
    m_uNextVideoBlockIndexToGenerate = 0;
@@ -103,6 +111,7 @@ VideoTxPacketsBuffer::VideoTxPacketsBuffer(int iVideoStreamIndex, int iCameraInd
    m_uLastFrameDistanceMs = 0;
    m_uTempNALPresenceFlags = 0;
    m_uTimeDataAvailable = 0;
+   m_uTraceTimeFrameStartMicros = 0;
    m_pTempVideoFrameBuffer = NULL;
    m_iTempVideoFrameBufferSize = 256000;
    m_iTempVideoBufferFilledBytes = 0;
@@ -201,6 +210,7 @@ void VideoTxPacketsBuffer::discardBuffer()
    m_iCurrentBufferIndexToSend = 0;
    m_iCurrentBufferPacketIndexToSend = 0;
    m_uTimeDataAvailable = 0;
+   m_iProgressiveECDataPacketsAdded = 0;
    log_line("[VideoTxBuffer] Discarded entire buffer.");
 }
 
@@ -229,6 +239,7 @@ void VideoTxPacketsBuffer::_checkAllocatePacket(int iBufferIndex, int iPacketInd
 void VideoTxPacketsBuffer::_fillVideoPacketHeaders(int iBufferIndex, int iPacketIndex, bool bIsECPacket, int iRawVideoDataSize, bool bIsLastPacket)
 {
    m_VideoPackets[iBufferIndex][iPacketIndex].bEmpty = false;
+   m_VideoPackets[iBufferIndex][iPacketIndex].uTraceTimeCaptureMicros = m_uTraceTimeFrameStartMicros;
 
    //------------------------------------
    // Update packet header
@@ -424,6 +435,12 @@ void VideoTxPacketsBuffer::setCustomECScheme(u16 uECScheme)
    updateVideoHeader(g_pCurrentModel);
 }
 
+void VideoTxPacketsBuffer::setProgressiveECEncoding(bool bEnable)
+{
+   m_bProgressiveECEncoding = bEnable;
+   log_line("[VideoTxBuffer] Set progressive EC encoding: %s", bEnable?"on":"off");
+}
+
 int VideoTxPacketsBuffer::getCurrentTotalBlockPackets()
 {
    return m_uNextBlockDataPackets + m_uNextBlockECPackets;
@@ -520,7 +537,10 @@ void VideoTxPacketsBuffer::appendDataToCurrentFrame(u8* pVideoData, int iDataSiz
       process_data_tx_video_on_new_data(pVideoData, iDataSize);
 
    if ( 0 == m_iTempVideoBufferFilledBytes )
+   {
       m_uTimeDataAvailable = uTimeDataAvailable;
+      m_uTraceTimeFrameStartMicros = latency_trace_is_enabled()?latency_trace_get_time_micros():0;
+   }
 
    // Append data to current video frame buffer
    if ( (NULL != pVideoData) && (iDataSize > 0) && (iDataSize <= m_iTempVideoFrameBufferSize - m_iTempVideoBufferFilledBytes) )
@@ -677,6 +697,14 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
       }
    }
 
+   if ( 0 == m_iNextBufferPacketIndexToFill )
+   {
+      m_iProgressiveECDataPacketsAdded = 0;
+      m_iProgressiveECPackets = m_PacketHeaderVideo.uCurrentBlockECPackets;
+      m_iProgressiveECBlockDataPackets = m_PacketHeaderVideo.uCurrentBlockDataPackets;
+      m_iProgressiveECPacketSize = m_PacketHeaderVideo.uCurrentBlockPacketSize;
+   }
+
    _fillVideoPacketHeaders(m_iNextBufferIndexToFill, m_iNextBufferPacketIndexToFill, false, iRawVideoDataSize, bIsLastPacket);
 
    // Copy video data
@@ -704,6 +732,8 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
    if ( iSizeToZero > 0 )
       memset(pVideoDestination, 0, iSizeToZero);
 
+   _addVideoPacketToECData(m_iNextBufferIndexToFill, m_iNextBufferPacketIndexToFill);
+
    // Update state
    m_iNextBufferPacketIndexToFill++;
    m_uNextVideoBlockPacketIndexToGenerate++;
@@ -713,26 +743,49 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
    if ( pCurrentVideoPacketHeader->uCurrentBlockDataPackets > 1 )
    if ( pCurrentVideoPacketHeader->uCurrentBlockECPackets > 0 )
    {
-      // Compute EC packets
-      u8* p_fec_data_packets[MAX_DATA_PACKETS_IN_BLOCK];
-      u8* p_fec_data_fecs[MAX_FECS_PACKETS_IN_BLOCK];
+      int iECDelta = pCurrentVideoPacketHeader->uCurrentBlockDataPackets;
 
-      for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockDataPackets; i++ )
+      bool bHasProgressiveECData = m_bProgressiveECEncoding &&
+           (m_iProgressiveECDataPacketsAdded == (int)pCurrentVideoPacketHeader->uCurrentBlockDataPackets) &&
+           (m_iProgressiveECPackets >= (int)pCurrentVideoPacketHeader->uCurrentBlockECPackets) &&
+           (m_iProgressiveECPacketSize == (int)pCurrentVideoPacketHeader->uCurrentBlockPacketSize);
+
+      if ( bHasProgressiveECData )
       {
-         _checkAllocatePacket(m_iNextBufferIndexToFill, i);
-         p_fec_data_packets[i] = m_VideoPackets[m_iNextBufferIndexToFill][i].pVideoData;
+         // EC packets are already computed. If the block was shortened (end of frame),
+         // move them to follow the last data packet (just swap the packets buffers)
+         if ( m_iProgressiveECBlockDataPackets != iECDelta )
+         {
+            for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockECPackets; i++ )
+            {
+               type_tx_video_packet_info tmpInfo = m_VideoPackets[m_iNextBufferIndexToFill][i+iECDelta];
+               m_VideoPackets[m_iNextBufferIndexToFill][i+iECDelta] = m_VideoPackets[m_iNextBufferIndexToFill][i+m_iProgressiveECBlockDataPackets];
+               m_VideoPackets[m_iNextBufferIndexToFill][i+m_iProgressiveECBlockDataPackets] = tmpInfo;
+            }
+         }
       }
-      int iECDelta = pCurrentVideoPacketHeader->uCurrentBlockDataPackets;
-      for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockECPackets; i++ )
+      else
       {
-         _checkAllocatePacket(m_iNextBufferIndexToFill, i+iECDelta);
-         p_fec_data_fecs[i] = m_VideoPackets[m_iNextBufferIndexToFill][i+iECDelta].pVideoData;
-      }
+         // Compute EC packets
+         u8* p_fec_data_packets[MAX_DATA_PACKETS_IN_BLOCK];
+         u8* p_fec_data_fecs[MAX_FECS_PACKETS_IN_BLOCK];
+
+         for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockDataPackets; i++ )
+         {
+            _checkAllocatePacket(m_iNextBufferIndexToFill, i);
+            p_fec_data_packets[i] = m_VideoPackets[m_iNextBufferIndexToFill][i].pVideoData;
+         }
+         for( int i=0; i<pCurrentVideoPacketHeader->uCurrentBlockECPackets; i++ )
+         {
+            _checkAllocatePacket(m_iNextBufferIndexToFill, i+iECDelta);
+            p_fec_data_fecs[i] = m_VideoPackets[m_iNextBufferIndexToFill][i+iECDelta].pVideoData;
+         }
 
-      u32 tTemp = get_current_timestamp_micros();
-      fec_encode(pCurrentVideoPacketHeader->uCurrentBlockPacketSize, p_fec_data_packets, pCurrentVideoPacketHeader->uCurrentBlockDataPackets, p_fec_data_fecs, pCurrentVideoPacketHeader->uCurrentBlockECPackets);
-      tTemp = get_current_timestamp_micros() - tTemp;
-      s_uTimeTotalFecTimeMicroSec += tTemp;
+         u32 tTemp = get_current_timestamp_micros();
+         fec_encode(pCurrentVideoPacketHeader->uCurrentBlockPacketSize, p_fec_data_packets, pCurrentVideoPacketHeader->uCurrentBlockDataPackets, p_fec_data_fecs, pCurrentVideoPacketHeader->uCurrentBlockECPackets);
+         tTemp = get_current_timestamp_micros() - tTemp;
+         s_uTimeTotalFecTimeMicroSec += tTemp;
+      }
       if ( 0 == s_uLastTimeFecCalculation )
       {
          s_uTimeFecMsPerSec = 0;
@@ -760,6 +813,8 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
 
    if ( m_uNextVideoBlockPacketIndexToGenerate >= pCurrentVideoPacketHeader->uCurrentBlockDataPackets + pCurrentVideoPacketHeader->uCurrentBlockECPackets )
    {
+      // Block closed: all data and EC packets are ready to be sent
+      latency_trace_add_since(LATENCY_TRACE_STAGE_FEC_BLOCK, m_uTraceTimeFrameStartMicros);
       m_uNextVideoBlockPacketIndexToGenerate = 0;
       m_uNextVideoBlockIndexToGenerate++;
       m_iNextBufferPacketIndexToFill = 0;
@@ -783,6 +838,44 @@ int VideoTxPacketsBuffer::_addNewVideoPacket(u8* pRawVideoData, int iRawVideoDat
    return iCountPacketsAdded;
 }
 
+// Folds a just added video data packet into the EC packets of the current block,
+// so the EC packets are ready as soon as the last data packet of the block is added.
+void VideoTxPacketsBuffer::_addVideoPacketToECData(int iBufferIndex, int iPacketIndex)
+{
+   if ( (! m_bProgressiveECEncoding) || (m_iProgressiveECPackets <= 0) || (m_iProgressiveECBlockDataPackets <= 1) )
+      return;
+   if ( iPacketIndex != m_iProgressiveECDataPacketsAdded )
+      return;
+   if ( m_iProgressiveECBlockDataPackets + m_iProgressiveECPackets > MAX_TOTAL_PACKETS_IN_BLOCK )
+      return;
+
+   // The EC slots follow the data packets count set at block start. If the block scheme grew since then
+   // (more data or EC packets, other packet size) the data packets use those slots: stop and let the block
+   // EC packets be computed at once when the block ends.
+   if ( (iPacketIndex >= m_iProgressiveECBlockDataPackets) ||
+        ((int)m_PacketHeaderVideo.uCurrentBlockDataPackets > m_iProgressiveECBlockDataPackets) ||
+        ((int)m_PacketHeaderVideo.uCurrentBlockECPackets > m_iProgressiveECPackets) ||
+        ((int)m_PacketHeaderVideo.uCurrentBlockPacketSize != m_iProgressiveECPacketSize) )
+   {
+      m_iProgressiveECPackets = 0;
+      return;
+   }
+
+   u8* p_fec_data_fecs[MAX_FECS_PACKETS_IN_BLOCK];
+   for( int i=0; i<m_iProgressiveECPackets; i++ )
+   {
+      _checkAllocatePacket(iBufferIndex, i+m_iProgressiveECBlockDataPackets);
+      p_fec_data_fecs[i] = m_VideoPackets[iBufferIndex][i+m_iProgressiveECBlockDataPackets].pVideoData;
+      if ( NULL == p_fec_data_fecs[i] )
+         return;
+   }
+
+   u32 tTemp = get_current_timestamp_micros();
+   fec_encode_add_data_block(m_iProgressiveECPacketSize, m_VideoPackets[iBufferIndex][iPacketIndex].pVideoData, iPacketIndex, p_fec_data_fecs, m_iProgressiveECPackets);
+   s_uTimeTotalFecTimeMicroSec += get_current_timestamp_micros() - tTemp;
+   m_iProgressiveECDataPacketsAdded++;
+}
+
 void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 uRetransmissionId, int iCountPacketsAferVideo)
 {
    if ( m_VideoPackets[iBufferIndex][iPacketIndex].bEmpty )
@@ -861,6 +954,11 @@ void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 u
 
    u32 uTimeMicros = get_current_timestamp_micros();
 
+   // When pacing, the tx pacer thread holds the packet for the gap, instead of sleeping here
+   if ( radio_is_paced_tx_active() )
+      radio_set_paced_tx_next_gap((m_uLastSentVideoPacketDurationMicros*3)/4);
+   // When batching, frames reach the driver only when the batch is flushed
+   else if ( ! radio_is_tx_batch_active() )
    if ( uTimeMicros > m_uLastTimeSentVideoPacketMicros )
    if ( (uTimeMicros - m_uLastTimeSentVideoPacketMicros) < m_uLastSentVideoPacketDurationMicros)
    {
@@ -872,6 +970,8 @@ void VideoTxPacketsBuffer::_sendPacket(int iBufferIndex, int iPacketIndex, u32 u
 
    packet_utils_reset_last_used_video_datarate();
    send_packet_to_radio_interfaces((u8*)pCurrentPacketHeader, pCurrentPacketHeader->total_length, -1);
+   if ( 0 == uRetransmissionId )
+      latency_trace_add_since(LATENCY_TRACE_STAGE_RADIO_TX, m_VideoPackets[iBufferIndex][iPacketIndex].uTraceTimeCaptureMicros);
    m_uLastSentVideoPacketDatarateBPS = get_last_tx_maximum_video_radio_datarate_bps();
    if ( (0 == m_uLastSentVideoPacketDatarateMinBPS) || (m_uLastSentVideoPacketDatarateBPS < m_uLastSentVideoPacketDatarateMinBPS) )
       m_uLastSentVideoPacketDatarateMinBPS = m_uLastSentVideoPacketDatarateBPS;
@@ -918,6 +1018,13 @@ int VideoTxPacketsBuffer::sendAvailablePackets(int iCountPacketsAferVideo)
    if ( m_iCurrentBufferPacketIndexToSend == m_iNextBufferPacketIndexToFill )
       return 0;
 
+   // Send the whole burst of available video packets to the tx pacer thread or
+   // else with one syscall per radio interface
+   int iPacedTx = radio_begin_paced_tx();
+   int iBatchTx = 0;
+   if ( ! iPacedTx )
+      iBatchTx = radio_begin_tx_batch();
+
    int iCountSent = 0;
    while ( true )
    {
@@ -962,6 +1069,10 @@ int VideoTxPacketsBuffer::sendAvailablePackets(int iCountPacketsAferVideo)
             m_iCurrentBufferIndexToSend = 0;
       }
    }
+   if ( iBatchTx )
+      radio_flush_tx_batch();
+   if ( iPacedTx )
+      radio_end_paced_tx();
    return iCountSent;
 }
 
@@ -1052,6 +1163,7 @@ void VideoTxPacketsBuffer::resendVideoPacketsFromFrameEnd(u32 uRetransmissionId,
    bool bFrameFound = false;
    bool bMatched = false;
    int iDbgIter = 0;
+   int iPacedTx = radio_begin_paced_tx();
    while ( true )
    {
       iDbgIter++;
@@ -1081,6 +1193,8 @@ void VideoTxPacketsBuffer::resendVideoPacketsFromFrameEnd(u32 uRetransmissionId,
       if ( iBufferIndex == m_iNextBufferIndexToFill )
          break;
    }
+   if ( iPacedTx )
+      radio_end_paced_tx();
 }
 
 void VideoTxPacketsBuffer::setTelemetryInfoVideoThroughput(u32 uVideoBitsPerSec)
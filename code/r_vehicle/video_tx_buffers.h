@@ -20,6 +20,7 @@ typedef struct
    t_packet_header_video_segment* pPHVS; // pointer inside pRawData
    t_packet_header_video_segment_important* pPHVSImp; // pointer inside pRawData
    bool bEmpty;
+   u64 uTraceTimeCaptureMicros; // latency trace: first data of the frame read from the camera
 }
 type_tx_video_packet_info;
 
@@ -39,6 +40,7 @@ class VideoTxPacketsBuffer
       int  getCurrentRealFPS();
 
       void setCustomECScheme(u16 uECScheme);
+      void setProgressiveECEncoding(bool bEnable);
       int  getCurrentTotalBlockPackets();
       void updateVideoHeader(Model* pModel);
       void appendDataToCurrentFrame(u8* pVideoData, int iDataSize, u32 uNALPresenceFlags, bool bIsEndOfFrame, u32 uTimeDataAvailable);
@@ -61,6 +63,7 @@ class VideoTxPacketsBuffer
       void _checkAllocatePacket(int iBufferIndex, int iPacketIndex);
       void _fillVideoPacketHeaders(int iBufferIndex, int iPacketIndex, bool bIsECPacket, int iRawVideoDataSize, bool bIsLastPacket);
       int _addNewVideoPacket(u8* pRawVideoData, int iRawVideoDataSize, int iRemainingVideoPackets, bool bIsLastPacket);
+      void _addVideoPacketToECData(int iBufferIndex, int iPacketIndex);
       void _sendPacket(int iBufferIndex, int iPacketIndex, u32 uRetransmissionId, int iCountPacketsAferVideo);
       static int m_siVideoBuffersInstancesCount;
       bool m_bInitialized;
@@ -83,6 +86,11 @@ class VideoTxPacketsBuffer
       u32 m_uLastAppliedECSchemeDataPackets;
       u32 m_uLastAppliedECSchemeECPackets;
       u16 m_uCustomECScheme; // low byte: ec, high byte: data, 0 or 0xFFFF for default
+      bool m_bProgressiveECEncoding;
+      int m_iProgressiveECDataPacketsAdded; // data packets of current block already added to EC packets
+      int m_iProgressiveECPackets; // EC packets computed progressively for current block
+      int m_iProgressiveECBlockDataPackets; // EC packets are computed progressively in the slots following this many data packets
+      int m_iProgressiveECPacketSize;
       t_packet_header m_PacketHeader;
       t_packet_header_video_segment m_PacketHeaderVideo;
       t_packet_header_video_segment_important m_PacketHeaderVideoImportant;
@@ -95,6 +103,7 @@ class VideoTxPacketsBuffer
       int m_iCurrentBufferIndexToSend;
       int m_iCurrentBufferPacketIndexToSend;
       u32 m_uTimeDataAvailable;
+      u64 m_uTraceTimeFrameStartMicros;
       u8* m_pTempVideoFrameBuffer;
       int m_iTempVideoFrameBufferSize;
       int m_iTempVideoBufferFilledBytes;
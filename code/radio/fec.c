@@ -82,6 +82,30 @@
 #include <assert.h>
 #include "fec.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#define FEC_HAS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/*
+ * The NEON kernels are in fec_neon.c, built with NEON enabled even when
+ * the rest of the code is not (32 bit ARM); used only if the CPU has it.
+ */
+#if defined(__arm__) || defined(__aarch64__)
+#define FEC_HAS_NEON_KERNELS 1
+#include <sys/auxv.h>
+#include "fec_neon.h"
+#if defined(__aarch64__)
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#else
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+#endif
+
 /*
  * stuff used for testing purposes only
  */
@@ -169,7 +193,7 @@ static const char *allPp[] = {    /* GF_BITS	polynomial		*/
  * In any case the macro gf_mul(x,y) takes care of multiplications.
  */
 
-static int s_iAssertion = 0;
+static int fec_initialized = 0;
 
 static gf gf_exp[2*GF_SIZE];	/* index->poly form conversion table	*/
 static int gf_log[GF_SIZE + 1];	/* Poly->index form conversion table	*/
@@ -212,6 +236,14 @@ __attribute__((aligned (256)))
 
 #define gf_mul(x,y) gf_mul_table[(x<<8)+y]
 
+/*
+ * Split-nibble tables used by the SIMD kernels: for a constant c,
+ * c*x = gf_mul_nibble_lo[c][x & 0x0f] ^ gf_mul_nibble_hi[c][x >> 4]
+ * Each row is 16 bytes, so it fits a single PSHUFB/TBL lookup register.
+ */
+static gf gf_mul_nibble_lo[(GF_SIZE + 1)*16] __attribute__((aligned (32)));
+static gf gf_mul_nibble_hi[(GF_SIZE + 1)*16] __attribute__((aligned (32)));
+
 #define USE_GF_MULC register gf * __gf_mulc_
 #define GF_MULC0(c) __gf_mulc_ = &gf_mul_table[(c)<<8]
 #define GF_ADDMULC(dst, x) dst ^= __gf_mulc_[x]
@@ -227,6 +259,12 @@ init_mul_table(void)
 
     for (j=0; j< GF_SIZE+1; j++)
 	gf_mul_table[j] = gf_mul_table[j<<8] = 0;
+
+    for (i=0; i< GF_SIZE+1; i++)
+	for (j=0; j< 16; j++) {
+	    gf_mul_nibble_lo[(i<<4)+j] = gf_mul(i, j);
+	    gf_mul_nibble_hi[(i<<4)+j] = gf_mul(i, (j<<4));
+	}
 }
 
 /*
@@ -435,9 +473,11 @@ addmul1(gf *dst1, gf *src1, gf c, int sz)
 # define addmul1 slow_addmul1
 #endif
 
+static void (*s_pFnAddMul1)(gf *, gf *, gf, int) = addmul1;
+
 static void addmul(gf *dst, gf *src, gf c, int sz) {
     // fprintf(stderr, "Dst=%p Src=%p, gf=%02x sz=%d\n", dst, src, c, sz);
-    if (c != 0) addmul1(dst, src, c, sz);
+    if (c != 0) s_pFnAddMul1(dst, src, c, sz);
 }
 
 /*
@@ -561,9 +601,216 @@ mul1(gf *dst1, gf *src1, gf c, int sz)
 # define mul1 slow_mul1
 #endif
 
+/*
+ * SIMD kernels for addmul1()/mul1(), using the split-nibble method:
+ * each source byte is split in its low and high nibble, each nibble
+ * indexes a 16 entry table for the constant c (a single PSHUFB on x86,
+ * TBL on ARM) and the two partial products are xored together.
+ * Tails shorter than a vector are handled by the scalar code, so the
+ * output is byte-identical to slow_addmul1()/slow_mul1().
+ */
+
+#ifdef FEC_HAS_X86_KERNELS
+
+__attribute__((target("ssse3")))
+static void
+addmul1_ssse3(gf *dst, gf *src, gf c, int sz)
+{
+    const __m128i tlo = _mm_load_si128((const __m128i *)&gf_mul_nibble_lo[c<<4]);
+    const __m128i thi = _mm_load_si128((const __m128i *)&gf_mul_nibble_hi[c<<4]);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 16 <= sz; i += 16) {
+	__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+	__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+	__m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+	__m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+	_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, _mm_xor_si128(l, h)));
+    }
+    if (i < sz)
+	slow_addmul1(dst + i, src + i, c, sz - i);
+}
+
+__attribute__((target("ssse3")))
+static void
+mul1_ssse3(gf *dst, gf *src, gf c, int sz)
+{
+    const __m128i tlo = _mm_load_si128((const __m128i *)&gf_mul_nibble_lo[c<<4]);
+    const __m128i thi = _mm_load_si128((const __m128i *)&gf_mul_nibble_hi[c<<4]);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 16 <= sz; i += 16) {
+	__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+	__m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(s, mask));
+	__m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+	_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(l, h));
+    }
+    if (i < sz)
+	slow_mul1(dst + i, src + i, c, sz - i);
+}
+
+__attribute__((target("avx2")))
+static void
+addmul1_avx2(gf *dst, gf *src, gf c, int sz)
+{
+    const __m256i tlo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)&gf_mul_nibble_lo[c<<4]));
+    const __m256i thi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)&gf_mul_nibble_hi[c<<4]));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 32 <= sz; i += 32) {
+	__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+	__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+	__m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask));
+	__m256i h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+	_mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, _mm256_xor_si256(l, h)));
+    }
+    if (i < sz)
+	slow_addmul1(dst + i, src + i, c, sz - i);
+}
+
+__attribute__((target("avx2")))
+static void
+mul1_avx2(gf *dst, gf *src, gf c, int sz)
+{
+    const __m256i tlo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)&gf_mul_nibble_lo[c<<4]));
+    const __m256i thi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)&gf_mul_nibble_hi[c<<4]));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 32 <= sz; i += 32) {
+	__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+	__m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask));
+	__m256i h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+	_mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(l, h));
+    }
+    if (i < sz)
+	slow_mul1(dst + i, src + i, c, sz - i);
+}
+
+#endif /* FEC_HAS_X86_KERNELS */
+
+#ifdef FEC_HAS_NEON_KERNELS
+
+static void
+addmul1_neon(gf *dst, gf *src, gf c, int sz)
+{
+    int i = fec_neon_addmul1(dst, src, &gf_mul_nibble_lo[c<<4], &gf_mul_nibble_hi[c<<4], sz);
+    if (i < sz)
+	slow_addmul1(dst + i, src + i, c, sz - i);
+}
+
+static void
+mul1_neon(gf *dst, gf *src, gf c, int sz)
+{
+    int i = fec_neon_mul1(dst, src, &gf_mul_nibble_lo[c<<4], &gf_mul_nibble_hi[c<<4], sz);
+    if (i < sz)
+	slow_mul1(dst + i, src + i, c, sz - i);
+}
+
+#endif /* FEC_HAS_NEON_KERNELS */
+
+static void (*s_pFnMul1)(gf *, gf *, gf, int) = mul1;
+static int s_iFecKernel = FEC_KERNEL_SCALAR;
+
 static inline void mul(gf *dst, gf *src, gf c, int sz) {
     /*fprintf(stderr, "%p = %02x * %p\n", dst, c, src);*/
-    if (c != 0) mul1(dst, src, c, sz); else memset(dst, 0, sz);
+    if (c != 0) s_pFnMul1(dst, src, c, sz); else memset(dst, 0, sz);
+}
+
+int fec_is_kernel_supported(int iKernel)
+{
+    switch (iKernel) {
+    case FEC_KERNEL_SCALAR:
+	return 1;
+#ifdef FEC_HAS_X86_KERNELS
+    case FEC_KERNEL_SSSE3:
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3") ? 1 : 0;
+    case FEC_KERNEL_AVX2:
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+#ifdef FEC_HAS_NEON_KERNELS
+    case FEC_KERNEL_NEON:
+	if (!fec_neon_is_built())
+	    return 0;
+#if defined(__aarch64__)
+	return (getauxval(AT_HWCAP) & HWCAP_ASIMD) ? 1 : 0;
+#else
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) ? 1 : 0;
+#endif
+#endif
+    default:
+	return 0;
+    }
+}
+
+int fec_set_kernel(int iKernel)
+{
+    if (!fec_is_kernel_supported(iKernel))
+	return 0;
+    /* the SIMD kernels need the nibble tables built by fec_init() */
+    if (!fec_initialized)
+	fec_init();
+
+    switch (iKernel) {
+#ifdef FEC_HAS_X86_KERNELS
+    case FEC_KERNEL_SSSE3:
+	s_pFnAddMul1 = addmul1_ssse3;
+	s_pFnMul1 = mul1_ssse3;
+	break;
+    case FEC_KERNEL_AVX2:
+	s_pFnAddMul1 = addmul1_avx2;
+	s_pFnMul1 = mul1_avx2;
+	break;
+#endif
+#ifdef FEC_HAS_NEON_KERNELS
+    case FEC_KERNEL_NEON:
+	s_pFnAddMul1 = addmul1_neon;
+	s_pFnMul1 = mul1_neon;
+	break;
+#endif
+    default:
+	s_pFnAddMul1 = addmul1;
+	s_pFnMul1 = mul1;
+	break;
+    }
+    s_iFecKernel = iKernel;
+    return 1;
+}
+
+int fec_get_kernel(void)
+{
+    return s_iFecKernel;
+}
+
+const char *fec_get_kernel_name(int iKernel)
+{
+    switch (iKernel) {
+    case FEC_KERNEL_SCALAR: return "scalar";
+    case FEC_KERNEL_SSSE3: return "ssse3";
+    case FEC_KERNEL_AVX2: return "avx2";
+    case FEC_KERNEL_NEON: return "neon";
+    default: return "unknown";
+    }
+}
+
+/*
+ * Picks the fastest kernel supported by the CPU we are running on.
+ */
+static void
+select_best_kernel(void)
+{
+    if (fec_set_kernel(FEC_KERNEL_AVX2))
+	return;
+    if (fec_set_kernel(FEC_KERNEL_SSSE3))
+	return;
+    if (fec_set_kernel(FEC_KERNEL_NEON))
+	return;
+    fec_set_kernel(FEC_KERNEL_SCALAR);
 }
 
 /*
@@ -694,8 +941,6 @@ invert_mat(gf *src, int k)
 }
 
 
-static int fec_initialized = 0;
-
 void fec_init(void)
 {
     TICK(ticks[0]);
@@ -707,6 +952,7 @@ void fec_init(void)
     TOCK(ticks[0]);
     DDB(fprintf(stderr, "init_mul_table took %ldus\n", ticks[0]);)
    	fec_initialized = 1 ;
+    select_best_kernel();
 }
 
 
@@ -834,13 +1080,44 @@ void fec_encode(unsigned int blockSize,
     }
 }
 
+/*
+ * Progressive version of fec_encode(): folds a single data block into the
+ * FEC blocks. Each FEC row coefficient depends only on the FEC row and on the
+ * data block index, not on the total number of data blocks, so after adding
+ * data blocks 0..k-1 (block 0 first) the FEC blocks are byte-identical to
+ * fec_encode() over those k data blocks. Block 0 initializes the FEC blocks.
+ */
+void fec_encode_add_data_block(unsigned int blockSize,
+		unsigned char *data_block,
+		unsigned int dataBlockNo,
+		unsigned char **fec_blocks,
+		unsigned int nrFecBlocks)
+{
+    unsigned int row;
+    unsigned int col = 128 + dataBlockNo;
+
+    if ( 0 == fec_initialized )
+       fec_init();
+    assert(dataBlockNo < 128);
+    assert(nrFecBlocks <= 128);
+
+    if (0 == dataBlockNo) {
+	for(row=0; row < nrFecBlocks; row++)
+	    mul(fec_blocks[row], data_block, inverse[128 ^ row], blockSize);
+	return;
+    }
+    for(row=0; row < nrFecBlocks; row++)
+	addmul(fec_blocks[row], data_block, inverse[row ^ col], blockSize);
+}
+
 /**
  * Reduce the system by substracting all received data blocks from FEC blocks
  * This will allow to resolve the system by inverting a much smaller matrix
  * (with size being number of blocks lost, rather than number of data blocks
  * + fec)
+ * Returns 0, or -2 if the erased blocks do not match the FEC blocks count.
  */
-static inline void reduce(unsigned int blockSize,
+static inline int reduce(unsigned int blockSize,
 			  unsigned char **data_blocks,
 			  unsigned int nr_data_blocks,
 			  unsigned char **fec_blocks,
@@ -868,14 +1145,16 @@ static inline void reduce(unsigned int blockSize,
 
     assert(nr_fec_blocks == erasedIdx);
     if ( nr_fec_blocks != erasedIdx )
-       s_iAssertion = -2;
+       return -2;
+    return 0;
 }
 
 /**
  * Resolves reduced system. Constructs "mini" encoding matrix, inverts
  * it, and multiply reduced vector by it.
+ * Returns 0, or -1 if the matrix is singular.
  */
-static inline void resolve(int blockSize,
+static inline int resolve(int blockSize,
 			   unsigned char **data_blocks,
 			   unsigned char **fec_blocks,
 			   unsigned int *fec_block_nos,
@@ -904,9 +1183,6 @@ static inline void resolve(int blockSize,
 
     r=invert_mat(matrix, nr_fec_blocks);
 
-    if(r)
-	      s_iAssertion = -1;
-
     /* do the multiplication with the reduced code vector */
     for(row = 0, ptr=0; row < nr_fec_blocks; row++) {
 	int col;
@@ -916,6 +1192,7 @@ static inline void resolve(int blockSize,
 	    addmul(target,fec_blocks[col],matrix[ptr],blockSize);
 	}
     }
+    return r?-1:0;
 }
 
 int fec_decode(unsigned int blockSize,
@@ -928,14 +1205,15 @@ int fec_decode(unsigned int blockSize,
 {
    if ( 0 == fec_initialized )
       fec_init();
-   s_iAssertion = 0;
 
-    reduce(blockSize, data_blocks, nr_data_blocks,
+    int iResult = reduce(blockSize, data_blocks, nr_data_blocks,
 	   fec_blocks, fec_block_nos,  erased_blocks, nr_fec_blocks);
 
-    resolve(blockSize, data_blocks,
+    int iResultResolve = resolve(blockSize, data_blocks,
 	    fec_blocks, fec_block_nos, erased_blocks,
 	    nr_fec_blocks);
-    return s_iAssertion;
+    if ( 0 == iResult )
+       iResult = iResultResolve;
+    return iResult;
 }
 
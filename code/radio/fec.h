@@ -18,6 +18,16 @@ void fec_encode(unsigned int blockSize,
 		unsigned char **fec_blocks,
 		unsigned int nrFecBlocks);
 
+// Adds one data block to the FEC blocks, in order, starting with data block 0.
+// After the last data block is added, the FEC blocks are identical to fec_encode output.
+void fec_encode_add_data_block(unsigned int blockSize,
+		unsigned char *data_block,
+		unsigned int dataBlockNo,
+		unsigned char **fec_blocks,
+		unsigned int nrFecBlocks);
+
+// Re-entrant (called from the FEC worker threads and the router thread at the same time).
+// Returns 0, or a negative value if the blocks could not be recovered.
 int fec_decode(unsigned int blockSize,
 		unsigned char **data_blocks,
 		unsigned int nr_data_blocks,
@@ -28,6 +38,23 @@ int fec_decode(unsigned int blockSize,
 
 void fec_print(fec_code_t code, int width);
 
+/*
+ * GF(2^8) multiply-accumulate kernels used by fec_encode/fec_decode.
+ * fec_init() selects the fastest one supported by the running CPU;
+ * the scalar kernel is the reference implementation.
+ */
+#define FEC_KERNEL_SCALAR 0
+#define FEC_KERNEL_SSSE3  1
+#define FEC_KERNEL_AVX2   2
+#define FEC_KERNEL_NEON   3
+#define FEC_KERNEL_COUNT  4
+
+int fec_is_kernel_supported(int iKernel);
+// Returns 1 if the kernel was selected, 0 if not supported on this CPU
+int fec_set_kernel(int iKernel);
+int fec_get_kernel(void);
+const char *fec_get_kernel_name(int iKernel);
+
 void fec_license(void);
 #ifdef __cplusplus
 }
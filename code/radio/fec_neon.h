@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+ * NEON split-nibble GF(2^8) kernels used by fec.c. Built in their own
+ * file so that on 32 bit ARM they get the NEON compiler flags without
+ * the rest of the code using NEON instructions; fec.c uses them only if
+ * the running CPU has NEON.
+ * Each call processes the largest multiple of 16 bytes of sz and returns
+ * that count; the tail is left to the scalar code.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns 1 if the kernels were built with NEON (0: the calls below do nothing)
+int fec_neon_is_built(void);
+int fec_neon_addmul1(unsigned char *dst, const unsigned char *src, const unsigned char *tlo, const unsigned char *thi, int sz);
+int fec_neon_mul1(unsigned char *dst, const unsigned char *src, const unsigned char *tlo, const unsigned char *thi, int sz);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,321 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <time.h>
+#include "../base/base.h"
+#include "../base/hardware_procs.h"
+#include "../base/packet_pool.h"
+#include "fec.h"
+#include "fec_worker.h"
+
+#define FEC_WORKER_CACHE_LINE 64
+#define FEC_WORKER_JOBS_MASK (FEC_WORKER_JOBS_PER_THREAD - 1)
+
+typedef struct
+{
+   // Written by the submitter only
+   _ATOMIC_PREFIX u32 uSubmitIndex __attribute__((aligned(FEC_WORKER_CACHE_LINE)));
+   u32 uCollectIndex;
+
+   // Written by the worker only
+   _ATOMIC_PREFIX u32 uDoneIndex __attribute__((aligned(FEC_WORKER_CACHE_LINE)));
+   u32 uMaxDecodeMicros;
+   u64 uTotalDecodeMicros;
+
+   int iEventFd __attribute__((aligned(FEC_WORKER_CACHE_LINE))); // wakes up the worker
+   int iIndex;
+   pthread_t thread;
+   int iThreadStarted;
+   type_fec_worker_job jobs[FEC_WORKER_JOBS_PER_THREAD];
+} type_fec_worker_thread;
+
+static type_fec_worker_thread s_FECWorkers[FEC_WORKER_MAX_THREADS];
+static int s_iFECWorkersCount = 0;
+static _ATOMIC_PREFIX int s_iFECWorkersStop = 0;
+static int s_iFECWorkersWakeupFd = -1;
+// Submit and collect sequences, they select the worker (round robin)
+static u32 s_uFECWorkersSubmitSequence = 0;
+static u32 s_uFECWorkersCollectSequence = 0;
+static u32 s_uFECWorkersJobsRejected = 0;
+
+static u64 _fec_worker_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000LL;
+}
+
+static void _fec_worker_signal_fd(int iFd)
+{
+   u64 uValue = 1;
+   if ( write(iFd, &uValue, sizeof(uValue)) != sizeof(uValue) )
+   {
+      // The counter is already non zero, the reader is woken up anyway
+   }
+}
+
+static void* _thread_fec_worker(void* pArgument)
+{
+   type_fec_worker_thread* pWorker = (type_fec_worker_thread*)pArgument;
+   log_line("[FECWorker] Thread %d started.", pWorker->iIndex+1);
+
+   while ( 1 )
+   {
+      // All queued jobs are done before stopping
+      u32 uDoneIndex = pWorker->uDoneIndex;
+      while ( uDoneIndex != __atomic_load_n(&pWorker->uSubmitIndex, __ATOMIC_ACQUIRE) )
+      {
+         type_fec_worker_job* pJob = &(pWorker->jobs[uDoneIndex & FEC_WORKER_JOBS_MASK]);
+         u64 uTimeStart = _fec_worker_time_micros();
+         pJob->iResult = fec_decode(pJob->uBlockSize, pJob->pDataPointers, pJob->uDataPackets, pJob->pECPointers, pJob->uECIndexes, pJob->uMissingIndexes, (unsigned short)pJob->uMissingCount);
+         pJob->uDecodeMicros = (u32)(_fec_worker_time_micros() - uTimeStart);
+         pWorker->uTotalDecodeMicros += pJob->uDecodeMicros;
+         if ( pJob->uDecodeMicros > pWorker->uMaxDecodeMicros )
+            pWorker->uMaxDecodeMicros = pJob->uDecodeMicros;
+
+         uDoneIndex++;
+         __atomic_store_n(&pWorker->uDoneIndex, uDoneIndex, __ATOMIC_RELEASE);
+         _fec_worker_signal_fd(s_iFECWorkersWakeupFd);
+      }
+      if ( __atomic_load_n(&s_iFECWorkersStop, __ATOMIC_ACQUIRE) )
+         break;
+
+      u64 uValue = 0;
+      if ( read(pWorker->iEventFd, &uValue, sizeof(uValue)) < 0 )
+      if ( errno != EINTR )
+         break;
+   }
+   log_line("[FECWorker] Thread %d finished.", pWorker->iIndex+1);
+   return NULL;
+}
+
+int fec_worker_start(int iThreads, int iCPUCore)
+{
+   if ( s_iFECWorkersCount > 0 )
+      return s_iFECWorkersCount;
+   if ( iThreads <= 0 )
+      return 0;
+   if ( iThreads > FEC_WORKER_MAX_THREADS )
+      iThreads = FEC_WORKER_MAX_THREADS;
+
+   // The decoding tables are built once, before the workers use them
+   fec_init();
+
+   s_iFECWorkersWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if ( s_iFECWorkersWakeupFd < 0 )
+   {
+      log_softerror_and_alarm("[FECWorker] Failed to create wakeup eventfd, error: %d, %s", errno, strerror(errno));
+      return 0;
+   }
+   __atomic_store_n(&s_iFECWorkersStop, 0, __ATOMIC_RELEASE);
+   s_uFECWorkersSubmitSequence = 0;
+   s_uFECWorkersCollectSequence = 0;
+   s_uFECWorkersJobsRejected = 0;
+
+   for( int i=0; i<iThreads; i++ )
+   {
+      type_fec_worker_thread* pWorker = &(s_FECWorkers[i]);
+      memset(pWorker, 0, sizeof(type_fec_worker_thread));
+      pWorker->iIndex = i;
+      pWorker->iEventFd = eventfd(0, EFD_CLOEXEC);
+      if ( pWorker->iEventFd < 0 )
+      {
+         log_softerror_and_alarm("[FECWorker] Failed to create eventfd for thread %d, error: %d, %s", i+1, errno, strerror(errno));
+         break;
+      }
+      pthread_attr_t attr;
+      hw_init_worker_thread_attrs(&attr, iCPUCore, 128000, SCHED_OTHER, 0, "fec_worker");
+      if ( 0 != pthread_create(&pWorker->thread, &attr, &_thread_fec_worker, (void*)pWorker) )
+      {
+         log_softerror_and_alarm("[FECWorker] Failed to create thread %d.", i+1);
+         pthread_attr_destroy(&attr);
+         close(pWorker->iEventFd);
+         pWorker->iEventFd = -1;
+         break;
+      }
+      pthread_attr_destroy(&attr);
+      pWorker->iThreadStarted = 1;
+      s_iFECWorkersCount++;
+   }
+
+   if ( 0 == s_iFECWorkersCount )
+   {
+      close(s_iFECWorkersWakeupFd);
+      s_iFECWorkersWakeupFd = -1;
+      log_softerror_and_alarm("[FECWorker] No worker threads started. EC decoding is done on the router thread.");
+      return 0;
+   }
+   log_line("[FECWorker] Started %d worker threads, %d jobs per thread.", s_iFECWorkersCount, FEC_WORKER_JOBS_PER_THREAD);
+   return s_iFECWorkersCount;
+}
+
+void fec_worker_stop()
+{
+   if ( 0 == s_iFECWorkersCount )
+      return;
+
+   __atomic_store_n(&s_iFECWorkersStop, 1, __ATOMIC_RELEASE);
+   for( int i=0; i<s_iFECWorkersCount; i++ )
+   {
+      _fec_worker_signal_fd(s_FECWorkers[i].iEventFd);
+      if ( s_FECWorkers[i].iThreadStarted )
+         pthread_join(s_FECWorkers[i].thread, NULL);
+      s_FECWorkers[i].iThreadStarted = 0;
+   }
+   fec_worker_process_completed();
+
+   for( int i=0; i<s_iFECWorkersCount; i++ )
+   {
+      close(s_FECWorkers[i].iEventFd);
+      s_FECWorkers[i].iEventFd = -1;
+   }
+   close(s_iFECWorkersWakeupFd);
+   s_iFECWorkersWakeupFd = -1;
+   log_line("[FECWorker] Stopped %d worker threads, %u jobs done, %u decoded by the caller (workers busy).",
+      s_iFECWorkersCount, s_uFECWorkersCollectSequence, s_uFECWorkersJobsRejected);
+   s_iFECWorkersCount = 0;
+}
+
+int fec_worker_is_running()
+{
+   return (s_iFECWorkersCount > 0)?1:0;
+}
+
+int fec_worker_get_wakeup_fd()
+{
+   return s_iFECWorkersWakeupFd;
+}
+
+void fec_worker_clear_wakeup()
+{
+   if ( s_iFECWorkersWakeupFd < 0 )
+      return;
+   u64 uValue = 0;
+   if ( read(s_iFECWorkersWakeupFd, &uValue, sizeof(uValue)) < 0 )
+   {
+      // EAGAIN: nothing signaled
+   }
+}
+
+type_fec_worker_job* fec_worker_get_free_job()
+{
+   if ( 0 == s_iFECWorkersCount )
+      return NULL;
+   type_fec_worker_thread* pWorker = &(s_FECWorkers[s_uFECWorkersSubmitSequence % (u32)s_iFECWorkersCount]);
+   if ( pWorker->uSubmitIndex - pWorker->uCollectIndex >= FEC_WORKER_JOBS_PER_THREAD )
+   {
+      s_uFECWorkersJobsRejected++;
+      return NULL;
+   }
+   type_fec_worker_job* pJob = &(pWorker->jobs[pWorker->uSubmitIndex & FEC_WORKER_JOBS_MASK]);
+   pJob->iCountPoolBuffers = 0;
+   pJob->pCallback = NULL;
+   pJob->pContext = NULL;
+   pJob->iResult = 0;
+   pJob->uDecodeMicros = 0;
+   return pJob;
+}
+
+void fec_worker_submit_job(type_fec_worker_job* pJob)
+{
+   if ( (0 == s_iFECWorkersCount) || (NULL == pJob) )
+      return;
+   type_fec_worker_thread* pWorker = &(s_FECWorkers[s_uFECWorkersSubmitSequence % (u32)s_iFECWorkersCount]);
+   if ( pJob != &(pWorker->jobs[pWorker->uSubmitIndex & FEC_WORKER_JOBS_MASK]) )
+   {
+      log_softerror_and_alarm("[FECWorker] Submitted job is not the last free job.");
+      return;
+   }
+   __atomic_store_n(&pWorker->uSubmitIndex, pWorker->uSubmitIndex + 1, __ATOMIC_RELEASE);
+   s_uFECWorkersSubmitSequence++;
+   _fec_worker_signal_fd(pWorker->iEventFd);
+}
+
+int fec_worker_process_completed()
+{
+   int iCount = 0;
+   while ( s_uFECWorkersCollectSequence != s_uFECWorkersSubmitSequence )
+   {
+      type_fec_worker_thread* pWorker = &(s_FECWorkers[s_uFECWorkersCollectSequence % (u32)s_iFECWorkersCount]);
+      if ( pWorker->uCollectIndex == __atomic_load_n(&pWorker->uDoneIndex, __ATOMIC_ACQUIRE) )
+         break;
+      type_fec_worker_job* pJob = &(pWorker->jobs[pWorker->uCollectIndex & FEC_WORKER_JOBS_MASK]);
+      if ( NULL != pJob->pCallback )
+         pJob->pCallback(pJob);
+      for( int i=0; i<pJob->iCountPoolBuffers; i++ )
+         packet_pool_unref(pJob->pPoolBuffers[i]);
+      pJob->iCountPoolBuffers = 0;
+      pWorker->uCollectIndex++;
+      s_uFECWorkersCollectSequence++;
+      iCount++;
+   }
+   return iCount;
+}
+
+int fec_worker_wait_all_completed(u32 uTimeoutMs)
+{
+   u32 uTimeStart = get_current_timestamp_ms();
+   while ( s_uFECWorkersCollectSequence != s_uFECWorkersSubmitSequence )
+   {
+      fec_worker_process_completed();
+      if ( s_uFECWorkersCollectSequence == s_uFECWorkersSubmitSequence )
+         break;
+      if ( get_current_timestamp_ms() > uTimeStart + uTimeoutMs )
+         return 0;
+      hardware_sleep_micros(50);
+   }
+   return 1;
+}
+
+int fec_worker_get_pending_jobs()
+{
+   return (int)(s_uFECWorkersSubmitSequence - s_uFECWorkersCollectSequence);
+}
+
+void fec_worker_get_stats(type_fec_worker_stats* pStats)
+{
+   if ( NULL == pStats )
+      return;
+   memset(pStats, 0, sizeof(type_fec_worker_stats));
+   pStats->iThreads = s_iFECWorkersCount;
+   pStats->uJobsSubmitted = s_uFECWorkersSubmitSequence;
+   pStats->uJobsCollected = s_uFECWorkersCollectSequence;
+   pStats->uJobsRejected = s_uFECWorkersJobsRejected;
+   for( int i=0; i<s_iFECWorkersCount; i++ )
+   {
+      pStats->uTotalDecodeMicros += s_FECWorkers[i].uTotalDecodeMicros;
+      if ( s_FECWorkers[i].uMaxDecodeMicros > pStats->uMaxDecodeMicros )
+         pStats->uMaxDecodeMicros = s_FECWorkers[i].uMaxDecodeMicros;
+   }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../base/base.h"
+#include "radiopackets2.h"
+
+// Worker threads that run the EC decoding (fec_decode) of video blocks off the router thread.
+// Each worker has a ring of jobs with three indexes: submitted (written by the submitter), done (written by
+// the worker) and collected (submitter only), so no locks are used. Jobs are given to the workers round
+// robin and collected in the order they were submitted. The submitter (the router main loop) is the only
+// thread that submits and collects jobs. Completed jobs are signaled on an eventfd.
+// When no worker has room for a job (or the workers are not started), the caller decodes in place.
+
+#define FEC_WORKER_MAX_THREADS 4
+#define FEC_WORKER_JOBS_PER_THREAD 16 // power of 2
+#define FEC_WORKER_DEFAULT_THREADS 1
+
+struct type_fec_worker_job;
+// Called on the collecting thread, in submit order
+typedef void (*fec_worker_done_callback)(struct type_fec_worker_job* pJob);
+
+typedef struct type_fec_worker_job
+{
+   // Set by the submitter
+   unsigned int uBlockSize;
+   unsigned int uDataPackets;
+   unsigned int uMissingCount;
+   u8* pDataPointers[MAX_TOTAL_PACKETS_IN_BLOCK];
+   u8* pECPointers[MAX_TOTAL_PACKETS_IN_BLOCK];
+   unsigned int uECIndexes[MAX_TOTAL_PACKETS_IN_BLOCK];
+   unsigned int uMissingIndexes[MAX_TOTAL_PACKETS_IN_BLOCK];
+   // Packet pool buffers used by the job, referenced by the submitter; released after the done callback
+   u8* pPoolBuffers[MAX_TOTAL_PACKETS_IN_BLOCK];
+   int iCountPoolBuffers;
+
+   fec_worker_done_callback pCallback;
+   void* pContext;
+   u32 uContextId;
+   int iContextIndex;
+   u64 uContextTimeMicros;
+
+   // Set by the worker
+   int iResult;
+   u32 uDecodeMicros;
+} type_fec_worker_job;
+
+typedef struct
+{
+   int iThreads;
+   u32 uJobsSubmitted;
+   u32 uJobsCollected;
+   u32 uJobsRejected; // no room in the workers rings, decoded by the caller
+   u32 uMaxDecodeMicros;
+   u64 uTotalDecodeMicros;
+} type_fec_worker_stats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns the number of worker threads started (0 on failure: EC decoding is done in place then)
+int fec_worker_start(int iThreads, int iCPUCore);
+// Waits for the queued jobs to finish and collects them, then stops the threads
+void fec_worker_stop();
+int fec_worker_is_running();
+
+// Readable when there are completed jobs to collect, -1 if not running
+int fec_worker_get_wakeup_fd();
+// Consumes the wakeup eventfd. Call it before fec_worker_process_completed when woken up by the fd.
+void fec_worker_clear_wakeup();
+
+// Returns a job to fill in, NULL if the workers are not running or have no room for it
+type_fec_worker_job* fec_worker_get_free_job();
+// Queues the job returned by the last fec_worker_get_free_job call
+void fec_worker_submit_job(type_fec_worker_job* pJob);
+// Runs the done callbacks of the completed jobs, in submit order. Returns the number of jobs collected.
+int fec_worker_process_completed();
+// Waits for all the submitted jobs and collects them. Returns 0 on timeout.
+int fec_worker_wait_all_completed(u32 uTimeoutMs);
+int fec_worker_get_pending_jobs();
+
+void fec_worker_get_stats(type_fec_worker_stats* pStats);
+
+#ifdef __cplusplus
+}
+#endif
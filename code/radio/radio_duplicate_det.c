@@ -39,15 +39,22 @@
 #include "radiolink.h"
 
 
-#define PACKETS_INDEX_HASH_SIZE 512
-#define PACKETS_INDEX_HASH_MASK 0x01FF
+// Per stream sliding window of received stream packet indexes (anti-replay style): bit N of the
+// window is set if stream packet index N was received. The window ends at the max received index and
+// moves forward with it; the words it leaves behind are cleared and reused (ring of words).
+// Stream packet indexes are compared modulo PACKET_FLAGS_MASK_STREAM_PACKET_IDX+1, so the wrap around is seamless.
+// Packets older than the window are duplicates (the stream restart detection catches larger jumps back).
+#define DUP_DET_WINDOW_WORDS 64 // power of 2
+#define DUP_DET_WINDOW_WORDS_MASK (DUP_DET_WINDOW_WORDS-1)
+#define DUP_DET_WINDOW_PACKETS ((DUP_DET_WINDOW_WORDS-1)*64) // the top word is partially ahead of the max index
+#define DUP_DET_INDEX_HALF_RANGE ((PACKET_FLAGS_MASK_STREAM_PACKET_IDX+1)/2)
 
 typedef struct
 {
    u32 uMaxReceivedPacketIndex;
-   u32 uLastReceivedPacketIndex;
+   u32 uLastReceivedPacketIndex; // MAX_U32 if nothing received on the stream
    u32 uLastTimeReceivedPacket;
-   u32 packetsHashIndexes[PACKETS_INDEX_HASH_SIZE];
+   u64 uWindow[DUP_DET_WINDOW_WORDS];
 } ALIGN_STRUCT_SPEC_INFO t_stream_history_packets_indexes;
 
 typedef struct
@@ -59,6 +66,15 @@ typedef struct
 
 t_vehicle_history_packets_indexes s_ListHistoryRxPacketsVehicles[MAX_CONCURENT_VEHICLES];
 
+// Vehicle id to runtime index cache, direct mapped on the vehicle id (checked against the list on use)
+#define DUP_DET_VID_CACHE_SIZE 16 // power of 2
+static int s_iDupDetVehicleIndexCache[DUP_DET_VID_CACHE_SIZE] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+
+static inline u32 _radio_dup_detection_vid_cache_slot(u32 uVehicleId)
+{
+   return (uVehicleId ^ (uVehicleId >> 8) ^ (uVehicleId >> 16)) & (DUP_DET_VID_CACHE_SIZE-1);
+}
+
 extern u32 s_uRadioRxTimeNow;
 
 shared_mem_radio_stats* s_pSMRadioStatsDuplicateDetection = NULL;
@@ -78,8 +94,26 @@ void _radio_dd_reset_duplication_stats_for_vehicle(int iVehicleIndex, int iReaso
       s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uMaxReceivedPacketIndex = 0;
       s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uLastReceivedPacketIndex = MAX_U32;
       s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uLastTimeReceivedPacket = 0;
-      memset((u8*)s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].packetsHashIndexes, 0xFF, PACKETS_INDEX_HASH_SIZE * sizeof(u32));
+      memset((u8*)s_ListHistoryRxPacketsVehicles[iVehicleIndex].streamsPacketsHistory[k].uWindow, 0, DUP_DET_WINDOW_WORDS * sizeof(u64));
+   }
+}
+
+static int _radio_dup_detection_find_vid(u32 uVehicleId)
+{
+   u32 uCacheSlot = _radio_dup_detection_vid_cache_slot(uVehicleId);
+   int iIndex = s_iDupDetVehicleIndexCache[uCacheSlot];
+   if ( (iIndex >= 0) && (uVehicleId == s_ListHistoryRxPacketsVehicles[iIndex].uVehicleId) )
+      return iIndex;
+
+   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
+   {
+      if ( uVehicleId == s_ListHistoryRxPacketsVehicles[i].uVehicleId )
+      {
+         s_iDupDetVehicleIndexCache[uCacheSlot] = i;
+         return i;
+      }
    }
+   return -1;
 }
 
 
@@ -113,16 +147,7 @@ void radio_duplicate_detection_log_info()
 
 int _radio_dup_detection_get_runtime_index_for_vid(u32 uVehicleId, u8* pPacketBuffer, int iPacketLength)
 {
-   int iStatsIndex = -1;
-
-   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
-   {
-      if ( uVehicleId == s_ListHistoryRxPacketsVehicles[i].uVehicleId )
-      {
-         iStatsIndex = i;
-         break;
-      }
-   }
+   int iStatsIndex = _radio_dup_detection_find_vid(uVehicleId);
    if ( iStatsIndex != -1 )
       return iStatsIndex;
 
@@ -211,55 +236,67 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
    u8 uPacketType = pPH->packet_type;   
    int iStatsIndex = -1;
 
+   if ( uStreamIndex >= MAX_RADIO_STREAMS )
+      return 1;
+
    iStatsIndex = _radio_dup_detection_get_runtime_index_for_vid(uVehicleId, pPacketBuffer, iPacketLength);
    if ( -1 == iStatsIndex )
       return 1;
 
    t_vehicle_history_packets_indexes* pDupInfo = &s_ListHistoryRxPacketsVehicles[iStatsIndex];
+   t_stream_history_packets_indexes* pStreamInfo = &pDupInfo->streamsPacketsHistory[uStreamIndex];
    pDupInfo->uVehicleId = uVehicleId;
    
    static u32 s_TimeLastLogAlarmStreamPacketsVariation = 0;
-
-   u32 uMaxDeltaForVideoStream = 2000;
-   u32 uMaxDeltaForDataStream = 50;
-   if ( hardware_radio_index_is_serial_radio(iRadioInterfaceIndex) )
-      uMaxDeltaForDataStream = 200;
-
-   if ( (uStreamIndex != STREAM_ID_AUDIO) && (uStreamIndex < STREAM_ID_VIDEO_1) )
-   if ((pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex > uMaxDeltaForDataStream ) && 
-           (uStreamPacketIndex < pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex - uMaxDeltaForDataStream) )
-   if ( pDupInfo->streamsPacketsHistory[uStreamIndex].uLastTimeReceivedPacket > uTimeNow - 4000 )
-   if ( uTimeNow > s_TimeLastLogAlarmStreamPacketsVariation + 1000 )
+   // How far behind the max received index the packet is (0 if it is newer), modulo the stream index range
+   u32 uPacketsBehind = 0;
+   if ( MAX_U32 != pStreamInfo->uLastReceivedPacketIndex )
    {
-      s_TimeLastLogAlarmStreamPacketsVariation = get_current_timestamp_ms();
-      log_line("[RadioDuplicateDetection] Received stream-%d packet index %u on radio interface %d, is %u packets older than max packet for the stream (%u).",
-         (int)uStreamIndex, iRadioInterfaceIndex+1, uStreamPacketIndex,
-         pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex-uStreamPacketIndex,
-         pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex);
+      uPacketsBehind = (pStreamInfo->uMaxReceivedPacketIndex - uStreamPacketIndex) & PACKET_FLAGS_MASK_STREAM_PACKET_IDX;
+      if ( uPacketsBehind >= DUP_DET_INDEX_HALF_RANGE )
+         uPacketsBehind = 0;
    }
 
    // --------------------------------------------------------
    // Begin: Detect if stream restarted
 
+   // Packets up to 10 behind the max are never a restart: skip the checks for them (most packets)
    int iStreamRestarted = 0;
+   if ( uPacketsBehind > 10 )
+   {
+      u32 uMaxDeltaForVideoStream = 2000;
+      u32 uMaxDeltaForDataStream = 50;
+      if ( hardware_radio_index_is_serial_radio(iRadioInterfaceIndex) )
+         uMaxDeltaForDataStream = 200;
+
+      if ( (uStreamIndex != STREAM_ID_AUDIO) && (uStreamIndex < STREAM_ID_VIDEO_1) )
+      if ( uPacketsBehind > uMaxDeltaForDataStream )
+      if ( pStreamInfo->uLastTimeReceivedPacket > uTimeNow - 4000 )
+      if ( uTimeNow > s_TimeLastLogAlarmStreamPacketsVariation + 1000 )
+      {
+         s_TimeLastLogAlarmStreamPacketsVariation = get_current_timestamp_ms();
+         log_line("[RadioDuplicateDetection] Received stream-%d packet index %u on radio interface %d, is %u packets older than max packet for the stream (%u).",
+            (int)uStreamIndex, uStreamPacketIndex, iRadioInterfaceIndex+1, uPacketsBehind,
+            pStreamInfo->uMaxReceivedPacketIndex);
+      }
 
-   if ( (uStreamIndex == STREAM_ID_AUDIO) || (uStreamIndex >= STREAM_ID_VIDEO_1) )
-   if ( pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex > uStreamPacketIndex + uMaxDeltaForVideoStream )
-      iStreamRestarted = 1;
+      if ( (uStreamIndex == STREAM_ID_AUDIO) || (uStreamIndex >= STREAM_ID_VIDEO_1) )
+      if ( uPacketsBehind > uMaxDeltaForVideoStream )
+         iStreamRestarted = 1;
 
-   if ( (uStreamIndex != STREAM_ID_AUDIO) && (uStreamIndex < STREAM_ID_VIDEO_1) )
-   if ( pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex > uStreamPacketIndex + uMaxDeltaForDataStream )
-      iStreamRestarted = 1;
+      if ( (uStreamIndex != STREAM_ID_AUDIO) && (uStreamIndex < STREAM_ID_VIDEO_1) )
+      if ( uPacketsBehind > uMaxDeltaForDataStream )
+         iStreamRestarted = 1;
 
-   if ( 0 != pDupInfo->streamsPacketsHistory[uStreamIndex].uLastTimeReceivedPacket )
-   if ( pDupInfo->streamsPacketsHistory[uStreamIndex].uLastTimeReceivedPacket < uTimeNow - 8000 )
-   if ( uStreamPacketIndex+10 < pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex )
-      iStreamRestarted = 1;
+      if ( 0 != pStreamInfo->uLastTimeReceivedPacket )
+      if ( pStreamInfo->uLastTimeReceivedPacket < uTimeNow - 8000 )
+         iStreamRestarted = 1;
+   }
 
    if ( iStreamRestarted )
    {
       char szTime[128];
-      u32 uDeltaTime = uTimeNow - pDupInfo->streamsPacketsHistory[uStreamIndex].uLastTimeReceivedPacket;
+      u32 uDeltaTime = uTimeNow - pStreamInfo->uLastTimeReceivedPacket;
       if ( uDeltaTime < 1000 )
          sprintf(szTime, "%u ms", uDeltaTime);
       else
@@ -278,12 +315,13 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
 
       log_line("[RadioDuplicateDetection] Detected stream restart on the other end of the radio link for VID %u. On stream: %d (%s), received stream packet index: %u, max recv stream packet index: %u, last received packet on this stream was %s ago. Packet tpye: %s. Do reset duplicate info.",
          uVehicleId, uStreamIndex, str_get_radio_stream_name(uStreamIndex),
-         uStreamPacketIndex, pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex,
+         uStreamPacketIndex, pStreamInfo->uMaxReceivedPacketIndex,
          szTime, str_get_packet_type(uPacketType) );
 
       _radio_dd_reset_duplication_stats_for_vehicle(iStatsIndex, 2);
       pDupInfo->iRestartDetected = 1;
       pDupInfo->uVehicleId = uVehicleId;
+      uPacketsBehind = 0;
    }
 
    // End: Detect if stream restarted
@@ -292,24 +330,41 @@ int radio_dup_detection_is_duplicate_on_stream(int iRadioInterfaceIndex, u8* pPa
    // ---------------------------------------------------
    // Check for packet duplication on stream for vehicle
 
-   int bIsDuplicatePacket = 0;
-   int iHashIndex = uStreamPacketIndex & PACKETS_INDEX_HASH_MASK;
-   if ( uStreamPacketIndex == pDupInfo->streamsPacketsHistory[uStreamIndex].packetsHashIndexes[iHashIndex] )
-      bIsDuplicatePacket = 1;
-
-   if ( (uPacketType == PACKET_TYPE_RUBY_PING_CLOCK) || (uPacketType == PACKET_TYPE_RUBY_PING_CLOCK_REPLY) )
-      bIsDuplicatePacket = 0;
+   int bAlwaysAccept = ((uPacketType == PACKET_TYPE_RUBY_PING_CLOCK) || (uPacketType == PACKET_TYPE_RUBY_PING_CLOCK_REPLY))?1:0;
+   u32 uWord = (uStreamPacketIndex >> 6) & DUP_DET_WINDOW_WORDS_MASK;
+   u64 uBit = ((u64)1) << (uStreamPacketIndex & 0x3F);
 
-   if ( bIsDuplicatePacket )
+   if ( MAX_U32 == pStreamInfo->uLastReceivedPacketIndex )
+   {
+      // First packet on the stream (or after a reset): the window starts at it
+      memset((u8*)pStreamInfo->uWindow, 0, DUP_DET_WINDOW_WORDS * sizeof(u64));
+      pStreamInfo->uMaxReceivedPacketIndex = uStreamPacketIndex;
+   }
+   else if ( (0 == uPacketsBehind) && (uStreamPacketIndex != pStreamInfo->uMaxReceivedPacketIndex) )
+   {
+      // Newer than the max: slide the window, clear the words left behind
+      u32 uWordsAhead = ((uStreamPacketIndex >> 6) - (pStreamInfo->uMaxReceivedPacketIndex >> 6)) & (PACKET_FLAGS_MASK_STREAM_PACKET_IDX >> 6);
+      if ( uWordsAhead >= DUP_DET_WINDOW_WORDS )
+         memset((u8*)pStreamInfo->uWindow, 0, DUP_DET_WINDOW_WORDS * sizeof(u64));
+      else
+      {
+         u32 uClearWord = pStreamInfo->uMaxReceivedPacketIndex >> 6;
+         for( u32 u=0; u<uWordsAhead; u++ )
+         {
+            uClearWord++;
+            pStreamInfo->uWindow[uClearWord & DUP_DET_WINDOW_WORDS_MASK] = 0;
+         }
+      }
+      pStreamInfo->uMaxReceivedPacketIndex = uStreamPacketIndex;
+   }
+   else if ( (uPacketsBehind >= DUP_DET_WINDOW_PACKETS) && (! bAlwaysAccept) )
+      return 1;
+   else if ( (pStreamInfo->uWindow[uWord] & uBit) && (! bAlwaysAccept) )
       return 1;
 
-   
-   pDupInfo->streamsPacketsHistory[uStreamIndex].packetsHashIndexes[iHashIndex] = uStreamPacketIndex;
-   pDupInfo->streamsPacketsHistory[uStreamIndex].uLastReceivedPacketIndex = uStreamPacketIndex;
-   if ( uStreamPacketIndex > pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex )
-      pDupInfo->streamsPacketsHistory[uStreamIndex].uMaxReceivedPacketIndex = uStreamPacketIndex;
-
-   pDupInfo->streamsPacketsHistory[uStreamIndex].uLastTimeReceivedPacket = s_uRadioRxTimeNow;
+   pStreamInfo->uWindow[uWord] |= uBit;
+   pStreamInfo->uLastReceivedPacketIndex = uStreamPacketIndex;
+   pStreamInfo->uLastTimeReceivedPacket = s_uRadioRxTimeNow;
 
    // End - Check for packet duplication on stream for vehicle
    // -------------------------------------------------------------
@@ -339,10 +394,10 @@ void radio_duplicate_detection_remove_data_for_vid(u32 uVehicleId)
 
 int radio_dup_detection_is_vehicle_restarted(u32 uVehicleId)
 {
-   for ( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
-      if ( s_ListHistoryRxPacketsVehicles[i].uVehicleId == uVehicleId )
-         return s_ListHistoryRxPacketsVehicles[i].iRestartDetected;
-   return 0;
+   int iIndex = _radio_dup_detection_find_vid(uVehicleId);
+   if ( -1 == iIndex )
+      return 0;
+   return s_ListHistoryRxPacketsVehicles[iIndex].iRestartDetected;
 }
 
 void radio_dup_detection_set_vehicle_restarted_flag(u32 uVehicleId)
@@ -379,11 +434,8 @@ u32 radio_dup_detection_get_max_received_packet_index_for_stream(u32 uVehicleId,
    if ( uStreamId >= MAX_RADIO_STREAMS )
       return 0;
 
-   for( int i=0; i<MAX_CONCURENT_VEHICLES; i++ )
-   {
-      if ( s_ListHistoryRxPacketsVehicles[i].uVehicleId == uVehicleId )
-         return s_ListHistoryRxPacketsVehicles[i].streamsPacketsHistory[uStreamId].uMaxReceivedPacketIndex;
-   }
-
-   return 0;
+   int iIndex = _radio_dup_detection_find_vid(uVehicleId);
+   if ( -1 == iIndex )
+      return 0;
+   return s_ListHistoryRxPacketsVehicles[iIndex].streamsPacketsHistory[uStreamId].uMaxReceivedPacketIndex;
 }
\ No newline at end of file
@@ -0,0 +1,660 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include "../base/base.h"
+#include "radio_link_sim.h"
+#include "radiotap.h"
+
+#define RADIO_LINK_SIM_SOCKET_BUFFER_SIZE (2*1024*1024)
+
+static u64 _radio_link_sim_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000;
+}
+
+// xorshift32, one generator per writer so runs with the same seed are repeatable
+static u32 _radio_link_sim_random(type_radio_link_sim_tx* pTx)
+{
+   u32 x = pTx->uRandomState;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   pTx->uRandomState = x;
+   return x;
+}
+
+static int _radio_link_sim_chance(type_radio_link_sim_tx* pTx, int iPerMille)
+{
+   if ( iPerMille <= 0 )
+      return 0;
+   if ( iPerMille >= 1000 )
+      return 1;
+   return ((int)(_radio_link_sim_random(pTx) % 1000) < iPerMille)?1:0;
+}
+
+void radio_link_sim_set_default_params(type_radio_link_sim_params* pParams)
+{
+   if ( NULL == pParams )
+      return;
+   memset(pParams, 0, sizeof(type_radio_link_sim_params));
+   pParams->iSignalDBM = -50;
+   pParams->iNoiseDBM = -90;
+}
+
+static int _radio_link_sim_parse_per_mille(const char* szValue)
+{
+   // Percents, fractional values allowed
+   double fValue = atof(szValue);
+   if ( fValue < 0.0 )
+      fValue = 0.0;
+   if ( fValue > 100.0 )
+      fValue = 100.0;
+   return (int)(fValue * 10.0 + 0.5);
+}
+
+int radio_link_sim_parse_params(const char* szParams, type_radio_link_sim_params* pParams)
+{
+   if ( (NULL == szParams) || (NULL == pParams) )
+      return 0;
+
+   char szBuffer[256];
+   strncpy(szBuffer, szParams, sizeof(szBuffer)-1);
+   szBuffer[sizeof(szBuffer)-1] = 0;
+
+   char* pSavePtr = NULL;
+   for( char* szToken = strtok_r(szBuffer, ",", &pSavePtr); NULL != szToken; szToken = strtok_r(NULL, ",", &pSavePtr) )
+   {
+      char* szValue = strchr(szToken, '=');
+      if ( NULL == szValue )
+      {
+         log_softerror_and_alarm("[RadioLinkSim] Invalid link param [%s], expected key=value.", szToken);
+         return 0;
+      }
+      *szValue = 0;
+      szValue++;
+
+      if ( 0 == strcmp(szToken, "loss") )
+         pParams->iLossPerMille = _radio_link_sim_parse_per_mille(szValue);
+      else if ( 0 == strcmp(szToken, "burst") )
+      {
+         // start:end:loss, percents
+         char* szEnd = strchr(szValue, ':');
+         char* szLoss = (NULL != szEnd)?strchr(szEnd+1, ':'):NULL;
+         pParams->iBurstStartPerMille = _radio_link_sim_parse_per_mille(szValue);
+         pParams->iBurstEndPerMille = (NULL != szEnd)?_radio_link_sim_parse_per_mille(szEnd+1):1000;
+         pParams->iBurstLossPerMille = (NULL != szLoss)?_radio_link_sim_parse_per_mille(szLoss+1):1000;
+      }
+      else if ( 0 == strcmp(szToken, "reorder") )
+      {
+         // percent:delay ms
+         char* szDelay = strchr(szValue, ':');
+         pParams->iReorderPerMille = _radio_link_sim_parse_per_mille(szValue);
+         pParams->uReorderDelayMicros = (NULL != szDelay)?(u32)(atof(szDelay+1)*1000.0):2000;
+      }
+      else if ( 0 == strcmp(szToken, "delay") )
+         pParams->uDelayMicros = (u32)(atof(szValue)*1000.0);
+      else if ( 0 == strcmp(szToken, "jitter") )
+         pParams->uJitterMicros = (u32)(atof(szValue)*1000.0);
+      else if ( 0 == strcmp(szToken, "rate") )
+         pParams->uRateBPS = (u32)atoi(szValue)*1000;
+      else if ( 0 == strcmp(szToken, "queue") )
+         pParams->uMaxQueueMicros = (u32)(atof(szValue)*1000.0);
+      else if ( 0 == strcmp(szToken, "signal") )
+         pParams->iSignalDBM = atoi(szValue);
+      else if ( 0 == strcmp(szToken, "noise") )
+         pParams->iNoiseDBM = atoi(szValue);
+      else if ( 0 == strcmp(szToken, "seed") )
+         pParams->uSeed = (u32)strtoul(szValue, NULL, 10);
+      else
+      {
+         log_softerror_and_alarm("[RadioLinkSim] Unknown link param [%s].", szToken);
+         return 0;
+      }
+   }
+   return 1;
+}
+
+void radio_link_sim_log_params(const char* szPrefix, type_radio_link_sim_params* pParams)
+{
+   if ( NULL == pParams )
+      return;
+   log_line("%s loss: %d.%d%%, burst: start %d.%d%% end %d.%d%% loss %d.%d%%, reorder: %d.%d%% by %u us, delay: %u us + %u us jitter, rate: %u kbps, max queue: %u us, signal/noise: %d/%d dBm",
+      (NULL != szPrefix)?szPrefix:"[RadioLinkSim]",
+      pParams->iLossPerMille/10, pParams->iLossPerMille%10,
+      pParams->iBurstStartPerMille/10, pParams->iBurstStartPerMille%10,
+      pParams->iBurstEndPerMille/10, pParams->iBurstEndPerMille%10,
+      pParams->iBurstLossPerMille/10, pParams->iBurstLossPerMille%10,
+      pParams->iReorderPerMille/10, pParams->iReorderPerMille%10, pParams->uReorderDelayMicros,
+      pParams->uDelayMicros, pParams->uJitterMicros, pParams->uRateBPS/1000, pParams->uMaxQueueMicros,
+      pParams->iSignalDBM, pParams->iNoiseDBM);
+}
+
+static int _radio_link_sim_tx_needs_queue(type_radio_link_sim_params* pParams)
+{
+   if ( (0 != pParams->uDelayMicros) || (0 != pParams->uJitterMicros) || (0 != pParams->uRateBPS) )
+      return 1;
+   if ( (pParams->iReorderPerMille > 0) && (0 != pParams->uReorderDelayMicros) )
+      return 1;
+   return 0;
+}
+
+static void _radio_link_sim_tx_send(type_radio_link_sim_tx* pTx, u8* pFrame, int iLength)
+{
+   // The radio port is the first byte of the IEEE receiver address (encoded), right after the radiotap header
+   int iRadiotapLength = pFrame[2] | (((int)pFrame[3]) << 8);
+   if ( iRadiotapLength + 5 > iLength )
+   {
+      pTx->stats.uFramesSendErrors++;
+      return;
+   }
+   int iRadioPort = (pFrame[iRadiotapLength + 4] >> 4) & 0x0F;
+
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = htons(pTx->uBasePort + iRadioPort);
+
+   if ( sendto(pTx->iSocket, pFrame, iLength, MSG_DONTWAIT, (struct sockaddr*)&addr, sizeof(addr)) != iLength )
+   {
+      pTx->stats.uFramesSendErrors++;
+      return;
+   }
+   pTx->stats.uFramesDelivered++;
+   pTx->stats.uBytesDelivered += iLength;
+}
+
+// Heap helpers, called with the mutex locked
+
+static int _radio_link_sim_heap_less(type_radio_link_sim_queued_frame* pA, type_radio_link_sim_queued_frame* pB)
+{
+   if ( pA->uReleaseTimeMicros != pB->uReleaseTimeMicros )
+      return (pA->uReleaseTimeMicros < pB->uReleaseTimeMicros)?1:0;
+   return ((int)(pA->uSequence - pB->uSequence) < 0)?1:0;
+}
+
+static void _radio_link_sim_heap_push(type_radio_link_sim_tx* pTx, type_radio_link_sim_queued_frame* pFrame)
+{
+   int iPos = pTx->iHeapCount;
+   pTx->iHeapCount++;
+   while ( iPos > 0 )
+   {
+      int iParent = (iPos-1)/2;
+      if ( ! _radio_link_sim_heap_less(pFrame, &pTx->pHeap[iParent]) )
+         break;
+      pTx->pHeap[iPos] = pTx->pHeap[iParent];
+      iPos = iParent;
+   }
+   pTx->pHeap[iPos] = *pFrame;
+}
+
+static void _radio_link_sim_heap_pop(type_radio_link_sim_tx* pTx)
+{
+   pTx->iHeapCount--;
+   if ( 0 == pTx->iHeapCount )
+      return;
+   type_radio_link_sim_queued_frame last = pTx->pHeap[pTx->iHeapCount];
+   int iPos = 0;
+   while ( 1 )
+   {
+      int iChild = iPos*2+1;
+      if ( iChild >= pTx->iHeapCount )
+         break;
+      if ( (iChild+1 < pTx->iHeapCount) && _radio_link_sim_heap_less(&pTx->pHeap[iChild+1], &pTx->pHeap[iChild]) )
+         iChild++;
+      if ( ! _radio_link_sim_heap_less(&pTx->pHeap[iChild], &last) )
+         break;
+      pTx->pHeap[iPos] = pTx->pHeap[iChild];
+      iPos = iChild;
+   }
+   pTx->pHeap[iPos] = last;
+}
+
+static void* _thread_radio_link_sim_delivery(void* pParam)
+{
+   type_radio_link_sim_tx* pTx = (type_radio_link_sim_tx*)pParam;
+   log_line("[RadioLinkSim] Started delivery thread for base port %d.", (int)pTx->uBasePort);
+
+   pthread_mutex_lock(&pTx->mutex);
+   while ( ! pTx->iStopRequested )
+   {
+      if ( 0 == pTx->iHeapCount )
+      {
+         pthread_cond_wait(&pTx->cond, &pTx->mutex);
+         continue;
+      }
+      u64 uTimeNow = _radio_link_sim_time_micros();
+      type_radio_link_sim_queued_frame* pHead = &pTx->pHeap[0];
+      if ( pHead->uReleaseTimeMicros > uTimeNow )
+      {
+         struct timespec t;
+         t.tv_sec = pHead->uReleaseTimeMicros / 1000000;
+         t.tv_nsec = (pHead->uReleaseTimeMicros % 1000000) * 1000;
+         pthread_cond_timedwait(&pTx->cond, &pTx->mutex, &t);
+         continue;
+      }
+      int iSlot = pHead->iSlot;
+      _radio_link_sim_heap_pop(pTx);
+      _radio_link_sim_tx_send(pTx, pTx->pSlab + iSlot * RADIO_LINK_SIM_MAX_FRAME_SIZE, pTx->pSlotsLengths[iSlot]);
+      pTx->pFreeSlots[pTx->iFreeSlotsCount] = iSlot;
+      pTx->iFreeSlotsCount++;
+   }
+   pthread_mutex_unlock(&pTx->mutex);
+
+   log_line("[RadioLinkSim] Stopped delivery thread for base port %d.", (int)pTx->uBasePort);
+   return NULL;
+}
+
+static void _radio_link_sim_tx_free_queue(type_radio_link_sim_tx* pTx)
+{
+   if ( NULL != pTx->pSlab )
+      free(pTx->pSlab);
+   if ( NULL != pTx->pSlotsLengths )
+      free(pTx->pSlotsLengths);
+   if ( NULL != pTx->pFreeSlots )
+      free(pTx->pFreeSlots);
+   if ( NULL != pTx->pHeap )
+      free(pTx->pHeap);
+   pTx->pSlab = NULL;
+   pTx->pSlotsLengths = NULL;
+   pTx->pFreeSlots = NULL;
+   pTx->pHeap = NULL;
+   pTx->iFreeSlotsCount = 0;
+   pTx->iHeapCount = 0;
+}
+
+int radio_link_sim_tx_open(type_radio_link_sim_tx* pTx, u16 uBasePort, type_radio_link_sim_params* pParams)
+{
+   if ( (NULL == pTx) || (0 == uBasePort) )
+      return -1;
+
+   memset(pTx, 0, sizeof(type_radio_link_sim_tx));
+   pTx->iSocket = -1;
+   pTx->uBasePort = uBasePort;
+   if ( NULL != pParams )
+      memcpy(&pTx->params, pParams, sizeof(type_radio_link_sim_params));
+   else
+      radio_link_sim_set_default_params(&pTx->params);
+
+   pTx->uRandomState = pTx->params.uSeed;
+   if ( 0 == pTx->uRandomState )
+      pTx->uRandomState = (u32)_radio_link_sim_time_micros() | 1;
+
+   pTx->iSocket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+   if ( pTx->iSocket < 0 )
+   {
+      log_softerror_and_alarm("[RadioLinkSim] Failed to create tx socket, error: %d (%s)", errno, strerror(errno));
+      return -1;
+   }
+   int iBufferSize = RADIO_LINK_SIM_SOCKET_BUFFER_SIZE;
+   setsockopt(pTx->iSocket, SOL_SOCKET, SO_SNDBUF, &iBufferSize, sizeof(iBufferSize));
+
+   if ( _radio_link_sim_tx_needs_queue(&pTx->params) )
+   {
+      pTx->pSlab = (u8*) malloc(RADIO_LINK_SIM_MAX_QUEUED_FRAMES * RADIO_LINK_SIM_MAX_FRAME_SIZE);
+      pTx->pSlotsLengths = (int*) calloc(RADIO_LINK_SIM_MAX_QUEUED_FRAMES, sizeof(int));
+      pTx->pFreeSlots = (int*) calloc(RADIO_LINK_SIM_MAX_QUEUED_FRAMES, sizeof(int));
+      pTx->pHeap = (type_radio_link_sim_queued_frame*) calloc(RADIO_LINK_SIM_MAX_QUEUED_FRAMES, sizeof(type_radio_link_sim_queued_frame));
+      if ( (NULL == pTx->pSlab) || (NULL == pTx->pSlotsLengths) || (NULL == pTx->pFreeSlots) || (NULL == pTx->pHeap) )
+      {
+         log_error_and_alarm("[RadioLinkSim] Failed to allocate the delivery queue (%d frames).", RADIO_LINK_SIM_MAX_QUEUED_FRAMES);
+         _radio_link_sim_tx_free_queue(pTx);
+         close(pTx->iSocket);
+         pTx->iSocket = -1;
+         return -1;
+      }
+      for( int i=0; i<RADIO_LINK_SIM_MAX_QUEUED_FRAMES; i++ )
+         pTx->pFreeSlots[i] = RADIO_LINK_SIM_MAX_QUEUED_FRAMES-1-i;
+      pTx->iFreeSlotsCount = RADIO_LINK_SIM_MAX_QUEUED_FRAMES;
+
+      pthread_condattr_t attr;
+      pthread_condattr_init(&attr);
+      pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+      pthread_cond_init(&pTx->cond, &attr);
+      pthread_condattr_destroy(&attr);
+      pthread_mutex_init(&pTx->mutex, NULL);
+
+      if ( 0 != pthread_create(&pTx->threadDelivery, NULL, &_thread_radio_link_sim_delivery, pTx) )
+      {
+         log_error_and_alarm("[RadioLinkSim] Failed to create the delivery thread.");
+         pthread_cond_destroy(&pTx->cond);
+         pthread_mutex_destroy(&pTx->mutex);
+         _radio_link_sim_tx_free_queue(pTx);
+         close(pTx->iSocket);
+         pTx->iSocket = -1;
+         return -1;
+      }
+      pTx->iThreadRunning = 1;
+   }
+
+   radio_link_sim_log_params("[RadioLinkSim] Opened tx,", &pTx->params);
+   return pTx->iSocket;
+}
+
+void radio_link_sim_tx_close(type_radio_link_sim_tx* pTx)
+{
+   if ( (NULL == pTx) || (pTx->iSocket < 0) )
+      return;
+
+   if ( pTx->iThreadRunning )
+   {
+      pthread_mutex_lock(&pTx->mutex);
+      pTx->iStopRequested = 1;
+      pthread_cond_signal(&pTx->cond);
+      pthread_mutex_unlock(&pTx->mutex);
+      pthread_join(pTx->threadDelivery, NULL);
+      pTx->iThreadRunning = 0;
+      if ( pTx->iHeapCount > 0 )
+         log_line("[RadioLinkSim] Discarded %d frames still in the delivery queue.", pTx->iHeapCount);
+      pthread_cond_destroy(&pTx->cond);
+      pthread_mutex_destroy(&pTx->mutex);
+   }
+   _radio_link_sim_tx_free_queue(pTx);
+
+   log_line("[RadioLinkSim] Closed tx. Frames in: %u, delivered: %u, lost random/burst: %u/%u, queue drops: %u, reordered: %u, send errors: %u",
+      pTx->stats.uFramesIn, pTx->stats.uFramesDelivered, pTx->stats.uFramesLostRandom, pTx->stats.uFramesLostBurst,
+      pTx->stats.uFramesDroppedQueue, pTx->stats.uFramesReordered, pTx->stats.uFramesSendErrors);
+   close(pTx->iSocket);
+   pTx->iSocket = -1;
+}
+
+int radio_link_sim_tx_is_open(type_radio_link_sim_tx* pTx)
+{
+   if ( (NULL == pTx) || (pTx->iSocket < 0) )
+      return 0;
+   return 1;
+}
+
+int radio_link_sim_tx_write(type_radio_link_sim_tx* pTx, u8* pFrame, int iLength)
+{
+   if ( (NULL == pTx) || (pTx->iSocket < 0) || (NULL == pFrame) || (iLength <= 0) )
+      return 0;
+   if ( iLength > RADIO_LINK_SIM_MAX_FRAME_SIZE )
+   {
+      log_softerror_and_alarm("[RadioLinkSim] Tried to send a frame too big (%d bytes).", iLength);
+      return 0;
+   }
+
+   if ( pTx->iThreadRunning )
+      pthread_mutex_lock(&pTx->mutex);
+
+   pTx->stats.uFramesIn++;
+
+   // Gilbert-Elliott loss: the state changes first, then the loss of the state applies
+   if ( pTx->iInBurst )
+   {
+      if ( _radio_link_sim_chance(pTx, pTx->params.iBurstEndPerMille) )
+         pTx->iInBurst = 0;
+   }
+   else if ( _radio_link_sim_chance(pTx, pTx->params.iBurstStartPerMille) )
+   {
+      pTx->iInBurst = 1;
+      pTx->stats.uBursts++;
+   }
+
+   int iLost = 0;
+   if ( pTx->iInBurst )
+   {
+      if ( _radio_link_sim_chance(pTx, pTx->params.iBurstLossPerMille) )
+      {
+         pTx->stats.uFramesLostBurst++;
+         iLost = 1;
+      }
+   }
+   else if ( _radio_link_sim_chance(pTx, pTx->params.iLossPerMille) )
+   {
+      pTx->stats.uFramesLostRandom++;
+      iLost = 1;
+   }
+
+   // A lost frame still used the air time
+   u64 uTimeNow = _radio_link_sim_time_micros();
+   u64 uTimeDone = uTimeNow;
+   if ( 0 != pTx->params.uRateBPS )
+   {
+      if ( pTx->uLinkBusyUntilMicros > uTimeNow )
+         uTimeDone = pTx->uLinkBusyUntilMicros;
+      if ( (0 != pTx->params.uMaxQueueMicros) && (uTimeDone - uTimeNow > pTx->params.uMaxQueueMicros) )
+      {
+         if ( ! iLost )
+            pTx->stats.uFramesDroppedQueue++;
+         if ( pTx->iThreadRunning )
+            pthread_mutex_unlock(&pTx->mutex);
+         return 1;
+      }
+      uTimeDone += ((u64)iLength * 8LL * 1000000LL) / pTx->params.uRateBPS;
+      pTx->uLinkBusyUntilMicros = uTimeDone;
+   }
+
+   if ( iLost )
+   {
+      if ( pTx->iThreadRunning )
+         pthread_mutex_unlock(&pTx->mutex);
+      return 1;
+   }
+
+   if ( ! pTx->iThreadRunning )
+   {
+      _radio_link_sim_tx_send(pTx, pFrame, iLength);
+      return 1;
+   }
+
+   u64 uReleaseTime = uTimeDone + pTx->params.uDelayMicros;
+   if ( 0 != pTx->params.uJitterMicros )
+      uReleaseTime += _radio_link_sim_random(pTx) % (pTx->params.uJitterMicros + 1);
+   // Jitter does not reorder frames (a radio link delivers in order), only the reorder setting does
+   if ( uReleaseTime < pTx->uLastReleaseTimeMicros )
+      uReleaseTime = pTx->uLastReleaseTimeMicros;
+   pTx->uLastReleaseTimeMicros = uReleaseTime;
+   if ( _radio_link_sim_chance(pTx, pTx->params.iReorderPerMille) )
+   {
+      uReleaseTime += pTx->params.uReorderDelayMicros;
+      pTx->stats.uFramesReordered++;
+   }
+
+   if ( 0 == pTx->iFreeSlotsCount )
+   {
+      pTx->stats.uFramesDroppedQueue++;
+      pthread_mutex_unlock(&pTx->mutex);
+      return 1;
+   }
+   pTx->iFreeSlotsCount--;
+   int iSlot = pTx->pFreeSlots[pTx->iFreeSlotsCount];
+   memcpy(pTx->pSlab + iSlot * RADIO_LINK_SIM_MAX_FRAME_SIZE, pFrame, iLength);
+   pTx->pSlotsLengths[iSlot] = iLength;
+
+   type_radio_link_sim_queued_frame frame;
+   frame.uReleaseTimeMicros = uReleaseTime;
+   frame.uSequence = pTx->uNextSequence++;
+   frame.iSlot = iSlot;
+   _radio_link_sim_heap_push(pTx, &frame);
+
+   // Wake up the delivery thread only if this frame is the next one to release
+   if ( pTx->pHeap[0].iSlot == iSlot )
+      pthread_cond_signal(&pTx->cond);
+   pthread_mutex_unlock(&pTx->mutex);
+   return 1;
+}
+
+int radio_link_sim_tx_get_queued_frames(type_radio_link_sim_tx* pTx)
+{
+   if ( (NULL == pTx) || (! pTx->iThreadRunning) )
+      return 0;
+   pthread_mutex_lock(&pTx->mutex);
+   int iCount = pTx->iHeapCount;
+   pthread_mutex_unlock(&pTx->mutex);
+   return iCount;
+}
+
+void radio_link_sim_tx_get_stats(type_radio_link_sim_tx* pTx, type_radio_link_sim_stats* pStats)
+{
+   if ( (NULL == pTx) || (NULL == pStats) )
+      return;
+   if ( pTx->iThreadRunning )
+      pthread_mutex_lock(&pTx->mutex);
+   memcpy(pStats, &pTx->stats, sizeof(type_radio_link_sim_stats));
+   if ( pTx->iThreadRunning )
+      pthread_mutex_unlock(&pTx->mutex);
+}
+
+int radio_link_sim_rx_open(type_radio_link_sim_rx* pRx, u16 uBasePort, int iRadioPort, int iSignalDBM, int iNoiseDBM)
+{
+   if ( (NULL == pRx) || (0 == uBasePort) || (iRadioPort < 0) || (iRadioPort > 15) )
+      return -1;
+
+   pRx->iSocket = -1;
+   pRx->iRadioPort = iRadioPort;
+   pRx->iSignalDBM = iSignalDBM;
+   pRx->iNoiseDBM = iNoiseDBM;
+   pRx->uTotalFramesRead = 0;
+
+   pRx->iSocket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+   if ( pRx->iSocket < 0 )
+   {
+      log_softerror_and_alarm("[RadioLinkSim] Failed to create rx socket, error: %d (%s)", errno, strerror(errno));
+      return -1;
+   }
+   int iBufferSize = RADIO_LINK_SIM_SOCKET_BUFFER_SIZE;
+   setsockopt(pRx->iSocket, SOL_SOCKET, SO_RCVBUF, &iBufferSize, sizeof(iBufferSize));
+
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = htons(uBasePort + iRadioPort);
+   if ( bind(pRx->iSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 )
+   {
+      log_softerror_and_alarm("[RadioLinkSim] Failed to bind rx socket for radio port %d on UDP port %d, error: %d (%s)", iRadioPort, (int)uBasePort + iRadioPort, errno, strerror(errno));
+      close(pRx->iSocket);
+      pRx->iSocket = -1;
+      return -1;
+   }
+   log_line("[RadioLinkSim] Opened rx for radio port %d on UDP port %d, fd=%d", iRadioPort, (int)uBasePort + iRadioPort, pRx->iSocket);
+   return pRx->iSocket;
+}
+
+void radio_link_sim_rx_close(type_radio_link_sim_rx* pRx)
+{
+   if ( (NULL == pRx) || (pRx->iSocket < 0) )
+      return;
+   log_line("[RadioLinkSim] Closed rx for radio port %d, frames read: %u", pRx->iRadioPort, pRx->uTotalFramesRead);
+   close(pRx->iSocket);
+   pRx->iSocket = -1;
+}
+
+int radio_link_sim_rx_is_open(type_radio_link_sim_rx* pRx)
+{
+   if ( (NULL == pRx) || (pRx->iSocket < 0) )
+      return 0;
+   return 1;
+}
+
+u8* radio_link_sim_rx_next_frame(type_radio_link_sim_rx* pRx, int* piFrameLength)
+{
+   if ( NULL != piFrameLength )
+      *piFrameLength = 0;
+   if ( (NULL == pRx) || (pRx->iSocket < 0) )
+      return NULL;
+
+   u8* pTxFrame = pRx->uFrame + RADIO_LINK_SIM_RX_HEADROOM;
+   int iLength = recv(pRx->iSocket, pTxFrame, RADIO_LINK_SIM_MAX_FRAME_SIZE, 0);
+   if ( iLength <= 8 )
+      return NULL;
+
+   int iTxRadiotapLength = pTxFrame[2] | (((int)pTxFrame[3]) << 8);
+   if ( (iTxRadiotapLength < 8) || (iTxRadiotapLength >= iLength) )
+      return NULL;
+
+   // Keep the rate or MCS the frame was sent with
+   int iHasRate = 0;
+   int iHasMCS = 0;
+   u8 uRate = 0;
+   u8 uMCS[3] = { 0, 0, 0 };
+   struct ieee80211_radiotap_iterator rti;
+   if ( ieee80211_radiotap_iterator_init(&rti, (struct ieee80211_radiotap_header*)pTxFrame, iTxRadiotapLength) >= 0 )
+   {
+      while ( 0 == ieee80211_radiotap_iterator_next(&rti) )
+      {
+         if ( rti.this_arg_index == IEEE80211_RADIOTAP_RATE )
+         {
+            uRate = *rti.this_arg;
+            iHasRate = 1;
+         }
+         else if ( rti.this_arg_index == IEEE80211_RADIOTAP_MCS )
+         {
+            memcpy(uMCS, rti.this_arg, 3);
+            iHasMCS = 1;
+         }
+      }
+   }
+
+   // Rx radiotap header: flags, rate, antenna signal, antenna noise, antenna, mcs; all fields are byte aligned
+   u8 uHeader[RADIO_LINK_SIM_RX_HEADROOM];
+   u32 uPresent = (1<<IEEE80211_RADIOTAP_FLAGS) | (1<<IEEE80211_RADIOTAP_DBM_ANTSIGNAL) | (1<<IEEE80211_RADIOTAP_DBM_ANTNOISE) | (1<<IEEE80211_RADIOTAP_ANTENNA);
+   if ( iHasMCS )
+      uPresent |= (1<<IEEE80211_RADIOTAP_MCS);
+   else if ( iHasRate )
+      uPresent |= (1<<IEEE80211_RADIOTAP_RATE);
+   int iPos = 8;
+   uHeader[iPos++] = 0;
+   if ( (! iHasMCS) && iHasRate )
+      uHeader[iPos++] = uRate;
+   uHeader[iPos++] = (u8)(int8_t)pRx->iSignalDBM;
+   uHeader[iPos++] = (u8)(int8_t)pRx->iNoiseDBM;
+   uHeader[iPos++] = 0;
+   if ( iHasMCS )
+   {
+      memcpy(&uHeader[iPos], uMCS, 3);
+      iPos += 3;
+   }
+   uHeader[0] = 0;
+   uHeader[1] = 0;
+   uHeader[2] = (u8)(iPos & 0xFF);
+   uHeader[3] = (u8)(iPos >> 8);
+   uHeader[4] = (u8)(uPresent & 0xFF);
+   uHeader[5] = (u8)((uPresent >> 8) & 0xFF);
+   uHeader[6] = (u8)((uPresent >> 16) & 0xFF);
+   uHeader[7] = (u8)((uPresent >> 24) & 0xFF);
+
+   u8* pRxFrame = pTxFrame + iTxRadiotapLength - iPos;
+   memcpy(pRxFrame, uHeader, iPos);
+   pRx->uTotalFramesRead++;
+   if ( NULL != piFrameLength )
+      *piFrameLength = iLength - iTxRadiotapLength + iPos;
+   return pRxFrame;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "../base/base.h"
+#include <pthread.h>
+
+// Radio link simulator: stands in for the monitor mode wifi interfaces, so the vehicle and
+// station radio paths can run on any Linux box (in the same process or in different processes).
+// Raw frames (radiotap + IEEE header + Ruby packets, as built for injection) are carried over UDP
+// on localhost: a frame written on radio port P goes to uBasePort+P, where the interface opened
+// for read on that port is bound (one reader per radio port on a channel).
+// The writer applies the link impairments: random loss, burst loss (Gilbert-Elliott, two states),
+// a fixed delay plus jitter (order preserving), reordering (frames held back) and a max link rate with a bounded queue.
+// Delayed frames are released by a delivery thread. The reader replaces the tx radiotap header with
+// a rx one (same rate/MCS, simulated signal and noise), as a monitor mode interface would.
+
+#define RADIO_LINK_SIM_DEFAULT_BASE_PORT 5720
+#define RADIO_LINK_SIM_MAX_FRAME_SIZE 2048
+#define RADIO_LINK_SIM_MAX_QUEUED_FRAMES 4096
+#define RADIO_LINK_SIM_RX_HEADROOM 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   int iLossPerMille; // random loss, in the good state
+   int iBurstStartPerMille; // chance, per frame, to enter the burst state
+   int iBurstEndPerMille; // chance, per frame, to leave the burst state
+   int iBurstLossPerMille; // loss in the burst state
+   int iReorderPerMille; // frames held back by uReorderDelayMicros, later frames get ahead of them
+   u32 uReorderDelayMicros;
+   u32 uDelayMicros;
+   u32 uJitterMicros; // uniform, added to the delay
+   u32 uRateBPS; // 0 for no rate limit
+   u32 uMaxQueueMicros; // rate limited frames that would wait longer than this are dropped; 0 for no limit
+   int iSignalDBM; // reported on the rx side
+   int iNoiseDBM;
+   u32 uSeed; // 0: seeded from the clock
+} type_radio_link_sim_params;
+
+typedef struct
+{
+   u32 uFramesIn;
+   u32 uFramesDelivered;
+   u32 uFramesLostRandom;
+   u32 uFramesLostBurst;
+   u32 uFramesDroppedQueue;
+   u32 uFramesReordered;
+   u32 uFramesSendErrors; // no reader on the port or the reader socket buffer is full
+   u32 uBursts;
+   u64 uBytesDelivered;
+} type_radio_link_sim_stats;
+
+typedef struct
+{
+   u64 uReleaseTimeMicros;
+   u32 uSequence; // frames with the same release time keep the write order
+   int iSlot;
+} type_radio_link_sim_queued_frame;
+
+typedef struct
+{
+   int iSocket;
+   u16 uBasePort;
+   type_radio_link_sim_params params;
+   type_radio_link_sim_stats stats;
+   u32 uRandomState;
+   int iInBurst;
+   u64 uLinkBusyUntilMicros;
+   u64 uLastReleaseTimeMicros; // of the last frame not reordered
+   u32 uNextSequence;
+
+   // Delivery queue (min heap on release time), used when frames are delayed or rate limited
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int iThreadRunning;
+   int iStopRequested;
+   pthread_t threadDelivery;
+   u8* pSlab; // RADIO_LINK_SIM_MAX_QUEUED_FRAMES frames of RADIO_LINK_SIM_MAX_FRAME_SIZE bytes
+   int* pSlotsLengths;
+   int* pFreeSlots;
+   int iFreeSlotsCount;
+   type_radio_link_sim_queued_frame* pHeap;
+   int iHeapCount;
+} type_radio_link_sim_tx;
+
+typedef struct
+{
+   int iSocket;
+   int iRadioPort;
+   int iSignalDBM;
+   int iNoiseDBM;
+   u32 uTotalFramesRead;
+   u8 uFrame[RADIO_LINK_SIM_RX_HEADROOM + RADIO_LINK_SIM_MAX_FRAME_SIZE];
+} type_radio_link_sim_rx;
+
+void radio_link_sim_set_default_params(type_radio_link_sim_params* pParams);
+// Parses comma separated key=value pairs (loss, burst=start:end:loss, reorder=permille:delayms,
+// delay (ms), jitter (ms), rate (kbps), queue (ms), signal, noise, seed) over the current values.
+// Loss values are in percents (fractional values allowed). Returns 1 on success.
+int radio_link_sim_parse_params(const char* szParams, type_radio_link_sim_params* pParams);
+void radio_link_sim_log_params(const char* szPrefix, type_radio_link_sim_params* pParams);
+
+// Writer side. Returns the socket fd or -1 on error.
+int radio_link_sim_tx_open(type_radio_link_sim_tx* pTx, u16 uBasePort, type_radio_link_sim_params* pParams);
+void radio_link_sim_tx_close(type_radio_link_sim_tx* pTx);
+int radio_link_sim_tx_is_open(type_radio_link_sim_tx* pTx);
+// Returns 1 if the frame was accepted (it can still be lost on the simulated link), 0 on error.
+int radio_link_sim_tx_write(type_radio_link_sim_tx* pTx, u8* pFrame, int iLength);
+int radio_link_sim_tx_get_queued_frames(type_radio_link_sim_tx* pTx);
+void radio_link_sim_tx_get_stats(type_radio_link_sim_tx* pTx, type_radio_link_sim_stats* pStats);
+
+// Reader side. iRadioPort is the port index (0..15). Returns the selectable fd or -1 on error.
+int radio_link_sim_rx_open(type_radio_link_sim_rx* pRx, u16 uBasePort, int iRadioPort, int iSignalDBM, int iNoiseDBM);
+void radio_link_sim_rx_close(type_radio_link_sim_rx* pRx);
+int radio_link_sim_rx_is_open(type_radio_link_sim_rx* pRx);
+// Returns the next received frame (with a rx radiotap header) or NULL if none is available.
+// The frame is valid until the next read.
+u8* radio_link_sim_rx_next_frame(type_radio_link_sim_rx* pRx, int* piFrameLength);
+
+#ifdef __cplusplus
+}
+#endif
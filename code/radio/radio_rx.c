@@ -34,6 +34,8 @@
 #include "../base/encr.h"
 #include "../base/config_hw.h"
 #include "../base/hardware_procs.h"
+#include "../base/latency_trace.h"
+#include "../base/packet_pool.h"
 #include "../common/radio_stats.h"
 #include "../common/string_utils.h"
 #include "radio_rx.h"
@@ -43,6 +45,7 @@
 
 
 int s_iRadioRxInitialized = 0;
+static u32 s_uRadioRxStartCount = 0;
 int s_iRadioRxThreadRunning = 0;
 int s_iRadioRxSignalStop = 0;
 int s_iRadioRxResetSignalInfo = 0;
@@ -84,8 +87,6 @@ int s_iRadioRxCountFDs = 0;
 int s_iRadioRxMaxFD = 0;
 struct timeval s_iRadioRxReadTimeInterval;
 
-u8 s_tmpLastProcessedRadioRxPacket[MAX_PACKET_TOTAL_SIZE];
-
 u32 s_uLastRxShortPacketsVehicleIds[MAX_RADIO_INTERFACES];
 
 // Pointers to array of int-s (max radio cards, for each card)
@@ -263,61 +264,24 @@ void _radio_rx_update_fd_sets()
 
 
 
-u8* _radio_rx_wait_get_queue_packet(t_radio_rx_state_packets_queue* pQueue, int iHighPriorityQueue, u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex)
-{
-   int iRes = -1;
-   /*
-   if ( 0 == uTimeoutMicroSec )
-      iRes = sem_trywait(pQueue->pSemaphoreRead);
-   else
-   {
-      struct timespec ts;
-      clock_gettime(CLOCK_REALTIME, &ts);
-      ts.tv_nsec += 1000LL*(long long)uTimeoutMicroSec*1000LL;
-      if ( ts.tv_nsec >= 1000000000LL )
-      {
-         ts.tv_sec++;
-         ts.tv_nsec -= 1000000000L;
-      }
-      iRes = sem_timedwait(pQueue->pSemaphoreRead, &ts);
-   }
-   if ( 0 != iRes )
-   {
-      if ( errno != ETIMEDOUT )
-         log_softerror_and_alarm("[RadioRx] Failed to timewait on %s semaphore for %u micros. Error: %d, %d, %s", iHighPriorityQueue?"high prio":"reg prio", uTimeoutMicroSec, iRes, errno, strerror(errno));
-      return NULL;
-   }
-   */
-   iRes = sem_trywait(pQueue->pSemaphoreRead);
-   if ( (0 != iRes) && (0 != uTimeoutMicroSec) )
-   {
-      hardware_sleep_micros(200);
-      iRes = sem_trywait(pQueue->pSemaphoreRead);
-   }
-   if ( 0 != iRes )
-      return NULL;
-   int iIndexToCopy = -1;
-   pthread_mutex_lock(&pQueue->mutexLock);
-   iIndexToCopy = pQueue->iCurrentPacketIndexToConsume;
-   if ( (iIndexToCopy != pQueue->iCurrentPacketIndexToWrite) && (NULL != pQueue->pPacketsBuffers[iIndexToCopy]) && (pQueue->iPacketsLengths[iIndexToCopy] > 0) && (pQueue->iPacketsLengths[iIndexToCopy] < MAX_PACKET_TOTAL_SIZE) )
-      pQueue->iCurrentPacketIndexToConsume = (pQueue->iCurrentPacketIndexToConsume + 1 ) % pQueue->iQueueSize;
-   else
-       iIndexToCopy = -1;
-   pthread_mutex_unlock(&pQueue->mutexLock);
+// Consumer side: time the last returned packet was read by the radio rx thread (latency trace clock), 0 if not traced
+static u64 s_uRadioRxLastPacketRxTimeMicros = 0;
 
-   if ( -1 == iIndexToCopy )
+u8* _radio_rx_wait_get_queue_packet(type_radio_rx_queue* pQueue, u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex)
+{
+   u8* pPacket = radio_rx_queue_borrow(pQueue, uTimeoutMicroSec, pLength, pRadioInterfaceIndex);
+   if ( NULL == pPacket )
       return NULL;
-
-   if ( NULL != pLength )
-      *pLength = pQueue->iPacketsLengths[iIndexToCopy];
+   s_uRadioRxLastPacketRxTimeMicros = radio_rx_queue_get_borrowed_time_micros(pQueue);
+   latency_trace_add_since(LATENCY_TRACE_STAGE_RADIO_RX, s_uRadioRxLastPacketRxTimeMicros);
    if ( NULL != pIsShortPacket )
-      *pIsShortPacket = pQueue->uPacketsAreShort[iIndexToCopy];
-   if ( NULL != pRadioInterfaceIndex )
-      *pRadioInterfaceIndex = pQueue->uPacketsRxInterface[iIndexToCopy];
-
-   memcpy(s_tmpLastProcessedRadioRxPacket, pQueue->pPacketsBuffers[iIndexToCopy], pQueue->iPacketsLengths[iIndexToCopy]);
+      *pIsShortPacket = 0;
+   return pPacket;
+}
 
-   return s_tmpLastProcessedRadioRxPacket;
+u64 radio_rx_get_last_packet_rx_time_micros()
+{
+   return s_uRadioRxLastPacketRxTimeMicros;
 }
 
 u32 radio_rx_get_current_frame_start_time()
@@ -420,6 +384,33 @@ void radio_rx_check_update_eof(u32 uTimeNow, u32 uTimeGuard, u32 uVideoFPS, u32
    s_iIsEOFDetected = 0; 
 }
 
+int radio_rx_get_wakeup_fd()
+{
+   if ( 0 == s_iRadioRxInitialized )
+      return -1;
+   return s_RadioRxState.queues_wakeup.iEventFd;
+}
+
+u32 radio_rx_get_start_count()
+{
+   return s_uRadioRxStartCount;
+}
+
+int radio_rx_prepare_wait()
+{
+   if ( 0 == s_iRadioRxInitialized )
+      return 0;
+   type_radio_rx_queue* pQueues[2] = { &(s_RadioRxState.queue_high_priority), &(s_RadioRxState.queue_reg_priority) };
+   return radio_rx_queue_wakeup_prepare_wait(&(s_RadioRxState.queues_wakeup), pQueues, 2);
+}
+
+void radio_rx_finish_wait()
+{
+   if ( 0 == s_iRadioRxInitialized )
+      return;
+   radio_rx_queue_wakeup_finish_wait(&(s_RadioRxState.queues_wakeup));
+}
+
 u8* radio_rx_wait_get_next_received_high_prio_packet(u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex)
 {
    if ( NULL != pLength )
@@ -431,7 +422,7 @@ u8* radio_rx_wait_get_next_received_high_prio_packet(u32 uTimeoutMicroSec, int*
    if ( 0 == s_iRadioRxInitialized )
       return NULL;
 
-   return _radio_rx_wait_get_queue_packet(&(s_RadioRxState.queue_high_priority), 1, uTimeoutMicroSec, pLength, pIsShortPacket, pRadioInterfaceIndex);
+   return _radio_rx_wait_get_queue_packet(&(s_RadioRxState.queue_high_priority), uTimeoutMicroSec, pLength, pIsShortPacket, pRadioInterfaceIndex);
 }
 
 u8* radio_rx_wait_get_next_received_reg_prio_packet(u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex)
@@ -445,7 +436,7 @@ u8* radio_rx_wait_get_next_received_reg_prio_packet(u32 uTimeoutMicroSec, int* p
    if ( 0 == s_iRadioRxInitialized )
       return NULL;
 
-   return _radio_rx_wait_get_queue_packet(&(s_RadioRxState.queue_reg_priority), 0, uTimeoutMicroSec, pLength, pIsShortPacket, pRadioInterfaceIndex);
+   return _radio_rx_wait_get_queue_packet(&(s_RadioRxState.queue_reg_priority), uTimeoutMicroSec, pLength, pIsShortPacket, pRadioInterfaceIndex);
 }
 
 void _radio_rx_add_packet_to_rx_queue(u8* pPacket, int iLength, int iRadioInterface)
@@ -456,38 +447,11 @@ void _radio_rx_add_packet_to_rx_queue(u8* pPacket, int iLength, int iRadioInterf
    t_packet_header* pPH = (t_packet_header*)pPacket;
    u8 uPacketFlags = pPH->packet_flags;
 
-   t_radio_rx_state_packets_queue* pQueue = &s_RadioRxState.queue_reg_priority;
+   type_radio_rx_queue* pQueue = &s_RadioRxState.queue_reg_priority;
    if ( uPacketFlags & PACKET_FLAGS_BIT_HIGH_PRIORITY )
       pQueue = &s_RadioRxState.queue_high_priority;
 
-   int iIndexToWriteTo = -1;
-   pthread_mutex_lock(&pQueue->mutexLock);
-   iIndexToWriteTo = pQueue->iCurrentPacketIndexToWrite;
-   // No more room? Discard oldest packet
-   if ( ((pQueue->iCurrentPacketIndexToWrite+1) % pQueue->iQueueSize) == pQueue->iCurrentPacketIndexToConsume )
-       pQueue->iCurrentPacketIndexToConsume = (pQueue->iCurrentPacketIndexToConsume+1) % pQueue->iQueueSize;
-
-   pQueue->iCurrentPacketIndexToWrite = (pQueue->iCurrentPacketIndexToWrite + 1) % pQueue->iQueueSize;
-   pthread_mutex_unlock(&pQueue->mutexLock);
-
-   // Add the packet to the queue
-   pQueue->uPacketsRxInterface[iIndexToWriteTo] = iRadioInterface;
-   pQueue->uPacketsAreShort[iIndexToWriteTo] = 0;
-   pQueue->iPacketsLengths[iIndexToWriteTo] = iLength;
-   memcpy(pQueue->pPacketsBuffers[iIndexToWriteTo], pPacket, iLength);
-      
-   if ( (NULL != pQueue->pSemaphoreWrite) && (0 != sem_post(pQueue->pSemaphoreWrite)) )
-      log_softerror_and_alarm("Failed to set semaphore for packet ready.");
- 
-   iIndexToWriteTo = (iIndexToWriteTo + 1) % pQueue->iQueueSize;
-   int iCountPackets = iIndexToWriteTo - pQueue->iCurrentPacketIndexToConsume;
-   if ( iIndexToWriteTo < pQueue->iCurrentPacketIndexToConsume )
-      iCountPackets = iIndexToWriteTo + (pQueue->iQueueSize - pQueue->iCurrentPacketIndexToConsume);
-
-   if ( iCountPackets > pQueue->iStatsMaxPacketsInQueueLastMinute )
-      pQueue->iStatsMaxPacketsInQueueLastMinute = iCountPackets;
-   if ( iCountPackets > pQueue->iStatsMaxPacketsInQueue )
-      pQueue->iStatsMaxPacketsInQueue = iCountPackets;
+   radio_rx_queue_push_timed(pQueue, pPacket, iLength, iRadioInterface, latency_trace_is_enabled()?latency_trace_get_time_micros():0);
 
    //s_uRadioRxLastTimeQueue += get_current_timestamp_ms() - s_uRadioRxTimeNow;
 }
@@ -743,7 +707,8 @@ int _radio_rx_parse_received_wifi_radio_data(int iInterfaceIndex, int iMaxReads)
    //static int sdebugCountParser = 0;
    //sdebugCountParser++;
 
-   for( int iCountReads=0; iCountReads<iMaxReads; iCountReads++ )
+   // On mmap rx rings, drain the whole block currently handed to user space
+   for( int iCountReads=0; (iCountReads<iMaxReads) || (radio_get_rx_ring_pending_frames(iInterfaceIndex) > 0); iCountReads++ )
    {
       iBufferLength = 0;
       iRxDatarate = 0;
@@ -932,16 +897,13 @@ void _radio_rx_update_stats(u32 uTimeNow)
       s_RadioRxState.queue_high_priority.iStatsMaxPacketsInQueueLastMinute = 0;
       s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueueLastMinute = 0;
 
-      int iCountPacketsHigh = s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite - s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume;
-      if ( s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite < s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume )
-         iCountPacketsHigh = s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite + (s_RadioRxState.queue_high_priority.iQueueSize - s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume);
+      int iCountPacketsHigh = radio_rx_queue_get_count(&s_RadioRxState.queue_high_priority);
+      int iCountPacketsReg = radio_rx_queue_get_count(&s_RadioRxState.queue_reg_priority);
 
-      int iCountPacketsReg = s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite - s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume;
-      if ( s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite < s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume )
-         iCountPacketsReg = s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite + (s_RadioRxState.queue_reg_priority.iQueueSize - s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume);
-
-      log_line("[RadioRxThread] Packets in queues now pending consumption (high/reg prio): %d/%d",
-         iCountPacketsHigh, iCountPacketsReg);
+      log_line("[RadioRxThread] Packets in queues now pending consumption (high/reg prio): %d/%d, dropped on full queues: %u/%u",
+         iCountPacketsHigh, iCountPacketsReg,
+         s_RadioRxState.queue_high_priority.uDroppedPackets,
+         s_RadioRxState.queue_reg_priority.uDroppedPackets);
 
       if ( (s_iCounterRadioRxStatsUpdate2 % 10) == 0 )
       {
@@ -1052,14 +1014,8 @@ void * _thread_radio_rx(void *argument)
          }
       }
 
-      int iDbg1 = s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite - s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume;
-      if ( s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite < s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume )
-         iDbg1 = s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite + (s_RadioRxState.queue_reg_priority.iQueueSize - s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume);
-      
-      int iDbg2 = s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite - s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume;
-      if ( s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite < s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume )
-         iDbg2 = s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite + (s_RadioRxState.queue_high_priority.iQueueSize - s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume);
-
+      //int iDbg1 = radio_rx_queue_get_count(&s_RadioRxState.queue_reg_priority);
+      //int iDbg2 = radio_rx_queue_get_count(&s_RadioRxState.queue_high_priority);
       //if ( (iDbg1 > 10) || (iDbg2 > 10) )
       //   log_line("DBG radio rx has %d reg and %d high prio pending packets to consume", iDbg1, iDbg2);
       
@@ -1239,6 +1195,7 @@ void * _thread_radio_rx(void *argument)
    }
 
    s_iRadioRxMarkedForQuit = 0;
+   packet_pool_flush_thread_cache();
    log_line("[RadioRxThread] Stopped.");
    s_iRadioRxThreadRunning = 0;
    return NULL;
@@ -1246,127 +1203,24 @@ void * _thread_radio_rx(void *argument)
 
 int _radio_rx_init_queues()
 {
-   s_RadioRxState.queue_reg_priority.iQueueSize = MAX_RX_PACKETS_QUEUE_REG;
-   s_RadioRxState.queue_high_priority.iQueueSize = MAX_RX_PACKETS_QUEUE_HIP;
-
-   for( int i=0; i<s_RadioRxState.queue_reg_priority.iQueueSize; i++ )
-   {
-      s_RadioRxState.queue_reg_priority.iPacketsLengths[i] = 0;
-      s_RadioRxState.queue_reg_priority.uPacketsAreShort[i] = 0;
-      s_RadioRxState.queue_reg_priority.uPacketsRxInterface[i] = 0;
-      s_RadioRxState.queue_reg_priority.pPacketsBuffers[i] = (u8*) malloc(MAX_PACKET_TOTAL_SIZE);
-      if ( NULL == s_RadioRxState.queue_reg_priority.pPacketsBuffers[i] )
-      {
-         log_error_and_alarm("[RadioRx] Failed to allocate rx packets buffers!");
-         return -1;
-      }
-   }
-   log_line("[RadioRx] Allocated %u bytes for %d rx packets (reg priority)", s_RadioRxState.queue_reg_priority.iQueueSize * MAX_PACKET_TOTAL_SIZE, s_RadioRxState.queue_reg_priority.iQueueSize);
+   // Previous queues, if any, are freed on stop
+   if ( ! radio_rx_queue_wakeup_init(&s_RadioRxState.queues_wakeup) )
+      log_softerror_and_alarm("[RadioRx] Failed to create rx queues wakeup event. Will poll rx queues.");
 
-   for( int i=0; i<s_RadioRxState.queue_high_priority.iQueueSize; i++ )
+   if ( ! radio_rx_queue_init(&s_RadioRxState.queue_reg_priority, MAX_RX_PACKETS_QUEUE_REG, &s_RadioRxState.queues_wakeup) )
    {
-      s_RadioRxState.queue_high_priority.iPacketsLengths[i] = 0;
-      s_RadioRxState.queue_high_priority.uPacketsAreShort[i] = 0;
-      s_RadioRxState.queue_high_priority.uPacketsRxInterface[i] = 0;
-      s_RadioRxState.queue_high_priority.pPacketsBuffers[i] = (u8*) malloc(MAX_PACKET_TOTAL_SIZE);
-      if ( NULL == s_RadioRxState.queue_high_priority.pPacketsBuffers[i] )
-      {
-         log_error_and_alarm("[RadioRx] Failed to allocate rx packets buffers!");
-         return 0;
-      }
-   }
-   log_line("[RadioRx] Allocated %u bytes for %d rx packets (high priority)", s_RadioRxState.queue_high_priority.iQueueSize * MAX_PACKET_TOTAL_SIZE, s_RadioRxState.queue_high_priority.iQueueSize);
-
-   s_RadioRxState.queue_high_priority.iCurrentPacketIndexToConsume = 0;
-   s_RadioRxState.queue_high_priority.iCurrentPacketIndexToWrite = 0;
-   s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToConsume = 0;
-   s_RadioRxState.queue_reg_priority.iCurrentPacketIndexToWrite = 0;
-   
-   s_RadioRxState.queue_high_priority.iStatsMaxPacketsInQueue = 0;
-   s_RadioRxState.queue_high_priority.iStatsMaxPacketsInQueueLastMinute = 0;
-   s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueue = 0;
-   s_RadioRxState.queue_reg_priority.iStatsMaxPacketsInQueueLastMinute = 0;
-
-   sem_unlink(RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-   sem_unlink(RUBY_SEM_RX_RADIO_REG_PRIORITY);
-
-   pthread_mutexattr_t mutexAttr;
-   if ( 0 != pthread_mutexattr_init(&mutexAttr) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to initialize rx queues mutex attributes.");
-      return -1;
-   }
-   if ( 0 != pthread_mutex_init(&s_RadioRxState.queue_high_priority.mutexLock, &mutexAttr) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to initialize high prio rx queue mutex.");
+      log_error_and_alarm("[RadioRx] Failed to allocate rx packets buffers!");
       return -1;
    }
-   if ( 0 != pthread_mutex_init(&s_RadioRxState.queue_reg_priority.mutexLock, &mutexAttr) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to initialize reg prio rx queue mutex.");
-      return -1;
-   }
-
-   if ( 0 != pthread_mutexattr_destroy(&mutexAttr) )
-      log_error_and_alarm("[RadioRx] Failed to cleanup radio rx queues mutex attributes");
-
-   s_RadioRxState.queue_high_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_CREAT | O_RDWR, S_IWUSR | S_IRUSR, 0);
-   if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreWrite) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s, try alternative.", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-      s_RadioRxState.queue_high_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreWrite) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-         return -1;
-      }
-   }
-   s_RadioRxState.queue_high_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_RDWR);
-   if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreRead) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s, try alternative.", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-      s_RadioRxState.queue_high_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_HIGH_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_high_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_high_priority.pSemaphoreRead) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s", RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-         return -1;
-      }
-   }
-   int iSemVal = 0;
-   if ( 0 == sem_getvalue(s_RadioRxState.queue_high_priority.pSemaphoreRead, &iSemVal) )
-      log_line("[RadioRx] High priority queue semaphore initial value: %d", iSemVal);
-   else
-      log_softerror_and_alarm("[RadioRx] Failed to get high priority queue sem value.");
+   log_line("[RadioRx] Allocated %u bytes for %u rx packets (reg priority)", s_RadioRxState.queue_reg_priority.uQueueSize * MAX_PACKET_TOTAL_SIZE, s_RadioRxState.queue_reg_priority.uQueueSize);
 
-   s_RadioRxState.queue_reg_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_CREAT | O_RDWR, S_IWUSR | S_IRUSR, 0);
-   if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) )
-   {
-      log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s, try alternative.", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-      s_RadioRxState.queue_reg_priority.pSemaphoreWrite = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreWrite) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create write semaphore: %s", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-         return -1;
-      }
-   }
-   s_RadioRxState.queue_reg_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_RDWR);
-   if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreRead) )
+   if ( ! radio_rx_queue_init(&s_RadioRxState.queue_high_priority, MAX_RX_PACKETS_QUEUE_HIP, &s_RadioRxState.queues_wakeup) )
    {
-      log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s, try alternative", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-      s_RadioRxState.queue_reg_priority.pSemaphoreRead = sem_open(RUBY_SEM_RX_RADIO_REG_PRIORITY, O_CREAT, S_IWUSR | S_IRUSR, 0); 
-      if ( (NULL == s_RadioRxState.queue_reg_priority.pSemaphoreRead) || (SEM_FAILED == s_RadioRxState.queue_reg_priority.pSemaphoreRead) )
-      {
-         log_error_and_alarm("[RadioRx] Failed to create read semaphore: %s", RUBY_SEM_RX_RADIO_REG_PRIORITY);
-         return -1;
-      }
+      log_error_and_alarm("[RadioRx] Failed to allocate rx packets buffers!");
+      radio_rx_queue_free(&s_RadioRxState.queue_reg_priority);
+      return -1;
    }
-
-   iSemVal = 0;
-   if ( 0 == sem_getvalue(s_RadioRxState.queue_reg_priority.pSemaphoreRead, &iSemVal) )
-      log_line("[RadioRx] Reg priority queue semaphore initial value: %d", iSemVal);
-   else
-      log_softerror_and_alarm("[RadioRx] Failed to get reg priority queue sem value.");
-
+   log_line("[RadioRx] Allocated %u bytes for %u rx packets (high priority)", s_RadioRxState.queue_high_priority.uQueueSize * MAX_PACKET_TOTAL_SIZE, s_RadioRxState.queue_high_priority.uQueueSize);
    return 0;
 }
 
@@ -1431,6 +1285,7 @@ int radio_rx_start_rx_thread(shared_mem_radio_stats* pSMRadioStats, int iSearchM
    }
    pthread_attr_destroy(&attr);
    s_iRadioRxInitialized = 1;
+   s_uRadioRxStartCount++;
    log_line("[RadioRx] Initialized data and started rx thread, accepted firmware types: %s.", str_format_firmware_type(s_RadioRxState.uAcceptedFirmwareType));
    return 1;
 }
@@ -1458,24 +1313,13 @@ void radio_rx_stop_rx_thread()
       pthread_cancel(s_pThreadRadioRx);
    }
 
-   if ( NULL != s_RadioRxState.queue_high_priority.pSemaphoreWrite )
-      sem_close(s_RadioRxState.queue_high_priority.pSemaphoreWrite);
-   if ( NULL != s_RadioRxState.queue_high_priority.pSemaphoreRead )
-      sem_close(s_RadioRxState.queue_high_priority.pSemaphoreRead);
-   if ( NULL != s_RadioRxState.queue_reg_priority.pSemaphoreWrite )
-      sem_close(s_RadioRxState.queue_reg_priority.pSemaphoreWrite);
-   if ( NULL != s_RadioRxState.queue_reg_priority.pSemaphoreRead )
-      sem_close(s_RadioRxState.queue_reg_priority.pSemaphoreRead);
-   s_RadioRxState.queue_high_priority.pSemaphoreWrite = NULL;
-   s_RadioRxState.queue_high_priority.pSemaphoreRead = NULL;
-   s_RadioRxState.queue_reg_priority.pSemaphoreWrite = NULL;
-   s_RadioRxState.queue_reg_priority.pSemaphoreRead = NULL;
-
-   pthread_mutex_destroy(&s_RadioRxState.queue_high_priority.mutexLock);
-   pthread_mutex_destroy(&s_RadioRxState.queue_reg_priority.mutexLock);
-
-   sem_unlink(RUBY_SEM_RX_RADIO_HIGH_PRIORITY);
-   sem_unlink(RUBY_SEM_RX_RADIO_REG_PRIORITY);
+   // A cancelled thread might still be adding packets, keep its queues in that case
+   if ( 0 == s_iRadioRxThreadRunning )
+   {
+      radio_rx_queue_free(&s_RadioRxState.queue_high_priority);
+      radio_rx_queue_free(&s_RadioRxState.queue_reg_priority);
+      radio_rx_queue_wakeup_close(&s_RadioRxState.queues_wakeup);
+   }
 
    log_line("[RadioRx] Finished stopping rx thread.");
 }
@@ -1632,6 +1476,12 @@ int radio_rx_detect_firmware_type_from_packet(u8* pPacketBuffer, int nPacketLeng
       {
          if ( pPH->packet_flags & PACKET_FLAGS_BIT_HAS_ENCRYPTION )
          {
+            if ( pPH->packet_flags_extended & PACKET_FLAGS_EXTENDED_BIT_ENC_AEAD )
+            {
+               if ( dpp_aead(pPacketBuffer, nPacketLength) )
+                  return MODEL_FIRMWARE_TYPE_RUBY;
+               return 0;
+            }
             int dx = sizeof(t_packet_header);
             int l = nPacketLength-dx;
             dpp(pPacketBuffer + dx, l);
@@ -3,6 +3,7 @@
 #include "../base/base.h"
 #include "../base/config.h"
 #include "../base/hardware.h"
+#include "radio_rx_queue.h"
 #include <pthread.h>
 #include <semaphore.h>
 
@@ -30,23 +31,6 @@ typedef struct
 
 } ALIGN_STRUCT_SPEC_INFO t_radio_rx_state_vehicle;
 
-typedef struct
-{
-   u8* pPacketsBuffers[MAX_RX_PACKETS_QUEUE_REG];
-   int iPacketsLengths[MAX_RX_PACKETS_QUEUE_REG];
-   u8  uPacketsAreShort[MAX_RX_PACKETS_QUEUE_REG];
-   u8  uPacketsRxInterface[MAX_RX_PACKETS_QUEUE_REG];
-   int iQueueSize;
-   _ATOMIC_PREFIX int iCurrentPacketIndexToWrite; // Where next packet will be added
-   _ATOMIC_PREFIX int iCurrentPacketIndexToConsume; // Where the first packet to read/consume is
-   int iStatsMaxPacketsInQueue;
-   int iStatsMaxPacketsInQueueLastMinute;
-
-   pthread_mutex_t mutexLock;
-   sem_t* pSemaphoreWrite;
-   sem_t* pSemaphoreRead;
-} ALIGN_STRUCT_SPEC_INFO t_radio_rx_state_packets_queue;
-
 typedef struct
 {
    int iRadioInterfacesBroken[MAX_RADIO_INTERFACES];
@@ -54,8 +38,9 @@ typedef struct
    int iRadioInterfacesRxBadPackets[MAX_RADIO_INTERFACES];
 
    t_radio_rx_state_vehicle vehicles[MAX_CONCURENT_VEHICLES];
-   t_radio_rx_state_packets_queue queue_high_priority;
-   t_radio_rx_state_packets_queue queue_reg_priority;
+   type_radio_rx_queue queue_high_priority;
+   type_radio_rx_queue queue_reg_priority;
+   type_radio_rx_queue_wakeup queues_wakeup; // Shared by both queues
 
    u32 uMaxLoopTime;
    u32 uAcceptedFirmwareType;
@@ -104,12 +89,25 @@ u32 radio_rx_get_and_reset_max_loop_time();
 u32 radio_rx_get_and_reset_max_loop_time_read();
 u32 radio_rx_get_and_reset_max_loop_time_queue();
 
+// Time the last packet returned by radio_rx_get_next_received_* was read by the radio rx thread
+// (latency_trace_get_time_micros clock), 0 if latency tracing is not enabled
+u64 radio_rx_get_last_packet_rx_time_micros();
+
 u32 radio_rx_get_current_frame_start_time();
 u32 radio_rx_get_current_frame_end_time();
 u16 radio_rx_get_current_frame_number();
 int radio_rx_is_eof_detected();
 void radio_rx_check_update_eof(u32 uTimeNow, u32 uTimeGuard, u32 uVideoFPS, u32 uMaxRetrWindow);
 
+// For consumers waiting in an event loop: the eventfd signaled when packets are pushed to the rx queues
+// (-1 if rx is not started; it's a new one, maybe with the same number, each time rx is started: check the start count)
+// and the wait handshake around the wait on it. radio_rx_prepare_wait returns 1 if there are packets already queued (don't block then).
+int radio_rx_get_wakeup_fd();
+u32 radio_rx_get_start_count();
+int radio_rx_prepare_wait();
+void radio_rx_finish_wait();
+
+// Packets are returned in place from the rx queues and are valid until the next call for the same priority
 u8* radio_rx_wait_get_next_received_high_prio_packet(u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex);
 u8* radio_rx_wait_get_next_received_reg_prio_packet(u32 uTimeoutMicroSec, int* pLength, int* pIsShortPacket, int* pRadioInterfaceIndex);
 
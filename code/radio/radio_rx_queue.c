@@ -0,0 +1,312 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/eventfd.h>
+#include <sys/select.h>
+#include "../base/base.h"
+#include "radio_rx_queue.h"
+
+int radio_rx_queue_wakeup_init(type_radio_rx_queue_wakeup* pWakeup)
+{
+   if ( NULL == pWakeup )
+      return 0;
+   pWakeup->iConsumerWaiting = 0;
+   pWakeup->iEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if ( pWakeup->iEventFd < 0 )
+   {
+      log_softerror_and_alarm("[RadioRxQueue] Failed to create wakeup eventfd, error: %d, %s", errno, strerror(errno));
+      return 0;
+   }
+   return 1;
+}
+
+void radio_rx_queue_wakeup_close(type_radio_rx_queue_wakeup* pWakeup)
+{
+   if ( NULL == pWakeup )
+      return;
+   if ( pWakeup->iEventFd >= 0 )
+      close(pWakeup->iEventFd);
+   pWakeup->iEventFd = -1;
+   pWakeup->iConsumerWaiting = 0;
+}
+
+int radio_rx_queue_init(type_radio_rx_queue* pQueue, int iMinQueueSize, type_radio_rx_queue_wakeup* pWakeup)
+{
+   if ( (NULL == pQueue) || (iMinQueueSize < 2) )
+      return 0;
+
+   memset(pQueue, 0, sizeof(type_radio_rx_queue));
+   pQueue->uQueueSize = 2;
+   while ( pQueue->uQueueSize < (u32)iMinQueueSize )
+      pQueue->uQueueSize *= 2;
+   pQueue->uQueueMask = pQueue->uQueueSize - 1;
+   pQueue->pWakeup = pWakeup;
+
+   pQueue->pPacketsBuffers = (u8**) calloc(pQueue->uQueueSize, sizeof(u8*));
+   pQueue->pPacketsLengths = (int*) calloc(pQueue->uQueueSize, sizeof(int));
+   pQueue->pPacketsRxInterface = (u8*) calloc(pQueue->uQueueSize, sizeof(u8));
+   pQueue->pPacketsTimeMicros = (u64*) calloc(pQueue->uQueueSize, sizeof(u64));
+   if ( (NULL == pQueue->pPacketsBuffers) || (NULL == pQueue->pPacketsLengths) || (NULL == pQueue->pPacketsRxInterface) || (NULL == pQueue->pPacketsTimeMicros) )
+   {
+      log_error_and_alarm("[RadioRxQueue] Failed to allocate rx queue.");
+      radio_rx_queue_free(pQueue);
+      return 0;
+   }
+   return 1;
+}
+
+void radio_rx_queue_free(type_radio_rx_queue* pQueue)
+{
+   if ( NULL == pQueue )
+      return;
+   if ( NULL != pQueue->pPacketsBuffers )
+   {
+      for( u32 u=0; u<pQueue->uQueueSize; u++ )
+      {
+         if ( NULL != pQueue->pPacketsBuffers[u] )
+            packet_pool_unref(pQueue->pPacketsBuffers[u]);
+      }
+      free(pQueue->pPacketsBuffers);
+   }
+   if ( NULL != pQueue->pPacketsLengths )
+      free(pQueue->pPacketsLengths);
+   if ( NULL != pQueue->pPacketsRxInterface )
+      free(pQueue->pPacketsRxInterface);
+   if ( NULL != pQueue->pPacketsTimeMicros )
+      free(pQueue->pPacketsTimeMicros);
+   pQueue->pPacketsBuffers = NULL;
+   pQueue->pPacketsLengths = NULL;
+   pQueue->pPacketsRxInterface = NULL;
+   pQueue->pPacketsTimeMicros = NULL;
+   pQueue->uQueueSize = 0;
+   pQueue->uQueueMask = 0;
+   pQueue->pWakeup = NULL;
+}
+
+int radio_rx_queue_push(type_radio_rx_queue* pQueue, u8* pPacket, int iLength, int iRadioInterfaceIndex)
+{
+   return radio_rx_queue_push_timed(pQueue, pPacket, iLength, iRadioInterfaceIndex, 0);
+}
+
+// Producer side: returns 0 if the queue is full
+static int _radio_rx_queue_has_room(type_radio_rx_queue* pQueue)
+{
+   u32 uWriteIndex = pQueue->uWriteIndex;
+   if ( uWriteIndex - pQueue->uCachedReadIndex >= pQueue->uQueueSize )
+   {
+      pQueue->uCachedReadIndex = __atomic_load_n(&pQueue->uReadIndex, __ATOMIC_ACQUIRE);
+      if ( uWriteIndex - pQueue->uCachedReadIndex >= pQueue->uQueueSize )
+         return 0;
+   }
+   return 1;
+}
+
+static int _radio_rx_queue_add(type_radio_rx_queue* pQueue, u8* pBuffer, int iLength, int iRadioInterfaceIndex, u64 uTimeMicros)
+{
+   u32 uWriteIndex = pQueue->uWriteIndex;
+   u32 uSlot = uWriteIndex & pQueue->uQueueMask;
+   pQueue->pPacketsBuffers[uSlot] = pBuffer;
+   pQueue->pPacketsLengths[uSlot] = iLength;
+   pQueue->pPacketsRxInterface[uSlot] = (u8)iRadioInterfaceIndex;
+   pQueue->pPacketsTimeMicros[uSlot] = uTimeMicros;
+   pQueue->uTotalPackets++;
+
+   // Publish the packet, then check (after a full barrier, paired with the consumer) if it must be woken up
+   __atomic_store_n(&pQueue->uWriteIndex, uWriteIndex + 1, __ATOMIC_SEQ_CST);
+   if ( NULL != pQueue->pWakeup )
+   if ( __atomic_load_n(&pQueue->pWakeup->iConsumerWaiting, __ATOMIC_SEQ_CST) )
+   {
+      u64 uValue = 1;
+      if ( write(pQueue->pWakeup->iEventFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+   }
+
+   int iCountPackets = (int)(uWriteIndex + 1 - pQueue->uCachedReadIndex);
+   if ( iCountPackets > pQueue->iStatsMaxPacketsInQueueLastMinute )
+   {
+      // Cached read index can be stale, get the current count
+      pQueue->uCachedReadIndex = __atomic_load_n(&pQueue->uReadIndex, __ATOMIC_ACQUIRE);
+      iCountPackets = (int)(uWriteIndex + 1 - pQueue->uCachedReadIndex);
+      if ( iCountPackets > pQueue->iStatsMaxPacketsInQueueLastMinute )
+         pQueue->iStatsMaxPacketsInQueueLastMinute = iCountPackets;
+      if ( iCountPackets > pQueue->iStatsMaxPacketsInQueue )
+         pQueue->iStatsMaxPacketsInQueue = iCountPackets;
+   }
+   return 1;
+}
+
+int radio_rx_queue_push_timed(type_radio_rx_queue* pQueue, u8* pPacket, int iLength, int iRadioInterfaceIndex, u64 uTimeMicros)
+{
+   if ( (NULL == pQueue) || (NULL == pQueue->pPacketsBuffers) || (NULL == pPacket) || (iLength <= 0) || (iLength > MAX_PACKET_TOTAL_SIZE) )
+      return 0;
+
+   if ( ! _radio_rx_queue_has_room(pQueue) )
+   {
+      pQueue->uDroppedPackets++;
+      return 0;
+   }
+   u8* pBuffer = packet_pool_alloc_copy(pPacket, iLength);
+   if ( NULL == pBuffer )
+   {
+      pQueue->uDroppedPackets++;
+      return 0;
+   }
+   return _radio_rx_queue_add(pQueue, pBuffer, iLength, iRadioInterfaceIndex, uTimeMicros);
+}
+
+int radio_rx_queue_push_buffer(type_radio_rx_queue* pQueue, u8* pBuffer, int iLength, int iRadioInterfaceIndex, u64 uTimeMicros)
+{
+   if ( NULL == pBuffer )
+      return 0;
+   if ( (NULL == pQueue) || (NULL == pQueue->pPacketsBuffers) || (iLength <= 0) || (iLength > PACKET_POOL_DATA_SIZE) || (! _radio_rx_queue_has_room(pQueue)) )
+   {
+      if ( NULL != pQueue )
+         pQueue->uDroppedPackets++;
+      packet_pool_unref(pBuffer);
+      return 0;
+   }
+   packet_pool_set_length(pBuffer, iLength);
+   return _radio_rx_queue_add(pQueue, pBuffer, iLength, iRadioInterfaceIndex, uTimeMicros);
+}
+
+void radio_rx_queue_release(type_radio_rx_queue* pQueue)
+{
+   if ( (NULL == pQueue) || (! pQueue->iHasBorrowedPacket) )
+      return;
+   pQueue->iHasBorrowedPacket = 0;
+   pQueue->uBorrowedPacketTimeMicros = 0;
+   u32 uSlot = pQueue->uReadIndex & pQueue->uQueueMask;
+   packet_pool_unref(pQueue->pPacketsBuffers[uSlot]);
+   pQueue->pPacketsBuffers[uSlot] = NULL;
+   __atomic_store_n(&pQueue->uReadIndex, pQueue->uReadIndex + 1, __ATOMIC_RELEASE);
+}
+
+u64 radio_rx_queue_get_borrowed_time_micros(type_radio_rx_queue* pQueue)
+{
+   if ( NULL == pQueue )
+      return 0;
+   return pQueue->uBorrowedPacketTimeMicros;
+}
+
+static int _radio_rx_queue_has_packets(type_radio_rx_queue* pQueue, int iMemoryOrder)
+{
+   if ( pQueue->uCachedWriteIndex != pQueue->uReadIndex )
+      return 1;
+   pQueue->uCachedWriteIndex = __atomic_load_n(&pQueue->uWriteIndex, iMemoryOrder);
+   return (pQueue->uCachedWriteIndex != pQueue->uReadIndex)?1:0;
+}
+
+static void _radio_rx_queue_wait(type_radio_rx_queue* pQueue, u32 uTimeoutMicroSec)
+{
+   type_radio_rx_queue_wakeup* pWakeup = pQueue->pWakeup;
+   if ( (NULL == pWakeup) || (pWakeup->iEventFd < 0) )
+   {
+      hardware_sleep_micros(uTimeoutMicroSec);
+      return;
+   }
+
+   // Announce the wait, then check again for packets pushed in the meantime (paired with the producer barrier)
+   __atomic_store_n(&pWakeup->iConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+   if ( ! _radio_rx_queue_has_packets(pQueue, __ATOMIC_SEQ_CST) )
+   {
+      fd_set readSet;
+      FD_ZERO(&readSet);
+      FD_SET(pWakeup->iEventFd, &readSet);
+      struct timeval timeout;
+      timeout.tv_sec = uTimeoutMicroSec / 1000000;
+      timeout.tv_usec = uTimeoutMicroSec % 1000000;
+      select(pWakeup->iEventFd + 1, &readSet, NULL, NULL, &timeout);
+   }
+   __atomic_store_n(&pWakeup->iConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+
+   u64 uValue = 0;
+   if ( read(pWakeup->iEventFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+}
+
+int radio_rx_queue_wakeup_prepare_wait(type_radio_rx_queue_wakeup* pWakeup, type_radio_rx_queue** pQueues, int iCountQueues)
+{
+   if ( (NULL == pWakeup) || (pWakeup->iEventFd < 0) )
+      return 1;
+
+   __atomic_store_n(&pWakeup->iConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+   for( int i=0; i<iCountQueues; i++ )
+   {
+      if ( (NULL != pQueues[i]) && (NULL != pQueues[i]->pPacketsBuffers) )
+      if ( _radio_rx_queue_has_packets(pQueues[i], __ATOMIC_SEQ_CST) )
+         return 1;
+   }
+   return 0;
+}
+
+void radio_rx_queue_wakeup_finish_wait(type_radio_rx_queue_wakeup* pWakeup)
+{
+   if ( (NULL == pWakeup) || (pWakeup->iEventFd < 0) )
+      return;
+   __atomic_store_n(&pWakeup->iConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+   u64 uValue = 0;
+   if ( read(pWakeup->iEventFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+}
+
+u8* radio_rx_queue_borrow(type_radio_rx_queue* pQueue, u32 uTimeoutMicroSec, int* pLength, int* pRadioInterfaceIndex)
+{
+   if ( (NULL == pQueue) || (NULL == pQueue->pPacketsBuffers) )
+      return NULL;
+
+   radio_rx_queue_release(pQueue);
+
+   if ( ! _radio_rx_queue_has_packets(pQueue, __ATOMIC_ACQUIRE) )
+   {
+      if ( 0 == uTimeoutMicroSec )
+         return NULL;
+      _radio_rx_queue_wait(pQueue, uTimeoutMicroSec);
+      if ( ! _radio_rx_queue_has_packets(pQueue, __ATOMIC_ACQUIRE) )
+         return NULL;
+   }
+
+   u32 uSlot = pQueue->uReadIndex & pQueue->uQueueMask;
+   pQueue->iHasBorrowedPacket = 1;
+   pQueue->uTotalConsumedPackets++;
+   pQueue->uBorrowedPacketTimeMicros = pQueue->pPacketsTimeMicros[uSlot];
+   if ( NULL != pLength )
+      *pLength = pQueue->pPacketsLengths[uSlot];
+   if ( NULL != pRadioInterfaceIndex )
+      *pRadioInterfaceIndex = pQueue->pPacketsRxInterface[uSlot];
+   return pQueue->pPacketsBuffers[uSlot];
+}
+
+int radio_rx_queue_get_count(type_radio_rx_queue* pQueue)
+{
+   if ( NULL == pQueue )
+      return 0;
+   u32 uWriteIndex = __atomic_load_n(&pQueue->uWriteIndex, __ATOMIC_ACQUIRE);
+   u32 uReadIndex = __atomic_load_n(&pQueue->uReadIndex, __ATOMIC_ACQUIRE);
+   return (int)(uWriteIndex - uReadIndex);
+}
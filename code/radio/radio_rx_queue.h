@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/packet_pool.h"
+#include "radiopackets2.h"
+
+// Single producer / single consumer queue of received radio packets.
+// The radio rx thread is the only producer and the router main loop the only consumer,
+// so no locks are used: each side owns its index and only reads the other one.
+// The consumer borrows packets in place and can block on an eventfd until packets arrive.
+// Packets are held in packet pool buffers: the consumer can keep a borrowed packet past its release by
+// taking a reference to it (packet_pool_ref) instead of copying it.
+
+#define RADIO_RX_QUEUE_CACHE_LINE 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared by all the queues read by the same consumer, so it's woken up by any of them
+typedef struct
+{
+   int iEventFd;
+   _ATOMIC_PREFIX int iConsumerWaiting;
+} type_radio_rx_queue_wakeup;
+
+typedef struct
+{
+   // Written by the producer only
+   _ATOMIC_PREFIX u32 uWriteIndex __attribute__((aligned(RADIO_RX_QUEUE_CACHE_LINE)));
+   u32 uCachedReadIndex;
+   u32 uTotalPackets;
+   u32 uDroppedPackets; // Dropped because the queue was full
+   int iStatsMaxPacketsInQueue;
+   int iStatsMaxPacketsInQueueLastMinute;
+
+   // Written by the consumer only
+   _ATOMIC_PREFIX u32 uReadIndex __attribute__((aligned(RADIO_RX_QUEUE_CACHE_LINE)));
+   u32 uCachedWriteIndex;
+   int iHasBorrowedPacket;
+   u32 uTotalConsumedPackets;
+   u64 uBorrowedPacketTimeMicros;
+
+   // Set on init only (the slots content is written by the producer, the pool buffer released by the consumer)
+   u8** pPacketsBuffers __attribute__((aligned(RADIO_RX_QUEUE_CACHE_LINE)));
+   int* pPacketsLengths;
+   u8*  pPacketsRxInterface;
+   u64* pPacketsTimeMicros; // optional push time, set by the producer
+   u32 uQueueSize; // power of 2
+   u32 uQueueMask;
+   type_radio_rx_queue_wakeup* pWakeup;
+} type_radio_rx_queue;
+
+int radio_rx_queue_wakeup_init(type_radio_rx_queue_wakeup* pWakeup);
+void radio_rx_queue_wakeup_close(type_radio_rx_queue_wakeup* pWakeup);
+
+// For consumers waiting on the wakeup eventfd in their own poll/epoll loop: announces the wait, then
+// checks the queues for packets pushed in the meantime. Returns 1 if there are packets (don't block then).
+// Must be followed by radio_rx_queue_wakeup_finish_wait after the wait.
+int radio_rx_queue_wakeup_prepare_wait(type_radio_rx_queue_wakeup* pWakeup, type_radio_rx_queue** pQueues, int iCountQueues);
+void radio_rx_queue_wakeup_finish_wait(type_radio_rx_queue_wakeup* pWakeup);
+
+// Queue size is rounded up to a power of 2. pWakeup can be NULL (consumer will poll).
+int radio_rx_queue_init(type_radio_rx_queue* pQueue, int iMinQueueSize, type_radio_rx_queue_wakeup* pWakeup);
+void radio_rx_queue_free(type_radio_rx_queue* pQueue);
+
+// Producer side. Returns 0 if the packet was dropped (queue full).
+int radio_rx_queue_push(type_radio_rx_queue* pQueue, u8* pPacket, int iLength, int iRadioInterfaceIndex);
+// Same, stores a time with the packet (any clock, used for latency tracing), read back with radio_rx_queue_get_borrowed_time_micros
+int radio_rx_queue_push_timed(type_radio_rx_queue* pQueue, u8* pPacket, int iLength, int iRadioInterfaceIndex, u64 uTimeMicros);
+// Same, without a copy: the queue takes over the caller's reference to the pool buffer (released if the packet is dropped)
+int radio_rx_queue_push_buffer(type_radio_rx_queue* pQueue, u8* pBuffer, int iLength, int iRadioInterfaceIndex, u64 uTimeMicros);
+
+// Consumer side. Returns the next packet, in place in the queue, waiting up to uTimeoutMicroSec
+// (or until a packet is pushed to any queue sharing the same wakeup) if none is available.
+// The packet stays valid until the next borrow/release on the same queue, unless the consumer takes a reference to it.
+u8* radio_rx_queue_borrow(type_radio_rx_queue* pQueue, u32 uTimeoutMicroSec, int* pLength, int* pRadioInterfaceIndex);
+void radio_rx_queue_release(type_radio_rx_queue* pQueue);
+// Time pushed with the last borrowed packet, 0 if none
+u64 radio_rx_queue_get_borrowed_time_micros(type_radio_rx_queue* pQueue);
+
+// Packets pending consumption (including a borrowed one)
+int radio_rx_queue_get_count(type_radio_rx_queue* pQueue);
+
+#ifdef __cplusplus
+}  
+#endif
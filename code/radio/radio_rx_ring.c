@@ -0,0 +1,248 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include "../base/base.h"
+#include "radio_rx_ring.h"
+
+int radio_rx_ring_get_interface_arp_type(const char* szInterfaceName)
+{
+   if ( (NULL == szInterfaceName) || (0 == szInterfaceName[0]) )
+      return -1;
+
+   int iSocket = socket(AF_PACKET, SOCK_RAW, 0);
+   if ( iSocket < 0 )
+      return -1;
+
+   struct ifreq ifr;
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, szInterfaceName, IFNAMSIZ-1);
+   int iResult = -1;
+   if ( ioctl(iSocket, SIOCGIFHWADDR, &ifr) == 0 )
+      iResult = ifr.ifr_hwaddr.sa_family;
+   close(iSocket);
+   return iResult;
+}
+
+int radio_rx_ring_open(type_radio_rx_ring* pRing, const char* szInterfaceName, struct bpf_program* pFilter)
+{
+   if ( (NULL == pRing) || (NULL == szInterfaceName) )
+      return -1;
+
+   memset(pRing, 0, sizeof(type_radio_rx_ring));
+   pRing->iSocketFd = -1;
+
+   int iInterfaceIndex = if_nametoindex(szInterfaceName);
+   if ( iInterfaceIndex <= 0 )
+   {
+      log_softerror_and_alarm("[RadioRxRing] Invalid interface [%s]", szInterfaceName);
+      return -1;
+   }
+
+   // Protocol 0: receive nothing until the ring and filter are set up and the socket is bound to the interface
+   pRing->iSocketFd = socket(AF_PACKET, SOCK_RAW, 0);
+   if ( pRing->iSocketFd < 0 )
+   {
+      log_softerror_and_alarm("[RadioRxRing] Failed to create socket for [%s], error: %d (%s)", szInterfaceName, errno, strerror(errno));
+      pRing->iSocketFd = -1;
+      return -1;
+   }
+
+   int iVersion = TPACKET_V3;
+   if ( 0 != setsockopt(pRing->iSocketFd, SOL_PACKET, PACKET_VERSION, &iVersion, sizeof(iVersion)) )
+   {
+      log_softerror_and_alarm("[RadioRxRing] TPACKET_V3 is not supported, error: %d (%s)", errno, strerror(errno));
+      radio_rx_ring_close(pRing);
+      return -1;
+   }
+
+   struct tpacket_req3 req;
+   memset(&req, 0, sizeof(req));
+   req.tp_block_size = RADIO_RX_RING_BLOCK_SIZE;
+   req.tp_block_nr = RADIO_RX_RING_BLOCKS_COUNT;
+   req.tp_frame_size = RADIO_RX_RING_FRAME_SIZE;
+   req.tp_frame_nr = (RADIO_RX_RING_BLOCK_SIZE * RADIO_RX_RING_BLOCKS_COUNT) / RADIO_RX_RING_FRAME_SIZE;
+   req.tp_retire_blk_tov = RADIO_RX_RING_BLOCK_TIMEOUT_MS;
+   req.tp_sizeof_priv = 0;
+   req.tp_feature_req_word = 0;
+
+   if ( 0 != setsockopt(pRing->iSocketFd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) )
+   {
+      log_softerror_and_alarm("[RadioRxRing] Failed to set rx ring for [%s], error: %d (%s)", szInterfaceName, errno, strerror(errno));
+      radio_rx_ring_close(pRing);
+      return -1;
+   }
+
+   pRing->uBlockSize = req.tp_block_size;
+   pRing->iBlocksCount = req.tp_block_nr;
+   pRing->uRingSize = req.tp_block_size * req.tp_block_nr;
+   u8* pBuffer = (u8*) mmap(NULL, pRing->uRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, pRing->iSocketFd, 0);
+   if ( MAP_FAILED == pBuffer )
+   {
+      log_softerror_and_alarm("[RadioRxRing] Failed to mmap rx ring (%u bytes) for [%s], error: %d (%s)", pRing->uRingSize, szInterfaceName, errno, strerror(errno));
+      radio_rx_ring_close(pRing);
+      return -1;
+   }
+   pRing->pRingBuffer = pBuffer;
+
+   if ( (NULL != pFilter) && (pFilter->bf_len > 0) )
+   {
+      // pcap bpf_insn and kernel sock_filter have the same layout
+      struct sock_fprog filter;
+      filter.len = pFilter->bf_len;
+      filter.filter = (struct sock_filter*) pFilter->bf_insns;
+      if ( 0 != setsockopt(pRing->iSocketFd, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) )
+      {
+         log_softerror_and_alarm("[RadioRxRing] Failed to attach filter for [%s], error: %d (%s)", szInterfaceName, errno, strerror(errno));
+         radio_rx_ring_close(pRing);
+         return -1;
+      }
+   }
+
+   struct sockaddr_ll ll_addr;
+   memset(&ll_addr, 0, sizeof(ll_addr));
+   ll_addr.sll_family = AF_PACKET;
+   ll_addr.sll_protocol = htons(ETH_P_ALL);
+   ll_addr.sll_ifindex = iInterfaceIndex;
+   if ( 0 != bind(pRing->iSocketFd, (struct sockaddr*)&ll_addr, sizeof(ll_addr)) )
+   {
+      log_softerror_and_alarm("[RadioRxRing] Failed to bind rx ring socket to [%s], error: %d (%s)", szInterfaceName, errno, strerror(errno));
+      radio_rx_ring_close(pRing);
+      return -1;
+   }
+
+   log_line("[RadioRxRing] Opened rx ring on [%s]: %d blocks of %u bytes, block timeout: %d ms, fd: %d",
+      szInterfaceName, pRing->iBlocksCount, pRing->uBlockSize, RADIO_RX_RING_BLOCK_TIMEOUT_MS, pRing->iSocketFd);
+   return pRing->iSocketFd;
+}
+
+void radio_rx_ring_close(type_radio_rx_ring* pRing)
+{
+   if ( NULL == pRing )
+      return;
+
+   if ( NULL != pRing->pRingBuffer )
+   {
+      struct tpacket_stats_v3 stats;
+      socklen_t uLen = sizeof(stats);
+      memset(&stats, 0, sizeof(stats));
+      if ( 0 == getsockopt(pRing->iSocketFd, SOL_PACKET, PACKET_STATISTICS, &stats, &uLen) )
+         log_line("[RadioRxRing] Closing rx ring fd %d. Read %u frames in %u blocks, kernel drops: %u",
+            pRing->iSocketFd, pRing->uTotalFramesRead, pRing->uTotalBlocksRead, stats.tp_drops);
+      munmap(pRing->pRingBuffer, pRing->uRingSize);
+   }
+   if ( pRing->iSocketFd >= 0 )
+      close(pRing->iSocketFd);
+
+   memset(pRing, 0, sizeof(type_radio_rx_ring));
+   pRing->iSocketFd = -1;
+}
+
+int radio_rx_ring_is_open(type_radio_rx_ring* pRing)
+{
+   if ( (NULL == pRing) || (NULL == pRing->pRingBuffer) )
+      return 0;
+   return 1;
+}
+
+u8* radio_rx_ring_next_frame(type_radio_rx_ring* pRing, int* piFrameLength)
+{
+   if ( NULL != piFrameLength )
+      *piFrameLength = 0;
+   if ( ! radio_rx_ring_is_open(pRing) )
+      return NULL;
+
+   while ( pRing->iFramesLeftInBlock <= 0 )
+   {
+      struct tpacket_block_desc* pBlock = (struct tpacket_block_desc*)(pRing->pRingBuffer + pRing->iCurrentBlock * pRing->uBlockSize);
+
+      // Return the consumed block to the kernel and move to the next one
+      if ( pRing->iCurrentBlockIsOwned )
+      {
+         __sync_synchronize();
+         pBlock->hdr.bh1.block_status = TP_STATUS_KERNEL;
+         pRing->iCurrentBlockIsOwned = 0;
+         pRing->iCurrentBlock = (pRing->iCurrentBlock + 1) % pRing->iBlocksCount;
+         pBlock = (struct tpacket_block_desc*)(pRing->pRingBuffer + pRing->iCurrentBlock * pRing->uBlockSize);
+      }
+
+      if ( 0 == (__atomic_load_n(&pBlock->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) )
+         return NULL;
+
+      pRing->iCurrentBlockIsOwned = 1;
+      pRing->iFramesLeftInBlock = pBlock->hdr.bh1.num_pkts;
+      pRing->pNextFrame = (u8*)pBlock + pBlock->hdr.bh1.offset_to_first_pkt;
+      pRing->uTotalBlocksRead++;
+   }
+
+   struct tpacket3_hdr* pFrameHeader = (struct tpacket3_hdr*) pRing->pNextFrame;
+   pRing->iFramesLeftInBlock--;
+   pRing->pNextFrame += pFrameHeader->tp_next_offset;
+   pRing->uTotalFramesRead++;
+
+   if ( NULL != piFrameLength )
+      *piFrameLength = pFrameHeader->tp_snaplen;
+   return ((u8*)pFrameHeader) + pFrameHeader->tp_mac;
+}
+
+int radio_rx_ring_get_pending_frames(type_radio_rx_ring* pRing)
+{
+   if ( ! radio_rx_ring_is_open(pRing) )
+      return 0;
+   return pRing->iFramesLeftInBlock;
+}
+
+int radio_rx_ring_drain_block(type_radio_rx_ring* pRing, u8** pFrames, int* piFramesLengths, int iMaxFrames)
+{
+   if ( (NULL == pFrames) || (NULL == piFramesLengths) || (iMaxFrames <= 0) )
+      return 0;
+
+   int iCount = 0;
+   while ( iCount < iMaxFrames )
+   {
+      pFrames[iCount] = radio_rx_ring_next_frame(pRing, &piFramesLengths[iCount]);
+      if ( NULL == pFrames[iCount] )
+         break;
+      iCount++;
+      // Do not advance to the next block, it would release the frames returned so far
+      if ( pRing->iFramesLeftInBlock <= 0 )
+         break;
+   }
+   return iCount;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../base/base.h"
+#include <pcap.h>
+
+// Memory mapped (AF_PACKET, TPACKET_V3) receive ring for monitor mode radio interfaces.
+// The kernel fills whole blocks of frames and hands them to user space;
+// frames are read in place from the ring, with no syscall or copy per frame.
+
+#define RADIO_RX_RING_BLOCK_SIZE ((u32)(1<<16))
+#define RADIO_RX_RING_BLOCKS_COUNT 32
+#define RADIO_RX_RING_FRAME_SIZE 2048
+// How long (ms) the kernel waits for a partially filled block before handing it to user space
+#define RADIO_RX_RING_BLOCK_TIMEOUT_MS 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   int iSocketFd;
+   u8* pRingBuffer;    // NULL when the ring is not opened
+   u32 uRingSize;
+   u32 uBlockSize;
+   int iBlocksCount;
+   int iCurrentBlock;
+   int iCurrentBlockIsOwned; // current block is handed to user space and not yet returned to kernel
+   int iFramesLeftInBlock;
+   u8* pNextFrame;
+   u32 uTotalFramesRead;
+   u32 uTotalBlocksRead;
+} type_radio_rx_ring;
+
+// Returns the ARPHRD_* type of the interface, or -1 on error
+int radio_rx_ring_get_interface_arp_type(const char* szInterfaceName);
+
+// pFilter is a compiled BPF program (can be NULL for no filtering). Returns the selectable fd or -1 on error.
+int radio_rx_ring_open(type_radio_rx_ring* pRing, const char* szInterfaceName, struct bpf_program* pFilter);
+void radio_rx_ring_close(type_radio_rx_ring* pRing);
+int radio_rx_ring_is_open(type_radio_rx_ring* pRing);
+
+// Returns the next received frame or NULL if none is available.
+// The frame is valid until the next read from the ring.
+u8* radio_rx_ring_next_frame(type_radio_rx_ring* pRing, int* piFrameLength);
+
+// Frames still available in the block currently owned by user space
+int radio_rx_ring_get_pending_frames(type_radio_rx_ring* pRing);
+
+// Returns all the frames (up to iMaxFrames) of the next ready block, or 0 if none is ready.
+// Frames are valid until the next read from the ring.
+int radio_rx_ring_drain_block(type_radio_rx_ring* pRing, u8** pFrames, int* piFramesLengths, int iMaxFrames);
+
+#ifdef __cplusplus
+}  
+#endif
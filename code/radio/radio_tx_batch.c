@@ -0,0 +1,178 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for sendmmsg
+#endif
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "../base/base.h"
+#include "radio_tx_batch.h"
+
+typedef struct
+{
+   struct mmsghdr messages[RADIO_TX_BATCH_MAX_FRAMES];
+   struct iovec iovecs[RADIO_TX_BATCH_MAX_FRAMES];
+} type_radio_tx_batch_messages;
+
+int radio_tx_batch_init(type_radio_tx_batch* pBatch)
+{
+   if ( NULL == pBatch )
+      return 0;
+   memset(pBatch, 0, sizeof(type_radio_tx_batch));
+
+   type_radio_tx_batch_messages* pMessages = (type_radio_tx_batch_messages*) calloc(1, sizeof(type_radio_tx_batch_messages));
+   if ( NULL == pMessages )
+   {
+      log_error_and_alarm("[RadioTxBatch] Failed to allocate tx batch messages.");
+      return 0;
+   }
+   pBatch->pMessages = pMessages;
+
+   for( int i=0; i<RADIO_TX_BATCH_MAX_FRAMES; i++ )
+   {
+      pBatch->pFramesBuffers[i] = (u8*) malloc(MAX_PACKET_TOTAL_SIZE);
+      if ( NULL == pBatch->pFramesBuffers[i] )
+      {
+         log_error_and_alarm("[RadioTxBatch] Failed to allocate tx batch buffers.");
+         radio_tx_batch_free(pBatch);
+         return 0;
+      }
+      pMessages->iovecs[i].iov_base = pBatch->pFramesBuffers[i];
+      pMessages->iovecs[i].iov_len = 0;
+      pMessages->messages[i].msg_hdr.msg_iov = &(pMessages->iovecs[i]);
+      pMessages->messages[i].msg_hdr.msg_iovlen = 1;
+   }
+   return 1;
+}
+
+void radio_tx_batch_free(type_radio_tx_batch* pBatch)
+{
+   if ( NULL == pBatch )
+      return;
+   for( int i=0; i<RADIO_TX_BATCH_MAX_FRAMES; i++ )
+   {
+      if ( NULL != pBatch->pFramesBuffers[i] )
+         free(pBatch->pFramesBuffers[i]);
+      pBatch->pFramesBuffers[i] = NULL;
+   }
+   if ( NULL != pBatch->pMessages )
+      free(pBatch->pMessages);
+   pBatch->pMessages = NULL;
+   pBatch->iFramesCount = 0;
+}
+
+int radio_tx_batch_is_initialized(type_radio_tx_batch* pBatch)
+{
+   if ( (NULL == pBatch) || (NULL == pBatch->pMessages) || (NULL == pBatch->pFramesBuffers[RADIO_TX_BATCH_MAX_FRAMES-1]) )
+      return 0;
+   return 1;
+}
+
+int radio_tx_batch_is_full(type_radio_tx_batch* pBatch)
+{
+   if ( ! radio_tx_batch_is_initialized(pBatch) )
+      return 1;
+   return (pBatch->iFramesCount >= RADIO_TX_BATCH_MAX_FRAMES)?1:0;
+}
+
+int radio_tx_batch_get_frames_count(type_radio_tx_batch* pBatch)
+{
+   if ( NULL == pBatch )
+      return 0;
+   return pBatch->iFramesCount;
+}
+
+u8* radio_tx_batch_get_next_frame_buffer(type_radio_tx_batch* pBatch)
+{
+   if ( radio_tx_batch_is_full(pBatch) )
+      return NULL;
+   return pBatch->pFramesBuffers[pBatch->iFramesCount];
+}
+
+int radio_tx_batch_add_frame(type_radio_tx_batch* pBatch, u8* pData, int iLength)
+{
+   if ( radio_tx_batch_is_full(pBatch) )
+      return 0;
+   if ( (NULL == pData) || (iLength <= 0) || (iLength > MAX_PACKET_TOTAL_SIZE) )
+      return 0;
+
+   u8* pBuffer = pBatch->pFramesBuffers[pBatch->iFramesCount];
+   if ( pData != pBuffer )
+      memcpy(pBuffer, pData, iLength);
+   pBatch->iFramesLengths[pBatch->iFramesCount] = iLength;
+   pBatch->iFramesCount++;
+   return 1;
+}
+
+int radio_tx_batch_flush(type_radio_tx_batch* pBatch, int iSocketFd)
+{
+   if ( (! radio_tx_batch_is_initialized(pBatch)) || (0 == pBatch->iFramesCount) )
+      return 0;
+
+   type_radio_tx_batch_messages* pMessages = (type_radio_tx_batch_messages*) pBatch->pMessages;
+   for( int i=0; i<pBatch->iFramesCount; i++ )
+      pMessages->iovecs[i].iov_len = pBatch->iFramesLengths[i];
+
+   int iSent = 0;
+   int iRetries = 2;
+   while ( iSent < pBatch->iFramesCount )
+   {
+      pBatch->uTotalSyscalls++;
+      int iResult = sendmmsg(iSocketFd, &(pMessages->messages[iSent]), pBatch->iFramesCount - iSent, 0);
+      if ( iResult > 0 )
+      {
+         iSent += iResult;
+         continue;
+      }
+      if ( (iResult < 0) && (errno == EINTR) )
+         continue;
+      if ( (iResult < 0) && ((errno == EAGAIN) || (errno == ENOBUFS)) && (iRetries > 0) )
+      {
+         iRetries--;
+         continue;
+      }
+      break;
+   }
+
+   pBatch->uTotalFramesSent += iSent;
+   if ( iSent < pBatch->iFramesCount )
+   {
+      pBatch->uTotalErrors++;
+      log_softerror_and_alarm("[RadioTxBatch] Failed to send radio frames on fd %d (%d sent of %d frames), error: %d (%s)",
+         iSocketFd, iSent, pBatch->iFramesCount, errno, strerror(errno));
+      pBatch->iFramesCount = 0;
+      return -1;
+   }
+   pBatch->iFramesCount = 0;
+   return iSent;
+}
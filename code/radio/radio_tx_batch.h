@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../base/base.h"
+#include "radiopackets2.h"
+
+// Batch of raw radio frames sent to a socket with a single sendmmsg syscall.
+// Frames are built directly in the batch buffers (radiotap and IEEE headers first, then payload),
+// so no extra copy is done for queuing a frame.
+
+#define RADIO_TX_BATCH_MAX_FRAMES 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   int iFramesCount;
+   u8* pFramesBuffers[RADIO_TX_BATCH_MAX_FRAMES]; // NULL if the batch is not initialized
+   int iFramesLengths[RADIO_TX_BATCH_MAX_FRAMES];
+   void* pMessages; // sendmmsg messages and iovecs for the frames buffers
+   u32 uTotalFramesSent;
+   u32 uTotalSyscalls;
+   u32 uTotalErrors;
+} type_radio_tx_batch;
+
+// Returns 1 on success, 0 if buffers can't be allocated
+int radio_tx_batch_init(type_radio_tx_batch* pBatch);
+void radio_tx_batch_free(type_radio_tx_batch* pBatch);
+int radio_tx_batch_is_initialized(type_radio_tx_batch* pBatch);
+int radio_tx_batch_is_full(type_radio_tx_batch* pBatch);
+int radio_tx_batch_get_frames_count(type_radio_tx_batch* pBatch);
+
+// Buffer (MAX_PACKET_TOTAL_SIZE bytes) where the next frame can be built in place; NULL if the batch is full
+u8* radio_tx_batch_get_next_frame_buffer(type_radio_tx_batch* pBatch);
+
+// Queues a frame. If pData is the buffer returned by radio_tx_batch_get_next_frame_buffer, no copy is done.
+// Returns 1 on success, 0 if the batch is full or the frame is invalid.
+int radio_tx_batch_add_frame(type_radio_tx_batch* pBatch, u8* pData, int iLength);
+
+// Sends all queued frames and empties the batch.
+// Returns the number of frames sent or -1 on error (frames not sent are discarded).
+int radio_tx_batch_flush(type_radio_tx_batch* pBatch, int iSocketFd);
+
+#ifdef __cplusplus
+}  
+#endif
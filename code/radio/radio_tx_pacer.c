@@ -0,0 +1,367 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sys/eventfd.h>
+#include <sys/select.h>
+#include <sched.h>
+#include <time.h>
+#include "../base/base.h"
+#include "radio_tx_pacer.h"
+
+static u64 _radio_tx_pacer_time_micros()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64)t.tv_sec * 1000000LL + (u64)t.tv_nsec / 1000;
+}
+
+static void _radio_tx_pacer_sleep_until(u64 uTimeMicros)
+{
+   struct timespec t;
+   t.tv_sec = uTimeMicros / 1000000;
+   t.tv_nsec = (uTimeMicros % 1000000) * 1000;
+   while ( EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) ) {}
+}
+
+int radio_tx_pacer_init(type_radio_tx_pacer* pPacer, int iMinQueueSize, shared_mem_radio_tx_pacing_stats* pStats)
+{
+   if ( (NULL == pPacer) || (iMinQueueSize < 2) )
+      return 0;
+
+   memset(pPacer, 0, sizeof(type_radio_tx_pacer));
+   pPacer->iEventFd = -1;
+   pPacer->uQueueSize = 2;
+   while ( pPacer->uQueueSize < (u32)iMinQueueSize )
+      pPacer->uQueueSize *= 2;
+   pPacer->uQueueMask = pPacer->uQueueSize - 1;
+
+   pPacer->pStats = pStats;
+   if ( NULL == pPacer->pStats )
+      pPacer->pStats = &pPacer->localStats;
+   memset(pPacer->pStats, 0, sizeof(shared_mem_radio_tx_pacing_stats));
+
+   pPacer->pSlab = (u8*) malloc(pPacer->uQueueSize * MAX_PACKET_TOTAL_SIZE);
+   pPacer->pFramesLengths = (int*) calloc(pPacer->uQueueSize, sizeof(int));
+   pPacer->pFramesFds = (int*) calloc(pPacer->uQueueSize, sizeof(int));
+   pPacer->pFramesGapsMicros = (u32*) calloc(pPacer->uQueueSize, sizeof(u32));
+   pPacer->pFramesQueuedTimeMicros = (u64*) calloc(pPacer->uQueueSize, sizeof(u64));
+   pPacer->iEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if ( (NULL == pPacer->pSlab) || (NULL == pPacer->pFramesLengths) || (NULL == pPacer->pFramesFds) ||
+        (NULL == pPacer->pFramesGapsMicros) || (NULL == pPacer->pFramesQueuedTimeMicros) || (pPacer->iEventFd < 0) )
+   {
+      log_error_and_alarm("[RadioTxPacer] Failed to allocate tx pacer queue (%u frames).", pPacer->uQueueSize);
+      radio_tx_pacer_free(pPacer);
+      return 0;
+   }
+   return 1;
+}
+
+void radio_tx_pacer_free(type_radio_tx_pacer* pPacer)
+{
+   if ( NULL == pPacer )
+      return;
+   radio_tx_pacer_stop(pPacer);
+   if ( NULL != pPacer->pSlab )
+      free(pPacer->pSlab);
+   if ( NULL != pPacer->pFramesLengths )
+      free(pPacer->pFramesLengths);
+   if ( NULL != pPacer->pFramesFds )
+      free(pPacer->pFramesFds);
+   if ( NULL != pPacer->pFramesGapsMicros )
+      free(pPacer->pFramesGapsMicros);
+   if ( NULL != pPacer->pFramesQueuedTimeMicros )
+      free(pPacer->pFramesQueuedTimeMicros);
+   if ( pPacer->iEventFd >= 0 )
+      close(pPacer->iEventFd);
+   pPacer->pSlab = NULL;
+   pPacer->pFramesLengths = NULL;
+   pPacer->pFramesFds = NULL;
+   pPacer->pFramesGapsMicros = NULL;
+   pPacer->pFramesQueuedTimeMicros = NULL;
+   pPacer->iEventFd = -1;
+   pPacer->uQueueSize = 0;
+   pPacer->uQueueMask = 0;
+}
+
+int radio_tx_pacer_is_initialized(type_radio_tx_pacer* pPacer)
+{
+   if ( (NULL == pPacer) || (NULL == pPacer->pSlab) )
+      return 0;
+   return 1;
+}
+
+static void _radio_tx_pacer_add_stats(shared_mem_radio_tx_pacing_stats* pStats, u64 uAchievedGapMicros, u64 uLatenessMicros)
+{
+   u32 uBucket = (u32)(uAchievedGapMicros / RADIO_TX_PACING_GAP_HISTOGRAM_BUCKET_MICROS);
+   if ( uBucket >= RADIO_TX_PACING_GAP_HISTOGRAM_BUCKETS )
+      uBucket = RADIO_TX_PACING_GAP_HISTOGRAM_BUCKETS-1;
+   pStats->uHistogramAchievedGap[uBucket]++;
+
+   static const u32 s_uLatenessLimits[RADIO_TX_PACING_LATENESS_HISTOGRAM_BUCKETS-1] = { 10, 25, 50, 100, 250, 500, 1000 };
+   uBucket = 0;
+   while ( (uBucket < RADIO_TX_PACING_LATENESS_HISTOGRAM_BUCKETS-1) && (uLatenessMicros >= s_uLatenessLimits[uBucket]) )
+      uBucket++;
+   pStats->uHistogramLateness[uBucket]++;
+   if ( uLatenessMicros > pStats->uMaxLatenessMicros )
+      pStats->uMaxLatenessMicros = (u32)uLatenessMicros;
+   pStats->uTotalPacedFrames++;
+}
+
+static int _radio_tx_pacer_has_frames(type_radio_tx_pacer* pPacer, int iMemoryOrder)
+{
+   return (__atomic_load_n(&pPacer->uWriteIndex, iMemoryOrder) != pPacer->uReadIndex)?1:0;
+}
+
+static void _radio_tx_pacer_wait_frames(type_radio_tx_pacer* pPacer)
+{
+   // Announce the wait, then check again for frames pushed in the meantime (paired with the producer barrier)
+   __atomic_store_n(&pPacer->iConsumerWaiting, 1, __ATOMIC_SEQ_CST);
+   if ( ! _radio_tx_pacer_has_frames(pPacer, __ATOMIC_SEQ_CST) )
+   {
+      fd_set readSet;
+      FD_ZERO(&readSet);
+      FD_SET(pPacer->iEventFd, &readSet);
+      struct timeval timeout;
+      timeout.tv_sec = 0;
+      timeout.tv_usec = 100*1000;
+      select(pPacer->iEventFd + 1, &readSet, NULL, NULL, &timeout);
+   }
+   __atomic_store_n(&pPacer->iConsumerWaiting, 0, __ATOMIC_SEQ_CST);
+
+   u64 uValue = 0;
+   if ( read(pPacer->iEventFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+}
+
+static void* _thread_radio_tx_pacer(void* pParam)
+{
+   type_radio_tx_pacer* pPacer = (type_radio_tx_pacer*)pParam;
+   log_line("[RadioTxPacer] Thread started.");
+
+   if ( (pPacer->iThreadRawPriority > 1) && (pPacer->iThreadRawPriority <= 100) )
+   {
+      struct sched_param params;
+      params.sched_priority = 100 - pPacer->iThreadRawPriority;
+      if ( 0 != pthread_setschedparam(pthread_self(), SCHED_FIFO, &params) )
+         log_softerror_and_alarm("[RadioTxPacer] Failed to set thread priority to %d.", pPacer->iThreadRawPriority);
+   }
+
+   shared_mem_radio_tx_pacing_stats* pStats = pPacer->pStats;
+   int iHasLastRelease = 0;
+
+   while ( ! __atomic_load_n(&pPacer->iStopRequested, __ATOMIC_ACQUIRE) )
+   {
+      if ( ! _radio_tx_pacer_has_frames(pPacer, __ATOMIC_ACQUIRE) )
+      {
+         _radio_tx_pacer_wait_frames(pPacer);
+         continue;
+      }
+
+      u32 uSlot = pPacer->uReadIndex & pPacer->uQueueMask;
+      u32 uGapMicros = pPacer->pFramesGapsMicros[uSlot];
+      u64 uReleaseTime = pPacer->uLastReleaseTimeMicros + uGapMicros;
+      int iIsPaced = 0;
+
+      // Frames queued before their release time are held until then; the others go right away
+      if ( iHasLastRelease && (uGapMicros > 0) && (pPacer->pFramesQueuedTimeMicros[uSlot] <= uReleaseTime) )
+      {
+         iIsPaced = 1;
+         if ( _radio_tx_pacer_time_micros() < uReleaseTime )
+            _radio_tx_pacer_sleep_until(uReleaseTime);
+         // Stopped while waiting: the frame is discarded by the stop, its fd may be closed already
+         if ( __atomic_load_n(&pPacer->iStopRequested, __ATOMIC_ACQUIRE) )
+            break;
+      }
+
+      u64 uTimeNow = _radio_tx_pacer_time_micros();
+      if ( iIsPaced )
+         _radio_tx_pacer_add_stats(pStats, uTimeNow - pPacer->uLastReleaseTimeMicros, (uTimeNow > uReleaseTime)?(uTimeNow - uReleaseTime):0);
+      pPacer->uLastReleaseTimeMicros = uTimeNow;
+      iHasLastRelease = 1;
+
+      u8* pFrame = pPacer->pSlab + uSlot * MAX_PACKET_TOTAL_SIZE;
+      if ( write(pPacer->pFramesFds[uSlot], pFrame, pPacer->pFramesLengths[uSlot]) != pPacer->pFramesLengths[uSlot] )
+      {
+         if ( 0 == pStats->uTotalWriteErrors )
+            log_softerror_and_alarm("[RadioTxPacer] Failed to write frame (%d bytes) to fd %d, error: %d, %s", pPacer->pFramesLengths[uSlot], pPacer->pFramesFds[uSlot], errno, strerror(errno));
+         pStats->uTotalWriteErrors++;
+      }
+      pStats->uTotalFrames++;
+      pStats->uLastTargetGapMicros = uGapMicros;
+      pStats->uTimeLastUpdate = (u32)(uTimeNow/1000);
+
+      __atomic_store_n(&pPacer->uReadIndex, pPacer->uReadIndex + 1, __ATOMIC_RELEASE);
+   }
+   log_line("[RadioTxPacer] Thread stopped.");
+   return NULL;
+}
+
+int radio_tx_pacer_start(type_radio_tx_pacer* pPacer, int iThreadRawPriority)
+{
+   if ( ! radio_tx_pacer_is_initialized(pPacer) )
+      return 0;
+   if ( pPacer->iThreadRunning )
+      return 1;
+
+   pPacer->iThreadRawPriority = iThreadRawPriority;
+   pPacer->iStopRequested = 0;
+   if ( 0 != pthread_create(&pPacer->threadPacer, NULL, &_thread_radio_tx_pacer, pPacer) )
+   {
+      log_softerror_and_alarm("[RadioTxPacer] Failed to create the tx pacer thread.");
+      return 0;
+   }
+   pPacer->iThreadRunning = 1;
+   return 1;
+}
+
+void radio_tx_pacer_stop(type_radio_tx_pacer* pPacer)
+{
+   if ( (NULL == pPacer) || (! pPacer->iThreadRunning) )
+      return;
+   __atomic_store_n(&pPacer->iStopRequested, 1, __ATOMIC_SEQ_CST);
+   u64 uValue = 1;
+   if ( write(pPacer->iEventFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+   pthread_join(pPacer->threadPacer, NULL);
+   pPacer->iThreadRunning = 0;
+
+   u32 uPending = __atomic_load_n(&pPacer->uWriteIndex, __ATOMIC_ACQUIRE) - pPacer->uReadIndex;
+   if ( uPending > 0 )
+   {
+      log_line("[RadioTxPacer] Discarded %u pending frames.", uPending);
+      pPacer->pStats->uTotalDroppedFrames += uPending;
+   }
+   pPacer->uReadIndex = pPacer->uWriteIndex;
+   pPacer->uCachedReadIndex = pPacer->uWriteIndex;
+}
+
+int radio_tx_pacer_discard_pending(type_radio_tx_pacer* pPacer)
+{
+   if ( (NULL == pPacer) || (! pPacer->iThreadRunning) )
+      return 0;
+   // Once the thread is stopped no queued frame can be written anymore
+   radio_tx_pacer_stop(pPacer);
+   return radio_tx_pacer_start(pPacer, pPacer->iThreadRawPriority);
+}
+
+int radio_tx_pacer_is_running(type_radio_tx_pacer* pPacer)
+{
+   if ( NULL == pPacer )
+      return 0;
+   return pPacer->iThreadRunning;
+}
+
+static int _radio_tx_pacer_is_full(type_radio_tx_pacer* pPacer)
+{
+   if ( pPacer->uWriteIndex - pPacer->uCachedReadIndex < pPacer->uQueueSize )
+      return 0;
+   pPacer->uCachedReadIndex = __atomic_load_n(&pPacer->uReadIndex, __ATOMIC_ACQUIRE);
+   return (pPacer->uWriteIndex - pPacer->uCachedReadIndex >= pPacer->uQueueSize)?1:0;
+}
+
+u8* radio_tx_pacer_get_next_frame_buffer(type_radio_tx_pacer* pPacer)
+{
+   if ( (! radio_tx_pacer_is_initialized(pPacer)) || _radio_tx_pacer_is_full(pPacer) )
+      return NULL;
+   return pPacer->pSlab + (pPacer->uWriteIndex & pPacer->uQueueMask) * MAX_PACKET_TOTAL_SIZE;
+}
+
+int radio_tx_pacer_push(type_radio_tx_pacer* pPacer, int iFd, u8* pData, int iLength, u32 uGapMicros)
+{
+   if ( (! radio_tx_pacer_is_initialized(pPacer)) || (! pPacer->iThreadRunning) )
+      return 0;
+   if ( (NULL == pData) || (iLength <= 0) || (iLength > MAX_PACKET_TOTAL_SIZE) || (iFd < 0) )
+      return 0;
+
+   if ( _radio_tx_pacer_is_full(pPacer) )
+   {
+      // The radio can't keep up: give the pacer some time to make room, then drop
+      pPacer->pStats->uTotalQueueFullWaits++;
+      u32 uTimeStart = get_current_timestamp_ms();
+      while ( _radio_tx_pacer_is_full(pPacer) )
+      {
+         if ( get_current_timestamp_ms() > uTimeStart + RADIO_TX_PACER_MAX_WAIT_QUEUE_FULL_MS )
+         {
+            pPacer->pStats->uTotalDroppedFrames++;
+            return 0;
+         }
+         hardware_sleep_micros(100);
+      }
+   }
+
+   u32 uSlot = pPacer->uWriteIndex & pPacer->uQueueMask;
+   u8* pSlotBuffer = pPacer->pSlab + uSlot * MAX_PACKET_TOTAL_SIZE;
+   if ( pData != pSlotBuffer )
+      memcpy(pSlotBuffer, pData, iLength);
+   pPacer->pFramesLengths[uSlot] = iLength;
+   pPacer->pFramesFds[uSlot] = iFd;
+   pPacer->pFramesGapsMicros[uSlot] = uGapMicros;
+   pPacer->pFramesQueuedTimeMicros[uSlot] = _radio_tx_pacer_time_micros();
+
+   // Publish the frame, then check (after a full barrier, paired with the pacer thread) if it must be woken up
+   __atomic_store_n(&pPacer->uWriteIndex, pPacer->uWriteIndex + 1, __ATOMIC_SEQ_CST);
+   if ( __atomic_load_n(&pPacer->iConsumerWaiting, __ATOMIC_SEQ_CST) )
+   {
+      u64 uValue = 1;
+      if ( write(pPacer->iEventFd, &uValue, sizeof(uValue)) != sizeof(uValue) ) {}
+   }
+
+   u32 uQueued = pPacer->uWriteIndex - pPacer->uCachedReadIndex;
+   if ( uQueued > pPacer->pStats->uMaxQueuedFrames )
+   {
+      // Cached read index can be stale, get the current count
+      uQueued = (u32)radio_tx_pacer_get_queued_frames(pPacer);
+      if ( uQueued > pPacer->pStats->uMaxQueuedFrames )
+         pPacer->pStats->uMaxQueuedFrames = uQueued;
+   }
+   return 1;
+}
+
+int radio_tx_pacer_get_queued_frames(type_radio_tx_pacer* pPacer)
+{
+   if ( ! radio_tx_pacer_is_initialized(pPacer) )
+      return 0;
+   pPacer->uCachedReadIndex = __atomic_load_n(&pPacer->uReadIndex, __ATOMIC_ACQUIRE);
+   return (int)(pPacer->uWriteIndex - pPacer->uCachedReadIndex);
+}
+
+int radio_tx_pacer_wait_empty(type_radio_tx_pacer* pPacer, u32 uTimeoutMs)
+{
+   if ( ! radio_tx_pacer_is_initialized(pPacer) )
+      return 1;
+   u32 uTimeStart = get_current_timestamp_ms();
+   while ( radio_tx_pacer_get_queued_frames(pPacer) > 0 )
+   {
+      if ( (! pPacer->iThreadRunning) || (get_current_timestamp_ms() > uTimeStart + uTimeoutMs) )
+         return 0;
+      hardware_sleep_micros(200);
+   }
+   return 1;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../base/base.h"
+#include "../base/config.h"
+#include "../base/shared_mem_radio.h"
+#include "radiopackets2.h"
+#include <pthread.h>
+
+// Paced tx of raw radio frames from a dedicated thread.
+// The producer (the main loop) only queues the frames, each with the minimum gap to keep after
+// the previous released frame; the pacer thread writes them to their sockets on that schedule
+// (absolute clock_nanosleep deadlines), so the producer never sleeps to pace the radio.
+// Single producer, single consumer; frames can be built in place in the queue slots.
+
+#define RADIO_TX_PACER_DEFAULT_QUEUE_SIZE 256
+#define RADIO_TX_PACER_MAX_WAIT_QUEUE_FULL_MS 20
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+   // Written by the producer only
+   u32 uWriteIndex __attribute__((aligned(64)));
+   u32 uCachedReadIndex;
+
+   // Written by the pacer thread only
+   u32 uReadIndex __attribute__((aligned(64)));
+   u64 uLastReleaseTimeMicros;
+
+   // Set on init
+   u8* pSlab __attribute__((aligned(64))); // uQueueSize frames of MAX_PACKET_TOTAL_SIZE bytes
+   int* pFramesLengths;
+   int* pFramesFds;
+   u32* pFramesGapsMicros;
+   u64* pFramesQueuedTimeMicros;
+   u32 uQueueSize; // power of 2
+   u32 uQueueMask;
+   int iEventFd;
+   _ATOMIC_PREFIX int iConsumerWaiting;
+   _ATOMIC_PREFIX int iStopRequested;
+   int iThreadRunning;
+   int iThreadRawPriority;
+   pthread_t threadPacer;
+
+   shared_mem_radio_tx_pacing_stats* pStats; // Can be in shared memory; points to localStats otherwise
+   shared_mem_radio_tx_pacing_stats localStats;
+} type_radio_tx_pacer;
+
+// iMinQueueSize is rounded up to a power of 2. pStats can be NULL. Returns 1 on success.
+int radio_tx_pacer_init(type_radio_tx_pacer* pPacer, int iMinQueueSize, shared_mem_radio_tx_pacing_stats* pStats);
+// Stops the pacer thread (pending frames are discarded) and frees the queue
+void radio_tx_pacer_free(type_radio_tx_pacer* pPacer);
+int radio_tx_pacer_is_initialized(type_radio_tx_pacer* pPacer);
+// iThreadRawPriority: 2..100 for a real time (FIFO) thread, anything else keeps the default scheduling
+int radio_tx_pacer_start(type_radio_tx_pacer* pPacer, int iThreadRawPriority);
+void radio_tx_pacer_stop(type_radio_tx_pacer* pPacer);
+// Drops the queued frames (none is written after it returns) and restarts the pacer thread. Returns 1 if restarted.
+int radio_tx_pacer_discard_pending(type_radio_tx_pacer* pPacer);
+int radio_tx_pacer_is_running(type_radio_tx_pacer* pPacer);
+
+// Producer side
+
+// Buffer (MAX_PACKET_TOTAL_SIZE bytes) of the next queue slot, to build a frame in place; NULL if the queue is full
+u8* radio_tx_pacer_get_next_frame_buffer(type_radio_tx_pacer* pPacer);
+// Queues a frame to be written to iFd no sooner than uGapMicros after the previous frame.
+// No copy is done if pData is the buffer returned by radio_tx_pacer_get_next_frame_buffer.
+// If the queue is full, waits up to RADIO_TX_PACER_MAX_WAIT_QUEUE_FULL_MS for the pacer to make room.
+// Returns 1 on success, 0 if the frame was dropped.
+int radio_tx_pacer_push(type_radio_tx_pacer* pPacer, int iFd, u8* pData, int iLength, u32 uGapMicros);
+int radio_tx_pacer_get_queued_frames(type_radio_tx_pacer* pPacer);
+// Waits for all queued frames to be written. Returns 1 if the queue is empty.
+int radio_tx_pacer_wait_empty(type_radio_tx_pacer* pPacer, u32 uTimeoutMs);
+
+#ifdef __cplusplus
+}  
+#endif
@@ -50,6 +50,11 @@
 #include "radiolink.h"
 #include "radiopackets2.h"
 #include "radio_rx.h"
+#include "radio_rx_ring.h"
+#include "radio_tx_batch.h"
+#include "radio_tx_pacer.h"
+#include "radio_link_sim.h"
+#include <net/if_arp.h>
 
 //#define DEBUG_PACKET_RECEIVED
 //#define DEBUG_PACKET_SENT
@@ -57,6 +62,18 @@
 int s_bRadioDebugFlag = 0;
 int s_iUsePCAPForTx = DEFAULT_USE_PPCAP_FOR_TX;
 int s_iBypassSocketBuffers = DEFAULT_BYPASS_SOCKET_BUFFERS;
+int s_iUseMMapRingForRx[MAX_RADIO_INTERFACES];
+type_radio_rx_ring s_RadioRxRings[MAX_RADIO_INTERFACES];
+int s_iUseBatchedTx = DEFAULT_USE_BATCHED_RADIO_TX;
+int s_iRadioTxBatchActive = 0;
+type_radio_tx_batch s_RadioTxBatches[MAX_RADIO_INTERFACES];
+int s_iRadioPacedTxActive = 0;
+u32 s_uRadioPacedTxNextGapMicros = 0;
+type_radio_tx_pacer s_RadioTxPacer;
+u16 s_uLinkSimBasePort[MAX_RADIO_INTERFACES]; // 0: the interface is a real radio
+type_radio_link_sim_params s_LinkSimParams[MAX_RADIO_INTERFACES];
+type_radio_link_sim_tx s_RadioLinkSimTx[MAX_RADIO_INTERFACES];
+type_radio_link_sim_rx s_RadioLinkSimRx[MAX_RADIO_INTERFACES];
 int s_iRadioInterfacesBroken = 0;
 int s_iRadioLastReadErrorCode = RADIO_READ_ERROR_NO_ERROR;
 int s_iVehicleBehindMilisec = 0;
@@ -155,7 +172,10 @@ void radio_init_link_structures()
    radio_packets_short_init();
 
    for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+   {
       s_uNextRadioPacketIndexes[i] = 0;
+      s_iUseMMapRingForRx[i] = DEFAULT_USE_MMAP_RING_FOR_RX;
+   }
 
    radio_reset_packets_default_frequencies(0);
 
@@ -194,6 +214,11 @@ void radio_init_link_structures()
 
 void radio_link_cleanup()
 {
+   radio_flush_tx_batch();
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+      radio_tx_batch_free(&s_RadioTxBatches[i]);
+   radio_set_use_paced_tx(0, NULL, 0);
+
    if ( s_iMutexRadioSyncRxTxThreadsInitialized )
    {
       pthread_mutex_destroy(&s_pMutexRadioSyncRxTxThreads);
@@ -293,6 +318,244 @@ void radio_set_use_pcap_for_tx(int iEnablePCAPTx)
       log_line("[Radio] Set using sockets for radio tx");
 }
 
+void radio_set_use_mmap_ring_for_rx(int iInterfaceIndex, int iEnable)
+{
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+   {
+      if ( (iInterfaceIndex == -1) || (iInterfaceIndex == i) )
+         s_iUseMMapRingForRx[i] = iEnable;
+   }
+   if ( iInterfaceIndex == -1 )
+      log_line("[Radio] Set using %s for radio rx on all interfaces.", iEnable?"mmap ring":"ppcap");
+   else
+      log_line("[Radio] Set using %s for radio rx on interface %d.", iEnable?"mmap ring":"ppcap", iInterfaceIndex+1);
+}
+
+void radio_set_use_batched_tx(int iEnable)
+{
+   if ( (! iEnable) && s_iRadioTxBatchActive )
+      radio_flush_tx_batch();
+   s_iUseBatchedTx = iEnable;
+   log_line("[Radio] Set %s radio tx.", s_iUseBatchedTx?"batched":"per packet");
+}
+
+int radio_begin_tx_batch()
+{
+   if ( (! s_iUseBatchedTx) || s_iUsePCAPForTx )
+      return 0;
+   s_iRadioTxBatchActive = 1;
+   return 1;
+}
+
+int radio_is_tx_batch_active()
+{
+   return s_iRadioTxBatchActive;
+}
+
+// Returns 1 if the interface can queue frames in its tx batch now
+int _radio_can_use_tx_batch(int interfaceIndex)
+{
+   if ( (! s_iRadioTxBatchActive) || s_iUsePCAPForTx )
+      return 0;
+   if ( (interfaceIndex < 0) || (interfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   if ( ! radio_tx_batch_is_initialized(&s_RadioTxBatches[interfaceIndex]) )
+   if ( ! radio_tx_batch_init(&s_RadioTxBatches[interfaceIndex]) )
+      return 0;
+   return 1;
+}
+
+// Returns 1 on success
+
+int _radio_flush_tx_batch_on_interface(int interfaceIndex)
+{
+   if ( (interfaceIndex < 0) || (interfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   if ( 0 == radio_tx_batch_get_frames_count(&s_RadioTxBatches[interfaceIndex]) )
+      return 1;
+
+   radio_hw_info_t* pRadioHWInfo = hardware_get_radio_info(interfaceIndex);
+   if ( (NULL == pRadioHWInfo) || (0 == pRadioHWInfo->openedForWrite) || (pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd < 0) )
+   {
+      log_softerror_and_alarm("RadioError: Tried to flush radio tx batch to an invalid interface (%d). Discarded %d frames.", interfaceIndex+1, radio_tx_batch_get_frames_count(&s_RadioTxBatches[interfaceIndex]));
+      s_RadioTxBatches[interfaceIndex].iFramesCount = 0;
+      return 0;
+   }
+
+   #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
+   if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
+      pthread_mutex_lock(&s_pMutexRadioSyncRxTxThreads);
+   #endif
+
+   int iResult = radio_tx_batch_flush(&s_RadioTxBatches[interfaceIndex], pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd);
+
+   #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
+   if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
+      pthread_mutex_unlock(&s_pMutexRadioSyncRxTxThreads);
+   #endif
+
+   if ( iResult < 0 )
+   {
+      pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount++;
+      return 0;
+   }
+   pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount = 0;
+   return 1;
+}
+
+int radio_flush_tx_batch()
+{
+   int iResult = 1;
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+   {
+      if ( ! _radio_flush_tx_batch_on_interface(i) )
+         iResult = 0;
+   }
+   s_iRadioTxBatchActive = 0;
+   return iResult;
+}
+
+u8* radio_get_tx_batch_frame_buffer(int interfaceIndex)
+{
+   if ( ! _radio_can_use_tx_batch(interfaceIndex) )
+      return NULL;
+   if ( radio_tx_batch_is_full(&s_RadioTxBatches[interfaceIndex]) )
+      _radio_flush_tx_batch_on_interface(interfaceIndex);
+   return radio_tx_batch_get_next_frame_buffer(&s_RadioTxBatches[interfaceIndex]);
+}
+
+void radio_set_use_paced_tx(int iEnable, shared_mem_radio_tx_pacing_stats* pStats, int iThreadRawPriority)
+{
+   s_iRadioPacedTxActive = 0;
+   if ( ! iEnable )
+   {
+      if ( ! radio_tx_pacer_is_initialized(&s_RadioTxPacer) )
+         return;
+      radio_tx_pacer_wait_empty(&s_RadioTxPacer, 200);
+      radio_tx_pacer_free(&s_RadioTxPacer);
+      log_line("[Radio] Set non paced video radio tx.");
+      return;
+   }
+   if ( radio_tx_pacer_is_running(&s_RadioTxPacer) )
+      return;
+   if ( ! radio_tx_pacer_init(&s_RadioTxPacer, RADIO_TX_PACER_DEFAULT_QUEUE_SIZE, pStats) )
+      return;
+   if ( ! radio_tx_pacer_start(&s_RadioTxPacer, iThreadRawPriority) )
+   {
+      radio_tx_pacer_free(&s_RadioTxPacer);
+      return;
+   }
+   log_line("[Radio] Set paced video radio tx (queue of %u frames, thread raw priority %d).", s_RadioTxPacer.uQueueSize, iThreadRawPriority);
+}
+
+int radio_begin_paced_tx()
+{
+   if ( s_iUsePCAPForTx || (! radio_tx_pacer_is_running(&s_RadioTxPacer)) )
+      return 0;
+   s_iRadioPacedTxActive = 1;
+   s_uRadioPacedTxNextGapMicros = 0;
+   return 1;
+}
+
+int radio_is_paced_tx_active()
+{
+   return s_iRadioPacedTxActive;
+}
+
+void radio_set_paced_tx_next_gap(u32 uGapMicros)
+{
+   s_uRadioPacedTxNextGapMicros = uGapMicros;
+}
+
+void radio_end_paced_tx()
+{
+   s_iRadioPacedTxActive = 0;
+   s_uRadioPacedTxNextGapMicros = 0;
+}
+
+// Returns 1 if frames to this interface go now to the tx pacer
+static int _radio_can_use_paced_tx(int interfaceIndex)
+{
+   if ( (! s_iRadioPacedTxActive) || s_iUsePCAPForTx )
+      return 0;
+   if ( (interfaceIndex < 0) || (interfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   return radio_tx_pacer_is_running(&s_RadioTxPacer);
+}
+
+u8* radio_get_paced_tx_frame_buffer(int interfaceIndex)
+{
+   if ( ! _radio_can_use_paced_tx(interfaceIndex) )
+      return NULL;
+   return radio_tx_pacer_get_next_frame_buffer(&s_RadioTxPacer);
+}
+
+void radio_set_use_link_simulator(int iInterfaceIndex, u16 uBasePort, type_radio_link_sim_params* pParams)
+{
+   for( int i=0; i<MAX_RADIO_INTERFACES; i++ )
+   {
+      if ( (iInterfaceIndex != -1) && (iInterfaceIndex != i) )
+         continue;
+      if ( 0 == s_uLinkSimBasePort[i] )
+      {
+         s_RadioLinkSimTx[i].iSocket = -1;
+         s_RadioLinkSimRx[i].iSocket = -1;
+      }
+      s_uLinkSimBasePort[i] = uBasePort;
+      if ( NULL != pParams )
+         memcpy(&s_LinkSimParams[i], pParams, sizeof(type_radio_link_sim_params));
+      else
+         radio_link_sim_set_default_params(&s_LinkSimParams[i]);
+   }
+   if ( 0 == uBasePort )
+      log_line("[Radio] Set using real radio interfaces (no link simulator) on %s.", (iInterfaceIndex == -1)?"all interfaces":"one interface");
+   else
+      log_line("[Radio] Set using the radio link simulator (UDP base port %d) on %s.", (int)uBasePort, (iInterfaceIndex == -1)?"all interfaces":"one interface");
+}
+
+int radio_is_using_link_simulator(int iInterfaceIndex)
+{
+   if ( (iInterfaceIndex < 0) || (iInterfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   return (0 != s_uLinkSimBasePort[iInterfaceIndex])?1:0;
+}
+
+static int _radio_link_sim_rx_is_open(int iInterfaceIndex)
+{
+   if ( (iInterfaceIndex < 0) || (iInterfaceIndex >= MAX_RADIO_INTERFACES) || (0 == s_uLinkSimBasePort[iInterfaceIndex]) )
+      return 0;
+   return radio_link_sim_rx_is_open(&s_RadioLinkSimRx[iInterfaceIndex]);
+}
+
+static int _radio_link_sim_tx_is_open(int iInterfaceIndex)
+{
+   if ( (iInterfaceIndex < 0) || (iInterfaceIndex >= MAX_RADIO_INTERFACES) || (0 == s_uLinkSimBasePort[iInterfaceIndex]) )
+      return 0;
+   return radio_link_sim_tx_is_open(&s_RadioLinkSimTx[iInterfaceIndex]);
+}
+
+int radio_get_link_simulator_stats(int iInterfaceIndex, type_radio_link_sim_stats* pStats)
+{
+   if ( ! _radio_link_sim_tx_is_open(iInterfaceIndex) )
+      return 0;
+   radio_link_sim_tx_get_stats(&s_RadioLinkSimTx[iInterfaceIndex], pStats);
+   return 1;
+}
+
+int radio_is_using_mmap_ring_for_rx(int iInterfaceIndex)
+{
+   if ( (iInterfaceIndex < 0) || (iInterfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   return radio_rx_ring_is_open(&s_RadioRxRings[iInterfaceIndex]);
+}
+
+int radio_get_rx_ring_pending_frames(int iInterfaceIndex)
+{
+   if ( (iInterfaceIndex < 0) || (iInterfaceIndex >= MAX_RADIO_INTERFACES) )
+      return 0;
+   return radio_rx_ring_get_pending_frames(&s_RadioRxRings[iInterfaceIndex]);
+}
+
 void radio_set_bypass_socket_buffers(int iBypass)
 {
    s_iBypassSocketBuffers = iBypass;
@@ -550,6 +813,58 @@ int radio_get_last_read_error_code()
    return s_iRadioLastReadErrorCode; 
 }
 
+int _radio_open_interface_for_read_mmap_ring(int interfaceIndex, radio_hw_info_t* pRadioHWInfo, char* szFilter, char* szFilterPrism)
+{
+   struct bpf_program bpfprogram;
+   char* szProgram = NULL;
+   int iDataLink = 0;
+
+   int iArpType = radio_rx_ring_get_interface_arp_type(pRadioHWInfo->szName);
+   if ( iArpType == ARPHRD_IEEE80211_RADIOTAP )
+   {
+      szProgram = szFilter;
+      iDataLink = DLT_IEEE802_11_RADIO;
+   }
+   else if ( iArpType == ARPHRD_IEEE80211_PRISM )
+   {
+      szProgram = szFilterPrism;
+      iDataLink = DLT_PRISM_HEADER;
+   }
+   else
+   {
+      log_softerror_and_alarm("ERROR: unknown encapsulation (%d) on [%s]! check if monitor mode is supported and enabled", iArpType, pRadioHWInfo->szName);
+      return -1;
+   }
+
+   // Compile the same filter as for pcap, without a live pcap handle
+   pcap_t* pPcapDead = pcap_open_dead(iDataLink, MAX_PACKET_LENGTH_PCAP);
+   if ( NULL == pPcapDead )
+   {
+      log_softerror_and_alarm("ERROR: failed to create pcap handle to compile the filter for interface [%s]", pRadioHWInfo->szName);
+      return -1;
+   }
+   if ( pcap_compile(pPcapDead, &bpfprogram, szProgram, 1, 0) == -1 )
+   {
+      log_softerror_and_alarm("ERROR: compiling program for interface [%s]: %s", pRadioHWInfo->szName, pcap_geterr(pPcapDead));
+      pcap_close(pPcapDead);
+      return -1;
+   }
+
+   int iFd = radio_rx_ring_open(&s_RadioRxRings[interfaceIndex], pRadioHWInfo->szName, &bpfprogram);
+   pcap_freecode(&bpfprogram);
+   pcap_close(pPcapDead);
+   if ( iFd < 0 )
+      return -1;
+
+   pRadioHWInfo->runtimeInterfaceInfoRx.ppcap = NULL;
+   pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = iFd;
+   reset_runtime_radio_rx_info(&(pRadioHWInfo->runtimeInterfaceInfoRx.radioHwRxInfo));
+   pRadioHWInfo->openedForRead = 1;
+
+   log_line("Opened radio interface %d (%s) for reading using mmap ring on %s, filter: [%s]. Returned fd=%d", interfaceIndex+1, pRadioHWInfo->szName, str_format_frequency(pRadioHWInfo->uCurrentFrequencyKhz), szProgram, iFd);
+   return iFd;
+}
+
 int _radio_open_interface_for_read_with_filter(int interfaceIndex, char* szFilter, char* szFilterPrism)
 {
    s_iRadioInterfacesBroken = 0;
@@ -581,6 +896,13 @@ int _radio_open_interface_for_read_with_filter(int interfaceIndex, char* szFilte
    pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = -1;
    pRadioHWInfo->runtimeInterfaceInfoRx.iErrorCount = 0;
 
+   if ( (interfaceIndex < MAX_RADIO_INTERFACES) && s_iUseMMapRingForRx[interfaceIndex] )
+   {
+      if ( _radio_open_interface_for_read_mmap_ring(interfaceIndex, pRadioHWInfo, szFilter, szFilterPrism) >= 0 )
+         return pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd;
+      log_softerror_and_alarm("Failed to open radio interface %d (%s) for reading using mmap ring. Fallback to pcap.", interfaceIndex+1, pRadioHWInfo->szName);
+   }
+
    szErrbuf[0] = '\0';
    //pRadioHWInfo->runtimeInterfaceInfoRx.ppcap = pcap_open_live(pRadioHWInfo->szName, 4096, 1, 1, szErrbuf);
    pRadioHWInfo->runtimeInterfaceInfoRx.ppcap = pcap_create(pRadioHWInfo->szName, szErrbuf);
@@ -666,6 +988,23 @@ int radio_open_interface_for_read(int interfaceIndex, int portNumber)
    if ( NULL == pRadioHWInfo )
       return -1;
 
+   if ( radio_is_using_link_simulator(interfaceIndex) )
+   {
+      pRadioHWInfo->openedForRead = 0;
+      pRadioHWInfo->runtimeInterfaceInfoRx.ppcap = NULL;
+      pRadioHWInfo->runtimeInterfaceInfoRx.iErrorCount = 0;
+      // The simulator delivers the frames by radio port, so there is no filter to set
+      pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd = radio_link_sim_rx_open(&s_RadioLinkSimRx[interfaceIndex], s_uLinkSimBasePort[interfaceIndex],
+         (_radio_encode_port(portNumber) >> 4) & 0x0F, s_LinkSimParams[interfaceIndex].iSignalDBM, s_LinkSimParams[interfaceIndex].iNoiseDBM);
+      if ( pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd < 0 )
+         return -1;
+      reset_runtime_radio_rx_info(&(pRadioHWInfo->runtimeInterfaceInfoRx.radioHwRxInfo));
+      pRadioHWInfo->runtimeInterfaceInfoRx.nPort = portNumber;
+      pRadioHWInfo->openedForRead = 1;
+      log_line("Opened radio interface %d (%s) for reading on port %d using the radio link simulator. Returned fd=%d", interfaceIndex+1, pRadioHWInfo->szName, portNumber, pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd);
+      return pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd;
+   }
+
    int port_encoded = _radio_encode_port(portNumber);
    sprintf(szFilter, "ether[0x00:2] == 0x0801 && ether[0x0a:4] == 0x13123456 && ether[0x04:1] == 0x%.2x", port_encoded);
    sprintf(szFilterPrism, "radio[0x40:2] == 0x0801 && radio[0x4a:4] == 0x13123456 && radio[0x44:1] == 0x%.2x", port_encoded);
@@ -707,6 +1046,17 @@ int radio_open_interface_for_write(int interfaceIndex)
    pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd = -1;
    pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount = 0;
 
+   if ( radio_is_using_link_simulator(interfaceIndex) )
+   {
+      pRadioHWInfo->runtimeInterfaceInfoTx.ppcap = NULL;
+      pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd = radio_link_sim_tx_open(&s_RadioLinkSimTx[interfaceIndex], s_uLinkSimBasePort[interfaceIndex], &s_LinkSimParams[interfaceIndex]);
+      if ( pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd < 0 )
+         return -1;
+      pRadioHWInfo->openedForWrite = 1;
+      log_line("Opened radio interface %d (%s) for writing using the radio link simulator. Returned fd=%d", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd);
+      return pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd;
+   }
+
    if ( s_iUsePCAPForTx )
    {
       log_line("Using ppcap for tx packets.");
@@ -809,7 +1159,17 @@ void radio_close_interface_for_read(int interfaceIndex)
 
    radio_rx_pause_interface(interfaceIndex, "Close radio interface");
    
-   if ( NULL != pRadioHWInfo->runtimeInterfaceInfoRx.ppcap )
+   if ( _radio_link_sim_rx_is_open(interfaceIndex) )
+   {
+      log_line("Closed radio interface %d [%s] that was used for read using the radio link simulator, selectable read fd was: %d", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd);
+      radio_link_sim_rx_close(&s_RadioLinkSimRx[interfaceIndex]);
+   }
+   else if ( (interfaceIndex < MAX_RADIO_INTERFACES) && radio_rx_ring_is_open(&s_RadioRxRings[interfaceIndex]) )
+   {
+      log_line("Closed radio interface %d [%s] that was used for read using mmap ring, selectable read fd was: %d", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd);
+      radio_rx_ring_close(&s_RadioRxRings[interfaceIndex]);
+   }
+   else if ( NULL != pRadioHWInfo->runtimeInterfaceInfoRx.ppcap )
    {
       log_line("Closed radio interface %d [%s] that was used for read, selectable read fd was: %d, ppcap was: %d", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoRx.selectable_fd, pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
       pcap_close(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap);
@@ -845,9 +1205,24 @@ void radio_close_interface_for_write(int interfaceIndex)
       return;
    }
 
+   if ( (interfaceIndex < MAX_RADIO_INTERFACES) && (radio_tx_batch_get_frames_count(&s_RadioTxBatches[interfaceIndex]) > 0) )
+      _radio_flush_tx_batch_on_interface(interfaceIndex);
+
+   // Frames still queued in the tx pacer hold the fd of this interface: they must be written
+   // (or dropped) before the fd is closed, as it can be reused right after
+   if ( radio_tx_pacer_get_queued_frames(&s_RadioTxPacer) > 0 )
+   if ( ! radio_tx_pacer_wait_empty(&s_RadioTxPacer, 200) )
+   {
+      log_softerror_and_alarm("RadioError: Radio tx pacer still has %d frames queued on closing radio interface %d. Dropping them.", radio_tx_pacer_get_queued_frames(&s_RadioTxPacer), interfaceIndex+1);
+      if ( ! radio_tx_pacer_discard_pending(&s_RadioTxPacer) )
+         s_iRadioPacedTxActive = 0;
+   }
+
    log_line("Closed radio interface %d (%s) that was used for write. Selectable write fd was: %d, ppcap was: %d", interfaceIndex+1, pRadioHWInfo->szName, pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd, pRadioHWInfo->runtimeInterfaceInfoTx.ppcap);
 
-   if ( s_iUsePCAPForTx )
+   if ( _radio_link_sim_tx_is_open(interfaceIndex) )
+      radio_link_sim_tx_close(&s_RadioLinkSimTx[interfaceIndex]);
+   else if ( s_iUsePCAPForTx )
    {
       if ( NULL != pRadioHWInfo->runtimeInterfaceInfoTx.ppcap )
          pcap_close(pRadioHWInfo->runtimeInterfaceInfoTx.ppcap);
@@ -957,7 +1332,22 @@ u8* radio_process_wlan_data_in(int interfaceNumber, int* piOutPacketLength, int*
    */
    struct pcap_pkthdr pcapHeader;
    ppcapPacketHeader = &pcapHeader;
-   pRadioPayload = (u8*) pcap_next(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap, ppcapPacketHeader); 
+   if ( (interfaceNumber < MAX_RADIO_INTERFACES) && radio_rx_ring_is_open(&s_RadioRxRings[interfaceNumber]) )
+   {
+      int iFrameLength = 0;
+      pRadioPayload = radio_rx_ring_next_frame(&s_RadioRxRings[interfaceNumber], &iFrameLength);
+      pcapHeader.caplen = iFrameLength;
+      pcapHeader.len = iFrameLength;
+   }
+   else if ( _radio_link_sim_rx_is_open(interfaceNumber) )
+   {
+      int iFrameLength = 0;
+      pRadioPayload = radio_link_sim_rx_next_frame(&s_RadioLinkSimRx[interfaceNumber], &iFrameLength);
+      pcapHeader.caplen = iFrameLength;
+      pcapHeader.len = iFrameLength;
+   }
+   else
+      pRadioPayload = (u8*) pcap_next(pRadioHWInfo->runtimeInterfaceInfoRx.ppcap, ppcapPacketHeader); 
    if ( NULL == pRadioPayload )
       return NULL;
    #ifdef DEBUG_PACKET_RECEIVED
@@ -1321,9 +1711,22 @@ int packet_process_and_check(int interfaceNb, u8* pPacketBuffer, int iBufferLeng
       #ifdef DEBUG_PACKET_RECEIVED
       log_line("enc detected");
       #endif
-      int dx = sizeof(t_packet_header);
-      int l = iPacketLength-dx;
-      dpp(pPacketBuffer + dx, l);
+      if ( pPH->packet_flags_extended & PACKET_FLAGS_EXTENDED_BIT_ENC_AEAD )
+      {
+         if ( ! dpp_aead(pPacketBuffer, iBufferLength) )
+         {
+            s_iLastProcessingErrorCode = RADIO_PROCESSING_ERROR_CODE_INVALID_AUTH_TAG;
+            if ( NULL != pbCRCOk )
+               *pbCRCOk = 0;
+            return 0;
+         }
+      }
+      else
+      {
+         int dx = sizeof(t_packet_header);
+         int l = iPacketLength-dx;
+         dpp(pPacketBuffer + dx, l);
+      }
    }
 
    u32 uCRC = 0;
@@ -1447,15 +1850,31 @@ int radio_build_new_raw_ieee_packet(int iLocalRadioLinkId, u8* pRawPacket, u8* p
   
    t_packet_header* pPH = (t_packet_header*)pRawPacket;
    pPH->radio_link_packet_index = uRadioLinkPacketIndex;
+   if ( (ENC_MODE_AEAD == bEncrypt) && (! hpp()) )
+      bEncrypt = ENC_MODE_NONE;
    if ( bEncrypt )
       pPH->packet_flags |= PACKET_FLAGS_BIT_HAS_ENCRYPTION;
 
+   // The authentication tag covers the whole packet, a headers only CRC is enough
+   if ( ENC_MODE_AEAD == bEncrypt )
+   {
+      pPH->packet_flags |= PACKET_FLAGS_BIT_HEADERS_ONLY_CRC;
+      pPH->packet_flags_extended |= PACKET_FLAGS_EXTENDED_BIT_ENC_AEAD;
+   }
+   else
+      pPH->packet_flags_extended &= ~PACKET_FLAGS_EXTENDED_BIT_ENC_AEAD;
+
    if ( pPH->packet_flags & PACKET_FLAGS_BIT_HEADERS_ONLY_CRC )
       radio_packet_compute_crc((u8*)pPH, sizeof(t_packet_header));
    else
       radio_packet_compute_crc((u8*)pPH, pPH->total_length);
 
-   if ( bEncrypt )
+   if ( ENC_MODE_AEAD == bEncrypt )
+   {
+      epp_aead(pRawPacket);
+      totalRadioLength += ENC_AEAD_TRAILER_SIZE;
+   }
+   else if ( bEncrypt )
    {
       int dx = sizeof(t_packet_header);
       epp(pRawPacket+dx, pPH->total_length-dx);
@@ -1500,6 +1919,58 @@ int radio_write_raw_ieee_packet(int interfaceIndex, u8* pData, int dataLength, i
      pPH = NULL;
    */
 
+   // The simulated link applies its own rate and pacing; tx batches and the tx pacer are bypassed
+   if ( _radio_link_sim_tx_is_open(interfaceIndex) )
+   {
+      for( int k=0; k<=iRepeatCount; k++ )
+      {
+         if ( ! radio_link_sim_tx_write(&s_RadioLinkSimTx[interfaceIndex], pData, dataLength) )
+         {
+            pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount++;
+            return 0;
+         }
+      }
+      pRadioHWInfo->runtimeInterfaceInfoTx.iErrorCount = 0;
+      s_uPacketsSentUsingCurrent_RadioRate++;
+      s_uPacketsSentUsingCurrent_RadioFlags++;
+      return 1;
+   }
+
+   // Hand the frame to the tx pacer thread if paced tx is in progress; it's written from there at the requested gap.
+   // Repeated frames are queued too (the repeats right after it), so they can't overtake the paced frames.
+   if ( _radio_can_use_paced_tx(interfaceIndex) )
+   {
+      if ( ! radio_tx_pacer_push(&s_RadioTxPacer, pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd, pData, dataLength, s_uRadioPacedTxNextGapMicros) )
+         return 0;
+      for( int k=0; k<iRepeatCount; k++ )
+      {
+         if ( ! radio_tx_pacer_push(&s_RadioTxPacer, pRadioHWInfo->runtimeInterfaceInfoTx.selectable_fd, pData, dataLength, 0) )
+            break;
+      }
+      s_uRadioPacedTxNextGapMicros = 0;
+      s_uPacketsSentUsingCurrent_RadioRate++;
+      s_uPacketsSentUsingCurrent_RadioFlags++;
+      return 1;
+   }
+
+   // Queue the frame if a tx batch is in progress; repeated frames are sent right away (after the queued ones)
+   if ( _radio_can_use_tx_batch(interfaceIndex) )
+   {
+      if ( 0 == iRepeatCount )
+      {
+         if ( radio_tx_batch_is_full(&s_RadioTxBatches[interfaceIndex]) )
+            _radio_flush_tx_batch_on_interface(interfaceIndex);
+         if ( radio_tx_batch_add_frame(&s_RadioTxBatches[interfaceIndex], pData, dataLength) )
+         {
+            s_uPacketsSentUsingCurrent_RadioRate++;
+            s_uPacketsSentUsingCurrent_RadioFlags++;
+            return 1;
+         }
+      }
+      if ( ! _radio_flush_tx_batch_on_interface(interfaceIndex) )
+         return 0;
+   }
+
    #ifdef FEATURE_RADIO_SYNCHRONIZE_RXTX_THREADS
    if ( 1 == s_iMutexRadioSyncRxTxThreadsInitialized )
       pthread_mutex_lock(&s_pMutexRadioSyncRxTxThreads);
@@ -37,6 +37,7 @@
 #include "radioflags.h"
 #include "radiotap.h"
 #include "radiopackets2.h"
+#include "radio_link_sim.h"
 #include <time.h>
 #include <sys/resource.h>
 
@@ -45,6 +46,7 @@
 #define RADIO_PROCESSING_ERROR_NO_ERROR 0x00
 #define RADIO_PROCESSING_ERROR_CODE_INVALID_CRC_RECEIVED 0x01
 #define RADIO_PROCESSING_ERROR_CODE_PACKET_RECEIVED_TOO_SMALL 0x02
+#define RADIO_PROCESSING_ERROR_CODE_INVALID_AUTH_TAG 0x03
 #define RADIO_PROCESSING_ERROR_INVALID_PARAMETERS 0x0E
 #define RADIO_PROCESSING_ERROR_INVALID_RECEIVED_PACKET 0x0F
 
@@ -66,6 +68,37 @@ void radio_set_link_clock_delta(int iVehicleBehindMilisec);
 int  radio_get_link_clock_delta();
 void radio_set_use_pcap_for_tx(int iEnablePCAPTx);
 void radio_set_bypass_socket_buffers(int iBypass);
+void radio_set_use_mmap_ring_for_rx(int iInterfaceIndex, int iEnable); // -1 for all interfaces, applies on next open for read
+int  radio_is_using_mmap_ring_for_rx(int iInterfaceIndex);
+int  radio_get_rx_ring_pending_frames(int iInterfaceIndex);
+
+// Batched radio tx (sockets mode only): between radio_begin_tx_batch() and radio_flush_tx_batch()
+// radio_write_raw_ieee_packet() queues the frames and they are sent with one syscall per interface.
+// Frames can be built in place, in the buffer returned by radio_get_tx_batch_frame_buffer().
+void radio_set_use_batched_tx(int iEnable);
+int  radio_begin_tx_batch(); // returns 1 if batching is used
+int  radio_is_tx_batch_active();
+u8*  radio_get_tx_batch_frame_buffer(int interfaceIndex); // NULL if no batch is in progress
+int  radio_flush_tx_batch(); // returns 1 on success
+
+// Paced radio tx (sockets mode only): between radio_begin_paced_tx() and radio_end_paced_tx()
+// radio_write_raw_ieee_packet() queues the frames to the tx pacer thread, which writes them
+// no sooner than the gap set with radio_set_paced_tx_next_gap() after the previous frame.
+// Frames can be built in place, in the buffer returned by radio_get_paced_tx_frame_buffer().
+void radio_set_use_paced_tx(int iEnable, shared_mem_radio_tx_pacing_stats* pStats, int iThreadRawPriority);
+int  radio_begin_paced_tx(); // returns 1 if pacing is used
+int  radio_is_paced_tx_active();
+void radio_set_paced_tx_next_gap(u32 uGapMicros); // applies to the next frame written
+u8*  radio_get_paced_tx_frame_buffer(int interfaceIndex); // NULL if no paced tx is in progress
+void radio_end_paced_tx();
+
+// Radio link simulator (see radio_link_sim.h): the wifi interfaces read and write over UDP on localhost
+// instead of the radio cards, with the link impairments in pParams (NULL for a perfect link).
+// iInterfaceIndex -1 for all interfaces; uBasePort 0 to use the real radio interfaces; applies on next open.
+void radio_set_use_link_simulator(int iInterfaceIndex, u16 uBasePort, type_radio_link_sim_params* pParams);
+int  radio_is_using_link_simulator(int iInterfaceIndex);
+int  radio_get_link_simulator_stats(int iInterfaceIndex, type_radio_link_sim_stats* pStats); // returns 0 if not open for write on the simulator
+
 int  radio_set_out_datarate(int rate_bps, u8 uPacketType, u32 uTimeNow); // positive: classic in bps, negative: MCS; returns 1 if it was changed
 u32  radio_get_current_frames_flags();
 u32  radio_get_current_frames_flags_datarate();
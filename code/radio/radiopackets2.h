@@ -87,6 +87,7 @@
 #define PACKET_FLAGS_BIT_HAS_ENCRYPTION   ((u8)(1<<6))
 #define PACKET_FLAGS_BIT_HIGH_PRIORITY    ((u8)(1<<7))
 
+#define PACKET_FLAGS_EXTENDED_BIT_ENC_AEAD  (((u16)1)<<0)
 #define PACKET_FLAGS_EXTENDED_BIT_SEND_ON_HIGH_CAPACITY_LINK_ONLY  (((u16)1)<<8)
 #define PACKET_FLAGS_EXTENDED_BIT_SEND_ON_LOW_CAPACITY_LINK_ONLY  (((u16)1)<<9)
 #define PACKET_FLAGS_EXTENDED_BIT_REQUIRE_ACK  (((u16)1)<<10)
@@ -126,7 +127,7 @@ typedef struct
 
    u16 packet_flags_extended;  // Added in 7.4: it replaced (length of all headers)
              // byte 0:
-             // not used
+             //    bit 0: 1: encrypted with ChaCha20-Poly1305, 16 bytes tag after the packet (total_length)
              // byte 1:
              //    bit 0: 1: send on high capacity links only;
              //    bit 1: 1: sent on low capacity links only;
@@ -278,8 +279,10 @@ typedef struct
 //         bit 0: contains re-requested packets
 //         bit 1: contains request for start of video frame packets at the end
 //         bit 2: contains request for end of video frame packets at the end
-//   u8: number of individual video packets requested
+//         bit 3: requested packets are coalesced per video block (VIDEO_NACK_FLAG_COALESCED, see video_nack.h)
+//   u8: number of individual video packets requested (number of video blocks if coalesced)
 //   (u32+u8)*n = each (video block index + video packet index) requested
+//      or, if coalesced: u32 first video block index + (u8+u32)*n = each (video block index delta + packets mask) requested
 //   (u16+u8) frame id and frame packets from start to get
 //   (u16+u8) frame id and frame packets to EOF to get
 
@@ -37,10 +37,34 @@
 #include "radiolink.h"
 
 
+// Returns the pool buffer to queue for the packet: the packet itself if it's a pool buffer, a copy otherwise
+static u8* _packets_queue_get_buffer(u8* pBuffer, int iLength)
+{
+   u8* pPoolBuffer = packet_pool_get_handoff_buffer(pBuffer, iLength);
+   if ( NULL != pPoolBuffer )
+   {
+      packet_pool_ref(pPoolBuffer);
+      return pPoolBuffer;
+   }
+   return packet_pool_alloc_copy(pBuffer, iLength);
+}
+
+static void _packets_queue_set_item_buffer(t_packet_queue_item* pItem, u8* pBuffer)
+{
+   if ( NULL != pItem->pPacketBuffer )
+      packet_pool_unref(pItem->pPacketBuffer);
+   pItem->pPacketBuffer = pBuffer;
+}
+
 void packets_queue_init(t_packet_queue* pQueue)
 {
    if ( NULL == pQueue )
       return;
+   for( int i=0; i<MAX_PACKETS_IN_QUEUE; i++ )
+      _packets_queue_set_item_buffer(&(pQueue->packets_queue[i]), NULL);
+   if ( NULL != pQueue->pPoppedBuffer )
+      packet_pool_unref(pQueue->pPoppedBuffer);
+   pQueue->pPoppedBuffer = NULL;
    pQueue->queue_start_pos = -1;
    pQueue->queue_end_pos = -1;   
 }
@@ -65,60 +89,43 @@ int packets_queue_has_packets(t_packet_queue* pQueue)
    return pQueue->queue_end_pos + (MAX_PACKETS_IN_QUEUE - pQueue->queue_start_pos);
 }
 
-int packets_queue_inject_packet_first(t_packet_queue* pQueue, u8* pBuffer)
+static int _packets_queue_inject_packet_first(t_packet_queue* pQueue, u8* pBuffer, u32 uTimeAdded)
 {
-   if ( NULL == pQueue )
+   if ( (NULL == pQueue) || (NULL == pBuffer) )
       return 0;
 
    t_packet_header* pPH = (t_packet_header*)pBuffer;
-   
+   u8* pPacketBuffer = _packets_queue_get_buffer(pBuffer, pPH->total_length);
+   if ( NULL == pPacketBuffer )
+      return 0;
+
    if ( (-1 == pQueue->queue_start_pos) || (pQueue->queue_start_pos == pQueue->queue_end_pos) )
    {
       pQueue->queue_start_pos = 0;
       pQueue->queue_end_pos = 1;
       pQueue->timeFirstPacket = get_current_timestamp_ms();
-      pQueue->packets_queue[0].uTimeAdded = 0;
-      pQueue->packets_queue[0].packet_length = pPH->total_length;
-      memcpy( &(pQueue->packets_queue[0].packet_buffer[0]), pBuffer, pQueue->packets_queue[0].packet_length);
-      return 1;
+   }
+   else
+   {
+      pQueue->queue_start_pos--;
+      if ( pQueue->queue_start_pos < 0 )
+         pQueue->queue_start_pos = MAX_PACKETS_IN_QUEUE-1;
    }
 
-   pQueue->queue_start_pos--;
-   if ( pQueue->queue_start_pos < 0 )
-      pQueue->queue_start_pos = MAX_PACKETS_IN_QUEUE-1;
-
-   pQueue->packets_queue[pQueue->queue_start_pos].uTimeAdded = 0;
+   pQueue->packets_queue[pQueue->queue_start_pos].uTimeAdded = uTimeAdded;
    pQueue->packets_queue[pQueue->queue_start_pos].packet_length = pPH->total_length;
-   memcpy( &(pQueue->packets_queue[pQueue->queue_start_pos].packet_buffer[0]), pBuffer, pQueue->packets_queue[pQueue->queue_start_pos].packet_length);
+   _packets_queue_set_item_buffer(&(pQueue->packets_queue[pQueue->queue_start_pos]), pPacketBuffer);
    return 1;
 }
 
-int packets_queue_inject_packet_first_mark_time(t_packet_queue* pQueue, u8* pBuffer)
+int packets_queue_inject_packet_first(t_packet_queue* pQueue, u8* pBuffer)
 {
-   if ( NULL == pQueue )
-      return 0;
-
-   t_packet_header* pPH = (t_packet_header*)pBuffer;
-   
-   if ( (-1 == pQueue->queue_start_pos) || (pQueue->queue_start_pos == pQueue->queue_end_pos) )
-   {
-      pQueue->queue_start_pos = 0;
-      pQueue->queue_end_pos = 1;
-      pQueue->timeFirstPacket = get_current_timestamp_ms();
-      pQueue->packets_queue[0].uTimeAdded = get_current_timestamp_micros();
-      pQueue->packets_queue[0].packet_length = pPH->total_length;
-      memcpy( &(pQueue->packets_queue[0].packet_buffer[0]), pBuffer, pQueue->packets_queue[0].packet_length);
-      return 1;
-   }
-
-   pQueue->queue_start_pos--;
-   if ( pQueue->queue_start_pos < 0 )
-      pQueue->queue_start_pos = MAX_PACKETS_IN_QUEUE-1;
+   return _packets_queue_inject_packet_first(pQueue, pBuffer, 0);
+}
 
-   pQueue->packets_queue[pQueue->queue_start_pos].uTimeAdded = get_current_timestamp_micros();
-   pQueue->packets_queue[pQueue->queue_start_pos].packet_length = pPH->total_length;
-   memcpy( &(pQueue->packets_queue[pQueue->queue_start_pos].packet_buffer[0]), pBuffer, pQueue->packets_queue[pQueue->queue_start_pos].packet_length);
-   return 1;
+int packets_queue_inject_packet_first_mark_time(t_packet_queue* pQueue, u8* pBuffer)
+{
+   return _packets_queue_inject_packet_first(pQueue, pBuffer, get_current_timestamp_micros());
 }
 
 int packets_queue_add_packet(t_packet_queue* pQueue, u8* pBuffer)
@@ -133,7 +140,7 @@ int packets_queue_add_packet_mark_time(t_packet_queue* pQueue, u8* pBuffer)
 
 int packets_queue_add_packet2(t_packet_queue* pQueue, u8* pBuffer, int length, int has_radio_header, int iMarkTime)
 {
-   if ( NULL == pQueue )
+   if ( (NULL == pQueue) || (NULL == pBuffer) )
       return 0;
    if ( -1 == pQueue->queue_start_pos )
    {
@@ -145,6 +152,15 @@ int packets_queue_add_packet2(t_packet_queue* pQueue, u8* pBuffer, int length, i
    if ( ((pQueue->queue_end_pos+1) % MAX_PACKETS_IN_QUEUE) == pQueue->queue_start_pos )
       return 0;
 
+   if ( -1 == length )
+   {
+      t_packet_header* pPH = (t_packet_header*)pBuffer;
+      length = pPH->total_length;
+   }
+   u8* pPacketBuffer = _packets_queue_get_buffer(pBuffer, length);
+   if ( NULL == pPacketBuffer )
+      return 0;
+
    // Empty queue ?
    if ( pQueue->queue_start_pos == pQueue->queue_end_pos )
       pQueue->timeFirstPacket = get_current_timestamp_ms();
@@ -155,13 +171,7 @@ int packets_queue_add_packet2(t_packet_queue* pQueue, u8* pBuffer, int length, i
       pQueue->packets_queue[pQueue->queue_end_pos].uTimeAdded = 0;
    pQueue->packets_queue[pQueue->queue_end_pos].has_radio_header = (u8)has_radio_header;
    pQueue->packets_queue[pQueue->queue_end_pos].packet_length = (u16)length;
-   if ( -1 == length )
-   {
-      t_packet_header* pPH = (t_packet_header*)pBuffer;
-      pQueue->packets_queue[pQueue->queue_end_pos].packet_length = pPH->total_length;
-   }
-
-   memcpy( &(pQueue->packets_queue[pQueue->queue_end_pos].packet_buffer[0]), pBuffer, pQueue->packets_queue[pQueue->queue_end_pos].packet_length);
+   _packets_queue_set_item_buffer(&(pQueue->packets_queue[pQueue->queue_end_pos]), pPacketBuffer);
 
    pQueue->queue_end_pos++;
    if ( pQueue->queue_end_pos >= MAX_PACKETS_IN_QUEUE )
@@ -170,6 +180,24 @@ int packets_queue_add_packet2(t_packet_queue* pQueue, u8* pBuffer, int length, i
    return 1;
 }
 
+// The popped packet buffer is kept by the queue until the next pop.
+// Popped packets are modified in place by the senders, so a packet still shared with someone else is copied.
+static u8* _packets_queue_take_item_buffer(t_packet_queue* pQueue, int iPos)
+{
+   if ( NULL != pQueue->pPoppedBuffer )
+      packet_pool_unref(pQueue->pPoppedBuffer);
+   u8* pBuffer = pQueue->packets_queue[iPos].pPacketBuffer;
+   pQueue->packets_queue[iPos].pPacketBuffer = NULL;
+   if ( (NULL != pBuffer) && (packet_pool_get_ref_count(pBuffer) > 1) )
+   {
+      u8* pCopy = packet_pool_alloc_copy(pBuffer, pQueue->packets_queue[iPos].packet_length);
+      packet_pool_unref(pBuffer);
+      pBuffer = pCopy;
+   }
+   pQueue->pPoppedBuffer = pBuffer;
+   return pBuffer;
+}
+
 u8* packets_queue_pop_packet(t_packet_queue* pQueue, int* pLength)
 {
    if ( NULL == pQueue )
@@ -181,7 +209,7 @@ u8* packets_queue_pop_packet(t_packet_queue* pQueue, int* pLength)
 
    if ( NULL != pLength )
       *pLength = pQueue->packets_queue[pQueue->queue_start_pos].packet_length;
-   u8* pRet = &(pQueue->packets_queue[pQueue->queue_start_pos].packet_buffer[0]);
+   u8* pRet = _packets_queue_take_item_buffer(pQueue, pQueue->queue_start_pos);
 
    pQueue->queue_start_pos++;
    if ( pQueue->queue_start_pos >= MAX_PACKETS_IN_QUEUE )
@@ -206,7 +234,7 @@ u8* packets_queue_pop_packet_and_time(t_packet_queue* pQueue, int* pLength, u32*
       *pLength = pQueue->packets_queue[pQueue->queue_start_pos].packet_length;
    if ( NULL != puTimeAdded )
       *puTimeAdded = pQueue->packets_queue[pQueue->queue_start_pos].uTimeAdded;
-   u8* pRet = &(pQueue->packets_queue[pQueue->queue_start_pos].packet_buffer[0]);
+   u8* pRet = _packets_queue_take_item_buffer(pQueue, pQueue->queue_start_pos);
 
    pQueue->queue_start_pos++;
    if ( pQueue->queue_start_pos >= MAX_PACKETS_IN_QUEUE )
@@ -232,7 +260,7 @@ u8* packets_queue_peek_packet(t_packet_queue* pQueue, int index, int* pLength)
       iPos -= MAX_PACKETS_IN_QUEUE;
    if ( NULL != pLength )
       *pLength = pQueue->packets_queue[iPos].packet_length;
-   u8* pRet = &(pQueue->packets_queue[iPos].packet_buffer[0]);
+   u8* pRet = pQueue->packets_queue[iPos].pPacketBuffer;
 
    return pRet;
 }
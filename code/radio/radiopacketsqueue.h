@@ -1,5 +1,10 @@
 #pragma once
 #include "radiopackets2.h"
+#include "../base/packet_pool.h"
+
+// Queued packets are held in packet pool buffers: a packet that is already the whole content of a pool
+// buffer is queued by reference, any other packet is copied in a new pool buffer.
+// A popped packet stays valid until the next pop from the same queue (or queue init).
 
 #define MAX_PACKETS_IN_QUEUE 64
 
@@ -7,8 +12,8 @@ typedef struct
 {
    u32 uTimeAdded;
    u8  has_radio_header;
-   u8  packet_buffer[MAX_PACKET_TOTAL_SIZE];
    u16 packet_length;
+   u8* pPacketBuffer; // packet pool buffer
 } ALIGN_STRUCT_SPEC_INFO t_packet_queue_item;
 
 typedef struct
@@ -17,12 +22,14 @@ typedef struct
    int queue_start_pos; // position of first element in queue
    int queue_end_pos; // position of first free element in queue (after the last one)
    u32 timeFirstPacket;
+   u8* pPoppedBuffer; // last popped packet, released on the next pop
 } ALIGN_STRUCT_SPEC_INFO t_packet_queue;
 
 #ifdef __cplusplus
 extern "C" {
 #endif  
 
+// Also empties the queue (releases the queued packets)
 void packets_queue_init(t_packet_queue* pQueue);
 
 int packets_queue_is_empty(t_packet_queue* pQueue);
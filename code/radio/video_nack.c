@@ -0,0 +1,356 @@
+/*
+    Ruby Licence
+    Copyright (c) 2020-2025 Petru Soroaga petrusoroaga@yahoo.com
+    All rights reserved.
+
+    Redistribution and/or use in source and/or binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions and/or use of the source code (partially or complete) must retain
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Redistributions in binary form (partially or complete) must reproduce
+        the above copyright notice, this list of conditions and the following disclaimer
+        in the documentation and/or other materials provided with the distribution.
+        * Copyright info and developer info must be preserved as is in the user
+        interface, additions could be made to that info.
+        * Neither the name of the organization nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+        * Military use is not permitted.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE AUTHOR (PETRU SOROAGA) BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "../base/base.h"
+#include "video_nack.h"
+
+static void _video_nack_update_rto(type_video_nack_state* pState)
+{
+   u32 uRTO = (pState->uSRTTx8 >> 3) + pState->uRTTVarx4;
+   if ( uRTO < VIDEO_NACK_MIN_RTO_MS )
+      uRTO = VIDEO_NACK_MIN_RTO_MS;
+   if ( uRTO > VIDEO_NACK_MAX_RTO_MS )
+      uRTO = VIDEO_NACK_MAX_RTO_MS;
+   pState->uRTOMs = uRTO;
+}
+
+void video_nack_init(type_video_nack_state* pState)
+{
+   if ( NULL == pState )
+      return;
+   memset(pState, 0, sizeof(type_video_nack_state));
+   pState->uSRTTx8 = VIDEO_NACK_DEFAULT_RTT_MS << 3;
+   pState->uRTTVarx4 = (VIDEO_NACK_DEFAULT_RTT_MS/2) << 2;
+   _video_nack_update_rto(pState);
+   video_nack_reset_pending(pState);
+}
+
+void video_nack_reset_pending(type_video_nack_state* pState)
+{
+   if ( NULL == pState )
+      return;
+   for( int i=0; i<VIDEO_NACK_MAX_PENDING_REQUESTS; i++ )
+   {
+      pState->uPendingIds[i] = 0;
+      pState->uPendingTimes[i] = 0;
+   }
+   pState->iNextPendingIndex = 0;
+   pState->uLastSkippedBlockIndex = 0;
+   pState->iHasSkippedBlock = 0;
+}
+
+u32 video_nack_get_srtt_ms(type_video_nack_state* pState)
+{
+   if ( NULL == pState )
+      return VIDEO_NACK_DEFAULT_RTT_MS;
+   return pState->uSRTTx8 >> 3;
+}
+
+u32 video_nack_get_rto_ms(type_video_nack_state* pState)
+{
+   if ( NULL == pState )
+      return VIDEO_NACK_MAX_RTO_MS;
+   return pState->uRTOMs;
+}
+
+void video_nack_on_request_sent(type_video_nack_state* pState, u32 uRequestId, u32 uTimeNow, int iCountPackets, int iRequestBytes)
+{
+   if ( NULL == pState )
+      return;
+   pState->uPendingIds[pState->iNextPendingIndex] = uRequestId;
+   pState->uPendingTimes[pState->iNextPendingIndex] = uTimeNow;
+   pState->iNextPendingIndex = (pState->iNextPendingIndex + 1) % VIDEO_NACK_MAX_PENDING_REQUESTS;
+
+   pState->uCountRequests++;
+   pState->uCountRequestedPackets += (u32)iCountPackets;
+   pState->uTotalRequestsBytes += (u64)iRequestBytes;
+}
+
+int video_nack_on_response(type_video_nack_state* pState, u32 uRequestId, u32 uTimeNow)
+{
+   if ( (NULL == pState) || (0 == uRequestId) )
+      return -1;
+
+   // Newest requests first, the response is usually for one of the last requests
+   int iIndex = pState->iNextPendingIndex;
+   for( int i=0; i<VIDEO_NACK_MAX_PENDING_REQUESTS; i++ )
+   {
+      iIndex--;
+      if ( iIndex < 0 )
+         iIndex = VIDEO_NACK_MAX_PENDING_REQUESTS-1;
+      if ( pState->uPendingIds[iIndex] != uRequestId )
+         continue;
+
+      // Only the first packet answering a request is a RTT sample
+      pState->uPendingIds[iIndex] = 0;
+      u32 uSample = uTimeNow - pState->uPendingTimes[iIndex];
+      if ( 0 == pState->uCountSamples )
+      {
+         pState->uSRTTx8 = uSample << 3;
+         pState->uRTTVarx4 = (uSample/2) << 2;
+         pState->uMinSampleMs = uSample;
+         pState->uMaxSampleMs = uSample;
+      }
+      else
+      {
+         // SRTT += (sample - SRTT)/8, RTTVAR += (|sample - SRTT| - RTTVAR)/4
+         int iDelta = (int)uSample - (int)(pState->uSRTTx8 >> 3);
+         pState->uSRTTx8 = (u32)((int)pState->uSRTTx8 + iDelta);
+         if ( iDelta < 0 )
+            iDelta = -iDelta;
+         iDelta -= (int)(pState->uRTTVarx4 >> 2);
+         pState->uRTTVarx4 = (u32)((int)pState->uRTTVarx4 + iDelta);
+         if ( uSample < pState->uMinSampleMs )
+            pState->uMinSampleMs = uSample;
+         if ( uSample > pState->uMaxSampleMs )
+            pState->uMaxSampleMs = uSample;
+      }
+      pState->uCountSamples++;
+      pState->uLastSampleMs = uSample;
+      if ( pState->uPendingTimes[iIndex] > pState->uLastAnsweredRequestTime )
+         pState->uLastAnsweredRequestTime = pState->uPendingTimes[iIndex];
+      pState->uLastAnswerTime = uTimeNow;
+      _video_nack_update_rto(pState);
+      return (int)uSample;
+   }
+   return -1;
+}
+
+u32 video_nack_get_packets_to_request(type_video_nack_state* pState, u32 uMissingMask, u32 uRequestedMask, const u32* pRequestedTimes, u32 uDeadline, u32 uTimeNow)
+{
+   if ( NULL == pState )
+      return uMissingMask;
+
+   // Last time a request can be answered before the deadline
+   u32 uLastRequestTime = 0;
+   if ( uDeadline > (pState->uSRTTx8 >> 3) + (pState->uRTTVarx4 >> 2) )
+      uLastRequestTime = uDeadline - (pState->uSRTTx8 >> 3) - (pState->uRTTVarx4 >> 2);
+
+   // The retransmissions answering a request arrive within the RTT variance of each other
+   u32 uAnswerWaitMs = pState->uRTTVarx4 >> 2;
+   if ( uAnswerWaitMs < VIDEO_NACK_MIN_RTO_MS )
+      uAnswerWaitMs = VIDEO_NACK_MIN_RTO_MS;
+   int iAnswered = ((0 != pState->uLastAnswerTime) && (uTimeNow >= pState->uLastAnswerTime + uAnswerWaitMs))?1:0;
+
+   u32 uToRequest = uMissingMask & (~uRequestedMask);
+   u32 uInFlight = uMissingMask & uRequestedMask;
+   while ( 0 != uInFlight )
+   {
+      int k = __builtin_ctz(uInFlight);
+      uInFlight &= uInFlight - 1;
+      u32 uRetryTime = pRequestedTimes[k] + pState->uRTOMs;
+      if ( (uRetryTime > uLastRequestTime) && (uLastRequestTime >= pRequestedTimes[k] + VIDEO_NACK_MIN_RTO_MS) )
+      {
+         uRetryTime = uLastRequestTime;
+         if ( uLastRequestTime >= pRequestedTimes[k] + 2*VIDEO_NACK_MIN_RTO_MS )
+            uRetryTime = pRequestedTimes[k] + (uLastRequestTime - pRequestedTimes[k])/2;
+      }
+      // Lost: a request sent at the same time or after it was answered
+      if ( iAnswered && (pRequestedTimes[k] <= pState->uLastAnsweredRequestTime) )
+         uRetryTime = uTimeNow;
+      if ( uTimeNow >= uRetryTime )
+         uToRequest |= ((u32)1) << k;
+      else
+         pState->uCountSuppressedPackets++;
+   }
+   return uToRequest;
+}
+
+int video_nack_is_past_deadline(type_video_nack_state* pState, u32 uBlockIndex, u32 uBlockTime, u32 uDeadlineMs, u32 uTimeNow)
+{
+   if ( (NULL == pState) || (0 == uBlockTime) )
+      return 0;
+   if ( uTimeNow + (pState->uSRTTx8 >> 3) < uBlockTime + uDeadlineMs )
+      return 0;
+   // The same blocks stay past their deadline on each check until they leave the rx buffer
+   if ( (! pState->iHasSkippedBlock) || (uBlockIndex > pState->uLastSkippedBlockIndex) )
+   {
+      pState->uCountSkippedBlocks++;
+      pState->uLastSkippedBlockIndex = uBlockIndex;
+      pState->iHasSkippedBlock = 1;
+   }
+   return 1;
+}
+
+int video_nack_encode_blocks(u8* pOutput, const u32* pBlockIndexes, const u32* pMasks, int iCountBlocks, int* piLength)
+{
+   if ( NULL != piLength )
+      *piLength = 0;
+   if ( (NULL == pOutput) || (iCountBlocks <= 0) )
+      return 0;
+
+   u32 uFirstBlockIndex = pBlockIndexes[0];
+   u8* pData = pOutput;
+   memcpy(pData, &uFirstBlockIndex, sizeof(u32));
+   pData += sizeof(u32);
+
+   int iCount = 0;
+   for( ; iCount<iCountBlocks; iCount++ )
+   {
+      if ( (pBlockIndexes[iCount] < uFirstBlockIndex) || (pBlockIndexes[iCount] - uFirstBlockIndex > VIDEO_NACK_MAX_BLOCK_DELTA) )
+         break;
+      *pData = (u8)(pBlockIndexes[iCount] - uFirstBlockIndex);
+      pData++;
+      memcpy(pData, &pMasks[iCount], sizeof(u32));
+      pData += sizeof(u32);
+   }
+   if ( NULL != piLength )
+      *piLength = (int)(pData - pOutput);
+   return iCount;
+}
+
+int video_nack_decode_blocks(const u8* pInput, int iLength, int iCountBlocks, u32* pBlockIndexes, u32* pMasks)
+{
+   if ( (NULL == pInput) || (iCountBlocks <= 0) )
+      return 0;
+   if ( iLength < (int)sizeof(u32) + iCountBlocks * (int)(sizeof(u8) + sizeof(u32)) )
+      return -1;
+
+   u32 uFirstBlockIndex = 0;
+   memcpy(&uFirstBlockIndex, pInput, sizeof(u32));
+   pInput += sizeof(u32);
+   for( int i=0; i<iCountBlocks; i++ )
+   {
+      pBlockIndexes[i] = uFirstBlockIndex + (u32)(*pInput);
+      pInput++;
+      memcpy(&pMasks[i], pInput, sizeof(u32));
+      pInput += sizeof(u32);
+   }
+   return iCountBlocks;
+}
+
+int video_nack_count_requests(const u32* pMasks, int iCountBlocks)
+{
+   int iCount = 0;
+   for( int i=0; i<iCountBlocks; i++ )
+   {
+      if ( VIDEO_NACK_MASK_FULL_BLOCK == pMasks[i] )
+         iCount++;
+      else
+         iCount += __builtin_popcount(pMasks[i]);
+   }
+   return iCount;
+}
+
+int video_nack_build_request(u8* pOutput, u32 uRequestId, u8 uVideoStreamIndex, u8 uFlags, const u32* pBlockIndexes, const u32* pMasks, int iCountBlocks, int bCoalesce)
+{
+   if ( NULL == pOutput )
+      return 0;
+   u8* pData = pOutput + sizeof(u32) + 3*sizeof(u8);
+   int iCountEntries = 0;
+   if ( bCoalesce )
+   {
+      int iLength = 0;
+      iCountEntries = video_nack_encode_blocks(pData, pBlockIndexes, pMasks, iCountBlocks, &iLength);
+      pData += iLength;
+      uFlags |= VIDEO_NACK_FLAG_COALESCED;
+   }
+   else
+   {
+      uFlags &= ~VIDEO_NACK_FLAG_COALESCED;
+      for( int i=0; (i<iCountBlocks) && (iCountEntries < 255); i++ )
+      {
+         u32 uMask = pMasks[i];
+         if ( VIDEO_NACK_MASK_FULL_BLOCK == uMask )
+            uMask = 0;
+         do
+         {
+            u8 uPacketIndex = 0xFF;
+            if ( 0 != uMask )
+            {
+               uPacketIndex = (u8)__builtin_ctz(uMask);
+               uMask &= uMask - 1;
+            }
+            memcpy(pData, &pBlockIndexes[i], sizeof(u32));
+            pData += sizeof(u32);
+            *pData = uPacketIndex;
+            pData++;
+            iCountEntries++;
+         }
+         while ( (0 != uMask) && (iCountEntries < 255) );
+      }
+   }
+
+   memcpy(pOutput, &uRequestId, sizeof(u32));
+   pOutput[sizeof(u32)] = uVideoStreamIndex;
+   pOutput[sizeof(u32) + 1] = uFlags;
+   pOutput[sizeof(u32) + 2] = (u8)iCountEntries;
+   return (int)(pData - pOutput);
+}
+
+int video_nack_parse_request(const u8* pInput, int iLength, type_video_nack_request* pRequest)
+{
+   if ( (NULL == pInput) || (NULL == pRequest) || (iLength < (int)(sizeof(u32) + 3*sizeof(u8))) )
+      return -1;
+   memcpy(&pRequest->uRequestId, pInput, sizeof(u32));
+   pRequest->uVideoStreamIndex = pInput[sizeof(u32)];
+   pRequest->uFlags = pInput[sizeof(u32) + 1];
+   pRequest->iCountEntries = pInput[sizeof(u32) + 2];
+   pRequest->iCountBlocks = 0;
+   int iPos = (int)(sizeof(u32) + 3*sizeof(u8));
+
+   if ( pRequest->uFlags & VIDEO_NACK_FLAG_COALESCED )
+   {
+      if ( video_nack_decode_blocks(pInput + iPos, iLength - iPos, pRequest->iCountEntries, pRequest->uBlockIndexes, pRequest->uMasks) < 0 )
+         return -1;
+      pRequest->iCountBlocks = pRequest->iCountEntries;
+      if ( pRequest->iCountEntries > 0 )
+         iPos += (int)sizeof(u32) + pRequest->iCountEntries * (int)(sizeof(u8) + sizeof(u32));
+      return iPos;
+   }
+
+   if ( iLength - iPos < pRequest->iCountEntries * (int)(sizeof(u32) + sizeof(u8)) )
+      return -1;
+   for( int i=0; i<pRequest->iCountEntries; i++ )
+   {
+      u32 uBlockIndex = 0;
+      memcpy(&uBlockIndex, pInput + iPos, sizeof(u32));
+      u8 uPacketIndex = pInput[iPos + sizeof(u32)];
+      iPos += (int)(sizeof(u32) + sizeof(u8));
+      if ( (0xFF != uPacketIndex) && (uPacketIndex >= 32) )
+         continue;
+      u32 uMask = (0xFF == uPacketIndex)?VIDEO_NACK_MASK_FULL_BLOCK:(((u32)1) << uPacketIndex);
+
+      // Consecutive entries of the same block go in the same mask
+      int iLast = pRequest->iCountBlocks - 1;
+      if ( (iLast >= 0) && (pRequest->uBlockIndexes[iLast] == uBlockIndex) &&
+           (VIDEO_NACK_MASK_FULL_BLOCK != uMask) && (VIDEO_NACK_MASK_FULL_BLOCK != pRequest->uMasks[iLast]) )
+      {
+         pRequest->uMasks[iLast] |= uMask;
+         continue;
+      }
+      pRequest->uBlockIndexes[pRequest->iCountBlocks] = uBlockIndex;
+      pRequest->uMasks[pRequest->iCountBlocks] = uMask;
+      pRequest->iCountBlocks++;
+   }
+   return iPos;
+}
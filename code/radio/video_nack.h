@@ -0,0 +1,111 @@
+#pragma once
+
+#include "../base/base.h"
+
+// Retransmission requests (NACK) scheduling for the video stream, station side.
+// The round trip time of the retransmissions is estimated from request/response pairs: the vehicle
+// tags the retransmitted packets with the id of the request they answer, the first packet that
+// answers a request in flight gives a RTT sample (smoothed RTT and RTT variance, as the TCP RTO).
+// A requested packet is not requested again until its request timeout (RTO) expires or, if that is too
+// late, until halfway to the last time it can still be retransmitted before its block playout deadline. It is
+// requested again sooner if a request sent after it was answered and it is still missing (lost).
+// No packets are requested from blocks whose retransmissions would arrive past their playout deadline.
+// The packets requested from the same video block are coalesced in a bitmask entry.
+
+#define VIDEO_NACK_MAX_PENDING_REQUESTS 32
+#define VIDEO_NACK_DEFAULT_RTT_MS 20
+#define VIDEO_NACK_MIN_RTO_MS 5
+#define VIDEO_NACK_MAX_RTO_MS 200
+
+// Set in the flags byte of a PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS request when the requested
+// packets are coalesced per video block. The request count is the number of blocks then, followed by:
+//   u32: video block index of the first entry
+//   (u8+u32)*count: video block index delta from the first entry, mask of the block packets requested
+#define VIDEO_NACK_FLAG_COALESCED 0x08
+#define VIDEO_NACK_MASK_FULL_BLOCK 0xFFFFFFFF
+#define VIDEO_NACK_MAX_BLOCK_DELTA 255
+// First vehicle software build that decodes the coalesced requests (released 11.8 builds do not)
+#define VIDEO_NACK_COALESCED_MIN_SW_BUILD 11802
+
+typedef struct
+{
+   u32 uSRTTx8; // smoothed RTT, ms * 8
+   u32 uRTTVarx4; // RTT variance, ms * 4
+   u32 uRTOMs;
+   u32 uCountSamples;
+   u32 uLastSampleMs;
+   u32 uMinSampleMs;
+   u32 uMaxSampleMs;
+   u32 uLastAnsweredRequestTime; // send time of the newest request answered
+   u32 uLastAnswerTime;
+
+   // Requests in flight (no packet answering them was received yet), oldest are overwritten
+   u32 uPendingIds[VIDEO_NACK_MAX_PENDING_REQUESTS];
+   u32 uPendingTimes[VIDEO_NACK_MAX_PENDING_REQUESTS];
+   int iNextPendingIndex;
+
+   u32 uCountRequests;
+   u32 uCountRequestedPackets;
+   u32 uCountSuppressedPackets; // missing packets not requested again, their request is in flight
+   u32 uCountSkippedBlocks; // blocks past their playout deadline
+   u32 uLastSkippedBlockIndex; // newest block counted as skipped, valid if iHasSkippedBlock
+   int iHasSkippedBlock;
+   u64 uTotalRequestsBytes;
+} type_video_nack_state;
+
+// A retransmission request (PACKET_TYPE_VIDEO_REQ_MULTIPLE_PACKETS), as parsed by the vehicle.
+// The individual packets entries are parsed to the same per block masks as the coalesced ones.
+typedef struct
+{
+   u32 uRequestId;
+   u8 uVideoStreamIndex;
+   u8 uFlags;
+   int iCountEntries; // as sent: packets, or blocks if coalesced
+   int iCountBlocks;
+   u32 uBlockIndexes[256];
+   u32 uMasks[256]; // VIDEO_NACK_MASK_FULL_BLOCK for a full block request
+} type_video_nack_request;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void video_nack_init(type_video_nack_state* pState);
+// Forgets the requests in flight and the skipped blocks (the stream restarted), keeps the RTT estimate
+void video_nack_reset_pending(type_video_nack_state* pState);
+
+u32 video_nack_get_srtt_ms(type_video_nack_state* pState);
+u32 video_nack_get_rto_ms(type_video_nack_state* pState);
+
+void video_nack_on_request_sent(type_video_nack_state* pState, u32 uRequestId, u32 uTimeNow, int iCountPackets, int iRequestBytes);
+// Call it for each retransmitted packet tagged with a request id. Returns the RTT sample in ms,
+// or -1 if the request is not in flight (already answered or unknown).
+int video_nack_on_response(type_video_nack_state* pState, u32 uRequestId, u32 uTimeNow);
+
+// Returns the packets of uMissingMask to request now: not requested yet (not in uRequestedMask) or whose
+// request time (pRequestedTimes, indexed by packet) is older than the RTO, or was answered. uDeadline is the time the block
+// is discarded at (0 if not known): when a retry after the RTO would arrive too late, the packet is
+// retried halfway to the last time its retransmission can still arrive before the deadline.
+u32 video_nack_get_packets_to_request(type_video_nack_state* pState, u32 uMissingMask, u32 uRequestedMask, const u32* pRequestedTimes, u32 uDeadline, u32 uTimeNow);
+// Returns 1 if a retransmission requested now would arrive after the block is discarded (uBlockTime + uDeadlineMs).
+// Each block is counted once as skipped, no matter how many times it is checked (blocks are checked oldest first).
+int video_nack_is_past_deadline(type_video_nack_state* pState, u32 uBlockIndex, u32 uBlockTime, u32 uDeadlineMs, u32 uTimeNow);
+
+// Coalesced requests entries (after the request count). Block indexes must be ascending.
+// Returns the number of blocks encoded (stops at the first block too far from the first one), sets the encoded length.
+int video_nack_encode_blocks(u8* pOutput, const u32* pBlockIndexes, const u32* pMasks, int iCountBlocks, int* piLength);
+// Returns the number of blocks decoded, -1 if the data is shorter than iCountBlocks entries
+int video_nack_decode_blocks(const u8* pInput, int iLength, int iCountBlocks, u32* pBlockIndexes, u32* pMasks);
+// Number of packet requests in the decoded entries; a full block request counts as one, as in the individual requests
+int video_nack_count_requests(const u32* pMasks, int iCountBlocks);
+
+// Writes a request, after the packet header: request id, video stream index, flags, count and the requested
+// packets of each block, coalesced (VIDEO_NACK_FLAG_COALESCED is added to the flags) or as individual entries
+// for the vehicles that do not know the coalesced requests. Block indexes must be ascending. Returns the length written.
+int video_nack_build_request(u8* pOutput, u32 uRequestId, u8 uVideoStreamIndex, u8 uFlags, const u32* pBlockIndexes, const u32* pMasks, int iCountBlocks, int bCoalesce);
+// Parses a request, after the packet header. Returns the length parsed (the frame end request follows it, if flagged), -1 if invalid
+int video_nack_parse_request(const u8* pInput, int iLength, type_video_nack_request* pRequest);
+
+#ifdef __cplusplus
+}
+#endif